@@ -0,0 +1,122 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef BBA_COMPRESS_H
+#define BBA_COMPRESS_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// Compressed output (--compress) is a header, an index and independently compressed blocks:
+//   char magic[8] = "NPNRCDBZ", u32 version = 1, u32 block_size, u64 raw_size, u32 num_blocks,
+//   u32 block_sizes[num_blocks] (the top bit set for a block stored uncompressed), then the blocks
+// in the endianness of the blob. Blocks use a simple LZ77 format: a token byte with the literal count in the top
+// nibble and the match length minus 4 in the bottom one (15 meaning that further bytes are added, until one that is
+// not 255), the literals, then a 16-bit little endian match offset. The last sequence of a block has no match.
+// common/embed.cc decompresses this when the chipdb is loaded, and the tests check it against this compressor.
+static const int compressBlockSize = 1 << 20;
+
+inline void writeLength(std::vector<uint8_t> &out, int length)
+{
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(length);
+}
+
+inline void writeSequence(std::vector<uint8_t> &out, const uint8_t *literals, int numLiterals, int offset,
+                          int matchLength)
+{
+    int matchCode = matchLength > 0 ? matchLength - 4 : 0;
+    out.push_back((std::min(numLiterals, 15) << 4) | std::min(matchCode, 15));
+    if (numLiterals >= 15)
+        writeLength(out, numLiterals - 15);
+    out.insert(out.end(), literals, literals + numLiterals);
+    if (matchLength > 0) {
+        out.push_back(offset & 0xFF);
+        out.push_back(offset >> 8);
+        if (matchCode >= 15)
+            writeLength(out, matchCode - 15);
+    }
+}
+
+inline void compressBlock(const uint8_t *src, int size, std::vector<uint8_t> &out)
+{
+    auto read32 = [&](int pos) {
+        uint32_t v;
+        memcpy(&v, src + pos, 4);
+        return v;
+    };
+    std::vector<int> table(1 << 16, -1);
+    int anchor = 0, pos = 0;
+    while (pos + 4 <= size) {
+        uint32_t seq = read32(pos);
+        int &entry = table[(seq * 2654435761U) >> 16];
+        int candidate = entry;
+        entry = pos;
+        if (candidate < 0 || pos - candidate > 0xFFFF || read32(candidate) != seq) {
+            pos++;
+            continue;
+        }
+        int length = 4;
+        while (pos + length < size && src[candidate + length] == src[pos + length])
+            length++;
+        writeSequence(out, src + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+    writeSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+inline std::vector<uint8_t> compressBlob(const std::vector<uint8_t> &data, bool bigEndian)
+{
+    std::vector<uint8_t> out;
+    auto put = [&](uint64_t value, int numBytes) {
+        for (int i = 0; i < numBytes; i++)
+            out.push_back(value >> (8 * (bigEndian ? (numBytes - 1 - i) : i)));
+    };
+    int numBlocks = (int(data.size()) + compressBlockSize - 1) / compressBlockSize;
+    static const char magic[8] = {'N', 'P', 'N', 'R', 'C', 'D', 'B', 'Z'};
+    out.resize(sizeof(magic));
+    memcpy(out.data(), magic, sizeof(magic));
+    put(1, 4);
+    put(compressBlockSize, 4);
+    put(data.size(), 8);
+    put(numBlocks, 4);
+    size_t indexPos = out.size();
+    out.resize(out.size() + 4 * numBlocks);
+    for (int i = 0; i < numBlocks; i++) {
+        int blockStart = i * compressBlockSize;
+        int blockSize = std::min(compressBlockSize, int(data.size()) - blockStart);
+        std::vector<uint8_t> block;
+        compressBlock(data.data() + blockStart, blockSize, block);
+        uint32_t entry = block.size();
+        if (int(block.size()) >= blockSize) {
+            block.assign(data.begin() + blockStart, data.begin() + blockStart + blockSize);
+            entry = blockSize | 0x80000000U;
+        }
+        for (int k = 0; k < 4; k++)
+            out[indexPos + 4 * i + k] = entry >> (8 * (bigEndian ? (3 - k) : k));
+        out.insert(out.end(), block.begin(), block.end());
+    }
+    return out;
+}
+
+#endif // BBA_COMPRESS_H
@@ -18,6 +18,7 @@
  *
  */
 
+#include <algorithm>
 #include <assert.h>
 #include <boost/filesystem/convenience.hpp>
 #include <boost/program_options.hpp>
@@ -29,6 +30,7 @@
 #include <string.h>
 #include <string>
 #include <vector>
+#include "compress.h"
 
 enum TokenType : int8_t
 {
@@ -74,6 +76,7 @@ int main(int argc, char **argv)
     bool bigEndian;
     bool writeC = false;
     bool writeE = false;
+    bool compress = false;
     char buffer[512];
 
     namespace po = boost::program_options;
@@ -86,6 +89,7 @@ int main(int argc, char **argv)
     options.add_options()("le,l", "little endian");
     options.add_options()("c,c", "write C strings");
     options.add_options()("e,e", "write #embed C");
+    options.add_options()("compress,z", "compress the blob, for nextpnr to decompress when loading it");
     options.add_options()("files", po::value<std::vector<std::string>>(), "file parameters");
     pos.add("files", -1);
 
@@ -120,6 +124,8 @@ int main(int argc, char **argv)
         writeC = true;
     if (vm.count("e"))
         writeE = true;
+    if (vm.count("compress"))
+        compress = true;
 
     if (writeC && writeE) {
         printf("Incompatible modes\n");
@@ -405,6 +411,14 @@ int main(int argc, char **argv)
 
     assert(cursor == int(data.size()));
 
+    if (compress) {
+        size_t rawSize = data.size();
+        data = compressBlob(data, bigEndian);
+        if (verbose)
+            printf("compressed %.2f MB to %.2f MB\n", double(rawSize) / (1024 * 1024),
+                   double(data.size()) / (1024 * 1024));
+    }
+
     if (writeC) {
         for (auto &s : preText)
             fprintf(fileOut, "%s\n", s.c_str());
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""
+Run the nextpnr benchmark catalogue (designs.json) and collect structured results.
+
+Each design is synthesised once with Yosys, then placed and routed for every seed, repeated --runs times. Results
+(per-stage runtime, peak memory, wirelength, fmax and the throughput of the placer and router inner loops, taken from
+nextpnr's --report output) are written as JSON, together with the median over repeats of each seed. With --baseline,
+results are compared against an earlier run and the script fails if any design got slower or worse by more than the
+given tolerances. With --compare, two existing results files are compared without running anything.
+"""
+
+import argparse
+import datetime
+import hashlib
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import time
+
+root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+parser = argparse.ArgumentParser(description="Run the nextpnr benchmark catalogue")
+parser.add_argument("--bin-dir", default=".", help="directory containing the nextpnr-<arch> binaries")
+parser.add_argument("--prefix", default="", help="program prefix of the nextpnr binaries")
+parser.add_argument("--arch", default="ice40,ecp5,nexus,gowin,generic",
+                    help="comma separated list of architectures to benchmark")
+parser.add_argument("--design", action="append", help="only run the named design(s)")
+parser.add_argument("--catalogue", default=os.path.join(root, "bench", "designs.json"), help="design catalogue")
+parser.add_argument("--seeds", default="1,2,3", help="comma separated list of placer seeds")
+parser.add_argument("--runs", type=int, default=3, help="number of repeats of each seed, for timing noise")
+parser.add_argument("--threads", type=int, default=None, help="value of --threads to pass to nextpnr")
+parser.add_argument("--work-dir", default="bench", help="directory for netlists, logs and reports")
+parser.add_argument("--out", default=None, help="results file to write (default <work-dir>/results.json)")
+parser.add_argument("--baseline", default=None, help="earlier results file to compare against")
+parser.add_argument("--compare", default=None, metavar="RESULTS",
+                    help="compare this results file against --baseline instead of running the catalogue")
+parser.add_argument("--time-tolerance", type=float, default=0.10,
+                    help="allowed relative increase in runtime or peak memory, or decrease in throughput, against "
+                         "the baseline")
+parser.add_argument("--min-stage-time", type=float, default=1.0,
+                    help="only compare the runtime and throughput of stages taking at least this long (s) in the "
+                         "baseline, as shorter ones are mostly noise")
+parser.add_argument("--qor-tolerance", type=float, default=0.02,
+                    help="allowed relative decrease in fmax or increase in wirelength against the baseline")
+args = parser.parse_args()
+
+
+def synthesise(arch, design, work_dir):
+    """Synthesise a design once; the netlist is reused while the sources and script are unchanged."""
+    sources = [os.path.join(root, s) for s in design["sources"]]
+    key = hashlib.sha1(design["synth"].encode())
+    for src in sources:
+        with open(src, "rb") as f:
+            key.update(f.read())
+    netlist = os.path.join(work_dir, "{}-{}.json".format(design["name"], key.hexdigest()[:12]))
+    if os.path.exists(netlist):
+        return netlist
+    read = "read_verilog {}".format(" ".join(sources))
+    if design["synth"].startswith("tcl "):
+        synth = "tcl {} {}".format(os.path.join(root, design["synth"].split()[1]),
+                                   " ".join(design["synth"].split()[2:] + [netlist]))
+    else:
+        synth = "{} -top {} -json {}".format(design["synth"], design["top"], netlist)
+    log = os.path.join(work_dir, "{}-yosys.log".format(design["name"]))
+    subprocess.run(["yosys", "-q", "-l", log, "-p", "{}; {}".format(read, synth)], check=True)
+    return netlist
+
+
+def run_pnr(arch, design, netlist, seed, run, work_dir):
+    """Run nextpnr once, returning the result record for this run."""
+    base = os.path.join(work_dir, "{}-s{}-r{}".format(design["name"], seed, run))
+    report = base + "-report.json"
+    if os.path.exists(report):
+        os.remove(report)
+    binary = os.path.abspath(os.path.join(args.bin_dir, "{}nextpnr-{}".format(args.prefix, arch)))
+    cmd = [binary, "--json", netlist, "--seed", str(seed), "--report", report, "--log", base + ".log", "--quiet"]
+    if args.threads is not None:
+        cmd += ["--threads", str(args.threads)]
+    cmd += design.get("args", [])
+    start = time.monotonic()
+    result = subprocess.run(cmd, cwd=os.path.join(root, design.get("cwd", ".")), stdout=subprocess.DEVNULL,
+                            stderr=subprocess.DEVNULL)
+    wall = time.monotonic() - start
+    record = {"arch": arch, "design": design["name"], "seed": seed, "run": run, "wall_s": wall,
+              "status": "ok" if result.returncode == 0 and os.path.exists(report) else "failed"}
+    if record["status"] == "ok":
+        with open(report) as f:
+            rpt = json.load(f)
+        record["runtime_s"] = rpt.get("runtime", {})
+        record["peak_rss_kib"] = rpt.get("peak_rss_kib")
+        record["memory_kib"] = {name: m["peak"] for name, m in rpt.get("memory_kib", {}).items()}
+        record["wirelength"] = rpt.get("wirelength", {})
+        record["fmax_mhz"] = {clk: v["achieved"] for clk, v in rpt.get("fmax", {}).items()}
+        # Placer moves, router nodes and solver iterations per second, and the time they were measured over
+        record["throughput"] = {name: {"per_s": t["per_s"], "seconds": t["seconds"]}
+                                for name, t in rpt.get("throughput", {}).items()}
+    return record
+
+
+def summarise(records):
+    """Median over repeats of every seed; the QoR of a seed should not change between repeats."""
+    summary = {}
+    for r in records:
+        if r["status"] != "ok":
+            continue
+        key = "{}/{}/s{}".format(r["arch"], r["design"], r["seed"])
+        summary.setdefault(key, []).append(r)
+    out = {}
+    for key, runs in sorted(summary.items()):
+        stages = sorted(set(s for r in runs for s in r["runtime_s"]))
+        loops = sorted(set(n for r in runs for n in r.get("throughput", {})))
+        out[key] = {
+            "runs": len(runs),
+            "wall_s": statistics.median(r["wall_s"] for r in runs),
+            "runtime_s": {s: statistics.median(r["runtime_s"].get(s, 0.0) for r in runs) for s in stages},
+            "peak_rss_kib": statistics.median(r["peak_rss_kib"] for r in runs),
+            "throughput": {n: {k: statistics.median(r.get("throughput", {}).get(n, {}).get(k, 0.0) for r in runs)
+                               for k in ("per_s", "seconds")} for n in loops},
+            "wirelength": runs[0]["wirelength"],
+            "fmax_mhz": runs[0]["fmax_mhz"],
+            "qor_stable": all(r["wirelength"] == runs[0]["wirelength"] and r["fmax_mhz"] == runs[0]["fmax_mhz"]
+                              for r in runs),
+        }
+    return out
+
+
+def compare(summary, baseline):
+    """Return a list of regressions of summary against baseline."""
+    regressions = []
+
+    def worse(key, what, old, new, tol, higher_is_worse=True):
+        if old is None or new is None or old == 0:
+            return
+        change = (new - old) / old if higher_is_worse else (old - new) / old
+        if change > tol:
+            regressions.append("{}: {} {:.4g} -> {:.4g} ({:+.1f}%)".format(key, what, old, new, 100 * change))
+
+    for key, new in sorted(summary.items()):
+        old = baseline.get(key)
+        if old is None:
+            continue
+        worse(key, "total runtime (s)", sum(old["runtime_s"].values()), sum(new["runtime_s"].values()),
+              args.time_tolerance)
+        for stage, t in sorted(new["runtime_s"].items()):
+            if old["runtime_s"].get(stage, 0.0) >= args.min_stage_time:
+                worse(key, "{} runtime (s)".format(stage), old["runtime_s"][stage], t, args.time_tolerance)
+        for name, t in sorted(new.get("throughput", {}).items()):
+            old_t = old.get("throughput", {}).get(name)
+            if old_t is not None and old_t["seconds"] >= args.min_stage_time:
+                worse(key, "{} per second".format(name), old_t["per_s"], t["per_s"], args.time_tolerance, False)
+        worse(key, "peak memory (KiB)", old["peak_rss_kib"], new["peak_rss_kib"], args.time_tolerance)
+        worse(key, "wirelength (hpwl)", old["wirelength"].get("hpwl"), new["wirelength"].get("hpwl"),
+              args.qor_tolerance)
+        for clk, fmax in new["fmax_mhz"].items():
+            worse(key, "fmax of {} (MHz)".format(clk), old["fmax_mhz"].get(clk), fmax, args.qor_tolerance, False)
+    for key in sorted(baseline):
+        if key not in summary:
+            regressions.append("{}: no successful runs".format(key))
+    return regressions
+
+
+def check(summary):
+    """Compare summary against --baseline, printing and returning the regressions."""
+    with open(args.baseline) as f:
+        regressions = compare(summary, json.load(f)["summary"])
+    for reg in regressions:
+        print("REGRESSION: {}".format(reg), file=sys.stderr)
+    return regressions
+
+
+def main():
+    if args.compare is not None:
+        if args.baseline is None:
+            parser.error("--compare needs --baseline")
+        with open(args.compare) as f:
+            summary = json.load(f)["summary"]
+        regressions = check(summary)
+        print("{} regressions in {} results".format(len(regressions), len(summary)))
+        return 1 if regressions else 0
+
+    with open(args.catalogue) as f:
+        catalogue = json.load(f)
+    seeds = [int(s) for s in args.seeds.split(",")]
+    records = []
+    for arch in args.arch.split(","):
+        if arch not in catalogue:
+            print("No designs for architecture '{}'".format(arch), file=sys.stderr)
+            continue
+        work_dir = os.path.abspath(os.path.join(args.work_dir, arch))
+        os.makedirs(work_dir, exist_ok=True)
+        for design in catalogue[arch]:
+            if args.design and design["name"] not in args.design:
+                continue
+            netlist = synthesise(arch, design, work_dir)
+            for seed in seeds:
+                for run in range(args.runs):
+                    r = run_pnr(arch, design, netlist, seed, run, work_dir)
+                    print("{}/{} seed {} run {}: {} in {:.2f}s".format(arch, design["name"], seed, run, r["status"],
+                                                                      r["wall_s"]))
+                    records.append(r)
+
+    try:
+        revision = subprocess.check_output(["git", "describe", "--always", "--dirty"], cwd=root,
+                                           stderr=subprocess.DEVNULL).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        revision = "unknown"
+    summary = summarise(records)
+    results = {
+        "meta": {
+            "revision": revision,
+            "date": datetime.datetime.now().isoformat(timespec="seconds"),
+            "host": platform.node(),
+            "platform": platform.platform(),
+            "cpus": os.cpu_count(),
+            "seeds": seeds,
+            "runs": args.runs,
+        },
+        "runs": records,
+        "summary": summary,
+    }
+    out = args.out or os.path.join(args.work_dir, "results.json")
+    with open(out, "w") as f:
+        json.dump(results, f, indent=2, sort_keys=True)
+    print("Results written to {}".format(out))
+
+    failed = [r for r in records if r["status"] != "ok"]
+    for r in failed:
+        print("FAILED: {}/{} seed {} run {}".format(r["arch"], r["design"], r["seed"], r["run"]), file=sys.stderr)
+    regressions = check(summary) if args.baseline is not None else []
+    return 1 if failed or regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
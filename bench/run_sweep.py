@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""
+Sweep placer and router seeds and parameters over several machines, and summarise the results.
+
+The design is packed once into a checkpoint, then every combination of seed and parameter values is placed and routed
+from that checkpoint as a separate job, with the parameters passed through nextpnr's --set option. Jobs are run on the
+given workers: "local" runs them on this machine, any other name over ssh. Remote workers must see the work directory
+and the nextpnr binary at the same paths as this machine (for example on a shared filesystem). Per-job fmax, runtime,
+peak memory and wirelength come from nextpnr's --report output and are written to a JSON summary, ranked by the worst
+ratio of achieved to constrained fmax over all clocks.
+
+Example:
+    run_sweep.py --nextpnr ./nextpnr-ecp5 --json top.json --seeds 1-16 --param router2/bbMargin=3,5 \\
+        --workers local:4,build1:16,build2:16 -- --45k --lpf top.lpf --freq 100
+"""
+
+import argparse
+import itertools
+import json
+import os
+import queue
+import shlex
+import subprocess
+import sys
+import threading
+import time
+
+parser = argparse.ArgumentParser(description="Sweep nextpnr seeds and parameters over several machines",
+                                 formatter_class=argparse.RawDescriptionHelpFormatter, epilog=__doc__)
+parser.add_argument("--nextpnr", required=True, help="nextpnr-<arch> binary")
+parser.add_argument("--json", required=True, help="synthesised design to pack and sweep")
+parser.add_argument("--seeds", default="1", help="seeds to sweep, as a comma separated list of numbers or ranges a-b")
+parser.add_argument("--param", action="append", default=[],
+                    help="setting to sweep, as NAME=VALUE1,VALUE2,...; may be given more than once")
+parser.add_argument("--workers", default="local:{}".format(os.cpu_count() or 1),
+                    help="comma separated list of HOST:JOBS, where HOST is 'local' or an ssh destination")
+parser.add_argument("--work-dir", default="sweep", help="directory for the checkpoint, logs and reports")
+parser.add_argument("--out", default=None, help="summary file to write (default <work-dir>/summary.json)")
+parser.add_argument("args", nargs="*", help="further nextpnr options for every run, such as the device, after '--'")
+args = parser.parse_args()
+
+
+def parse_seeds(spec):
+    seeds = []
+    for part in spec.split(","):
+        if "-" in part:
+            first, last = part.split("-", 1)
+            seeds += range(int(first), int(last) + 1)
+        else:
+            seeds.append(int(part))
+    return seeds
+
+
+def parse_params(specs):
+    """List of (name, [values]) for each swept setting."""
+    params = []
+    for spec in specs:
+        if "=" not in spec:
+            parser.error("--param expects NAME=VALUE1,VALUE2,..., not '{}'".format(spec))
+        name, values = spec.split("=", 1)
+        params.append((name, values.split(",")))
+    return params
+
+
+def parse_workers(spec):
+    """One entry per job slot, naming the host it runs on."""
+    slots = []
+    for worker in spec.split(","):
+        host, _, count = worker.rpartition(":")
+        if not host:
+            host, count = count, "1"
+        slots += [host] * int(count)
+    return slots
+
+
+def run_on(host, cmd, cwd):
+    """Run a command on a worker, returning its exit status."""
+    if host == "local":
+        return subprocess.run(cmd, cwd=cwd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL).returncode
+    remote = "cd {} && {}".format(shlex.quote(cwd), " ".join(shlex.quote(c) for c in cmd))
+    return subprocess.run(["ssh", "-o", "BatchMode=yes", host, remote], stdin=subprocess.DEVNULL,
+                          stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL).returncode
+
+
+def job_result(job, host, status, wall):
+    record = {"job": job["name"], "seed": job["seed"], "settings": job["settings"], "host": host, "wall_s": wall,
+              "status": "ok" if status == 0 and os.path.exists(job["report"]) else "failed"}
+    if record["status"] == "ok":
+        with open(job["report"]) as f:
+            rpt = json.load(f)
+        record["runtime_s"] = rpt.get("runtime", {})
+        record["peak_rss_kib"] = rpt.get("peak_rss_kib")
+        record["wirelength"] = rpt.get("wirelength", {})
+        record["fmax_mhz"] = {clk: v["achieved"] for clk, v in rpt.get("fmax", {}).items()}
+        ratios = [v["achieved"] / v["constraint"] if v.get("constraint") else v["achieved"]
+                  for v in rpt.get("fmax", {}).values()]
+        record["score"] = min(ratios) if ratios else None
+    return record
+
+
+def main():
+    nextpnr = os.path.abspath(args.nextpnr)
+    work_dir = os.path.abspath(args.work_dir)
+    os.makedirs(work_dir, exist_ok=True)
+    seeds = parse_seeds(args.seeds)
+    params = parse_params(args.param)
+    slots = parse_workers(args.workers)
+
+    checkpoint = os.path.join(work_dir, "packed.npck")
+    print("Packing {}...".format(args.json))
+    pack = [nextpnr, "--json", os.path.abspath(args.json), "--pack-only", "--write-checkpoint", checkpoint, "--log",
+            os.path.join(work_dir, "pack.log"), "--quiet"] + args.args
+    if subprocess.run(pack).returncode != 0:
+        print("Packing failed, see {}".format(os.path.join(work_dir, "pack.log")), file=sys.stderr)
+        return 1
+
+    jobs = queue.Queue()
+    names = [name for name, _ in params]
+    for values in itertools.product(*[vals for _, vals in params]):
+        settings = dict(zip(names, values))
+        for seed in seeds:
+            tag = "-".join(["s{}".format(seed)] + ["{}={}".format(n.replace("/", "."), v) for n, v in settings.items()])
+            base = os.path.join(work_dir, tag)
+            cmd = [nextpnr, "--load-checkpoint", checkpoint, "--seed", str(seed), "--report", base + "-report.json",
+                   "--log", base + ".log", "--quiet"] + args.args
+            for name, value in settings.items():
+                cmd += ["--set", "{}={}".format(name, value)]
+            jobs.put({"name": tag, "seed": seed, "settings": settings, "cmd": cmd, "report": base + "-report.json"})
+    total = jobs.qsize()
+    print("Running {} jobs on {} slots...".format(total, len(slots)))
+
+    results = []
+    lock = threading.Lock()
+
+    def worker(host):
+        while True:
+            try:
+                job = jobs.get_nowait()
+            except queue.Empty:
+                return
+            if os.path.exists(job["report"]):
+                os.remove(job["report"])
+            start = time.monotonic()
+            status = run_on(host, job["cmd"], work_dir)
+            record = job_result(job, host, status, time.monotonic() - start)
+            with lock:
+                results.append(record)
+                print("[{}/{}] {} on {}: {} in {:.1f}s{}".format(
+                    len(results), total, job["name"], host, record["status"], record["wall_s"],
+                    "" if record.get("score") is None else ", score {:.3f}".format(record["score"])))
+
+    threads = [threading.Thread(target=worker, args=(host, )) for host in slots]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    ranked = sorted((r for r in results if r["status"] == "ok"), key=lambda r: -(r.get("score") or 0))
+    summary = {
+        "design": os.path.abspath(args.json),
+        "args": args.args,
+        "seeds": seeds,
+        "params": dict(params),
+        "jobs": ranked + [r for r in results if r["status"] != "ok"],
+    }
+    out = args.out or os.path.join(work_dir, "summary.json")
+    with open(out, "w") as f:
+        json.dump(summary, f, indent=2, sort_keys=True)
+
+    print()
+    print("{:<40} {:>8} {:>10} {:>12}".format("job", "score", "route (s)", "hpwl"))
+    for r in ranked[:10]:
+        print("{:<40} {:>8} {:>10.2f} {:>12}".format(
+            r["job"], "-" if r.get("score") is None else "{:.3f}".format(r["score"]),
+            r["runtime_s"].get("route", 0.0), r["wirelength"].get("hpwl", "-")))
+    failed = total - len(ranked)
+    if failed:
+        print("{} jobs failed, see their logs in {}".format(failed, work_dir), file=sys.stderr)
+    print("Summary written to {}".format(out))
+    return 1 if not ranked else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
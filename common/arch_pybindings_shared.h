@@ -14,6 +14,14 @@ fn_wrapper_1a<Context, decltype(&Context::getNetByAlias), &Context::getNetByAlia
               conv_from_str<IdString>>::def_wrap(ctx_cls, "getNetByAlias");
 fn_wrapper_2a_v<Context, decltype(&Context::addClock), &Context::addClock, conv_from_str<IdString>,
                 pass_through<float>>::def_wrap(ctx_cls, "addClock");
+fn_wrapper_3a_v<Context, decltype(&Context::addFalsePath), &Context::addFalsePath, conv_from_str<IdString>,
+                conv_from_str<IdString>, conv_from_str<IdString>>::def_wrap(ctx_cls, "addFalsePath");
+fn_wrapper_4a_v<Context, decltype(&Context::addMulticyclePath), &Context::addMulticyclePath, conv_from_str<IdString>,
+                conv_from_str<IdString>, conv_from_str<IdString>, pass_through<int>>::def_wrap(ctx_cls,
+                                                                                              "addMulticyclePath");
+fn_wrapper_4a_v<Context, decltype(&Context::addMaxDelay), &Context::addMaxDelay, conv_from_str<IdString>,
+                conv_from_str<IdString>, conv_from_str<IdString>, pass_through<float>>::def_wrap(ctx_cls,
+                                                                                                "addMaxDelay");
 fn_wrapper_5a_v<Context, decltype(&Context::createRectangularRegion), &Context::createRectangularRegion,
                 conv_from_str<IdString>, pass_through<int>, pass_through<int>, pass_through<int>,
                 pass_through<int>>::def_wrap(ctx_cls, "createRectangularRegion");
@@ -108,5 +116,29 @@ fn_wrapper_0a<Context, decltype(&Context::getChipName), &Context::getChipName, p
 fn_wrapper_0a<Context, decltype(&Context::archId), &Context::archId, conv_to_str<IdString>>::def_wrap(ctx_cls,
                                                                                                       "archId");
 
-fn_wrapper_2a_v<Context, decltype(&Context::writeSVG), &Context::writeSVG, pass_through<std::string>,
-                pass_through<std::string>>::def_wrap(ctx_cls, "writeSVG");
+ctx_cls.def("writeSVG", &Context::writeSVG, py::arg("filename"), py::arg("flags") = "", release_gil());
+ctx_cls.def(
+        "timing_analysis",
+        [](Context &ctx, bool slack_histogram, bool print_fmax, bool print_path, bool warn_on_failure) {
+            timing_analysis(&ctx, slack_histogram, print_fmax, print_path, warn_on_failure);
+        },
+        py::arg("slack_histogram") = false, py::arg("print_fmax") = true, py::arg("print_path") = false,
+        py::arg("warn_on_failure") = false, release_gil());
+// Persistent timing graph for repeated queries; the first update is a full analysis, later ones only redo what changed
+ctx_cls.def(
+        "incremental_timing",
+        [](Context &ctx) {
+            std::unique_ptr<IncrementalCriticality> timing(new IncrementalCriticality(&ctx));
+            timing->update(nullptr);
+            return timing;
+        },
+        py::keep_alive<0, 1>());
+
+ctx_cls.def("getPlacementTable", [](const Context &ctx) { return placement_table(&ctx); });
+ctx_cls.def("getRoutingTable", [](const Context &ctx) { return routing_table(&ctx); });
+ctx_cls.def("getIdStrings", [](const Context &ctx) {
+    py::list result;
+    for (int i = 0; i < ctx.idstring_db->size(); i++)
+        result.append(ctx.idstring_db->str(i));
+    return result;
+});
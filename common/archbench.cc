@@ -0,0 +1,181 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include "log.h"
+#include "nextpnr.h"
+#include "util.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+// Times the Arch API calls that dominate the placer and router inner loops, each over the same random sample of
+// objects, so that the effect of changes to an arch's database layout or lookup code can be measured in isolation
+struct ArchBench
+{
+    const Context *ctx;
+    int samples, repeats;
+    DeterministicRNG rng;
+    std::vector<BelId> bels;
+    std::vector<WireId> wires, dst_wires;
+    std::vector<PipId> pips;
+    std::vector<std::pair<BelId, IdString>> bel_pins;
+    // Every result is folded into this, so that the calls being timed can't be optimised away
+    uint64_t sink = 0;
+
+    ArchBench(const Context *ctx) : ctx(ctx)
+    {
+        samples = std::max(1, int_or_default(ctx->settings, ctx->id("archbench/samples"), 100000));
+        repeats = std::max(1, int_or_default(ctx->settings, ctx->id("archbench/repeats"), 3));
+        rng.rngseed(ctx->rngstate);
+
+        std::vector<BelId> all_bels;
+        std::vector<WireId> all_wires;
+        std::vector<PipId> all_pips;
+        for (BelId bel : ctx->getBels())
+            all_bels.push_back(bel);
+        for (WireId wire : ctx->getWires())
+            all_wires.push_back(wire);
+        for (PipId pip : ctx->getPips())
+            all_pips.push_back(pip);
+        log_info("Device has %d bels, %d wires and %d pips.\n", int(all_bels.size()), int(all_wires.size()),
+                 int(all_pips.size()));
+
+        bels = take_sample(all_bels);
+        wires = take_sample(all_wires);
+        dst_wires = take_sample(all_wires);
+        pips = take_sample(all_pips);
+        for (BelId bel : bels) {
+            auto pins = ctx->getBelPins(bel);
+            if (!pins.empty())
+                bel_pins.emplace_back(bel, pins.at(rng.rng(int(pins.size()))));
+        }
+        log_info("Timing %d random samples of each call, best of %d runs.\n", samples, repeats);
+        log_break();
+    }
+
+    // Samples are drawn with replacement, so that small devices still give enough calls to time
+    template <typename T> std::vector<T> take_sample(const std::vector<T> &items)
+    {
+        std::vector<T> result;
+        if (items.empty())
+            return result;
+        result.reserve(samples);
+        for (int i = 0; i < samples; i++)
+            result.push_back(items.at(rng.rng(int(items.size()))));
+        return result;
+    }
+
+    // Time func, which makes the given number of calls and returns the number of items (e.g. pips) they yielded
+    template <typename Tfunc> void bench(const char *name, int calls, Tfunc func)
+    {
+        if (calls == 0)
+            return;
+        double best = std::numeric_limits<double>::max();
+        int64_t items = 0;
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            items = func();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+        }
+        log_info("  %-22s %10d %12.1f %12.2f\n", name, calls, best / calls, double(items) / calls);
+    }
+
+    void run()
+    {
+        log_info("  %-22s %10s %12s %12s\n", "call", "calls", "ns/call", "items/call");
+
+        bench("getPipsDownhill", int(wires.size()), [&]() {
+            int64_t count = 0;
+            for (WireId wire : wires)
+                for (PipId pip : ctx->getPipsDownhill(wire)) {
+                    sink += std::hash<PipId>()(pip);
+                    count++;
+                }
+            return count;
+        });
+        bench("getPipsUphill", int(wires.size()), [&]() {
+            int64_t count = 0;
+            for (WireId wire : wires)
+                for (PipId pip : ctx->getPipsUphill(wire)) {
+                    sink += std::hash<PipId>()(pip);
+                    count++;
+                }
+            return count;
+        });
+        bench("getPipDstWire", int(pips.size()), [&]() {
+            for (PipId pip : pips)
+                sink += std::hash<WireId>()(ctx->getPipDstWire(pip));
+            return int64_t(pips.size());
+        });
+        bench("getPipDelay", int(pips.size()), [&]() {
+            for (PipId pip : pips)
+                sink += uint64_t(ctx->getPipDelay(pip).maxDelay());
+            return int64_t(pips.size());
+        });
+        bench("estimateDelay", int(wires.size()), [&]() {
+            for (size_t i = 0; i < wires.size(); i++)
+                sink += uint64_t(ctx->estimateDelay(wires.at(i), dst_wires.at(i)));
+            return int64_t(wires.size());
+        });
+        bench("checkWireAvail", int(wires.size()), [&]() {
+            for (WireId wire : wires)
+                sink += ctx->checkWireAvail(wire);
+            return int64_t(wires.size());
+        });
+        bench("checkPipAvail", int(pips.size()), [&]() {
+            for (PipId pip : pips)
+                sink += ctx->checkPipAvail(pip);
+            return int64_t(pips.size());
+        });
+        bench("checkBelAvail", int(bels.size()), [&]() {
+            for (BelId bel : bels)
+                sink += ctx->checkBelAvail(bel);
+            return int64_t(bels.size());
+        });
+        bench("getBelPinWire", int(bel_pins.size()), [&]() {
+            for (auto &bp : bel_pins)
+                sink += std::hash<WireId>()(ctx->getBelPinWire(bp.first, bp.second));
+            return int64_t(bel_pins.size());
+        });
+        bench("isBelLocationValid", int(bels.size()), [&]() {
+            for (BelId bel : bels)
+                sink += ctx->isBelLocationValid(bel);
+            return int64_t(bels.size());
+        });
+        log_break();
+        log_info("Checksum: %016llx\n", (unsigned long long)sink);
+    }
+};
+
+} // namespace
+
+NEXTPNR_NAMESPACE_BEGIN
+
+void Context::archbench() const
+{
+    log_info("Benchmarking architecture API...\n");
+    ArchBench(this).run();
+}
+
+NEXTPNR_NAMESPACE_END
@@ -17,8 +17,11 @@
  *
  */
 
+#include <numeric>
 #include "log.h"
 #include "nextpnr.h"
+#include "util.h"
+#include "worker_pool.h"
 
 #if 0
 #define dbg(...) log(__VA_ARGS__)
@@ -30,170 +33,301 @@ USING_NEXTPNR_NAMESPACE
 
 namespace {
 
-void archcheck_names(const Context *ctx)
+// Failed checks of one shard. log_error can only be called once all shards are done, so failures are collected and
+// reported in shard order afterwards
+typedef std::vector<std::string> Failures;
+
+#define archcheck_assert(cond, name)                                                                                   \
+    do {                                                                                                               \
+        if (!(cond))                                                                                                   \
+            failures.push_back(stringf("%s:%d: '%s' failed for %s", __FILE__, __LINE__, #cond, name));                 \
+    } while (0)
+
+struct ArchChecker
 {
-    log_info("Checking entity names.\n");
-
-    log_info("Checking bel names..\n");
-    for (BelId bel : ctx->getBels()) {
-        IdString name = ctx->getBelName(bel);
-        BelId bel2 = ctx->getBelByName(name);
-        if (bel != bel2) {
-            log_error("bel != bel2, name = %s\n", name.c_str(ctx));
-        }
-    }
+    const Context *ctx;
+    int threads;
+    // The objects to check: all of them, or a random sample
+    std::vector<BelId> bels;
+    std::vector<WireId> wires;
+    std::vector<PipId> pips;
+    std::vector<Loc> tiles;
+#ifndef NPNR_DISABLE_THREADS
+    std::unique_ptr<WorkerPool> pool;
+#endif
 
-    log_info("Checking wire names..\n");
-    for (WireId wire : ctx->getWires()) {
-        IdString name = ctx->getWireName(wire);
-        WireId wire2 = ctx->getWireByName(name);
-        if (wire != wire2) {
-            log_error("wire != wire2, name = %s\n", name.c_str(ctx));
-        }
-    }
-#ifndef ARCH_ECP5
-    log_info("Checking pip names..\n");
-    for (PipId pip : ctx->getPips()) {
-        IdString name = ctx->getPipName(pip);
-        PipId pip2 = ctx->getPipByName(name);
-        if (pip != pip2) {
-            log_error("pip != pip2, name = %s\n", name.c_str(ctx));
+    ArchChecker(const Context *ctx) : ctx(ctx)
+    {
+        threads = ctx->stage_threads("archcheck", 0);
+
+        for (BelId bel : ctx->getBels())
+            bels.push_back(bel);
+        for (WireId wire : ctx->getWires())
+            wires.push_back(wire);
+        for (PipId pip : ctx->getPips())
+            pips.push_back(pip);
+        for (int x = 0; x < ctx->getGridDimX(); x++)
+            for (int y = 0; y < ctx->getGridDimY(); y++)
+                tiles.push_back(Loc(x, y, 0));
+
+        int sample = int_or_default(ctx->settings, ctx->id("archcheck/sample"), 0);
+        if (sample > 0) {
+            log_info("Checking a sample of up to %d of each kind of object.\n", sample);
+            DeterministicRNG rng;
+            rng.rngseed(ctx->rngstate);
+            take_sample(rng, bels, sample);
+            take_sample(rng, wires, sample);
+            take_sample(rng, pips, sample);
+            take_sample(rng, tiles, sample);
         }
+        log_info("Checking with %d thread%s.\n", threads, threads == 1 ? "" : "s");
+        log_break();
     }
-#endif
-    log_break();
-}
 
-void archcheck_locs(const Context *ctx)
-{
-    log_info("Checking location data.\n");
-
-    log_info("Checking all bels..\n");
-    for (BelId bel : ctx->getBels()) {
-        log_assert(bel != BelId());
-        dbg("> %s\n", ctx->getBelName(bel).c_str(ctx));
-
-        Loc loc = ctx->getBelLocation(bel);
-        dbg("   ... %d %d %d\n", loc.x, loc.y, loc.z);
-
-        log_assert(0 <= loc.x);
-        log_assert(0 <= loc.y);
-        log_assert(0 <= loc.z);
-        log_assert(loc.x < ctx->getGridDimX());
-        log_assert(loc.y < ctx->getGridDimY());
-        log_assert(loc.z < ctx->getTileBelDimZ(loc.x, loc.y));
-
-        BelId bel2 = ctx->getBelByLocation(loc);
-        dbg("   ... %s\n", ctx->getBelName(bel2).c_str(ctx));
-        log_assert(bel == bel2);
+    template <typename T> static void take_sample(DeterministicRNG &rng, std::vector<T> &items, int sample)
+    {
+        if (int(items.size()) <= sample)
+            return;
+        rng.shuffle(items.begin(), items.end());
+        items.resize(sample);
     }
 
-    log_info("Checking all locations..\n");
-    for (int x = 0; x < ctx->getGridDimX(); x++)
-        for (int y = 0; y < ctx->getGridDimY(); y++) {
-            dbg("> %d %d\n", x, y);
-            std::unordered_set<int> usedz;
-
-            for (int z = 0; z < ctx->getTileBelDimZ(x, y); z++) {
-                BelId bel = ctx->getBelByLocation(Loc(x, y, z));
-                if (bel == BelId())
-                    continue;
-                Loc loc = ctx->getBelLocation(bel);
-                dbg("   + %d %s\n", z, ctx->getBelName(bel).c_str(ctx));
-                log_assert(x == loc.x);
-                log_assert(y == loc.y);
-                log_assert(z == loc.z);
-                usedz.insert(z);
-            }
-
-            for (BelId bel : ctx->getBelsByTile(x, y)) {
-                Loc loc = ctx->getBelLocation(bel);
-                dbg("   - %d %s\n", loc.z, ctx->getBelName(bel).c_str(ctx));
-                log_assert(x == loc.x);
-                log_assert(y == loc.y);
-                log_assert(usedz.count(loc.z));
-                usedz.erase(loc.z);
+    // Run func(begin, end, failures) over shards of [0, count), on several threads if parallel, then report failures
+    void run_sharded(int count, const std::function<void(int, int, Failures &)> &func, bool parallel = true)
+    {
+        const int shard_size = 1024;
+        int num_shards = (count + shard_size - 1) / shard_size;
+        std::vector<Failures> failures(num_shards);
+        auto run_shard = [&](int i) { func(i * shard_size, std::min(count, (i + 1) * shard_size), failures.at(i)); };
+#ifndef NPNR_DISABLE_THREADS
+        if (parallel && threads > 1 && num_shards > 1) {
+            if (pool == nullptr)
+                pool.reset(new WorkerPool(threads));
+            std::vector<int> tasks(num_shards);
+            std::iota(tasks.begin(), tasks.end(), 0);
+            pool->run(tasks, run_shard);
+        } else
+#endif
+            for (int i = 0; i < num_shards; i++)
+                run_shard(i);
+
+        int total = 0;
+        for (auto &shard : failures) {
+            for (auto &failure : shard) {
+                if (total < 20)
+                    log_nonfatal_error("%s\n", failure.c_str());
+                total++;
             }
-
-            log_assert(usedz.empty());
         }
+        if (total > 0)
+            log_error("%d architecture database check%s failed.\n", total, total == 1 ? "" : "s");
+    }
 
-    log_break();
-}
+    void check_names()
+    {
+        log_info("Checking entity names.\n");
 
-void archcheck_conn(const Context *ctx)
-{
-    log_info("Checking connectivity data.\n");
+        // ECP5 fills in name lookup caches as it goes, so its lookups can't run in parallel
+#ifdef ARCH_ECP5
+        bool parallel = false;
+#else
+        bool parallel = true;
+#endif
 
-    log_info("Checking all wires...\n");
+        log_info("Checking bel names..\n");
+        run_sharded(
+                int(bels.size()),
+                [&](int begin, int end, Failures &failures) {
+                    for (int i = begin; i < end; i++) {
+                        BelId bel = bels.at(i);
+                        IdString name = ctx->getBelName(bel);
+                        BelId bel2 = ctx->getBelByName(name);
+                        archcheck_assert(bel == bel2, name.c_str(ctx));
+                    }
+                },
+                parallel);
+
+        log_info("Checking wire names..\n");
+        run_sharded(
+                int(wires.size()),
+                [&](int begin, int end, Failures &failures) {
+                    for (int i = begin; i < end; i++) {
+                        WireId wire = wires.at(i);
+                        IdString name = ctx->getWireName(wire);
+                        WireId wire2 = ctx->getWireByName(name);
+                        archcheck_assert(wire == wire2, name.c_str(ctx));
+                    }
+                },
+                parallel);
+#ifndef ARCH_ECP5
+        log_info("Checking pip names..\n");
+        run_sharded(
+                int(pips.size()),
+                [&](int begin, int end, Failures &failures) {
+                    for (int i = begin; i < end; i++) {
+                        PipId pip = pips.at(i);
+                        IdString name = ctx->getPipName(pip);
+                        PipId pip2 = ctx->getPipByName(name);
+                        archcheck_assert(pip == pip2, name.c_str(ctx));
+                    }
+                },
+                parallel);
+#endif
+        log_break();
+    }
 
-    for (WireId wire : ctx->getWires()) {
-        for (BelPin belpin : ctx->getWireBelPins(wire)) {
-            WireId wire2 = ctx->getBelPinWire(belpin.bel, belpin.pin);
-            log_assert(wire == wire2);
-        }
+    void check_locs()
+    {
+        log_info("Checking location data.\n");
 
-        for (PipId pip : ctx->getPipsDownhill(wire)) {
-            WireId wire2 = ctx->getPipSrcWire(pip);
-            log_assert(wire == wire2);
-        }
+        // Some arches build their location lookup on first use, so make sure that has happened before going parallel
+        ctx->getBelByLocation(Loc(0, 0, 0));
 
-        for (PipId pip : ctx->getPipsUphill(wire)) {
-            WireId wire2 = ctx->getPipDstWire(pip);
-            log_assert(wire == wire2);
-        }
-    }
+        log_info("Checking all bels..\n");
+        run_sharded(int(bels.size()), [&](int begin, int end, Failures &failures) {
+            for (int i = begin; i < end; i++) {
+                BelId bel = bels.at(i);
+                const char *name = ctx->nameOfBel(bel);
+                archcheck_assert(bel != BelId(), name);
+                dbg("> %s\n", name);
 
-    log_info("Checking all BELs...\n");
-    for (BelId bel : ctx->getBels()) {
-        for (IdString pin : ctx->getBelPins(bel)) {
-            WireId wire = ctx->getBelPinWire(bel, pin);
+                Loc loc = ctx->getBelLocation(bel);
+                dbg("   ... %d %d %d\n", loc.x, loc.y, loc.z);
+
+                archcheck_assert(0 <= loc.x, name);
+                archcheck_assert(0 <= loc.y, name);
+                archcheck_assert(0 <= loc.z, name);
+                archcheck_assert(loc.x < ctx->getGridDimX(), name);
+                archcheck_assert(loc.y < ctx->getGridDimY(), name);
+                if (loc.x < 0 || loc.y < 0 || loc.x >= ctx->getGridDimX() || loc.y >= ctx->getGridDimY())
+                    continue;
+                archcheck_assert(loc.z < ctx->getTileBelDimZ(loc.x, loc.y), name);
 
-            if (wire == WireId()) {
-                continue;
+                BelId bel2 = ctx->getBelByLocation(loc);
+                dbg("   ... %s\n", ctx->nameOfBel(bel2));
+                archcheck_assert(bel == bel2, name);
             }
+        });
+
+        log_info("Checking all locations..\n");
+        run_sharded(int(tiles.size()), [&](int begin, int end, Failures &failures) {
+            for (int i = begin; i < end; i++) {
+                int x = tiles.at(i).x, y = tiles.at(i).y;
+                dbg("> %d %d\n", x, y);
+                std::string tile = stringf("tile %d %d", x, y);
+                std::unordered_set<int> usedz;
+
+                for (int z = 0; z < ctx->getTileBelDimZ(x, y); z++) {
+                    BelId bel = ctx->getBelByLocation(Loc(x, y, z));
+                    if (bel == BelId())
+                        continue;
+                    Loc loc = ctx->getBelLocation(bel);
+                    dbg("   + %d %s\n", z, ctx->nameOfBel(bel));
+                    archcheck_assert(x == loc.x, tile.c_str());
+                    archcheck_assert(y == loc.y, tile.c_str());
+                    archcheck_assert(z == loc.z, tile.c_str());
+                    usedz.insert(z);
+                }
 
-            bool found_belpin = false;
-            for (BelPin belpin : ctx->getWireBelPins(wire)) {
-                if (belpin.bel == bel && belpin.pin == pin) {
-                    found_belpin = true;
-                    break;
+                for (BelId bel : ctx->getBelsByTile(x, y)) {
+                    Loc loc = ctx->getBelLocation(bel);
+                    dbg("   - %d %s\n", loc.z, ctx->nameOfBel(bel));
+                    archcheck_assert(x == loc.x, tile.c_str());
+                    archcheck_assert(y == loc.y, tile.c_str());
+                    archcheck_assert(usedz.count(loc.z), tile.c_str());
+                    usedz.erase(loc.z);
                 }
+
+                archcheck_assert(usedz.empty(), tile.c_str());
             }
+        });
 
-            log_assert(found_belpin);
-        }
+        log_break();
     }
 
-    log_info("Checking all PIPs...\n");
-    for (PipId pip : ctx->getPips()) {
-        WireId src_wire = ctx->getPipSrcWire(pip);
-        if (src_wire != WireId()) {
-            bool found_pip = false;
-            for (PipId downhill_pip : ctx->getPipsDownhill(src_wire)) {
-                if (pip == downhill_pip) {
-                    found_pip = true;
-                    break;
+    void check_conn()
+    {
+        log_info("Checking connectivity data.\n");
+
+        log_info("Checking all wires...\n");
+        run_sharded(int(wires.size()), [&](int begin, int end, Failures &failures) {
+            for (int i = begin; i < end; i++) {
+                WireId wire = wires.at(i);
+                const char *name = ctx->nameOfWire(wire);
+                for (BelPin belpin : ctx->getWireBelPins(wire)) {
+                    WireId wire2 = ctx->getBelPinWire(belpin.bel, belpin.pin);
+                    archcheck_assert(wire == wire2, name);
                 }
-            }
 
-            log_assert(found_pip);
-        }
+                for (PipId pip : ctx->getPipsDownhill(wire)) {
+                    WireId wire2 = ctx->getPipSrcWire(pip);
+                    archcheck_assert(wire == wire2, name);
+                }
 
-        WireId dst_wire = ctx->getPipDstWire(pip);
-        if (dst_wire != WireId()) {
-            bool found_pip = false;
-            for (PipId uphill_pip : ctx->getPipsUphill(dst_wire)) {
-                if (pip == uphill_pip) {
-                    found_pip = true;
-                    break;
+                for (PipId pip : ctx->getPipsUphill(wire)) {
+                    WireId wire2 = ctx->getPipDstWire(pip);
+                    archcheck_assert(wire == wire2, name);
+                }
+            }
+        });
+
+        log_info("Checking all BELs...\n");
+        run_sharded(int(bels.size()), [&](int begin, int end, Failures &failures) {
+            for (int i = begin; i < end; i++) {
+                BelId bel = bels.at(i);
+                for (IdString pin : ctx->getBelPins(bel)) {
+                    WireId wire = ctx->getBelPinWire(bel, pin);
+
+                    if (wire == WireId()) {
+                        continue;
+                    }
+
+                    bool found_belpin = false;
+                    for (BelPin belpin : ctx->getWireBelPins(wire)) {
+                        if (belpin.bel == bel && belpin.pin == pin) {
+                            found_belpin = true;
+                            break;
+                        }
+                    }
+
+                    archcheck_assert(found_belpin, ctx->nameOfBel(bel));
                 }
             }
+        });
+
+        log_info("Checking all PIPs...\n");
+        run_sharded(int(pips.size()), [&](int begin, int end, Failures &failures) {
+            for (int i = begin; i < end; i++) {
+                PipId pip = pips.at(i);
+                WireId src_wire = ctx->getPipSrcWire(pip);
+                if (src_wire != WireId()) {
+                    bool found_pip = false;
+                    for (PipId downhill_pip : ctx->getPipsDownhill(src_wire)) {
+                        if (pip == downhill_pip) {
+                            found_pip = true;
+                            break;
+                        }
+                    }
+
+                    archcheck_assert(found_pip, ctx->nameOfPip(pip));
+                }
 
-            log_assert(found_pip);
-        }
+                WireId dst_wire = ctx->getPipDstWire(pip);
+                if (dst_wire != WireId()) {
+                    bool found_pip = false;
+                    for (PipId uphill_pip : ctx->getPipsUphill(dst_wire)) {
+                        if (pip == uphill_pip) {
+                            found_pip = true;
+                            break;
+                        }
+                    }
+
+                    archcheck_assert(found_pip, ctx->nameOfPip(pip));
+                }
+            }
+        });
     }
-}
+};
 
 } // namespace
 
@@ -204,9 +338,10 @@ void Context::archcheck() const
     log_info("Running architecture database integrity check.\n");
     log_break();
 
-    archcheck_names(this);
-    archcheck_locs(this);
-    archcheck_conn(this);
+    ArchChecker checker(this);
+    checker.check_names();
+    checker.check_locs();
+    checker.check_conn();
 }
 
 NEXTPNR_NAMESPACE_END
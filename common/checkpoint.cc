@@ -0,0 +1,900 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+#include "design_utils.h"
+#include "log.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+
+// File layout, all in 32-bit words of native byte order:
+//   header: magic (2 words), version, byte order mark, string count, string bytes, body words
+//   string table: string count + 1 byte offsets into the string bytes, then the string bytes padded to a word
+//   body: the design, see CheckpointWriter::write_design
+const char checkpoint_magic[8] = {'N', 'P', 'N', 'R', 'C', 'K', 'P', 'T'};
+const uint32_t checkpoint_version = 1;
+const uint32_t byte_order_mark = 0x01020304;
+const size_t header_words = 7;
+
+// In place of a string index, for a missing name (unplaced cell, disconnected port, wire without a driving pip...)
+const uint32_t no_string = 0xFFFFFFFF;
+
+struct CheckpointWriter
+{
+    Context *ctx;
+    // The ROUTING attribute of nets duplicates the routing, it is recreated on load instead
+    IdString routing_attr;
+
+    std::vector<uint32_t> body;
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> string_index;
+    std::unordered_map<IdString, uint32_t> id_index;
+
+    CheckpointWriter(Context *ctx) : ctx(ctx), routing_attr(ctx->id("ROUTING")) {}
+
+    uint32_t str(const std::string &s)
+    {
+        auto found = string_index.find(s);
+        if (found != string_index.end())
+            return found->second;
+        uint32_t index = uint32_t(strings.size());
+        strings.push_back(s);
+        string_index.emplace(s, index);
+        return index;
+    }
+
+    uint32_t id(IdString name)
+    {
+        auto found = id_index.find(name);
+        if (found != id_index.end())
+            return found->second;
+        uint32_t index = str(name.str(ctx));
+        id_index.emplace(name, index);
+        return index;
+    }
+
+    void word(uint32_t value) { body.push_back(value); }
+    void name(IdString value) { word(id(value)); }
+    void cell_name(const CellInfo *cell) { word(cell == nullptr ? no_string : id(cell->name)); }
+    void net_name(const NetInfo *net) { word(net == nullptr ? no_string : id(net->name)); }
+
+    void delay(delay_t value)
+    {
+        float ns = ctx->getDelayNS(value);
+        uint32_t bits;
+        memcpy(&bits, &ns, sizeof(bits));
+        word(bits);
+    }
+
+    void property(const Property &value)
+    {
+        word(value.is_string ? 1 : 0);
+        word(str(value.is_string ? value.str : value.bit_str()));
+    }
+
+    template <typename T> void properties(const T &map, IdString skip = IdString())
+    {
+        uint32_t count = 0;
+        for (auto &item : map)
+            if (item.first != skip)
+                count++;
+        word(count);
+        for (auto &item : map) {
+            if (item.first == skip)
+                continue;
+            name(item.first);
+            property(item.second);
+        }
+    }
+
+    template <typename T> void id_map(const T &map)
+    {
+        word(uint32_t(map.size()));
+        for (auto &item : map) {
+            name(item.first);
+            name(item.second);
+        }
+    }
+
+    void ports(const PortInfoMap &map)
+    {
+        word(uint32_t(map.size()));
+        for (auto &port : map) {
+            name(port.first);
+            word(port.second.type);
+            net_name(port.second.net);
+        }
+    }
+
+    void write_design()
+    {
+        word(str(ctx->getChipName()));
+        properties(ctx->settings);
+        properties(ctx->attrs);
+
+        word(uint32_t(ctx->region.size()));
+        for (auto &item : ctx->region) {
+            const Region *region = item.second.get();
+            name(region->name);
+            word(region->constr_bels);
+            word(region->constr_wires);
+            word(region->constr_pips);
+            word(uint32_t(region->bels.size()));
+            region->bels.for_each([&](Loc loc) { name(ctx->getBelName(ctx->getBelByLocation(loc))); });
+            word(uint32_t(region->wires.size()));
+            for (WireId wire : region->wires)
+                name(ctx->getWireName(wire));
+            word(uint32_t(region->piplocs.size()));
+            for (Loc loc : region->piplocs) {
+                word(uint32_t(loc.x));
+                word(uint32_t(loc.y));
+                word(uint32_t(loc.z));
+            }
+        }
+
+        // Nets and cells are created first, the connections between them and placement constraints follow
+        word(uint32_t(ctx->nets.size()));
+        for (auto &item : ctx->nets) {
+            const NetInfo *ni = item.second.get();
+            name(ni->name);
+            name(ni->hierpath);
+            properties(ni->attrs, routing_attr);
+            word(uint32_t(ni->aliases.size()));
+            for (IdString alias : ni->aliases)
+                name(alias);
+            word(ni->region == nullptr ? no_string : id(ni->region->name));
+            word(ni->clkconstr != nullptr);
+            if (ni->clkconstr != nullptr) {
+                delay(ni->clkconstr->high.maxDelay());
+                delay(ni->clkconstr->low.maxDelay());
+                delay(ni->clkconstr->period.maxDelay());
+            }
+        }
+
+        word(uint32_t(ctx->cells.size()));
+        for (auto &item : ctx->cells) {
+            const CellInfo *ci = item.second.get();
+            name(ci->name);
+            name(ci->type);
+            name(ci->hierpath);
+            properties(ci->attrs);
+            properties(ci->params);
+            ports(ci->ports);
+            id_map(ci->pins);
+            word(ci->bel == BelId() ? no_string : id(ctx->getBelName(ci->bel)));
+            word(ci->belStrength);
+            word(uint32_t(ci->constr_x));
+            word(uint32_t(ci->constr_y));
+            word(uint32_t(ci->constr_z));
+            word(ci->constr_abs_z);
+            word(ci->region == nullptr ? no_string : id(ci->region->name));
+        }
+
+        ports(ctx->ports);
+
+        for (auto &item : ctx->nets) {
+            const NetInfo *ni = item.second.get();
+            cell_name(ni->driver.cell);
+            name(ni->driver.port);
+            word(uint32_t(ni->users.size()));
+            for (auto &user : ni->users) {
+                cell_name(user.cell);
+                name(user.port);
+            }
+            word(uint32_t(ni->wires.size()));
+            for (auto &wire : ni->wires) {
+                name(ctx->getWireName(wire.first));
+                word(wire.second.pip == PipId() ? no_string : id(ctx->getPipName(wire.second.pip)));
+                word(wire.second.strength);
+            }
+        }
+
+        for (auto &item : ctx->cells) {
+            const CellInfo *ci = item.second.get();
+            cell_name(ci->constr_parent);
+            word(uint32_t(ci->constr_children.size()));
+            for (const CellInfo *child : ci->constr_children)
+                cell_name(child);
+        }
+
+        id_map(ctx->net_aliases);
+
+        name(ctx->top_module);
+        word(uint32_t(ctx->hierarchy.size()));
+        for (auto &item : ctx->hierarchy) {
+            const HierarchicalCell &hc = item.second;
+            name(item.first);
+            name(hc.name);
+            name(hc.type);
+            name(hc.parent);
+            name(hc.fullpath);
+            id_map(hc.leaf_cells);
+            id_map(hc.nets);
+            id_map(hc.hier_cells);
+            word(uint32_t(hc.ports.size()));
+            for (auto &port : hc.ports) {
+                const HierarchicalPort &hp = port.second;
+                name(hp.name);
+                word(hp.dir);
+                word(uint32_t(hp.nets.size()));
+                for (IdString net : hp.nets)
+                    name(net);
+                word(uint32_t(hp.offset));
+                word(hp.upto);
+            }
+        }
+    }
+
+    void write(std::ostream &out)
+    {
+        std::vector<uint32_t> offsets;
+        offsets.reserve(strings.size() + 1);
+        uint32_t bytes = 0;
+        for (auto &s : strings) {
+            offsets.push_back(bytes);
+            bytes += uint32_t(s.size());
+        }
+        offsets.push_back(bytes);
+
+        uint32_t header[header_words];
+        memcpy(header, checkpoint_magic, sizeof(checkpoint_magic));
+        header[2] = checkpoint_version;
+        header[3] = byte_order_mark;
+        header[4] = uint32_t(strings.size());
+        header[5] = bytes;
+        header[6] = uint32_t(body.size());
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint32_t));
+        for (auto &s : strings)
+            out.write(s.data(), s.size());
+        static const char padding[4] = {0, 0, 0, 0};
+        out.write(padding, (4 - bytes % 4) % 4);
+        out.write(reinterpret_cast<const char *>(body.data()), body.size() * sizeof(uint32_t));
+    }
+};
+
+struct CheckpointReader
+{
+    Context *ctx;
+    const std::string &filename;
+
+    // The whole file, which is read in one go and then parsed in place
+    std::vector<uint32_t> data;
+    const uint32_t *offsets = nullptr;
+    const char *string_bytes = nullptr;
+    uint32_t string_count = 0;
+    const uint32_t *body = nullptr;
+    size_t body_words = 0, pos = 0;
+    // IdString index of each string, or -1 if not yet looked up
+    std::vector<int> ids;
+
+    CheckpointReader(Context *ctx, const std::string &filename) : ctx(ctx), filename(filename) {}
+
+    void read_file(std::istream &in)
+    {
+        in.seekg(0, std::ios::end);
+        std::streamoff size = in.tellg();
+        in.seekg(0, std::ios::beg);
+        if (!in || size < std::streamoff(header_words * sizeof(uint32_t)) || size % sizeof(uint32_t) != 0)
+            log_error("'%s' is not a nextpnr checkpoint.\n", filename.c_str());
+        data.resize(size_t(size) / sizeof(uint32_t));
+        if (!in.read(reinterpret_cast<char *>(data.data()), size))
+            log_error("Failed to read checkpoint '%s'.\n", filename.c_str());
+
+        if (memcmp(data.data(), checkpoint_magic, sizeof(checkpoint_magic)) != 0)
+            log_error("'%s' is not a nextpnr checkpoint.\n", filename.c_str());
+        if (data[2] != checkpoint_version)
+            log_error("Checkpoint '%s' has unsupported version %u.\n", filename.c_str(), unsigned(data[2]));
+        if (data[3] != byte_order_mark)
+            log_error("Checkpoint '%s' was written on a machine with a different byte order.\n", filename.c_str());
+        string_count = data[4];
+        size_t string_words = (size_t(data[5]) + 3) / 4;
+        body_words = data[6];
+        if (data.size() != header_words + string_count + 1 + string_words + body_words)
+            log_error("Checkpoint '%s' is truncated.\n", filename.c_str());
+        offsets = data.data() + header_words;
+        string_bytes = reinterpret_cast<const char *>(offsets + string_count + 1);
+        body = offsets + string_count + 1 + string_words;
+        if (offsets[string_count] != data[5])
+            log_error("Checkpoint '%s' is corrupt.\n", filename.c_str());
+        ids.assign(string_count, -1);
+    }
+
+    uint32_t word()
+    {
+        if (pos >= body_words)
+            log_error("Checkpoint '%s' is truncated.\n", filename.c_str());
+        return body[pos++];
+    }
+
+    std::string str(uint32_t index)
+    {
+        if (index >= string_count || offsets[index] > offsets[index + 1])
+            log_error("Checkpoint '%s' is corrupt.\n", filename.c_str());
+        return std::string(string_bytes + offsets[index], offsets[index + 1] - offsets[index]);
+    }
+
+    IdString id(uint32_t index)
+    {
+        if (index >= string_count)
+            log_error("Checkpoint '%s' is corrupt.\n", filename.c_str());
+        if (ids[index] == -1)
+            ids[index] = ctx->id(str(index)).index;
+        return IdString(ids[index]);
+    }
+
+    IdString name() { return id(word()); }
+
+    CellInfo *cell_name()
+    {
+        uint32_t index = word();
+        if (index == no_string)
+            return nullptr;
+        auto found = ctx->cells.find(id(index));
+        if (found == ctx->cells.end())
+            log_error("Checkpoint '%s' refers to unknown cell '%s'.\n", filename.c_str(), str(index).c_str());
+        return found->second.get();
+    }
+
+    NetInfo *net_name()
+    {
+        uint32_t index = word();
+        if (index == no_string)
+            return nullptr;
+        auto found = ctx->nets.find(id(index));
+        if (found == ctx->nets.end())
+            log_error("Checkpoint '%s' refers to unknown net '%s'.\n", filename.c_str(), str(index).c_str());
+        return found->second.get();
+    }
+
+    Region *region_name()
+    {
+        uint32_t index = word();
+        if (index == no_string)
+            return nullptr;
+        auto found = ctx->region.find(id(index));
+        if (found == ctx->region.end())
+            log_error("Checkpoint '%s' refers to unknown region '%s'.\n", filename.c_str(), str(index).c_str());
+        return found->second.get();
+    }
+
+    BelId bel_name(uint32_t index)
+    {
+        BelId bel = ctx->getBelByName(id(index));
+        if (bel == BelId())
+            log_error("Bel '%s' in checkpoint '%s' does not exist.\n", str(index).c_str(), filename.c_str());
+        return bel;
+    }
+
+    WireId wire_name(uint32_t index)
+    {
+        WireId wire = ctx->getWireByName(id(index));
+        if (wire == WireId())
+            log_error("Wire '%s' in checkpoint '%s' does not exist.\n", str(index).c_str(), filename.c_str());
+        return wire;
+    }
+
+    PipId pip_name(uint32_t index)
+    {
+        PipId pip = ctx->getPipByName(id(index));
+        if (pip == PipId())
+            log_error("Pip '%s' in checkpoint '%s' does not exist.\n", str(index).c_str(), filename.c_str());
+        return pip;
+    }
+
+    DelayInfo delay()
+    {
+        uint32_t bits = word();
+        float ns;
+        memcpy(&ns, &bits, sizeof(ns));
+        return ctx->getDelayFromNS(ns);
+    }
+
+    Property property()
+    {
+        bool is_string = word() != 0;
+        std::string value = str(word());
+        if (is_string)
+            return Property(value);
+        Property bits;
+        for (char c : value)
+            bits.push_back(Property::State(c));
+        bits.update_intval();
+        return bits;
+    }
+
+    template <typename T> void properties(T &map)
+    {
+        uint32_t count = word();
+        for (uint32_t i = 0; i < count; i++) {
+            IdString key = name();
+            map[key] = property();
+        }
+    }
+
+    template <typename T> void id_map(T &map)
+    {
+        uint32_t count = word();
+        for (uint32_t i = 0; i < count; i++) {
+            IdString key = name();
+            IdString value = name();
+            map[key] = value;
+        }
+    }
+
+    void ports(PortInfoMap &map)
+    {
+        uint32_t count = word();
+        for (uint32_t i = 0; i < count; i++) {
+            PortInfo port;
+            port.name = name();
+            port.type = PortType(word());
+            port.net = net_name();
+            port.user_idx = 0;
+            map[port.name] = port;
+        }
+    }
+
+    void read_design()
+    {
+        std::string chip = str(word());
+        if (chip != ctx->getChipName())
+            log_error("Checkpoint '%s' is for chip '%s', not '%s'.\n", filename.c_str(), chip.c_str(),
+                      ctx->getChipName().c_str());
+        if (!ctx->cells.empty() || !ctx->nets.empty())
+            log_error("Checkpoint '%s' can only be loaded into an empty design.\n", filename.c_str());
+        properties(ctx->settings);
+        properties(ctx->attrs);
+
+        uint32_t region_count = word();
+        for (uint32_t i = 0; i < region_count; i++) {
+            std::unique_ptr<Region> region(new Region());
+            region->name = name();
+            region->constr_bels = word() != 0;
+            region->constr_wires = word() != 0;
+            region->constr_pips = word() != 0;
+            uint32_t count = word();
+            for (uint32_t j = 0; j < count; j++)
+                region->bels.insert(ctx->getBelLocation(bel_name(word())));
+            count = word();
+            for (uint32_t j = 0; j < count; j++)
+                region->wires.insert(wire_name(word()));
+            count = word();
+            for (uint32_t j = 0; j < count; j++) {
+                Loc loc;
+                loc.x = int(word());
+                loc.y = int(word());
+                loc.z = int(word());
+                region->piplocs.insert(loc);
+            }
+            IdString region_name = region->name;
+            ctx->region[region_name] = std::move(region);
+        }
+
+        std::vector<NetInfo *> nets(word());
+        for (auto &ni : nets) {
+            ni = ctx->createNet(name());
+            ni->hierpath = name();
+            properties(ni->attrs);
+            uint32_t count = word();
+            for (uint32_t j = 0; j < count; j++)
+                ni->aliases.push_back(name());
+            ni->region = region_name();
+            if (word() != 0) {
+                std::unique_ptr<ClockConstraint> constr(new ClockConstraint());
+                constr->high = delay();
+                constr->low = delay();
+                constr->period = delay();
+                ni->clkconstr = std::move(constr);
+            }
+        }
+
+        std::vector<CellInfo *> cells(word());
+        for (auto &ci : cells) {
+            IdString cell_name = name();
+            IdString cell_type = name();
+            ci = ctx->createCell(cell_name, cell_type);
+            ci->hierpath = name();
+            properties(ci->attrs);
+            properties(ci->params);
+            ports(ci->ports);
+            id_map(ci->pins);
+            uint32_t bel = word();
+            PlaceStrength strength = PlaceStrength(word());
+            if (bel != no_string)
+                ctx->bindBel(bel_name(bel), ci, strength);
+            ci->constr_x = int(word());
+            ci->constr_y = int(word());
+            ci->constr_z = int(word());
+            ci->constr_abs_z = word() != 0;
+            ci->region = region_name();
+        }
+
+        ports(ctx->ports);
+
+        for (NetInfo *ni : nets) {
+            ni->driver.cell = cell_name();
+            ni->driver.port = name();
+            ni->users.resize(word());
+            for (size_t j = 0; j < ni->users.size(); j++) {
+                auto &user = ni->users.at(j);
+                user.cell = cell_name();
+                user.port = name();
+                auto port = user.cell->ports.find(user.port);
+                if (port != user.cell->ports.end())
+                    port->second.user_idx = j;
+            }
+            uint32_t count = word();
+            for (uint32_t j = 0; j < count; j++) {
+                uint32_t wire = word();
+                uint32_t pip = word();
+                PlaceStrength strength = PlaceStrength(word());
+                if (pip != no_string)
+                    ctx->bindPip(pip_name(pip), ni, strength);
+                else
+                    ctx->bindWire(wire_name(wire), ni, strength);
+            }
+        }
+
+        for (CellInfo *ci : cells) {
+            ci->constr_parent = cell_name();
+            ci->constr_children.resize(word());
+            for (auto &child : ci->constr_children)
+                child = cell_name();
+        }
+
+        id_map(ctx->net_aliases);
+
+        ctx->top_module = name();
+        uint32_t hier_count = word();
+        for (uint32_t i = 0; i < hier_count; i++) {
+            HierarchicalCell &hc = ctx->hierarchy[name()];
+            hc.name = name();
+            hc.type = name();
+            hc.parent = name();
+            hc.fullpath = name();
+            id_map(hc.leaf_cells);
+            id_map(hc.nets);
+            id_map(hc.hier_cells);
+            uint32_t port_count = word();
+            for (uint32_t j = 0; j < port_count; j++) {
+                HierarchicalPort port;
+                port.name = name();
+                port.dir = PortType(word());
+                port.nets.resize(word());
+                for (auto &net : port.nets)
+                    net = name();
+                port.offset = int(word());
+                port.upto = word() != 0;
+                hc.ports[port.name] = port;
+            }
+        }
+
+        if (pos != body_words)
+            log_error("Checkpoint '%s' is corrupt.\n", filename.c_str());
+
+        ctx->assignArchInfo();
+        ctx->archInfoToAttributes();
+    }
+
+    void skip(size_t words)
+    {
+        if (body_words - pos < words)
+            log_error("Checkpoint '%s' is truncated.\n", filename.c_str());
+        pos += words;
+    }
+
+    void skip_properties() { skip(3 * size_t(word())); }
+    void skip_id_map() { skip(2 * size_t(word())); }
+    void skip_ports() { skip(3 * size_t(word())); }
+
+    // Whether a hierarchical path is one of the partitions, or inside one of them
+    static bool in_partition(const std::string &path, const std::vector<std::string> &partitions)
+    {
+        for (auto &part : partitions)
+            if (path.compare(0, part.size(), part) == 0 && (path.size() == part.size() || path[part.size()] == '/'))
+                return true;
+        return false;
+    }
+
+    // Skip from the start of the body to the cells, returning the name of each net
+    std::vector<uint32_t> skip_to_cells()
+    {
+        std::string chip = str(word());
+        if (chip != ctx->getChipName())
+            log_error("Checkpoint '%s' is for chip '%s', not '%s'.\n", filename.c_str(), chip.c_str(),
+                      ctx->getChipName().c_str());
+        skip_properties();
+        skip_properties();
+
+        uint32_t region_count = word();
+        for (uint32_t i = 0; i < region_count; i++) {
+            skip(4);
+            skip(word());
+            skip(word());
+            skip(3 * size_t(word()));
+        }
+
+        std::vector<uint32_t> net_names(word());
+        for (auto &net : net_names) {
+            net = word();
+            skip(1);
+            skip_properties();
+            skip(word());
+            skip(1);
+            if (word() != 0)
+                skip(3);
+        }
+        return net_names;
+    }
+
+    void skip_cells()
+    {
+        uint32_t cell_count = word();
+        for (uint32_t i = 0; i < cell_count; i++) {
+            skip(3);
+            skip_properties();
+            skip_properties();
+            skip_ports();
+            skip_id_map();
+            skip(7);
+        }
+    }
+
+    // Read the connections and routing of the next net, returning its routing. Wires and pips that no longer exist
+    // become a null wire, so that the routing can't be bound
+    std::vector<std::pair<WireId, PipId>> net_routing()
+    {
+        skip(2);
+        skip(2 * size_t(word()));
+        std::vector<std::pair<WireId, PipId>> routing(word());
+        for (auto &entry : routing) {
+            entry.first = ctx->getWireByName(id(word()));
+            uint32_t pip = word();
+            if (pip != no_string) {
+                entry.second = ctx->getPipByName(id(pip));
+                if (entry.second == PipId())
+                    entry.first = WireId();
+            }
+            skip(1);
+        }
+        return routing;
+    }
+
+    // Read the routing of each net, by net name
+    void read_routing(std::unordered_map<IdString, std::vector<std::pair<WireId, PipId>>> &routing)
+    {
+        std::vector<uint32_t> net_names = skip_to_cells();
+        skip_cells();
+        skip_ports();
+        for (uint32_t net_name : net_names) {
+            auto net = net_routing();
+            if (!net.empty())
+                routing[id(net_name)] = std::move(net);
+        }
+    }
+
+    // Read the bel of each placed cell, by cell name
+    void read_placement(std::unordered_map<IdString, BelId> &placement)
+    {
+        skip_to_cells();
+        uint32_t cell_count = word();
+        for (uint32_t i = 0; i < cell_count; i++) {
+            IdString cell_name = name();
+            skip(2);
+            skip_properties();
+            skip_properties();
+            skip_ports();
+            skip_id_map();
+            uint32_t bel_index = word();
+            skip(6);
+            BelId bel = (bel_index == no_string) ? BelId() : ctx->getBelByName(id(bel_index));
+            if (bel != BelId())
+                placement[cell_name] = bel;
+        }
+    }
+
+    // Bind the placement of the cells of the partitions, and the routing of the nets that connect only those cells,
+    // from a checkpoint of an earlier run, to the current packed design. Cells are matched by name and type, nets by
+    // name; anything that no longer matches, or would conflict with what is already bound, is left for the placer and
+    // router. Everything that is bound is locked, so that it survives placement and routing unchanged.
+    void reuse_partitions(const std::vector<std::string> &partitions)
+    {
+        for (auto &part : partitions)
+            if (!ctx->hierarchy.count(ctx->id(part)))
+                log_error("Partition '%s' is not a hierarchical instance of the design.\n", part.c_str());
+        std::vector<uint32_t> net_names = skip_to_cells();
+
+        std::unordered_set<const CellInfo *> locked_cells;
+        int partition_cells = 0;
+        uint32_t cell_count = word();
+        for (uint32_t i = 0; i < cell_count; i++) {
+            uint32_t cell_name = word();
+            uint32_t cell_type = word();
+            uint32_t hierpath = word();
+            skip_properties();
+            skip_properties();
+            skip_ports();
+            skip_id_map();
+            uint32_t bel_index = word();
+            skip(6);
+            if (bel_index == no_string || !in_partition(str(hierpath), partitions))
+                continue;
+            partition_cells++;
+            auto found = ctx->cells.find(id(cell_name));
+            if (found == ctx->cells.end())
+                continue;
+            CellInfo *ci = found->second.get();
+            BelId bel = ctx->getBelByName(id(bel_index));
+            if (ci->type != id(cell_type) || ci->bel != BelId() || bel == BelId() || !ctx->checkBelAvail(bel) ||
+                !ctx->isValidBelForCell(ci, bel))
+                continue;
+            ctx->bindBel(bel, ci, STRENGTH_LOCKED);
+            if (!ctx->isBelLocationValid(bel)) {
+                ctx->unbindBel(bel);
+                continue;
+            }
+            locked_cells.insert(ci);
+        }
+
+        skip_ports();
+
+        int locked_nets = 0, partition_nets = 0;
+        for (uint32_t net_name : net_names) {
+            auto routing = net_routing();
+            auto found = ctx->nets.find(id(net_name));
+            if (found == ctx->nets.end())
+                continue;
+            NetInfo *ni = found->second.get();
+            if (ni->driver.cell == nullptr || !locked_cells.count(ni->driver.cell) || ni->users.empty())
+                continue;
+            bool internal = true;
+            for (auto &user : ni->users)
+                internal = internal && user.cell != nullptr && locked_cells.count(user.cell);
+            if (!internal)
+                continue;
+            partition_nets++;
+            if (bind_net_routing(ctx, ni, routing, STRENGTH_LOCKED))
+                locked_nets++;
+        }
+
+        log_info("Reused the placement of %d/%d cells and the routing of %d/%d nets of %d partition(s) from "
+                 "checkpoint '%s'.\n",
+                 int(locked_cells.size()), partition_cells, locked_nets, partition_nets, int(partitions.size()),
+                 filename.c_str());
+    }
+};
+
+} // namespace
+
+bool write_checkpoint(std::ostream &out, const std::string &filename, Context *ctx)
+{
+    try {
+        if (!out)
+            log_error("Failed to open checkpoint '%s' for writing.\n", filename.c_str());
+        CheckpointWriter writer(ctx);
+        writer.write_design();
+        writer.write(out);
+        if (!out)
+            log_error("Failed to write checkpoint '%s'.\n", filename.c_str());
+        return true;
+    } catch (log_execution_error_exception) {
+        return false;
+    }
+}
+
+bool load_checkpoint(std::istream &in, const std::string &filename, Context *ctx)
+{
+    try {
+        if (!in)
+            log_error("Failed to open checkpoint '%s'.\n", filename.c_str());
+        CheckpointReader reader(ctx, filename);
+        reader.read_file(in);
+        reader.read_design();
+        log_info("Loaded checkpoint '%s' with %d cells and %d nets.\n", filename.c_str(), int(ctx->cells.size()),
+                 int(ctx->nets.size()));
+        return true;
+    } catch (log_execution_error_exception) {
+        return false;
+    }
+}
+
+bool is_checkpoint(std::istream &in)
+{
+    char magic[sizeof(checkpoint_magic)];
+    std::streampos start = in.tellg();
+    bool result = bool(in.read(magic, sizeof(magic))) && memcmp(magic, checkpoint_magic, sizeof(magic)) == 0;
+    in.clear();
+    in.seekg(start);
+    return result;
+}
+
+bool read_checkpoint_placement(std::istream &in, const std::string &filename, Context *ctx,
+                               std::unordered_map<IdString, BelId> &placement)
+{
+    try {
+        if (!in)
+            log_error("Failed to open checkpoint '%s'.\n", filename.c_str());
+        CheckpointReader reader(ctx, filename);
+        reader.read_file(in);
+        reader.read_placement(placement);
+        return true;
+    } catch (log_execution_error_exception) {
+        return false;
+    }
+}
+
+bool read_checkpoint_routing(std::istream &in, const std::string &filename, Context *ctx,
+                             std::unordered_map<IdString, std::vector<std::pair<WireId, PipId>>> &routing)
+{
+    try {
+        if (!in)
+            log_error("Failed to open checkpoint '%s'.\n", filename.c_str());
+        CheckpointReader reader(ctx, filename);
+        reader.read_file(in);
+        reader.read_routing(routing);
+        return true;
+    } catch (log_execution_error_exception) {
+        return false;
+    }
+}
+
+bool reuse_checkpoint_partitions(std::istream &in, const std::string &filename, Context *ctx,
+                                 const std::vector<std::string> &partitions)
+{
+    try {
+        if (!in)
+            log_error("Failed to open checkpoint '%s'.\n", filename.c_str());
+        CheckpointReader reader(ctx, filename);
+        reader.read_file(in);
+        reader.reuse_partitions(partitions);
+        return true;
+    } catch (log_execution_error_exception) {
+        return false;
+    }
+}
+
+void Context::autosave(bool force)
+{
+    if (autosave_file.empty())
+        return;
+    auto now = std::chrono::steady_clock::now();
+    if (!force && std::chrono::duration<double>(now - last_autosave).count() < autosave_interval)
+        return;
+    // Write to a temporary file first, so that a crash while writing leaves the previous checkpoint intact
+    std::string temp_file = autosave_file + ".tmp";
+    bool written;
+    {
+        std::ofstream f(temp_file, std::ios::binary);
+        written = write_checkpoint(f, temp_file, this) && f.flush();
+    }
+    if (!written || std::rename(temp_file.c_str(), autosave_file.c_str()) != 0)
+        log_warning("Failed to save checkpoint '%s'.\n", autosave_file.c_str());
+    else if (verbose)
+        log_info("Saved checkpoint '%s'.\n", autosave_file.c_str());
+    last_autosave = std::chrono::steady_clock::now();
+}
+
+NEXTPNR_NAMESPACE_END
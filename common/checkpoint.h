@@ -0,0 +1,53 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Binary checkpoints of the whole design state (netlist, settings, constraints, placement and routing), for resuming
+// a flow between stages much faster than through JSON. A checkpoint is a header, a string table and a stream of
+// 32-bit words referring to it; it is tied to the chip it was written for, but not to the nextpnr build, as bels,
+// wires and pips are stored by name.
+bool write_checkpoint(std::ostream &out, const std::string &filename, Context *ctx);
+// The context must not contain a design yet
+bool load_checkpoint(std::istream &in, const std::string &filename, Context *ctx);
+// Whether a stream, which is left at its current position, holds a checkpoint
+bool is_checkpoint(std::istream &in);
+// Read just the bel of each placed cell, by cell name; bels that do not exist are left out
+bool read_checkpoint_placement(std::istream &in, const std::string &filename, Context *ctx,
+                               std::unordered_map<IdString, BelId> &placement);
+// Read just the routing of each routed net, by net name, as (wire, pip) entries; see bind_net_routing
+bool read_checkpoint_routing(std::istream &in, const std::string &filename, Context *ctx,
+                             std::unordered_map<IdString, std::vector<std::pair<WireId, PipId>>> &routing);
+// Lock the placement and routing of hierarchical instances (given by full path, e.g. "top/cpu") from a checkpoint
+// of an earlier run of the same design into the current, packed design, so that only the rest is placed and routed
+bool reuse_checkpoint_partitions(std::istream &in, const std::string &filename, Context *ctx,
+                                 const std::vector<std::string> &partitions);
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -31,16 +31,37 @@
 #include <boost/algorithm/string/join.hpp>
 #include <boost/filesystem/convenience.hpp>
 #include <boost/program_options.hpp>
+#include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include "checkpoint.h"
 #include "command.h"
+#include "congestion.h"
 #include "design_utils.h"
 #include "json_frontend.h"
 #include "jsonwrite.h"
 #include "log.h"
+#include "profiler.h"
+#include "router_select.h"
 #include "timing.h"
 #include "util.h"
 #include "version.h"
+#include "worker_pool.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -48,7 +69,9 @@ CommandHandler::CommandHandler(int argc, char **argv) : argc(argc), argv(argv) {
 
 bool CommandHandler::parseOptions()
 {
-    options.add(getGeneralOptions()).add(getArchOptions());
+    // Server jobs are parsed again with the same options
+    if (options.options().empty())
+        options.add(getGeneralOptions()).add(getArchOptions());
     try {
         po::parsed_options parsed =
                 po::command_line_parser(argc, argv)
@@ -80,6 +103,7 @@ bool CommandHandler::executeBeforeContext()
         return true;
     }
     validate();
+    conflicting_options(vm, "json", "load-checkpoint");
 
     if (vm.count("quiet")) {
         log_streams.push_back(std::make_pair(&std::cerr, LogLevel::WARNING_MSG));
@@ -122,8 +146,44 @@ po::options_description CommandHandler::getGeneralOptions()
 
 #endif
     general.add_options()("json", po::value<std::string>(), "JSON design file to ingest");
+    general.add_options()("threads", po::value<int>(),
+                          "number of threads for every parallel stage, unless set for a stage with its own option "
+                          "(default: each stage's own default, limited to the available cores)");
     general.add_options()("write", po::value<std::string>(), "JSON design file to write");
+    general.add_options()("write-threads", po::value<int>(), "number of threads to serialise the JSON design with");
+    general.add_options()("write-routing", po::value<std::string>(),
+                          "how to write the ROUTING attribute of nets to the JSON design: keep (default), compact "
+                          "(leave out wire names implied by pips) or omit");
+    general.add_options()("load-checkpoint", po::value<std::string>(),
+                          "binary design checkpoint to load instead of a JSON design, resuming after its last stage");
+    general.add_options()("write-checkpoint", po::value<std::string>(), "binary design checkpoint to write");
+    general.add_options()("reuse-checkpoint", po::value<std::string>(),
+                          "checkpoint of an earlier run to take the placement and routing of --reuse-partition from");
+    general.add_options()("reuse-partition", po::value<std::vector<std::string>>(),
+                          "hierarchical instance (full path, e.g. top/cpu) whose placement and routing to lock from "
+                          "--reuse-checkpoint; may be given more than once");
+    general.add_options()("autosave", po::value<std::string>(),
+                          "checkpoint to save after each stage and periodically during placement and routing");
+    general.add_options()("autosave-interval", po::value<double>(),
+                          "minimum time between periodic checkpoints in seconds (default 600)");
+    general.add_options()("resume", "resume from the --autosave checkpoint if it exists, e.g. after a crash");
+    general.add_options()("guide-placement", po::value<std::string>(),
+                          "JSON design or checkpoint of an earlier run whose placement to start placing from");
+    general.add_options()("guide-routing", po::value<std::string>(),
+                          "JSON design or checkpoint of an earlier run whose routing to keep for nets that still "
+                          "connect the same wires");
     general.add_options()("top", po::value<std::string>(), "name of top module");
+    general.add_options()("frontend-threads", po::value<int>(),
+                          "number of threads to read leaf cells of the netlist with");
+    general.add_options()("pack-threads", po::value<int>(),
+                          "number of threads for the parallel parts of packing, where the architecture has them");
+    general.add_options()("bitstream-threads", po::value<int>(),
+                          "number of threads for the parallel parts of bitstream generation, where the architecture "
+                          "has them (default: all cores)");
+    general.add_options()("checksum-threads", po::value<int>(),
+                          "number of threads to compute the design checksum with (default: all cores)");
+    general.add_options()("check-threads", po::value<int>(),
+                          "number of threads to verify the routed design with (default: all cores)");
     general.add_options()("seed", po::value<int>(), "seed value for random number generator");
     general.add_options()("randomize-seed,r", "randomize seed value for random number generator");
 
@@ -136,33 +196,127 @@ po::options_description CommandHandler::getGeneralOptions()
     general.add_options()(
             "router", po::value<std::string>(),
             std::string("router algorithm to use; available: " + boost::algorithm::join(Arch::availableRouters, ", ") +
-                        "; default: " + Arch::defaultRouter)
+                        ", auto (pick router and threads from the placed design); default: " + Arch::defaultRouter)
                     .c_str());
 
+    general.add_options()("router1-threads", po::value<int>(),
+                          "number of threads router1 searches batches of disjoint arcs with");
+    general.add_options()("router1-time-budget", po::value<float>(),
+                          "wall clock time in seconds after which router1 stops, keeping the best routing found");
+    general.add_options()("router1-timeout-router2", "finish routing with router2 if router1 runs out of time");
+    general.add_options()("route-graph", "flatten the routing graph once, for faster routing at some memory cost");
+    general.add_options()("route-graph-cache", po::value<std::string>(),
+                          "directory to cache flattened routing graphs in (implies --route-graph)");
+    general.add_options()("router2-threads", po::value<int>(),
+                          "number of regions router2 partitions the device into for parallel routing");
+    general.add_options()("router2-regions", po::value<int>(),
+                          "number of leaf regions router2 partitions the device into, regardless of thread count");
+    general.add_options()("check-determinism",
+                          "route twice with router2 using different thread counts and fail if the results differ");
+    general.add_options()("router2-incremental", "keep existing legal routing and only route changed arcs in router2");
+    general.add_options()("router2-lookahead", "use a precomputed delay table as the router2 A* heuristic");
+    general.add_options()("router2-lookahead-cache", po::value<std::string>(),
+                          "directory to cache router2 lookahead tables in (implies --router2-lookahead)");
+    general.add_options()("router2-hfn-split", po::value<int>(),
+                          "minimum fanout of nets that router2 splits into trunks to clusters of sinks");
+    general.add_options()("router2-stats", po::value<std::string>(),
+                          "write per-iteration router2 congestion and runtime statistics to a CSV or JSON file");
+    general.add_options()("router2-incremental-timing",
+                          "update router2 criticalities every iteration from the timing of rerouted arcs");
+    general.add_options()("router2-crit-weight", po::value<float>(),
+                          "how much router2 favours delay over congestion for critical arcs (0 to 1)");
+
     general.add_options()("slack_redist_iter", po::value<int>(), "number of iterations between slack redistribution");
     general.add_options()("cstrweight", po::value<float>(), "placer weighting for relative constraint satisfaction");
     general.add_options()("starttemp", po::value<float>(), "placer SA start temperature");
     general.add_options()("placer-budgets", "use budget rather than criticality in placer timing weights");
+    general.add_options()("placer-congestion-weight", po::value<float>(),
+                          "placer weighting for moving cells out of areas estimated to be congested");
+    general.add_options()("congestion-report", "report an estimate of routing congestion after placement");
+    general.add_options()("placer1-threads", po::value<int>(),
+                          "number of threads for placer1 refinement after analytic placement");
+    general.add_options()("placer1-time-budget", po::value<float>(),
+                          "scale the placer1 annealing schedule to finish within this many seconds");
+    general.add_options()("placer1-incremental-timing",
+                          "only update the timing of nets of moved cells between placer1 temperatures");
+    general.add_options()("placer-heap-solver", po::value<std::string>(),
+                          "preconditioner for the HeAP equation solver (none, jacobi or ichol)");
+    general.add_options()("placer-heap-solver-threads", po::value<int>(),
+                          "number of threads for each HeAP equation solve (needs a build with USE_OPENMP)");
+    general.add_options()("placer-heap-spread-threads", po::value<int>(),
+                          "number of threads for HeAP cell spreading");
+    general.add_options()("placer-heap-legalise-threads", po::value<int>(),
+                          "number of threads for HeAP strict legalisation");
+    general.add_options()("placer-heap-star-fanout", po::value<int>(),
+                          "use a star net model in HeAP for nets with at least this many users");
+    general.add_options()("placer-heap-sample-fanout", po::value<int>(),
+                          "only use a sample of this many users in HeAP for nets with more users");
+    general.add_options()("placer-heap-compare-net-models",
+                          "report the wirelength and runtime of each HeAP net model before placing");
+    general.add_options()("placer-heap-convergence", po::value<float>(),
+                          "stop HeAP once the solved wirelength is above this fraction of the legal wirelength");
+    general.add_options()("placer-heap-stall-iters", po::value<int>(),
+                          "stop HeAP after this many iterations without improvement");
+    general.add_options()("placer-heap-min-improvement", po::value<float>(),
+                          "fractional improvement in wirelength for a HeAP iteration not to count as stalled");
+    general.add_options()("placer-heap-time-budget", po::value<float>(),
+                          "stop the HeAP analytical placer after this many seconds");
+    general.add_options()("placer-heap-cluster-cells", po::value<int>(),
+                          "first place clusters of connected cells in HeAP for designs with at least this many cells");
+    general.add_options()("placer-heap-cluster-size", po::value<int>(),
+                          "maximum number of cells in each HeAP cluster");
+    general.add_options()("placer-heap-incremental-timing", po::value<int>()->implicit_value(0),
+                          "use incremental timing analysis in HeAP, ignoring cells that moved less than the given "
+                          "distance");
 
     general.add_options()("pack-only", "pack design only without placement or routing");
     general.add_options()("no-route", "process design without routing");
     general.add_options()("no-place", "process design without placement");
     general.add_options()("no-pack", "process design without packing");
+    general.add_options()("no-preflight", "skip the resource and constraint checks run after loading the design");
 
     general.add_options()("ignore-loops", "ignore combinational loops in timing analysis");
+    general.add_options()("timing-threads", po::value<int>(),
+                          "number of threads for propagating arrival times in timing analysis");
 
     general.add_options()("version,V", "show version");
     general.add_options()("test", "check architecture database integrity");
+    general.add_options()("test-threads", po::value<int>(),
+                          "number of threads to check the architecture database with (default: all cores)");
+    general.add_options()("test-sample", po::value<int>(),
+                          "only check a random sample of N bels, wires, pips and tiles of the architecture database");
+    general.add_options()("bench-arch", "time the architecture API calls used by the placers and routers");
+    general.add_options()("bench-samples", po::value<int>(),
+                          "number of random objects to time each architecture API call over (default: 100000)");
     general.add_options()("freq", po::value<double>(), "set target frequency for design in MHz");
     general.add_options()("timing-allow-fail", "allow timing to fail in design");
+    general.add_options()("timing-fast-corner", "also report fmax and slack at the fast (minimum delay) corner");
+    general.add_options()("report-paths", po::value<int>(), "report the N worst paths of each clock domain pair");
     general.add_options()("no-tmdriv", "disable timing-driven placement");
+    general.add_options()("set", po::value<std::vector<std::string>>(),
+                          "set a named setting, such as a placer or router parameter, as NAME=VALUE (e.g. "
+                          "router2/bbMargin=5); may be given more than once, and overrides a loaded checkpoint");
+    general.add_options()("parallel-seeds", po::value<int>(),
+                          "pack once, then place and route with N seeds in parallel and keep the best result");
+    general.add_options()("server", po::value<std::string>(),
+                          "load the device, then run jobs sent with --client to the given socket, each in a fork");
+    general.add_options()("client", po::value<std::string>(),
+                          "run with the other options as a job of the --server listening on the given socket");
     general.add_options()("sdf", po::value<std::string>(), "SDF delay back-annotation file to write");
+    general.add_options()("report", po::value<std::string>(),
+                          "JSON file to write with fmax, slack histogram, critical paths, runtimes and utilisation");
+    general.add_options()("profile", po::value<std::string>(),
+                          "time the phases of the run, print a summary and write a Chrome trace JSON file");
     general.add_options()("sdf-cvc", "enable tweaks for SDF file compatibility with the CVC simulator");
+    general.add_options()("sdf-threads", po::value<int>(),
+                          "number of threads to generate the SDF file with (default: all cores)");
     general.add_options()("no-print-critical-path-source",
                           "disable printing of the line numbers associated with each net in the critical path");
 
-    general.add_options()("placed-svg", po::value<std::string>(), "write render of placement to SVG file");
-    general.add_options()("routed-svg", po::value<std::string>(), "write render of routing to SVG file");
+    general.add_options()("placed-svg", po::value<std::string>(),
+                          "write render of placement to SVG file (compressed if named .svgz)");
+    general.add_options()("routed-svg", po::value<std::string>(),
+                          "write render of the routing used by the design to SVG file (compressed if named .svgz)");
 
     return general;
 }
@@ -179,6 +333,8 @@ void CommandHandler::setupContext(Context *ctx)
     if (vm.count("debug")) {
         ctx->verbose = true;
         ctx->debug = true;
+        // Debug output is heavy enough to slow down placement and routing if written as it is logged
+        log_set_async(true);
     }
 
     if (vm.count("no-print-critical-path-source")) {
@@ -217,10 +373,50 @@ void CommandHandler::setupContext(Context *ctx)
         ctx->settings[ctx->id("timing/ignoreLoops")] = true;
     }
 
+    if (vm.count("threads")) {
+        int threads = vm["threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of threads must be at least 1\n");
+        ctx->settings[ctx->id("threads")] = threads;
+    }
+
+    if (vm.count("timing-threads")) {
+        int threads = vm["timing-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of timing threads must be at least 1\n");
+        ctx->settings[ctx->id("timing/threads")] = threads;
+    }
+
     if (vm.count("timing-allow-fail")) {
         ctx->settings[ctx->id("timing/allowFail")] = true;
     }
 
+    if (vm.count("timing-fast-corner")) {
+        ctx->settings[ctx->id("timing/fastCorner")] = true;
+    }
+
+    if (vm.count("report-paths")) {
+        int paths = vm["report-paths"].as<int>();
+        if (paths < 0)
+            log_error("Number of paths to report must not be negative\n");
+        ctx->settings[ctx->id("timing/reportPaths")] = paths;
+    }
+
+#ifdef _WIN32
+    if (vm.count("server") || vm.count("client"))
+        log_error("Server mode is not supported on this platform\n");
+#endif
+
+    if (vm.count("parallel-seeds")) {
+        int seeds = vm["parallel-seeds"].as<int>();
+        if (seeds < 1)
+            log_error("Number of parallel seeds must be at least 1\n");
+#ifdef _WIN32
+        if (seeds > 1)
+            log_error("Parallel seeds are not supported on this platform\n");
+#endif
+    }
+
     if (vm.count("placer")) {
         std::string placer = vm["placer"].as<std::string>();
         if (std::find(Arch::availablePlacers.begin(), Arch::availablePlacers.end(), placer) ==
@@ -232,11 +428,160 @@ void CommandHandler::setupContext(Context *ctx)
 
     if (vm.count("router")) {
         std::string router = vm["router"].as<std::string>();
-        if (std::find(Arch::availableRouters.begin(), Arch::availableRouters.end(), router) ==
-            Arch::availableRouters.end())
-            log_error("Router algorithm '%s' is not supported (available options: %s)\n", router.c_str(),
+        if (router == "auto")
+            ctx->settings[ctx->id("router/auto")] = true;
+        else if (std::find(Arch::availableRouters.begin(), Arch::availableRouters.end(), router) ==
+                 Arch::availableRouters.end())
+            log_error("Router algorithm '%s' is not supported (available options: %s, auto)\n", router.c_str(),
                       boost::algorithm::join(Arch::availableRouters, ", ").c_str());
-        ctx->settings[ctx->id("router")] = router;
+        else
+            ctx->settings[ctx->id("router")] = router;
+    }
+
+    if (vm.count("frontend-threads")) {
+        int threads = vm["frontend-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of frontend threads must be at least 1\n");
+        ctx->settings[ctx->id("frontend/threads")] = threads;
+    }
+
+    if (vm.count("test-threads")) {
+        int threads = vm["test-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of test threads must be at least 1\n");
+        ctx->settings[ctx->id("archcheck/threads")] = threads;
+    }
+
+    if (vm.count("test-sample")) {
+        int sample = vm["test-sample"].as<int>();
+        if (sample < 1)
+            log_error("Test sample size must be at least 1\n");
+        ctx->settings[ctx->id("archcheck/sample")] = sample;
+    }
+
+    if (vm.count("bench-samples")) {
+        int samples = vm["bench-samples"].as<int>();
+        if (samples < 1)
+            log_error("Benchmark sample size must be at least 1\n");
+        ctx->settings[ctx->id("archbench/samples")] = samples;
+    }
+
+    if (vm.count("pack-threads")) {
+        int threads = vm["pack-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of pack threads must be at least 1\n");
+        ctx->settings[ctx->id("pack/threads")] = threads;
+    }
+
+    if (vm.count("bitstream-threads")) {
+        int threads = vm["bitstream-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of bitstream threads must be at least 1\n");
+        ctx->settings[ctx->id("bitstream/threads")] = threads;
+    }
+
+    if (vm.count("checksum-threads")) {
+        int threads = vm["checksum-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of checksum threads must be at least 1\n");
+        ctx->settings[ctx->id("checksum/threads")] = threads;
+    }
+
+    if (vm.count("check-threads")) {
+        int threads = vm["check-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of routing check threads must be at least 1\n");
+        ctx->settings[ctx->id("check/threads")] = threads;
+    }
+
+    if (vm.count("write-threads")) {
+        int threads = vm["write-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of JSON write threads must be at least 1\n");
+        ctx->settings[ctx->id("jsonwrite/threads")] = threads;
+    }
+
+    if (vm.count("sdf-threads")) {
+        int threads = vm["sdf-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of SDF write threads must be at least 1\n");
+        ctx->settings[ctx->id("sdf/threads")] = threads;
+    }
+
+    if (vm.count("write-routing")) {
+        std::string mode = vm["write-routing"].as<std::string>();
+        if (mode != "keep" && mode != "compact" && mode != "omit")
+            log_error("ROUTING attribute mode '%s' is not supported (available options: keep, compact, omit)\n",
+                      mode.c_str());
+        ctx->settings[ctx->id("jsonwrite/routing")] = mode;
+    }
+
+    if (vm.count("router1-threads")) {
+        int threads = vm["router1-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of router1 threads must be at least 1\n");
+        ctx->settings[ctx->id("router1/threads")] = threads;
+    }
+
+    if (vm.count("router1-time-budget")) {
+        float budget = vm["router1-time-budget"].as<float>();
+        if (budget <= 0)
+            log_error("Router1 time budget must be positive\n");
+        ctx->settings[ctx->id("router1/timeBudget")] = std::to_string(budget);
+    }
+
+    if (vm.count("router1-timeout-router2"))
+        ctx->settings[ctx->id("router1/timeoutRouter2")] = true;
+
+    if (vm.count("route-graph") || vm.count("route-graph-cache")) {
+        ctx->settings[ctx->id("router1/routeGraph")] = true;
+        ctx->settings[ctx->id("router2/routeGraph")] = true;
+    }
+
+    if (vm.count("route-graph-cache"))
+        ctx->settings[ctx->id("routeGraph/cacheDir")] = vm["route-graph-cache"].as<std::string>();
+
+    if (vm.count("router2-threads")) {
+        int threads = vm["router2-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of router2 threads must be at least 1\n");
+        ctx->settings[ctx->id("router2/threads")] = threads;
+    }
+
+    if (vm.count("router2-regions")) {
+        int regions = vm["router2-regions"].as<int>();
+        if (regions < 1)
+            log_error("Number of router2 regions must be at least 1\n");
+        ctx->settings[ctx->id("router2/regions")] = regions;
+    }
+
+    if (vm.count("check-determinism"))
+        ctx->settings[ctx->id("router2/checkDeterminism")] = true;
+
+    if (vm.count("router2-incremental"))
+        ctx->settings[ctx->id("router2/incremental")] = true;
+
+    if (vm.count("router2-lookahead"))
+        ctx->settings[ctx->id("router2/lookahead")] = true;
+
+    if (vm.count("router2-lookahead-cache")) {
+        ctx->settings[ctx->id("router2/lookahead")] = true;
+        ctx->settings[ctx->id("router2/lookaheadCache")] = vm["router2-lookahead-cache"].as<std::string>();
+    }
+
+    if (vm.count("router2-hfn-split"))
+        ctx->settings[ctx->id("router2/hfnSplitFanout")] = vm["router2-hfn-split"].as<int>();
+
+    if (vm.count("router2-stats"))
+        ctx->settings[ctx->id("router2/statsFile")] = vm["router2-stats"].as<std::string>();
+
+    if (vm.count("router2-incremental-timing"))
+        ctx->settings[ctx->id("router2/incrementalTiming")] = true;
+    if (vm.count("router2-crit-weight")) {
+        float weight = vm["router2-crit-weight"].as<float>();
+        if (weight < 0 || weight > 1)
+            log_error("router2 criticality weight must be between 0 and 1\n");
+        ctx->settings[ctx->id("router2/critWeight")] = std::to_string(weight);
     }
 
     if (vm.count("cstrweight")) {
@@ -249,6 +594,102 @@ void CommandHandler::setupContext(Context *ctx)
     if (vm.count("placer-budgets")) {
         ctx->settings[ctx->id("placer1/budgetBased")] = true;
     }
+    if (vm.count("placer-congestion-weight")) {
+        std::string weight = std::to_string(vm["placer-congestion-weight"].as<float>());
+        ctx->settings[ctx->id("placer1/congestionWeight")] = weight;
+        ctx->settings[ctx->id("placerHeap/congestionWeight")] = weight;
+    }
+    if (vm.count("placer1-threads")) {
+        int threads = vm["placer1-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of placer1 threads must be at least 1\n");
+        ctx->settings[ctx->id("placer1/threads")] = threads;
+    }
+    if (vm.count("placer1-time-budget")) {
+        float budget = vm["placer1-time-budget"].as<float>();
+        if (budget <= 0)
+            log_error("placer1 time budget must be positive\n");
+        ctx->settings[ctx->id("placer1/timeBudget")] = std::to_string(budget);
+    }
+    if (vm.count("placer1-incremental-timing"))
+        ctx->settings[ctx->id("placer1/incrementalTiming")] = true;
+    if (vm.count("placer-heap-solver"))
+        ctx->settings[ctx->id("placerHeap/solverPreconditioner")] = vm["placer-heap-solver"].as<std::string>();
+    if (vm.count("placer-heap-solver-threads")) {
+        int threads = vm["placer-heap-solver-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of HeAP solver threads must be at least 1\n");
+        ctx->settings[ctx->id("placerHeap/solverThreads")] = threads;
+    }
+    if (vm.count("placer-heap-spread-threads")) {
+        int threads = vm["placer-heap-spread-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of HeAP spreading threads must be at least 1\n");
+        ctx->settings[ctx->id("placerHeap/spreadThreads")] = threads;
+    }
+    if (vm.count("placer-heap-legalise-threads")) {
+        int threads = vm["placer-heap-legalise-threads"].as<int>();
+        if (threads < 1)
+            log_error("Number of HeAP legalisation threads must be at least 1\n");
+        ctx->settings[ctx->id("placerHeap/legaliseThreads")] = threads;
+    }
+    if (vm.count("placer-heap-star-fanout")) {
+        int fanout = vm["placer-heap-star-fanout"].as<int>();
+        if (fanout < 2)
+            log_error("HeAP star model fanout must be at least 2\n");
+        ctx->settings[ctx->id("placerHeap/starFanout")] = fanout;
+    }
+    if (vm.count("placer-heap-sample-fanout")) {
+        int fanout = vm["placer-heap-sample-fanout"].as<int>();
+        if (fanout < 1)
+            log_error("HeAP net sample fanout must be at least 1\n");
+        ctx->settings[ctx->id("placerHeap/netSampleFanout")] = fanout;
+    }
+    if (vm.count("placer-heap-compare-net-models"))
+        ctx->settings[ctx->id("placerHeap/compareNetModels")] = true;
+    if (vm.count("placer-heap-convergence")) {
+        float ratio = vm["placer-heap-convergence"].as<float>();
+        if (ratio <= 0 || ratio > 1)
+            log_error("HeAP convergence ratio must be between 0 and 1\n");
+        ctx->settings[ctx->id("placerHeap/convergenceRatio")] = std::to_string(ratio);
+    }
+    if (vm.count("placer-heap-stall-iters")) {
+        int iters = vm["placer-heap-stall-iters"].as<int>();
+        if (iters < 1)
+            log_error("HeAP stall iterations must be at least 1\n");
+        ctx->settings[ctx->id("placerHeap/maxStalledIters")] = iters;
+    }
+    if (vm.count("placer-heap-min-improvement")) {
+        float improvement = vm["placer-heap-min-improvement"].as<float>();
+        if (improvement < 0 || improvement >= 1)
+            log_error("HeAP minimum improvement must be between 0 and 1\n");
+        ctx->settings[ctx->id("placerHeap/minImprovement")] = std::to_string(improvement);
+    }
+    if (vm.count("placer-heap-time-budget")) {
+        float budget = vm["placer-heap-time-budget"].as<float>();
+        if (budget <= 0)
+            log_error("HeAP time budget must be positive\n");
+        ctx->settings[ctx->id("placerHeap/timeBudget")] = std::to_string(budget);
+    }
+    if (vm.count("placer-heap-cluster-cells")) {
+        int cells = vm["placer-heap-cluster-cells"].as<int>();
+        if (cells < 1)
+            log_error("HeAP clustering cell count must be at least 1\n");
+        ctx->settings[ctx->id("placerHeap/clusterMinCells")] = cells;
+    }
+    if (vm.count("placer-heap-cluster-size")) {
+        int size = vm["placer-heap-cluster-size"].as<int>();
+        if (size < 1)
+            log_error("HeAP cluster size must be at least 1\n");
+        ctx->settings[ctx->id("placerHeap/clusterSize")] = size;
+    }
+    if (vm.count("placer-heap-incremental-timing")) {
+        int threshold = vm["placer-heap-incremental-timing"].as<int>();
+        if (threshold < 0)
+            log_error("HeAP timing move threshold must not be negative\n");
+        ctx->settings[ctx->id("placerHeap/incrementalTiming")] = true;
+        ctx->settings[ctx->id("placerHeap/timingMoveThreshold")] = threshold;
+    }
     if (vm.count("freq")) {
         auto freq = vm["freq"].as<double>();
         if (freq > 0)
@@ -258,6 +699,8 @@ void CommandHandler::setupContext(Context *ctx)
     if (vm.count("no-tmdriv"))
         ctx->settings[ctx->id("timing_driven")] = false;
 
+    apply_set_options(ctx);
+
     // Setting default values
     if (ctx->settings.find(ctx->id("target_freq")) == ctx->settings.end())
         ctx->settings[ctx->id("target_freq")] = std::to_string(12e6);
@@ -277,13 +720,247 @@ void CommandHandler::setupContext(Context *ctx)
     ctx->settings[ctx->id("seed")] = ctx->rngstate;
 }
 
+namespace {
+
+template <typename T> int64_t dict_memory(const IdStringDict<T> &dict)
+{
+    return int64_t(dict.size()) * sizeof(std::pair<IdString, T>);
+}
+
+int64_t property_memory(const IdStringDict<Property> &dict)
+{
+    int64_t bytes = dict_memory(dict);
+    for (auto &entry : dict)
+        bytes += memory_of(entry.second.planes) + int64_t(entry.second.str.capacity());
+    return bytes;
+}
+
+// Estimate the memory held by the netlist and the ID string database, from the sizes of their containers; hash maps
+// are counted as their entries plus a node and a bucket pointer per entry
+void track_design_memory(const Context *ctx)
+{
+    const int64_t node_overhead = 3 * sizeof(void *);
+    int64_t netlist = 0;
+    for (auto &cell : ctx->cells) {
+        const CellInfo *ci = cell.second.get();
+        netlist += sizeof(CellInfo) + node_overhead + int64_t(ci->ports.size()) * (sizeof(PortInfo) + node_overhead);
+        netlist += property_memory(ci->attrs) + property_memory(ci->params) + dict_memory(ci->pins);
+        netlist += memory_of(ci->constr_children);
+    }
+    for (auto &net : ctx->nets) {
+        const NetInfo *ni = net.second.get();
+        netlist += sizeof(NetInfo) + node_overhead + memory_of(ni->users) + property_memory(ni->attrs);
+        netlist += int64_t(ni->wires.size()) * sizeof(std::pair<WireId, PipMap>);
+        netlist += int64_t(ni->wire_delays.size()) * sizeof(std::pair<WireId, std::pair<delay_t, delay_t>>);
+    }
+    memory_track("netlist", netlist);
+
+    int64_t idstrings = 0;
+    for (int i = 0; i < ctx->idstring_db->size(); i++)
+        idstrings += 2 * sizeof(std::string) + int64_t(ctx->idstring_db->str(i).capacity()) + 2 * node_overhead;
+    memory_track("idstrings", idstrings);
+}
+
+// Continue from a checkpoint saved in the middle of placement or routing. A partial placement can't be continued
+// directly, as the placers would treat placed cells as fixed, so it becomes the placement guide instead. Partial
+// routing is kept, as for a routing guide
+void resume_partial_stage(Context *ctx, bool placing)
+{
+    if (placing) {
+        int guided = 0;
+        for (auto &cell : ctx->cells) {
+            CellInfo *ci = cell.second.get();
+            if (ci->bel == BelId() || ci->belStrength > STRENGTH_STRONG)
+                continue;
+            ctx->placement_guide[ci->name] = ci->bel;
+            ctx->unbindBel(ci->bel);
+            ci->attrs.erase(ctx->id("NEXTPNR_BEL"));
+            ci->attrs.erase(ctx->id("BEL_STRENGTH"));
+            guided++;
+        }
+        if (guided > 0)
+            log_info("Resuming placement of %d cells from their placement in the checkpoint.\n", guided);
+    } else {
+        bool routed = false;
+        for (auto &net : ctx->nets)
+            routed = routed || !net.second->wires.empty();
+        if (routed && !ctx->settings.count(ctx->id("router2/incremental")))
+            ctx->settings[ctx->id("router2/incremental")] = true;
+    }
+}
+
+// Bind the routing of an earlier run to the nets that still connect the same source and sink wires, where it is still
+// free; the routers keep it (router2 in incremental mode) and only route the other nets
+void apply_routing_guide(Context *ctx, const std::string &filename)
+{
+    std::unordered_map<IdString, std::vector<std::pair<WireId, PipId>>> routing;
+    std::ifstream f(filename, std::ios::binary);
+    bool loaded = is_checkpoint(f) ? read_checkpoint_routing(f, filename, ctx, routing)
+                                   : read_json_routing(f, filename, ctx, routing);
+    if (!loaded)
+        log_error("Loading routing guide failed.\n");
+    int bound = 0;
+    for (auto &net : ctx->nets) {
+        auto found = routing.find(net.first);
+        if (found != routing.end() && bind_net_routing(ctx, net.second.get(), found->second, STRENGTH_WEAK))
+            bound++;
+    }
+    log_info("Reused the routing of %d/%d nets from routing guide '%s'.\n", bound, int(ctx->nets.size()),
+             filename.c_str());
+    if (bound > 0 && !ctx->settings.count(ctx->id("router2/incremental")))
+        ctx->settings[ctx->id("router2/incremental")] = true;
+}
+
+} // namespace
+
+#ifndef _WIN32
+namespace {
+
+// State of a forked process placing and routing with one of the parallel seeds
+struct SeedWorker
+{
+    int seed = 0;
+    pid_t pid = -1;
+    // Parent side: read the score from result_fd, write whether to keep the result to verdict_fd. Worker side: the
+    // other ends of the same pipes
+    int result_fd = -1, verdict_fd = -1;
+    // Worker side: the log is buffered until the worker knows if its result is kept
+    std::vector<std::pair<std::ostream *, LogLevel>> saved_streams;
+    std::vector<std::unique_ptr<std::ostringstream>> log_buffers;
+};
+
+// The worst ratio of achieved to constrained frequency over all clocks, or 0 if there was no timing analysis
+double seed_score(const Context *ctx)
+{
+    const auto &result = ctx->timing_result;
+    if (!result.valid || result.clock_fmax.empty())
+        return 0;
+    double score = std::numeric_limits<double>::max();
+    for (auto &clock : result.clock_fmax) {
+        double achieved = clock.second.first, target = clock.second.second;
+        score = std::min(score, target > 0 ? achieved / target : achieved);
+    }
+    return score;
+}
+
+// Fork one worker per seed from the packed design. In the parent this waits for every worker to report its score,
+// lets the best one write the outputs, and returns true with that worker's exit status. In each worker it returns
+// false, with the worker's seed set and its log buffered; the worker must call finish_seed_worker after routing.
+bool fork_seed_workers(Context *ctx, int count, int base_seed, SeedWorker &self, int &exit_status)
+{
+    log_info("Placing and routing with %d seeds in parallel...\n", count);
+    // The log writer thread would not survive the fork, and workers redirect the log streams
+    log_set_async(false);
+    std::vector<SeedWorker> workers;
+    for (int i = 0; i < count; i++) {
+        int result_pipe[2], verdict_pipe[2];
+        if (pipe(result_pipe) != 0 || pipe(verdict_pipe) != 0)
+            log_error("Failed to create pipes for seed %d\n", base_seed + i);
+        for (auto &stream : log_streams)
+            stream.first->flush();
+        pid_t pid = fork();
+        if (pid < 0)
+            log_error("Failed to fork process for seed %d\n", base_seed + i);
+        if (pid == 0) {
+            for (auto &other : workers) {
+                close(other.result_fd);
+                close(other.verdict_fd);
+            }
+            close(result_pipe[0]);
+            close(verdict_pipe[1]);
+            self.seed = base_seed + i;
+            self.result_fd = result_pipe[1];
+            self.verdict_fd = verdict_pipe[0];
+            self.saved_streams = log_streams;
+            for (auto &stream : log_streams) {
+                self.log_buffers.emplace_back(new std::ostringstream());
+                stream.first = self.log_buffers.back().get();
+            }
+            ctx->rngseed(self.seed);
+            ctx->settings[ctx->id("seed")] = ctx->rngstate;
+            return false;
+        }
+        close(result_pipe[1]);
+        close(verdict_pipe[0]);
+        workers.emplace_back();
+        workers.back().seed = base_seed + i;
+        workers.back().pid = pid;
+        workers.back().result_fd = result_pipe[0];
+        workers.back().verdict_fd = verdict_pipe[1];
+    }
+
+    int best = -1;
+    double best_score = 0;
+    for (int i = 0; i < count; i++) {
+        double score;
+        if (read(workers.at(i).result_fd, &score, sizeof(score)) != sizeof(score)) {
+            log_info("    seed %d failed\n", workers.at(i).seed);
+            continue;
+        }
+        log_info("    seed %d: worst clock at %.1f%% of its target frequency\n", workers.at(i).seed, 100 * score);
+        if (best == -1 || score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    if (best != -1)
+        log_info("Keeping the result of seed %d.\n", workers.at(best).seed);
+    for (int i = 0; i < count; i++) {
+        char verdict = (i == best);
+        if (write(workers.at(i).verdict_fd, &verdict, 1) != 1 && i == best)
+            log_error("Failed to signal the process for seed %d\n", workers.at(i).seed);
+        close(workers.at(i).verdict_fd);
+        close(workers.at(i).result_fd);
+    }
+    for (auto &stream : log_streams)
+        stream.first->flush();
+    exit_status = 1;
+    for (int i = 0; i < count; i++) {
+        int status = 0;
+        waitpid(workers.at(i).pid, &status, 0);
+        if (i == best)
+            exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    }
+    if (best == -1)
+        log_error("Placement and routing failed with every seed\n");
+    return true;
+}
+
+// Report the score of a worker to the parent. Returns, with the worker's log replayed, only if its result is kept
+void finish_seed_worker(Context *ctx, SeedWorker &self)
+{
+    double score = seed_score(ctx);
+    char verdict = 0;
+    if (write(self.result_fd, &score, sizeof(score)) != sizeof(score) || read(self.verdict_fd, &verdict, 1) != 1 ||
+        !verdict)
+        _exit(0);
+    close(self.result_fd);
+    close(self.verdict_fd);
+    log_streams = self.saved_streams;
+    for (size_t i = 0; i < log_streams.size(); i++)
+        *log_streams.at(i).first << self.log_buffers.at(i)->str();
+    self.log_buffers.clear();
+}
+
+} // namespace
+#endif
+
 int CommandHandler::executeMain(std::unique_ptr<Context> ctx)
 {
+    std::vector<std::pair<std::string, double>> stage_runtimes;
+    // Writers of the output files, run together once the flow is done
+    std::vector<std::function<void()>> outputs;
+
     if (vm.count("test")) {
         ctx->archcheck();
         return 0;
     }
 
+    if (vm.count("bench-arch")) {
+        ctx->archbench();
+        return 0;
+    }
+
     if (vm.count("top")) {
         ctx->settings[ctx->id("frontend/top")] = vm["top"].as<std::string>();
     }
@@ -311,13 +988,52 @@ int CommandHandler::executeMain(std::unique_ptr<Context> ctx)
         return a.exec();
     }
 #endif
-    if (vm.count("json")) {
+    // With --resume, the autosave checkpoint is loaded in place of the design if it exists
+    std::string checkpoint_file;
+    if (vm.count("load-checkpoint"))
+        checkpoint_file = vm["load-checkpoint"].as<std::string>();
+    if (vm.count("resume")) {
+        if (!vm.count("autosave"))
+            log_error("--resume needs an --autosave checkpoint to resume from.\n");
+        std::string filename = vm["autosave"].as<std::string>();
+        if (std::ifstream(filename).good())
+            checkpoint_file = filename;
+        else
+            log_info("No checkpoint '%s' to resume from, starting from the beginning.\n", filename.c_str());
+    }
+    if (vm.count("autosave")) {
+        ctx->autosave_file = vm["autosave"].as<std::string>();
+        if (vm.count("autosave-interval"))
+            ctx->autosave_interval = vm["autosave-interval"].as<double>();
+    }
+
+    if (vm.count("json") && checkpoint_file.empty()) {
         std::string filename = vm["json"].as<std::string>();
         std::ifstream f(filename);
+        NPNR_PROFILE_ZONE("load design");
         if (!parse_json(f, filename, ctx.get()))
             log_error("Loading design failed.\n");
 
         customAfterLoad(ctx.get());
+
+        PreflightCfg preflight;
+        if (!vm.count("no-preflight") && preflightConfig(ctx.get(), preflight) &&
+            !preflight_check(ctx.get(), preflight)) {
+            if (!ctx->force)
+                log_error("Pre-flight checks failed (override this error with --force).\n");
+            log_warning("Pre-flight checks failed, carrying on because of --force.\n");
+        }
+    }
+
+    if (!checkpoint_file.empty()) {
+        std::string filename = checkpoint_file;
+        std::ifstream f(filename, std::ios::binary);
+        if (!load_checkpoint(f, filename, ctx.get()))
+            log_error("Loading checkpoint failed.\n");
+        // The checkpoint brings the settings it was written with
+        apply_set_options(ctx.get());
+
+        customAfterLoad(ctx.get());
     }
 
 #ifndef NO_PYTHON
@@ -331,56 +1047,189 @@ int CommandHandler::executeMain(std::unique_ptr<Context> ctx)
             execute_python_file(filename.c_str());
     } else
 #endif
-            if (vm.count("json")) {
+            if (vm.count("json") || !checkpoint_file.empty()) {
         bool do_pack = vm.count("pack-only") != 0 || vm.count("no-pack") == 0;
         bool do_place = vm.count("pack-only") == 0 && vm.count("no-place") == 0;
         bool do_route = vm.count("pack-only") == 0 && vm.count("no-route") == 0;
+        if (!checkpoint_file.empty()) {
+            // Resume after the stages the checkpoint has already been through
+            do_pack = do_pack && !ctx->settings.count(ctx->id("pack"));
+            do_place = do_place && !ctx->settings.count(ctx->id("place"));
+            do_route = do_route && !ctx->settings.count(ctx->id("route"));
+            if (!do_pack && (do_place || do_route))
+                resume_partial_stage(ctx.get(), do_place);
+        }
+
+        auto end_stage = [&](const char *stage, std::chrono::high_resolution_clock::time_point start) {
+            auto end = std::chrono::high_resolution_clock::now();
+            stage_runtimes.emplace_back(stage, std::chrono::duration<double>(end - start).count());
+            track_design_memory(ctx.get());
+            memory_summary(stage);
+        };
 
         if (do_pack) {
             run_script_hook("pre-pack");
+            NPNR_PROFILE_ZONE("pack");
+            auto pstart = std::chrono::high_resolution_clock::now();
             if (!ctx->pack() && !ctx->force)
                 log_error("Packing design failed.\n");
+            end_stage("pack", pstart);
+            ctx->autosave(true);
+        }
+        if (vm.count("reuse-checkpoint")) {
+            std::string filename = vm["reuse-checkpoint"].as<std::string>();
+            if (!vm.count("reuse-partition"))
+                log_error("--reuse-checkpoint needs at least one --reuse-partition.\n");
+            std::ifstream f(filename, std::ios::binary);
+            if (!reuse_checkpoint_partitions(f, filename, ctx.get(),
+                                             vm["reuse-partition"].as<std::vector<std::string>>()))
+                log_error("Reusing partitions from checkpoint failed.\n");
+        }
+        if (vm.count("guide-placement") && do_place) {
+            std::string filename = vm["guide-placement"].as<std::string>();
+            std::ifstream f(filename, std::ios::binary);
+            bool loaded = is_checkpoint(f) ? read_checkpoint_placement(f, filename, ctx.get(), ctx->placement_guide)
+                                           : read_json_placement(f, filename, ctx.get(), ctx->placement_guide);
+            if (!loaded)
+                log_error("Loading placement guide failed.\n");
+            log_info("Loaded placement guide with %d placed cells.\n", int(ctx->placement_guide.size()));
+        }
+        {
+            NPNR_PROFILE_ZONE("assign budget");
+            assign_budget(ctx.get());
         }
-        assign_budget(ctx.get());
         ctx->check();
         print_utilisation(ctx.get());
 
+#ifndef _WIN32
+        bool seed_worker = false;
+        SeedWorker self;
+        int seeds = vm.count("parallel-seeds") ? vm["parallel-seeds"].as<int>() : 1;
+        if (do_place && seeds > 1) {
+            int exit_status;
+            if (fork_seed_workers(ctx.get(), seeds, vm.count("seed") ? vm["seed"].as<int>() : 1, self, exit_status)) {
+#ifndef NO_PYTHON
+                deinit_python();
+#endif
+                return exit_status;
+            }
+            seed_worker = true;
+            // The workers would all write the same checkpoint
+            ctx->autosave_file.clear();
+        }
+#endif
+
         if (do_place) {
             run_script_hook("pre-place");
+            NPNR_PROFILE_ZONE("place");
+            auto pstart = std::chrono::high_resolution_clock::now();
             if (!ctx->place() && !ctx->force)
                 log_error("Placing design failed.\n");
+            end_stage("place", pstart);
+            ctx->autosave(true);
             ctx->check();
+            if (vm.count("congestion-report")) {
+                CongestionMap congestion(ctx.get());
+                congestion.update();
+                congestion.report();
+            }
             if (vm.count("placed-svg"))
                 ctx->writeSVG(vm["placed-svg"].as<std::string>(), "scale=50 hide_routing");
         }
 
         if (do_route) {
             run_script_hook("pre-route");
+            if (vm.count("guide-routing"))
+                apply_routing_guide(ctx.get(), vm["guide-routing"].as<std::string>());
+            NPNR_PROFILE_ZONE("route");
+            bool auto_router = ctx->setting<bool>("router/auto", false);
+            RouterChoice router_choice;
+            if (auto_router)
+                router_choice = select_router(ctx.get());
+            auto rstart = std::chrono::high_resolution_clock::now();
             if (!ctx->route() && !ctx->force)
                 log_error("Routing design failed.\n");
+            end_stage("route", rstart);
+            ctx->autosave(true);
+            if (auto_router) {
+                auto rend = std::chrono::high_resolution_clock::now();
+                log_info("Routing time with %s: predicted %.02fs, actual %.02fs\n", router_choice.router.c_str(),
+                         router_choice.predicted_time, std::chrono::duration<float>(rend - rstart).count());
+            }
             run_script_hook("post-route");
             if (vm.count("routed-svg"))
-                ctx->writeSVG(vm["routed-svg"].as<std::string>(), "scale=500");
+                ctx->writeSVG(vm["routed-svg"].as<std::string>(), "scale=500 used_only merge");
         }
 
-        customBitstream(ctx.get());
+#ifndef _WIN32
+        if (seed_worker)
+            finish_seed_worker(ctx.get(), self);
+#endif
+
+        if (bitstreamModifiesDesign()) {
+            // Must finish before the other outputs read the design
+            NPNR_PROFILE_ZONE("bitstream");
+            customBitstream(ctx.get());
+        } else {
+            outputs.push_back([&]() {
+                NPNR_PROFILE_ZONE("bitstream");
+                customBitstream(ctx.get());
+            });
+        }
     }
 
     if (vm.count("write")) {
-        std::string filename = vm["write"].as<std::string>();
-        std::ofstream f(filename);
-        if (!write_json_file(f, filename, ctx.get()))
-            log_error("Saving design failed.\n");
+        outputs.push_back([&]() {
+            std::string filename = vm["write"].as<std::string>();
+            std::ofstream f(filename);
+            NPNR_PROFILE_ZONE("write design");
+            if (!write_json_file(f, filename, ctx.get()))
+                log_error("Saving design failed.\n");
+        });
+    }
+
+    if (vm.count("write-checkpoint")) {
+        outputs.push_back([&]() {
+            std::string filename = vm["write-checkpoint"].as<std::string>();
+            std::ofstream f(filename, std::ios::binary);
+            if (!write_checkpoint(f, filename, ctx.get()))
+                log_error("Saving checkpoint failed.\n");
+        });
     }
 
     if (vm.count("sdf")) {
-        std::string filename = vm["sdf"].as<std::string>();
-        std::ofstream f(filename);
-        if (!f)
-            log_error("Failed to open SDF file '%s' for writing.\n", filename.c_str());
-        ctx->writeSDF(f, vm.count("sdf-cvc"));
+        outputs.push_back([&]() {
+            std::string filename = vm["sdf"].as<std::string>();
+            std::ofstream f(filename);
+            if (!f)
+                log_error("Failed to open SDF file '%s' for writing.\n", filename.c_str());
+            NPNR_PROFILE_ZONE("write SDF");
+            ctx->writeSDF(f, vm.count("sdf-cvc"));
+        });
     }
 
+    if (vm.count("report")) {
+        outputs.push_back([&]() {
+            std::string filename = vm["report"].as<std::string>();
+            std::ofstream f(filename);
+            if (!f)
+                log_error("Failed to open report file '%s' for writing.\n", filename.c_str());
+            ctx->writeReport(f, stage_runtimes);
+        });
+    }
+
+    // The output writers only read the design, so they can all run at once
+    int output_threads = std::min(ctx->stage_threads("output", 0), int(outputs.size()));
+#ifndef NPNR_DISABLE_THREADS
+    if (output_threads > 1) {
+        std::vector<int> tasks(outputs.size());
+        std::iota(tasks.begin(), tasks.end(), 0);
+        WorkerPool(output_threads).run(tasks, [&](int i) { outputs.at(i)(); });
+    } else
+#endif
+        for (auto &output : outputs)
+            output();
+
 #ifndef NO_PYTHON
     deinit_python();
 #endif
@@ -388,6 +1237,18 @@ int CommandHandler::executeMain(std::unique_ptr<Context> ctx)
     return had_nonfatal_error ? 1 : 0;
 }
 
+void CommandHandler::apply_set_options(Context *ctx)
+{
+    if (!vm.count("set"))
+        return;
+    for (auto &item : vm["set"].as<std::vector<std::string>>()) {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos || eq == 0)
+            log_error("Expected NAME=VALUE for --set, not '%s'.\n", item.c_str());
+        ctx->settings[ctx->id(item.substr(0, eq))] = item.substr(eq + 1);
+    }
+}
+
 void CommandHandler::conflicting_options(const boost::program_options::variables_map &vm, const char *opt1,
                                          const char *opt2)
 {
@@ -412,22 +1273,273 @@ int CommandHandler::exec()
         if (!parseOptions())
             return -1;
 
+#ifndef _WIN32
+        if (vm.count("client"))
+            return runClient(vm["client"].as<std::string>());
+#endif
+
         if (executeBeforeContext())
             return 0;
 
+        if (vm.count("profile"))
+            profile_enable();
+
         std::unordered_map<std::string, Property> values;
-        std::unique_ptr<Context> ctx = createContext(values);
+        auto start = std::chrono::high_resolution_clock::now();
+        std::unique_ptr<Context> ctx;
+        {
+            NPNR_PROFILE_ZONE("load device");
+            ctx = createContext(values);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        log_info("Loaded device database in %.2fs\n", std::chrono::duration<double>(end - start).count());
         setupContext(ctx.get());
         setupArchContext(ctx.get());
+#ifndef _WIN32
+        if (vm.count("server"))
+            return serve(std::move(ctx));
+#endif
         int rc = executeMain(std::move(ctx));
+        writeProfile();
         printFooter();
+        log_set_async(false);
         return rc;
     } catch (log_execution_error_exception) {
+        // A profile of a failing run is still useful to see where it got to
+        writeProfile();
         printFooter();
+        log_set_async(false);
         return -1;
     }
 }
 
+#ifndef _WIN32
+namespace {
+bool write_all(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool open_socket(const std::string &path, sockaddr_un &addr, int &fd)
+{
+    if (path.size() >= sizeof(addr.sun_path))
+        return false;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    return fd >= 0;
+}
+
+// The value of an option as a string for comparison, distinguishing options that aren't given from flags
+std::string option_value(const po::variables_map &vm, const std::string &name)
+{
+    if (!vm.count(name))
+        return std::string(1, '\0');
+    const boost::any &value = vm[name].value();
+    if (auto s = boost::any_cast<std::string>(&value))
+        return *s;
+    if (auto i = boost::any_cast<int>(&value))
+        return std::to_string(*i);
+    if (auto v = boost::any_cast<std::vector<std::string>>(&value))
+        return boost::algorithm::join(*v, std::string(1, '\0'));
+    return std::string();
+}
+} // namespace
+
+// A job is sent as the client's working directory and then its arguments, each terminated by a NUL. The server
+// streams back everything the job writes to stdout and stderr, then a NUL and the job's exit status.
+int CommandHandler::serve(std::unique_ptr<Context> ctx)
+{
+    std::string path = vm["server"].as<std::string>();
+    sockaddr_un addr;
+    int listen_fd;
+    if (!open_socket(path, addr, listen_fd))
+        log_error("Failed to create server socket '%s'\n", path.c_str());
+    // Replace the socket of an earlier server, but nothing else
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode))
+            log_error("Can't serve on '%s', as it exists and isn't a socket\n", path.c_str());
+        unlink(path.c_str());
+    }
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 16) != 0)
+        log_error("Failed to listen on '%s': %s\n", path.c_str(), strerror(errno));
+    log_info("Serving jobs on '%s'.\n", path.c_str());
+    std::map<std::string, std::string> context_options;
+    for (auto &name : getContextOptions())
+        context_options[name] = option_value(vm, name);
+    // Workers would not survive the fork; jobs are reaped automatically
+    log_set_async(false);
+    signal(SIGCHLD, SIG_IGN);
+
+    int jobs = 0;
+    while (true) {
+        int conn = accept(listen_fd, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR)
+                continue;
+            log_error("Failed to accept a job: %s\n", strerror(errno));
+        }
+        for (auto &stream : log_streams)
+            stream.first->flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listen_fd);
+            signal(SIGCHLD, SIG_DFL);
+            runJob(std::move(ctx), conn, context_options);
+        }
+        close(conn);
+        if (pid < 0)
+            log_warning("Failed to fork process for a job: %s\n", strerror(errno));
+        else
+            log_info("Started job %d (pid %d).\n", ++jobs, int(pid));
+    }
+}
+
+// Run one job, in a fork of the server, on its own copy of the warm context; never returns
+void CommandHandler::runJob(std::unique_ptr<Context> ctx, int conn,
+                            const std::map<std::string, std::string> &context_options)
+{
+    std::string request;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(conn, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR))
+        if (n > 0)
+            request.append(buf, n);
+    std::vector<std::string> fields;
+    for (size_t start = 0, end; (end = request.find('\0', start)) != std::string::npos; start = end + 1)
+        fields.push_back(request.substr(start, end - start));
+
+    dup2(conn, STDOUT_FILENO);
+    dup2(conn, STDERR_FILENO);
+    close(conn);
+
+    int rc = -1;
+    if (fields.empty() || chdir(fields.front().c_str()) != 0) {
+        std::cerr << "Failed to enter the working directory of the job\n";
+    } else {
+        std::vector<char *> job_argv{argv[0]};
+        for (size_t i = 1; i < fields.size(); i++)
+            job_argv.push_back(&fields.at(i)[0]);
+        job_argv.push_back(nullptr);
+        argc = int(job_argv.size()) - 1;
+        argv = job_argv.data();
+
+        vm.clear();
+        log_streams.clear();
+        message_count_by_level.clear();
+        had_nonfatal_error = false;
+        try {
+            if (!parseOptions()) {
+                rc = -1;
+            } else if (executeBeforeContext()) {
+                rc = 0;
+            } else {
+                if (vm.count("server") || vm.count("client"))
+                    log_error("Server jobs can't start servers or clients\n");
+                if (vm.count("profile"))
+                    profile_enable();
+                // The device was loaded by the server, so the job must ask for the same one
+                for (auto &option : context_options)
+                    if (option_value(vm, option.first) != option.second)
+                        log_error("Option --%s of the job doesn't match the server; this needs a server started "
+                                  "with the same device options\n",
+                                  option.first.c_str());
+                setupContext(ctx.get());
+                rc = executeMain(std::move(ctx));
+                writeProfile();
+                printFooter();
+            }
+        } catch (log_execution_error_exception) {
+            writeProfile();
+            printFooter();
+            rc = -1;
+        }
+        log_set_async(false);
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+    std::string status = std::string(1, '\0') + std::to_string(rc);
+    write_all(STDOUT_FILENO, status.data(), status.size());
+    _exit(0);
+}
+
+int CommandHandler::runClient(const std::string &path)
+{
+    sockaddr_un addr;
+    int fd;
+    if (!open_socket(path, addr, fd) || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Failed to connect to the nextpnr server at '" << path << "'\n";
+        return -1;
+    }
+    std::string request = boost::filesystem::current_path().string() + '\0';
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--client") {
+            i++;
+            continue;
+        }
+        if (arg.compare(0, 9, "--client=") != 0)
+            request += arg + '\0';
+    }
+    if (!write_all(fd, request.data(), request.size())) {
+        std::cerr << "Failed to send the job to the nextpnr server\n";
+        return -1;
+    }
+    shutdown(fd, SHUT_WR);
+
+    // The job's output, up to the NUL before its exit status, goes to stderr like the log of a local run
+    std::string status;
+    bool in_status = false;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR)) {
+        if (n < 0)
+            continue;
+        const char *data = buf, *end = buf + n;
+        if (!in_status) {
+            const char *nul = std::find(data, end, '\0');
+            std::cerr.write(data, nul - data);
+            if (nul == end)
+                continue;
+            in_status = true;
+            data = nul + 1;
+        }
+        status.append(data, end);
+    }
+    std::cerr.flush();
+    close(fd);
+    if (!in_status || status.empty()) {
+        std::cerr << "The nextpnr server ended the job without an exit status\n";
+        return -1;
+    }
+    return std::stoi(status);
+}
+#endif
+
+void CommandHandler::writeProfile()
+{
+    if (!vm.count("profile"))
+        return;
+    profile_summary();
+    std::string filename = vm["profile"].as<std::string>();
+    if (!profile_write_trace(filename))
+        log_nonfatal_error("Failed to write profile to '%s'.\n", filename.c_str());
+}
+
 std::unique_ptr<Context> CommandHandler::load_json(std::string filename)
 {
     std::unordered_map<std::string, Property> values;
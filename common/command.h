@@ -25,6 +25,7 @@
 #include <fstream>
 #include "log.h"
 #include "nextpnr.h"
+#include "preflight.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -44,19 +45,34 @@ class CommandHandler
     virtual void setupArchContext(Context *ctx) = 0;
     virtual std::unique_ptr<Context> createContext(std::unordered_map<std::string, Property> &values) = 0;
     virtual po::options_description getArchOptions() = 0;
+    // Options read by createContext. Server jobs reuse the server's Context, so they must give these the same values
+    virtual std::vector<std::string> getContextOptions() { return {}; }
     virtual void validate(){};
     virtual void customAfterLoad(Context *ctx){};
+    // Fill in the arch's resources for the checks after loading a design; return false to skip them
+    virtual bool preflightConfig(Context *ctx, PreflightCfg &cfg) { return false; }
     virtual void customBitstream(Context *ctx){};
+    // Whether customBitstream changes the design (e.g. to fill in defaults), so that it can't run at the same time as
+    // the other output writers
+    virtual bool bitstreamModifiesDesign() { return false; }
     void conflicting_options(const boost::program_options::variables_map &vm, const char *opt1, const char *opt2);
 
   private:
     bool parseOptions();
     bool executeBeforeContext();
     void setupContext(Context *ctx);
+    void apply_set_options(Context *ctx);
     int executeMain(std::unique_ptr<Context> ctx);
     po::options_description getGeneralOptions();
     void run_script_hook(const std::string &name);
     void printFooter();
+    void writeProfile();
+#ifndef _WIN32
+    int serve(std::unique_ptr<Context> ctx);
+    NPNR_NORETURN void runJob(std::unique_ptr<Context> ctx, int conn,
+                              const std::map<std::string, std::string> &context_options);
+    int runClient(const std::string &path);
+#endif
 
   protected:
     po::variables_map vm;
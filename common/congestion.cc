@@ -0,0 +1,169 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "congestion.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include "log.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+// Fraction of the wires of a tile assumed to be usable by nets passing through it; the rest are taken up by pin
+// and local wires, and by the detours that real routes make compared to the bounding box estimate
+const float wire_utilisation = 0.25f;
+// Fraction of occupied tiles that may be overused before the placement is reported as likely to be unroutable
+const float overflow_warn_fraction = 0.01f;
+} // namespace
+
+CongestionMap::CongestionMap(const Context *ctx) : width(ctx->getGridDimX()), height(ctx->getGridDimY()), ctx(ctx)
+{
+    dem.resize(width * height, 0);
+}
+
+void CongestionMap::update_demand()
+{
+    // 2D difference array, so each net is added in constant time
+    std::vector<float> diff((width + 1) * (height + 1), 0);
+    for (auto &net : ctx->nets) {
+        const NetInfo *ni = net.second.get();
+        if (ni->driver.cell == nullptr || ni->driver.cell->bel == BelId() || ni->users.empty())
+            continue;
+        if (int(ni->users.size()) > max_fanout || ctx->getBelGlobalBuf(ni->driver.cell->bel))
+            continue;
+        Loc drv = ctx->getBelLocation(ni->driver.cell->bel);
+        int x0 = drv.x, x1 = drv.x, y0 = drv.y, y1 = drv.y;
+        for (auto &usr : ni->users) {
+            if (usr.cell == nullptr || usr.cell->bel == BelId())
+                continue;
+            Loc loc = ctx->getBelLocation(usr.cell->bel);
+            x0 = std::min(x0, loc.x);
+            x1 = std::max(x1, loc.x);
+            y0 = std::min(y0, loc.y);
+            y1 = std::max(y1, loc.y);
+        }
+        x0 = std::max(0, std::min(x0, width - 1));
+        x1 = std::max(0, std::min(x1, width - 1));
+        y0 = std::max(0, std::min(y0, height - 1));
+        y1 = std::max(0, std::min(y1, height - 1));
+        float d = float((x1 - x0) + (y1 - y0) + 1) / float((x1 - x0 + 1) * (y1 - y0 + 1));
+        diff[y0 * (width + 1) + x0] += d;
+        diff[y0 * (width + 1) + x1 + 1] -= d;
+        diff[(y1 + 1) * (width + 1) + x0] -= d;
+        diff[(y1 + 1) * (width + 1) + x1 + 1] += d;
+    }
+    // Prefix sum along rows then columns to get the demand of each tile
+    for (int y = 0; y < height; y++)
+        for (int x = 1; x < width; x++)
+            diff[y * (width + 1) + x] += diff[y * (width + 1) + x - 1];
+    for (int y = 1; y < height; y++)
+        for (int x = 0; x < width; x++)
+            diff[y * (width + 1) + x] += diff[(y - 1) * (width + 1) + x];
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            dem[y * width + x] = diff[y * (width + 1) + x];
+}
+
+void CongestionMap::update_capacity()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    cap.assign(width * height, 0);
+    for (auto wire : ctx->getWires()) {
+        // Only wires that can be both entered and left through a pip are useful for passing through a tile
+        auto dh = ctx->getPipsDownhill(wire), uh = ctx->getPipsUphill(wire);
+        if (!(dh.begin() != dh.end()) || !(uh.begin() != uh.end()))
+            continue;
+        ArcBounds bb = ctx->getRouteBoundingBox(wire, wire);
+        int x = std::max(0, std::min((bb.x0 + bb.x1) / 2, width - 1));
+        int y = std::max(0, std::min((bb.y0 + bb.y1) / 2, height - 1));
+        cap[y * width + x] += wire_utilisation;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    log_info("Congestion map: counted routing wires in %.02fs\n", std::chrono::duration<float>(end - start).count());
+}
+
+void CongestionMap::update()
+{
+    if (cap.empty())
+        update_capacity();
+    update_demand();
+    overflow_sum.assign((width + 1) * (height + 1), 0);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            overflow_sum[(y + 1) * (width + 1) + x + 1] = std::max(0.0f, ratio(x, y) - 1) +
+                                                          overflow_sum[y * (width + 1) + x + 1] +
+                                                          overflow_sum[(y + 1) * (width + 1) + x] -
+                                                          overflow_sum[y * (width + 1) + x];
+}
+
+float CongestionMap::ratio(int x, int y) const
+{
+    float c = capacity(x, y);
+    // Tiles without routing are skipped over by the router, rather than congested
+    return (c > 0) ? demand(x, y) / c : 0;
+}
+
+float CongestionMap::mean_overflow(int x0, int y0, int x1, int y1) const
+{
+    x0 = std::max(0, std::min(x0, width - 1));
+    x1 = std::max(0, std::min(x1, width - 1));
+    y0 = std::max(0, std::min(y0, height - 1));
+    y1 = std::max(0, std::min(y1, height - 1));
+    double sum = overflow_sum[(y1 + 1) * (width + 1) + x1 + 1] - overflow_sum[y0 * (width + 1) + x1 + 1] -
+                 overflow_sum[(y1 + 1) * (width + 1) + x0] + overflow_sum[y0 * (width + 1) + x0];
+    return float(sum / ((x1 - x0 + 1) * (y1 - y0 + 1)));
+}
+
+void CongestionMap::report(int hotspots) const
+{
+    std::vector<std::pair<float, int>> occupied;
+    double total_demand = 0;
+    int overused = 0;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++) {
+            if (demand(x, y) < 1e-3f)
+                continue;
+            total_demand += demand(x, y);
+            float r = ratio(x, y);
+            occupied.emplace_back(r, y * width + x);
+            if (r > 1)
+                overused++;
+        }
+    if (occupied.empty()) {
+        log_info("Congestion estimate: no placed nets\n");
+        return;
+    }
+    std::sort(occupied.begin(), occupied.end(), std::greater<std::pair<float, int>>());
+    float p95 = occupied.at(occupied.size() / 20).first, p50 = occupied.at(occupied.size() / 2).first;
+    log_info("Congestion estimate: demand %.0f over %d tiles, usage max %.0f%% p95 %.0f%% median %.0f%%, %d tiles "
+             "over capacity\n",
+             total_demand, int(occupied.size()), 100 * occupied.front().first, 100 * p95, 100 * p50, overused);
+    for (int i = 0; i < std::min(hotspots, int(occupied.size())); i++) {
+        int x = occupied.at(i).second % width, y = occupied.at(i).second / width;
+        log_info("    tile (%3d, %3d): demand %6.1f, capacity %6.1f, usage %4.0f%%\n", x, y, demand(x, y),
+                 capacity(x, y), 100 * occupied.at(i).first);
+    }
+    if (overused > overflow_warn_fraction * occupied.size())
+        log_warning("%d of %d used tiles are estimated to be over their routing capacity, routing is likely to be "
+                    "slow or to fail\n",
+                    overused, int(occupied.size()));
+}
+
+NEXTPNR_NAMESPACE_END
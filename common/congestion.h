@@ -0,0 +1,65 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef CONGESTION_H
+#define CONGESTION_H
+
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// A fast probabilistic estimate of routing congestion from the current placement, before any routing is done.
+// The demand of each net is the half perimeter of its bounding box spread evenly over the tiles inside it (RUDY);
+// this is compared against the number of routing wires in each tile.
+struct CongestionMap
+{
+    explicit CongestionMap(const Context *ctx);
+
+    // Recompute the demand from the current placement; this is linear in the number of pins so cheap enough to do
+    // once per placer iteration
+    void update_demand();
+    // Count the routing wires of each tile; this visits every wire of the device so is only done once
+    void update_capacity();
+    // Update the demand (and the capacity, if not yet known) and the overflow map
+    void update();
+
+    float demand(int x, int y) const { return dem.at(y * width + x); }
+    float capacity(int x, int y) const { return cap.at(y * width + x); }
+    // Ratio of demand to usable capacity, with tiles above 1 likely to be congested
+    float ratio(int x, int y) const;
+    // Mean over a box of the excess of the ratio above 1, in constant time
+    float mean_overflow(int x0, int y0, int x1, int y1) const;
+
+    // Log a summary of the congestion estimate and the worst tiles, after update()
+    void report(int hotspots = 8) const;
+
+    int width, height;
+    // Nets of higher fanout are left out, as they are often on global resources
+    int max_fanout = 64;
+
+  private:
+    const Context *ctx;
+    std::vector<float> dem, cap;
+    // 2D prefix sum of the overflow, of (width + 1) * (height + 1) entries
+    std::vector<double> overflow_sum;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
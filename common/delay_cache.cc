@@ -0,0 +1,84 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "delay_cache.h"
+#include <limits>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+PredictDelayCache::PredictDelayCache(Context *ctx) : ctx(ctx)
+{
+    cached = Arch::predictDelayCacheable && ctx->setting<bool>("predictDelayCache", true);
+    width = ctx->getGridDimX();
+    height = ctx->getGridDimY();
+}
+
+int PredictDelayCache::arc_class(const NetInfo *net, const PortRef &sink)
+{
+    if (!cached || net->driver.cell == nullptr || sink.cell == nullptr)
+        return -1;
+    ArcKey key{net->driver.cell->type, net->driver.port, sink.cell->type, sink.port};
+    auto found = class_index.find(key);
+    if (found != class_index.end())
+        return found->second;
+    int cls = int(tables.size());
+    class_index[key] = cls;
+    tables.emplace_back();
+    return cls;
+}
+
+delay_t PredictDelayCache::predict(int cls, const NetInfo *net, const PortRef &sink)
+{
+    if (cls < 0)
+        return ctx->predictDelay(net, sink);
+    BelId driver_bel = net->driver.cell->bel, sink_bel = sink.cell->bel;
+    if (driver_bel == BelId() || sink_bel == BelId())
+        return ctx->predictDelay(net, sink);
+    Loc driver_loc = ctx->getBelLocation(driver_bel), sink_loc = ctx->getBelLocation(sink_bel);
+    int dx = std::abs(sink_loc.x - driver_loc.x), dy = std::abs(sink_loc.y - driver_loc.y);
+    if ((dx == 0 && dy == 0) || dx >= width || dy >= height)
+        return ctx->predictDelay(net, sink);
+
+    int arch_class = ctx->getPredictDelayClass(net, sink);
+    NPNR_ASSERT(arch_class >= 0);
+    auto &arch_tables = tables.at(cls);
+    if (arch_class >= int(arch_tables.size()))
+        arch_tables.resize(arch_class + 1);
+    auto &table = arch_tables.at(arch_class);
+    if (table.empty())
+        table.resize(width * height, std::numeric_limits<delay_t>::lowest());
+    delay_t &entry = table.at(dy * width + dx);
+    if (entry == std::numeric_limits<delay_t>::lowest())
+        entry = ctx->predictDelay(net, sink);
+    return entry;
+}
+
+delay_t PredictDelayCache::route_delay(int cls, const NetInfo *net, const PortRef &sink)
+{
+#ifdef ARCH_ECP5
+    if (net->is_global)
+        return 0;
+#endif
+    if (net->wires.empty())
+        return predict(cls, net, sink);
+    return ctx->getNetinfoRouteDelay(net, sink);
+}
+
+NEXTPNR_NAMESPACE_END
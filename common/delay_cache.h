@@ -0,0 +1,84 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef DELAY_CACHE_H
+#define DELAY_CACHE_H
+
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// A memoised predictDelay, for architectures that declare Arch::predictDelayCacheable. Arcs are grouped into classes
+// by the types and ports of the driver and sink cells, and each class has a table of predicted delays by the
+// absolute x and y distance between the driver and sink bels, filled in as it is used. Where predictDelay also depends
+// on the placement, Arch::getPredictDelayClass splits each class further, with one table per value it returns. Arcs
+// within a tile, and arcs with an unplaced cell, always go to predictDelay.
+//
+// This is not thread safe, as looking up a delay may fill in the table.
+struct PredictDelayCache
+{
+    explicit PredictDelayCache(Context *ctx);
+
+    // Index of the class of the arc from the driver of net to sink, or -1 if its delay is not cached
+    int arc_class(const NetInfo *net, const PortRef &sink);
+
+    // Equivalent to ctx->predictDelay(net, sink), for an arc of class cls as returned by arc_class
+    delay_t predict(int cls, const NetInfo *net, const PortRef &sink);
+    delay_t predict(const NetInfo *net, const PortRef &sink) { return predict(arc_class(net, sink), net, sink); }
+
+    // Equivalent to ctx->getNetinfoRouteDelay(net, sink), using the cache for unrouted nets
+    delay_t route_delay(int cls, const NetInfo *net, const PortRef &sink);
+
+    bool enabled() const { return cached; }
+
+  private:
+    Context *ctx;
+    bool cached;
+    int width, height;
+
+    struct ArcKey
+    {
+        IdString driver_type, driver_port, sink_type, sink_port;
+        bool operator==(const ArcKey &other) const
+        {
+            return driver_type == other.driver_type && driver_port == other.driver_port &&
+                   sink_type == other.sink_type && sink_port == other.sink_port;
+        }
+    };
+    struct ArcKeyHash
+    {
+        std::size_t operator()(const ArcKey &key) const noexcept
+        {
+            std::size_t seed = std::hash<IdString>()(key.driver_type);
+            boost::hash_combine(seed, std::hash<IdString>()(key.driver_port));
+            boost::hash_combine(seed, std::hash<IdString>()(key.sink_type));
+            boost::hash_combine(seed, std::hash<IdString>()(key.sink_port));
+            return seed;
+        }
+    };
+
+    std::unordered_map<ArcKey, int, ArcKeyHash> class_index;
+    // Per class and then per Arch::getPredictDelayClass value, width * height entries indexed by dy * width + dx;
+    // empty until first used
+    std::vector<std::vector<std::vector<delay_t>>> tables;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef DESIGN_ALLOC_H
+#define DESIGN_ALLOC_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Included from nextpnr.h, after the namespace macros are defined
+NEXTPNR_NAMESPACE_BEGIN
+
+// Allocation of the many small objects that make up a design (cells, nets and the nodes of their maps). Blocks of each
+// size are carved out of large slabs and recycled through a free list, so building a design makes a few large
+// allocations rather than one per object. Slabs are never returned to the system, so there is nothing to free at exit.
+template <std::size_t Size> class DesignBlockPool
+{
+  public:
+    // Blocks are at least pointer sized, for the free list, and keep the alignment of operator new
+    static const std::size_t block_size =
+            ((Size < sizeof(void *) ? sizeof(void *) : Size) + alignof(std::max_align_t) - 1) &
+            ~(alignof(std::max_align_t) - 1);
+
+    static DesignBlockPool &get()
+    {
+        // Deliberately never destroyed, so that objects outliving static destruction can still be freed
+        static DesignBlockPool *pool = new DesignBlockPool();
+        return *pool;
+    }
+
+    void *alloc()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free_list == nullptr)
+            add_slab();
+        void *block = free_list;
+        free_list = *reinterpret_cast<void **>(block);
+        return block;
+    }
+
+    void release(void *block)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        *reinterpret_cast<void **>(block) = free_list;
+        free_list = block;
+    }
+
+  private:
+    static const std::size_t slab_bytes = 1 << 20;
+    static const std::size_t slab_blocks = (slab_bytes / block_size) < 16 ? 16 : (slab_bytes / block_size);
+
+    std::mutex mutex;
+    void *free_list = nullptr;
+
+    void add_slab()
+    {
+        char *slab = static_cast<char *>(::operator new(slab_blocks * block_size));
+        for (std::size_t i = slab_blocks; i-- > 0;) {
+            void *block = slab + i * block_size;
+            *reinterpret_cast<void **>(block) = free_list;
+            free_list = block;
+        }
+    }
+};
+
+// An allocator for standard containers of design objects. Single objects, such as the nodes of a map, come from the
+// pool for their size; arrays, such as hash table buckets, use the normal allocator.
+template <typename T> struct DesignAllocator
+{
+    typedef T value_type;
+
+    DesignAllocator() noexcept {}
+    template <typename U> DesignAllocator(const DesignAllocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n)
+    {
+        if (n == 1)
+            return static_cast<T *>(DesignBlockPool<sizeof(T)>::get().alloc());
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n)
+    {
+        if (n == 1)
+            DesignBlockPool<sizeof(T)>::get().release(p);
+        else
+            std::allocator<T>().deallocate(p, n);
+    }
+};
+
+template <typename T, typename U> bool operator==(const DesignAllocator<T> &, const DesignAllocator<U> &)
+{
+    return true;
+}
+template <typename T, typename U> bool operator!=(const DesignAllocator<T> &, const DesignAllocator<U> &)
+{
+    return false;
+}
+
+NEXTPNR_NAMESPACE_END
+
+#endif
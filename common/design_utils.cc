@@ -20,11 +20,25 @@
 
 #include "design_utils.h"
 #include <algorithm>
+#include <deque>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include "log.h"
 #include "util.h"
 NEXTPNR_NAMESPACE_BEGIN
 
+size_t find_user(const NetInfo *net, const CellInfo *cell, IdString port, size_t hint)
+{
+    if (hint < net->users.size() && net->users[hint].cell == cell && net->users[hint].port == port)
+        return hint;
+    for (size_t i = 0; i < net->users.size(); i++)
+        if (net->users[i].cell == cell && net->users[i].port == port)
+            return i;
+    return net->users.size();
+}
+
 void replace_port(CellInfo *old_cell, IdString old_name, CellInfo *rep_cell, IdString rep_name)
 {
     if (!old_cell->ports.count(old_name))
@@ -49,11 +63,11 @@ void replace_port(CellInfo *old_cell, IdString old_name, CellInfo *rep_cell, IdS
         }
     } else if (rep.type == PORT_IN) {
         if (rep.net != nullptr) {
-            for (PortRef &load : rep.net->users) {
-                if (load.cell == old_cell && load.port == old_name) {
-                    load.cell = rep_cell;
-                    load.port = rep_name;
-                }
+            size_t idx = find_user(rep.net, old_cell, old_name, old.user_idx);
+            if (idx != rep.net->users.size()) {
+                rep.net->users.at(idx).cell = rep_cell;
+                rep.net->users.at(idx).port = rep_name;
+                rep.user_idx = idx;
             }
         }
     } else {
@@ -99,6 +113,7 @@ void connect_port(const Context *ctx, NetInfo *net, CellInfo *cell, IdString por
         PortRef user;
         user.cell = cell;
         user.port = port_name;
+        port.user_idx = net->users.size();
         net->users.push_back(user);
     } else {
         NPNR_ASSERT_FALSE("invalid port type for connect_port");
@@ -111,11 +126,18 @@ void disconnect_port(const Context *ctx, CellInfo *cell, IdString port_name)
         return;
     PortInfo &port = cell->ports.at(port_name);
     if (port.net != nullptr) {
-        port.net->users.erase(std::remove_if(port.net->users.begin(), port.net->users.end(),
-                                             [cell, port_name](const PortRef &user) {
-                                                 return user.cell == cell && user.port == port_name;
-                                             }),
-                              port.net->users.end());
+        // Swap the last user into the place of this one, so that disconnecting every user of a net isn't quadratic
+        auto &users = port.net->users;
+        size_t idx = find_user(port.net, cell, port_name, port.user_idx);
+        if (idx != users.size()) {
+            if (idx != users.size() - 1) {
+                users[idx] = users.back();
+                auto moved = users[idx].cell->ports.find(users[idx].port);
+                if (moved != users[idx].cell->ports.end())
+                    moved->second.user_idx = idx;
+            }
+            users.pop_back();
+        }
         if (port.net->driver.cell == cell && port.net->driver.port == port_name)
             port.net->driver.cell = nullptr;
         port.net = nullptr;
@@ -193,4 +215,312 @@ void copy_bus(Context *ctx, CellInfo *old_cell, IdString old_name, int old_offse
     }
 }
 
+bool bind_net_routing(Context *ctx, NetInfo *net, const std::vector<std::pair<WireId, PipId>> &routing,
+                      PlaceStrength strength)
+{
+    if (routing.empty() || !net->wires.empty())
+        return false;
+    std::unordered_set<WireId> wires;
+    for (auto &entry : routing) {
+        if (entry.first == WireId() || !ctx->checkWireAvail(entry.first) || !wires.insert(entry.first).second)
+            return false;
+        if (entry.second != PipId() &&
+            (ctx->getPipDstWire(entry.second) != entry.first || !ctx->checkPipAvail(entry.second)))
+            return false;
+    }
+    WireId src_wire = ctx->getNetinfoSourceWire(net);
+    if (src_wire == WireId() || !wires.count(src_wire))
+        return false;
+    for (auto &user : net->users) {
+        WireId dst_wire = ctx->getNetinfoSinkWire(net, user);
+        if (dst_wire == WireId() || !wires.count(dst_wire))
+            return false;
+    }
+    for (auto &entry : routing) {
+        if (entry.second != PipId())
+            ctx->bindPip(entry.second, net, strength);
+        else
+            ctx->bindWire(entry.first, net, strength);
+    }
+    return true;
+}
+
+namespace {
+struct NetlistOptimiser
+{
+    Context *ctx;
+    std::unordered_map<IdString, const NetlistOptCfg::LutType *> lut_types;
+    std::unordered_map<IdString, const NetlistOptCfg::ConstType *> const_types;
+    // The constant nets that others of the same value are merged into
+    NetInfo *const_nets[2] = {nullptr, nullptr};
+    std::unordered_set<const NetInfo *> port_nets;
+    std::deque<IdString> worklist;
+    std::unordered_set<IdString> queued;
+    // Folded inputs are only taken off the users of the constant nets at the end, as these can have a huge fanout
+    std::set<std::pair<const CellInfo *, IdString>> stale_users;
+    int folded_inputs = 0, dropped_inputs = 0, buffers = 0, const_luts = 0, dead_cells = 0, removed_nets = 0;
+
+    NetlistOptimiser(Context *ctx, const NetlistOptCfg &cfg) : ctx(ctx)
+    {
+        for (auto &lut : cfg.luts)
+            lut_types[lut.type] = &lut;
+        for (auto &c : cfg.constants)
+            const_types[c.type] = &c;
+        for (auto &port : ctx->ports)
+            port_nets.insert(port.second.net);
+    }
+
+    bool is_fixed(const CellInfo *cell)
+    {
+        return bool_or_default(cell->attrs, ctx->id("keep")) || cell->attrs.count(ctx->id("BEL"));
+    }
+
+    // Whether a net may be removed, once it has no driver and no users
+    bool can_remove(const NetInfo *net)
+    {
+        return !port_nets.count(net) && net->clkconstr == nullptr && net->region == nullptr &&
+               net->tmg_id.index == -1 && !bool_or_default(net->attrs, ctx->id("keep"));
+    }
+
+    // The value of a net driven by a constant driver, or -1
+    int const_value(const NetInfo *net)
+    {
+        if (net == nullptr || net->driver.cell == nullptr)
+            return -1;
+        auto found = const_types.find(net->driver.cell->type);
+        if (found == const_types.end() || net->driver.port != found->second->output)
+            return -1;
+        return found->second->value;
+    }
+
+    void queue(CellInfo *cell)
+    {
+        if (cell != nullptr && (lut_types.count(cell->type) || const_types.count(cell->type)) &&
+            queued.insert(cell->name).second)
+            worklist.push_back(cell->name);
+    }
+
+    void remove_net_if_unused(NetInfo *net)
+    {
+        if (net->driver.cell == nullptr && net->users.empty() && can_remove(net)) {
+            for (IdString alias : net->aliases) {
+                auto found = ctx->net_aliases.find(alias);
+                if (found != ctx->net_aliases.end() && found->second == net->name)
+                    ctx->net_aliases.erase(found);
+            }
+            ctx->nets.erase(net->name);
+            removed_nets++;
+        }
+    }
+
+    void disconnect_input(CellInfo *cell, IdString port)
+    {
+        NetInfo *net = cell->ports.at(port).net;
+        disconnect_port(ctx, cell, port);
+        if (net->users.empty())
+            queue(net->driver.cell);
+        remove_net_if_unused(net);
+    }
+
+    // Move all users of from to net to, which from is then an alias of
+    void move_users(NetInfo *from, NetInfo *to)
+    {
+        for (auto &user : from->users) {
+            PortInfo &port = user.cell->ports.at(user.port);
+            port.net = to;
+            port.user_idx = to->users.size();
+            to->users.push_back(user);
+            queue(user.cell);
+        }
+        from->users.clear();
+        for (IdString alias : from->aliases) {
+            if (alias != from->name) {
+                ctx->net_aliases[alias] = to->name;
+                to->aliases.push_back(alias);
+            }
+        }
+        from->aliases.clear();
+        if (from->name != to->name) {
+            ctx->net_aliases[from->name] = to->name;
+            to->aliases.push_back(from->name);
+        }
+    }
+
+    void remove_cell(CellInfo *cell)
+    {
+        for (auto &port : cell->ports) {
+            NetInfo *net = port.second.net;
+            if (net == nullptr)
+                continue;
+            disconnect_port(ctx, cell, port.first);
+            if (net->users.empty())
+                queue(net->driver.cell);
+            remove_net_if_unused(net);
+        }
+        ctx->cells.erase(cell->name);
+    }
+
+    // Whether the output of a LUT with k inputs depends on input i
+    static bool depends_on(uint64_t truth, int k, int i)
+    {
+        for (int idx = 0; idx < (1 << k); idx++)
+            if (!(idx & (1 << i)) && ((truth >> idx) & 1) != ((truth >> (idx | (1 << i))) & 1))
+                return true;
+        return false;
+    }
+
+    // Whether a LUT with k inputs just passes through input i
+    static bool is_buffer_of(uint64_t truth, int k, int i)
+    {
+        for (int idx = 0; idx < (1 << k); idx++)
+            if (((truth >> idx) & 1) != uint64_t((idx >> i) & 1))
+                return false;
+        return true;
+    }
+
+    bool has_users(CellInfo *cell, IdString output)
+    {
+        auto found = cell->ports.find(output);
+        return found != cell->ports.end() && found->second.net != nullptr && !found->second.net->users.empty();
+    }
+
+    void process(CellInfo *cell)
+    {
+        if (is_fixed(cell))
+            return;
+        auto const_type = const_types.find(cell->type);
+        if (const_type != const_types.end()) {
+            if (!has_users(cell, const_type->second->output)) {
+                remove_cell(cell);
+                dead_cells++;
+            }
+            return;
+        }
+        const NetlistOptCfg::LutType &lut = *lut_types.at(cell->type);
+        if (!has_users(cell, lut.output)) {
+            NetInfo *out = get_net_or_empty(cell, lut.output);
+            if (out == nullptr || can_remove(out)) {
+                remove_cell(cell);
+                dead_cells++;
+            }
+            return;
+        }
+        int k = int(lut.inputs.size());
+        auto init = cell->params.find(lut.init);
+        if (k > 6 || init == cell->params.end() || init->second.is_string || !init->second.is_fully_def())
+            return;
+        uint64_t mask = (k == 6) ? ~uint64_t(0) : ((uint64_t(1) << (1 << k)) - 1);
+        uint64_t truth = uint64_t(init->second.as_int64()) & mask;
+
+        // Fold in constant inputs, then drop any other inputs that the function no longer depends on
+        bool changed = false;
+        for (int i = 0; i < k; i++) {
+            NetInfo *net = get_net_or_empty(cell, lut.inputs.at(i));
+            int value = const_value(net);
+            if (value == -1 || net != const_nets[value])
+                continue;
+            uint64_t folded = 0;
+            for (int idx = 0; idx < (1 << k); idx++) {
+                int src = value ? (idx | (1 << i)) : (idx & ~(1 << i));
+                folded |= ((truth >> src) & 1) << idx;
+            }
+            truth = folded;
+            cell->ports.at(lut.inputs.at(i)).net = nullptr;
+            stale_users.emplace(cell, lut.inputs.at(i));
+            folded_inputs++;
+            changed = true;
+        }
+        int depends = 0, last_input = -1;
+        for (int i = 0; i < k; i++) {
+            if (!depends_on(truth, k, i)) {
+                if (get_net_or_empty(cell, lut.inputs.at(i)) != nullptr) {
+                    disconnect_input(cell, lut.inputs.at(i));
+                    dropped_inputs++;
+                }
+                continue;
+            }
+            depends++;
+            last_input = i;
+        }
+        if (changed)
+            cell->params[lut.init] = Property(int64_t(truth), 1 << k);
+
+        NetInfo *out = cell->ports.at(lut.output).net;
+        if (!can_remove(out))
+            return;
+        if (depends == 0 && const_nets[truth & 1] != nullptr) {
+            move_users(out, const_nets[truth & 1]);
+            remove_cell(cell);
+            const_luts++;
+        } else if (depends == 1 && is_buffer_of(truth, k, last_input)) {
+            NetInfo *in = get_net_or_empty(cell, lut.inputs.at(last_input));
+            if (in == nullptr || in == out || in->driver.cell == nullptr)
+                return;
+            move_users(out, in);
+            remove_cell(cell);
+            buffers++;
+        }
+    }
+
+    void process_worklist()
+    {
+        while (!worklist.empty()) {
+            IdString name = worklist.front();
+            worklist.pop_front();
+            queued.erase(name);
+            auto found = ctx->cells.find(name);
+            if (found != ctx->cells.end())
+                process(found->second.get());
+        }
+    }
+
+    void run()
+    {
+        int cells_before = int(ctx->cells.size()), nets_before = int(ctx->nets.size());
+        // Merge the constant nets of each value into one
+        int merged = 0;
+        for (auto net : sorted(ctx->nets)) {
+            NetInfo *ni = net.second;
+            int value = const_value(ni);
+            if (value == -1 || !can_remove(ni) || is_fixed(ni->driver.cell))
+                continue;
+            if (const_nets[value] == nullptr) {
+                const_nets[value] = ni;
+            } else {
+                move_users(ni, const_nets[value]);
+                queue(ni->driver.cell);
+                merged++;
+            }
+        }
+        for (auto cell : sorted(ctx->cells))
+            queue(cell.second);
+        process_worklist();
+        for (NetInfo *net : const_nets) {
+            if (net == nullptr)
+                continue;
+            net->users.erase(std::remove_if(net->users.begin(), net->users.end(),
+                                            [&](const PortRef &user) {
+                                                return stale_users.count(std::make_pair(user.cell, user.port));
+                                            }),
+                             net->users.end());
+            queue(net->driver.cell);
+        }
+        process_worklist();
+        log_info("Netlist optimisation: %d -> %d cells, %d -> %d nets.\n", cells_before, int(ctx->cells.size()),
+                 nets_before, int(ctx->nets.size()));
+        log_info("    merged %d constant nets, folded %d constant LUT inputs and dropped %d unused ones;\n", merged,
+                 folded_inputs, dropped_inputs);
+        log_info("    removed %d buffers, %d constant LUTs and %d cells without users.\n", buffers, const_luts,
+                 dead_cells);
+    }
+};
+} // namespace
+
+void optimise_netlist(Context *ctx, const NetlistOptCfg &cfg)
+{
+    if (!ctx->setting<bool>("pack/optimiseNetlist", true))
+        return;
+    NetlistOptimiser(ctx, cfg).run();
+}
+
 NEXTPNR_NAMESPACE_END
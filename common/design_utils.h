@@ -31,6 +31,10 @@ NEXTPNR_NAMESPACE_BEGIN
 Utilities for design manipulation, intended for use inside packing algorithms
  */
 
+// Index of the user of net that is port of cell, trying hint (normally PortInfo::user_idx) first; net->users.size()
+// if there is none
+size_t find_user(const NetInfo *net, const CellInfo *cell, IdString port, size_t hint);
+
 // Disconnect a net (if connected) from old, and connect it to rep
 void replace_port(CellInfo *old_cell, IdString old_name, CellInfo *rep_cell, IdString rep_name);
 
@@ -92,7 +96,7 @@ inline bool port_used(CellInfo *cell, IdString port_name)
 // Connect a net to a port
 void connect_port(const Context *ctx, NetInfo *net, CellInfo *cell, IdString port_name);
 
-// Disconnect a net from a port
+// Disconnect a net from a port; the last user of the net takes the place of the port in its users
 void disconnect_port(const Context *ctx, CellInfo *cell, IdString port_name);
 
 // Connect two ports together
@@ -117,6 +121,38 @@ void copy_bus(Context *ctx, CellInfo *old_cell, IdString old_name, int old_offse
 // Copy a port from one cell to another
 void copy_port(Context *ctx, CellInfo *old_cell, IdString old_name, CellInfo *new_cell, IdString new_name);
 
+// Bind routing taken from an earlier run to an unrouted net, as (wire, pip) entries with a null pip for the source
+// wire. Nothing is bound unless all of it is still available and it reaches the net's source and every sink wire;
+// returns whether it was bound
+bool bind_net_routing(Context *ctx, NetInfo *net, const std::vector<std::pair<WireId, PipId>> &routing,
+                      PlaceStrength strength);
+
+// The LUT and constant driver cells of an arch, as they come from synthesis, for optimise_netlist
+struct NetlistOptCfg
+{
+    struct LutType
+    {
+        IdString type;
+        // Inputs from the least significant select bit of the INIT parameter upwards
+        std::vector<IdString> inputs;
+        IdString output, init;
+    };
+    std::vector<LutType> luts;
+    struct ConstType
+    {
+        IdString type, output;
+        bool value;
+    };
+    std::vector<ConstType> constants;
+};
+
+// Shrink the netlist before packing: constant LUT inputs are folded into the LUT function and inputs the function
+// does not depend on are disconnected; LUTs that are constant or buffers are replaced by the constant or their input
+// net; duplicate constant drivers are merged; and LUTs and constant drivers with no users are removed. Cells with the
+// keep or BEL attribute are left alone, as are nets that are top level ports, constrained or kept. Does nothing if
+// the pack/optimiseNetlist setting is false
+void optimise_netlist(Context *ctx, const NetlistOptCfg &cfg);
+
 NEXTPNR_NAMESPACE_END
 
 #endif
@@ -1,16 +1,66 @@
 #if defined(WIN32)
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 #include <boost/filesystem.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#ifndef NPNR_DISABLE_THREADS
+#include <thread>
+#endif
 #include "embed.h"
+#include "log.h"
 #include "nextpnr.h"
+#include "profiler.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
-#if defined(EXTERNAL_CHIPDB_ROOT)
+// Chipdb data mapped or decompressed into memory; embedded databases are part of the binary and not counted
+static int64_t chipdb_bytes = 0;
 
-const void *get_chipdb(const std::string &filename)
+#if defined(EXTERNAL_CHIPDB_ROOT) && !defined(WIN32)
+
+static const void *get_raw_chipdb(const std::string &filename, size_t &size)
+{
+    // The database is only ever read, so map it read-only and shared: nothing is copied, pages are read in as they
+    // are first used and several nextpnr processes share the page cache. Arches prefetch their hot tables with
+    // chipdb_advise.
+    static std::map<std::string, std::pair<const void *, size_t>> files;
+    auto found = files.find(filename);
+    if (found != files.end()) {
+        size = found->second.second;
+        return found->second.first;
+    }
+    const void *data = nullptr;
+    size = 0;
+    std::string full_filename = EXTERNAL_CHIPDB_ROOT "/" + filename;
+    int fd = open(full_filename.c_str(), O_RDONLY);
+    if (fd != -1) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (map != MAP_FAILED) {
+                data = map;
+                size = st.st_size;
+                memory_track("chipdb", chipdb_bytes += st.st_size);
+            }
+        }
+        close(fd);
+    }
+    // Like the embedded databases, mappings stay for the lifetime of the process
+    files[filename] = std::make_pair(data, size);
+    return data;
+}
+
+#elif defined(EXTERNAL_CHIPDB_ROOT)
+
+static const void *get_raw_chipdb(const std::string &filename, size_t &size)
 {
     static std::map<std::string, boost::iostreams::mapped_file> files;
     if (!files.count(filename)) {
@@ -18,17 +68,20 @@ const void *get_chipdb(const std::string &filename)
         if (boost::filesystem::exists(full_filename))
             files[filename].open(full_filename, boost::iostreams::mapped_file::priv);
     }
-    if (files.count(filename))
-        return files.at(filename).data();
-    return nullptr;
+    size = 0;
+    if (!files.count(filename))
+        return nullptr;
+    size = files.at(filename).size();
+    return files.at(filename).data();
 }
 
 #elif defined(WIN32)
 
-const void *get_chipdb(const std::string &filename)
+static const void *get_raw_chipdb(const std::string &filename, size_t &size)
 {
     HRSRC rc = ::FindResource(nullptr, filename.c_str(), RT_RCDATA);
     HGLOBAL rcData = ::LoadResource(nullptr, rc);
+    size = ::SizeofResource(nullptr, rc);
     return ::LockResource(rcData);
 }
 
@@ -36,14 +89,183 @@ const void *get_chipdb(const std::string &filename)
 
 EmbeddedFile *EmbeddedFile::head = nullptr;
 
-const void *get_chipdb(const std::string &filename)
+static const void *get_raw_chipdb(const std::string &filename, size_t &size)
 {
     for (EmbeddedFile *file = EmbeddedFile::head; file; file = file->next)
-        if (file->filename == filename)
+        if (file->filename == filename) {
+            size = file->size;
             return file->content;
+        }
+    size = 0;
     return nullptr;
 }
 
 #endif
 
+namespace {
+
+// Header of a chipdb compressed by bbasm --compress; see bba/compress.h for the format
+const char compressed_magic[8] = {'N', 'P', 'N', 'R', 'C', 'D', 'B', 'Z'};
+
+template <typename T> T read_header(const uint8_t *&ptr)
+{
+    T value;
+    memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return value;
+}
+
+size_t read_length(const uint8_t *&src, const uint8_t *end, size_t length)
+{
+    uint8_t b;
+    do {
+        if (src >= end)
+            return SIZE_MAX;
+        b = *(src++);
+        length += b;
+    } while (b == 255);
+    return length;
+}
+
+bool decompress_block(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *src_end = src + src_size;
+    uint8_t *dst_begin = dst, *dst_end = dst + dst_size;
+    while (src < src_end) {
+        uint8_t token = *(src++);
+        size_t literals = token >> 4;
+        if (literals == 15 && (literals = read_length(src, src_end, literals)) == SIZE_MAX)
+            return false;
+        if (literals > size_t(src_end - src) || literals > size_t(dst_end - dst))
+            return false;
+        memcpy(dst, src, literals);
+        src += literals;
+        dst += literals;
+        // The last sequence has no match
+        if (src == src_end)
+            break;
+        if (src_end - src < 2)
+            return false;
+        size_t offset = src[0] | (src[1] << 8);
+        src += 2;
+        size_t length = token & 0xF;
+        if (length == 15 && (length = read_length(src, src_end, length)) == SIZE_MAX)
+            return false;
+        length += 4;
+        if (offset == 0 || offset > size_t(dst - dst_begin) || length > size_t(dst_end - dst))
+            return false;
+        // Matches may overlap their own output, so copy a byte at a time
+        const uint8_t *match = dst - offset;
+        for (size_t i = 0; i < length; i++)
+            dst[i] = match[i];
+        dst += length;
+    }
+    return dst == dst_end;
+}
+
+// Decompress a whole chipdb into memory. The arches access it through relative pointers, so it must be contiguous;
+// cold sections can't be left compressed until first use without trapping page faults, so all of it is decompressed
+// (in parallel, by block) up front.
+const void *decompress_chipdb(const std::string &filename, const void *data, size_t size)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    const size_t header_size = sizeof(compressed_magic) + 3 * sizeof(uint32_t) + sizeof(uint64_t);
+    if (size < header_size)
+        log_error("Compressed chipdb '%s' is corrupt.\n", filename.c_str());
+    const uint8_t *ptr = reinterpret_cast<const uint8_t *>(data) + sizeof(compressed_magic);
+    const uint8_t *file_end = reinterpret_cast<const uint8_t *>(data) + size;
+    uint32_t version = read_header<uint32_t>(ptr);
+    if (version != 1)
+        log_error("Compressed chipdb '%s' has unsupported version %d.\n", filename.c_str(), int(version));
+    size_t block_size = read_header<uint32_t>(ptr);
+    size_t raw_size = read_header<uint64_t>(ptr);
+    size_t num_blocks = read_header<uint32_t>(ptr);
+
+    // Check the header and the block table against each other and the file before anything is allocated or written:
+    // every block but the last is block_size long, and all the compressed data is inside the file
+    if (block_size == 0 || num_blocks != raw_size / block_size + (raw_size % block_size != 0) ||
+        num_blocks > size_t(file_end - ptr) / 4)
+        log_error("Compressed chipdb '%s' is corrupt.\n", filename.c_str());
+    std::vector<const uint8_t *> block_data(num_blocks);
+    std::vector<uint32_t> block_entry(num_blocks);
+    const uint8_t *block_ptr = ptr + 4 * num_blocks;
+    for (size_t i = 0; i < num_blocks; i++) {
+        block_entry.at(i) = read_header<uint32_t>(ptr);
+        block_data.at(i) = block_ptr;
+        size_t length = block_entry.at(i) & 0x7FFFFFFFU;
+        if (length > size_t(file_end - block_ptr))
+            log_error("Compressed chipdb '%s' is corrupt.\n", filename.c_str());
+        block_ptr += length;
+    }
+
+    // Allocated as 64-bit words so the database is suitably aligned; never freed, like the other chipdb sources
+    uint8_t *raw = reinterpret_cast<uint8_t *>(new uint64_t[(raw_size + 7) / 8]);
+    std::vector<char> ok(num_blocks, 0);
+    auto do_block = [&](size_t i) {
+        size_t offset = i * block_size, length = std::min(block_size, raw_size - offset);
+        uint32_t entry = block_entry.at(i);
+        if (entry & 0x80000000U) {
+            ok.at(i) = ((entry & 0x7FFFFFFFU) == length);
+            if (ok.at(i))
+                memcpy(raw + offset, block_data.at(i), length);
+        } else {
+            ok.at(i) = decompress_block(block_data.at(i), entry, raw + offset, length);
+        }
+    };
+#ifndef NPNR_DISABLE_THREADS
+    size_t num_threads = std::min<size_t>(num_blocks, available_cores());
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++)
+        threads.emplace_back([&, t]() {
+            for (size_t i = t; i < num_blocks; i += num_threads)
+                do_block(i);
+        });
+    for (auto &thread : threads)
+        thread.join();
+#else
+    for (size_t i = 0; i < num_blocks; i++)
+        do_block(i);
+#endif
+    if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+        log_error("Compressed chipdb '%s' is corrupt.\n", filename.c_str());
+
+    auto end = std::chrono::high_resolution_clock::now();
+    memory_track("chipdb", chipdb_bytes += raw_size);
+    log_info("Decompressed chipdb '%s' (%.1f MiB) in %.2fs\n", filename.c_str(), raw_size / (1024.0 * 1024.0),
+             std::chrono::duration<double>(end - start).count());
+    return raw;
+}
+
+} // namespace
+
+const void *get_chipdb(const std::string &filename)
+{
+    size_t size;
+    const void *data = get_raw_chipdb(filename, size);
+    if (data == nullptr || size < sizeof(compressed_magic) ||
+        memcmp(data, compressed_magic, sizeof(compressed_magic)) != 0)
+        return data;
+    static std::map<std::string, const void *> decompressed;
+    auto found = decompressed.find(filename);
+    if (found != decompressed.end())
+        return found->second;
+    const void *raw = decompress_chipdb(filename, data, size);
+    decompressed[filename] = raw;
+    return raw;
+}
+
+void chipdb_advise(const void *data, size_t size, ChipdbUse use)
+{
+#if !defined(WIN32)
+    if (data == nullptr || size == 0)
+        return;
+    // madvise needs a page aligned range; round outwards, which is harmless for a hint
+    uintptr_t page = uintptr_t(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = uintptr_t(data) & ~(page - 1);
+    uintptr_t end = (uintptr_t(data) + size + page - 1) & ~(page - 1);
+    // Failures are ignored; at worst pages are read in on first use as usual
+    madvise(reinterpret_cast<void *>(begin), end - begin, (use == ChipdbUse::HOT) ? MADV_WILLNEED : MADV_RANDOM);
+#endif
+}
+
 NEXTPNR_NAMESPACE_END
@@ -31,19 +31,43 @@ struct EmbeddedFile
 
     std::string filename;
     const void *content;
+    size_t size;
     EmbeddedFile *next = nullptr;
 
-    EmbeddedFile(const std::string &filename, const void *content) : filename(filename), content(content)
+    EmbeddedFile(const std::string &filename, const void *content, size_t size)
+            : filename(filename), content(content), size(size)
     {
         next = head;
         head = this;
     }
+
+    // The generated chipdb sources embed the database as a string literal, whose terminating NUL isn't part of it
+    template <size_t N>
+    EmbeddedFile(const std::string &filename, const char (&content)[N]) : EmbeddedFile(filename, content, N - 1)
+    {
+    }
 };
 
 #endif
 
 const void *get_chipdb(const std::string &filename);
 
+enum class ChipdbUse
+{
+    // Read during setup or by the placer and router; prefetched in the background
+    HOT,
+    // Only read for a few lookups, such as bitstream or package data; read in a page at a time, without readahead
+    COLD
+};
+
+// Hint how a range of chipdb data will be used, so that large databases load faster
+void chipdb_advise(const void *data, size_t size, ChipdbUse use);
+
+template <typename Slice> void chipdb_advise(const Slice &slice, ChipdbUse use)
+{
+    chipdb_advise(slice.begin(), slice.size() * sizeof(*slice.begin()), use);
+}
+
 NEXTPNR_NAMESPACE_END
 
 #endif // EMBED_H
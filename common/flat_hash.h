@@ -0,0 +1,273 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef FLAT_HASH_H
+#define FLAT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Included from nextpnr.h, after the namespace macros are defined
+NEXTPNR_NAMESPACE_BEGIN
+
+// Finalise a std::hash result before it picks a slot in a power-of-two table. The arch id hashes (and std::hash of
+// integers) are close to the identity, so consecutive ids would otherwise fill runs of neighbouring slots.
+inline size_t flat_hash_mix(size_t h)
+{
+    uint64_t x = h;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return size_t(x);
+}
+
+// Hash containers for the small, hot maps keyed by arch ids (the routing of a net, router search state, etc). Entries
+// are kept in one contiguous array, so iterating touches a single block of memory; once there are more than a few
+// entries, an open-addressing index over the array with linear probing is kept for lookups. Erasing moves the last
+// entry into the hole, so erase(iterator) returns the position of the next entry to visit. Unlike std::unordered_map,
+// any insertion or erasure invalidates iterators, pointers and references to entries.
+template <typename Key, typename Entry, typename KeyOf, typename Hash> class FlatHashTable
+{
+  public:
+    typedef Key key_type;
+    typedef Entry value_type;
+    typedef typename std::vector<Entry>::iterator iterator;
+    typedef typename std::vector<Entry>::const_iterator const_iterator;
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear()
+    {
+        entries.clear();
+        index.clear();
+    }
+    void reserve(size_t n)
+    {
+        entries.reserve(n);
+        if (n > index_threshold && 2 * n > index.size())
+            rebuild_index(n);
+    }
+
+    iterator find(const Key &key)
+    {
+        int i = lookup(key);
+        return (i == -1) ? entries.end() : (entries.begin() + i);
+    }
+    const_iterator find(const Key &key) const
+    {
+        int i = lookup(key);
+        return (i == -1) ? entries.end() : (entries.begin() + i);
+    }
+    size_t count(const Key &key) const { return lookup(key) != -1 ? 1 : 0; }
+
+    size_t erase(const Key &key)
+    {
+        int i = lookup(key);
+        if (i == -1)
+            return 0;
+        remove(i);
+        return 1;
+    }
+    iterator erase(iterator pos)
+    {
+        int i = int(pos - entries.begin());
+        remove(i);
+        return entries.begin() + i;
+    }
+
+  protected:
+    // Tables with at most this many entries are searched linearly, without an index
+    static const size_t index_threshold = 8;
+
+    std::vector<Entry> entries;
+    // Power-of-two sized table of entry indices, -1 for empty slots
+    std::vector<int32_t> index;
+
+    static const Key &key_of(const Entry &entry) { return KeyOf()(entry); }
+
+    size_t home_slot(const Key &key) const { return flat_hash_mix(Hash()(key)) & (index.size() - 1); }
+
+    int lookup(const Key &key) const
+    {
+        if (index.empty()) {
+            for (size_t i = 0; i < entries.size(); i++)
+                if (key_of(entries[i]) == key)
+                    return int(i);
+            return -1;
+        }
+        for (size_t slot = home_slot(key);; slot = (slot + 1) & (index.size() - 1)) {
+            int32_t i = index[slot];
+            if (i == -1 || key_of(entries[i]) == key)
+                return i;
+        }
+    }
+
+    // Add an entry, constructed from args, for a key known not to be present
+    template <typename... Args> iterator append(Args &&... args)
+    {
+        entries.emplace_back(std::forward<Args>(args)...);
+        int i = int(entries.size()) - 1;
+        // Keep the table at most half full
+        if (2 * entries.size() > index.size()) {
+            if (entries.size() > index_threshold)
+                rebuild_index(entries.size());
+        } else {
+            index_entry(i);
+        }
+        return entries.begin() + i;
+    }
+
+  private:
+    size_t slot_of(int i) const
+    {
+        size_t slot = home_slot(key_of(entries[i]));
+        while (index[slot] != i)
+            slot = (slot + 1) & (index.size() - 1);
+        return slot;
+    }
+
+    void index_entry(int i)
+    {
+        size_t slot = home_slot(key_of(entries[i]));
+        while (index[slot] != -1)
+            slot = (slot + 1) & (index.size() - 1);
+        index[slot] = i;
+    }
+
+    void rebuild_index(size_t n)
+    {
+        size_t slots = 16;
+        while (slots < 4 * n)
+            slots *= 2;
+        index.assign(slots, -1);
+        for (int i = 0; i < int(entries.size()); i++)
+            index_entry(i);
+    }
+
+    void remove(int i)
+    {
+        int last = int(entries.size()) - 1;
+        if (!index.empty()) {
+            // Backward-shift deletion, so that no tombstones are needed
+            size_t mask = index.size() - 1;
+            size_t hole = slot_of(i);
+            for (size_t slot = (hole + 1) & mask; index[slot] != -1; slot = (slot + 1) & mask) {
+                size_t home = home_slot(key_of(entries[index[slot]]));
+                bool stays = (hole <= slot) ? (hole < home && home <= slot) : (hole < home || home <= slot);
+                if (!stays) {
+                    index[hole] = index[slot];
+                    hole = slot;
+                }
+            }
+            index[hole] = -1;
+            if (i != last)
+                index[slot_of(last)] = i;
+        }
+        if (i != last)
+            entries[i] = std::move(entries[last]);
+        entries.pop_back();
+        if (entries.size() <= index_threshold / 2)
+            index.clear();
+    }
+};
+
+template <typename Key, typename Value> struct FlatHashMapKeyOf
+{
+    const Key &operator()(const std::pair<Key, Value> &entry) const { return entry.first; }
+};
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap : public FlatHashTable<Key, std::pair<Key, Value>, FlatHashMapKeyOf<Key, Value>, Hash>
+{
+    typedef FlatHashTable<Key, std::pair<Key, Value>, FlatHashMapKeyOf<Key, Value>, Hash> Base;
+
+  public:
+    typedef Value mapped_type;
+    typedef typename Base::iterator iterator;
+
+    Value &at(const Key &key)
+    {
+        int i = this->lookup(key);
+        if (i == -1)
+            throw std::out_of_range("FlatHashMap::at");
+        return this->entries[i].second;
+    }
+    const Value &at(const Key &key) const
+    {
+        int i = this->lookup(key);
+        if (i == -1)
+            throw std::out_of_range("FlatHashMap::at");
+        return this->entries[i].second;
+    }
+    Value &operator[](const Key &key) { return emplace(key).first->second; }
+
+    template <typename... Args> std::pair<iterator, bool> emplace(const Key &key, Args &&... args)
+    {
+        int i = this->lookup(key);
+        if (i != -1)
+            return std::make_pair(this->entries.begin() + i, false);
+        return std::make_pair(this->append(std::piecewise_construct, std::forward_as_tuple(key),
+                                           std::forward_as_tuple(std::forward<Args>(args)...)),
+                              true);
+    }
+    std::pair<iterator, bool> insert(const std::pair<Key, Value> &value) { return emplace(value.first, value.second); }
+};
+
+template <typename Key> struct FlatHashSetKeyOf
+{
+    const Key &operator()(const Key &entry) const { return entry; }
+};
+
+template <typename Key, typename Hash = std::hash<Key>>
+class FlatHashSet : public FlatHashTable<Key, Key, FlatHashSetKeyOf<Key>, Hash>
+{
+    typedef FlatHashTable<Key, Key, FlatHashSetKeyOf<Key>, Hash> Base;
+
+  public:
+    typedef typename Base::iterator iterator;
+
+    std::pair<iterator, bool> insert(const Key &key)
+    {
+        int i = this->lookup(key);
+        if (i != -1)
+            return std::make_pair(this->entries.begin() + i, false);
+        return std::make_pair(this->append(key), true);
+    }
+    template <typename It> void insert(It first, It last)
+    {
+        for (; first != last; ++first)
+            insert(*first);
+    }
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
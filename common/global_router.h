@@ -0,0 +1,90 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef GLOBAL_ROUTER_H
+#define GLOBAL_ROUTER_H
+
+#include <queue>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Route a sink of a global (e.g. clock) net onto the net's existing routing tree, for the arch specific global
+// routing passes. This is a backwards breadth-first search from dst through available pips accepted by
+// pip_filter, which stops at the first wire for which is_target returns true; normally any wire already bound
+// to the net. Once the trunk of a clock tree (spines, rows, branches) has been routed, most sinks join it within
+// a few steps, rather than every sink searching all the way back to the source.
+//
+// On success, the pips from the target wire down to dst are bound to net and the target wire is returned; the
+// target itself is left for the caller to bind if it isn't already part of the net. Returns WireId() if no target
+// is found within iter_limit wires.
+template <typename Ttgt, typename Tfilt>
+WireId route_to_global_tree(Context *ctx, NetInfo *net, WireId dst, int iter_limit, Ttgt is_target,
+                            Tfilt pip_filter, PlaceStrength strength = STRENGTH_LOCKED)
+{
+    if (is_target(dst))
+        return dst;
+
+    std::queue<WireId> visit;
+    // Wire -> downhill pip towards dst
+    std::unordered_map<WireId, PipId> backtrace;
+    visit.push(dst);
+    backtrace[dst] = PipId();
+
+    WireId found;
+    int iter = 0;
+    while (found == WireId() && !visit.empty() && iter++ < iter_limit) {
+        WireId cursor = visit.front();
+        visit.pop();
+        for (PipId pip : ctx->getPipsUphill(cursor)) {
+            // Skip pip if unavailable, and not because it's already used for this net
+            if (!ctx->checkPipAvail(pip) && ctx->getBoundPipNet(pip) != net)
+                continue;
+            WireId prev = ctx->getPipSrcWire(pip);
+            if (backtrace.count(prev))
+                continue;
+            bool target = is_target(prev);
+            if (!target && !ctx->checkWireAvail(prev))
+                continue;
+            if (!pip_filter(pip))
+                continue;
+            backtrace[prev] = pip;
+            if (target) {
+                found = prev;
+                break;
+            }
+            visit.push(prev);
+        }
+    }
+
+    if (found == WireId())
+        return found;
+
+    WireId cursor = found;
+    while (cursor != dst) {
+        PipId pip = backtrace.at(cursor);
+        ctx->bindPip(pip, net, strength);
+        cursor = ctx->getPipDstWire(pip);
+    }
+    return found;
+}
+
+NEXTPNR_NAMESPACE_END
+
+#endif
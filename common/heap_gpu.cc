@@ -0,0 +1,491 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "heap_gpu.h"
+#include "log.h"
+
+#ifdef NPNR_USE_OPENCL
+#define CL_TARGET_OPENCL_VERSION 120
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <string>
+#endif
+
+NEXTPNR_NAMESPACE_BEGIN
+
+#ifdef NPNR_USE_OPENCL
+
+namespace {
+const char *kernel_source = R"CL(
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+
+// y = A x
+__kernel void spmv(int n, __global const int *row_ptr, __global const int *cols, __global const double *vals,
+                   __global const double *x, __global double *y)
+{
+    int i = get_global_id(0);
+    if (i >= n)
+        return;
+    double sum = 0;
+    for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++)
+        sum += vals[k] * x[cols[k]];
+    y[i] = sum;
+}
+
+// Given ax = A x: the inverse diagonal of A for the preconditioner, r = b - A x and z = p = inv_diag * r
+__kernel void cg_start(int n, __global const int *row_ptr, __global const int *cols, __global const double *vals,
+                       __global const double *b, __global const double *ax, __global double *inv_diag,
+                       __global double *r, __global double *z, __global double *p)
+{
+    int i = get_global_id(0);
+    if (i >= n)
+        return;
+    double d = 0;
+    for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++)
+        if (cols[k] == i)
+            d = vals[k];
+    inv_diag[i] = (d != 0) ? 1 / d : 1;
+    r[i] = b[i] - ax[i];
+    z[i] = inv_diag[i] * r[i];
+    p[i] = z[i];
+}
+
+// x += alpha p, r -= alpha q (where q = A p) and z = inv_diag * r
+__kernel void cg_step(int n, double alpha, __global const double *p, __global const double *q,
+                      __global const double *inv_diag, __global double *x, __global double *r, __global double *z)
+{
+    int i = get_global_id(0);
+    if (i >= n)
+        return;
+    x[i] += alpha * p[i];
+    r[i] -= alpha * q[i];
+    z[i] = inv_diag[i] * r[i];
+}
+
+// p = z + beta p
+__kernel void cg_direction(int n, double beta, __global const double *z, __global double *p)
+{
+    int i = get_global_id(0);
+    if (i >= n)
+        return;
+    p[i] = z[i] + beta * p[i];
+}
+
+// The dot products a.b and c.d, as one partial sum of each per work group
+__kernel void dot2(int n, __global const double *a, __global const double *b, __global const double *c,
+                   __global const double *d, __global double *partial, __local double *scratch)
+{
+    int l = get_local_id(0);
+    double ab = 0, cd = 0;
+    for (int k = get_global_id(0); k < n; k += get_global_size(0)) {
+        ab += a[k] * b[k];
+        cd += c[k] * d[k];
+    }
+    scratch[2 * l] = ab;
+    scratch[2 * l + 1] = cd;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int stride = get_local_size(0) / 2; stride > 0; stride /= 2) {
+        if (l < stride) {
+            scratch[2 * l] += scratch[2 * (l + stride)];
+            scratch[2 * l + 1] += scratch[2 * (l + stride) + 1];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if (l == 0) {
+        partial[2 * get_group_id(0)] = scratch[0];
+        partial[2 * get_group_id(0) + 1] = scratch[1];
+    }
+}
+
+// The x and y spans of the bounding box of each net
+__kernel void net_span(int n_nets, __global const int *net_start, __global const int *pin_cell,
+                       __global const int *x, __global const int *y, __global int *span)
+{
+    int i = get_global_id(0);
+    if (i >= n_nets)
+        return;
+    int c = pin_cell[net_start[i]];
+    int x0 = x[c], x1 = x[c], y0 = y[c], y1 = y[c];
+    for (int k = net_start[i] + 1; k < net_start[i + 1]; k++) {
+        c = pin_cell[k];
+        x0 = min(x0, x[c]);
+        x1 = max(x1, x[c]);
+        y0 = min(y0, y[c]);
+        y1 = max(y1, y[c]);
+    }
+    span[2 * i] = x1 - x0;
+    span[2 * i + 1] = y1 - y0;
+}
+)CL";
+
+// Work groups for the dot products, each giving one partial sum that is added up on the host
+const int dot_groups = 64;
+
+// A device buffer that only grows, so that repeated solves of similar size don't reallocate
+struct DeviceBuffer
+{
+    cl_mem mem = nullptr;
+    size_t size = 0;
+
+    ~DeviceBuffer()
+    {
+        if (mem != nullptr)
+            clReleaseMemObject(mem);
+    }
+
+    cl_int reserve(cl_context context, size_t bytes)
+    {
+        if (bytes <= size && mem != nullptr)
+            return CL_SUCCESS;
+        if (mem != nullptr)
+            clReleaseMemObject(mem);
+        cl_int err;
+        size = std::max<size_t>(bytes, 1);
+        mem = clCreateBuffer(context, CL_MEM_READ_WRITE, size, nullptr, &err);
+        if (err != CL_SUCCESS) {
+            mem = nullptr;
+            size = 0;
+        }
+        return err;
+    }
+};
+} // namespace
+
+struct HeapGpu::Impl
+{
+    cl_context context = nullptr;
+    cl_command_queue queue = nullptr;
+    cl_program program = nullptr;
+    cl_kernel k_spmv = nullptr, k_cg_start = nullptr, k_cg_step = nullptr, k_cg_direction = nullptr,
+              k_dot2 = nullptr, k_net_span = nullptr;
+    size_t local_size = 64;
+
+    DeviceBuffer row_ptr, cols, vals, b, x, r, z, p, q, inv_diag, partial;
+    DeviceBuffer net_start, pin_cell, cell_x, cell_y, span;
+    int n_nets = 0;
+
+    // Solves are serialised, as they share the buffers and queue
+    std::mutex mutex;
+    // Set after the first failure, after which the CPU is always used
+    bool failed = false;
+
+    ~Impl()
+    {
+        for (cl_kernel k : {k_spmv, k_cg_start, k_cg_step, k_cg_direction, k_dot2, k_net_span})
+            if (k != nullptr)
+                clReleaseKernel(k);
+        if (program != nullptr)
+            clReleaseProgram(program);
+        if (queue != nullptr)
+            clReleaseCommandQueue(queue);
+        if (context != nullptr)
+            clReleaseContext(context);
+    }
+
+    bool check(cl_int err, const char *what)
+    {
+        if (err == CL_SUCCESS)
+            return true;
+        if (!failed)
+            log_warning("OpenCL error %d in %s, using the CPU for the rest of placement.\n", int(err), what);
+        failed = true;
+        return false;
+    }
+
+    size_t global_size(size_t n) const { return ((n + local_size - 1) / local_size) * local_size; }
+
+    bool run(cl_kernel kernel, size_t items, const char *what)
+    {
+        size_t global = global_size(items);
+        return check(clEnqueueNDRangeKernel(queue, kernel, 1, nullptr, &global, &local_size, 0, nullptr, nullptr),
+                     what);
+    }
+
+    template <typename T> bool write(DeviceBuffer &buf, const T *data, size_t count, const char *what)
+    {
+        return check(buf.reserve(context, count * sizeof(T)), what) &&
+               check(clEnqueueWriteBuffer(queue, buf.mem, CL_TRUE, 0, count * sizeof(T), data, 0, nullptr, nullptr),
+                     what);
+    }
+
+    template <typename T> bool read(DeviceBuffer &buf, T *data, size_t count, const char *what)
+    {
+        return check(clEnqueueReadBuffer(queue, buf.mem, CL_TRUE, 0, count * sizeof(T), data, 0, nullptr, nullptr),
+                     what);
+    }
+
+    template <typename T> bool set_arg(cl_kernel kernel, cl_uint idx, const T &value)
+    {
+        return check(clSetKernelArg(kernel, idx, sizeof(T), &value), "clSetKernelArg");
+    }
+
+    bool set_buf(cl_kernel kernel, cl_uint idx, DeviceBuffer &buf) { return set_arg(kernel, idx, buf.mem); }
+
+    // The dot products a.b and c.d
+    bool dot2(cl_int n, DeviceBuffer &a, DeviceBuffer &b, DeviceBuffer &c, DeviceBuffer &d, double &ab, double &cd)
+    {
+        std::vector<double> sums(2 * dot_groups);
+        size_t global = dot_groups * local_size;
+        if (!(set_arg(k_dot2, 0, n) && set_buf(k_dot2, 1, a) && set_buf(k_dot2, 2, b) && set_buf(k_dot2, 3, c) &&
+              set_buf(k_dot2, 4, d) && set_buf(k_dot2, 5, partial) &&
+              check(clSetKernelArg(k_dot2, 6, 2 * local_size * sizeof(double), nullptr), "clSetKernelArg") &&
+              check(clEnqueueNDRangeKernel(queue, k_dot2, 1, nullptr, &global, &local_size, 0, nullptr, nullptr),
+                    "dot2") &&
+              read(partial, sums.data(), sums.size(), "dot2")))
+            return false;
+        ab = cd = 0;
+        for (int i = 0; i < dot_groups; i++) {
+            ab += sums.at(2 * i);
+            cd += sums.at(2 * i + 1);
+        }
+        return true;
+    }
+};
+
+HeapGpu::HeapGpu() : impl(new Impl) {}
+HeapGpu::~HeapGpu() {}
+
+std::unique_ptr<HeapGpu> HeapGpu::create()
+{
+    cl_uint n_platforms = 0;
+    if (clGetPlatformIDs(0, nullptr, &n_platforms) != CL_SUCCESS || n_platforms == 0) {
+        log_warning("No OpenCL platforms found, solving on the CPU.\n");
+        return nullptr;
+    }
+    std::vector<cl_platform_id> platforms(n_platforms);
+    clGetPlatformIDs(n_platforms, platforms.data(), nullptr);
+
+    // The first GPU with double precision support
+    cl_device_id device = nullptr;
+    for (auto platform : platforms) {
+        cl_uint n_devices = 0;
+        if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 0, nullptr, &n_devices) != CL_SUCCESS || n_devices == 0)
+            continue;
+        std::vector<cl_device_id> devices(n_devices);
+        clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, n_devices, devices.data(), nullptr);
+        for (auto dev : devices) {
+            size_t len = 0;
+            clGetDeviceInfo(dev, CL_DEVICE_EXTENSIONS, 0, nullptr, &len);
+            std::string extensions(len, '\0');
+            clGetDeviceInfo(dev, CL_DEVICE_EXTENSIONS, len, &extensions[0], nullptr);
+            if (extensions.find("cl_khr_fp64") != std::string::npos) {
+                device = dev;
+                break;
+            }
+        }
+        if (device != nullptr)
+            break;
+    }
+    if (device == nullptr) {
+        log_warning("No OpenCL GPU with double precision support found, solving on the CPU.\n");
+        return nullptr;
+    }
+
+    std::unique_ptr<HeapGpu> gpu(new HeapGpu);
+    Impl &g = *gpu->impl;
+    cl_int err;
+    g.context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+    if (!g.check(err, "clCreateContext"))
+        return nullptr;
+    g.queue = clCreateCommandQueue(g.context, device, 0, &err);
+    if (!g.check(err, "clCreateCommandQueue"))
+        return nullptr;
+    g.program = clCreateProgramWithSource(g.context, 1, &kernel_source, nullptr, &err);
+    if (!g.check(err, "clCreateProgramWithSource"))
+        return nullptr;
+    if (clBuildProgram(g.program, 1, &device, "", nullptr, nullptr) != CL_SUCCESS) {
+        size_t len = 0;
+        clGetProgramBuildInfo(g.program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &len);
+        std::string build_log(len, '\0');
+        clGetProgramBuildInfo(g.program, device, CL_PROGRAM_BUILD_LOG, len, &build_log[0], nullptr);
+        log_warning("Failed to build the OpenCL kernels, solving on the CPU:\n%s\n", build_log.c_str());
+        return nullptr;
+    }
+    std::pair<cl_kernel *, const char *> kernels[] = {{&g.k_spmv, "spmv"},
+                                                      {&g.k_cg_start, "cg_start"},
+                                                      {&g.k_cg_step, "cg_step"},
+                                                      {&g.k_cg_direction, "cg_direction"},
+                                                      {&g.k_dot2, "dot2"},
+                                                      {&g.k_net_span, "net_span"}};
+    for (auto &k : kernels) {
+        *k.first = clCreateKernel(g.program, k.second, &err);
+        if (!g.check(err, "clCreateKernel"))
+            return nullptr;
+    }
+
+    // The largest power of two work group size up to 256 that the device supports, as the dot product reduction needs
+    size_t max_group = 64;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_group), &max_group, nullptr);
+    g.local_size = 1;
+    while (g.local_size * 2 <= std::min<size_t>(max_group, 256))
+        g.local_size *= 2;
+    if (!g.check(g.partial.reserve(g.context, 2 * dot_groups * sizeof(double)), "clCreateBuffer"))
+        return nullptr;
+
+    size_t len = 0;
+    clGetDeviceInfo(device, CL_DEVICE_NAME, 0, nullptr, &len);
+    std::string name(len, '\0');
+    clGetDeviceInfo(device, CL_DEVICE_NAME, len, &name[0], nullptr);
+    log_info("Using OpenCL device '%s' for the placer's equation solves.\n", name.c_str());
+    return gpu;
+}
+
+bool HeapGpu::solve(int n, const int *row_ptr, const int *cols, const double *vals, const double *b, double *x,
+                    double tolerance, int &iterations, double &error)
+{
+    Impl &g = *impl;
+    std::lock_guard<std::mutex> lock(g.mutex);
+    if (g.failed)
+        return false;
+    iterations = 0;
+    error = 0;
+    double b_norm2 = 0;
+    for (int i = 0; i < n; i++)
+        b_norm2 += b[i] * b[i];
+    if (b_norm2 == 0) {
+        std::fill(x, x + n, 0.0);
+        return true;
+    }
+    int nnz = row_ptr[n];
+    if (!(g.write(g.row_ptr, row_ptr, n + 1, "upload") && g.write(g.cols, cols, nnz, "upload") &&
+          g.write(g.vals, vals, nnz, "upload") && g.write(g.b, b, n, "upload") && g.write(g.x, x, n, "upload")))
+        return false;
+    for (DeviceBuffer *buf : {&g.r, &g.z, &g.p, &g.q, &g.inv_diag})
+        if (!g.check(buf->reserve(g.context, n * sizeof(double)), "clCreateBuffer"))
+            return false;
+
+    cl_int cn = n;
+    if (!(g.set_arg(g.k_spmv, 0, cn) && g.set_buf(g.k_spmv, 1, g.row_ptr) && g.set_buf(g.k_spmv, 2, g.cols) &&
+          g.set_buf(g.k_spmv, 3, g.vals) && g.set_buf(g.k_spmv, 4, g.x) && g.set_buf(g.k_spmv, 5, g.q) &&
+          g.run(g.k_spmv, n, "spmv")))
+        return false;
+    if (!(g.set_arg(g.k_cg_start, 0, cn) && g.set_buf(g.k_cg_start, 1, g.row_ptr) &&
+          g.set_buf(g.k_cg_start, 2, g.cols) && g.set_buf(g.k_cg_start, 3, g.vals) && g.set_buf(g.k_cg_start, 4, g.b) &&
+          g.set_buf(g.k_cg_start, 5, g.q) && g.set_buf(g.k_cg_start, 6, g.inv_diag) &&
+          g.set_buf(g.k_cg_start, 7, g.r) && g.set_buf(g.k_cg_start, 8, g.z) && g.set_buf(g.k_cg_start, 9, g.p) &&
+          g.run(g.k_cg_start, n, "cg_start")))
+        return false;
+    // From here on, the spmv kernel computes q = A p
+    if (!(g.set_buf(g.k_spmv, 4, g.p) && g.set_arg(g.k_cg_step, 0, cn) && g.set_buf(g.k_cg_step, 2, g.p) &&
+          g.set_buf(g.k_cg_step, 3, g.q) && g.set_buf(g.k_cg_step, 4, g.inv_diag) && g.set_buf(g.k_cg_step, 5, g.x) &&
+          g.set_buf(g.k_cg_step, 6, g.r) && g.set_buf(g.k_cg_step, 7, g.z) && g.set_arg(g.k_cg_direction, 0, cn) &&
+          g.set_buf(g.k_cg_direction, 2, g.z) && g.set_buf(g.k_cg_direction, 3, g.p)))
+        return false;
+
+    double rz, r_norm2;
+    if (!g.dot2(cn, g.r, g.z, g.r, g.r, rz, r_norm2))
+        return false;
+    double threshold = double(tolerance) * double(tolerance) * b_norm2;
+    int max_iters = 2 * n;
+    while (r_norm2 >= threshold && iterations < max_iters) {
+        double pq, unused;
+        if (!(g.run(g.k_spmv, n, "spmv") && g.dot2(cn, g.p, g.q, g.p, g.p, pq, unused)))
+            return false;
+        cl_double alpha = rz / pq;
+        double rz_next;
+        if (!(g.set_arg(g.k_cg_step, 1, alpha) && g.run(g.k_cg_step, n, "cg_step") &&
+              g.dot2(cn, g.r, g.z, g.r, g.r, rz_next, r_norm2)))
+            return false;
+        iterations++;
+        if (r_norm2 < threshold)
+            break;
+        cl_double beta = rz_next / rz;
+        rz = rz_next;
+        if (!(g.set_arg(g.k_cg_direction, 1, beta) && g.run(g.k_cg_direction, n, "cg_direction")))
+            return false;
+    }
+    if (!g.read(g.x, x, n, "download"))
+        return false;
+    error = std::sqrt(r_norm2 / b_norm2);
+    return true;
+}
+
+bool HeapGpu::set_nets(const std::vector<int> &net_start, const std::vector<int> &pin_cell)
+{
+    Impl &g = *impl;
+    std::lock_guard<std::mutex> lock(g.mutex);
+    if (g.failed)
+        return false;
+    g.n_nets = int(net_start.size()) - 1;
+    return g.write(g.net_start, net_start.data(), net_start.size(), "upload") &&
+           g.write(g.pin_cell, pin_cell.data(), pin_cell.size(), "upload") &&
+           g.check(g.span.reserve(g.context, 2 * std::max(g.n_nets, 1) * sizeof(cl_int)), "clCreateBuffer");
+}
+
+bool HeapGpu::net_spans(const std::vector<int> &x, const std::vector<int> &y, int64_t &span_x, int64_t &span_y)
+{
+    Impl &g = *impl;
+    std::lock_guard<std::mutex> lock(g.mutex);
+    if (g.failed)
+        return false;
+    span_x = span_y = 0;
+    if (g.n_nets <= 0)
+        return true;
+    cl_int n_nets = g.n_nets;
+    std::vector<int> spans(2 * n_nets);
+    if (!(g.write(g.cell_x, x.data(), x.size(), "upload") && g.write(g.cell_y, y.data(), y.size(), "upload") &&
+          g.set_arg(g.k_net_span, 0, n_nets) && g.set_buf(g.k_net_span, 1, g.net_start) &&
+          g.set_buf(g.k_net_span, 2, g.pin_cell) && g.set_buf(g.k_net_span, 3, g.cell_x) &&
+          g.set_buf(g.k_net_span, 4, g.cell_y) && g.set_buf(g.k_net_span, 5, g.span) &&
+          g.run(g.k_net_span, n_nets, "net_span") && g.read(g.span, spans.data(), spans.size(), "download")))
+        return false;
+    for (int i = 0; i < n_nets; i++) {
+        span_x += spans.at(2 * i);
+        span_y += spans.at(2 * i + 1);
+    }
+    return true;
+}
+
+#else
+
+struct HeapGpu::Impl
+{
+};
+
+HeapGpu::HeapGpu() : impl(new Impl) {}
+HeapGpu::~HeapGpu() {}
+
+std::unique_ptr<HeapGpu> HeapGpu::create()
+{
+    log_warning("nextpnr was built without OpenCL (USE_OPENCL), solving on the CPU.\n");
+    return nullptr;
+}
+
+bool HeapGpu::solve(int n, const int *row_ptr, const int *cols, const double *vals, const double *b, double *x,
+                    double tolerance, int &iterations, double &error)
+{
+    return false;
+}
+
+bool HeapGpu::set_nets(const std::vector<int> &net_start, const std::vector<int> &pin_cell) { return false; }
+
+bool HeapGpu::net_spans(const std::vector<int> &x, const std::vector<int> &y, int64_t &span_x, int64_t &span_y)
+{
+    return false;
+}
+
+#endif
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,58 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef HEAP_GPU_H
+#define HEAP_GPU_H
+
+#include <memory>
+#include <vector>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Offload of the HeAP placer's conjugate gradient solves and wirelength evaluation to a GPU, through OpenCL, for very
+// large designs. This needs nextpnr to be built with USE_OPENCL, and a device with double precision support. Any
+// failure is reported by returning false, after which the placer carries on with Eigen on the CPU.
+struct HeapGpu
+{
+    // Set up the first suitable device, or return nullptr with a warning if there is none
+    static std::unique_ptr<HeapGpu> create();
+    ~HeapGpu();
+
+    // Solve the symmetric system A x = b, with A as n rows in compressed row form and x holding the initial guess, by
+    // conjugate gradient with a Jacobi preconditioner. Stops once the residual is below tolerance relative to b, or
+    // after 2n iterations, like Eigen's ConjugateGradient. May be called from several threads, one solve at a time
+    bool solve(int n, const int *row_ptr, const int *cols, const double *vals, const double *b, double *x,
+               double tolerance, int &iterations, double &error);
+
+    // Upload the pins of the nets to evaluate, as the index of the cell of each pin with the pins of net i at
+    // [net_start[i], net_start[i + 1]); every net needs at least one pin
+    bool set_nets(const std::vector<int> &net_start, const std::vector<int> &pin_cell);
+    // Sum over the nets of the x and y spans of their bounding boxes, given the location of each cell
+    bool net_spans(const std::vector<int> &x, const std::vector<int> &y, int64_t &span_x, int64_t &span_y);
+
+  private:
+    HeapGpu();
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
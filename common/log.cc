@@ -17,8 +17,10 @@
  *
  */
 
+#include <condition_variable>
 #include <list>
 #include <map>
+#include <mutex>
 #include <set>
 #include <stdarg.h>
 #include <stdio.h>
@@ -42,6 +44,100 @@ std::unordered_map<LogLevel, int> message_count_by_level;
 static int log_newline_count = 0;
 bool had_nonfatal_error = false;
 
+#ifndef NPNR_DISABLE_THREADS
+// Guards the counters above and writing to log_streams, so that messages can be logged from any thread
+static std::mutex log_mutex;
+
+// When logging asynchronously, messages are queued for a writer thread instead of being written by the thread logging
+// them. Messages of a level above plain log() are flushed out straight away, so that only the volume of debug output
+// is deferred
+namespace {
+struct AsyncLog
+{
+    std::unique_ptr<boost::thread> writer;
+    std::condition_variable queued_cv, drained_cv;
+    std::vector<std::pair<std::string, LogLevel>> queue;
+    // Whether the writer is writing out a batch it took from the queue
+    bool writing = false;
+    bool stop = false;
+
+    ~AsyncLog()
+    {
+        if (writer == nullptr)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(log_mutex);
+            stop = true;
+        }
+        queued_cv.notify_all();
+        writer->join();
+    }
+};
+AsyncLog async_log;
+} // namespace
+#endif
+
+static void write_to_streams(const std::string &str, LogLevel level)
+{
+    for (auto f : log_streams)
+        if (f.second <= level)
+            *f.first << str;
+}
+
+#ifndef NPNR_DISABLE_THREADS
+static void async_log_writer()
+{
+    std::vector<std::pair<std::string, LogLevel>> batch;
+    std::unique_lock<std::mutex> lock(log_mutex);
+    while (true) {
+        async_log.queued_cv.wait(lock, []() { return async_log.stop || !async_log.queue.empty(); });
+        if (async_log.queue.empty() && async_log.stop)
+            return;
+        std::swap(batch, async_log.queue);
+        async_log.writing = true;
+        // While async logging is on, only this thread writes to the streams, so they can be written without the lock
+        lock.unlock();
+        for (auto &message : batch)
+            write_to_streams(message.first, message.second);
+        batch.clear();
+        lock.lock();
+        async_log.writing = false;
+        async_log.drained_cv.notify_all();
+    }
+}
+#endif
+
+void log_set_async(bool async)
+{
+#ifndef NPNR_DISABLE_THREADS
+    if (async == (async_log.writer != nullptr))
+        return;
+    if (async) {
+        async_log.stop = false;
+        async_log.writer.reset(new boost::thread(async_log_writer));
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(log_mutex);
+            async_log.stop = true;
+        }
+        async_log.queued_cv.notify_all();
+        async_log.writer->join();
+        async_log.writer.reset();
+    }
+#else
+    (void)async;
+#endif
+}
+
+bool log_is_async()
+{
+#ifndef NPNR_DISABLE_THREADS
+    return async_log.writer != nullptr;
+#else
+    return false;
+#endif
+}
+
 std::string stringf(const char *fmt, ...)
 {
     std::string string;
@@ -98,22 +194,36 @@ void logv(const char *format, va_list ap, LogLevel level = LogLevel::LOG_MSG)
     if (str.empty())
         return;
 
-    size_t nnl_pos = str.find_last_not_of('\n');
-    if (nnl_pos == std::string::npos)
-        log_newline_count += str.size();
-    else
-        log_newline_count = str.size() - nnl_pos - 1;
-
-    for (auto f : log_streams)
-        if (f.second <= level)
-            *f.first << str;
+    {
+#ifndef NPNR_DISABLE_THREADS
+        std::lock_guard<std::mutex> lock(log_mutex);
+#endif
+        size_t nnl_pos = str.find_last_not_of('\n');
+        if (nnl_pos == std::string::npos)
+            log_newline_count += str.size();
+        else
+            log_newline_count = str.size() - nnl_pos - 1;
+
+#ifndef NPNR_DISABLE_THREADS
+        if (async_log.writer != nullptr) {
+            async_log.queue.emplace_back(str, level);
+            async_log.queued_cv.notify_one();
+        } else
+#endif
+            write_to_streams(str, level);
+    }
     if (log_write_function)
         log_write_function(str);
 }
 
 void log_with_level(LogLevel level, const char *format, ...)
 {
-    message_count_by_level[level]++;
+    {
+#ifndef NPNR_DISABLE_THREADS
+        std::lock_guard<std::mutex> lock(log_mutex);
+#endif
+        message_count_by_level[level]++;
+    }
     va_list ap;
     va_start(ap, format);
     logv(format, ap, level);
@@ -191,6 +301,10 @@ void log_nonfatal_error(const char *format, ...)
 
 void log_flush()
 {
+#ifndef NPNR_DISABLE_THREADS
+    std::unique_lock<std::mutex> lock(log_mutex);
+    async_log.drained_cv.wait(lock, []() { return async_log.queue.empty() && !async_log.writing; });
+#endif
     for (auto f : log_streams)
         f.first->flush();
 }
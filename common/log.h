@@ -70,8 +70,28 @@ void log_warning(const char *format, ...) NPNR_ATTRIBUTE(format(printf, 1, 2));
 NPNR_NORETURN void log_error(const char *format, ...) NPNR_ATTRIBUTE(format(printf, 1, 2), noreturn);
 void log_nonfatal_error(const char *format, ...) NPNR_ATTRIBUTE(format(printf, 1, 2));
 void log_break();
+// Writes out any queued messages and flushes all streams
 void log_flush();
 
+// Whether messages are written by a background thread, so that heavy debug output doesn't hold up the threads logging
+// it. log_flush() waits for the queue to be written; streams should only be changed while logging synchronously
+void log_set_async(bool async);
+bool log_is_async();
+
+// Log a debug message when cond (usually ctx->debug) holds, only evaluating the arguments then. Builds with
+// NPNR_DISABLE_DEBUG_LOG leave these out altogether
+#ifdef NPNR_DISABLE_DEBUG_LOG
+#define log_debug_if(cond, ...)                                                                                        \
+    do {                                                                                                               \
+    } while (0)
+#else
+#define log_debug_if(cond, ...)                                                                                        \
+    do {                                                                                                               \
+        if (cond)                                                                                                      \
+            NEXTPNR_NAMESPACE_PREFIX log(__VA_ARGS__);                                                                 \
+    } while (0)
+#endif
+
 static inline void log_assert_worker(bool cond, const char *expr, const char *file, int line)
 {
     if (!cond)
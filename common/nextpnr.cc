@@ -18,10 +18,19 @@
  */
 
 #include "nextpnr.h"
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
+#include <cmath>
+#include <fstream>
+#include <numeric>
 #include "design_utils.h"
 #include "log.h"
 #include "util.h"
+#include "worker_pool.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
 
 #if defined(__wasm)
 extern "C" {
@@ -45,30 +54,76 @@ assertion_failure::assertion_failure(std::string msg, std::string expr_str, std:
     log_flush();
 }
 
-void IdString::set(const BaseCtx *ctx, const std::string &s)
+IdStringDb::IdStringDb() : count(0)
 {
-    auto it = ctx->idstring_str_to_idx->find(s);
-    if (it == ctx->idstring_str_to_idx->end()) {
-        index = ctx->idstring_idx_to_str->size();
-        auto insert_rc = ctx->idstring_str_to_idx->insert({s, index});
-        ctx->idstring_idx_to_str->push_back(&insert_rc.first->first);
-    } else {
-        index = it->second;
+    for (auto &chunk : chunks)
+        chunk.store(nullptr, std::memory_order_relaxed);
+}
+
+IdStringDb::~IdStringDb()
+{
+    for (auto &chunk : chunks)
+        delete[] chunk.load(std::memory_order_relaxed);
+}
+
+void IdStringDb::set_str(int idx, const std::string *s)
+{
+    int chunk = idx >> chunk_bits;
+    NPNR_ASSERT(chunk < max_chunks);
+    const std::string **entries = chunks[chunk].load(std::memory_order_acquire);
+    if (entries == nullptr) {
+        std::lock_guard<std::mutex> lock(chunk_mutex);
+        entries = chunks[chunk].load(std::memory_order_relaxed);
+        if (entries == nullptr) {
+            entries = new const std::string *[chunk_size]();
+            chunks[chunk].store(entries, std::memory_order_release);
+        }
     }
+    entries[idx & (chunk_size - 1)] = s;
 }
 
-const std::string &IdString::str(const BaseCtx *ctx) const { return *ctx->idstring_idx_to_str->at(index); }
+int IdStringDb::intern(const std::string &s)
+{
+    Shard &shard = get_shard(s);
+    // The string is stored before the shard is unlocked, so any thread that gets the index from the shard, or from
+    // this thread, can look it up
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.str_to_idx.find(s);
+    if (found != shard.str_to_idx.end())
+        return found->second;
+    int idx = count.fetch_add(1);
+    auto inserted = shard.str_to_idx.emplace(s, idx);
+    set_str(idx, &inserted.first->first);
+    return idx;
+}
 
-const char *IdString::c_str(const BaseCtx *ctx) const { return str(ctx).c_str(); }
+int IdStringDb::lookup(const std::string &s)
+{
+    Shard &shard = get_shard(s);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.str_to_idx.find(s);
+    return (found != shard.str_to_idx.end()) ? found->second : -1;
+}
 
-void IdString::initialize_add(const BaseCtx *ctx, const char *s, int idx)
+void IdStringDb::add(const std::string &s, int idx)
 {
-    NPNR_ASSERT(ctx->idstring_str_to_idx->count(s) == 0);
-    NPNR_ASSERT(int(ctx->idstring_idx_to_str->size()) == idx);
-    auto insert_rc = ctx->idstring_str_to_idx->insert({s, idx});
-    ctx->idstring_idx_to_str->push_back(&insert_rc.first->first);
+    Shard &shard = get_shard(s);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    NPNR_ASSERT(shard.str_to_idx.count(s) == 0);
+    NPNR_ASSERT(size() == idx);
+    count.fetch_add(1);
+    auto inserted = shard.str_to_idx.emplace(s, idx);
+    set_str(idx, &inserted.first->first);
 }
 
+void IdString::set(const BaseCtx *ctx, const std::string &s) { index = ctx->idstring_db->intern(s); }
+
+const std::string &IdString::str(const BaseCtx *ctx) const { return ctx->idstring_db->str(index); }
+
+const char *IdString::c_str(const BaseCtx *ctx) const { return str(ctx).c_str(); }
+
+void IdString::initialize_add(const BaseCtx *ctx, const char *s, int idx) { ctx->idstring_db->add(s, idx); }
+
 TimingConstrObjectId BaseCtx::timingWildcardObject()
 {
     TimingConstrObjectId id;
@@ -146,18 +201,18 @@ TimingConstrObjectId BaseCtx::timingPortObject(CellInfo *cell, IdString port)
     }
 }
 
-Property::Property() : is_string(false), str(""), intval(0) {}
+Property::Property() : is_string(false), str(""), intval(0), width(0) {}
 
-Property::Property(int64_t intval, int width) : is_string(false), intval(intval)
+Property::Property(int64_t intval, int width) : is_string(false), intval(intval), width(width)
 {
-    str.reserve(width);
-    for (int i = 0; i < width; i++)
-        str.push_back((intval & (1ULL << i)) ? S1 : S0);
+    planes.resize(2 * ((width + 63) / 64), 0);
+    if (width > 0)
+        planes[0] = uint64_t(intval) & ((width >= 64) ? ~0ULL : ((1ULL << width) - 1));
 }
 
-Property::Property(const std::string &strval) : is_string(true), str(strval), intval(0xDEADBEEF) {}
+Property::Property(const std::string &strval) : is_string(true), str(strval), intval(0xDEADBEEF), width(0) {}
 
-Property::Property(State bit) : is_string(false), str(std::string("") + char(bit)), intval(bit == S1) {}
+Property::Property(State bit) : is_string(false), str(""), intval(bit == S1), width(0) { push_back(bit); }
 
 void CellInfo::addInput(IdString name)
 {
@@ -200,7 +255,10 @@ std::string Property::to_string() const
             result += " ";
         return result;
     } else {
-        return std::string(str.rbegin(), str.rend());
+        std::string result(width, S0);
+        for (int i = 0; i < width; i++)
+            result[width - 1 - i] = get(i);
+        return result;
     }
 }
 
@@ -210,8 +268,9 @@ Property Property::from_string(const std::string &s)
 
     size_t cursor = s.find_first_not_of("01xz");
     if (cursor == std::string::npos) {
-        p.str = std::string(s.rbegin(), s.rend());
-        p.is_string = false;
+        p.planes.reserve(2 * ((s.size() + 63) / 64));
+        for (auto it = s.rbegin(); it != s.rend(); ++it)
+            p.push_back(State(*it));
         p.update_intval();
     } else if (s.find_first_not_of(' ', cursor) == std::string::npos) {
         p = Property(s.substr(0, s.size() - 1));
@@ -239,12 +298,32 @@ void BaseCtx::removeConstraint(IdString constrName)
         constrsFrom.erase(std::find(fromConstrs.first, fromConstrs.second, std::make_pair(fromObj, constr)));
     }
     for (auto toObj : constr->to) {
-        auto toConstrs = constrsFrom.equal_range(toObj);
-        constrsFrom.erase(std::find(toConstrs.first, toConstrs.second, std::make_pair(toObj, constr)));
+        auto toConstrs = constrsTo.equal_range(toObj);
+        constrsTo.erase(std::find(toConstrs.first, toConstrs.second, std::make_pair(toObj, constr)));
     }
     constraints.erase(constrName);
 }
 
+TimingConstrObjectId BaseCtx::timingObjectByName(IdString name)
+{
+    const std::string &str = name.str(this);
+    if (str == "*")
+        return timingWildcardObject();
+    if (cells.count(name))
+        return timingCellObject(cells.at(name).get());
+    if (nets.count(name) || net_aliases.count(name)) {
+        NetInfo *net = getNetByAlias(name);
+        return net->clkconstr ? timingClockDomainObject(net) : timingNetObject(net);
+    }
+    size_t dot = str.rfind('.');
+    if (dot != std::string::npos) {
+        IdString cell = id(str.substr(0, dot)), port = id(str.substr(dot + 1));
+        if (cells.count(cell) && cells.at(cell)->ports.count(port))
+            return timingPortObject(cells.at(cell).get(), port);
+    }
+    log_error("No cell, net or cell port named '%s' for timing constraint.\n", str.c_str());
+}
+
 const char *BaseCtx::nameOfBel(BelId bel) const
 {
     const Context *ctx = getCtx();
@@ -305,6 +384,60 @@ WireId Context::getNetinfoSinkWire(const NetInfo *net_info, const PortRef &user_
     return getBelPinWire(dst_bel, user_port);
 }
 
+// Get the (max, min) routed delay to sink, returning false if the sink isn't routed
+static bool netinfo_routed_delay(const Context *ctx, const NetInfo *net_info, WireId src_wire, const PortRef &user_info,
+                                 std::pair<delay_t, delay_t> &routed)
+{
+    std::lock_guard<std::mutex> lock(net_info->wire_delays_mutex);
+    auto &wire_delays = net_info->wire_delays;
+    if (!wire_delays.count(src_wire)) {
+        // Find the delay to every wire of the net at once, by walking uphill from each wire until reaching one whose
+        // delay is already known; wires that don't lead back to the source are left out
+        wire_delays.clear();
+        DelayInfo src_delay = ctx->getWireDelay(src_wire);
+        wire_delays[src_wire] = std::make_pair(src_delay.maxDelay(), src_delay.minDelay());
+        FlatHashSet<WireId> unreachable;
+        std::vector<WireId> path;
+        for (auto &w : net_info->wires) {
+            WireId cursor = w.first;
+            path.clear();
+            while (cursor != WireId() && !wire_delays.count(cursor) && !unreachable.count(cursor)) {
+                auto it = net_info->wires.find(cursor);
+                // Also stop at loops in the routing, which can't reach the source
+                if (it == net_info->wires.end() || it->second.pip == PipId() ||
+                    path.size() > net_info->wires.size()) {
+                    cursor = WireId();
+                    break;
+                }
+                path.push_back(cursor);
+                cursor = ctx->getPipSrcWire(it->second.pip);
+            }
+            auto found = (cursor == WireId()) ? wire_delays.end() : wire_delays.find(cursor);
+            if (found == wire_delays.end()) {
+                unreachable.insert(path.begin(), path.end());
+                unreachable.insert(w.first);
+                continue;
+            }
+            auto delay = found->second;
+            for (auto it = path.rbegin(); it != path.rend(); ++it) {
+                DelayInfo pip_delay = ctx->getPipDelay(net_info->wires.at(*it).pip);
+                DelayInfo wire_delay = ctx->getWireDelay(*it);
+                delay.first += pip_delay.maxDelay();
+                delay.first += wire_delay.maxDelay();
+                delay.second += pip_delay.minDelay();
+                delay.second += wire_delay.minDelay();
+                wire_delays[*it] = delay;
+            }
+        }
+    }
+
+    auto found = wire_delays.find(ctx->getNetinfoSinkWire(net_info, user_info));
+    if (found == wire_delays.end())
+        return false;
+    routed = found->second;
+    return true;
+}
+
 delay_t Context::getNetinfoRouteDelay(const NetInfo *net_info, const PortRef &user_info) const
 {
 #ifdef ARCH_ECP5
@@ -319,27 +452,30 @@ delay_t Context::getNetinfoRouteDelay(const NetInfo *net_info, const PortRef &us
     if (src_wire == WireId())
         return 0;
 
-    WireId dst_wire = getNetinfoSinkWire(net_info, user_info);
-    WireId cursor = dst_wire;
-    delay_t delay = 0;
+    std::pair<delay_t, delay_t> routed;
+    if (netinfo_routed_delay(this, net_info, src_wire, user_info, routed))
+        return routed.first;
 
-    while (cursor != WireId() && cursor != src_wire) {
-        auto it = net_info->wires.find(cursor);
+    return predictDelay(net_info, user_info);
+}
 
-        if (it == net_info->wires.end())
-            break;
+delay_t Context::getNetinfoRouteDelayMin(const NetInfo *net_info, const PortRef &user_info) const
+{
+#ifdef ARCH_ECP5
+    if (net_info->is_global)
+        return 0;
+#endif
 
-        PipId pip = it->second.pip;
-        if (pip == PipId())
-            break;
+    if (net_info->wires.empty())
+        return predictDelay(net_info, user_info);
 
-        delay += getPipDelay(pip).maxDelay();
-        delay += getWireDelay(cursor).maxDelay();
-        cursor = getPipSrcWire(pip);
-    }
+    WireId src_wire = getNetinfoSourceWire(net_info);
+    if (src_wire == WireId())
+        return 0;
 
-    if (cursor == src_wire)
-        return delay + getWireDelay(src_wire).maxDelay();
+    std::pair<delay_t, delay_t> routed;
+    if (netinfo_routed_delay(this, net_info, src_wire, user_info, routed))
+        return routed.second;
 
     return predictDelay(net_info, user_info);
 }
@@ -352,111 +488,273 @@ static uint32_t xorshift32(uint32_t x)
     return x;
 }
 
-uint32_t Context::checksum() const
+static int detect_available_cores()
 {
-    uint32_t cksum = xorshift32(123456789);
+    int cores = std::max(1, int(boost::thread::hardware_concurrency()));
+#if defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        cores = std::min(cores, std::max(1, CPU_COUNT(&set)));
+    // CPU quota of the cgroup, as set by container runtimes and job schedulers (cgroup v2, then v1)
+    double quota = -1;
+    std::ifstream cpu_max("/sys/fs/cgroup/cpu.max");
+    std::string max;
+    long period = 0;
+    if (cpu_max >> max >> period) {
+        if (max != "max" && period > 0)
+            quota = std::stod(max) / period;
+    } else {
+        std::ifstream quota_us("/sys/fs/cgroup/cpu/cpu.cfs_quota_us"), period_us("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+        long q = 0;
+        if (quota_us >> q && period_us >> period && q > 0 && period > 0)
+            quota = double(q) / period;
+    }
+    if (quota > 0)
+        cores = std::min(cores, std::max(1, int(std::ceil(quota))));
+#endif
+    return cores;
+}
 
-    uint32_t cksum_nets_sum = 0;
-    for (auto &it : nets) {
-        auto &ni = *it.second;
-        uint32_t x = 123456789;
-        x = xorshift32(x + xorshift32(it.first.index));
-        x = xorshift32(x + xorshift32(ni.name.index));
-        if (ni.driver.cell)
-            x = xorshift32(x + xorshift32(ni.driver.cell->name.index));
-        x = xorshift32(x + xorshift32(ni.driver.port.index));
-        x = xorshift32(x + xorshift32(getDelayChecksum(ni.driver.budget)));
-
-        for (auto &u : ni.users) {
-            if (u.cell)
-                x = xorshift32(x + xorshift32(u.cell->name.index));
-            x = xorshift32(x + xorshift32(u.port.index));
-            x = xorshift32(x + xorshift32(getDelayChecksum(u.budget)));
-        }
+int available_cores()
+{
+    static int cores = detect_available_cores();
+    return cores;
+}
 
-        uint32_t attr_x_sum = 0;
-        for (auto &a : ni.attrs) {
-            uint32_t attr_x = 123456789;
-            attr_x = xorshift32(attr_x + xorshift32(a.first.index));
-            for (char ch : a.second.str)
-                attr_x = xorshift32(attr_x + xorshift32((int)ch));
-            attr_x_sum += attr_x;
-        }
-        x = xorshift32(x + xorshift32(attr_x_sum));
-
-        uint32_t wire_x_sum = 0;
-        for (auto &w : ni.wires) {
-            uint32_t wire_x = 123456789;
-            wire_x = xorshift32(wire_x + xorshift32(getWireChecksum(w.first)));
-            wire_x = xorshift32(wire_x + xorshift32(getPipChecksum(w.second.pip)));
-            wire_x = xorshift32(wire_x + xorshift32(int(w.second.strength)));
-            wire_x_sum += wire_x;
-        }
-        x = xorshift32(x + xorshift32(wire_x_sum));
+int Context::stage_threads(const std::string &stage, int def) const
+{
+#ifdef NPNR_DISABLE_THREADS
+    return 1;
+#else
+    auto get = [&](const std::string &name, int &value) {
+        auto found = settings.find(id(name));
+        if (found == settings.end())
+            return false;
+        value = found->second.is_string ? std::stoi(found->second.as_string()) : int(found->second.as_int64());
+        return true;
+    };
+    int threads;
+    if (!stage.empty() && get(stage + "/threads", threads))
+        return std::max(1, threads);
+    if (get("threads", threads))
+        return std::max(1, threads);
+    return (def <= 0) ? available_cores() : std::min(def, available_cores());
+#endif
+}
 
-        cksum_nets_sum += x;
+static uint32_t property_checksum(IdString name, const Property &prop)
+{
+    uint32_t x = 123456789;
+    x = xorshift32(x + xorshift32(name.index));
+    if (prop.is_string) {
+        for (char ch : prop.str)
+            x = xorshift32(x + xorshift32((int)ch));
+    } else {
+        for (int i = 0; i < prop.width; i++)
+            x = xorshift32(x + xorshift32((int)prop.get(i)));
     }
-    cksum = xorshift32(cksum + xorshift32(cksum_nets_sum));
+    return x;
+}
 
-    uint32_t cksum_cells_sum = 0;
-    for (auto &it : cells) {
-        auto &ci = *it.second;
-        uint32_t x = 123456789;
-        x = xorshift32(x + xorshift32(it.first.index));
-        x = xorshift32(x + xorshift32(ci.name.index));
-        x = xorshift32(x + xorshift32(ci.type.index));
-
-        uint32_t port_x_sum = 0;
-        for (auto &p : ci.ports) {
-            uint32_t port_x = 123456789;
-            port_x = xorshift32(port_x + xorshift32(p.first.index));
-            port_x = xorshift32(port_x + xorshift32(p.second.name.index));
-            if (p.second.net)
-                port_x = xorshift32(port_x + xorshift32(p.second.net->name.index));
-            port_x = xorshift32(port_x + xorshift32(p.second.type));
-            port_x_sum += port_x;
-        }
-        x = xorshift32(x + xorshift32(port_x_sum));
-
-        uint32_t attr_x_sum = 0;
-        for (auto &a : ci.attrs) {
-            uint32_t attr_x = 123456789;
-            attr_x = xorshift32(attr_x + xorshift32(a.first.index));
-            for (char ch : a.second.str)
-                attr_x = xorshift32(attr_x + xorshift32((int)ch));
-            attr_x_sum += attr_x;
-        }
-        x = xorshift32(x + xorshift32(attr_x_sum));
-
-        uint32_t param_x_sum = 0;
-        for (auto &p : ci.params) {
-            uint32_t param_x = 123456789;
-            param_x = xorshift32(param_x + xorshift32(p.first.index));
-            for (char ch : p.second.str)
-                param_x = xorshift32(param_x + xorshift32((int)ch));
-            param_x_sum += param_x;
-        }
-        x = xorshift32(x + xorshift32(param_x_sum));
+static uint32_t net_checksum(const Context *ctx, IdString key, const NetInfo &ni)
+{
+    uint32_t x = 123456789;
+    x = xorshift32(x + xorshift32(key.index));
+    x = xorshift32(x + xorshift32(ni.name.index));
+    if (ni.driver.cell)
+        x = xorshift32(x + xorshift32(ni.driver.cell->name.index));
+    x = xorshift32(x + xorshift32(ni.driver.port.index));
+    x = xorshift32(x + xorshift32(ctx->getDelayChecksum(ni.driver.budget)));
+
+    for (auto &u : ni.users) {
+        if (u.cell)
+            x = xorshift32(x + xorshift32(u.cell->name.index));
+        x = xorshift32(x + xorshift32(u.port.index));
+        x = xorshift32(x + xorshift32(ctx->getDelayChecksum(u.budget)));
+    }
 
-        x = xorshift32(x + xorshift32(getBelChecksum(ci.bel)));
-        x = xorshift32(x + xorshift32(ci.belStrength));
+    uint32_t attr_x_sum = 0;
+    for (auto &a : ni.attrs)
+        attr_x_sum += property_checksum(a.first, a.second);
+    x = xorshift32(x + xorshift32(attr_x_sum));
+
+    uint32_t wire_x_sum = 0;
+    for (auto &w : ni.wires) {
+        uint32_t wire_x = 123456789;
+        wire_x = xorshift32(wire_x + xorshift32(ctx->getWireChecksum(w.first)));
+        wire_x = xorshift32(wire_x + xorshift32(ctx->getPipChecksum(w.second.pip)));
+        wire_x = xorshift32(wire_x + xorshift32(int(w.second.strength)));
+        wire_x_sum += wire_x;
+    }
+    x = xorshift32(x + xorshift32(wire_x_sum));
+    return x;
+}
+
+static uint32_t cell_checksum(const Context *ctx, IdString key, const CellInfo &ci)
+{
+    uint32_t x = 123456789;
+    x = xorshift32(x + xorshift32(key.index));
+    x = xorshift32(x + xorshift32(ci.name.index));
+    x = xorshift32(x + xorshift32(ci.type.index));
+
+    uint32_t port_x_sum = 0;
+    for (auto &p : ci.ports) {
+        uint32_t port_x = 123456789;
+        port_x = xorshift32(port_x + xorshift32(p.first.index));
+        port_x = xorshift32(port_x + xorshift32(p.second.name.index));
+        if (p.second.net)
+            port_x = xorshift32(port_x + xorshift32(p.second.net->name.index));
+        port_x = xorshift32(port_x + xorshift32(p.second.type));
+        port_x_sum += port_x;
+    }
+    x = xorshift32(x + xorshift32(port_x_sum));
+
+    uint32_t attr_x_sum = 0;
+    for (auto &a : ci.attrs)
+        attr_x_sum += property_checksum(a.first, a.second);
+    x = xorshift32(x + xorshift32(attr_x_sum));
+
+    uint32_t param_x_sum = 0;
+    for (auto &p : ci.params)
+        param_x_sum += property_checksum(p.first, p.second);
+    x = xorshift32(x + xorshift32(param_x_sum));
+
+    x = xorshift32(x + xorshift32(ctx->getBelChecksum(ci.bel)));
+    x = xorshift32(x + xorshift32(ci.belStrength));
+
+    uint32_t pin_x_sum = 0;
+    for (auto &a : ci.pins) {
+        uint32_t pin_x = 123456789;
+        pin_x = xorshift32(pin_x + xorshift32(a.first.index));
+        pin_x = xorshift32(pin_x + xorshift32(a.second.index));
+        pin_x_sum += pin_x;
+    }
+    x = xorshift32(x + xorshift32(pin_x_sum));
+    return x;
+}
 
-        uint32_t pin_x_sum = 0;
-        for (auto &a : ci.pins) {
-            uint32_t pin_x = 123456789;
-            pin_x = xorshift32(pin_x + xorshift32(a.first.index));
-            pin_x = xorshift32(pin_x + xorshift32(a.second.index));
-            pin_x_sum += pin_x;
+uint32_t Context::checksum() const
+{
+    // Each net and cell is hashed on its own and the hashes are summed, so the result doesn't depend on the order they
+    // are visited in; on large designs they are hashed in chunks on several threads.
+    std::vector<std::pair<IdString, const NetInfo *>> net_list;
+    std::vector<std::pair<IdString, const CellInfo *>> cell_list;
+    net_list.reserve(nets.size());
+    for (auto &it : nets)
+        net_list.emplace_back(it.first, it.second.get());
+    cell_list.reserve(cells.size());
+    for (auto &it : cells)
+        cell_list.emplace_back(it.first, it.second.get());
+
+    const int chunk_size = 4096;
+    int net_chunks = (int(net_list.size()) + chunk_size - 1) / chunk_size;
+    int cell_chunks = (int(cell_list.size()) + chunk_size - 1) / chunk_size;
+    std::vector<uint32_t> net_sums(net_chunks, 0), cell_sums(cell_chunks, 0);
+    auto hash_chunk = [&](int chunk) {
+        if (chunk < net_chunks) {
+            int end = std::min(int(net_list.size()), (chunk + 1) * chunk_size);
+            for (int i = chunk * chunk_size; i < end; i++)
+                net_sums[chunk] += net_checksum(this, net_list[i].first, *net_list[i].second);
+        } else {
+            chunk -= net_chunks;
+            int end = std::min(int(cell_list.size()), (chunk + 1) * chunk_size);
+            for (int i = chunk * chunk_size; i < end; i++)
+                cell_sums[chunk] += cell_checksum(this, cell_list[i].first, *cell_list[i].second);
         }
-        x = xorshift32(x + xorshift32(pin_x_sum));
+    };
 
-        cksum_cells_sum += x;
+    int threads = std::min(net_chunks + cell_chunks, stage_threads("checksum", 0));
+#ifndef NPNR_DISABLE_THREADS
+    if (threads > 1) {
+        std::vector<int> tasks(net_chunks + cell_chunks);
+        std::iota(tasks.begin(), tasks.end(), 0);
+        WorkerPool(threads).run(tasks, hash_chunk);
+    } else
+#endif
+    {
+        for (int chunk = 0; chunk < net_chunks + cell_chunks; chunk++)
+            hash_chunk(chunk);
     }
-    cksum = xorshift32(cksum + xorshift32(cksum_cells_sum));
 
+    uint32_t cksum = xorshift32(123456789);
+    uint32_t cksum_nets_sum = 0, cksum_cells_sum = 0;
+    for (uint32_t sum : net_sums)
+        cksum_nets_sum += sum;
+    for (uint32_t sum : cell_sums)
+        cksum_cells_sum += sum;
+    cksum = xorshift32(cksum + xorshift32(cksum_nets_sum));
+    cksum = xorshift32(cksum + xorshift32(cksum_cells_sum));
     return cksum;
 }
 
+void Context::saveSnapshot(DesignSnapshot &snapshot, bool placement, bool routing) const
+{
+    snapshot = DesignSnapshot();
+    snapshot.has_placement = placement;
+    snapshot.has_routing = routing;
+    if (placement) {
+        snapshot.cells.reserve(cells.size());
+        snapshot.bels.reserve(cells.size());
+        snapshot.bel_strengths.reserve(cells.size());
+        for (auto &cell : cells) {
+            CellInfo *ci = cell.second.get();
+            if (ci->belStrength >= STRENGTH_LOCKED)
+                continue;
+            snapshot.cells.push_back(ci);
+            snapshot.bels.push_back(ci->bel);
+            snapshot.bel_strengths.push_back(ci->belStrength);
+        }
+    }
+    if (routing) {
+        snapshot.nets.reserve(nets.size());
+        snapshot.route_start.reserve(nets.size() + 1);
+        for (auto &net : nets) {
+            NetInfo *ni = net.second.get();
+            snapshot.nets.push_back(ni);
+            snapshot.route_start.push_back(uint32_t(snapshot.wires.size()));
+            for (auto &wire : ni->wires) {
+                if (wire.second.strength >= STRENGTH_LOCKED)
+                    continue;
+                snapshot.wires.push_back(wire.first);
+                snapshot.pips.push_back(wire.second.pip);
+                snapshot.wire_strengths.push_back(wire.second.strength);
+            }
+        }
+        snapshot.route_start.push_back(uint32_t(snapshot.wires.size()));
+    }
+}
+
+void Context::restoreSnapshot(const DesignSnapshot &snapshot)
+{
+    if (snapshot.has_routing) {
+        std::vector<WireId> to_unbind;
+        for (NetInfo *ni : snapshot.nets)
+            for (auto &wire : ni->wires)
+                if (wire.second.strength < STRENGTH_LOCKED)
+                    to_unbind.push_back(wire.first);
+        for (WireId wire : to_unbind)
+            unbindWire(wire);
+    }
+    if (snapshot.has_placement) {
+        for (CellInfo *ci : snapshot.cells)
+            if (ci->bel != BelId() && ci->belStrength < STRENGTH_LOCKED)
+                unbindBel(ci->bel);
+        for (size_t i = 0; i < snapshot.cells.size(); i++)
+            if (snapshot.bels[i] != BelId())
+                bindBel(snapshot.bels[i], snapshot.cells[i], snapshot.bel_strengths[i]);
+    }
+    if (snapshot.has_routing) {
+        for (size_t i = 0; i < snapshot.nets.size(); i++) {
+            for (uint32_t j = snapshot.route_start[i]; j < snapshot.route_start[i + 1]; j++) {
+                if (snapshot.pips[j] == PipId())
+                    bindWire(snapshot.wires[j], snapshot.nets[i], snapshot.wire_strengths[j]);
+                else
+                    bindPip(snapshot.pips[j], snapshot.nets[i], snapshot.wire_strengths[j]);
+            }
+        }
+    }
+}
+
 void Context::check() const
 {
     bool check_failed = false;
@@ -568,6 +866,48 @@ void BaseCtx::addClock(IdString net, float freq)
     }
 }
 
+static std::unique_ptr<TimingConstraint> path_exception(BaseCtx *ctx, IdString name, IdString from, IdString to)
+{
+    if (ctx->constraints.count(name))
+        log_error("Timing constraint '%s' already exists.\n", name.c_str(ctx));
+    std::unique_ptr<TimingConstraint> constr(new TimingConstraint());
+    constr->name = name;
+    constr->value = 0;
+    constr->from.insert(ctx->timingObjectByName(from));
+    constr->to.insert(ctx->timingObjectByName(to));
+    return constr;
+}
+
+void BaseCtx::addFalsePath(IdString name, IdString from, IdString to)
+{
+    auto constr = path_exception(this, name, from, to);
+    constr->type = TimingConstraint::FALSE_PATH;
+    addConstraint(std::move(constr));
+    log_info("false path '%s' from '%s' to '%s'\n", name.c_str(this), from.c_str(this), to.c_str(this));
+}
+
+void BaseCtx::addMulticyclePath(IdString name, IdString from, IdString to, int cycles)
+{
+    if (cycles < 1)
+        log_error("Multicycle path '%s' must have at least one cycle.\n", name.c_str(this));
+    auto constr = path_exception(this, name, from, to);
+    constr->type = TimingConstraint::MULTICYCLE;
+    constr->value = cycles;
+    addConstraint(std::move(constr));
+    log_info("multicycle path '%s' from '%s' to '%s' of %d cycles\n", name.c_str(this), from.c_str(this),
+             to.c_str(this), cycles);
+}
+
+void BaseCtx::addMaxDelay(IdString name, IdString from, IdString to, float delay_ns)
+{
+    auto constr = path_exception(this, name, from, to);
+    constr->type = TimingConstraint::MAX_DELAY;
+    constr->value = getCtx()->getDelayFromNS(delay_ns).maxDelay();
+    addConstraint(std::move(constr));
+    log_info("maximum delay '%s' from '%s' to '%s' of %.02f ns\n", name.c_str(this), from.c_str(this),
+             to.c_str(this), delay_ns);
+}
+
 void BaseCtx::createRectangularRegion(IdString name, int x0, int y0, int x1, int y1)
 {
     std::unique_ptr<Region> new_region(new Region());
@@ -578,12 +918,12 @@ void BaseCtx::createRectangularRegion(IdString name, int x0, int y0, int x1, int
     for (int x = x0; x <= x1; x++) {
         for (int y = y0; y <= y1; y++) {
             for (auto bel : getCtx()->getBelsByTile(x, y))
-                new_region->bels.insert(bel);
+                new_region->bels.insert(getCtx()->getBelLocation(bel));
         }
     }
     region[name] = std::move(new_region);
 }
-void BaseCtx::addBelToRegion(IdString name, BelId bel) { region[name]->bels.insert(bel); }
+void BaseCtx::addBelToRegion(IdString name, BelId bel) { region[name]->bels.insert(getCtx()->getBelLocation(bel)); }
 void BaseCtx::constrainCellToRegion(IdString cell, IdString region_name)
 {
     // Support hierarchical cells as well as leaf ones
@@ -739,6 +1079,60 @@ void BaseCtx::attributesToArchInfo()
     getCtx()->assignArchInfo();
 }
 
+void BaseCtx::refreshUi()
+{
+#ifndef NPNR_DISABLE_THREADS
+    std::lock_guard<std::mutex> lock(ui_updates_mutex);
+#endif
+    // Everything is reloaded, so the pending changes can go
+    ui_updates = UiUpdates();
+    ui_updates.all = true;
+}
+
+void BaseCtx::refreshUiFrame()
+{
+#ifndef NPNR_DISABLE_THREADS
+    std::lock_guard<std::mutex> lock(ui_updates_mutex);
+#endif
+    ui_updates.frame = true;
+}
+
+void BaseCtx::publishUiBel(BelId bel)
+{
+    DecalXY decal = getCtx()->getBelDecal(bel);
+#ifndef NPNR_DISABLE_THREADS
+    std::lock_guard<std::mutex> lock(ui_updates_mutex);
+#endif
+    ui_updates.bels.emplace_back(bel, decal);
+}
+
+void BaseCtx::publishUiWire(WireId wire)
+{
+    DecalXY decal = getCtx()->getWireDecal(wire);
+#ifndef NPNR_DISABLE_THREADS
+    std::lock_guard<std::mutex> lock(ui_updates_mutex);
+#endif
+    ui_updates.wires.emplace_back(wire, decal);
+}
+
+void BaseCtx::publishUiPip(PipId pip)
+{
+    DecalXY decal = getCtx()->getPipDecal(pip);
+#ifndef NPNR_DISABLE_THREADS
+    std::lock_guard<std::mutex> lock(ui_updates_mutex);
+#endif
+    ui_updates.pips.emplace_back(pip, decal);
+}
+
+void BaseCtx::publishUiGroup(GroupId group)
+{
+    DecalXY decal = getCtx()->getGroupDecal(group);
+#ifndef NPNR_DISABLE_THREADS
+    std::lock_guard<std::mutex> lock(ui_updates_mutex);
+#endif
+    ui_updates.groups.emplace_back(group, decal);
+}
+
 NetInfo *BaseCtx::createNet(IdString name)
 {
     NPNR_ASSERT(!nets.count(name));
@@ -826,14 +1220,10 @@ struct FixupHierarchyWorker
         for (auto &n : h.nets)
             if (!ctx->nets.count(n.second))
                 todelete_nets.push_back(n.first);
-        for (auto tdc : todelete_cells) {
-            h.leaf_cells_by_gname.erase(h.leaf_cells.at(tdc));
+        for (auto tdc : todelete_cells)
             h.leaf_cells.erase(tdc);
-        }
-        for (auto tdn : todelete_nets) {
-            h.nets_by_gname.erase(h.nets.at(tdn));
+        for (auto tdn : todelete_nets)
             h.nets.erase(tdn);
-        }
         for (auto &sc : h.hier_cells)
             trim_hierarchy(sc.second);
     }
@@ -857,15 +1247,21 @@ struct FixupHierarchyWorker
     // Update hierarchy structure for nets and cells that have hiercell set
     void rebuild_hierarchy()
     {
+        // Hierarchy levels by the global names of their leaf cells
+        std::unordered_multimap<IdString, IdString> known_cells;
+        for (auto &h : ctx->hierarchy)
+            for (auto &lc : h.second.leaf_cells)
+                known_cells.emplace(lc.second, h.first);
         for (auto cell : sorted(ctx->cells)) {
             CellInfo *ci = cell.second;
             if (ci->hierpath == IdString())
                 ci->hierpath = ctx->top_module;
-            auto &hc = ctx->hierarchy.at(ci->hierpath);
-            if (hc.leaf_cells_by_gname.count(ci->name))
+            auto known = known_cells.equal_range(ci->name);
+            if (std::any_of(known.first, known.second,
+                            [&](const std::pair<const IdString, IdString> &k) { return k.second == ci->hierpath; }))
                 continue; // already known
+            auto &hc = ctx->hierarchy.at(ci->hierpath);
             IdString local_name = construct_local_name(hc, ci->name, true);
-            hc.leaf_cells_by_gname[ci->name] = local_name;
             hc.leaf_cells[local_name] = ci->name;
         }
     }
@@ -20,12 +20,16 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -69,6 +73,9 @@
 #define NPNR_PACKED_STRUCT(...) __VA_ARGS__
 #endif
 
+#include "design_alloc.h"
+#include "flat_hash.h"
+
 NEXTPNR_NAMESPACE_BEGIN
 
 class assertion_failure : public std::runtime_error
@@ -145,6 +152,100 @@ template <> struct hash<NEXTPNR_NAMESPACE_PREFIX IdString>
 
 NEXTPNR_NAMESPACE_BEGIN
 
+// A map keyed by IdString, stored as a vector of entries sorted by IdString index. For the small attribute, parameter
+// and pin maps of cells and nets this is much more compact and cache friendly than an unordered_map, and it iterates in
+// a deterministic order. Unlike an unordered_map, adding or removing an entry invalidates references to the others.
+template <typename T> class IdStringDict
+{
+  public:
+    typedef IdString key_type;
+    typedef T mapped_type;
+    typedef std::pair<IdString, T> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    IdStringDict() {}
+    IdStringDict(std::initializer_list<value_type> init)
+    {
+        for (auto &entry : init)
+            insert(entry);
+    }
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear() { entries.clear(); }
+    void reserve(size_t n) { entries.reserve(n); }
+
+    iterator find(IdString key)
+    {
+        auto found = lower_bound(key);
+        return (found != entries.end() && found->first == key) ? found : entries.end();
+    }
+    const_iterator find(IdString key) const
+    {
+        auto found = lower_bound(key);
+        return (found != entries.end() && found->first == key) ? found : entries.end();
+    }
+    size_t count(IdString key) const { return find(key) != entries.end() ? 1 : 0; }
+
+    T &at(IdString key)
+    {
+        auto found = find(key);
+        if (found == entries.end())
+            throw std::out_of_range("IdStringDict::at");
+        return found->second;
+    }
+    const T &at(IdString key) const
+    {
+        auto found = find(key);
+        if (found == entries.end())
+            throw std::out_of_range("IdStringDict::at");
+        return found->second;
+    }
+    T &operator[](IdString key) { return emplace(key).first->second; }
+
+    template <typename... Args> std::pair<iterator, bool> emplace(IdString key, Args &&... args)
+    {
+        auto found = lower_bound(key);
+        if (found != entries.end() && found->first == key)
+            return std::make_pair(found, false);
+        found = entries.emplace(found, std::piecewise_construct, std::forward_as_tuple(key),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+        return std::make_pair(found, true);
+    }
+    std::pair<iterator, bool> insert(const value_type &value) { return emplace(value.first, value.second); }
+    // The hint is ignored, but allows std::inserter to be used
+    iterator insert(const_iterator hint, const value_type &value) { return emplace(value.first, value.second).first; }
+
+    size_t erase(IdString key)
+    {
+        auto found = find(key);
+        if (found == entries.end())
+            return 0;
+        entries.erase(found);
+        return 1;
+    }
+    iterator erase(iterator pos) { return entries.erase(pos); }
+
+    bool operator==(const IdStringDict &other) const { return entries == other.entries; }
+    bool operator!=(const IdStringDict &other) const { return entries != other.entries; }
+
+  private:
+    std::vector<value_type> entries;
+
+    static bool entry_less(const value_type &entry, IdString key) { return entry.first.index < key.index; }
+    iterator lower_bound(IdString key) { return std::lower_bound(entries.begin(), entries.end(), key, entry_less); }
+    const_iterator lower_bound(IdString key) const
+    {
+        return std::lower_bound(entries.begin(), entries.end(), key, entry_less);
+    }
+};
+
 struct GraphicElement
 {
     enum type_t
@@ -276,6 +377,58 @@ struct BelPin
 
 struct CellInfo;
 
+// A set of locations, stored as a bitmap of z values for each tile. Testing membership doesn't need any hashing, and
+// large sets such as whole-device regions only take a bit per location.
+struct LocSet
+{
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    bool contains(Loc loc) const
+    {
+        if (loc.x < 0 || loc.y < 0 || loc.z < 0 || loc.x >= int(tiles.size()) || loc.y >= int(tiles[loc.x].size()))
+            return false;
+        const std::vector<uint64_t> &words = tiles[loc.x][loc.y];
+        size_t word = size_t(loc.z) / 64;
+        return word < words.size() && ((words[word] >> (loc.z % 64)) & 1);
+    }
+
+    void insert(Loc loc)
+    {
+        NPNR_ASSERT(loc.x >= 0 && loc.y >= 0 && loc.z >= 0);
+        if (loc.x >= int(tiles.size()))
+            tiles.resize(loc.x + 1);
+        auto &column = tiles[loc.x];
+        if (loc.y >= int(column.size()))
+            column.resize(loc.y + 1);
+        auto &words = column[loc.y];
+        size_t word = size_t(loc.z) / 64;
+        if (word >= words.size())
+            words.resize(word + 1, 0);
+        uint64_t bit = uint64_t(1) << (loc.z % 64);
+        if (!(words[word] & bit)) {
+            words[word] |= bit;
+            ++count;
+        }
+    }
+
+    // Call func(loc) for every location in the set, in x, then y, then z order
+    template <typename Tf> void for_each(Tf func) const
+    {
+        for (int x = 0; x < int(tiles.size()); x++)
+            for (int y = 0; y < int(tiles[x].size()); y++)
+                for (size_t word = 0; word < tiles[x][y].size(); word++)
+                    for (int bit = 0; bit < 64; bit++)
+                        if ((tiles[x][y][word] >> bit) & 1)
+                            func(Loc(x, y, int(word * 64) + bit));
+    }
+
+  private:
+    // Indexed by x, y and then the z / 64
+    std::vector<std::vector<std::vector<uint64_t>>> tiles;
+    size_t count = 0;
+};
+
 struct Region
 {
     IdString name;
@@ -284,7 +437,8 @@ struct Region
     bool constr_wires = false;
     bool constr_pips = false;
 
-    std::unordered_set<BelId> bels;
+    // Locations of the bels in the region
+    LocSet bels;
     std::unordered_set<WireId> wires;
     std::unordered_set<Loc> piplocs;
 };
@@ -330,21 +484,55 @@ struct Property
 
     bool is_string;
 
-    // The string literal (for string values), or a string of [01xz] (for numeric values)
+    // The string literal, for string values
     std::string str;
     // The lower 64 bits (for numeric values), unused for string values
     int64_t intval;
 
-    void update_intval()
+    // Numeric values are vectors of [01xz] states, packed into two bit planes so that long values such as RAM
+    // initialisation take a quarter of a bit per state. Each pair of words covers 64 states: the first word has the
+    // bits set that are 1 or z, the second those that are x or z. Bits past the width are always clear.
+    int width;
+    std::vector<uint64_t> planes;
+
+    State get(int i) const
     {
-        intval = 0;
-        for (int i = 0; i < int(str.size()); i++) {
-            NPNR_ASSERT(str[i] == S0 || str[i] == S1 || str[i] == Sx || str[i] == Sz);
-            if ((str[i] == S1) && i < 64)
-                intval |= (1ULL << i);
-        }
+        NPNR_ASSERT(!is_string && i >= 0 && i < width);
+        bool value = (planes[2 * (i / 64)] >> (i % 64)) & 1, undef = (planes[2 * (i / 64) + 1] >> (i % 64)) & 1;
+        return undef ? (value ? Sz : Sx) : (value ? S1 : S0);
+    }
+
+    void set(int i, State bit)
+    {
+        NPNR_ASSERT(!is_string && i >= 0 && i < width);
+        NPNR_ASSERT(bit == S0 || bit == S1 || bit == Sx || bit == Sz);
+        uint64_t mask = 1ULL << (i % 64);
+        uint64_t &value = planes[2 * (i / 64)], &undef = planes[2 * (i / 64) + 1];
+        value = (bit == S1 || bit == Sz) ? (value | mask) : (value & ~mask);
+        undef = (bit == Sx || bit == Sz) ? (undef | mask) : (undef & ~mask);
+    }
+
+    // Add a bit above the current most significant bit
+    void push_back(State bit)
+    {
+        if (width % 64 == 0)
+            planes.resize(planes.size() + 2, 0);
+        ++width;
+        set(width - 1, bit);
+    }
+
+    // The states as a string of [01xz], least significant first (the reverse of to_string())
+    std::string bit_str() const
+    {
+        std::string result;
+        result.reserve(width);
+        for (int i = 0; i < width; i++)
+            result.push_back(get(i));
+        return result;
     }
 
+    void update_intval() { intval = planes.empty() ? 0 : int64_t(planes[0] & ~planes[1]); }
+
     int64_t as_int64() const
     {
         NPNR_ASSERT(!is_string);
@@ -352,11 +540,10 @@ struct Property
     }
     std::vector<bool> as_bits() const
     {
-        std::vector<bool> result;
-        result.reserve(str.size());
         NPNR_ASSERT(!is_string);
-        for (auto c : str)
-            result.push_back(c == S1);
+        std::vector<bool> result(width);
+        for (int i = 0; i < width; i++)
+            result[i] = ((planes[2 * (i / 64)] & ~planes[2 * (i / 64) + 1]) >> (i % 64)) & 1;
         return result;
     }
     std::string as_string() const
@@ -369,7 +556,7 @@ struct Property
         NPNR_ASSERT(is_string);
         return str.c_str();
     }
-    size_t size() const { return is_string ? 8 * str.size() : str.size(); }
+    size_t size() const { return is_string ? 8 * str.size() : width; }
     double as_double() const
     {
         NPNR_ASSERT(is_string);
@@ -377,22 +564,29 @@ struct Property
     }
     bool as_bool() const
     {
-        if (int(str.size()) <= 64)
-            return intval != 0;
-        else
-            return std::any_of(str.begin(), str.end(), [](char c) { return c == S1; });
+        if (is_string)
+            return (int(str.size()) <= 64) ? (intval != 0)
+                                           : std::any_of(str.begin(), str.end(), [](char c) { return c == S1; });
+        for (size_t i = 0; i < planes.size(); i += 2)
+            if (planes[i] & ~planes[i + 1])
+                return true;
+        return false;
     }
     bool is_fully_def() const
     {
-        return !is_string && std::all_of(str.begin(), str.end(), [](char c) { return c == S0 || c == S1; });
+        if (is_string)
+            return false;
+        for (size_t i = 1; i < planes.size(); i += 2)
+            if (planes[i] != 0)
+                return false;
+        return true;
     }
     Property extract(int offset, int len, State padding = State::S0) const
     {
         Property ret;
-        ret.is_string = false;
-        ret.str.reserve(len);
+        ret.planes.reserve(2 * ((len + 63) / 64));
         for (int i = offset; i < offset + len; i++)
-            ret.str.push_back(i < int(str.size()) ? str[i] : padding);
+            ret.push_back(i < width ? get(i) : padding);
         ret.update_intval();
         return ret;
     }
@@ -404,11 +598,17 @@ struct Property
     static Property from_string(const std::string &s);
 };
 
-inline bool operator==(const Property &a, const Property &b) { return a.is_string == b.is_string && a.str == b.str; }
-inline bool operator!=(const Property &a, const Property &b) { return a.is_string != b.is_string || a.str != b.str; }
+inline bool operator==(const Property &a, const Property &b)
+{
+    return a.is_string == b.is_string && a.str == b.str && a.width == b.width && a.planes == b.planes;
+}
+inline bool operator!=(const Property &a, const Property &b) { return !(a == b); }
 
 struct ClockConstraint;
 
+// The routing of a net: each bound wire and the pip driving it (PipId() for the source wire)
+typedef FlatHashMap<WireId, PipMap> RoutingMap;
+
 struct NetInfo : ArchNetInfo
 {
     IdString name, hierpath;
@@ -416,10 +616,15 @@ struct NetInfo : ArchNetInfo
 
     PortRef driver;
     std::vector<PortRef> users;
-    std::unordered_map<IdString, Property> attrs;
+    IdStringDict<Property> attrs;
 
     // wire -> uphill_pip
-    std::unordered_map<WireId, PipMap> wires;
+    RoutingMap wires;
+    // Routed (max, min) delay from the source to each wire, filled in by getNetinfoRouteDelay in one pass over the
+    // routing tree and cleared by the Arch whenever wires changes. Timing analysis and the output writers may query the
+    // delays of one net from several threads, so getNetinfoRouteDelay only uses it with wire_delays_mutex held
+    mutable FlatHashMap<WireId, std::pair<delay_t, delay_t>> wire_delays;
+    mutable std::mutex wire_delays_mutex;
 
     std::vector<IdString> aliases; // entries in net_aliases that point to this net
 
@@ -428,6 +633,14 @@ struct NetInfo : ArchNetInfo
     TimingConstrObjectId tmg_id;
 
     Region *region = nullptr;
+
+    // Nets are allocated from the design pool
+    static void *operator new(std::size_t size)
+    {
+        NPNR_ASSERT(size == sizeof(NetInfo));
+        return DesignBlockPool<sizeof(NetInfo)>::get().alloc();
+    }
+    static void operator delete(void *p) { DesignBlockPool<sizeof(NetInfo)>::get().release(p); }
 };
 
 enum PortType
@@ -443,21 +656,28 @@ struct PortInfo
     NetInfo *net;
     PortType type;
     TimingConstrObjectId tmg_id;
+    // Where this port last was in net->users, so it can be found without a search; only a hint, as code may change
+    // the users of a net directly, and must be checked against the entry
+    size_t user_idx;
 };
 
+typedef std::unordered_map<IdString, PortInfo, std::hash<IdString>, std::equal_to<IdString>,
+                           DesignAllocator<std::pair<const IdString, PortInfo>>>
+        PortInfoMap;
+
 struct CellInfo : ArchCellInfo
 {
     IdString name, type, hierpath;
     int32_t udata;
 
-    std::unordered_map<IdString, PortInfo> ports;
-    std::unordered_map<IdString, Property> attrs, params;
+    PortInfoMap ports;
+    IdStringDict<Property> attrs, params;
 
     BelId bel;
     PlaceStrength belStrength = STRENGTH_NONE;
 
     // cell_port -> bel_pin
-    std::unordered_map<IdString, IdString> pins;
+    IdStringDict<IdString> pins;
 
     // placement constraints
     CellInfo *constr_parent = nullptr;
@@ -480,6 +700,14 @@ struct CellInfo : ArchCellInfo
     void unsetParam(IdString name);
     void setAttr(IdString name, Property value);
     void unsetAttr(IdString name);
+
+    // Cells are allocated from the design pool
+    static void *operator new(std::size_t size)
+    {
+        NPNR_ASSERT(size == sizeof(CellInfo));
+        return DesignBlockPool<sizeof(CellInfo)>::get().alloc();
+    }
+    static void operator delete(void *p) { DesignBlockPool<sizeof(CellInfo)>::get().release(p); }
 };
 
 enum TimingPortClass
@@ -545,8 +773,10 @@ struct TimingConstraint
         MULTICYCLE,
     } type;
 
+    // Delay for MIN_DELAY and MAX_DELAY, number of clock cycles for MULTICYCLE
     delay_t value;
 
+    // Paths from any of the from objects to any of the to objects are affected; an empty set matches anything
     std::unordered_set<TimingConstrObjectId> from;
     std::unordered_set<TimingConstrObjectId> to;
 };
@@ -566,10 +796,9 @@ struct HierarchicalPort
 struct HierarchicalCell
 {
     IdString name, type, parent, fullpath;
-    // Name inside cell instance -> global name
+    // Name inside cell instance -> global name. There is no reverse index, as deep hierarchies have a great many
+    // leaf cells; the few users needing one build it when required
     std::unordered_map<IdString, IdString> leaf_cells, nets;
-    // Global name -> name inside cell instance
-    std::unordered_map<IdString, IdString> leaf_cells_by_gname, nets_by_gname;
     // Cell port to net
     std::unordered_map<IdString, HierarchicalPort> ports;
     // Name inside cell instance -> global name
@@ -631,6 +860,26 @@ struct DeterministicRNG
             rng64();
     }
 
+    // SplitMix64 finaliser (https://prng.di.unimi.it/splitmix64.c)
+    static uint64_t mix64(uint64_t x)
+    {
+        x += 0x9E3779B97F4A7C15;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+        return x ^ (x >> 31);
+    }
+
+    // An independent generator for stream number `stream` (a thread, partition or work item), derived from the
+    // current state without advancing it. A stream only depends on the seed, the number of values drawn from this
+    // generator so far and the stream number, so parallel work seeded this way is reproducible whatever the thread
+    // count or scheduling. Draw from this generator between sets of streams that should differ.
+    DeterministicRNG split(uint64_t stream) const
+    {
+        DeterministicRNG result;
+        result.rngseed(mix64(rngstate ^ mix64(stream)));
+        return result;
+    }
+
     template <typename Iter> void shuffle(const Iter &begin, const Iter &end)
     {
         size_t size = end - begin;
@@ -650,6 +899,49 @@ struct DeterministicRNG
     }
 };
 
+// The ID string database, which strings can be interned into from several threads at once. The string to index map
+// is split into shards that each have their own lock, and the index to string table is append-only storage in fixed
+// size chunks, so that getting the string of an index never takes a lock. Indices are only deterministic if all
+// strings are interned from one thread at a time.
+struct IdStringDb
+{
+    static const int num_shards = 64;
+    static const int chunk_bits = 12;
+    static const int chunk_size = 1 << chunk_bits;
+    static const int max_chunks = 1 << 16;
+
+    IdStringDb();
+    ~IdStringDb();
+
+    // Get the index of a string, adding it if it is new
+    int intern(const std::string &s);
+    // Get the index of a string, or -1 if it hasn't been added
+    int lookup(const std::string &s);
+    // Add a new string, which must get the given index
+    void add(const std::string &s, int idx);
+
+    int size() const { return count.load(std::memory_order_relaxed); }
+    const std::string &str(int idx) const
+    {
+        NPNR_ASSERT(idx >= 0 && idx < size());
+        return *chunks[idx >> chunk_bits].load(std::memory_order_acquire)[idx & (chunk_size - 1)];
+    }
+
+  private:
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, int> str_to_idx;
+    };
+    Shard shards[num_shards];
+    std::atomic<const std::string **> chunks[max_chunks];
+    std::mutex chunk_mutex;
+    std::atomic<int> count;
+
+    Shard &get_shard(const std::string &s) { return shards[std::hash<std::string>()(s) % num_shards]; }
+    void set_str(int idx, const std::string *s);
+};
+
 struct BaseCtx
 {
 #ifndef NPNR_DISABLE_THREADS
@@ -661,11 +953,12 @@ struct BaseCtx
     // method will lock/unlock it when its' released the main mutex to make
     // sure the UI is not starved.
     std::mutex ui_mutex;
+    // Whether the current holder of the lock actually took the mutex; see lock()
+    bool mutex_taken = false;
 #endif
 
     // ID String database.
-    mutable std::unordered_map<std::string, int> *idstring_str_to_idx;
-    mutable std::vector<const std::string *> *idstring_idx_to_str;
+    mutable IdStringDb *idstring_db;
 
     // Project settings and config switches
     std::unordered_map<IdString, Property> settings;
@@ -683,7 +976,7 @@ struct BaseCtx
     std::unordered_map<IdString, IdString> net_aliases;
 
     // Top-level ports
-    std::unordered_map<IdString, PortInfo> ports;
+    PortInfoMap ports;
 
     // Floorplanning regions
     std::unordered_map<IdString, std::unique_ptr<Region>> region;
@@ -693,8 +986,7 @@ struct BaseCtx
 
     BaseCtx()
     {
-        idstring_str_to_idx = new std::unordered_map<std::string, int>;
-        idstring_idx_to_str = new std::vector<const std::string *>;
+        idstring_db = new IdStringDb;
         IdString::initialize_add(this, "", 0);
         IdString::initialize_arch(this);
 
@@ -706,23 +998,32 @@ struct BaseCtx
 
     ~BaseCtx()
     {
-        delete idstring_str_to_idx;
-        delete idstring_idx_to_str;
+        delete idstring_db;
     }
 
     // Must be called before performing any mutating changes on the Ctx/Arch.
+    // Until a GUI attaches there is no other thread to exclude, so the
+    // mutex is only taken once one has; whether it was is remembered until
+    // the matching unlock(), so attaching while the flow holds the lock is
+    // safe, and takes effect from its next yield().
     void lock(void)
     {
 #ifndef NPNR_DISABLE_THREADS
+        if (!ui_attached.load(std::memory_order_relaxed))
+            return;
         mutex.lock();
         mutex_owner = boost::this_thread::get_id();
+        mutex_taken = true;
 #endif
     }
 
     void unlock(void)
     {
 #ifndef NPNR_DISABLE_THREADS
+        if (!mutex_taken)
+            return;
         NPNR_ASSERT(boost::this_thread::get_id() == mutex_owner);
+        mutex_taken = false;
         mutex.unlock();
 #endif
     }
@@ -753,6 +1054,8 @@ struct BaseCtx
     void yield(void)
     {
 #ifndef NPNR_DISABLE_THREADS
+        if (!mutex_taken && !ui_attached.load(std::memory_order_relaxed))
+            return;
         unlock();
         ui_mutex.lock();
         ui_mutex.unlock();
@@ -784,24 +1087,80 @@ struct BaseCtx
 
     // --------------------------------------------------------------
 
-    bool allUiReload = true;
-    bool frameUiReload = false;
-    std::unordered_set<BelId> belUiReload;
-    std::unordered_set<WireId> wireUiReload;
-    std::unordered_set<PipId> pipUiReload;
-    std::unordered_set<GroupId> groupUiReload;
+    // Changes for the GUI to show. The flow appends to one side of a double buffer as it goes, and the GUI swaps it
+    // for an empty one whenever it redraws, so following placement and routing needs only the short ui_updates_mutex
+    // rather than the context lock. The decals of changed bels, wires and pips are taken as they change, and only once
+    // a GUI has attached.
+    struct UiUpdates
+    {
+        bool all = false;
+        bool frame = false;
+        std::vector<std::pair<BelId, DecalXY>> bels;
+        std::vector<std::pair<WireId, DecalXY>> wires;
+        std::vector<std::pair<PipId, DecalXY>> pips;
+        std::vector<std::pair<GroupId, DecalXY>> groups;
+
+        bool empty() const
+        {
+            return !all && !frame && bels.empty() && wires.empty() && pips.empty() && groups.empty();
+        }
+    };
 
-    void refreshUi() { allUiReload = true; }
+    std::atomic<bool> ui_attached{false};
+#ifndef NPNR_DISABLE_THREADS
+    std::mutex ui_updates_mutex;
+#endif
+    UiUpdates ui_updates;
+
+    // Called by the GUI when it starts showing this context
+    void attachUi()
+    {
+        ui_attached = true;
+        refreshUi();
+    }
 
-    void refreshUiFrame() { frameUiReload = true; }
+    // Swaps out everything that changed since the last call
+    void takeUiUpdates(UiUpdates &out)
+    {
+        out = UiUpdates();
+#ifndef NPNR_DISABLE_THREADS
+        std::lock_guard<std::mutex> lock(ui_updates_mutex);
+#endif
+        std::swap(out, ui_updates);
+    }
+
+    void refreshUi();
+
+    void refreshUiFrame();
+
+    void refreshUiBel(BelId bel)
+    {
+        if (ui_attached)
+            publishUiBel(bel);
+    }
 
-    void refreshUiBel(BelId bel) { belUiReload.insert(bel); }
+    void refreshUiWire(WireId wire)
+    {
+        if (ui_attached)
+            publishUiWire(wire);
+    }
 
-    void refreshUiWire(WireId wire) { wireUiReload.insert(wire); }
+    void refreshUiPip(PipId pip)
+    {
+        if (ui_attached)
+            publishUiPip(pip);
+    }
 
-    void refreshUiPip(PipId pip) { pipUiReload.insert(pip); }
+    void refreshUiGroup(GroupId group)
+    {
+        if (ui_attached)
+            publishUiGroup(group);
+    }
 
-    void refreshUiGroup(GroupId group) { groupUiReload.insert(group); }
+    void publishUiBel(BelId bel);
+    void publishUiWire(WireId wire);
+    void publishUiPip(PipId pip);
+    void publishUiGroup(GroupId group);
 
     // --------------------------------------------------------------
 
@@ -828,9 +1187,15 @@ struct BaseCtx
 
     void addConstraint(std::unique_ptr<TimingConstraint> constr);
     void removeConstraint(IdString constrName);
+    // Object for the cell, net, "cell.port" or "*" (anything) of the given name; a constrained clock net gives its
+    // clock domain
+    TimingConstrObjectId timingObjectByName(IdString name);
 
     // Intended to simplify Python API
     void addClock(IdString net, float freq);
+    void addFalsePath(IdString name, IdString from, IdString to);
+    void addMulticyclePath(IdString name, IdString from, IdString to, int cycles);
+    void addMaxDelay(IdString name, IdString from, IdString to, float delay_ns);
     void createRectangularRegion(IdString name, int x0, int y0, int x1, int y1);
     void addBelToRegion(IdString name, BelId bel);
     void constrainCellToRegion(IdString cell, IdString region_name);
@@ -858,6 +1223,57 @@ NEXTPNR_NAMESPACE_END
 
 NEXTPNR_NAMESPACE_BEGIN
 
+// Results of the most recent timing analysis, for the machine-readable report
+struct TimingResult
+{
+    struct PathPort
+    {
+        IdString net, cell, port;
+    };
+
+    struct Path
+    {
+        // Formatted start and end clock events
+        std::string start, end;
+        delay_t delay, period;
+        // The sink ports along the path, in order
+        std::vector<PathPort> ports;
+    };
+
+    bool valid = false;
+    // Achieved and target frequency of each clock in MHz
+    std::unordered_map<IdString, std::pair<double, double>> clock_fmax;
+    // Slack in ps to number of endpoints
+    std::map<int, unsigned> slack_histogram;
+    // The critical path of each clock and cross-domain pair
+    std::vector<Path> crit_paths;
+    // The worst paths of each clock pair, if timing/reportPaths is set
+    std::vector<Path> worst_paths;
+};
+
+// A saved placement and/or routing, see Context::saveSnapshot. Only bindings weaker than STRENGTH_LOCKED are
+// recorded, as those are the only ones tools may change. Cells and nets are held by pointer, so a snapshot can only be
+// restored while the same cells and nets exist.
+struct DesignSnapshot
+{
+    bool has_placement = false, has_routing = false;
+
+    // The bel (BelId() if unplaced) and strength of each cell
+    std::vector<CellInfo *> cells;
+    std::vector<BelId> bels;
+    std::vector<PlaceStrength> bel_strengths;
+
+    // The routing of nets[i] is entries route_start[i] to route_start[i + 1] - 1 of the wire arrays
+    std::vector<NetInfo *> nets;
+    std::vector<uint32_t> route_start;
+    std::vector<WireId> wires;
+    std::vector<PipId> pips;
+    std::vector<PlaceStrength> wire_strengths;
+};
+
+// Number of CPU cores this process may use, taking the affinity mask and any cgroup CPU quota into account
+int available_cores();
+
 struct Context : Arch, DeterministicRNG
 {
     bool verbose = false;
@@ -874,11 +1290,18 @@ struct Context : Arch, DeterministicRNG
     WireId getNetinfoSourceWire(const NetInfo *net_info) const;
     WireId getNetinfoSinkWire(const NetInfo *net_info, const PortRef &sink) const;
     delay_t getNetinfoRouteDelay(const NetInfo *net_info, const PortRef &sink) const;
+    // As getNetinfoRouteDelay, but summing the minimum delays of the routing, for fast corner timing analysis
+    delay_t getNetinfoRouteDelayMin(const NetInfo *net_info, const PortRef &sink) const;
 
     // provided by router1.cc
     bool checkRoutedDesign() const;
     bool getActualRouteDelay(WireId src_wire, WireId dst_wire, delay_t *delay = nullptr,
-                             std::unordered_map<WireId, PipId> *route = nullptr, bool useEstimate = true);
+                             std::unordered_map<WireId, PipId> *route = nullptr, bool useEstimate = true) const;
+    // As getActualRouteDelay, but to many sinks with a single search; delays gets the delay to each sink (-1 where
+    // unreachable) and route the shortest path tree. Returns the number of sinks reached
+    int getActualRouteDelays(WireId src_wire, const std::vector<WireId> &dst_wires,
+                             std::vector<delay_t> *delays = nullptr,
+                             std::unordered_map<WireId, PipId> *route = nullptr) const;
 
     // --------------------------------------------------------------
     // call after changing hierpath or adding/removing nets and cells
@@ -896,10 +1319,45 @@ struct Context : Arch, DeterministicRNG
 
     // --------------------------------------------------------------
 
+    TimingResult timing_result;
+
+    // provided by report.cc, with the runtime in seconds of each flow stage that was run
+    void writeReport(std::ostream &out, const std::vector<std::pair<std::string, double>> &stage_runtimes) const;
+
+    // --------------------------------------------------------------
+
+    // Save the current placement and/or routing; restoring replaces the current bindings of the snapshot's cells
+    // and nets with the saved ones, unbinding everything first and then binding in bulk
+    void saveSnapshot(DesignSnapshot &snapshot, bool placement = true, bool routing = true) const;
+    void restoreSnapshot(const DesignSnapshot &snapshot);
+
+    // --------------------------------------------------------------
+
+    // provided by checkpoint.cc: checkpoints for resuming after a crash (see --autosave). Placers and routers call
+    // autosave() at points where the design is consistent; a checkpoint is written if at least autosave_interval
+    // seconds have passed since the last one
+    std::string autosave_file;
+    double autosave_interval = 600;
+    std::chrono::steady_clock::time_point last_autosave = std::chrono::steady_clock::now();
+    void autosave(bool force = false);
+
+    // --------------------------------------------------------------
+
+    // Bels of an earlier run to start placement from, by cell name (see --guide-placement). Unlike constraints, the
+    // placers are free to move cells away from them
+    std::unordered_map<IdString, BelId> placement_guide;
+
+    // --------------------------------------------------------------
+
     uint32_t checksum() const;
 
     void check() const;
     void archcheck() const;
+    void archbench() const;
+
+    // Number of threads for a parallel stage: its "<stage>/threads" setting if there is one, else the global --threads
+    // budget, else def (0 for all cores) limited to the available cores. Always 1 if built without threads
+    int stage_threads(const std::string &stage, int def) const;
 
     template <typename T> T setting(const char *name, T defaultValue)
     {
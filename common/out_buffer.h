@@ -0,0 +1,95 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef OUT_BUFFER_H
+#define OUT_BUFFER_H
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Output is appended to large chunks of memory instead of going through ostream formatting. A buffer with a stream
+// writes a chunk out whenever it fills; one without just grows, for sections serialised by worker threads.
+struct OutBuffer
+{
+    static const size_t chunk_size = 1 << 20;
+
+    explicit OutBuffer(std::ostream *out = nullptr, size_t capacity = 64 * 1024) : out(out)
+    {
+        buf.reserve(out ? 2 * chunk_size : capacity);
+    }
+    ~OutBuffer() { flush(); }
+
+    OutBuffer &operator<<(const char *str)
+    {
+        buf += str;
+        return check();
+    }
+    OutBuffer &operator<<(const std::string &str)
+    {
+        buf += str;
+        return check();
+    }
+    OutBuffer &operator<<(char c)
+    {
+        buf += c;
+        return check();
+    }
+    OutBuffer &operator<<(int value)
+    {
+        char tmp[16];
+        snprintf(tmp, sizeof(tmp), "%d", value);
+        buf += tmp;
+        return check();
+    }
+    // Formatted as std::ostream would with its default precision
+    OutBuffer &operator<<(double value)
+    {
+        char tmp[32];
+        snprintf(tmp, sizeof(tmp), "%g", value);
+        buf += tmp;
+        return check();
+    }
+
+    void flush()
+    {
+        if (out != nullptr && !buf.empty()) {
+            out->write(buf.data(), buf.size());
+            buf.clear();
+        }
+    }
+
+    std::ostream *out;
+    std::string buf;
+
+  private:
+    OutBuffer &check()
+    {
+        if (out != nullptr && buf.size() >= chunk_size)
+            flush();
+        return *this;
+    }
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
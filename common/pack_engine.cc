@@ -0,0 +1,223 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+
+#include "pack_engine.h"
+#include <algorithm>
+#include <map>
+#include "design_utils.h"
+#include "log.h"
+#include "worker_pool.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+bool name_order(const CellInfo *a, const CellInfo *b) { return a->name < b->name; }
+} // namespace
+
+PackEngine::PackEngine(Context *ctx, int threads) : ctx(ctx), threads(threads) { index_cells(); }
+
+void PackEngine::index_cells()
+{
+    by_type.clear();
+    for (auto &cell : ctx->cells)
+        by_type[cell.second->type].push_back(cell.second.get());
+    for (auto &type : by_type)
+        std::sort(type.second.begin(), type.second.end(), name_order);
+}
+
+const std::vector<CellInfo *> &PackEngine::cells_of(IdString type) const
+{
+    auto found = by_type.find(type);
+    return (found != by_type.end()) ? found->second : no_cells;
+}
+
+std::vector<CellInfo *> PackEngine::cells_matching(const std::function<bool(const CellInfo *)> &type_pred) const
+{
+    std::vector<CellInfo *> cells;
+    for (auto &type : by_type)
+        if (!type.second.empty() && type_pred(type.second.front()))
+            cells.insert(cells.end(), type.second.begin(), type.second.end());
+    std::sort(cells.begin(), cells.end(), name_order);
+    return cells;
+}
+
+std::vector<std::pair<CellInfo *, CellInfo *>> PackEngine::match_pairs(const PairRule &rule) const
+{
+    std::vector<std::pair<CellInfo *, CellInfo *>> pairs;
+    for (CellInfo *ci : cells_matching(rule.driver_pred))
+        pairs.emplace_back(ci, nullptr);
+
+    auto match = [&](size_t i) {
+        CellInfo *ci = pairs.at(i).first;
+        auto port = ci->ports.find(rule.driver_port);
+        if (port == ci->ports.end() || port->second.net == nullptr)
+            return;
+        const NetInfo *net = port->second.net;
+        if (rule.exclusive && net->users.size() != 1)
+            return;
+        for (auto &usr : net->users) {
+            if (usr.port == rule.user_port && usr.cell != ci && rule.user_pred(usr.cell) &&
+                (!rule.compatible || rule.compatible(ci, usr.cell))) {
+                pairs.at(i).second = usr.cell;
+                return;
+            }
+        }
+    };
+    const size_t chunk_size = 4096;
+#ifndef NPNR_DISABLE_THREADS
+    if (threads > 1 && pairs.size() > chunk_size) {
+        std::vector<int> chunks;
+        for (size_t i = 0; i * chunk_size < pairs.size(); i++)
+            chunks.push_back(int(i));
+        WorkerPool pool(threads);
+        pool.run(chunks, [&](int c) {
+            for (size_t i = c * chunk_size; i < std::min(pairs.size(), (c + 1) * chunk_size); i++)
+                match(i);
+        });
+    } else
+#endif
+    {
+        for (size_t i = 0; i < pairs.size(); i++)
+            match(i);
+    }
+    return pairs;
+}
+
+IdString PackEngine::strip_port_name(IdString pname)
+{
+    auto fnd = stripped_port_names.find(pname);
+    if (fnd != stripped_port_names.end())
+        return fnd->second;
+    const std::string &name = pname.str(ctx);
+    IdString stripped = pname;
+    if (name.find_first_of("[]") != std::string::npos) {
+        std::string stripped_name;
+        for (auto c : name)
+            if (c != '[' && c != ']')
+                stripped_name += c;
+        stripped = ctx->id(stripped_name);
+    }
+    stripped_port_names.emplace(pname, stripped);
+    return stripped;
+}
+
+void PackEngine::xform_cell(const std::unordered_map<IdString, XFormRule> &rules, CellInfo *ci)
+{
+    auto &rule = rules.at(ci->type);
+    ci->type = rule.new_type;
+    std::vector<IdString> orig_port_names;
+    for (auto &port : ci->ports)
+        orig_port_names.push_back(port.first);
+
+    for (auto pname : orig_port_names) {
+        auto fnd_multi = rule.port_multixform.find(pname);
+        if (fnd_multi != rule.port_multixform.end()) {
+            auto old_port = ci->ports.at(pname);
+            disconnect_port(ctx, ci, pname);
+            ci->ports.erase(pname);
+            for (auto new_name : fnd_multi->second) {
+                ci->ports[new_name].name = new_name;
+                ci->ports[new_name].type = old_port.type;
+                connect_port(ctx, old_port.net, ci, new_name);
+            }
+        } else {
+            auto fnd_xform = rule.port_xform.find(pname);
+            IdString new_name = (fnd_xform != rule.port_xform.end()) ? fnd_xform->second : strip_port_name(pname);
+            if (new_name != pname) {
+                rename_port(ctx, ci, pname, new_name);
+            }
+        }
+    }
+
+    if (!rule.param_xform.empty()) {
+        std::vector<IdString> xform_params;
+        for (auto &param : ci->params)
+            if (rule.param_xform.count(param.first))
+                xform_params.push_back(param.first);
+        for (auto param : xform_params)
+            ci->params[rule.param_xform.at(param)] = ci->params[param];
+    }
+
+    for (auto &attr : rule.set_attrs)
+        ci->attrs[attr.first] = attr.second;
+
+    for (auto &param : rule.default_params)
+        if (!ci->params.count(param.first))
+            ci->params[param.first] = param.second;
+
+    {
+        IdString old_param, new_param;
+        int width;
+        int64_t def;
+        for (const auto &p : rule.parse_params) {
+            std::tie(old_param, new_param, width, def) = p;
+            NPNR_ASSERT(param_parser);
+            ci->params[new_param] = param_parser(ci, old_param, width, def);
+        }
+    }
+
+    for (auto &param : rule.set_params)
+        ci->params[param.first] = param.second;
+}
+
+void PackEngine::xform(const std::unordered_map<IdString, XFormRule> &rules, bool print_summary)
+{
+    // Take the cells of the rule types out of the index, transform them and file them under their new types
+    std::vector<CellInfo *> matched;
+    for (auto &rule : rules) {
+        auto found = by_type.find(rule.first);
+        if (found == by_type.end())
+            continue;
+        matched.insert(matched.end(), found->second.begin(), found->second.end());
+        by_type.erase(found);
+    }
+    std::sort(matched.begin(), matched.end(), name_order);
+
+    std::unordered_map<IdString, int> type_cell_count, type_new_types;
+    for (CellInfo *ci : matched) {
+        type_cell_count[ci->type]++;
+        xform_cell(rules, ci);
+        type_new_types[ci->type]++;
+        by_type[ci->type].push_back(ci);
+    }
+    for (auto &nt : type_new_types) {
+        auto &cells = by_type.at(nt.first);
+        std::sort(cells.begin(), cells.end(), name_order);
+    }
+
+    if (print_summary) {
+        std::map<std::string, int> cell_count;
+        std::map<std::string, int> new_types;
+        for (auto &cc : type_cell_count)
+            cell_count[cc.first.str(ctx)] = cc.second;
+        for (auto &nt : type_new_types)
+            new_types[nt.first.str(ctx)] = nt.second;
+        for (auto &nt : new_types) {
+            log_info("    Created %d %s cells from:\n", nt.second, nt.first.c_str());
+            for (auto &cc : cell_count) {
+                if (rules.at(ctx->id(cc.first)).new_type != ctx->id(nt.first))
+                    continue;
+                log_info("        %6dx %s\n", cc.second, cc.first.c_str());
+            }
+        }
+    }
+}
+
+NEXTPNR_NAMESPACE_END
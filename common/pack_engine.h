@@ -0,0 +1,99 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+
+#ifndef PACK_ENGINE_H
+#define PACK_ENGINE_H
+
+#include <functional>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Building blocks shared by the arch packers. The netlist is indexed by cell type once, so that a packing pass only
+// visits the cells it is interested in rather than scanning and sorting all of ctx->cells, and packing is declared
+// as rules: pairs of cells joined by a net that go together into one packed cell, and transformations of a cell's
+// type, ports and parameters.
+struct PackEngine
+{
+    explicit PackEngine(Context *ctx, int threads = 1);
+
+    // Rebuild the index by cell type. Needed whenever cells have been created, removed or had their type changed
+    // other than through xform
+    void index_cells();
+    // The cells of a type as of the last indexing, in name order
+    const std::vector<CellInfo *> &cells_of(IdString type) const;
+    // The cells matching a predicate such as is_lut, in name order. The predicate must only depend on the cell type,
+    // as it is only tested once per type
+    std::vector<CellInfo *> cells_matching(const std::function<bool(const CellInfo *)> &type_pred) const;
+
+    // An output port of one cell driving an input port of another, the two of which are packed together
+    struct PairRule
+    {
+        std::function<bool(const CellInfo *)> driver_pred;
+        IdString driver_port;
+        std::function<bool(const CellInfo *)> user_pred;
+        IdString user_port;
+        // Whether the user must be the only load of the net
+        bool exclusive = true;
+        // Any further check on a candidate pair, such as for conflicting BEL constraints. This and user_pred are
+        // called from several threads, so must only read the netlist (and not create IdStrings)
+        std::function<bool(const CellInfo *driver, const CellInfo *user)> compatible;
+    };
+    // All cells matching the driver predicate, in name order, each with the cell it pairs with or nullptr. Matching
+    // only reads the netlist, so large designs are matched in parallel
+    std::vector<std::pair<CellInfo *, CellInfo *>> match_pairs(const PairRule &rule) const;
+
+    // Transformation of a cell into a new type. Ports not in the port maps are kept, with any [] removed
+    struct XFormRule
+    {
+        IdString new_type;
+        std::unordered_map<IdString, IdString> port_xform;
+        std::unordered_map<IdString, std::vector<IdString>> port_multixform;
+        std::unordered_map<IdString, IdString> param_xform;
+        std::vector<std::pair<IdString, std::string>> set_attrs;
+        std::vector<std::pair<IdString, Property>> set_params;
+        std::vector<std::pair<IdString, Property>> default_params;
+        // Parameters (old name, new name, width, default) converted by param_parser
+        std::vector<std::tuple<IdString, IdString, int, int64_t>> parse_params;
+    };
+    // Arch parser of the parameter values named in parse_params
+    std::function<Property(const CellInfo *, IdString, int, int64_t)> param_parser;
+
+    void xform_cell(const std::unordered_map<IdString, XFormRule> &rules, CellInfo *ci);
+    // Transform every indexed cell with a rule, in name order, and update the index to match
+    void xform(const std::unordered_map<IdString, XFormRule> &rules, bool print_summary = false);
+
+  private:
+    Context *ctx;
+    int threads;
+    std::unordered_map<IdString, std::vector<CellInfo *>> by_type;
+    const std::vector<CellInfo *> no_cells;
+
+    // Port names with any [] removed, as the same names turn up on cell after cell
+    std::unordered_map<IdString, IdString> stripped_port_names;
+    IdString strip_port_name(IdString pname);
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -19,8 +19,10 @@
 
 #include "place_common.h"
 #include <cmath>
+#include <numeric>
 #include "log.h"
 #include "util.h"
+#include "worker_pool.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -77,6 +79,98 @@ wirelen_t get_net_metric(const Context *ctx, const NetInfo *net, MetricType type
     return wirelength;
 }
 
+namespace {
+// Run func(begin, end) over ranges of [0, n), on worker threads if there are enough items to be worth it
+template <typename Tf> void for_ranges(int n, int threads, Tf func)
+{
+#ifndef NPNR_DISABLE_THREADS
+    const int min_range = 4096;
+    int ranges = std::min(threads * 4, n / min_range);
+    if (threads > 1 && ranges > 1) {
+        WorkerPool pool(threads);
+        std::vector<int> tasks(ranges);
+        std::iota(tasks.begin(), tasks.end(), 0);
+        pool.run(tasks, [&](int r) { func(int(int64_t(n) * r / ranges), int(int64_t(n) * (r + 1) / ranges)); });
+        return;
+    }
+#endif
+    func(0, n);
+}
+} // namespace
+
+NetPinLocations::NetPinLocations(const Context *ctx, const std::vector<const NetInfo *> &nets, int threads)
+        : nets(nets)
+{
+    int n = int(nets.size());
+    auto is_pin = [&](const CellInfo *cell) {
+        return cell != nullptr && cell->bel != BelId() && !ctx->getBelGlobalBuf(cell->bel);
+    };
+    // Count the pins of each net, then fill in the locations of each net's slice of the arrays
+    offset.assign(n + 1, 0);
+    for_ranges(n, threads, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const NetInfo *ni = nets.at(i);
+            if (!is_pin(ni->driver.cell))
+                continue;
+            int count = 1;
+            for (auto &usr : ni->users)
+                if (is_pin(usr.cell))
+                    ++count;
+            offset.at(i + 1) = count;
+        }
+    });
+    std::partial_sum(offset.begin(), offset.end(), offset.begin());
+    x.resize(offset.back());
+    y.resize(offset.back());
+    for_ranges(n, threads, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const NetInfo *ni = nets.at(i);
+            int pin = offset.at(i);
+            if (pin == offset.at(i + 1))
+                continue;
+            auto add_pin = [&](const CellInfo *cell) {
+                Loc loc = ctx->getBelLocation(cell->bel);
+                x[pin] = loc.x;
+                y[pin] = loc.y;
+                ++pin;
+            };
+            add_pin(ni->driver.cell);
+            for (auto &usr : ni->users)
+                if (is_pin(usr.cell))
+                    add_pin(usr.cell);
+        }
+    });
+}
+
+std::vector<wirelen_t> NetPinLocations::hpwl() const
+{
+    std::vector<wirelen_t> result(nets.size(), 0);
+    for (size_t i = 0; i < nets.size(); i++) {
+        int begin = offset[i], end = offset[i + 1];
+        if (begin == end)
+            continue;
+        int xmin = x[begin], xmax = x[begin], ymin = y[begin], ymax = y[begin];
+        for (int j = begin + 1; j < end; j++) {
+            xmin = std::min(xmin, x[j]);
+            xmax = std::max(xmax, x[j]);
+            ymin = std::min(ymin, y[j]);
+            ymax = std::max(ymax, y[j]);
+        }
+        result[i] = wirelen_t(xmax - xmin) + wirelen_t(ymax - ymin);
+    }
+    return result;
+}
+
+wirelen_t get_total_hpwl(const Context *ctx, int threads)
+{
+    std::vector<const NetInfo *> nets;
+    nets.reserve(ctx->nets.size());
+    for (auto &net : ctx->nets)
+        nets.push_back(net.second.get());
+    auto hpwl = NetPinLocations(ctx, nets, threads).hpwl();
+    return std::accumulate(hpwl.begin(), hpwl.end(), wirelen_t(0));
+}
+
 // Get the total wirelength for a cell
 wirelen_t get_cell_metric(const Context *ctx, const CellInfo *cell, MetricType type)
 {
@@ -172,6 +266,18 @@ class ConstraintLegaliseWorker
     Context *ctx;
     std::set<IdString> rippedCells;
     std::unordered_map<IdString, Loc> oldLocations;
+    // Number of bels in each tile bound with at least STRENGTH_STRONG. Chains aren't placed in tiles with any, so
+    // this lets a candidate location be rejected without looking at every bel of its tile
+    std::vector<int> strongTileBels;
+
+    int tile_index(Loc loc) const { return loc.y * ctx->getGridDimX() + loc.x; }
+
+    void count_strong(const CellInfo *cell, int delta)
+    {
+        if (cell->bel != BelId() && cell->belStrength >= STRENGTH_STRONG)
+            strongTileBels.at(tile_index(ctx->getBelLocation(cell->bel))) += delta;
+    }
+
     class IncreasingDiameterSearch
     {
       public:
@@ -239,11 +345,8 @@ class ConstraintLegaliseWorker
             }
         }
         // Don't place at tiles where any strongly bound Bels exist, as we might need to rip them up later
-        for (auto tilebel : ctx->getBelsByTile(loc.x, loc.y)) {
-            CellInfo *tcell = ctx->getBoundBelCell(tilebel);
-            if (tcell && tcell->belStrength >= STRENGTH_STRONG)
-                return false;
-        }
+        if (strongTileBels.at(tile_index(loc)) > 0)
+            return false;
         usedLocations.insert(loc);
         for (auto child : cell->constr_children) {
             IncreasingDiameterSearch xSearch, ySearch, zSearch;
@@ -304,7 +407,10 @@ class ConstraintLegaliseWorker
     // Set the strength to locked on all cells in chain
     void lockdown_chain(CellInfo *root)
     {
+        bool was_strong = root->belStrength >= STRENGTH_STRONG;
         root->belStrength = STRENGTH_STRONG;
+        if (!was_strong)
+            count_strong(root, 1);
         for (auto child : root->constr_children)
             lockdown_chain(child);
     }
@@ -361,8 +467,10 @@ class ConstraintLegaliseWorker
                 if (valid_loc_for(cell, rootLoc, solution, used)) {
                     for (auto cp : solution) {
                         // First unbind all cells
-                        if (ctx->cells.at(cp.first)->bel != BelId())
-                            ctx->unbindBel(ctx->cells.at(cp.first)->bel);
+                        CellInfo *ci = ctx->cells.at(cp.first).get();
+                        count_strong(ci, -1);
+                        if (ci->bel != BelId())
+                            ctx->unbindBel(ci->bel);
                     }
                     for (auto cp : solution) {
                         if (ctx->verbose)
@@ -381,6 +489,7 @@ class ConstraintLegaliseWorker
                             }
                         }
                         ctx->bindBel(target, ctx->cells.at(cp.first).get(), STRENGTH_STRONG);
+                        count_strong(ctx->cells.at(cp.first).get(), 1);
                         rippedCells.erase(cp.first);
                     }
                     for (auto cp : solution) {
@@ -463,8 +572,10 @@ class ConstraintLegaliseWorker
     int legalise_constraints()
     {
         log_info("Legalising relative constraints...\n");
+        strongTileBels.assign(ctx->getGridDimX() * ctx->getGridDimY(), 0);
         for (auto cell : sorted(ctx->cells)) {
             oldLocations[cell.first] = ctx->getBelLocation(cell.second->bel);
+            count_strong(cell.second, 1);
         }
         for (auto cell : sorted(ctx->cells)) {
             bool res = legalise_cell(cell.second);
@@ -529,12 +640,71 @@ int get_constraints_distance(const Context *ctx, const CellInfo *cell)
     return dist;
 }
 
-bool check_cell_bel_region(const CellInfo *cell, BelId bel)
+bool check_cell_bel_region(const Context *ctx, const CellInfo *cell, BelId bel)
 {
-    if (cell->region != nullptr && cell->region->constr_bels && !cell->region->bels.count(bel))
+    if (cell->region != nullptr && cell->region->constr_bels && !cell->region->bels.contains(ctx->getBelLocation(bel)))
         return false;
     else
         return true;
 }
 
+BelId CellMoveBatch::swap(CellInfo *cell, BelId new_bel)
+{
+    BelId old_bel = cell->bel;
+    moves.emplace_back(cell, old_bel);
+    do_swap(cell, new_bel);
+    return old_bel;
+}
+
+void CellMoveBatch::undo_last()
+{
+    NPNR_ASSERT(!moves.empty());
+    do_swap(moves.back().first, moves.back().second);
+    moves.pop_back();
+}
+
+void CellMoveBatch::rollback()
+{
+    while (!moves.empty())
+        undo_last();
+}
+
+bool CellMoveBatch::is_legal() const
+{
+    for (const auto &move : moves) {
+        CellInfo *cell = move.first;
+        if (!ctx->isBelLocationValid(cell->bel) || !check_cell_bel_region(ctx, cell, cell->bel))
+            return false;
+        if (move.second == cell->bel)
+            continue;
+        if (!ctx->isBelLocationValid(move.second))
+            return false;
+        CellInfo *swapped = ctx->getBoundBelCell(move.second);
+        if (swapped != nullptr && !check_cell_bel_region(ctx, swapped, move.second))
+            return false;
+    }
+    return true;
+}
+
+void CellMoveBatch::do_swap(CellInfo *cell, BelId new_bel)
+{
+    BelId old_bel = cell->bel;
+    if (old_bel == new_bel)
+        return;
+    CellInfo *other_cell = ctx->getBoundBelCell(new_bel);
+    PlaceStrength strength = cell->belStrength;
+    ctx->unbindBel(old_bel);
+    if (other_cell != nullptr) {
+        PlaceStrength other_strength = other_cell->belStrength;
+        ctx->unbindBel(new_bel);
+        ctx->bindBel(old_bel, other_cell, other_strength);
+    }
+    ctx->bindBel(new_bel, cell, strength);
+    if (on_move) {
+        on_move(cell, old_bel, new_bel);
+        if (other_cell != nullptr)
+            on_move(other_cell, new_bel, old_bel);
+    }
+}
+
 NEXTPNR_NAMESPACE_END
@@ -20,6 +20,7 @@
 #ifndef PLACE_COMMON_H
 #define PLACE_COMMON_H
 
+#include <functional>
 #include "nextpnr.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -35,6 +36,26 @@ enum class MetricType
 // Return the wirelength of a net
 wirelen_t get_net_metric(const Context *ctx, const NetInfo *net, MetricType type, float &tns);
 
+// Pin locations of a set of nets, gathered into contiguous arrays so that whole-design metrics are a min/max reduction
+// over each net's slice of the arrays, which the compiler can vectorise, rather than a walk over every port of the
+// netlist. As in get_net_metric, pins on unplaced cells or global buffers are left out, as are all pins of nets with
+// an unplaced or global driver. The gathering is split between threads for large designs.
+struct NetPinLocations
+{
+    NetPinLocations(const Context *ctx, const std::vector<const NetInfo *> &nets, int threads = 1);
+
+    // Half-perimeter wirelength of each net, in the order the nets were given
+    std::vector<wirelen_t> hpwl() const;
+
+    std::vector<const NetInfo *> nets;
+    // Pins of nets[i] are at [offset[i], offset[i + 1])
+    std::vector<int> offset;
+    std::vector<int> x, y;
+};
+
+// Total half-perimeter wirelength of the design, the sum of get_net_metric with MetricType::WIRELENGTH over all nets
+wirelen_t get_total_hpwl(const Context *ctx, int threads = 1);
+
 // Return the wirelength of all nets connected to a cell
 wirelen_t get_cell_metric(const Context *ctx, const CellInfo *cell, MetricType type);
 
@@ -51,7 +72,38 @@ bool legalise_relative_constraints(Context *ctx);
 int get_constraints_distance(const Context *ctx, const CellInfo *cell);
 
 // Check that a Bel is within the region for a cell
-bool check_cell_bel_region(const CellInfo *cell, BelId bel);
+bool check_cell_bel_region(const Context *ctx, const CellInfo *cell, BelId bel);
+
+// A batch of cell swaps, which are applied to the design as they are made so that the whole batch can then be checked
+// for legality and either kept or undone. Each cell keeps its binding strength
+struct CellMoveBatch
+{
+    explicit CellMoveBatch(Context *ctx) : ctx(ctx){};
+
+    // Move a cell to new_bel, moving the cell bound there (if any) to the Bel the cell was at, which is returned
+    BelId swap(CellInfo *cell, BelId new_bel);
+    // Undo the last swap
+    void undo_last();
+    // Undo all swaps, in reverse order
+    void rollback();
+    // Keep all swaps made so far, and start a new batch
+    void commit() { moves.clear(); }
+
+    // Whether every Bel changed by the batch is valid, and every moved cell is within its region
+    bool is_legal() const;
+
+    bool empty() const { return moves.empty(); }
+
+    // The swaps made, as <cell, Bel it was at before>
+    std::vector<std::pair<CellInfo *, BelId>> moves;
+    // If set, called for every cell moved, including those moved by undo_last and rollback, with the cell and the Bels
+    // it moved from and to
+    std::function<void(CellInfo *, BelId, BelId)> on_move;
+
+  private:
+    Context *ctx;
+    void do_swap(CellInfo *cell, BelId new_bel);
+};
 
 NEXTPNR_NAMESPACE_END
 
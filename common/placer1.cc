@@ -23,14 +23,15 @@
 
 #include "placer1.h"
 #include <algorithm>
+#include <atomic>
 #include <boost/lexical_cast.hpp>
-#include <boost/range/adaptor/reversed.hpp>
 #include <chrono>
 #include <cmath>
 #include <iostream>
 #include <limits>
 #include <list>
 #include <map>
+#include <numeric>
 #include <ostream>
 #include <queue>
 #include <set>
@@ -39,10 +40,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <vector>
+#include "congestion.h"
+#include "delay_cache.h"
 #include "log.h"
 #include "place_common.h"
+#include "profiler.h"
 #include "timing.h"
 #include "util.h"
+#include "worker_pool.h"
 
 namespace std {
 template <> struct hash<std::pair<NEXTPNR_NAMESPACE_PREFIX IdString, std::size_t>>
@@ -74,9 +79,24 @@ class SAPlacer
         }
     };
 
+    // An index of the tiles of fast_bels for one Bel type that contain at least one Bel, for picking a random tile
+    // within a window without retries
+    struct TileIndex
+    {
+        // Number of non-empty tiles with x' < x and y' < y, at x * (max_y + 2) + y
+        std::vector<int> prefix;
+        // Per x, the y coordinates of the non-empty tiles in ascending order
+        std::vector<std::vector<int>> col_rows;
+    };
+
   public:
-    SAPlacer(Context *ctx, Placer1Cfg cfg) : ctx(ctx), cfg(cfg)
+    SAPlacer(Context *ctx, Placer1Cfg cfg) : ctx(ctx), cfg(cfg), delay_cache(ctx), chain_move(ctx)
     {
+        if (cfg.netShareWeight > 0)
+            chain_move.on_move = [this](CellInfo *cell, BelId old_bel, BelId new_bel) {
+                update_nets_by_tile(cell, this->ctx->getBelLocation(old_bel), this->ctx->getBelLocation(new_bel));
+            };
+
         int num_bel_types = 0;
         for (auto bel : ctx->getBels()) {
             IdString type = ctx->getBelType(bel);
@@ -104,6 +124,7 @@ class SAPlacer
             fast_bels.at(type_idx).at(loc.x).at(loc.y).push_back(bel);
         }
         diameter = std::max(max_x, max_y) + 1;
+        build_tile_index();
 
         net_bounds.resize(ctx->nets.size());
         net_arc_tcost.resize(ctx->nets.size());
@@ -124,13 +145,12 @@ class SAPlacer
                 bb.x1 = std::numeric_limits<int>::min();
                 bb.y0 = std::numeric_limits<int>::max();
                 bb.y1 = std::numeric_limits<int>::min();
-                for (auto bel : r->bels) {
-                    Loc loc = ctx->getBelLocation(bel);
+                r->bels.for_each([&](Loc loc) {
                     bb.x0 = std::min(bb.x0, loc.x);
                     bb.x1 = std::max(bb.x1, loc.x);
                     bb.y0 = std::min(bb.y0, loc.y);
                     bb.y1 = std::max(bb.y1, loc.y);
-                }
+                });
             } else {
                 bb.x0 = 0;
                 bb.y0 = 0;
@@ -146,10 +166,13 @@ class SAPlacer
     {
         for (auto &net : ctx->nets)
             net.second->udata = old_udata[net.second->udata];
+        for (auto &cell : ctx->cells)
+            cell.second->udata = old_cell_udata[cell.second->udata];
     }
 
     bool place(bool refine = false)
     {
+        NPNR_PROFILE_ZONE(refine ? "SA refine" : "SA");
         log_break();
         ctx->lock();
 
@@ -212,8 +235,12 @@ class SAPlacer
             // Place cells randomly initially
             log_info("Creating initial placement for remaining %d cells.\n", int(autoplaced.size()));
 
+            int guided_cells = 0;
             for (auto cell : autoplaced) {
-                place_initial(cell);
+                if (place_guided(cell))
+                    guided_cells++;
+                else
+                    place_initial(cell);
                 placed_cells++;
                 if ((placed_cells - constr_placed_cells) % 500 == 0)
                     log_info("  initial placement placed %d/%d cells\n", int(placed_cells - constr_placed_cells),
@@ -223,11 +250,16 @@ class SAPlacer
                 log_info("  initial placement placed %d/%d cells\n", int(placed_cells - constr_placed_cells),
                          int(autoplaced.size()));
             if (cfg.budgetBased && cfg.slack_redist_iter > 0)
-                assign_budget(ctx);
+                assign_budget(ctx, false, get_timing_graph());
             ctx->yield();
             auto iplace_end = std::chrono::high_resolution_clock::now();
             log_info("Initial placement time %.02fs\n",
                      std::chrono::duration<float>(iplace_end - iplace_start).count());
+            if (guided_cells > 0)
+                log_info("Started %d/%d cells at their bels in the placement guide.\n", guided_cells,
+                         int(autoplaced.size()));
+            // Starting from a guide that nearly all cells could follow, the placement only needs touching up
+            guided = guided_cells > 0 && guided_cells >= 0.9 * autoplaced.size();
             log_info("Running simulated annealing placer.\n");
         } else {
             for (auto &cell : ctx->cells) {
@@ -243,16 +275,30 @@ class SAPlacer
             }
             require_legal = false;
             diameter = 3;
-            log_info("Running simulated annealing placer for refinement.\n");
+#ifndef NPNR_DISABLE_THREADS
+            if (cfg.threads > 1 && cfg.netShareWeight <= 0) {
+                refine_pool.reset(new WorkerPool(cfg.threads));
+                refine_move_data.resize(cfg.threads);
+                for (auto &md : refine_move_data) {
+                    md.init(this);
+                    refine_free_move_data.push_back(&md);
+                }
+                log_info("Running simulated annealing placer for refinement with %d threads.\n", cfg.threads);
+            } else
+#endif
+                log_info("Running simulated annealing placer for refinement.\n");
         }
         auto saplace_start = std::chrono::high_resolution_clock::now();
 
         // Invoke timing analysis to obtain criticalities
+        if (!cfg.budgetBased && cfg.timing_driven && cfg.incrementalTiming)
+            incr_timing.reset(new IncrementalCriticality(ctx));
         if (!cfg.budgetBased)
-            get_criticalities(ctx, &net_crit);
+            update_timing();
 
         // Calculate costs after initial placement
         setup_costs();
+        update_congestion_weights();
         moveChange.init(this);
         curr_wirelen_cost = total_wirelen_cost();
         curr_timing_cost = total_timing_cost();
@@ -266,10 +312,12 @@ class SAPlacer
         wirelen_t min_wirelen = curr_wirelen_cost;
 
         int n_no_progress = 0;
-        temp = refine ? 1e-7 : cfg.startTemp;
+        temp = refine ? 1e-7 : (guided ? std::min(cfg.startTemp, cfg.guideStartTemp) : cfg.startTemp);
+        int64_t total_moves = 0, total_sweeps = 0;
 
         // Main simulated annealing loop
         for (int iter = 1;; iter++) {
+            NPNR_PROFILE_ZONE("iteration");
             n_move = n_accept = 0;
             improved = false;
 
@@ -278,15 +326,22 @@ class SAPlacer
                          "%.0f, wirelen = %.0f\n",
                          iter, temp, double(curr_timing_cost), double(curr_wirelen_cost));
 
-            for (int m = 0; m < 15; ++m) {
-                // Loop through all automatically placed cells
-                for (auto cell : autoplaced) {
-                    // Find another random Bel for this cell
-                    BelId try_bel = random_bel_for_cell(cell);
-                    // If valid, try and swap to a new position and see if
-                    // the new position is valid/worthwhile
-                    if (try_bel != BelId() && try_bel != cell->bel)
-                        try_swap_position(cell, try_bel);
+            for (int m = 0; m < sweeps_per_temp; ++m) {
+#ifndef NPNR_DISABLE_THREADS
+                if (refine_pool != nullptr) {
+                    parallel_refine_pass(autoplaced);
+                } else
+#endif
+                {
+                    // Loop through all automatically placed cells
+                    for (auto cell : autoplaced) {
+                        // Find another random Bel for this cell
+                        BelId try_bel = random_bel_for_cell(cell);
+                        // If valid, try and swap to a new position and see if
+                        // the new position is valid/worthwhile
+                        if (try_bel != BelId() && try_bel != cell->bel)
+                            try_swap_position(cell, try_bel);
+                    }
                 }
                 // Also try swapping chains, if applicable
                 for (auto cb : chain_basis) {
@@ -333,6 +388,18 @@ class SAPlacer
                 break;
             }
 
+            double elapsed =
+                    std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - saplace_start).count();
+            if (cfg.timeBudget > 0 && elapsed >= cfg.timeBudget) {
+                // The placement must still be legal at the end, even if annealing never cooled enough to legalise
+                if (require_legal)
+                    legalise_relative_constraints(ctx);
+                log_info("  at iteration #%d: temp = %f, timing cost = "
+                         "%.0f, wirelen = %.0f, time budget of %.02fs reached\n",
+                         iter, temp, double(curr_timing_cost), double(curr_wirelen_cost), cfg.timeBudget);
+                break;
+            }
+
             double Raccept = double(n_accept) / double(n_move);
 
             int M = std::max(max_x, max_y) + 1;
@@ -377,18 +444,19 @@ class SAPlacer
 
                     // Legalisation is a big change so force a slack redistribution here
                     if (cfg.slack_redist_iter > 0 && cfg.budgetBased)
-                        assign_budget(ctx, true /* quiet */);
+                        assign_budget(ctx, true /* quiet */, get_timing_graph());
                 }
                 require_legal = false;
             } else if (cfg.budgetBased && cfg.slack_redist_iter > 0 && iter % cfg.slack_redist_iter == 0) {
-                assign_budget(ctx, true /* quiet */);
+                assign_budget(ctx, true /* quiet */, get_timing_graph());
             }
 
             // Invoke timing analysis to obtain criticalities
             if (!cfg.budgetBased && cfg.timing_driven)
-                get_criticalities(ctx, &net_crit);
+                update_timing();
             // Need to rebuild costs after criticalities change
             setup_costs();
+            update_congestion_weights();
             // Reset incremental bounds
             moveChange.reset(this);
             moveChange.new_net_bounds = net_bounds;
@@ -401,10 +469,24 @@ class SAPlacer
             last_timing_cost = curr_timing_cost;
             // Let the UI show visualization updates.
             ctx->yield();
+            ctx->autosave();
+
+            total_moves += n_move;
+            total_sweeps += sweeps_per_temp;
+            if (cfg.timeBudget > 0) {
+                elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - saplace_start)
+                                  .count();
+                update_sweeps_per_temp(iter, refine, total_moves, total_sweeps, elapsed);
+            }
         }
 
         auto saplace_end = std::chrono::high_resolution_clock::now();
         log_info("SA placement time %.02fs\n", std::chrono::duration<float>(saplace_end - saplace_start).count());
+        throughput_track("placer1/moves", total_moves,
+                         std::chrono::duration<double>(saplace_end - saplace_start).count());
+        if (bel_picks > 0)
+            log_info("  %.1f%% of random Bel picks were retried\n",
+                     100.0 * double(bel_picks - bel_picks_found) / double(bel_picks));
 
         // Final post-placement validity check
         ctx->yield();
@@ -435,6 +517,23 @@ class SAPlacer
     }
 
   private:
+    // Place a cell at its bel in the placement guide, if that is still free and valid for it
+    bool place_guided(CellInfo *cell)
+    {
+        auto found = ctx->placement_guide.find(cell->name);
+        if (found == ctx->placement_guide.end())
+            return false;
+        BelId bel = found->second;
+        if (ctx->getBelType(bel) != cell->type || !ctx->checkBelAvail(bel) || !ctx->isValidBelForCell(cell, bel))
+            return false;
+        if (cell->region != nullptr && cell->region->constr_bels &&
+            !cell->region->bels.contains(ctx->getBelLocation(bel)))
+            return false;
+        ctx->bindBel(bel, cell, STRENGTH_WEAK);
+        cell->attrs[ctx->id("BEL")] = ctx->getBelName(bel).str(ctx);
+        return true;
+    }
+
     // Initial random placement
     void place_initial(CellInfo *cell)
     {
@@ -472,9 +571,7 @@ class SAPlacer
             };
 
             if (cell->region != nullptr && cell->region->constr_bels) {
-                for (auto bel : cell->region->bels) {
-                    proc_bel(bel);
-                }
+                cell->region->bels.for_each([&](Loc loc) { proc_bel(ctx->getBelByLocation(loc)); });
             } else {
                 for (auto bel : ctx->getBels()) {
                     proc_bel(bel);
@@ -593,28 +690,6 @@ class SAPlacer
         return cell->constr_parent != nullptr || !cell->constr_children.empty();
     }
 
-    // Swap the Bel of a cell with another, return the original location
-    BelId swap_cell_bels(CellInfo *cell, BelId newBel)
-    {
-        BelId oldBel = cell->bel;
-#if 0
-        log_info("%s old: %s new: %s\n", cell->name.c_str(ctx), ctx->getBelName(cell->bel).c_str(ctx), ctx->getBelName(newBel).c_str(ctx));
-#endif
-        CellInfo *bound = ctx->getBoundBelCell(newBel);
-        if (bound != nullptr)
-            ctx->unbindBel(newBel);
-        ctx->unbindBel(oldBel);
-        ctx->bindBel(newBel, cell, is_constrained(cell) ? STRENGTH_STRONG : STRENGTH_WEAK);
-        if (bound != nullptr) {
-            ctx->bindBel(oldBel, bound, is_constrained(bound) ? STRENGTH_STRONG : STRENGTH_WEAK);
-            if (cfg.netShareWeight > 0)
-                update_nets_by_tile(bound, ctx->getBelLocation(newBel), ctx->getBelLocation(oldBel));
-        }
-        if (cfg.netShareWeight > 0)
-            update_nets_by_tile(cell, ctx->getBelLocation(oldBel), ctx->getBelLocation(newBel));
-        return oldBel;
-    }
-
     // Discover the relative positions of all cells in a chain
     void discover_chain(Loc baseLoc, CellInfo *cell, std::vector<std::pair<CellInfo *, Loc>> &cell_rel)
     {
@@ -630,7 +705,6 @@ class SAPlacer
     {
         std::vector<std::pair<CellInfo *, Loc>> cell_rel;
         std::unordered_set<IdString> cells;
-        std::vector<std::pair<CellInfo *, BelId>> moves_made;
         std::vector<std::pair<CellInfo *, BelId>> dest_bels;
         double delta = 0;
         int orig_share_cost = total_net_share;
@@ -661,28 +735,21 @@ class SAPlacer
                 return false;
             dest_bels.emplace_back(std::make_pair(cr.first, targetBel));
         }
+        // Check the result of the swaps is legal before making any of them, as unbinding and rebinding a long chain
+        // is expensive and most chain moves fail this check
+        if (!chain_swap_valid(dest_bels))
+            return false;
 #if 0
         if (ctx->debug)
             log_info("trying chain swap %s\n", cell->name.c_str(ctx));
 #endif
-        // <cell, oldBel>
         for (const auto &db : dest_bels) {
-            BelId oldBel = swap_cell_bels(db.first, db.second);
-            moves_made.emplace_back(std::make_pair(db.first, oldBel));
+            BelId oldBel = chain_move.swap(db.first, db.second);
             CellInfo *bound = ctx->getBoundBelCell(oldBel);
             add_move_cell(moveChange, db.first, oldBel);
             if (bound != nullptr)
                 add_move_cell(moveChange, bound, db.second);
         }
-        for (const auto &mm : moves_made) {
-            if (!ctx->isBelLocationValid(mm.first->bel) || !check_cell_bel_region(mm.first, mm.first->bel))
-                goto swap_fail;
-            if (!ctx->isBelLocationValid(mm.second))
-                goto swap_fail;
-            CellInfo *bound = ctx->getBoundBelCell(mm.second);
-            if (bound && !check_cell_bel_region(bound, bound->bel))
-                goto swap_fail;
-        }
         compute_cost_changes(moveChange);
         delta = lambda * (moveChange.timing_delta / last_timing_cost) +
                 (1 - lambda) * (double(moveChange.wirelen_delta) / last_wirelen_cost);
@@ -702,20 +769,80 @@ class SAPlacer
             goto swap_fail;
         }
         commit_cost_changes(moveChange);
+        chain_move.commit();
         return true;
     swap_fail:
-        for (const auto &entry : boost::adaptors::reverse(moves_made))
-            swap_cell_bels(entry.first, entry.second);
+        chain_move.rollback();
         return false;
     }
 
+    // Return true if swapping each cell in turn to its new Bel, as try_swap_chain does, would give a legal placement.
+    // The swaps are simulated in chain_overlay, which holds the cell bound to every Bel they change afterwards
+    bool chain_swap_valid(const std::vector<std::pair<CellInfo *, BelId>> &dest_bels)
+    {
+        chain_overlay.clear();
+        chain_cell_bel.clear();
+        auto bound_cell = [&](BelId bel) {
+            auto found = chain_overlay.find(bel);
+            return found != chain_overlay.end() ? found->second : ctx->getBoundBelCell(bel);
+        };
+        auto cell_bel = [&](CellInfo *cell) {
+            auto found = chain_cell_bel.find(cell);
+            return found != chain_cell_bel.end() ? found->second : cell->bel;
+        };
+        for (const auto &db : dest_bels) {
+            BelId oldBel = cell_bel(db.first);
+            CellInfo *bound = bound_cell(db.second);
+            chain_overlay[oldBel] = bound;
+            chain_overlay[db.second] = db.first;
+            chain_cell_bel[db.first] = db.second;
+            if (bound != nullptr)
+                chain_cell_bel[bound] = oldBel;
+        }
+        for (const auto &ov : chain_overlay) {
+            if (ov.second != nullptr && !check_cell_bel_region(ctx, ov.second, ov.first))
+                return false;
+            if (!ctx->isBelLocationValidWith(ov.first, chain_overlay))
+                return false;
+        }
+        return true;
+    }
+
+    // With a time budget, choose the number of sweeps over all cells per temperature so that annealing is expected to
+    // finish within the budget. The time per sweep is measured so far, including the work done once per temperature;
+    // the number of temperatures left is estimated from the average cooling rate so far
+    void update_sweeps_per_temp(int iter, bool refine, int64_t total_moves, int64_t total_sweeps, double elapsed)
+    {
+        const double final_temp = 1e-7;
+        const int final_iters = refine ? 1 : 5;
+        double cooling = (refine || temp >= cfg.startTemp) ? 0.9 : std::pow(temp / cfg.startTemp, 1.0 / iter);
+        cooling = std::min(cooling, 0.99);
+        double iters_left = final_iters;
+        if (temp > final_temp)
+            iters_left += std::log(final_temp / temp) / std::log(cooling);
+        double time_per_sweep = elapsed / double(total_sweeps);
+        double time_left = std::max(0.0, cfg.timeBudget - elapsed);
+        int sweeps = int(time_left / (iters_left * time_per_sweep));
+        sweeps = std::max(1, std::min(sweeps, max_sweeps_per_temp));
+        if (iter == 1 || (ctx->verbose && sweeps != sweeps_per_temp))
+            log_info("  %.0f moves/s, %.0f temperatures left in %.02fs, using %d sweeps per temperature\n",
+                     double(total_moves) / elapsed, iters_left, time_left, sweeps);
+        sweeps_per_temp = sweeps;
+    }
+
     // Find a random Bel of the correct type for a cell, within the specified
     // diameter
     BelId random_bel_for_cell(CellInfo *cell, int force_z = -1)
+    {
+        return random_bel_for_cell(cell, force_z, *ctx, 0, std::numeric_limits<int>::max());
+    }
+
+    // As above, using a given random number generator and only picking Bels with an x coordinate in the range
+    // [min_x, max_x] (if the Bel type is picked by grid location)
+    BelId random_bel_for_cell(CellInfo *cell, int force_z, DeterministicRNG &rng, int min_x, int max_x)
     {
         IdString targetType = cell->type;
         Loc curr_loc = ctx->getBelLocation(cell->bel);
-        int count = 0;
 
         int dx = diameter, dy = diameter;
         if (cell->region != nullptr && cell->region->constr_bels) {
@@ -730,35 +857,97 @@ class SAPlacer
             curr_loc.y = std::min(region_bounds[cell->region->name].y1, curr_loc.y);
         }
 
+        int beltype_idx, beltype_cnt;
+        std::tie(beltype_idx, beltype_cnt) = bel_types.at(targetType);
+        // The window is the same as picking nx and ny uniformly from [x0, x0 + 2 * dx] and [y0, y0 + 2 * dy], and
+        // retrying until a non-empty tile is found, but the non-empty tile is found directly from the index
+        int x0 = std::max(curr_loc.x - dx, min_x), y0 = std::max(curr_loc.y - dy, 0);
+        int x1 = std::min(x0 + 2 * dx, max_x), y1 = y0 + 2 * dy;
+        if (beltype_cnt < cfg.minBelsForGridPick)
+            x0 = x1 = y0 = y1 = 0;
+
         while (true) {
-            int nx = ctx->rng(2 * dx + 1) + std::max(curr_loc.x - dx, 0);
-            int ny = ctx->rng(2 * dy + 1) + std::max(curr_loc.y - dy, 0);
-            int beltype_idx, beltype_cnt;
-            std::tie(beltype_idx, beltype_cnt) = bel_types.at(targetType);
-            if (beltype_cnt < cfg.minBelsForGridPick)
-                nx = ny = 0;
-            if (nx >= int(fast_bels.at(beltype_idx).size()))
-                continue;
-            if (ny >= int(fast_bels.at(beltype_idx).at(nx).size()))
-                continue;
+            int nx, ny;
+            if (!random_tile(beltype_idx, x0, x1, y0, y1, rng, nx, ny))
+                return BelId();
+            bel_picks++;
             const auto &fb = fast_bels.at(beltype_idx).at(nx).at(ny);
-            if (fb.size() == 0)
-                continue;
-            BelId bel = fb.at(ctx->rng(int(fb.size())));
+            BelId bel = fb.at(rng.rng(int(fb.size())));
             if (force_z != -1) {
                 Loc loc = ctx->getBelLocation(bel);
                 if (loc.z != force_z)
                     continue;
             }
-            if (!check_cell_bel_region(cell, bel))
+            if (!check_cell_bel_region(ctx, cell, bel))
                 continue;
             if (locked_bels.find(bel) != locked_bels.end())
                 continue;
-            count++;
+            bel_picks_found++;
             return bel;
         }
     }
 
+    // Build tile_index from fast_bels
+    void build_tile_index()
+    {
+        tile_index.resize(fast_bels.size());
+        int width = max_x + 1, height = max_y + 1, h = height + 1;
+        for (size_t t = 0; t < fast_bels.size(); t++) {
+            auto &ti = tile_index.at(t);
+            ti.prefix.assign((width + 1) * h, 0);
+            ti.col_rows.resize(width);
+            for (int x = 0; x < width; x++) {
+                for (int y = 0; y < height; y++) {
+                    bool used = x < int(fast_bels.at(t).size()) && y < int(fast_bels.at(t).at(x).size()) &&
+                                !fast_bels.at(t).at(x).at(y).empty();
+                    if (used)
+                        ti.col_rows.at(x).push_back(y);
+                    ti.prefix.at((x + 1) * h + (y + 1)) = int(used) + ti.prefix.at(x * h + (y + 1)) +
+                                                         ti.prefix.at((x + 1) * h + y) - ti.prefix.at(x * h + y);
+                }
+            }
+        }
+    }
+
+    // Number of non-empty tiles of a Bel type in [x0, x1] x [y0, y1], which must be within the grid
+    int tile_count(const TileIndex &ti, int x0, int x1, int y0, int y1)
+    {
+        int h = max_y + 2;
+        return ti.prefix.at((x1 + 1) * h + (y1 + 1)) - ti.prefix.at(x0 * h + (y1 + 1)) -
+               ti.prefix.at((x1 + 1) * h + y0) + ti.prefix.at(x0 * h + y0);
+    }
+
+    // Pick a uniformly random non-empty tile of a Bel type in [x0, x1] x [y0, y1], returning false if there is none
+    bool random_tile(int beltype_idx, int x0, int x1, int y0, int y1, DeterministicRNG &rng, int &nx, int &ny)
+    {
+        const auto &ti = tile_index.at(beltype_idx);
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, max_x);
+        y1 = std::min(y1, max_y);
+        if (x0 > x1 || y0 > y1)
+            return false;
+        int count = tile_count(ti, x0, x1, y0, y1);
+        if (count == 0)
+            return false;
+        int k = rng.rng(count);
+        // Find the column containing the k-th tile
+        int lo = x0, hi = x1;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (tile_count(ti, x0, mid, y0, y1) > k)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        nx = lo;
+        if (nx > x0)
+            k -= tile_count(ti, x0, nx - 1, y0, y1);
+        const auto &rows = ti.col_rows.at(nx);
+        ny = *(std::lower_bound(rows.begin(), rows.end(), y0) + k);
+        return true;
+    }
+
     // Return true if a net is to be entirely ignored
     inline bool ignore_net(NetInfo *net)
     {
@@ -813,29 +1002,79 @@ class SAPlacer
         return bb;
     }
 
+    // Record the current location of the pins of every net, and the pin histograms of high fanout nets
+    void setup_pins()
+    {
+        net_pin_start.assign(1, 0);
+        for (auto ni : net_by_udata)
+            net_pin_start.push_back(net_pin_start.back() + 1 + int32_t(ni->users.size()));
+        pin_x.assign(net_pin_start.back(), -1);
+        pin_y.assign(net_pin_start.back(), -1);
+        net_hist.assign(net_by_udata.size(), -1);
+        pin_hists.clear();
+        for (auto ni : net_by_udata) {
+            int32_t start = net_pin_start.at(ni->udata);
+            auto set_pin = [&](int32_t pin, const CellInfo *cell) {
+                if (cell == nullptr || cell->bel == BelId())
+                    return;
+                Loc loc = ctx->getBelLocation(cell->bel);
+                pin_x.at(pin) = loc.x;
+                pin_y.at(pin) = loc.y;
+            };
+            set_pin(start, ni->driver.cell);
+            for (size_t i = 0; i < ni->users.size(); i++)
+                set_pin(start + 1 + int32_t(i), ni->users.at(i).cell);
+            if (int(ni->users.size()) < cfg.bbHistFanout || ignore_net(ni))
+                continue;
+            net_hist.at(ni->udata) = int(pin_hists.size());
+            pin_hists.emplace_back();
+            PinHistogram &hist = pin_hists.back();
+            hist.x.assign(max_x + 1, 0);
+            hist.y.assign(max_y + 1, 0);
+            for (int32_t pin = start; pin < net_pin_start.at(ni->udata + 1); pin++) {
+                if (pin_x.at(pin) < 0)
+                    continue;
+                hist.x.at(pin_x.at(pin))++;
+                hist.y.at(pin_y.at(pin))++;
+            }
+        }
+    }
+
+    // Predicted delay of an arc of a net
+    inline delay_t predict_delay(NetInfo *net, size_t user)
+    {
+        return delay_cache.predict(net_arc_class.at(net->udata).at(user), net, net->users.at(user));
+    }
+
     // Get the timing cost for an arc of a net
     inline double get_timing_cost(NetInfo *net, size_t user)
     {
-        int cc;
         if (net->driver.cell == nullptr)
             return 0;
-        if (ctx->getPortTimingClass(net->driver.cell, net->driver.port, cc) == TMG_IGNORE)
+        if (net_timing_ignored.at(net->udata))
             return 0;
         if (cfg.budgetBased) {
-            double delay = ctx->getDelayNS(ctx->predictDelay(net, net->users.at(user)));
+            double delay = ctx->getDelayNS(predict_delay(net, user));
             return std::min(10.0, std::exp(delay - ctx->getDelayNS(net->users.at(user).budget) / 10));
         } else {
-            auto crit = net_crit.find(net->name);
-            if (crit == net_crit.end() || crit->second.criticality.empty())
+            const NetCriticalityInfo *crit = net_crit_by_udata.at(net->udata);
+            if (crit == nullptr || crit->criticality.empty())
                 return 0;
-            double delay = ctx->getDelayNS(ctx->predictDelay(net, net->users.at(user)));
-            return delay * std::pow(crit->second.criticality.at(user), crit_exp);
+            double delay = ctx->getDelayNS(predict_delay(net, user));
+            return delay * std::pow(crit->criticality.at(user), crit_exp);
         }
     }
 
     // Set up the cost maps
     void setup_costs()
     {
+        net_crit_by_udata.assign(net_by_udata.size(), nullptr);
+        for (auto ni : net_by_udata) {
+            auto crit = net_crit.find(ni->name);
+            if (crit != net_crit.end())
+                net_crit_by_udata.at(ni->udata) = &crit->second;
+        }
+        setup_pins();
         for (auto net : sorted(ctx->nets)) {
             NetInfo *ni = net.second;
             if (ignore_net(ni))
@@ -847,12 +1086,36 @@ class SAPlacer
         }
     }
 
+    // Weight the wiring cost of each net by the estimated congestion inside its bounding box, so that nets are
+    // drawn out of areas that are likely to be hard to route
+    void update_congestion_weights()
+    {
+        if (cfg.congestionWeight <= 0)
+            return;
+        if (congestion == nullptr)
+            congestion = std::unique_ptr<CongestionMap>(new CongestionMap(ctx));
+        congestion->update();
+        net_cong_weight.resize(net_bounds.size());
+        for (size_t i = 0; i < net_bounds.size(); i++) {
+            const BoundingBox &bb = net_bounds.at(i);
+            net_cong_weight.at(i) = 1 + cfg.congestionWeight * congestion->mean_overflow(bb.x0, bb.y0, bb.x1, bb.y1);
+        }
+    }
+
+    // Get the wiring cost of a net with a given bounding box
+    inline wirelen_t net_wirelen_cost(size_t udata, const BoundingBox &bb)
+    {
+        if (net_cong_weight.empty())
+            return bb.hpwl(cfg);
+        return wirelen_t(bb.hpwl(cfg) * net_cong_weight[udata]);
+    }
+
     // Get the total wiring cost for the design
     wirelen_t total_wirelen_cost()
     {
         wirelen_t cost = 0;
-        for (const auto &net : net_bounds)
-            cost += net.hpwl(cfg);
+        for (size_t i = 0; i < net_bounds.size(); i++)
+            cost += net_wirelen_cost(i, net_bounds[i]);
         return cost;
     }
 
@@ -889,6 +1152,15 @@ class SAPlacer
         std::vector<BoundingBox> new_net_bounds;
         std::vector<std::pair<std::pair<decltype(NetInfo::udata), size_t>, double>> new_arc_costs;
 
+        // The pins moved, as an index into pin_x/pin_y, with their old and new locations
+        struct MovedPin
+        {
+            decltype(NetInfo::udata) net;
+            int32_t pin;
+            Loc old_loc, new_loc;
+        };
+        std::vector<MovedPin> moved_pins;
+
         wirelen_t wirelen_delta = 0;
         double timing_delta = 0;
 
@@ -919,6 +1191,7 @@ class SAPlacer
             bounds_changed_nets_y.clear();
             changed_arcs.clear();
             new_arc_costs.clear();
+            moved_pins.clear();
             wirelen_delta = 0;
             timing_delta = 0;
         }
@@ -927,15 +1200,23 @@ class SAPlacer
 
     void add_move_cell(MoveChangeData &mc, CellInfo *cell, BelId old_bel)
     {
-        Loc curr_loc = ctx->getBelLocation(cell->bel);
-        Loc old_loc = ctx->getBelLocation(old_bel);
+        add_move_cell(mc, cell, ctx->getBelLocation(old_bel), ctx->getBelLocation(cell->bel), true);
+    }
+
+    // As above, for a cell moving from old_loc to curr_loc whether or not it is bound there, optionally ignoring the
+    // timing arcs which can only be evaluated once it is
+    void add_move_cell(MoveChangeData &mc, CellInfo *cell, Loc old_loc, Loc curr_loc, bool timing)
+    {
         // Check net bounds
-        for (const auto &port : cell->ports) {
-            NetInfo *pn = port.second.net;
-            if (pn == nullptr)
-                continue;
+        for (int32_t i = cell_ports_start.at(cell->udata); i < cell_ports_start.at(cell->udata + 1); i++) {
+            const CellPortNet &port = cell_ports.at(i);
+            NetInfo *pn = net_by_udata[port.net];
             if (ignore_net(pn))
                 continue;
+            if (port.driver || port.user != -1) {
+                int32_t pin = net_pin_start.at(port.net) + (port.driver ? 0 : 1 + port.user);
+                mc.moved_pins.push_back({port.net, pin, old_loc, curr_loc});
+            }
             BoundingBox &curr_bounds = mc.new_net_bounds[pn->udata];
             // Incremental bounding box updates
             // Note that everything other than full updates are applied immediately rather than being queued,
@@ -1058,19 +1339,17 @@ class SAPlacer
                 }
             }
 
-            if (cfg.timing_driven && int(pn->users.size()) < cfg.timingFanoutThresh) {
+            if (timing && cfg.timing_driven && int(pn->users.size()) < cfg.timingFanoutThresh) {
                 // Output ports - all arcs change timing
-                if (port.second.type == PORT_OUT) {
-                    int cc;
-                    TimingPortClass cls = ctx->getPortTimingClass(cell, port.first, cc);
-                    if (cls != TMG_IGNORE)
+                if (port.type == PORT_OUT) {
+                    if (port.timing)
                         for (size_t i = 0; i < pn->users.size(); i++)
                             if (!mc.already_changed_arcs[pn->udata][i]) {
                                 mc.changed_arcs.emplace_back(std::make_pair(pn->udata, i));
                                 mc.already_changed_arcs[pn->udata][i] = true;
                             }
-                } else if (port.second.type == PORT_IN) {
-                    auto usr = fast_port_to_user.at(&port.second);
+                } else if (port.type == PORT_IN) {
+                    size_t usr = port.user;
                     if (!mc.already_changed_arcs[pn->udata][usr]) {
                         mc.changed_arcs.emplace_back(std::make_pair(pn->udata, usr));
                         mc.already_changed_arcs[pn->udata][usr] = true;
@@ -1080,23 +1359,115 @@ class SAPlacer
         }
     }
 
+    // Apply the pin moves of md to pin_x/pin_y and the histograms, or undo them
+    void move_pins(const MoveChangeData &md, bool undo)
+    {
+        for (size_t i = 0; i < md.moved_pins.size(); i++) {
+            const auto &mp = md.moved_pins.at(undo ? (md.moved_pins.size() - 1 - i) : i);
+            Loc from = undo ? mp.new_loc : mp.old_loc, to = undo ? mp.old_loc : mp.new_loc;
+            pin_x[mp.pin] = to.x;
+            pin_y[mp.pin] = to.y;
+            int h = net_hist[mp.net];
+            if (h != -1) {
+                PinHistogram &hist = pin_hists[h];
+                hist.x[from.x]--;
+                hist.y[from.y]--;
+                hist.x[to.x]++;
+                hist.y[to.y]++;
+            }
+        }
+    }
+
+    // The bounding box of a net, from the pin locations with the move of md applied. This gives the same result as
+    // get_net_bounds, but nets with a histogram only need to scan inwards from their old bounds, and for the others
+    // it is a pass over contiguous arrays without branches that the compiler can vectorise
+    BoundingBox recompute_net_bounds(const MoveChangeData &md, decltype(NetInfo::udata) net)
+    {
+        BoundingBox bb;
+        int h = net_hist.at(net);
+        if (h != -1) {
+            const PinHistogram &hist = pin_hists.at(h);
+            // Pins moved by md may have gone beyond the old bounds
+            bb = net_bounds.at(net);
+            for (const auto &mp : md.moved_pins) {
+                if (mp.net != net)
+                    continue;
+                bb.x0 = std::min(bb.x0, mp.new_loc.x);
+                bb.x1 = std::max(bb.x1, mp.new_loc.x);
+                bb.y0 = std::min(bb.y0, mp.new_loc.y);
+                bb.y1 = std::max(bb.y1, mp.new_loc.y);
+            }
+            while (hist.x[bb.x0] == 0)
+                bb.x0++;
+            while (hist.x[bb.x1] == 0)
+                bb.x1--;
+            while (hist.y[bb.y0] == 0)
+                bb.y0++;
+            while (hist.y[bb.y1] == 0)
+                bb.y1--;
+            bb.nx0 = hist.x[bb.x0];
+            bb.nx1 = hist.x[bb.x1];
+            bb.ny0 = hist.y[bb.y0];
+            bb.ny1 = hist.y[bb.y1];
+            return bb;
+        }
+        const int *xs = pin_x.data(), *ys = pin_y.data();
+        int32_t start = net_pin_start[net], end = net_pin_start[net + 1];
+        // Unplaced pins are at -1, so never above the driver's location, but need skipping for the minimum
+        int x0 = std::numeric_limits<int>::max(), x1 = -1, y0 = std::numeric_limits<int>::max(), y1 = -1;
+        for (int32_t i = start; i < end; i++) {
+            x0 = std::min(x0, xs[i] < 0 ? std::numeric_limits<int>::max() : xs[i]);
+            x1 = std::max(x1, xs[i]);
+            y0 = std::min(y0, ys[i] < 0 ? std::numeric_limits<int>::max() : ys[i]);
+            y1 = std::max(y1, ys[i]);
+        }
+        int nx0 = 0, nx1 = 0, ny0 = 0, ny1 = 0;
+        for (int32_t i = start; i < end; i++) {
+            nx0 += (xs[i] == x0);
+            nx1 += (xs[i] == x1);
+            ny0 += (ys[i] == y0);
+            ny1 += (ys[i] == y1);
+        }
+        bb.x0 = x0;
+        bb.x1 = x1;
+        bb.y0 = y0;
+        bb.y1 = y1;
+        bb.nx0 = nx0;
+        bb.nx1 = nx1;
+        bb.ny0 = ny0;
+        bb.ny1 = ny1;
+        return bb;
+    }
+
     void compute_cost_changes(MoveChangeData &md)
     {
+        // Full recomputes work from the pin locations, so apply the move to them for the duration
+        bool pins_moved = false;
         for (const auto &bc : md.bounds_changed_nets_x) {
-            if (md.already_bounds_changed_x[bc] == MoveChangeData::FULL_RECOMPUTE)
-                md.new_net_bounds[bc] = get_net_bounds(net_by_udata[bc]);
+            if (md.already_bounds_changed_x[bc] == MoveChangeData::FULL_RECOMPUTE) {
+                if (!pins_moved)
+                    move_pins(md, false);
+                pins_moved = true;
+                md.new_net_bounds[bc] = recompute_net_bounds(md, bc);
+            }
         }
         for (const auto &bc : md.bounds_changed_nets_y) {
             if (md.already_bounds_changed_x[bc] != MoveChangeData::FULL_RECOMPUTE &&
-                md.already_bounds_changed_y[bc] == MoveChangeData::FULL_RECOMPUTE)
-                md.new_net_bounds[bc] = get_net_bounds(net_by_udata[bc]);
+                md.already_bounds_changed_y[bc] == MoveChangeData::FULL_RECOMPUTE) {
+                if (!pins_moved)
+                    move_pins(md, false);
+                pins_moved = true;
+                md.new_net_bounds[bc] = recompute_net_bounds(md, bc);
+            }
         }
+        if (pins_moved)
+            move_pins(md, true);
 
         for (const auto &bc : md.bounds_changed_nets_x)
-            md.wirelen_delta += md.new_net_bounds[bc].hpwl(cfg) - net_bounds[bc].hpwl(cfg);
+            md.wirelen_delta += net_wirelen_cost(bc, md.new_net_bounds[bc]) - net_wirelen_cost(bc, net_bounds[bc]);
         for (const auto &bc : md.bounds_changed_nets_y)
             if (md.already_bounds_changed_x[bc] == MoveChangeData::NO_CHANGE)
-                md.wirelen_delta += md.new_net_bounds[bc].hpwl(cfg) - net_bounds[bc].hpwl(cfg);
+                md.wirelen_delta += net_wirelen_cost(bc, md.new_net_bounds[bc]) - net_wirelen_cost(bc, net_bounds[bc]);
 
         if (cfg.timing_driven) {
             for (const auto &tc : md.changed_arcs) {
@@ -1109,8 +1480,118 @@ class SAPlacer
         }
     }
 
+#ifndef NPNR_DISABLE_THREADS
+    // Check whether moving cell to new_bel (swapping with the cell there, if any) would certainly be rejected by
+    // try_swap_position, without binding anything so it can be run in parallel. The wirelength change comes from
+    // md, as for a real move, and the timing cost can at most fall by the current cost of the arcs involved. Moves
+    // that change net bounds in a way that would need a full recompute are never rejected
+    bool can_reject_move(MoveChangeData &md, CellInfo *cell, BelId new_bel)
+    {
+        static const double epsilon = 1e-20;
+        CellInfo *other_cell = ctx->getBoundBelCell(new_bel);
+        Loc old_loc = ctx->getBelLocation(cell->bel), new_loc = ctx->getBelLocation(new_bel);
+        double max_timing_gain = 0;
+        for (CellInfo *ci : {cell, other_cell}) {
+            if (ci == nullptr)
+                continue;
+            for (int32_t i = cell_ports_start.at(ci->udata); i < cell_ports_start.at(ci->udata + 1); i++) {
+                const CellPortNet &port = cell_ports.at(i);
+                if (ignore_net(net_by_udata[port.net]))
+                    continue;
+                // Other threads' moves don't update md, so take the current bounds of the nets involved
+                md.new_net_bounds[port.net] = net_bounds[port.net];
+                if (port.type == PORT_OUT) {
+                    for (auto arc_cost : net_arc_tcost[port.net])
+                        max_timing_gain += arc_cost;
+                } else if (port.type == PORT_IN) {
+                    max_timing_gain += net_arc_tcost[port.net].at(port.user);
+                }
+            }
+        }
+        add_move_cell(md, cell, old_loc, new_loc, false);
+        if (other_cell != nullptr)
+            add_move_cell(md, other_cell, new_loc, old_loc, false);
+
+        bool exact = true;
+        wirelen_t wirelen_delta = 0;
+        for (const auto &bc : md.bounds_changed_nets_x) {
+            if (md.already_bounds_changed_x[bc] == MoveChangeData::FULL_RECOMPUTE)
+                exact = false;
+            wirelen_delta += net_wirelen_cost(bc, md.new_net_bounds[bc]) - net_wirelen_cost(bc, net_bounds[bc]);
+        }
+        for (const auto &bc : md.bounds_changed_nets_y) {
+            if (md.already_bounds_changed_y[bc] == MoveChangeData::FULL_RECOMPUTE)
+                exact = false;
+            if (md.already_bounds_changed_x[bc] == MoveChangeData::NO_CHANGE)
+                wirelen_delta += net_wirelen_cost(bc, md.new_net_bounds[bc]) - net_wirelen_cost(bc, net_bounds[bc]);
+        }
+        md.reset(this);
+        if (!exact)
+            return false;
+
+        double min_delta = (1 - lambda) * (double(wirelen_delta) / std::max<double>(last_wirelen_cost, epsilon)) -
+                           lambda * (max_timing_gain / std::max<double>(last_timing_cost, epsilon));
+        // The chance of try_swap_position accepting a move with a cost increase this large is below exp(-7)
+        return min_delta > 7 * temp;
+    }
+
+    // One pass of refinement moves over cells, with the moves found in parallel. The device is split into vertical
+    // stripes, shifted by half a stripe every pass, and the cells in each stripe are given random new locations
+    // within it. Moves that can_reject_move shows would be rejected are dropped; the rest are then tried in order by
+    // try_swap_position. Each stripe has its own random number generator, so the result depends on the seed and not
+    // on the number of threads
+    void parallel_refine_pass(const std::vector<CellInfo *> &cells)
+    {
+        int offset = (refine_pass++ % 2) * (refine_stripe_width / 2);
+        int n_stripes = (max_x + offset) / refine_stripe_width + 1;
+        std::vector<std::vector<CellInfo *>> stripe_cells(n_stripes);
+        for (auto cell : cells)
+            stripe_cells.at((ctx->getBelLocation(cell->bel).x + offset) / refine_stripe_width).push_back(cell);
+
+        std::vector<int> stripes(n_stripes);
+        std::iota(stripes.begin(), stripes.end(), 0);
+        // Each pass takes a new set of streams, one per stripe
+        ctx->rng64();
+        std::vector<std::vector<std::pair<CellInfo *, BelId>>> stripe_moves(n_stripes);
+        std::vector<int> stripe_rejected(n_stripes, 0);
+        refine_pool->run(stripes, [&](int stripe) {
+            MoveChangeData *md;
+            {
+                std::unique_lock<std::mutex> lk(refine_mutex);
+                md = refine_free_move_data.back();
+                refine_free_move_data.pop_back();
+            }
+            DeterministicRNG rng = ctx->split(stripe);
+            int x0 = stripe * refine_stripe_width - offset, x1 = x0 + refine_stripe_width - 1;
+            for (auto cell : stripe_cells.at(stripe)) {
+                BelId try_bel = random_bel_for_cell(cell, -1, rng, x0, x1);
+                if (try_bel == BelId() || try_bel == cell->bel || is_constrained(cell))
+                    continue;
+                CellInfo *other_cell = ctx->getBoundBelCell(try_bel);
+                if (other_cell != nullptr && (is_constrained(other_cell) || other_cell->belStrength > STRENGTH_WEAK))
+                    continue;
+                if (can_reject_move(*md, cell, try_bel))
+                    stripe_rejected.at(stripe)++;
+                else
+                    stripe_moves.at(stripe).emplace_back(cell, try_bel);
+            }
+            std::unique_lock<std::mutex> lk(refine_mutex);
+            refine_free_move_data.push_back(md);
+        });
+
+        for (int i = 0; i < n_stripes; i++) {
+            // Moves rejected early still count towards the acceptance rate
+            n_move += stripe_rejected.at(i);
+            for (auto &move : stripe_moves.at(i))
+                if (move.second != move.first->bel)
+                    try_swap_position(move.first, move.second);
+        }
+    }
+#endif
+
     void commit_cost_changes(MoveChangeData &md)
     {
+        move_pins(md, false);
         for (const auto &bc : md.bounds_changed_nets_x)
             net_bounds[bc] = md.new_net_bounds[bc];
         for (const auto &bc : md.bounds_changed_nets_y)
@@ -1120,7 +1601,7 @@ class SAPlacer
         curr_wirelen_cost += md.wirelen_delta;
         curr_timing_cost += md.timing_delta;
     }
-    // Build the cell port -> user index
+    // Build the cell port -> user index, and the table of the nets connected to each cell
     void build_port_index()
     {
         for (auto net : sorted(ctx->nets)) {
@@ -1130,6 +1611,45 @@ class SAPlacer
                 fast_port_to_user[&(usr.cell->ports.at(usr.port))] = i;
             }
         }
+        decltype(CellInfo::udata) n = 0;
+        old_cell_udata.reserve(ctx->cells.size());
+        for (auto &cell : ctx->cells) {
+            CellInfo *ci = cell.second.get();
+            old_cell_udata.emplace_back(ci->udata);
+            ci->udata = n++;
+            cell_ports_start.push_back(int32_t(cell_ports.size()));
+            for (auto &port : ci->ports) {
+                if (port.second.net == nullptr)
+                    continue;
+                CellPortNet cpn;
+                cpn.net = port.second.net->udata;
+                cpn.type = port.second.type;
+                cpn.driver = port.second.net->driver.cell == ci && port.second.net->driver.port == port.first;
+                if (port.second.type == PORT_IN) {
+                    cpn.user = int32_t(fast_port_to_user.at(&port.second));
+                } else if (port.second.type == PORT_INOUT) {
+                    // Not a timing arc, but still a pin of the net
+                    auto fnd = fast_port_to_user.find(&port.second);
+                    if (fnd != fast_port_to_user.end())
+                        cpn.user = int32_t(fnd->second);
+                } else if (port.second.type == PORT_OUT) {
+                    int cc;
+                    cpn.timing = ctx->getPortTimingClass(ci, port.first, cc) != TMG_IGNORE;
+                }
+                cell_ports.push_back(cpn);
+            }
+        }
+        cell_ports_start.push_back(int32_t(cell_ports.size()));
+        net_timing_ignored.resize(net_by_udata.size());
+        net_arc_class.resize(net_by_udata.size());
+        for (auto ni : net_by_udata) {
+            for (auto &usr : ni->users)
+                net_arc_class.at(ni->udata).push_back(delay_cache.arc_class(ni, usr));
+            int cc;
+            net_timing_ignored.at(ni->udata) = ni->driver.cell != nullptr &&
+                                               ctx->getPortTimingClass(ni->driver.cell, ni->driver.port, cc) ==
+                                                       TMG_IGNORE;
+        }
     }
 
     // Simple routeability driven placement
@@ -1197,16 +1717,72 @@ class SAPlacer
     std::vector<BoundingBox> net_bounds;
     // Map net arcs to their timing cost (criticality * delay ns)
     std::vector<std::vector<double>> net_arc_tcost;
+    // Map nets to their congestion weighting of wiring cost, empty when not congestion driven
+    std::vector<float> net_cong_weight;
+    std::unique_ptr<CongestionMap> congestion;
 
     // Fast lookup for cell port to net user index
     std::unordered_map<const PortInfo *, size_t> fast_port_to_user;
 
+    // The connected ports of every cell, for the cell with udata i in cell_ports[cell_ports_start[i] ..
+    // cell_ports_start[i + 1]), so that moves don't need to go through the port maps of cells and nets
+    struct CellPortNet
+    {
+        decltype(NetInfo::udata) net = 0;
+        // Index in the users of the net for inputs
+        int32_t user = -1;
+        PortType type = PORT_IN;
+        // Whether this is the driver of the net, which may also be an inout
+        bool driver = false;
+        // False for outputs with the TMG_IGNORE timing class
+        bool timing = true;
+    };
+    std::vector<CellPortNet> cell_ports;
+    std::vector<int32_t> cell_ports_start;
+
+    // The location of the pins of each net as of the last committed move, with the driver first and then the users,
+    // at [net_pin_start[net], net_pin_start[net + 1]); unplaced pins are at -1
+    std::vector<int32_t> net_pin_start;
+    std::vector<int> pin_x, pin_y;
+    // For nets with at least bbHistFanout users, the number of pins in each column and row, so that the bounding box
+    // can be found again without visiting every pin when the last pin leaves an edge
+    struct PinHistogram
+    {
+        std::vector<int> x, y;
+    };
+    std::vector<int> net_hist;
+    std::vector<PinHistogram> pin_hists;
+    std::vector<decltype(CellInfo::udata)> old_cell_udata;
+    // Whether the driver of each net has the TMG_IGNORE timing class, and the criticality data of each net
+    std::vector<bool> net_timing_ignored;
+    std::vector<const NetCriticalityInfo *> net_crit_by_udata;
+    // Per net and user, the class of the arc in delay_cache
+    std::vector<std::vector<int>> net_arc_class;
+
     // Wirelength and timing cost at last and current iteration
     wirelen_t last_wirelen_cost, curr_wirelen_cost;
     double last_timing_cost, curr_timing_cost;
 
     // Criticality data from timing analysis
     NetCriticalityMap net_crit;
+    std::unique_ptr<IncrementalCriticality> incr_timing;
+
+    void update_timing()
+    {
+        if (incr_timing)
+            incr_timing->update(&net_crit);
+        else
+            get_criticalities(ctx, &net_crit, get_timing_graph());
+    }
+
+    // Timing graph for repeated analysis, built on first use; the netlist is not changed while placing
+    std::unique_ptr<TimingGraph> timing_graph;
+    const TimingGraph *get_timing_graph()
+    {
+        if (!timing_graph)
+            timing_graph.reset(new TimingGraph(ctx));
+        return timing_graph.get();
+    }
 
     Context *ctx;
     float temp = 10;
@@ -1214,30 +1790,60 @@ class SAPlacer
     float lambda = 0.5;
     bool improved = false;
     int n_move, n_accept;
+    // Sweeps over all cells per temperature, which is only changed from 15 with a time budget
+    int sweeps_per_temp = 15;
+    const int max_sweeps_per_temp = 60;
     int diameter = 35, max_x = 1, max_y = 1;
     std::unordered_map<IdString, std::tuple<int, int>> bel_types;
     std::unordered_map<IdString, BoundingBox> region_bounds;
     std::vector<std::vector<std::vector<std::vector<BelId>>>> fast_bels;
+    std::vector<TileIndex> tile_index; // per Bel type
+    // Bels picked by random_bel_for_cell, and how many of them were usable; the rest needed a retry
+    std::atomic<int64_t> bel_picks{0}, bel_picks_found{0};
+    // Scratch space for chain_swap_valid
+    std::unordered_map<BelId, CellInfo *> chain_overlay;
+    std::unordered_map<CellInfo *, BelId> chain_cell_bel;
     std::unordered_set<BelId> locked_bels;
     std::vector<NetInfo *> net_by_udata;
     std::vector<decltype(NetInfo::udata)> old_udata;
     bool require_legal = true;
+    // Whether the initial placement came from the placement guide, rather than being random
+    bool guided = false;
     const int legalise_dia = 4;
+#ifndef NPNR_DISABLE_THREADS
+    // For parallel refinement, the workers and their move data
+    std::unique_ptr<WorkerPool> refine_pool;
+    std::vector<MoveChangeData> refine_move_data;
+    std::vector<MoveChangeData *> refine_free_move_data;
+    std::mutex refine_mutex;
+#endif
+    // Width of the stripes used for parallel refinement, and the number of passes so far
+    const int refine_stripe_width = 8;
+    int refine_pass = 0;
     Placer1Cfg cfg;
+    PredictDelayCache delay_cache;
+    // Swaps made by try_swap_chain
+    CellMoveBatch chain_move;
 };
 
 Placer1Cfg::Placer1Cfg(Context *ctx)
 {
     constraintWeight = ctx->setting<float>("placer1/constraintWeight", 10);
     netShareWeight = ctx->setting<float>("placer1/netShareWeight", 0);
+    congestionWeight = ctx->setting<float>("placer1/congestionWeight", 0);
+    threads = ctx->stage_threads("placer1", 1);
     minBelsForGridPick = ctx->setting<int>("placer1/minBelsForGridPick", 64);
     budgetBased = ctx->setting<bool>("placer1/budgetBased", false);
     startTemp = ctx->setting<float>("placer1/startTemp", 1);
+    guideStartTemp = ctx->setting<float>("placer1/guideStartTemp", 0.01);
     timingFanoutThresh = std::numeric_limits<int>::max();
     timing_driven = ctx->setting<bool>("timing_driven");
     slack_redist_iter = ctx->setting<int>("slack_redist_iter");
     hpwl_scale_x = 1;
     hpwl_scale_y = 1;
+    timeBudget = ctx->setting<float>("placer1/timeBudget", 0);
+    incrementalTiming = ctx->setting<bool>("placer1/incrementalTiming", false);
+    bbHistFanout = ctx->setting<int>("placer1/bbHistFanout", 64);
 }
 
 bool placer1(Context *ctx, Placer1Cfg cfg)
@@ -27,14 +27,28 @@ NEXTPNR_NAMESPACE_BEGIN
 struct Placer1Cfg
 {
     Placer1Cfg(Context *ctx);
-    float constraintWeight, netShareWeight;
+    float constraintWeight, netShareWeight, congestionWeight;
     int minBelsForGridPick;
     bool budgetBased;
     float startTemp;
+    // Starting temperature when nearly all cells could be placed at their bels in the placement guide
+    float guideStartTemp;
     int timingFanoutThresh;
     bool timing_driven;
     int slack_redist_iter;
     int hpwl_scale_x, hpwl_scale_y;
+    // Threads for finding moves during refinement after analytic placement, which changes the result compared to
+    // a single thread (but not between thread counts above 1)
+    int threads;
+    // If non-zero, the number of sweeps per temperature is scaled to aim to finish annealing within this many seconds,
+    // and annealing stops once it has passed
+    float timeBudget;
+    // Update criticalities incrementally, recomputing only the arcs of cells that have moved, instead of running a
+    // full timing analysis after each temperature
+    bool incrementalTiming;
+    // Nets with at least this many users keep a histogram of their pin locations, to find their bounding box again
+    // quickly when a cell leaves its edge
+    int bbHistFanout;
 };
 
 extern bool placer1(Context *ctx, Placer1Cfg cfg);
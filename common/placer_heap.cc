@@ -29,6 +29,8 @@
  *     as described in HeAP to ensure validity. This searches random bels in the vicinity of the position chosen by
  *     spreading, with diameter increasing over iterations, with a heuristic to prefer lower wirelength choices.
  *   - To make the placer timing-driven, the bound2bound weights are multiplied by (1 + 10 * crit^2)
+ *   - Optionally, spreading treats tiles where a RUDY estimate of the routing demand of the last legal placement
+ *     exceeds the routing capacity as having fewer Bels, to move cells out of likely congested areas
  */
 
 #ifdef WITH_HEAP
@@ -37,29 +39,47 @@
 #include <Eigen/Core>
 #include <Eigen/IterativeLinearSolvers>
 #include <boost/optional.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <deque>
 #include <fstream>
 #include <numeric>
 #include <queue>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
+#include "congestion.h"
+#include "heap_gpu.h"
 #include "log.h"
 #include "nextpnr.h"
 #include "place_common.h"
 #include "placer1.h"
+#include "profiler.h"
 #include "timing.h"
 #include "util.h"
+#include "worker_pool.h"
 NEXTPNR_NAMESPACE_BEGIN
 
 namespace {
 // A simple internal representation for a sparse system of equations Ax = rhs
 // This is designed to decouple the functions that build the matrix to the engine that
 // solves it, and the representation that requires
+//
+// When reuse_pattern is set, a system that is rebuilt and solved repeatedly keeps the sparsity pattern of the first
+// solve in the solver's own matrix; later builds only update its values, as the connections between cells change
+// little between iterations. Coefficients outside of the pattern are still inserted, at a higher cost.
+//
+// The system is solved by conjugate gradient with a choice of preconditioner. The matrix is kept row-major, which
+// (as it is symmetric) lets Eigen run the matrix-vector products of the solver in parallel when built with OpenMP.
+// If gpu is set, the system is solved on the GPU instead, with the Jacobi preconditioner, falling back to Eigen if
+// that fails.
 template <typename T> struct EquationSystem
 {
 
-    EquationSystem(size_t rows, size_t cols)
+    EquationSystem(size_t rows, size_t cols, bool reuse_pattern = false,
+                   PlacerHeapCfg::Preconditioner precond = PlacerHeapCfg::PRECOND_JACOBI)
+            : reuse_pattern(reuse_pattern), precond(precond)
     {
         A.resize(cols);
         rhs.resize(rows);
@@ -68,15 +88,41 @@ template <typename T> struct EquationSystem
     // Simple sparse format, easy to convert to CCS for solver
     std::vector<std::vector<std::pair<int, T>>> A; // col -> (row, x[row, col]) sorted by row
     std::vector<T> rhs;                            // RHS vector
+
+    bool reuse_pattern;
+    PlacerHeapCfg::Preconditioner precond;
+    HeapGpu *gpu = nullptr;
+    // Set once mat holds the pattern, after which it is updated directly rather than through A
+    bool frozen = false;
+
+    typedef Eigen::SparseMatrix<T, Eigen::RowMajor> Matrix;
+    Matrix mat;
+    // One solver for each preconditioner, so the one in use keeps its analysis of the pattern between solves
+    Eigen::ConjugateGradient<Matrix, Eigen::Lower | Eigen::Upper, Eigen::IdentityPreconditioner> solver_none;
+    Eigen::ConjugateGradient<Matrix, Eigen::Lower | Eigen::Upper, Eigen::DiagonalPreconditioner<T>> solver_jacobi;
+    Eigen::ConjugateGradient<Matrix, Eigen::Lower | Eigen::Upper, Eigen::IncompleteCholesky<T>> solver_ichol;
+
+    // Iteration count and estimated relative error of the last solve
+    int iterations = 0;
+    double error = 0;
+
     void reset()
     {
-        for (auto &col : A)
-            col.clear();
+        if (frozen) {
+            std::fill(mat.valuePtr(), mat.valuePtr() + mat.nonZeros(), T());
+        } else {
+            for (auto &col : A)
+                col.clear();
+        }
         std::fill(rhs.begin(), rhs.end(), T());
     }
 
     void add_coeff(int row, int col, T val)
     {
+        if (frozen) {
+            mat.coeffRef(row, col) += val;
+            return;
+        }
         auto &Ac = A.at(col);
         // Binary search
         int b = 0, e = int(Ac.size()) - 1;
@@ -96,6 +142,34 @@ template <typename T> struct EquationSystem
 
     void add_rhs(int row, T val) { rhs[row] += val; }
 
+    // Estimated bytes held by the system, counting the incomplete Cholesky factor (if used) as the size of the matrix
+    int64_t memory_usage() const
+    {
+        int64_t bytes = memory_of(A) + memory_of(rhs);
+        for (auto &col : A)
+            bytes += memory_of(col);
+        int64_t mat_bytes = int64_t(mat.nonZeros()) * (sizeof(T) + sizeof(typename Matrix::StorageIndex)) +
+                            int64_t(mat.outerSize() + 1) * sizeof(typename Matrix::StorageIndex);
+        return bytes + ((precond == PlacerHeapCfg::PRECOND_ICHOL) ? 2 : 1) * mat_bytes;
+    }
+
+    // Solve with one of the solvers, returning false if its preconditioner could not be computed
+    template <typename Solver>
+    bool run_solver(Solver &solver, bool analyse, float tolerance, const Eigen::VectorXd &vb, Eigen::VectorXd &vx)
+    {
+        if (analyse)
+            solver.analyzePattern(mat);
+        solver.setTolerance(tolerance);
+        solver.factorize(mat);
+        if (solver.info() != Eigen::Success)
+            return false;
+        Eigen::VectorXd xr = solver.solveWithGuess(vb, vx);
+        vx = xr;
+        iterations = int(solver.iterations());
+        error = solver.error();
+        return true;
+    }
+
     void solve(std::vector<T> &x, float tolerance)
     {
         using namespace Eigen;
@@ -104,28 +178,53 @@ template <typename T> struct EquationSystem
         NPNR_ASSERT(x.size() == A.size());
 
         VectorXd vx(x.size()), vb(rhs.size());
-        SparseMatrix<T> mat(A.size(), A.size());
-
-        std::vector<int> colnnz;
-        for (auto &Ac : A)
-            colnnz.push_back(int(Ac.size()));
-        mat.reserve(colnnz);
-        for (int col = 0; col < int(A.size()); col++) {
-            auto &Ac = A.at(col);
-            for (auto &el : Ac)
-                mat.insert(el.first, col) = el.second;
+        bool analyse = false;
+        if (!frozen) {
+            // The matrix is symmetric, so the number of entries of each column is also that of each row
+            mat = Matrix(A.size(), A.size());
+            std::vector<int> colnnz;
+            for (auto &Ac : A)
+                colnnz.push_back(int(Ac.size()));
+            mat.reserve(colnnz);
+            for (int col = 0; col < int(A.size()); col++) {
+                auto &Ac = A.at(col);
+                for (auto &el : Ac)
+                    mat.insert(el.first, col) = el.second;
+            }
+            mat.makeCompressed();
+            analyse = true;
+            if (reuse_pattern) {
+                frozen = true;
+                for (auto &Ac : A)
+                    std::vector<std::pair<int, T>>().swap(Ac);
+            }
+        } else if (!mat.isCompressed()) {
+            // New coefficients were inserted outside of the pattern
+            mat.makeCompressed();
+            analyse = true;
         }
 
+        if (gpu != nullptr && gpu->solve(int(x.size()), mat.outerIndexPtr(), mat.innerIndexPtr(), mat.valuePtr(),
+                                          rhs.data(), x.data(), tolerance, iterations, error))
+            return;
+
         for (int i = 0; i < int(x.size()); i++)
             vx[i] = x.at(i);
         for (int i = 0; i < int(rhs.size()); i++)
             vb[i] = rhs.at(i);
 
-        ConjugateGradient<SparseMatrix<T>, Lower | Upper> solver;
-        solver.setTolerance(tolerance);
-        VectorXd xr = solver.compute(mat).solveWithGuess(vb, vx);
+        bool solved = false;
+        if (precond == PlacerHeapCfg::PRECOND_ICHOL)
+            solved = run_solver(solver_ichol, analyse, tolerance, vb, vx);
+        else if (precond == PlacerHeapCfg::PRECOND_NONE)
+            solved = run_solver(solver_none, analyse, tolerance, vb, vx);
+        if (!solved) {
+            // Also used if the incomplete Cholesky factorisation fails, as the Jacobi preconditioner cannot
+            solved = run_solver(solver_jacobi, analyse || precond != PlacerHeapCfg::PRECOND_JACOBI, tolerance, vb, vx);
+            NPNR_ASSERT(solved);
+        }
         for (int i = 0; i < int(x.size()); i++)
-            x.at(i) = xr[i];
+            x.at(i) = vx[i];
         // for (int i = 0; i < int(x.size()); i++)
         //    log_info("x[%d] = %f\n", i, x.at(i));
     }
@@ -138,40 +237,78 @@ class HeAPPlacer
   public:
     HeAPPlacer(Context *ctx, PlacerHeapCfg cfg) : ctx(ctx), cfg(cfg) { Eigen::initParallel(); }
 
+    // Run the simulated annealing refinement after legalisation
+    bool refine = true;
+
     bool place()
     {
+        NPNR_PROFILE_ZONE("HeAP");
         auto startt = std::chrono::high_resolution_clock::now();
 
         ctx->lock();
+        setup_cell_index();
+        setup_solver_threads();
+#ifndef NPNR_DISABLE_THREADS
+        if (cfg.spreadThreads > 1)
+            spread_pool.reset(new WorkerPool(cfg.spreadThreads));
+        if (cfg.legaliseThreads > 1)
+            legalise_pool.reset(new WorkerPool(cfg.legaliseThreads));
+        if (cfg.runThreads > 1)
+            run_pool.reset(new WorkerPool(cfg.runThreads));
+#endif
         place_constraints();
         build_fast_bels();
         seed_placement();
         update_all_chains();
+        if (cfg.useGpu)
+            setup_gpu();
         wirelen_t hpwl = total_hpwl();
-        log_info("Creating initial analytic placement for %d cells, random placement wirelen = %d.\n",
-                 int(place_cells.size()), int(hpwl));
-        for (int i = 0; i < 4; i++) {
-            setup_solve_cells();
+        // Starting from a guide that nearly all cells could follow, there is no need for an initial placement, and
+        // the main loop starts with its cells already anchored to their guide locations
+        bool guided = guided_cells > 0 && guided_cells >= 0.9 * place_cells.size();
+        if (guided) {
+            log_info("Starting analytic placement of %d cells from the placement guide (%d cells guided), wirelen = "
+                     "%d.\n",
+                     int(place_cells.size()), guided_cells, int(hpwl));
+            for (auto &cl : cell_locs) {
+                cl.legal_x = cl.x;
+                cl.legal_y = cl.y;
+            }
+        } else {
+            log_info("Creating initial analytic placement for %d cells, random placement wirelen = %d.\n",
+                     int(place_cells.size()), int(hpwl));
+        }
+        // For large designs, first solve with one variable per cluster of cells, then for every cell starting from
+        // the cluster locations
+        bool clustered = !guided && cfg.clusterMinCells > 0 && int(place_cells.size()) >= cfg.clusterMinCells;
+        if (clustered) {
+            log_info("Placing %d clusters of cells first.\n", build_clusters());
+            update_clusters();
+            update_all_chains();
+        }
+        for (int i = 0; i < (guided ? 0 : clustered ? 8 : 4); i++) {
+            bool cluster_iter = clustered && i < 4;
+            NPNR_PROFILE_ZONE("initial solve");
+            setup_solve_cells(solve, nullptr, cluster_iter);
             auto solve_startt = std::chrono::high_resolution_clock::now();
-#ifdef NPNR_DISABLE_THREADS
-            build_solve_direction(false, -1);
-            build_solve_direction(true, -1);
-#else
-            boost::thread xaxis([&]() { build_solve_direction(false, -1); });
-            build_solve_direction(true, -1);
-            xaxis.join();
-#endif
+            reset_solver_iters();
+            solve_axes(solve, -1, cfg.parallelAxes);
             auto solve_endt = std::chrono::high_resolution_clock::now();
             solve_time += std::chrono::duration<double>(solve_endt - solve_startt).count();
 
+            if (cluster_iter)
+                update_clusters();
             update_all_chains();
 
             hpwl = total_hpwl();
-            log_info("    at initial placer iter %d, wirelen = %d\n", i, int(hpwl));
+            log_info("    at initial placer iter %d%s, wirelen = %d; solver iterations x/y = %d/%d\n", i,
+                     cluster_iter ? " (clustered)" : "", int(hpwl), solve.solver_iters[0],
+                     solve.solver_iters[1]);
         }
 
         wirelen_t solved_hpwl = 0, spread_hpwl = 0, legal_hpwl = 0, best_hpwl = std::numeric_limits<wirelen_t>::max();
-        int iter = 0, stalled = 0;
+        int first_iter = guided ? cfg.guideStartIter : 0;
+        int iter = first_iter, stalled = 0;
 
         std::vector<std::tuple<CellInfo *, BelId, PlaceStrength>> solution;
 
@@ -202,79 +339,127 @@ class HeAPPlacer
         }
 
         heap_runs.push_back(all_celltypes);
+        auto run_batches = batch_heap_runs(heap_runs);
         // The main HeAP placer loop
         log_info("Running main analytical placer.\n");
-        while (stalled < 5 && (solved_hpwl <= legal_hpwl * 0.8)) {
+        if (cfg.timing_driven && cfg.incrementalTiming)
+            incr_timing.reset(new IncrementalCriticality(ctx));
+        std::string stop_reason;
+        while (stop_reason.empty()) {
+            // The first iteration starts from a random placement, so there is no congestion estimate yet
+            if (iter > 0)
+                update_congestion();
             // Alternate between particular bel types and all bels
-            for (auto &run : heap_runs) {
+            for (auto &batch : run_batches) {
                 auto run_startt = std::chrono::high_resolution_clock::now();
 
-                setup_solve_cells(&run);
-                if (solve_cells.empty())
-                    continue;
-                // Heuristic: don't bother with threading below a certain size
-                auto solve_startt = std::chrono::high_resolution_clock::now();
-
+                // The runs of a batch share no nets, so solving them all first gives the same result as solving each
+                // just before it is spread and legalised
+                std::vector<SolveSet> solved(batch.size());
+                std::vector<char> has_cells(batch.size());
+                {
+                    NPNR_PROFILE_ZONE("solve");
+                    auto solve_startt = std::chrono::high_resolution_clock::now();
+                    auto solve_run = [&](int i) {
+                        setup_solve_cells(solved.at(i), &heap_runs.at(batch.at(i)));
+                        has_cells.at(i) = !solved.at(i).solve_cells.empty();
+                        // Heuristic: don't bother with threading below a certain size
+                        if (has_cells.at(i))
+                            solve_axes(solved.at(i), (iter == 0) ? -1 : iter,
+                                       cfg.parallelAxes && solved.at(i).solve_cells.size() >= 500);
+                    };
 #ifndef NPNR_DISABLE_THREADS
-                if (solve_cells.size() >= 500) {
-                    boost::thread xaxis([&]() { build_solve_direction(false, (iter == 0) ? -1 : iter); });
-                    build_solve_direction(true, (iter == 0) ? -1 : iter);
-                    xaxis.join();
-                } else
+                    if (run_pool != nullptr && batch.size() > 1) {
+                        std::vector<int> tasks(batch.size());
+                        std::iota(tasks.begin(), tasks.end(), 0);
+                        run_pool->run(tasks, solve_run);
+                    } else
 #endif
-                {
-                    build_solve_direction(false, (iter == 0) ? -1 : iter);
-                    build_solve_direction(true, (iter == 0) ? -1 : iter);
+                    {
+                        for (int i = 0; i < int(batch.size()); i++)
+                            solve_run(i);
+                    }
+                    auto solve_endt = std::chrono::high_resolution_clock::now();
+                    solve_time += std::chrono::duration<double>(solve_endt - solve_startt).count();
                 }
-                auto solve_endt = std::chrono::high_resolution_clock::now();
-                solve_time += std::chrono::duration<double>(solve_endt - solve_startt).count();
-                update_all_chains();
-                solved_hpwl = total_hpwl();
-
-                update_all_chains();
-
-                for (const auto &group : cfg.cellGroups)
-                    CutSpreader(this, group).run();
 
-                for (auto type : sorted(run))
-                    if (std::all_of(cfg.cellGroups.begin(), cfg.cellGroups.end(),
-                                    [type](const std::unordered_set<IdString> &grp) { return !grp.count(type); }))
-                        CutSpreader(this, {type}).run();
-
-                update_all_chains();
-                spread_hpwl = total_hpwl();
-                legalise_placement_strict(true);
-                update_all_chains();
-
-                legal_hpwl = total_hpwl();
-                auto run_stopt = std::chrono::high_resolution_clock::now();
-                log_info("    at iteration #%d, type %s: wirelen solved = %d, spread = %d, legal = %d; time = %.02fs\n",
-                         iter + 1, (run.size() > 1 ? "ALL" : run.begin()->c_str(ctx)), int(solved_hpwl),
-                         int(spread_hpwl), int(legal_hpwl),
-                         std::chrono::duration<double>(run_stopt - run_startt).count());
+                for (size_t i = 0; i < batch.size(); i++) {
+                    if (!has_cells.at(i))
+                        continue;
+                    auto &run = heap_runs.at(batch.at(i));
+                    reset_solver_iters();
+                    solve = std::move(solved.at(i));
+                    update_all_chains();
+                    solved_hpwl = total_hpwl();
+
+                    update_all_chains();
+
+                    for (const auto &group : cfg.cellGroups)
+                        CutSpreader(this, group).run();
+
+                    for (auto type : sorted(run))
+                        if (std::all_of(cfg.cellGroups.begin(), cfg.cellGroups.end(),
+                                        [type](const std::unordered_set<IdString> &grp) { return !grp.count(type); }))
+                            CutSpreader(this, {type}).run();
+
+                    update_all_chains();
+                    spread_hpwl = total_hpwl();
+                    legalise_placement_strict(true);
+                    update_all_chains();
+
+                    legal_hpwl = total_hpwl();
+                    // Incremental analysis is cheap enough to refresh criticalities after every run
+                    if (incr_timing)
+                        update_timing();
+                    // The time of the first run of a batch includes solving the whole batch
+                    auto run_stopt = std::chrono::high_resolution_clock::now();
+                    log_info("    at iteration #%d, type %s: wirelen solved = %d, spread = %d, legal = %d; time = "
+                             "%.02fs; solver iterations x/y = %d/%d\n",
+                             iter + 1, (run.size() > 1 ? "ALL" : run.begin()->c_str(ctx)), int(solved_hpwl),
+                             int(spread_hpwl), int(legal_hpwl),
+                             std::chrono::duration<double>(run_stopt - run_startt).count(), solve.solver_iters[0],
+                             solve.solver_iters[1]);
+                    run_startt = run_stopt;
+                }
             }
 
-            if (cfg.timing_driven)
-                get_criticalities(ctx, &net_crit);
+            if (cfg.timing_driven && !incr_timing)
+                update_timing();
 
+            // Improvements of less than minImprovement still update the best solution, but count towards a plateau
+            if (legal_hpwl < best_hpwl * (1.0 - cfg.minImprovement))
+                stalled = 0;
+            else
+                ++stalled;
             if (legal_hpwl < best_hpwl) {
                 best_hpwl = legal_hpwl;
-                stalled = 0;
                 // Save solution
                 solution.clear();
                 for (auto cell : sorted(ctx->cells)) {
                     solution.emplace_back(cell.second, cell.second->bel, cell.second->belStrength);
                 }
-            } else {
-                ++stalled;
             }
             for (auto &cl : cell_locs) {
-                cl.second.legal_x = cl.second.x;
-                cl.second.legal_y = cl.second.y;
+                cl.legal_x = cl.x;
+                cl.legal_y = cl.y;
             }
             ctx->yield();
+            // The cells are bound to their legalised locations here
+            ctx->autosave();
             ++iter;
+
+            double elapsed =
+                    std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startt).count();
+            if (solved_hpwl > legal_hpwl * cfg.convergenceRatio)
+                stop_reason = stringf("solved wirelength is within %.0f%% of legal wirelength",
+                                      100.0 * (1.0 - cfg.convergenceRatio));
+            else if (stalled >= cfg.maxStalledIters)
+                stop_reason = stringf("no improvement in legal wirelength for %d iterations", stalled);
+            else if (cfg.timeBudget > 0 && elapsed >= cfg.timeBudget)
+                stop_reason = stringf("time budget of %.02fs reached", cfg.timeBudget);
         }
+        log_info("Stopping main analytical placer after %d iterations: %s.\n", iter - first_iter,
+                 stop_reason.c_str());
 
         // Apply saved solution
         for (auto &sc : solution) {
@@ -300,15 +485,30 @@ class HeAPPlacer
         }
 
         ctx->unlock();
+        gpu.reset();
+        gpu_cell_x.clear();
+        reset_solver_iters();
+        memory_track("placer_heap/solver_x", 0);
+        memory_track("placer_heap/solver_y", 0);
+#ifndef NPNR_DISABLE_THREADS
+        spread_pool.reset();
+        legalise_pool.reset();
+        run_pool.reset();
+#endif
         auto endtt = std::chrono::high_resolution_clock::now();
         log_info("HeAP Placer Time: %.02fs\n", std::chrono::duration<double>(endtt - startt).count());
-        log_info("  of which solving equations: %.02fs\n", solve_time);
+        log_info("  of which solving equations: %.02fs (%lld solver iterations)\n", solve_time,
+                 (long long)total_solver_iters);
+        throughput_track("placer_heap/cg_iterations", total_solver_iters, solve_time);
         log_info("  of which spreading cells: %.02fs\n", cl_time);
         log_info("  of which strict legalisation: %.02fs\n", sl_time);
+        if (cfg.timing_driven)
+            log_info("  of which timing analysis: %.02fs\n", timing_time);
 
         ctx->check();
 
-        placer1_refine(ctx, Placer1Cfg(ctx));
+        if (refine)
+            placer1_refine(ctx, Placer1Cfg(ctx));
 
         return true;
     }
@@ -340,32 +540,157 @@ class HeAPPlacer
     // structure instead
     struct CellLocation
     {
-        int x, y;
-        int legal_x, legal_y;
-        double rawx, rawy;
-        bool locked, global;
+        int x = 0, y = 0;
+        int legal_x = 0, legal_y = 0;
+        double rawx = 0, rawy = 0;
+        bool locked = false, global = false;
+        // Set once the cell has been given a location
+        bool valid = false;
     };
-    std::unordered_map<IdString, CellLocation> cell_locs;
+    // Per-cell state is kept in dense arrays indexed by cell udata, which is set to the index of each cell in cells
+    // for the duration of placement, so the inner loops don't need to hash cell names
+    std::vector<CellInfo *> cells;
+    std::vector<CellLocation> cell_locs;
+    // All nets, in name order
+    std::vector<NetInfo *> nets;
     // The set of cells that we will actually place. This excludes locked cells and children cells of macros/chains
     // (only the root of each macro is placed.)
     std::vector<CellInfo *> place_cells;
+    // Cells seeded from the placement guide
+    int guided_cells = 0;
 
-    // The cells in the current equation being solved (a subset of place_cells in some cases, where we only place
-    // cells of a certain type)
-    std::vector<CellInfo *> solve_cells;
+    // The cells and rows of one system of equations, for one heap run
+    struct SolveSet
+    {
+        // The cells being solved (a subset of place_cells in some cases, where we only place cells of a certain type)
+        std::vector<CellInfo *> solve_cells;
+        // The row of each cell in the equations, or dont_solve
+        std::vector<int32_t> solve_row;
+        // For each net, the row of the star node of nets using the star model, or -1. Star nodes are solved after all
+        // of solve_cells, and star_centre holds their current position in each axis
+        std::vector<int> star_rows;
+        int n_star_nets = 0;
+        std::vector<double> star_centre[2];
+        // Conjugate gradient iterations for the x and y axes, since last reset for logging
+        int solver_iters[2] = {0, 0};
+    };
+    // The cells being spread and legalised, and last solved for
+    SolveSet solve;
+
+    // For large designs, the cluster of each cell in place_cells for the coarse initial placement, or -1; and the
+    // first cell of each cluster, which stands in for the whole cluster when solving
+    std::vector<int> cluster_of;
+    std::vector<CellInfo *> cluster_head;
+    // Nets with more users than this are ignored when clustering
+    const int cluster_max_fanout = 16;
+    // Nets with more users than this are not followed when seeding by connectivity
+    const int seed_max_fanout = 64;
 
     // For cells in a chain, this is the ultimate root cell of the chain (sometimes this is not constr_parent
     // where chains are within chains
-    std::unordered_map<IdString, CellInfo *> chain_root;
-    std::unordered_map<IdString, int> chain_size;
+    std::vector<CellInfo *> chain_root;
+    std::vector<int> chain_size;
 
     // The offset from chain_root to a cell in the chain
     std::unordered_map<IdString, std::pair<int, int>> cell_offsets;
 
+    // Root Bels set aside for macros by reserve_macro_space, for the current strict legalisation
+    std::unordered_map<IdString, BelId> macro_reservations;
+
     // Performance counting
-    double solve_time = 0, cl_time = 0, sl_time = 0;
+    double solve_time = 0, cl_time = 0, sl_time = 0, timing_time = 0;
+#ifndef NPNR_DISABLE_THREADS
+    // Workers for cutting disjoint regions in parallel during spreading, and for parallel strict legalisation, if
+    // enabled
+    std::unique_ptr<WorkerPool> spread_pool, legalise_pool;
+    // Workers for solving the heap runs of a batch at once, if enabled
+    std::unique_ptr<WorkerPool> run_pool;
+#endif
+    // Width and height in tiles of the shards used by parallel strict legalisation
+    const int legalise_shard_size = 16;
+
+    int64_t total_solver_iters = 0;
+
+    void setup_cell_index()
+    {
+        cells.clear();
+        for (auto cell : sorted(ctx->cells)) {
+            cell.second->udata = int(cells.size());
+            cells.push_back(cell.second);
+        }
+        nets.clear();
+        for (auto net : sorted(ctx->nets))
+            nets.push_back(net.second);
+        cell_locs.resize(cells.size());
+        chain_root.resize(cells.size(), nullptr);
+        chain_size.resize(cells.size(), 1);
+    }
+
+    void setup_solver_threads()
+    {
+        if (cfg.solverThreads <= 1)
+            return;
+#ifdef _OPENMP
+        // Each of the x and y axis solves, which already run in parallel, uses this many threads
+        Eigen::setNbThreads(cfg.solverThreads);
+        log_info("Using %d threads for each equation solve.\n", cfg.solverThreads);
+#else
+        log_warning("Multi-threaded equation solving needs nextpnr to be built with USE_OPENMP, using 1 thread.\n");
+#endif
+    }
+
+    void reset_solver_iters()
+    {
+        total_solver_iters += solve.solver_iters[0] + solve.solver_iters[1];
+        solve.solver_iters[0] = solve.solver_iters[1] = 0;
+    }
 
     NetCriticalityMap net_crit;
+    std::unique_ptr<IncrementalCriticality> incr_timing;
+
+    // Timing graph for repeated analysis, built on first use; the netlist is not changed while placing
+    std::unique_ptr<TimingGraph> timing_graph;
+    const TimingGraph *get_timing_graph()
+    {
+        if (!timing_graph)
+            timing_graph.reset(new TimingGraph(ctx));
+        return timing_graph.get();
+    }
+
+    // Refresh net_crit for the current placement
+    void update_timing()
+    {
+        NPNR_PROFILE_ZONE("timing");
+        auto startt = std::chrono::high_resolution_clock::now();
+        if (incr_timing)
+            incr_timing->update(&net_crit, cfg.timingMoveThreshold);
+        else
+            get_criticalities(ctx, &net_crit, get_timing_graph());
+        auto endt = std::chrono::high_resolution_clock::now();
+        timing_time += std::chrono::duration<double>(endt - startt).count();
+    }
+
+    // Routing congestion estimate of the last legal placement, and the resulting factor [x][y] by which spreading
+    // scales the number of Bels of each tile; empty when not congestion driven
+    std::unique_ptr<CongestionMap> congestion;
+    std::vector<std::vector<float>> cong_derate;
+    // Lower bound on cong_derate, so no amount of congestion can make a tile look empty
+    const float min_cong_derate = 0.5;
+
+    void update_congestion()
+    {
+        if (cfg.congestionWeight <= 0)
+            return;
+        if (congestion == nullptr)
+            congestion = std::unique_ptr<CongestionMap>(new CongestionMap(ctx));
+        congestion->update();
+        cong_derate.assign(max_x + 1, std::vector<float>(max_y + 1, 1));
+        for (int x = 0; x <= std::min(max_x, congestion->width - 1); x++)
+            for (int y = 0; y <= std::min(max_y, congestion->height - 1); y++) {
+                float overflow = std::max(0.0f, congestion->ratio(x, y) - 1);
+                cong_derate.at(x).at(y) = std::max(min_cong_derate, 1 / (1 + cfg.congestionWeight * overflow));
+            }
+    }
 
     // Place cells with the BEL attribute set to constrain them
     void place_constraints()
@@ -481,13 +806,12 @@ class HeAPPlacer
                 bb.x1 = std::numeric_limits<int>::min();
                 bb.y0 = std::numeric_limits<int>::max();
                 bb.y1 = std::numeric_limits<int>::min();
-                for (auto bel : r->bels) {
-                    Loc loc = ctx->getBelLocation(bel);
+                r->bels.for_each([&](Loc loc) {
                     bb.x0 = std::min(bb.x0, loc.x);
                     bb.x1 = std::max(bb.x1, loc.x);
                     bb.y0 = std::min(bb.y0, loc.y);
                     bb.y1 = std::max(bb.y1, loc.y);
-                }
+                });
             } else {
                 bb.x0 = 0;
                 bb.y0 = 0;
@@ -499,13 +823,78 @@ class HeAPPlacer
     }
 
     // Build and solve in one direction
-    void build_solve_direction(bool yaxis, int iter)
+    void build_solve_direction(SolveSet &ss, bool yaxis, int iter)
     {
+        int rows = int(ss.solve_cells.size()) + ss.n_star_nets;
+        EquationSystem<double> esx(rows, rows, cfg.reuseSolverPattern, cfg.solverPreconditioner);
+        // The GPU only has the Jacobi preconditioner, so isn't used with the stronger incomplete Cholesky
+        if (gpu != nullptr && rows >= cfg.gpuMinRows && cfg.solverPreconditioner != PlacerHeapCfg::PRECOND_ICHOL)
+            esx.gpu = gpu.get();
         for (int i = 0; i < 5; i++) {
-            EquationSystem<double> esx(solve_cells.size(), solve_cells.size());
-            build_equations(esx, yaxis, iter);
-            solve_equations(esx, yaxis);
+            build_equations(ss, esx, yaxis, iter);
+            solve_equations(ss, esx, yaxis);
+            ss.solver_iters[yaxis] += esx.iterations;
         }
+        // The systems of both axes can be alive at once, on separate threads
+        memory_track(yaxis ? "placer_heap/solver_y" : "placer_heap/solver_x", esx.memory_usage());
+    }
+
+    // Solve both axes, on two threads if parallel
+    void solve_axes(SolveSet &ss, int iter, bool parallel)
+    {
+#ifndef NPNR_DISABLE_THREADS
+        if (parallel) {
+            boost::thread xaxis([&]() { build_solve_direction(ss, false, iter); });
+            build_solve_direction(ss, true, iter);
+            xaxis.join();
+            return;
+        }
+#endif
+        build_solve_direction(ss, false, iter);
+        build_solve_direction(ss, true, iter);
+    }
+
+    // Group consecutive heap runs into batches that can be solved at once: no net connects the cells of two runs in a
+    // batch (counting chain children with their root), so the equations of each don't depend on the others' cells
+    std::vector<std::vector<int>> batch_heap_runs(const std::vector<std::unordered_set<IdString>> &heap_runs)
+    {
+        std::vector<std::vector<int>> batches;
+        std::vector<std::vector<bool>> run_nets;
+        if (cfg.runThreads > 1) {
+            std::vector<bool> is_placed(cells.size());
+            for (auto cell : place_cells)
+                is_placed.at(cell->udata) = true;
+            for (auto &run : heap_runs) {
+                run_nets.emplace_back(nets.size());
+                for (size_t i = 0; i < nets.size(); i++)
+                    foreach_port(nets.at(i), [&](PortRef &port, int user_idx) {
+                        CellInfo *root = chain_root.at(port.cell->udata);
+                        if (root == nullptr)
+                            root = port.cell;
+                        if (is_placed.at(root->udata) && run.count(root->type))
+                            run_nets.back().at(i) = true;
+                    });
+            }
+        }
+        auto independent = [&](int a, int b) {
+            for (size_t i = 0; i < nets.size(); i++)
+                if (run_nets.at(a).at(i) && run_nets.at(b).at(i))
+                    return false;
+            return true;
+        };
+        for (int r = 0; r < int(heap_runs.size()); r++) {
+            if (!batches.empty() && !run_nets.empty() &&
+                std::all_of(batches.back().begin(), batches.back().end(), [&](int b) { return independent(b, r); }))
+                batches.back().push_back(r);
+            else
+                batches.push_back({r});
+        }
+        int largest = 0;
+        for (auto &batch : batches)
+            largest = std::max(largest, int(batch.size()));
+        if (largest > 1)
+            log_info("Solving up to %d heap runs at once.\n", largest);
+        return batches;
     }
 
     // Check if a cell has any meaningful connectivity
@@ -523,6 +912,8 @@ class HeAPPlacer
     // FIXME: Are there better approaches to the initial placement (e.g. greedy?)
     void seed_placement()
     {
+        // Cells solved for, seeded at a random bel
+        std::vector<CellInfo *> random_cells;
         std::unordered_map<IdString, std::deque<BelId>> available_bels;
         for (auto bel : ctx->getBels()) {
             if (!ctx->checkBelAvail(bel))
@@ -536,10 +927,13 @@ class HeAPPlacer
             CellInfo *ci = cell.second;
             if (ci->bel != BelId()) {
                 Loc loc = ctx->getBelLocation(ci->bel);
-                cell_locs[cell.first].x = loc.x;
-                cell_locs[cell.first].y = loc.y;
-                cell_locs[cell.first].locked = true;
-                cell_locs[cell.first].global = ctx->getBelGlobalBuf(ci->bel);
+                cell_locs.at(ci->udata).x = loc.x;
+                cell_locs.at(ci->udata).y = loc.y;
+                cell_locs.at(ci->udata).locked = true;
+                cell_locs.at(ci->udata).global = ctx->getBelGlobalBuf(ci->bel);
+                cell_locs.at(ci->udata).valid = true;
+            } else if (ci->constr_parent == nullptr && place_guided(ci)) {
+                guided_cells++;
             } else if (ci->constr_parent == nullptr) {
                 bool placed = false;
                 int attempt_count = 0;
@@ -553,18 +947,20 @@ class HeAPPlacer
                     BelId bel = available_bels.at(ci->type).back();
                     available_bels.at(ci->type).pop_back();
                     Loc loc = ctx->getBelLocation(bel);
-                    cell_locs[cell.first].x = loc.x;
-                    cell_locs[cell.first].y = loc.y;
-                    cell_locs[cell.first].locked = false;
-                    cell_locs[cell.first].global = ctx->getBelGlobalBuf(bel);
+                    cell_locs.at(ci->udata).x = loc.x;
+                    cell_locs.at(ci->udata).y = loc.y;
+                    cell_locs.at(ci->udata).locked = false;
+                    cell_locs.at(ci->udata).global = ctx->getBelGlobalBuf(bel);
+                    cell_locs.at(ci->udata).valid = true;
                     // FIXME
                     if (has_connectivity(cell.second) && !cfg.ioBufTypes.count(ci->type)) {
                         place_cells.push_back(ci);
+                        random_cells.push_back(ci);
                         placed = true;
                     } else {
                         if (ctx->isValidBelForCell(ci, bel)) {
                             ctx->bindBel(bel, ci, STRENGTH_STRONG);
-                            cell_locs[cell.first].locked = true;
+                            cell_locs.at(ci->udata).locked = true;
                             placed = true;
                         } else {
                             available_bels.at(ci->type).push_front(bel);
@@ -573,46 +969,278 @@ class HeAPPlacer
                 }
             }
         }
+        if (cfg.connectivitySeed && !random_cells.empty())
+            seed_by_connectivity(random_cells);
+    }
+
+    // Move the randomly seeded cells so that they start near the cells they connect to, giving the first solves a
+    // better starting point. Cells are visited breadth first from the fixed (e.g. IO) and guided cells, through nets
+    // of up to seed_max_fanout users; each takes the free random seed location of its type nearest the average
+    // location of its already seeded neighbours. Cells not reached from any fixed cell start new searches in turn
+    void seed_by_connectivity(const std::vector<CellInfo *> &random_cells)
+    {
+        auto root_of = [](CellInfo *cell) {
+            while (cell->constr_parent != nullptr)
+                cell = cell->constr_parent;
+            return cell;
+        };
+        // Run a function on every net of a cell and its chain children
+        auto foreach_chain_net = [&](CellInfo *root, std::function<void(NetInfo *)> func) {
+            std::vector<CellInfo *> stack{root};
+            while (!stack.empty()) {
+                CellInfo *cell = stack.back();
+                stack.pop_back();
+                for (auto &port : cell->ports) {
+                    NetInfo *ni = port.second.net;
+                    if (ni != nullptr && ni->driver.cell != nullptr && int(ni->users.size()) <= seed_max_fanout &&
+                        !cell_locs.at(ni->driver.cell->udata).global)
+                        func(ni);
+                }
+                stack.insert(stack.end(), cell->constr_children.begin(), cell->constr_children.end());
+            }
+        };
+
+        // The random seed locations, as a count per tile for each cell type
+        std::unordered_map<IdString, std::vector<std::vector<int>>> free_locs;
+        std::vector<bool> seeded(cells.size(), true);
+        for (auto cell : random_cells) {
+            auto &grid = free_locs[cell->type];
+            if (grid.empty())
+                grid.assign(max_x + 1, std::vector<int>(max_y + 1, 0));
+            grid.at(cell_locs.at(cell->udata).x).at(cell_locs.at(cell->udata).y)++;
+            seeded.at(cell->udata) = false;
+        }
+
+        // Take the free location of the cell's type nearest to the average of its seeded neighbours, or to its random
+        // location if there are none
+        auto seed_cell = [&](CellInfo *cell) {
+            auto &cl = cell_locs.at(cell->udata);
+            double sum_x = 0, sum_y = 0;
+            int count = 0;
+            foreach_chain_net(cell, [&](NetInfo *ni) {
+                foreach_port(ni, [&](PortRef &port, int user_idx) {
+                    CellInfo *other = root_of(port.cell);
+                    if (other == cell || !seeded.at(other->udata) || !cell_locs.at(other->udata).valid)
+                        return;
+                    sum_x += cell_locs.at(other->udata).x;
+                    sum_y += cell_locs.at(other->udata).y;
+                    count++;
+                });
+            });
+            int tx = count ? int(sum_x / count + 0.5) : cl.x, ty = count ? int(sum_y / count + 0.5) : cl.y;
+            auto &grid = free_locs.at(cell->type);
+            // Search square rings of increasing radius around the target
+            for (int r = 0; r <= std::max(max_x, max_y); r++) {
+                for (int x = std::max(0, tx - r); x <= std::min(max_x, tx + r); x++) {
+                    int dy = (std::abs(x - tx) == r) ? 1 : 2 * r;
+                    for (int y = ty - r; y <= ty + r; y += std::max(1, dy)) {
+                        if (y < 0 || y > max_y || grid.at(x).at(y) == 0)
+                            continue;
+                        grid.at(x).at(y)--;
+                        cl.x = x;
+                        cl.y = y;
+                        seeded.at(cell->udata) = true;
+                        return;
+                    }
+                }
+            }
+            NPNR_ASSERT_FALSE("no free seed location");
+        };
+
+        std::queue<CellInfo *> visit;
+        int start_cells = 0;
+        for (auto cell : cells)
+            if (cell->constr_parent == nullptr && cell_locs.at(cell->udata).valid && seeded.at(cell->udata)) {
+                visit.push(cell);
+                start_cells++;
+            }
+        auto next_start = random_cells.begin();
+        while (true) {
+            if (visit.empty()) {
+                while (next_start != random_cells.end() && seeded.at((*next_start)->udata))
+                    ++next_start;
+                if (next_start == random_cells.end())
+                    break;
+                seed_cell(*next_start);
+                visit.push(*next_start);
+            }
+            CellInfo *cell = visit.front();
+            visit.pop();
+            foreach_chain_net(cell, [&](NetInfo *ni) {
+                foreach_port(ni, [&](PortRef &port, int user_idx) {
+                    CellInfo *other = root_of(port.cell);
+                    if (seeded.at(other->udata))
+                        return;
+                    seed_cell(other);
+                    visit.push(other);
+                });
+            });
+        }
+        log_info("Seeded %d cells by connectivity from %d fixed or guided cells.\n", int(random_cells.size()),
+                 start_cells);
     }
 
-    // Setup the cells to be solved, returns the number of rows
-    int setup_solve_cells(std::unordered_set<IdString> *celltypes = nullptr)
+    // Seed a cell at its bel in the placement guide, if the bel still suits it. Like random seeds, the locations of
+    // cells that are solved for are only a starting point; the others are bound to the guide bel straight away
+    bool place_guided(CellInfo *ci)
+    {
+        auto found = ctx->placement_guide.find(ci->name);
+        if (found == ctx->placement_guide.end() || ctx->getBelType(found->second) != ci->type)
+            return false;
+        BelId bel = found->second;
+        auto &cl = cell_locs.at(ci->udata);
+        if (has_connectivity(ci) && !cfg.ioBufTypes.count(ci->type)) {
+            place_cells.push_back(ci);
+            cl.locked = false;
+        } else {
+            if (!ctx->checkBelAvail(bel) || !ctx->isValidBelForCell(ci, bel))
+                return false;
+            ctx->bindBel(bel, ci, STRENGTH_STRONG);
+            cl.locked = true;
+        }
+        Loc loc = ctx->getBelLocation(bel);
+        cl.x = loc.x;
+        cl.y = loc.y;
+        cl.global = ctx->getBelGlobalBuf(bel);
+        cl.valid = true;
+        return true;
+    }
+
+    // Setup the cells to be solved, returns the number of rows. If clustered, all cells of a cluster share a row
+    int setup_solve_cells(SolveSet &ss, std::unordered_set<IdString> *celltypes = nullptr, bool clustered = false)
     {
         int row = 0;
-        solve_cells.clear();
-        // First clear the udata of all cells
-        for (auto cell : sorted(ctx->cells))
-            cell.second->udata = dont_solve;
+        ss.solve_cells.clear();
+        // First clear the row of all cells
+        ss.solve_row.assign(cells.size(), dont_solve);
         // Then update cells to be placed, which excludes cell children
         for (auto cell : place_cells) {
             if (celltypes && !celltypes->count(cell->type))
                 continue;
-            cell->udata = row++;
-            solve_cells.push_back(cell);
+            if (clustered && cluster_head.at(cluster_of.at(cell->udata)) != cell) {
+                ss.solve_row.at(cell->udata) = ss.solve_row.at(cluster_head.at(cluster_of.at(cell->udata))->udata);
+                continue;
+            }
+            ss.solve_row.at(cell->udata) = row++;
+            ss.solve_cells.push_back(cell);
+        }
+        // Finally, update the row of children
+        for (auto cell : cells)
+            if (chain_root.at(cell->udata) != nullptr)
+                ss.solve_row.at(cell->udata) = ss.solve_row.at(chain_root.at(cell->udata)->udata);
+        // Nets above the star fanout, with at least one cell being solved, get an extra row for their star node
+        ss.star_rows.assign(nets.size(), -1);
+        ss.n_star_nets = 0;
+        if (cfg.starFanout > 0) {
+            for (size_t i = 0; i < nets.size(); i++) {
+                NetInfo *ni = nets.at(i);
+                if (ni->driver.cell == nullptr || int(ni->users.size()) < cfg.starFanout)
+                    continue;
+                if (cell_locs.at(ni->driver.cell->udata).global)
+                    continue;
+                bool movable = false;
+                foreach_port(ni, [&](PortRef &port, int user_idx) {
+                    if (ss.solve_row.at(port.cell->udata) != dont_solve)
+                        movable = true;
+                });
+                if (movable)
+                    ss.star_rows.at(i) = row + ss.n_star_nets++;
+            }
+        }
+        for (int axis = 0; axis < 2; axis++)
+            ss.star_centre[axis].assign(ss.n_star_nets, 0);
+        return row + ss.n_star_nets;
+    }
+
+    // Group place_cells into clusters of up to clusterSize cells, returning the number of clusters. Each cell in turn
+    // joins the already formed cluster it is most strongly connected to, relative to the size of the cluster, or
+    // starts a new one. Connections to cells in the same hierarchical cell count double, as these are likely to end
+    // up close together
+    int build_clusters()
+    {
+        cluster_of.assign(cells.size(), -1);
+        cluster_head.clear();
+        std::vector<int> cluster_size;
+        std::vector<double> score;
+        std::vector<int> candidates;
+        for (auto cell : place_cells) {
+            candidates.clear();
+            for (auto &port : cell->ports) {
+                NetInfo *ni = port.second.net;
+                if (ni == nullptr || ni->driver.cell == nullptr || ni->users.empty())
+                    continue;
+                if (int(ni->users.size()) > cluster_max_fanout || cell_locs.at(ni->driver.cell->udata).global)
+                    continue;
+                foreach_port(ni, [&](PortRef &other, int user_idx) {
+                    CellInfo *oc = other.cell;
+                    if (chain_root.at(oc->udata) != nullptr)
+                        oc = chain_root.at(oc->udata);
+                    if (oc == cell || cluster_of.at(oc->udata) == -1)
+                        return;
+                    int cluster = cluster_of.at(oc->udata);
+                    if (cluster_head.at(cluster)->region != cell->region)
+                        return;
+                    if (score.at(cluster) == 0)
+                        candidates.push_back(cluster);
+                    score.at(cluster) += (oc->hierpath == cell->hierpath ? 2.0 : 1.0) / ni->users.size();
+                });
+            }
+            int best = -1;
+            double best_score = 0;
+            for (int cluster : candidates) {
+                double cluster_score = score.at(cluster) / cluster_size.at(cluster);
+                if (cluster_size.at(cluster) + chain_size.at(cell->udata) <= cfg.clusterSize &&
+                    cluster_score > best_score) {
+                    best = cluster;
+                    best_score = cluster_score;
+                }
+                score.at(cluster) = 0;
+            }
+            if (best == -1) {
+                best = int(cluster_head.size());
+                cluster_head.push_back(cell);
+                cluster_size.push_back(0);
+                score.push_back(0);
+            }
+            cluster_of.at(cell->udata) = best;
+            cluster_size.at(best) += chain_size.at(cell->udata);
+        }
+        return int(cluster_head.size());
+    }
+
+    // Move every cell in place_cells to the location of the head of its cluster
+    void update_clusters()
+    {
+        for (auto cell : place_cells) {
+            CellInfo *head = cluster_head.at(cluster_of.at(cell->udata));
+            if (head == cell)
+                continue;
+            auto &loc = cell_locs.at(cell->udata), &head_loc = cell_locs.at(head->udata);
+            loc.x = head_loc.x;
+            loc.y = head_loc.y;
+            loc.rawx = head_loc.rawx;
+            loc.rawy = head_loc.rawy;
         }
-        // Finally, update the udata of children
-        for (auto chained : chain_root)
-            ctx->cells.at(chained.first)->udata = chained.second->udata;
-        return row;
     }
 
     // Update the location of all children of a chain
     void update_chain(CellInfo *cell, CellInfo *root)
     {
-        const auto &base = cell_locs[cell->name];
+        const auto &base = cell_locs.at(cell->udata);
         for (auto child : cell->constr_children) {
             // FIXME: Improve handling of heterogeneous chains
             if (child->type == root->type)
-                chain_size[root->name]++;
+                chain_size.at(root->udata)++;
             if (child->constr_x != child->UNCONSTR)
-                cell_locs[child->name].x = std::max(0, std::min(max_x, base.x + child->constr_x));
+                cell_locs.at(child->udata).x = std::max(0, std::min(max_x, base.x + child->constr_x));
             else
-                cell_locs[child->name].x = base.x; // better handling of UNCONSTR?
+                cell_locs.at(child->udata).x = base.x; // better handling of UNCONSTR?
             if (child->constr_y != child->UNCONSTR)
-                cell_locs[child->name].y = std::max(0, std::min(max_y, base.y + child->constr_y));
+                cell_locs.at(child->udata).y = std::max(0, std::min(max_y, base.y + child->constr_y));
             else
-                cell_locs[child->name].y = base.y; // better handling of UNCONSTR?
-            chain_root[child->name] = root;
+                cell_locs.at(child->udata).y = base.y; // better handling of UNCONSTR?
+            cell_locs.at(child->udata).valid = true;
+            chain_root.at(child->udata) = root;
             if (!child->constr_children.empty())
                 update_chain(child, root);
         }
@@ -622,7 +1250,7 @@ class HeAPPlacer
     void update_all_chains()
     {
         for (auto cell : place_cells) {
-            chain_size[cell->name] = 1;
+            chain_size.at(cell->udata) = 1;
             if (!cell->constr_children.empty())
                 update_chain(cell, cell);
         }
@@ -637,29 +1265,82 @@ class HeAPPlacer
             func(net->users.at(i), i);
     }
 
+    // Run a function on the driver and every stride-th user of a net
+    template <typename Tf> void foreach_sampled_port(NetInfo *net, int stride, Tf func)
+    {
+        if (net->driver.cell != nullptr)
+            func(net->driver, -1);
+        for (size_t i = 0; i < net->users.size(); i += stride)
+            func(net->users.at(i), i);
+    }
+
     // Build the system of equations for either X or Y
-    void build_equations(EquationSystem<double> &es, bool yaxis, int iter = -1)
+    void build_equations(SolveSet &ss, EquationSystem<double> &es, bool yaxis, int iter = -1)
     {
         // Return the x or y position of a cell, depending on ydir
-        auto cell_pos = [&](CellInfo *cell) { return yaxis ? cell_locs.at(cell->name).y : cell_locs.at(cell->name).x; };
+        auto cell_pos = [&](CellInfo *cell) {
+            return yaxis ? cell_locs.at(cell->udata).y : cell_locs.at(cell->udata).x;
+        };
         auto legal_pos = [&](CellInfo *cell) {
-            return yaxis ? cell_locs.at(cell->name).legal_y : cell_locs.at(cell->name).legal_x;
+            return yaxis ? cell_locs.at(cell->udata).legal_y : cell_locs.at(cell->udata).legal_x;
+        };
+
+        // Timing weight of an arc to a user
+        auto crit_weight = [&](NetInfo *ni, int user_idx) {
+            if (user_idx != -1 && net_crit.count(ni->name)) {
+                auto &nc = net_crit.at(ni->name);
+                if (user_idx < int(nc.criticality.size()))
+                    return 1.0 + cfg.timingWeight * std::pow(nc.criticality.at(user_idx), cfg.criticalityExponent);
+            }
+            return 1.0;
         };
+        double scale = yaxis ? cfg.hpwl_scale_y : cfg.hpwl_scale_x;
 
         es.reset();
 
-        for (auto net : sorted(ctx->nets)) {
-            NetInfo *ni = net.second;
+        for (size_t net_idx = 0; net_idx < nets.size(); net_idx++) {
+            NetInfo *ni = nets.at(net_idx);
             if (ni->driver.cell == nullptr)
                 continue;
             if (ni->users.empty())
                 continue;
-            if (cell_locs.at(ni->driver.cell->name).global)
+            if (cell_locs.at(ni->driver.cell->udata).global)
                 continue;
+            // Very high fanout nets only use a sample of their users, with the weights scaled up to match
+            int stride = 1;
+            if (cfg.netSampleFanout > 0 && int(ni->users.size()) > cfg.netSampleFanout)
+                stride = (int(ni->users.size()) + cfg.netSampleFanout - 1) / cfg.netSampleFanout;
+            int n_users = (int(ni->users.size()) + stride - 1) / stride;
+
+            int star = ss.star_rows.at(net_idx);
+            if (star != -1) {
+                // Star model: every port connects to a star node, which is solved for along with the cells, rather
+                // than to the two bounds of the net
+                double centre = 0;
+                foreach_sampled_port(ni, stride, [&](PortRef &port, int user_idx) { centre += cell_pos(port.cell); });
+                centre /= (n_users + 1);
+                ss.star_centre[yaxis].at(star - ss.solve_cells.size()) = centre;
+                foreach_sampled_port(ni, stride, [&](PortRef &port, int user_idx) {
+                    int pos = cell_pos(port.cell);
+                    double weight = 2.0 / (n_users * std::max<double>(1, scale * std::abs(pos - centre)));
+                    weight *= crit_weight(ni, user_idx);
+                    es.add_coeff(star, star, weight);
+                    int row = ss.solve_row.at(port.cell->udata);
+                    if (row != dont_solve) {
+                        es.add_coeff(row, row, weight);
+                        es.add_coeff(row, star, -weight);
+                        es.add_coeff(star, row, -weight);
+                    } else {
+                        es.add_rhs(star, weight * pos);
+                    }
+                });
+                continue;
+            }
+
             // Find the bounds of the net in this axis, and the ports that correspond to these bounds
             PortRef *lbport = nullptr, *ubport = nullptr;
             int lbpos = std::numeric_limits<int>::max(), ubpos = std::numeric_limits<int>::min();
-            foreach_port(ni, [&](PortRef &port, int user_idx) {
+            foreach_sampled_port(ni, stride, [&](PortRef &port, int user_idx) {
                 int pos = cell_pos(port.cell);
                 if (pos < lbpos) {
                     lbpos = pos;
@@ -674,12 +1355,12 @@ class HeAPPlacer
             NPNR_ASSERT(ubport != nullptr);
 
             auto stamp_equation = [&](PortRef &var, PortRef &eqn, double weight) {
-                if (eqn.cell->udata == dont_solve)
+                if (ss.solve_row.at(eqn.cell->udata) == dont_solve)
                     return;
-                int row = eqn.cell->udata;
+                int row = ss.solve_row.at(eqn.cell->udata);
                 int v_pos = cell_pos(var.cell);
-                if (var.cell->udata != dont_solve) {
-                    es.add_coeff(row, var.cell->udata, weight);
+                if (ss.solve_row.at(var.cell->udata) != dont_solve) {
+                    es.add_coeff(row, ss.solve_row.at(var.cell->udata), weight);
                 } else {
                     es.add_rhs(row, -v_pos * weight);
                 }
@@ -691,22 +1372,14 @@ class HeAPPlacer
             };
 
             // Add all relevant connections to the matrix
-            foreach_port(ni, [&](PortRef &port, int user_idx) {
+            foreach_sampled_port(ni, stride, [&](PortRef &port, int user_idx) {
                 int this_pos = cell_pos(port.cell);
                 auto process_arc = [&](PortRef *other) {
                     if (other == &port)
                         return;
                     int o_pos = cell_pos(other->cell);
-                    double weight = 1.0 / (ni->users.size() *
-                                           std::max<double>(1, (yaxis ? cfg.hpwl_scale_y : cfg.hpwl_scale_x) *
-                                                                       std::abs(o_pos - this_pos)));
-
-                    if (user_idx != -1 && net_crit.count(ni->name)) {
-                        auto &nc = net_crit.at(ni->name);
-                        if (user_idx < int(nc.criticality.size()))
-                            weight *= (1.0 + cfg.timingWeight *
-                                                     std::pow(nc.criticality.at(user_idx), cfg.criticalityExponent));
-                    }
+                    double weight = 1.0 / (n_users * std::max<double>(1, scale * std::abs(o_pos - this_pos)));
+                    weight *= crit_weight(ni, user_idx);
 
                     // If cell 0 is not fixed, it will stamp +w on its equation and -w on the other end's equation,
                     // if the other end isn't fixed
@@ -721,9 +1394,9 @@ class HeAPPlacer
         }
         if (iter != -1) {
             float alpha = cfg.alpha;
-            for (size_t row = 0; row < solve_cells.size(); row++) {
-                int l_pos = legal_pos(solve_cells.at(row));
-                int c_pos = cell_pos(solve_cells.at(row));
+            for (size_t row = 0; row < ss.solve_cells.size(); row++) {
+                int l_pos = legal_pos(ss.solve_cells.at(row));
+                int c_pos = cell_pos(ss.solve_cells.at(row));
 
                 double weight =
                         alpha * iter /
@@ -736,43 +1409,79 @@ class HeAPPlacer
     }
 
     // Build the system of equations for either X or Y
-    void solve_equations(EquationSystem<double> &es, bool yaxis)
+    void solve_equations(const SolveSet &ss, EquationSystem<double> &es, bool yaxis)
     {
         // Return the x or y position of a cell, depending on ydir
-        auto cell_pos = [&](CellInfo *cell) { return yaxis ? cell_locs.at(cell->name).y : cell_locs.at(cell->name).x; };
+        auto cell_pos = [&](CellInfo *cell) {
+            return yaxis ? cell_locs.at(cell->udata).y : cell_locs.at(cell->udata).x;
+        };
         std::vector<double> vals;
-        std::transform(solve_cells.begin(), solve_cells.end(), std::back_inserter(vals), cell_pos);
+        std::transform(ss.solve_cells.begin(), ss.solve_cells.end(), std::back_inserter(vals), cell_pos);
+        vals.insert(vals.end(), ss.star_centre[yaxis].begin(), ss.star_centre[yaxis].end());
         es.solve(vals, cfg.solverTolerance);
-        for (size_t i = 0; i < vals.size(); i++)
+        for (size_t i = 0; i < ss.solve_cells.size(); i++) {
+            CellInfo *cell = ss.solve_cells.at(i);
+            auto &cl = cell_locs.at(cell->udata);
             if (yaxis) {
-                cell_locs.at(solve_cells.at(i)->name).rawy = vals.at(i);
-                cell_locs.at(solve_cells.at(i)->name).y = std::min(max_y, std::max(0, int(vals.at(i))));
-                if (solve_cells.at(i)->region != nullptr)
-                    cell_locs.at(solve_cells.at(i)->name).y =
-                            limit_to_reg(solve_cells.at(i)->region, cell_locs.at(solve_cells.at(i)->name).y, true);
+                cl.rawy = vals.at(i);
+                cl.y = limit_to_reg(cell->region, std::min(max_y, std::max(0, int(vals.at(i)))), true);
             } else {
-                cell_locs.at(solve_cells.at(i)->name).rawx = vals.at(i);
-                cell_locs.at(solve_cells.at(i)->name).x = std::min(max_x, std::max(0, int(vals.at(i))));
-                if (solve_cells.at(i)->region != nullptr)
-                    cell_locs.at(solve_cells.at(i)->name).x =
-                            limit_to_reg(solve_cells.at(i)->region, cell_locs.at(solve_cells.at(i)->name).x, false);
+                cl.rawx = vals.at(i);
+                cl.x = limit_to_reg(cell->region, std::min(max_x, std::max(0, int(vals.at(i)))), false);
             }
+        }
+    }
+
+    // Optional GPU offload of the larger equation solves and of total_hpwl
+    std::unique_ptr<HeapGpu> gpu;
+    // Cell locations for the GPU wirelength evaluation
+    std::vector<int> gpu_cell_x, gpu_cell_y;
+
+    void setup_gpu()
+    {
+        gpu = HeapGpu::create();
+        if (gpu == nullptr || int(place_cells.size()) < cfg.gpuMinRows)
+            return;
+        // The nets counted by total_hpwl; the cells on global buffers stay there
+        std::vector<int> net_start, pin_cell;
+        for (auto ni : nets) {
+            if (ni->driver.cell == nullptr || cell_locs.at(ni->driver.cell->udata).global)
+                continue;
+            net_start.push_back(int(pin_cell.size()));
+            pin_cell.push_back(ni->driver.cell->udata);
+            for (auto &user : ni->users)
+                pin_cell.push_back(user.cell->udata);
+        }
+        net_start.push_back(int(pin_cell.size()));
+        if (gpu->set_nets(net_start, pin_cell)) {
+            gpu_cell_x.resize(cells.size());
+            gpu_cell_y.resize(cells.size());
+        }
     }
 
     // Compute HPWL
     wirelen_t total_hpwl()
     {
+        if (!gpu_cell_x.empty()) {
+            for (size_t i = 0; i < cells.size(); i++) {
+                gpu_cell_x.at(i) = cell_locs.at(i).x;
+                gpu_cell_y.at(i) = cell_locs.at(i).y;
+            }
+            int64_t span_x, span_y;
+            if (gpu->net_spans(gpu_cell_x, gpu_cell_y, span_x, span_y))
+                return cfg.hpwl_scale_x * span_x + cfg.hpwl_scale_y * span_y;
+            gpu_cell_x.clear();
+        }
         wirelen_t hpwl = 0;
-        for (auto net : sorted(ctx->nets)) {
-            NetInfo *ni = net.second;
+        for (auto ni : nets) {
             if (ni->driver.cell == nullptr)
                 continue;
-            CellLocation &drvloc = cell_locs.at(ni->driver.cell->name);
+            CellLocation &drvloc = cell_locs.at(ni->driver.cell->udata);
             if (drvloc.global)
                 continue;
             int xmin = drvloc.x, xmax = drvloc.x, ymin = drvloc.y, ymax = drvloc.y;
             for (auto &user : ni->users) {
-                CellLocation &usrloc = cell_locs.at(user.cell->name);
+                CellLocation &usrloc = cell_locs.at(user.cell->udata);
                 xmin = std::min(xmin, usrloc.x);
                 xmax = std::max(xmax, usrloc.x);
                 ymin = std::min(ymin, usrloc.y);
@@ -786,22 +1495,54 @@ class HeAPPlacer
     // Strict placement legalisation, performed after the initial HeAP spreading
     void legalise_placement_strict(bool require_validity = false)
     {
+        NPNR_PROFILE_ZONE("legalise");
         auto startt = std::chrono::high_resolution_clock::now();
 
         // Unbind all cells placed in this solution
         for (auto cell : sorted(ctx->cells)) {
             CellInfo *ci = cell.second;
-            if (ci->bel != BelId() && (ci->udata != dont_solve ||
-                                       (chain_root.count(ci->name) && chain_root.at(ci->name)->udata != dont_solve)))
+            if (ci->bel != BelId() && (solve.solve_row.at(ci->udata) != dont_solve ||
+                                       (chain_root.at(ci->udata) != nullptr &&
+                                        solve.solve_row.at(chain_root.at(ci->udata)->udata) != dont_solve)))
                 ctx->unbindBel(ci->bel);
         }
 
+        if (cfg.reserveMacros)
+            reserve_macro_space();
+
         // At the moment we don't follow the full HeAP algorithm using cuts for legalisation, instead using
         // the simple greedy largest-macro-first approach.
         std::priority_queue<std::pair<int, IdString>> remaining;
-        for (auto cell : solve_cells) {
-            remaining.emplace(chain_size[cell->name], cell->name);
+#ifndef NPNR_DISABLE_THREADS
+        if (legalise_pool != nullptr) {
+            // Macros are placed first, as before; then single cells are placed a shard at a time in parallel, and
+            // any left over are placed by the serial legaliser
+            std::vector<CellInfo *> singles;
+            for (auto cell : solve.solve_cells) {
+                if (chain_size.at(cell->udata) > 1 || !cell->constr_children.empty() || cell->constr_abs_z)
+                    remaining.emplace(chain_size.at(cell->udata), cell->name);
+                else
+                    singles.push_back(cell);
+            }
+            legalise_queue(remaining, require_validity);
+            legalise_singles_parallel(singles, remaining, require_validity);
+        } else
+#endif
+        {
+            for (auto cell : solve.solve_cells) {
+                remaining.emplace(chain_size.at(cell->udata), cell->name);
+            }
         }
+        legalise_queue(remaining, require_validity);
+
+        auto endt = std::chrono::high_resolution_clock::now();
+        sl_time += std::chrono::duration<float>(endt - startt).count();
+    }
+
+    // Place the cells in a queue, largest first, by searching random bels of increasing radius around their
+    // position and ripping up other cells if needed
+    void legalise_queue(std::priority_queue<std::pair<int, IdString>> &remaining, bool require_validity)
+    {
         int ripup_radius = 2;
         int total_iters = 0;
         int total_iters_noreset = 0;
@@ -825,7 +1566,7 @@ class HeAPPlacer
 
             total_iters++;
             total_iters_noreset++;
-            if (total_iters > int(solve_cells.size())) {
+            if (total_iters > int(solve.solve_cells.size())) {
                 total_iters = 0;
                 ripup_radius = std::max(std::max(max_x, max_y), ripup_radius * 2);
             }
@@ -834,6 +1575,15 @@ class HeAPPlacer
                 log_error("Unable to find legal placement for all cells, design is probably at utilisation limit.\n");
             }
 
+            auto reservation = macro_reservations.find(ci->name);
+            if (reservation != macro_reservations.end()) {
+                BelId reserved_bel = reservation->second;
+                // Only used once; if the macro is ripped up later it goes through the normal search
+                macro_reservations.erase(reservation);
+                if (place_macro_at(ci, reserved_bel, remaining))
+                    continue;
+            }
+
             while (!placed) {
 
                 // Set a conservative timeout
@@ -854,20 +1604,20 @@ class HeAPPlacer
                                                   1);
                 }
 
-                int nx = ctx->rng(2 * rx + 1) + std::max(cell_locs.at(ci->name).x - rx, 0);
-                int ny = ctx->rng(2 * ry + 1) + std::max(cell_locs.at(ci->name).y - ry, 0);
+                int nx = ctx->rng(2 * rx + 1) + std::max(cell_locs.at(ci->udata).x - rx, 0);
+                int ny = ctx->rng(2 * ry + 1) + std::max(cell_locs.at(ci->udata).y - ry, 0);
 
                 iter++;
                 iter_at_radius++;
                 if (iter >= (10 * (radius + 1))) {
                     radius = std::min(std::max(max_x, max_y), radius + 1);
                     while (radius < std::max(max_x, max_y)) {
-                        for (int x = std::max(0, cell_locs.at(ci->name).x - radius);
-                             x <= std::min(max_x, cell_locs.at(ci->name).x + radius); x++) {
+                        for (int x = std::max(0, cell_locs.at(ci->udata).x - radius);
+                             x <= std::min(max_x, cell_locs.at(ci->udata).x + radius); x++) {
                             if (x >= int(fb.size()))
                                 break;
-                            for (int y = std::max(0, cell_locs.at(ci->name).y - radius);
-                                 y <= std::min(max_y, cell_locs.at(ci->name).y + radius); y++) {
+                            for (int y = std::max(0, cell_locs.at(ci->udata).y - radius);
+                                 y <= std::min(max_y, cell_locs.at(ci->udata).y + radius); y++) {
                                 if (y >= int(fb.at(x).size()))
                                     break;
                                 if (fb.at(x).at(y).size() > 0)
@@ -901,19 +1651,19 @@ class HeAPPlacer
                     CellInfo *bound = ctx->getBoundBelCell(bestBel);
                     if (bound != nullptr) {
                         ctx->unbindBel(bound->bel);
-                        remaining.emplace(chain_size[bound->name], bound->name);
+                        remaining.emplace(chain_size.at(bound->udata), bound->name);
                     }
                     ctx->bindBel(bestBel, ci, STRENGTH_WEAK);
                     placed = true;
                     Loc loc = ctx->getBelLocation(bestBel);
-                    cell_locs[ci->name].x = loc.x;
-                    cell_locs[ci->name].y = loc.y;
+                    cell_locs.at(ci->udata).x = loc.x;
+                    cell_locs.at(ci->udata).y = loc.y;
                     break;
                 }
 
                 if (ci->constr_children.empty() && !ci->constr_abs_z) {
                     for (auto sz : fb.at(nx).at(ny)) {
-                        if (ci->region != nullptr && ci->region->constr_bels && !ci->region->bels.count(sz))
+                        if (!check_cell_bel_region(ctx, ci, sz))
                             continue;
                         if (ctx->checkBelAvail(sz) || (radius > ripup_radius || ctx->rng(20000) < 10)) {
                             CellInfo *bound = ctx->getBoundBelCell(sz);
@@ -938,12 +1688,12 @@ class HeAPPlacer
                                     if (p.type != PORT_IN || p.net == nullptr || p.net->driver.cell == nullptr)
                                         continue;
                                     CellInfo *drv = p.net->driver.cell;
-                                    auto drv_loc = cell_locs.find(drv->name);
-                                    if (drv_loc == cell_locs.end())
+                                    auto &drv_loc = cell_locs.at(drv->udata);
+                                    if (!drv_loc.valid)
                                         continue;
-                                    if (drv_loc->second.global)
+                                    if (drv_loc.global)
                                         continue;
-                                    input_len += std::abs(drv_loc->second.x - nx) + std::abs(drv_loc->second.y - ny);
+                                    input_len += std::abs(drv_loc.x - nx) + std::abs(drv_loc.y - ny);
                                 }
                                 if (input_len < best_inp_len) {
                                     best_inp_len = input_len;
@@ -952,10 +1702,10 @@ class HeAPPlacer
                                 break;
                             } else {
                                 if (bound != nullptr)
-                                    remaining.emplace(chain_size[bound->name], bound->name);
+                                    remaining.emplace(chain_size.at(bound->udata), bound->name);
                                 Loc loc = ctx->getBelLocation(sz);
-                                cell_locs[ci->name].x = loc.x;
-                                cell_locs[ci->name].y = loc.y;
+                                cell_locs.at(ci->udata).x = loc.x;
+                                cell_locs.at(ci->udata).y = loc.y;
                                 placed = true;
                                 break;
                             }
@@ -963,93 +1713,249 @@ class HeAPPlacer
                     }
                 } else {
                     for (auto sz : fb.at(nx).at(ny)) {
-                        Loc loc = ctx->getBelLocation(sz);
-                        if (ci->constr_abs_z && loc.z != ci->constr_z)
-                            continue;
-                        std::vector<std::pair<CellInfo *, BelId>> targets;
-                        std::vector<std::pair<BelId, CellInfo *>> swaps_made;
-                        std::queue<std::pair<CellInfo *, Loc>> visit;
-                        visit.emplace(ci, loc);
-                        while (!visit.empty()) {
-                            CellInfo *vc = visit.front().first;
-                            NPNR_ASSERT(vc->bel == BelId());
-                            Loc ploc = visit.front().second;
-                            visit.pop();
-                            BelId target = ctx->getBelByLocation(ploc);
-                            if (vc->region != nullptr && vc->region->constr_bels && !vc->region->bels.count(target))
-                                goto fail;
-                            CellInfo *bound;
-                            if (target == BelId() || ctx->getBelType(target) != vc->type)
-                                goto fail;
-                            bound = ctx->getBoundBelCell(target);
-                            // Chains cannot overlap
-                            if (bound != nullptr)
-                                if (bound->constr_z != bound->UNCONSTR || bound->constr_parent != nullptr ||
-                                    !bound->constr_children.empty() || bound->belStrength > STRENGTH_WEAK)
-                                    goto fail;
-                            targets.emplace_back(vc, target);
-                            for (auto child : vc->constr_children) {
-                                Loc cloc = ploc;
-                                if (child->constr_x != child->UNCONSTR)
-                                    cloc.x += child->constr_x;
-                                if (child->constr_y != child->UNCONSTR)
-                                    cloc.y += child->constr_y;
-                                if (child->constr_z != child->UNCONSTR)
-                                    cloc.z = child->constr_abs_z ? child->constr_z : (ploc.z + child->constr_z);
-                                visit.emplace(child, cloc);
-                            }
+                        if (place_macro_at(ci, sz, remaining)) {
+                            placed = true;
+                            break;
                         }
+                    }
+                }
+            }
+        }
+    }
 
-                        for (auto &target : targets) {
-                            CellInfo *bound = ctx->getBoundBelCell(target.second);
-                            if (bound != nullptr)
-                                ctx->unbindBel(target.second);
-                            ctx->bindBel(target.second, target.first, STRENGTH_STRONG);
-                            swaps_made.emplace_back(target.second, bound);
-                        }
+    // Find the Bel for each cell of the macro rooted at ci, if its root were placed at loc. Fails if a Bel is missing,
+    // of the wrong type or outside the cell's region, or if it holds a cell that can't be ripped up
+    bool get_macro_targets(CellInfo *ci, Loc loc, std::vector<std::pair<CellInfo *, BelId>> &targets)
+    {
+        targets.clear();
+        if (ci->constr_abs_z && loc.z != ci->constr_z)
+            return false;
+        std::queue<std::pair<CellInfo *, Loc>> visit;
+        visit.emplace(ci, loc);
+        while (!visit.empty()) {
+            CellInfo *vc = visit.front().first;
+            NPNR_ASSERT(vc->bel == BelId());
+            Loc ploc = visit.front().second;
+            visit.pop();
+            BelId target = ctx->getBelByLocation(ploc);
+            if (!check_cell_bel_region(ctx, vc, target))
+                return false;
+            if (target == BelId() || ctx->getBelType(target) != vc->type)
+                return false;
+            CellInfo *bound = ctx->getBoundBelCell(target);
+            // Chains cannot overlap
+            if (bound != nullptr)
+                if (bound->constr_z != bound->UNCONSTR || bound->constr_parent != nullptr ||
+                    !bound->constr_children.empty() || bound->belStrength > STRENGTH_WEAK)
+                    return false;
+            targets.emplace_back(vc, target);
+            for (auto child : vc->constr_children) {
+                Loc cloc = ploc;
+                if (child->constr_x != child->UNCONSTR)
+                    cloc.x += child->constr_x;
+                if (child->constr_y != child->UNCONSTR)
+                    cloc.y += child->constr_y;
+                if (child->constr_z != child->UNCONSTR)
+                    cloc.z = child->constr_abs_z ? child->constr_z : (ploc.z + child->constr_z);
+                visit.emplace(child, cloc);
+            }
+        }
+        return true;
+    }
 
-                        for (auto &sm : swaps_made) {
-                            if (!ctx->isBelLocationValid(sm.first))
-                                goto fail;
-                        }
+    // Try to place the macro rooted at ci with its root at root_bel, ripping up any single cells in the way and adding
+    // them to remaining. On failure the placement is left unchanged
+    bool place_macro_at(CellInfo *ci, BelId root_bel, std::priority_queue<std::pair<int, IdString>> &remaining)
+    {
+        std::vector<std::pair<CellInfo *, BelId>> targets;
+        std::vector<std::pair<BelId, CellInfo *>> swaps_made;
+        if (!get_macro_targets(ci, ctx->getBelLocation(root_bel), targets))
+            return false;
 
-                        if (false) {
-                        fail:
-                            for (auto &swap : swaps_made) {
-                                ctx->unbindBel(swap.first);
-                                if (swap.second != nullptr)
-                                    ctx->bindBel(swap.first, swap.second, STRENGTH_WEAK);
-                            }
+        for (auto &target : targets) {
+            CellInfo *bound = ctx->getBoundBelCell(target.second);
+            if (bound != nullptr)
+                ctx->unbindBel(target.second);
+            ctx->bindBel(target.second, target.first, STRENGTH_STRONG);
+            swaps_made.emplace_back(target.second, bound);
+        }
+
+        for (auto &sm : swaps_made) {
+            if (!ctx->isBelLocationValid(sm.first)) {
+                for (auto &swap : swaps_made) {
+                    ctx->unbindBel(swap.first);
+                    if (swap.second != nullptr)
+                        ctx->bindBel(swap.first, swap.second, STRENGTH_WEAK);
+                }
+                return false;
+            }
+        }
+
+        for (auto &target : targets) {
+            Loc loc = ctx->getBelLocation(target.second);
+            cell_locs.at(target.first->udata).x = loc.x;
+            cell_locs.at(target.first->udata).y = loc.y;
+        }
+        for (auto &swap : swaps_made) {
+            if (swap.second != nullptr)
+                remaining.emplace(chain_size.at(swap.second->udata), swap.second->name);
+        }
+        return true;
+    }
+
+    // Before legalising, give each macro a root Bel where its whole footprint fits, as close as possible to its solved
+    // position and without overlapping the footprints of larger macros. Legalisation then tries that Bel first,
+    // instead of finding space for long chains by random sampling and many ripups
+    void reserve_macro_space()
+    {
+        macro_reservations.clear();
+        std::vector<CellInfo *> macros;
+        for (auto cell : solve.solve_cells)
+            if (!cell->constr_children.empty())
+                macros.push_back(cell);
+        // Largest first, as in legalise_queue
+        std::stable_sort(macros.begin(), macros.end(), [&](const CellInfo *a, const CellInfo *b) {
+            return chain_size.at(a->udata) > chain_size.at(b->udata);
+        });
+
+        std::unordered_set<BelId> reserved;
+        std::vector<std::pair<CellInfo *, BelId>> targets;
+        int max_radius = std::max(max_x, max_y);
+        for (auto ci : macros) {
+            auto &fb = fast_bels.at(std::get<0>(bel_types.at(ci->type)));
+            int cx = cell_locs.at(ci->udata).x, cy = cell_locs.at(ci->udata).y;
+            bool found = false;
+            // Search rings of increasing radius around the solved location
+            for (int radius = 0; radius <= max_radius && !found; radius++) {
+                for (int x = cx - radius; x <= cx + radius && !found; x++) {
+                    if (x < 0 || x >= int(fb.size()))
+                        continue;
+                    for (int y = cy - radius; y <= cy + radius && !found; y++) {
+                        if (y < 0 || y >= int(fb.at(x).size()))
                             continue;
+                        if (std::abs(x - cx) != radius && std::abs(y - cy) != radius)
+                            continue;
+                        for (auto bel : fb.at(x).at(y)) {
+                            if (!get_macro_targets(ci, ctx->getBelLocation(bel), targets))
+                                continue;
+                            if (std::any_of(targets.begin(), targets.end(),
+                                            [&](const std::pair<CellInfo *, BelId> &t) {
+                                                return reserved.count(t.second);
+                                            }))
+                                continue;
+                            for (auto &t : targets)
+                                reserved.insert(t.second);
+                            macro_reservations[ci->name] = bel;
+                            found = true;
+                            break;
                         }
-                        for (auto &target : targets) {
-                            Loc loc = ctx->getBelLocation(target.second);
-                            cell_locs[target.first->name].x = loc.x;
-                            cell_locs[target.first->name].y = loc.y;
-                            // log_info("%s %d %d %d\n", target.first->name.c_str(ctx), loc.x, loc.y, loc.z);
-                        }
-                        for (auto &swap : swaps_made) {
-                            if (swap.second != nullptr)
-                                remaining.emplace(chain_size[swap.second->name], swap.second->name);
-                        }
+                    }
+                }
+            }
+        }
+    }
 
-                        placed = true;
+#ifndef NPNR_DISABLE_THREADS
+    // Parallel legalisation of cells without placement constraints. The device is split into square shards, and each
+    // shard places the cells positioned inside it on the nearest free bels inside it, without binding them. As shards
+    // share no bels, they can't conflict; the bels found are then bound in a fixed shard order, so the result doesn't
+    // depend on the number of threads. Cells that find no bel in their shard, or whose bel turns out not to be valid,
+    // are added to remaining for the serial legaliser.
+    void legalise_singles_parallel(const std::vector<CellInfo *> &cells,
+                                   std::priority_queue<std::pair<int, IdString>> &remaining, bool require_validity)
+    {
+        int shards_x = max_x / legalise_shard_size + 1, shards_y = max_y / legalise_shard_size + 1;
+        std::vector<std::vector<CellInfo *>> shard_cells(shards_x * shards_y);
+        for (auto cell : cells) {
+            auto &cl = cell_locs.at(cell->udata);
+            shard_cells.at((cl.y / legalise_shard_size) * shards_x + (cl.x / legalise_shard_size)).push_back(cell);
+        }
+
+        std::vector<std::vector<BelId>> shard_bels(shard_cells.size());
+        std::vector<int> tasks;
+        for (int i = 0; i < int(shard_cells.size()); i++)
+            if (!shard_cells.at(i).empty())
+                tasks.push_back(i);
+        legalise_pool->run(tasks, [&](int i) {
+            int x0 = (i % shards_x) * legalise_shard_size, y0 = (i / shards_x) * legalise_shard_size;
+            propose_shard(x0, y0, std::min(max_x, x0 + legalise_shard_size - 1),
+                          std::min(max_y, y0 + legalise_shard_size - 1), shard_cells.at(i), shard_bels.at(i));
+        });
+
+        int n_placed = 0;
+        for (int i = 0; i < int(shard_cells.size()); i++)
+            for (int j = 0; j < int(shard_cells.at(i).size()); j++) {
+                CellInfo *ci = shard_cells.at(i).at(j);
+                BelId bel = shard_bels.at(i).at(j);
+                if (bel == BelId() || !ctx->checkBelAvail(bel)) {
+                    remaining.emplace(chain_size.at(ci->udata), ci->name);
+                    continue;
+                }
+                ctx->bindBel(bel, ci, STRENGTH_WEAK);
+                if (require_validity && !ctx->isBelLocationValid(bel)) {
+                    ctx->unbindBel(bel);
+                    remaining.emplace(chain_size.at(ci->udata), ci->name);
+                    continue;
+                }
+                Loc loc = ctx->getBelLocation(bel);
+                cell_locs.at(ci->udata).x = loc.x;
+                cell_locs.at(ci->udata).y = loc.y;
+                n_placed++;
+            }
+        if (ctx->verbose)
+            log_info("    parallel legalisation placed %d/%d cells\n", n_placed, int(cells.size()));
+    }
+
+    // Find the nearest free bel inside a shard for each of its cells, without binding; this only reads the context
+    // so can be run for several shards at once
+    void propose_shard(int x0, int y0, int x1, int y1, const std::vector<CellInfo *> &cells, std::vector<BelId> &bels)
+    {
+        std::unordered_set<BelId> taken;
+        auto find_bel = [&](CellInfo *ci) {
+            auto &fb = fast_bels.at(std::get<0>(bel_types.at(ci->type)));
+            auto &cl = cell_locs.at(ci->udata);
+            int max_radius = std::max(std::max(cl.x - x0, x1 - cl.x), std::max(cl.y - y0, y1 - cl.y));
+            for (int radius = 0; radius <= max_radius; radius++)
+                for (int x = std::max(x0, cl.x - radius); x <= std::min(x1, cl.x + radius); x++) {
+                    if (x >= int(fb.size()))
                         break;
+                    for (int y = std::max(y0, cl.y - radius); y <= std::min(y1, cl.y + radius); y++) {
+                        // Only visit the ring at this radius
+                        if (std::max(std::abs(x - cl.x), std::abs(y - cl.y)) != radius)
+                            continue;
+                        if (y >= int(fb.at(x).size()))
+                            break;
+                        for (auto bel : fb.at(x).at(y)) {
+                            if (!check_cell_bel_region(ctx, ci, bel))
+                                continue;
+                            if (taken.count(bel) || !ctx->checkBelAvail(bel))
+                                continue;
+                            return bel;
+                        }
                     }
                 }
-            }
+            return BelId();
+        };
+        bels.clear();
+        for (auto ci : cells) {
+            BelId bel = find_bel(ci);
+            if (bel != BelId())
+                taken.insert(bel);
+            bels.push_back(bel);
         }
-        auto endt = std::chrono::high_resolution_clock::now();
-        sl_time += std::chrono::duration<float>(endt - startt).count();
     }
+#endif
+
     // Implementation of the cut-based spreading as described in the HeAP/SimPL papers
 
     template <typename T> T limit_to_reg(Region *reg, T val, bool dir)
     {
         if (reg == nullptr)
             return val;
-        int limit_low = dir ? constraint_region_bounds[reg->name].y0 : constraint_region_bounds[reg->name].x0;
-        int limit_high = dir ? constraint_region_bounds[reg->name].y1 : constraint_region_bounds[reg->name].x1;
+        // Read only (with at), as this is called from parallel spreading
+        const BoundingBox &bounds = constraint_region_bounds.at(reg->name);
+        int limit_low = dir ? bounds.y0 : bounds.x0;
+        int limit_high = dir ? bounds.y1 : bounds.x1;
         return std::max<T>(std::min<T>(val, limit_high), limit_low);
     }
 
@@ -1093,8 +1999,10 @@ class HeAPPlacer
         static int seq;
         void run()
         {
+            NPNR_PROFILE_ZONE("spread");
             auto startt = std::chrono::high_resolution_clock::now();
             init();
+            setup_derate();
             find_overused_regions();
             for (auto &r : regions) {
                 if (merged_regions.count(r.id))
@@ -1105,12 +2013,12 @@ class HeAPPlacer
 #endif
             }
             expand_regions();
-            std::queue<std::pair<int, bool>> workqueue;
+            std::vector<std::pair<int, bool>> workqueue;
 #if 0
             std::vector<std::pair<double, double>> orig;
             if (ctx->debug)
-                for (auto c : p->solve_cells)
-                    orig.emplace_back(p->cell_locs[c->name].rawx, p->cell_locs[c->name].rawy);
+                for (auto c : p->solve.solve_cells)
+                    orig.emplace_back(p->cell_locs.at(c->udata).rawx, p->cell_locs.at(c->udata).rawy);
 #endif
             for (auto &r : regions) {
                 if (merged_regions.count(r.id))
@@ -1122,35 +2030,59 @@ class HeAPPlacer
                 }
 
 #endif
-                workqueue.emplace(r.id, false);
+                workqueue.emplace_back(r.id, false);
             }
+            // Regions are cut a generation at a time. The regions of a generation are disjoint, so can be cut in
+            // parallel; and the new regions are added in the same order as cutting them one by one in a FIFO would,
+            // so the result doesn't depend on the number of threads.
+            struct CutResult
+            {
+                boost::optional<std::pair<SpreaderRegion, SpreaderRegion>> halves;
+                bool next_dir;
+            };
             while (!workqueue.empty()) {
-                auto front = workqueue.front();
-                workqueue.pop();
-                auto &r = regions.at(front.first);
-                if (std::all_of(r.cells.begin(), r.cells.end(), [](int x) { return x == 0; }))
-                    continue;
-                auto res = cut_region(r, front.second);
-                if (res) {
-                    workqueue.emplace(res->first, !front.second);
-                    workqueue.emplace(res->second, !front.second);
-                } else {
-                    // Try the other dir, in case stuck in one direction only
-                    auto res2 = cut_region(r, !front.second);
-                    if (res2) {
-                        workqueue.emplace(res2->first, front.second);
-                        workqueue.emplace(res2->second, front.second);
+                std::vector<CutResult> results(workqueue.size());
+                auto process = [&](int i) {
+                    const SpreaderRegion &r = regions.at(workqueue.at(i).first);
+                    bool dir = workqueue.at(i).second;
+                    if (std::all_of(r.cells.begin(), r.cells.end(), [](int x) { return x == 0; }))
+                        return;
+                    results.at(i).halves = cut_region(r, dir);
+                    results.at(i).next_dir = !dir;
+                    if (!results.at(i).halves) {
+                        // Try the other dir, in case stuck in one direction only
+                        results.at(i).halves = cut_region(r, !dir);
+                        results.at(i).next_dir = dir;
                     }
+                };
+#ifndef NPNR_DISABLE_THREADS
+                if (p->spread_pool != nullptr && workqueue.size() > 1) {
+                    std::vector<int> tasks(workqueue.size());
+                    std::iota(tasks.begin(), tasks.end(), 0);
+                    p->spread_pool->run(tasks, process);
+                } else
+#endif
+                {
+                    for (int i = 0; i < int(workqueue.size()); i++)
+                        process(i);
                 }
+                std::vector<std::pair<int, bool>> next;
+                for (auto &res : results) {
+                    if (!res.halves)
+                        continue;
+                    next.emplace_back(add_region(res.halves->first), res.next_dir);
+                    next.emplace_back(add_region(res.halves->second), res.next_dir);
+                }
+                workqueue.swap(next);
             }
 #if 0
             if (ctx->debug) {
                 std::ofstream sp("spread" + std::to_string(seq) + ".csv");
-                for (size_t i = 0; i < p->solve_cells.size(); i++) {
-                    auto &c = p->solve_cells.at(i);
+                for (size_t i = 0; i < p->solve.solve_cells.size(); i++) {
+                    auto &c = p->solve.solve_cells.at(i);
                     if (c->type != beltype)
                         continue;
-                    sp << orig.at(i).first << "," << orig.at(i).second << "," << p->cell_locs[c->name].rawx << "," << p->cell_locs[c->name].rawy << std::endl;
+                    sp << orig.at(i).first << "," << orig.at(i).second << "," << p->cell_locs.at(c->udata).rawx << "," << p->cell_locs.at(c->udata).rawy << std::endl;
                 }
                 std::ofstream oc("cells" + std::to_string(seq) + ".csv");
                 for (size_t y = 0; y <= p->max_y; y++) {
@@ -1185,11 +2117,35 @@ class HeAPPlacer
 
         int occ_at(int x, int y, int type) { return occupancy.at(x).at(y).at(type); }
 
+        // Whether to scale the Bels of each tile by cong_derate
+        bool derate = false;
+
         int bels_at(int x, int y, int type)
         {
             if (x >= int(fb.at(type)->size()) || y >= int(fb.at(type)->at(x).size()))
                 return 0;
-            return int(fb.at(type)->at(x).at(y).size());
+            int bels = int(fb.at(type)->at(x).at(y).size());
+            if (derate)
+                bels = int(std::ceil(bels * p->cong_derate.at(x).at(y)));
+            return bels;
+        }
+
+        // Only scale Bels by congestion if that still leaves enough of each type for all the cells
+        void setup_derate()
+        {
+            if (p->cong_derate.empty())
+                return;
+            std::vector<int> total_cells(beltype.size(), 0), total_bels(beltype.size(), 0);
+            derate = true;
+            for (int x = 0; x <= p->max_x; x++)
+                for (int y = 0; y <= p->max_y; y++)
+                    for (int t = 0; t < int(beltype.size()); t++) {
+                        total_cells.at(t) += occ_at(x, y, t);
+                        total_bels.at(t) += bels_at(x, y, t);
+                    }
+            for (int t = 0; t < int(beltype.size()); t++)
+                if (total_cells.at(t) > p->cfg.beta * total_bels.at(t))
+                    derate = false;
         }
 
         void init()
@@ -1219,40 +2175,42 @@ class HeAPPlacer
                 }
             };
 
-            for (auto &cell : p->cell_locs) {
-                if (!beltype.count(ctx->cells.at(cell.first)->type))
+            for (auto ci : p->cells) {
+                auto &cl = p->cell_locs.at(ci->udata);
+                if (!cl.valid || !beltype.count(ci->type))
                     continue;
-                if (ctx->cells.at(cell.first)->belStrength > STRENGTH_STRONG)
+                if (ci->belStrength > STRENGTH_STRONG)
                     continue;
-                occupancy.at(cell.second.x).at(cell.second.y).at(type_index.at(ctx->cells.at(cell.first)->type))++;
+                occupancy.at(cl.x).at(cl.y).at(type_index.at(ci->type))++;
                 // Compute ultimate extent of each chain root
-                if (p->chain_root.count(cell.first)) {
-                    set_chain_ext(p->chain_root.at(cell.first)->name, cell.second.x, cell.second.y);
-                } else if (!ctx->cells.at(cell.first)->constr_children.empty()) {
-                    set_chain_ext(cell.first, cell.second.x, cell.second.y);
+                if (p->chain_root.at(ci->udata) != nullptr) {
+                    set_chain_ext(p->chain_root.at(ci->udata)->name, cl.x, cl.y);
+                } else if (!ci->constr_children.empty()) {
+                    set_chain_ext(ci->name, cl.x, cl.y);
                 }
             }
-            for (auto &cell : p->cell_locs) {
-                if (!beltype.count(ctx->cells.at(cell.first)->type))
+            for (auto ci : p->cells) {
+                auto &cl = p->cell_locs.at(ci->udata);
+                if (!cl.valid || !beltype.count(ci->type))
                     continue;
                 // Transfer chain extents to the actual chaines structure
                 ChainExtent *ce = nullptr;
-                if (p->chain_root.count(cell.first))
-                    ce = &(cell_extents.at(p->chain_root.at(cell.first)->name));
-                else if (!ctx->cells.at(cell.first)->constr_children.empty())
-                    ce = &(cell_extents.at(cell.first));
+                if (p->chain_root.at(ci->udata) != nullptr)
+                    ce = &(cell_extents.at(p->chain_root.at(ci->udata)->name));
+                else if (!ci->constr_children.empty())
+                    ce = &(cell_extents.at(ci->name));
                 if (ce) {
-                    auto &lce = chaines.at(cell.second.x).at(cell.second.y);
+                    auto &lce = chaines.at(cl.x).at(cl.y);
                     lce.x0 = std::min(lce.x0, ce->x0);
                     lce.y0 = std::min(lce.y0, ce->y0);
                     lce.x1 = std::max(lce.x1, ce->x1);
                     lce.y1 = std::max(lce.y1, ce->y1);
                 }
             }
-            for (auto cell : p->solve_cells) {
+            for (auto cell : p->solve.solve_cells) {
                 if (!beltype.count(cell->type))
                     continue;
-                cells_at_location.at(p->cell_locs.at(cell->name).x).at(p->cell_locs.at(cell->name).y).push_back(cell);
+                cells_at_location.at(p->cell_locs.at(cell->udata).x).at(p->cell_locs.at(cell->udata).y).push_back(cell);
             }
         }
         void merge_regions(SpreaderRegion &merged, SpreaderRegion &mergee)
@@ -1444,11 +2402,23 @@ class HeAPPlacer
         // Implementation of the recursive cut-based spreading as described in the HeAP paper
         // Note we use "left" to mean "-x/-y" depending on dir and "right" to mean "+x/+y" depending on dir
 
-        std::vector<CellInfo *> cut_cells;
+        // Add a region made by a cut, returning its id
+        int add_region(SpreaderRegion reg)
+        {
+            reg.id = int(regions.size());
+            for (int x = reg.x0; x <= reg.x1; x++)
+                for (int y = reg.y0; y <= reg.y1; y++)
+                    groups.at(x).at(y) = reg.id;
+            regions.push_back(reg);
+            return reg.id;
+        }
 
-        boost::optional<std::pair<int, int>> cut_region(SpreaderRegion &r, bool dir)
+        // Cut a region in two, spreading its cells into the two halves, which are returned rather than added to
+        // regions. This only touches the cells and locations inside the region, so disjoint regions can be cut in
+        // parallel
+        boost::optional<std::pair<SpreaderRegion, SpreaderRegion>> cut_region(const SpreaderRegion &r, bool dir)
         {
-            cut_cells.clear();
+            std::vector<CellInfo *> cut_cells;
             auto &cal = cells_at_location;
             int total_cells = 0, total_bels = 0;
             for (int x = r.x0; x <= r.x1; x++) {
@@ -1459,11 +2429,11 @@ class HeAPPlacer
                 }
             }
             for (auto &cell : cut_cells) {
-                total_cells += p->chain_size.count(cell->name) ? p->chain_size.at(cell->name) : 1;
+                total_cells += p->chain_size.at(cell->udata);
             }
             std::sort(cut_cells.begin(), cut_cells.end(), [&](const CellInfo *a, const CellInfo *b) {
-                return dir ? (p->cell_locs.at(a->name).rawy < p->cell_locs.at(b->name).rawy)
-                           : (p->cell_locs.at(a->name).rawx < p->cell_locs.at(b->name).rawx);
+                return dir ? (p->cell_locs.at(a->udata).rawy < p->cell_locs.at(b->udata).rawy)
+                           : (p->cell_locs.at(a->udata).rawx < p->cell_locs.at(b->udata).rawx);
             });
 
             if (cut_cells.size() < 2)
@@ -1472,7 +2442,7 @@ class HeAPPlacer
             int pivot_cells = 0;
             int pivot = 0;
             for (auto &cell : cut_cells) {
-                pivot_cells += p->chain_size.count(cell->name) ? p->chain_size.at(cell->name) : 1;
+                pivot_cells += p->chain_size.at(cell->udata);
                 if (pivot_cells >= total_cells / 2)
                     break;
                 pivot++;
@@ -1537,10 +2507,10 @@ class HeAPPlacer
             std::vector<int> left_bels_v(beltype.size(), 0), right_bels_v(r.bels);
             for (int i = 0; i <= pivot; i++)
                 left_cells_v.at(type_index.at(cut_cells.at(i)->type)) +=
-                        p->chain_size.count(cut_cells.at(i)->name) ? p->chain_size.at(cut_cells.at(i)->name) : 1;
+                        p->chain_size.at(cut_cells.at(i)->udata);
             for (int i = pivot + 1; i < int(cut_cells.size()); i++)
                 right_cells_v.at(type_index.at(cut_cells.at(i)->type)) +=
-                        p->chain_size.count(cut_cells.at(i)->name) ? p->chain_size.at(cut_cells.at(i)->name) : 1;
+                        p->chain_size.at(cut_cells.at(i)->udata);
 
             int best_tgt_cut = -1;
             double best_deltaU = std::numeric_limits<double>::max();
@@ -1606,14 +2576,14 @@ class HeAPPlacer
             };
             while (pivot > 0 && is_part_overutil(false)) {
                 auto &move_cell = cut_cells.at(pivot);
-                int size = p->chain_size.count(move_cell->name) ? p->chain_size.at(move_cell->name) : 1;
+                int size = p->chain_size.at(move_cell->udata);
                 left_cells_v.at(type_index.at(cut_cells.at(pivot)->type)) -= size;
                 right_cells_v.at(type_index.at(cut_cells.at(pivot)->type)) += size;
                 pivot--;
             }
             while (pivot < int(cut_cells.size()) - 1 && is_part_overutil(true)) {
                 auto &move_cell = cut_cells.at(pivot + 1);
-                int size = p->chain_size.count(move_cell->name) ? p->chain_size.at(move_cell->name) : 1;
+                int size = p->chain_size.at(move_cell->udata);
                 left_cells_v.at(type_index.at(cut_cells.at(pivot)->type)) += size;
                 right_cells_v.at(type_index.at(cut_cells.at(pivot)->type)) -= size;
                 pivot++;
@@ -1624,8 +2594,8 @@ class HeAPPlacer
                 int N = cells_end - cells_start;
                 if (N <= 2) {
                     for (int i = cells_start; i < cells_end; i++) {
-                        auto &pos = dir ? p->cell_locs.at(cut_cells.at(i)->name).rawy
-                                        : p->cell_locs.at(cut_cells.at(i)->name).rawx;
+                        auto &pos = dir ? p->cell_locs.at(cut_cells.at(i)->udata).rawy
+                                        : p->cell_locs.at(cut_cells.at(i)->udata).rawx;
                         pos = area_l + i * ((area_r - area_l) / N);
                     }
                     return;
@@ -1639,10 +2609,10 @@ class HeAPPlacer
                 bin_bounds.emplace_back(cells_end, area_r + 0.99);
                 for (int i = 0; i < K; i++) {
                     auto &bl = bin_bounds.at(i), br = bin_bounds.at(i + 1);
-                    double orig_left = dir ? p->cell_locs.at(cut_cells.at(bl.first)->name).rawy
-                                           : p->cell_locs.at(cut_cells.at(bl.first)->name).rawx;
-                    double orig_right = dir ? p->cell_locs.at(cut_cells.at(br.first - 1)->name).rawy
-                                            : p->cell_locs.at(cut_cells.at(br.first - 1)->name).rawx;
+                    double orig_left = dir ? p->cell_locs.at(cut_cells.at(bl.first)->udata).rawy
+                                           : p->cell_locs.at(cut_cells.at(bl.first)->udata).rawx;
+                    double orig_right = dir ? p->cell_locs.at(cut_cells.at(br.first - 1)->udata).rawy
+                                            : p->cell_locs.at(cut_cells.at(br.first - 1)->udata).rawx;
                     double m = (br.second - bl.second) / std::max(0.00001, orig_right - orig_left);
                     for (int j = bl.first; j < br.first; j++) {
                         Region *cr = cut_cells.at(j)->region;
@@ -1651,13 +2621,13 @@ class HeAPPlacer
                             double brsc = p->limit_to_reg(cr, br.second, dir);
                             double blsc = p->limit_to_reg(cr, bl.second, dir);
                             double mr = (brsc - blsc) / std::max(0.00001, orig_right - orig_left);
-                            auto &pos = dir ? p->cell_locs.at(cut_cells.at(j)->name).rawy
-                                            : p->cell_locs.at(cut_cells.at(j)->name).rawx;
+                            auto &pos = dir ? p->cell_locs.at(cut_cells.at(j)->udata).rawy
+                                            : p->cell_locs.at(cut_cells.at(j)->udata).rawx;
                             NPNR_ASSERT(pos >= orig_left && pos <= orig_right);
                             pos = blsc + mr * (pos - orig_left);
                         } else {
-                            auto &pos = dir ? p->cell_locs.at(cut_cells.at(j)->name).rawy
-                                            : p->cell_locs.at(cut_cells.at(j)->name).rawx;
+                            auto &pos = dir ? p->cell_locs.at(cut_cells.at(j)->udata).rawy
+                                            : p->cell_locs.at(cut_cells.at(j)->udata).rawx;
                             NPNR_ASSERT(pos >= orig_left && pos <= orig_right);
                             pos = bl.second + m * (pos - orig_left);
                         }
@@ -1672,35 +2642,27 @@ class HeAPPlacer
                     cells_at_location.at(x).at(y).clear();
                 }
             for (auto cell : cut_cells) {
-                auto &cl = p->cell_locs.at(cell->name);
+                auto &cl = p->cell_locs.at(cell->udata);
                 cl.x = std::min(r.x1, std::max(r.x0, int(cl.rawx)));
                 cl.y = std::min(r.y1, std::max(r.y0, int(cl.rawy)));
                 cells_at_location.at(cl.x).at(cl.y).push_back(cell);
             }
             SpreaderRegion rl, rr;
-            rl.id = int(regions.size());
+            rl.id = -1;
             rl.x0 = r.x0;
             rl.y0 = r.y0;
             rl.x1 = dir ? r.x1 : best_tgt_cut;
             rl.y1 = dir ? best_tgt_cut : r.y1;
             rl.cells = left_cells_v;
             rl.bels = left_bels_v;
-            rr.id = int(regions.size()) + 1;
+            rr.id = -1;
             rr.x0 = dir ? r.x0 : (best_tgt_cut + 1);
             rr.y0 = dir ? (best_tgt_cut + 1) : r.y0;
             rr.x1 = r.x1;
             rr.y1 = r.y1;
             rr.cells = right_cells_v;
             rr.bels = right_bels_v;
-            regions.push_back(rl);
-            regions.push_back(rr);
-            for (int x = rl.x0; x <= rl.x1; x++)
-                for (int y = rl.y0; y <= rl.y1; y++)
-                    groups.at(x).at(y) = rl.id;
-            for (int x = rr.x0; x <= rr.x1; x++)
-                for (int y = rr.y0; y <= rr.y1; y++)
-                    groups.at(x).at(y) = rr.id;
-            return std::make_pair(rl.id, rr.id);
+            return std::make_pair(rl, rr);
         };
     };
     typedef decltype(CellInfo::udata) cell_udata_t;
@@ -1708,7 +2670,71 @@ class HeAPPlacer
 };
 int HeAPPlacer::CutSpreader::seq = 0;
 
-bool placer_heap(Context *ctx, PlacerHeapCfg cfg) { return HeAPPlacer(ctx, cfg).place(); }
+namespace {
+// Run global placement and legalisation with each net model in turn from the same starting point, and report the
+// time taken and wirelength before refinement; so the faster models can be checked against bound2bound
+void compare_net_models(Context *ctx, const PlacerHeapCfg &cfg)
+{
+    struct NetModel
+    {
+        const char *name;
+        int star_fanout, sample_fanout;
+    };
+    int star_fanout = cfg.starFanout > 0 ? cfg.starFanout : 16;
+    int sample_fanout = cfg.netSampleFanout > 0 ? cfg.netSampleFanout : 128;
+    std::vector<NetModel> models = {{"bound2bound", 0, 0},
+                                    {"star", star_fanout, 0},
+                                    {"star+sampled", star_fanout, sample_fanout},
+                                    {"sampled", 0, sample_fanout}};
+
+    std::vector<std::tuple<CellInfo *, BelId, PlaceStrength>> initial;
+    for (auto cell : sorted(ctx->cells))
+        initial.emplace_back(cell.second, cell.second->bel, cell.second->belStrength);
+    uint64_t rngstate = ctx->rngstate;
+
+    std::vector<std::pair<wirelen_t, double>> results;
+    for (auto &model : models) {
+        log_info("Running HeAP with the %s net model...\n", model.name);
+        PlacerHeapCfg model_cfg = cfg;
+        model_cfg.starFanout = model.star_fanout;
+        model_cfg.netSampleFanout = model.sample_fanout;
+        auto startt = std::chrono::high_resolution_clock::now();
+        HeAPPlacer placer(ctx, model_cfg);
+        placer.refine = false;
+        placer.place();
+        auto endt = std::chrono::high_resolution_clock::now();
+
+        ctx->lock();
+        wirelen_t wirelen = get_total_hpwl(ctx, ctx->stage_threads("", 0));
+        results.emplace_back(wirelen, std::chrono::duration<double>(endt - startt).count());
+        // Restore the initial placement for the next model
+        for (auto &cell : ctx->cells)
+            if (cell.second->bel != BelId())
+                ctx->unbindBel(cell.second->bel);
+        for (auto &init : initial)
+            if (std::get<1>(init) != BelId())
+                ctx->bindBel(std::get<1>(init), std::get<0>(init), std::get<2>(init));
+        ctx->rngstate = rngstate;
+        ctx->unlock();
+    }
+
+    log_info("HeAP net model comparison (before refinement):\n");
+    for (size_t i = 0; i < models.size(); i++)
+        log_info("    %-12s (star fanout %4d, sample fanout %4d): wirelength %8lld (%+.1f%%), time %.02fs\n",
+                 models.at(i).name, models.at(i).star_fanout, models.at(i).sample_fanout,
+                 (long long)results.at(i).first,
+                 results.front().first == 0 ? 0.0 : 100.0 * (results.at(i).first - results.front().first) /
+                                                            double(results.front().first),
+                 results.at(i).second);
+}
+} // namespace
+
+bool placer_heap(Context *ctx, PlacerHeapCfg cfg)
+{
+    if (cfg.compareNetModels)
+        compare_net_models(ctx, cfg);
+    return HeAPPlacer(ctx, cfg).place();
+}
 
 PlacerHeapCfg::PlacerHeapCfg(Context *ctx)
 {
@@ -1716,8 +2742,43 @@ PlacerHeapCfg::PlacerHeapCfg(Context *ctx)
     beta = ctx->setting<float>("placerHeap/beta", 0.9);
     criticalityExponent = ctx->setting<int>("placerHeap/criticalityExponent", 2);
     timingWeight = ctx->setting<int>("placerHeap/timingWeight", 10);
+    congestionWeight = ctx->setting<float>("placerHeap/congestionWeight", 0);
     timing_driven = ctx->setting<bool>("timing_driven");
     solverTolerance = 1e-5;
+    reuseSolverPattern = ctx->setting<bool>("placerHeap/reuseSolverPattern", true);
+    std::string precond = "jacobi";
+    if (ctx->settings.count(ctx->id("placerHeap/solverPreconditioner")))
+        precond = ctx->settings.at(ctx->id("placerHeap/solverPreconditioner")).as_string();
+    if (precond == "none")
+        solverPreconditioner = PRECOND_NONE;
+    else if (precond == "jacobi")
+        solverPreconditioner = PRECOND_JACOBI;
+    else if (precond == "ichol")
+        solverPreconditioner = PRECOND_ICHOL;
+    else
+        log_error("Unknown HeAP solver preconditioner '%s' (available options: none, jacobi, ichol)\n",
+                  precond.c_str());
+    solverThreads = ctx->setting<int>("placerHeap/solverThreads", 1);
+    parallelAxes = ctx->stage_threads("placerHeap", 2) > 1;
+    spreadThreads = ctx->setting<int>("placerHeap/spreadThreads", ctx->stage_threads("placerHeap", 1));
+    runThreads = ctx->setting<int>("placerHeap/runThreads", ctx->stage_threads("placerHeap", 1));
+    legaliseThreads = ctx->setting<int>("placerHeap/legaliseThreads", 1);
+    starFanout = ctx->setting<int>("placerHeap/starFanout", 0);
+    netSampleFanout = ctx->setting<int>("placerHeap/netSampleFanout", 0);
+    compareNetModels = ctx->setting<bool>("placerHeap/compareNetModels", false);
+    convergenceRatio = ctx->setting<float>("placerHeap/convergenceRatio", 0.8);
+    maxStalledIters = ctx->setting<int>("placerHeap/maxStalledIters", 5);
+    minImprovement = ctx->setting<float>("placerHeap/minImprovement", 0);
+    timeBudget = ctx->setting<float>("placerHeap/timeBudget", 0);
+    guideStartIter = ctx->setting<int>("placerHeap/guideStartIter", 5);
+    clusterMinCells = ctx->setting<int>("placerHeap/clusterMinCells", 0);
+    clusterSize = ctx->setting<int>("placerHeap/clusterSize", 8);
+    incrementalTiming = ctx->setting<bool>("placerHeap/incrementalTiming", false);
+    timingMoveThreshold = ctx->setting<int>("placerHeap/timingMoveThreshold", 0);
+    reserveMacros = ctx->setting<bool>("placerHeap/reserveMacros", true);
+    connectivitySeed = ctx->setting<bool>("placerHeap/connectivitySeed", false);
+    useGpu = ctx->setting<bool>("placerHeap/gpu", false);
+    gpuMinRows = ctx->setting<int>("placerHeap/gpuMinRows", 20000);
     placeAllAtOnce = false;
 
     hpwl_scale_x = 1;
@@ -38,8 +38,62 @@ struct PlacerHeapCfg
     float alpha, beta;
     float criticalityExponent;
     float timingWeight;
+    float congestionWeight;
     bool timing_driven;
     float solverTolerance;
+    // Keep the sparsity pattern of the equation system between the solver iterations of each run
+    bool reuseSolverPattern;
+    // Preconditioner for the conjugate gradient solver
+    enum Preconditioner
+    {
+        PRECOND_NONE,
+        PRECOND_JACOBI,
+        PRECOND_ICHOL
+    } solverPreconditioner;
+    // Solve the x and y axes at the same time, on two threads
+    bool parallelAxes;
+    // Threads for the matrix-vector products of each solve, needs an OpenMP build
+    int solverThreads;
+    // Solve systems of at least gpuMinRows rows, and evaluate the wirelength of designs with at least that many cells
+    // to place, on a GPU; needs an OpenCL build (USE_OPENCL)
+    bool useGpu;
+    int gpuMinRows;
+    // Threads for cutting disjoint regions during spreading; the result is the same for any number
+    int spreadThreads;
+    // Threads for solving consecutive heap runs (of single cell types) that share no nets at once; the result is the
+    // same as solving them one at a time, unless incrementalTiming is set
+    int runThreads;
+    // Threads for strict legalisation of cells without placement constraints, which changes the result compared to
+    // the serial legaliser (but not between thread counts above 1)
+    int legaliseThreads;
+    // Nets with at least this many users use a star model instead of bound2bound, if non-zero
+    int starFanout;
+    // Nets with more than this many users only use a sample of that many users in the equations, if non-zero
+    int netSampleFanout;
+    // Before placing, compare the wirelength and runtime of the available net models
+    bool compareNetModels;
+    // The analytical placer stops when the solved wirelength is above convergenceRatio times the legal wirelength,
+    // after maxStalledIters iterations without the legal wirelength improving by at least minImprovement (as a
+    // fraction), or once timeBudget seconds have passed if non-zero
+    float convergenceRatio;
+    int maxStalledIters;
+    float minImprovement;
+    float timeBudget;
+    // When nearly all cells are seeded from the placement guide, the initial placement is skipped and the main loop
+    // starts as if at this iteration, so that the cells are anchored firmly to the guide and it converges sooner
+    int guideStartIter;
+    // Designs with at least clusterMinCells movable cells, if non-zero, are first placed with clusters of up to
+    // clusterSize connected cells moving together
+    int clusterMinCells;
+    int clusterSize;
+    // Use incremental timing analysis, refreshing criticalities after every run rather than every iteration. Cells
+    // that moved by less than timingMoveThreshold since their delays were last updated are not updated
+    bool incrementalTiming;
+    int timingMoveThreshold;
+    // Find space for each macro (such as a carry chain) before strict legalisation, rather than by random search
+    bool reserveMacros;
+    // Seed the cells to be solved near the fixed cells they connect to, breadth first, rather than at random bels
+    bool connectivitySeed;
     bool placeAllAtOnce;
 
     int hpwl_scale_x, hpwl_scale_y;
@@ -0,0 +1,146 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+
+#include "preflight.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "log.h"
+#include "util.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+std::function<int(const Context *, const CellInfo *)> preflight_cell_types(std::unordered_map<IdString, int> units)
+{
+    return [units](const Context *, const CellInfo *ci) { return get_or_default(units, ci->type, 0); };
+}
+
+// The number of top level ports that need an IO of their own, rather than being connected to a pad cell
+static int count_top_ports(Context *ctx, const PreflightCfg &cfg)
+{
+    std::unordered_set<IdString> buf_types = {ctx->id("$nextpnr_ibuf"), ctx->id("$nextpnr_obuf"),
+                                              ctx->id("$nextpnr_iobuf")};
+    std::unordered_set<IdString> pad_types(cfg.pad_cell_types.begin(), cfg.pad_cell_types.end());
+    int count = 0;
+    for (auto &cell : ctx->cells) {
+        CellInfo *ci = cell.second.get();
+        if (!buf_types.count(ci->type))
+            continue;
+        bool to_pad = false;
+        for (auto &port : ci->ports) {
+            NetInfo *net = port.second.net;
+            if (net == nullptr)
+                continue;
+            if (net->driver.cell != nullptr && pad_types.count(net->driver.cell->type))
+                to_pad = true;
+            for (auto &usr : net->users)
+                if (pad_types.count(usr.cell->type))
+                    to_pad = true;
+        }
+        if (!to_pad)
+            count++;
+    }
+    return count;
+}
+
+bool preflight_check(Context *ctx, const PreflightCfg &cfg)
+{
+    log_break();
+    log_info("Running pre-flight checks..\n");
+    std::vector<std::string> errors;
+
+    std::unordered_map<IdString, int> bel_counts;
+    for (auto bel : ctx->getBels())
+        bel_counts[ctx->getBelType(bel)]++;
+
+    int top_ports = count_top_ports(ctx, cfg);
+    log_info("Estimated resource use:\n");
+    for (auto &res : cfg.resources) {
+        std::vector<int> demand(res.groups.size(), res.top_ports ? top_ports : 0);
+        for (auto &cell : ctx->cells)
+            for (size_t i = 0; i < res.groups.size(); i++)
+                demand.at(i) += res.groups.at(i)(ctx, cell.second.get());
+        int needed = 0;
+        for (int d : demand)
+            needed = std::max(needed, (d + res.units_per_bel - 1) / res.units_per_bel);
+        int available = 0;
+        for (auto type : res.bel_types)
+            available += get_or_default(bel_counts, type, 0);
+        log_info("\t%20s: %5d/%5d %5d%%\n", res.name.c_str(), needed, available,
+                 available ? int(100 * int64_t(needed) / available) : 0);
+        if (needed > available)
+            errors.push_back(stringf("design needs at least %d %s but the device has %d", needed, res.name.c_str(),
+                                     available));
+    }
+
+    // Constraints to a bel or a pin must name something that exists, and only one cell may use each
+    const IdString bel_attr = ctx->id("BEL");
+    std::vector<IdString> loc_attrs = cfg.loc_attrs;
+    loc_attrs.push_back(bel_attr);
+    std::unordered_map<IdString, std::unordered_map<std::string, IdString>> loc_users;
+    for (auto cell : sorted(ctx->cells)) {
+        CellInfo *ci = cell.second;
+        for (auto attr : loc_attrs) {
+            auto loc = ci->attrs.find(attr);
+            if (loc == ci->attrs.end() || !loc->second.is_string)
+                continue;
+            const std::string &value = loc->second.as_string();
+            if (attr == bel_attr && cfg.check_bel_names && ctx->getBelByName(ctx->id(value)) == BelId())
+                errors.push_back(stringf("cell '%s' is constrained to bel '%s', which does not exist",
+                                         ctx->nameOf(ci), value.c_str()));
+            auto ins = loc_users[attr].emplace(value, ci->name);
+            if (!ins.second)
+                errors.push_back(stringf("cells '%s' and '%s' are both constrained to %s '%s'",
+                                         ins.first->second.c_str(ctx), ctx->nameOf(ci), attr.c_str(ctx),
+                                         value.c_str()));
+        }
+        if (ci->region != nullptr && ci->region->constr_bels && ci->region->bels.empty())
+            errors.push_back(stringf("cell '%s' is constrained to region '%s', which contains no bels",
+                                     ctx->nameOf(ci), ci->region->name.c_str(ctx)));
+    }
+
+    // More clocks than global networks is not fatal, as clocks can use general routing, but is worth knowing about
+    if (!cfg.global_bel_types.empty()) {
+        std::unordered_set<IdString> clock_ports(cfg.clock_ports.begin(), cfg.clock_ports.end());
+        std::unordered_set<const NetInfo *> clocks;
+        for (auto &cell : ctx->cells)
+            for (auto &port : cell.second->ports)
+                if (port.second.net != nullptr && port.second.type == PORT_IN && clock_ports.count(port.first))
+                    clocks.insert(port.second.net);
+        int globals = 0;
+        for (auto type : cfg.global_bel_types)
+            globals += get_or_default(bel_counts, type, 0);
+        log_info("\t%20s: %5d/%5d\n", "clocks", int(clocks.size()), globals);
+        if (int(clocks.size()) > globals)
+            log_warning("The design has %d clocks but the device only has %d global networks.\n", int(clocks.size()),
+                        globals);
+    }
+
+    if (errors.empty()) {
+        log_info("Pre-flight checks passed.\n");
+        return true;
+    }
+    log_info("Pre-flight checks found %d problems that stop the design from fitting:\n", int(errors.size()));
+    for (auto &err : errors)
+        log_info("    %s\n", err.c_str());
+    return false;
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,77 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+
+#ifndef PREFLIGHT_H
+#define PREFLIGHT_H
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// What an arch knows about its resources before packing, for preflight_check
+struct PreflightCfg
+{
+    // A kind of bel, with the demand for it estimated from the unpacked cells
+    struct Resource
+    {
+        Resource(const std::string &name, const std::vector<IdString> &bel_types, int units_per_bel = 1)
+                : name(name), bel_types(bel_types), units_per_bel(units_per_bel)
+        {
+        }
+
+        std::string name;
+        std::vector<IdString> bel_types;
+        // How many units of each group one bel holds, e.g. the number of LUTs in a slice
+        int units_per_bel;
+        // Each group gives the units a cell needs (0 if it is not part of the group). The groups share the bels, like
+        // the LUTs and FFs of a logic cell, so the demand is that of the largest group: a lower bound on what packing
+        // will need
+        std::vector<std::function<int(const Context *, const CellInfo *)>> groups;
+        // Whether each top level port not connected to one of pad_cell_types also needs a unit of every group
+        bool top_ports = false;
+    };
+    std::vector<Resource> resources;
+    // Cells that top level ports connect to directly, such as IO buffers and dedicated pads, whose ports do not need
+    // a top_ports resource of their own
+    std::vector<IdString> pad_cell_types;
+    // Attributes holding a package pin or site, which no two cells can share
+    std::vector<IdString> loc_attrs;
+    // Whether to check that BEL attributes name existing bels; only for arches whose getBelByName copes with any name
+    bool check_bel_names = false;
+    // Global clock buffer bels, and the clock input ports of cells, to warn about more clocks than global networks
+    std::vector<IdString> global_bel_types;
+    std::vector<IdString> clock_ports;
+};
+
+// A resource group counting the cells of some types, each needing the given number of units
+std::function<int(const Context *, const CellInfo *)> preflight_cell_types(std::unordered_map<IdString, int> units);
+
+// Check, straight after the design is loaded, that it can fit the device: the estimated demand for each resource
+// against the number of bels, that BEL and location constraints are valid and not shared, and that constrained
+// regions are not empty. Logs a report and returns false if the design cannot fit
+bool preflight_check(Context *ctx, const PreflightCfg &cfg);
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -0,0 +1,278 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "json11.hpp"
+#include "log.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+NEXTPNR_NAMESPACE_BEGIN
+
+std::atomic<bool> profiler_enabled(false);
+
+namespace {
+
+typedef std::chrono::steady_clock profile_clock;
+
+struct ProfileEvent
+{
+    const char *name;
+    int64_t start_us, end_us;
+    int64_t peak_kib;
+    // Index of the enclosing zone on the same thread, or -1
+    int parent;
+};
+
+// Zones recorded by one thread. Only the owning thread appends to it, so recording doesn't need a lock; threads
+// register themselves once, and their profiles outlive them so that worker threads can be reported afterwards.
+struct ThreadProfile
+{
+    int tid;
+    std::vector<ProfileEvent> events;
+    int open = -1;
+};
+
+std::mutex profile_mutex;
+std::vector<std::unique_ptr<ThreadProfile>> thread_profiles;
+profile_clock::time_point profile_epoch;
+thread_local ThreadProfile *this_thread_profile = nullptr;
+
+int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(profile_clock::now() - profile_epoch).count();
+}
+
+ThreadProfile *get_thread_profile()
+{
+    if (this_thread_profile == nullptr) {
+        std::lock_guard<std::mutex> lock(profile_mutex);
+        thread_profiles.emplace_back(new ThreadProfile());
+        thread_profiles.back()->tid = int(thread_profiles.size()) - 1;
+        this_thread_profile = thread_profiles.back().get();
+    }
+    return this_thread_profile;
+}
+
+} // namespace
+
+int64_t peak_rss_kib()
+{
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#ifdef __APPLE__
+    return int64_t(usage.ru_maxrss) / 1024;
+#else
+    return int64_t(usage.ru_maxrss);
+#endif
+#else
+    return -1;
+#endif
+}
+
+namespace {
+std::mutex memory_mutex;
+std::vector<MemoryUsage> memory_subsystems;
+} // namespace
+
+void memory_track(const char *subsystem, int64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    auto found = std::find_if(memory_subsystems.begin(), memory_subsystems.end(),
+                              [&](const MemoryUsage &m) { return std::strcmp(m.subsystem, subsystem) == 0; });
+    if (found == memory_subsystems.end()) {
+        memory_subsystems.push_back(MemoryUsage{subsystem, 0, 0});
+        found = memory_subsystems.end() - 1;
+    }
+    found->current = bytes;
+    found->peak = std::max(found->peak, bytes);
+}
+
+std::vector<MemoryUsage> memory_usage()
+{
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    return memory_subsystems;
+}
+
+void memory_summary(const char *stage)
+{
+    int64_t peak = peak_rss_kib();
+    if (peak >= 0)
+        log_info("Peak memory after %s: %.01f MiB\n", stage, peak / 1024.0);
+    else
+        log_info("Memory after %s:\n", stage);
+    for (auto &m : memory_usage())
+        log_info("    %-24s %10.01f MiB (peak %.01f MiB)\n", m.subsystem, m.current / 1048576.0, m.peak / 1048576.0);
+}
+
+namespace {
+std::vector<Throughput> throughput_items;
+} // namespace
+
+void throughput_track(const char *name, int64_t count, double seconds)
+{
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    auto found = std::find_if(throughput_items.begin(), throughput_items.end(),
+                              [&](const Throughput &t) { return std::strcmp(t.name, name) == 0; });
+    if (found == throughput_items.end()) {
+        throughput_items.push_back(Throughput{name, 0, 0});
+        found = throughput_items.end() - 1;
+    }
+    found->count += count;
+    found->seconds += seconds;
+}
+
+std::vector<Throughput> throughput()
+{
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    return throughput_items;
+}
+
+void profile_enable()
+{
+    if (profiler_enabled)
+        return;
+    profile_epoch = profile_clock::now();
+    profiler_enabled = true;
+}
+
+void profile_begin(const char *name)
+{
+    ThreadProfile *tp = get_thread_profile();
+    tp->events.push_back(ProfileEvent{name, now_us(), -1, -1, tp->open});
+    tp->open = int(tp->events.size()) - 1;
+}
+
+void profile_end()
+{
+    ThreadProfile *tp = get_thread_profile();
+    NPNR_ASSERT(tp->open != -1);
+    ProfileEvent &ev = tp->events.at(tp->open);
+    ev.end_us = now_us();
+    ev.peak_kib = peak_rss_kib();
+    tp->open = ev.parent;
+}
+
+void profile_summary()
+{
+    // Merge the zones of all threads into one tree, keyed by the path of zone names from the root
+    struct SummaryNode
+    {
+        const char *name;
+        int depth;
+        int calls = 0;
+        int64_t total_us = 0, child_us = 0, peak_kib = -1;
+        std::vector<int> children;
+    };
+    std::vector<SummaryNode> nodes(1);
+    nodes.at(0).name = "";
+    nodes.at(0).depth = -1;
+
+    auto get_child = [&](int parent, const char *name) {
+        for (int c : nodes.at(parent).children)
+            if (std::strcmp(nodes.at(c).name, name) == 0)
+                return c;
+        int idx = int(nodes.size());
+        nodes.emplace_back();
+        nodes.back().name = name;
+        nodes.back().depth = nodes.at(parent).depth + 1;
+        nodes.at(parent).children.push_back(idx);
+        return idx;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(profile_mutex);
+        for (auto &tp : thread_profiles) {
+            // Events are stored in the order they were opened, so parents always come before their children
+            std::vector<int> event_node(tp->events.size());
+            for (size_t i = 0; i < tp->events.size(); i++) {
+                const ProfileEvent &ev = tp->events.at(i);
+                int parent_node = (ev.parent == -1) ? 0 : event_node.at(ev.parent);
+                int node = get_child(parent_node, ev.name);
+                event_node.at(i) = node;
+                if (ev.end_us < 0)
+                    continue;
+                auto &n = nodes.at(node);
+                n.calls++;
+                n.total_us += ev.end_us - ev.start_us;
+                n.peak_kib = std::max(n.peak_kib, ev.peak_kib);
+                if (parent_node != 0)
+                    nodes.at(parent_node).child_us += ev.end_us - ev.start_us;
+            }
+        }
+    }
+
+    log_break();
+    log_info("Profile summary:\n");
+    log_info("  %-40s %8s %10s %10s %10s\n", "zone", "calls", "total (s)", "self (s)", "peak (MiB)");
+    std::vector<int> stack(nodes.at(0).children.rbegin(), nodes.at(0).children.rend());
+    while (!stack.empty()) {
+        auto &n = nodes.at(stack.back());
+        stack.pop_back();
+        std::string label = std::string(2 * n.depth, ' ') + n.name;
+        log_info("  %-40s %8d %10.02f %10.02f %10.01f\n", label.c_str(), n.calls, n.total_us / 1e6,
+                 (n.total_us - n.child_us) / 1e6, n.peak_kib / 1024.0);
+        stack.insert(stack.end(), n.children.rbegin(), n.children.rend());
+    }
+    int64_t peak = peak_rss_kib();
+    if (peak >= 0)
+        log_info("Peak memory usage: %.01f MiB\n", peak / 1024.0);
+}
+
+bool profile_write_trace(const std::string &filename)
+{
+    std::ofstream f(filename);
+    if (!f)
+        return false;
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    f << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    auto sep = [&]() {
+        f << (first ? "\n" : ",\n");
+        first = false;
+    };
+    for (auto &tp : thread_profiles) {
+        sep();
+        f << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << tp->tid
+          << ", \"args\": {\"name\": \"" << (tp->tid == 0 ? "main" : "worker") << " " << tp->tid << "\"}}";
+        for (auto &ev : tp->events) {
+            if (ev.end_us < 0)
+                continue;
+            sep();
+            f << "{\"name\": " << json11::Json(ev.name).dump() << ", \"ph\": \"X\", \"pid\": 0, \"tid\": " << tp->tid
+              << ", \"ts\": " << ev.start_us << ", \"dur\": " << (ev.end_us - ev.start_us)
+              << ", \"args\": {\"peak_rss_kib\": " << ev.peak_kib << "}}";
+        }
+    }
+    f << "\n]}\n";
+    return bool(f);
+}
+
+NEXTPNR_NAMESPACE_END
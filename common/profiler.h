@@ -0,0 +1,106 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Scoped timers for the phases of a run. Zones nest per thread, and are only recorded once profiling has been enabled
+// (--profile); otherwise a zone costs a single relaxed load. Zone names must be string literals, as only the pointer
+// is kept.
+extern std::atomic<bool> profiler_enabled;
+
+void profile_enable();
+void profile_begin(const char *name);
+void profile_end();
+
+// Print the time, call count and peak memory of every zone, aggregated over its position in the zone hierarchy.
+// Should only be called once any worker threads have finished.
+void profile_summary();
+// Write all recorded zones in the Chrome trace event format (chrome://tracing, Perfetto)
+bool profile_write_trace(const std::string &filename);
+
+// Peak resident set size of the process in KiB, or -1 if unknown
+int64_t peak_rss_kib();
+
+// Estimated memory held by the major data structures, by subsystem, so that a run that uses too much memory shows what
+// for. Subsystems set their current estimate as their structures are built and freed, and the largest estimate of each
+// is kept. Unlike zones, memory is always tracked, as estimates are only made a few times per stage. Subsystem names
+// must be string literals.
+void memory_track(const char *subsystem, int64_t bytes);
+
+struct MemoryUsage
+{
+    const char *subsystem;
+    int64_t current, peak;
+};
+// Every subsystem tracked so far, in the order they were first tracked
+std::vector<MemoryUsage> memory_usage();
+// Log the peak memory so far and the estimate of every subsystem, after the given stage
+void memory_summary(const char *stage);
+
+// Work done by the inner loops of the placers and routers, as a count of items (moves, nodes, solver iterations) and
+// the time spent on them, summed over all runs of that loop; for comparing throughput between builds. Names must be
+// string literals.
+void throughput_track(const char *name, int64_t count, double seconds);
+
+struct Throughput
+{
+    const char *name;
+    int64_t count;
+    double seconds;
+};
+// Everything tracked so far, in the order it was first tracked
+std::vector<Throughput> throughput();
+
+template <typename T> int64_t memory_of(const std::vector<T> &v) { return int64_t(v.capacity()) * sizeof(T); }
+
+struct ProfileZone
+{
+    explicit ProfileZone(const char *name) : active(profiler_enabled.load(std::memory_order_relaxed))
+    {
+        if (active)
+            profile_begin(name);
+    }
+    ~ProfileZone()
+    {
+        if (active)
+            profile_end();
+    }
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+  private:
+    bool active;
+};
+
+#define NPNR_PROFILE_CONCAT2(a, b) a##b
+#define NPNR_PROFILE_CONCAT(a, b) NPNR_PROFILE_CONCAT2(a, b)
+#define NPNR_PROFILE_ZONE(name) ProfileZone NPNR_PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -83,6 +83,41 @@ template <> struct string_converter<Property>
 
 } // namespace PythonConversion
 
+IntTable placement_table(const Context *ctx)
+{
+    IntTable t;
+    t.columns = {"cell", "bel", "x", "y", "z", "strength"};
+    t.data.reserve(ctx->cells.size() * t.columns.size());
+    for (auto &cell : ctx->cells) {
+        const CellInfo *ci = cell.second.get();
+        Loc loc(-1, -1, -1);
+        if (ci->bel != BelId())
+            loc = ctx->getBelLocation(ci->bel);
+        t.data.insert(t.data.end(), {ci->name.index, (ci->bel != BelId()) ? ctx->getBelName(ci->bel).index : -1,
+                                     loc.x, loc.y, loc.z, int32_t(ci->belStrength)});
+    }
+    return t;
+}
+
+IntTable routing_table(const Context *ctx)
+{
+    IntTable t;
+    t.columns = {"net", "wire", "pip", "strength"};
+    size_t total = 0;
+    for (auto &net : ctx->nets)
+        total += net.second->wires.size();
+    t.data.reserve(total * t.columns.size());
+    for (auto &net : ctx->nets) {
+        const NetInfo *ni = net.second.get();
+        for (auto &w : ni->wires)
+            t.data.insert(t.data.end(),
+                          {ni->name.index, ctx->getWireName(w.first).index,
+                           (w.second.pip != PipId()) ? ctx->getPipName(w.second.pip).index : -1,
+                           int32_t(w.second.strength)});
+    }
+    return t;
+}
+
 PYBIND11_EMBEDDED_MODULE(MODULE_NAME, m)
 {
     py::register_exception_translator([](std::exception_ptr p) {
@@ -139,9 +174,10 @@ PYBIND11_EMBEDDED_MODULE(MODULE_NAME, m)
             .value("STRENGTH_USER", STRENGTH_USER)
             .export_values();
 
-    typedef std::unordered_map<IdString, Property> AttrMap;
-    typedef std::unordered_map<IdString, PortInfo> PortMap;
+    typedef IdStringDict<Property> AttrMap;
+    typedef PortInfoMap PortMap;
     typedef std::unordered_map<IdString, IdString> IdIdMap;
+    typedef IdStringDict<IdString> PinMap;
     typedef std::unordered_map<IdString, std::unique_ptr<Region>> RegionMap;
 
     py::class_<BaseCtx>(m, "BaseCtx");
@@ -167,8 +203,8 @@ PYBIND11_EMBEDDED_MODULE(MODULE_NAME, m)
                       conv_from_str<BelId>>::def_wrap(ci_cls, "bel");
     readwrite_wrapper<CellInfo &, decltype(&CellInfo::belStrength), &CellInfo::belStrength, pass_through<PlaceStrength>,
                       pass_through<PlaceStrength>>::def_wrap(ci_cls, "belStrength");
-    readonly_wrapper<CellInfo &, decltype(&CellInfo::pins), &CellInfo::pins, wrap_context<IdIdMap &>>::def_wrap(ci_cls,
-                                                                                                                "pins");
+    readonly_wrapper<CellInfo &, decltype(&CellInfo::pins), &CellInfo::pins, wrap_context<PinMap &>>::def_wrap(ci_cls,
+                                                                                                               "pins");
 
     fn_wrapper_1a_v<CellInfo &, decltype(&CellInfo::addInput), &CellInfo::addInput, conv_from_str<IdString>>::def_wrap(
             ci_cls, "addInput");
@@ -195,8 +231,7 @@ PYBIND11_EMBEDDED_MODULE(MODULE_NAME, m)
                       pass_through<PortType>>::def_wrap(pi_cls, "type");
 
     typedef std::vector<PortRef> PortRefVector;
-    typedef std::unordered_map<WireId, PipMap> WireMap;
-    typedef std::unordered_set<BelId> BelSet;
+    typedef RoutingMap WireMap;
     typedef std::unordered_set<WireId> WireSet;
 
     auto ni_cls = py::class_<ContextualWrapper<NetInfo &>>(m, "NetInfo");
@@ -235,8 +270,11 @@ PYBIND11_EMBEDDED_MODULE(MODULE_NAME, m)
                       pass_through<bool>>::def_wrap(region_cls, "constr_bels");
     readwrite_wrapper<Region &, decltype(&Region::constr_pips), &Region::constr_pips, pass_through<bool>,
                       pass_through<bool>>::def_wrap(region_cls, "constr_pips");
-    readonly_wrapper<Region &, decltype(&Region::bels), &Region::bels, wrap_context<BelSet &>>::def_wrap(region_cls,
-                                                                                                         "bels");
+    region_cls.def_property_readonly("bels", [](ContextualWrapper<Region &> &r) {
+        py::list bels;
+        r.base.bels.for_each([&](Loc loc) { bels.append(r.ctx->getBelName(r.ctx->getBelByLocation(loc)).str(r.ctx)); });
+        return bels;
+    });
     readonly_wrapper<Region &, decltype(&Region::wires), &Region::wires, wrap_context<WireSet &>>::def_wrap(region_cls,
                                                                                                             "wires");
 
@@ -259,11 +297,68 @@ PYBIND11_EMBEDDED_MODULE(MODULE_NAME, m)
     WRAP_MAP(m, AttrMap, conv_to_str<Property>, "AttrMap");
     WRAP_MAP(m, PortMap, wrap_context<PortInfo &>, "PortMap");
     WRAP_MAP(m, IdIdMap, conv_to_str<IdString>, "IdIdMap");
+    WRAP_MAP(m, PinMap, conv_to_str<IdString>, "PinMap");
     WRAP_MAP(m, WireMap, wrap_context<PipMap &>, "WireMap");
     WRAP_MAP_UPTR(m, RegionMap, "RegionMap");
 
     WRAP_VECTOR(m, PortRefVector, wrap_context<PortRef &>);
 
+    py::class_<IntTable>(m, "IntTable", py::buffer_protocol())
+            .def_buffer([](IntTable &t) {
+                ssize_t cols = t.columns.size(), item = sizeof(int32_t);
+                return py::buffer_info(t.data.data(), item, py::format_descriptor<int32_t>::format(), 2,
+                                       {ssize_t(t.rows()), cols}, {item * cols, item}, true);
+            })
+            .def("__len__", &IntTable::rows)
+            .def_property_readonly("columns", [](const IntTable &t) {
+                py::tuple result(t.columns.size());
+                for (size_t i = 0; i < t.columns.size(); i++)
+                    result[i] = py::str(t.columns.at(i));
+                return result;
+            });
+
+    // Times are in ns, and None for ports without timing
+    auto port_time = [](IncrementalCriticality &t, const std::string &cell, const std::string &port, int which) {
+        Context *ctx = t.getCtx();
+        delay_t times[3];
+        if (!t.port_timing(ctx->cells.at(ctx->id(cell)).get(), ctx->id(port), times[0], times[1], times[2]))
+            return py::object(py::none());
+        return py::object(py::float_(ctx->getDelayNS(times[which])));
+    };
+    py::class_<IncrementalCriticality>(m, "IncrementalTiming")
+            .def("update", [](IncrementalCriticality &t) { t.update(nullptr); })
+            .def("update_nets",
+                 [](IncrementalCriticality &t, const std::vector<std::string> &nets) {
+                     Context *ctx = t.getCtx();
+                     std::vector<NetInfo *> changed;
+                     for (auto &name : nets)
+                         changed.push_back(ctx->nets.at(ctx->id(name)).get());
+                     t.update_nets(nullptr, changed);
+                 })
+            .def("arrival", [port_time](IncrementalCriticality &t, const std::string &cell,
+                                        const std::string &port) { return port_time(t, cell, port, 0); })
+            .def("required", [port_time](IncrementalCriticality &t, const std::string &cell,
+                                         const std::string &port) { return port_time(t, cell, port, 1); })
+            .def("slack", [port_time](IncrementalCriticality &t, const std::string &cell,
+                                      const std::string &port) { return port_time(t, cell, port, 2); })
+            .def("worst_slack",
+                 [](IncrementalCriticality &t) { return t.getCtx()->getDelayNS(t.worst_slack()); })
+            .def("set_arc_delay",
+                 [](IncrementalCriticality &t, const std::string &cell, const std::string &port, float delay) {
+                     Context *ctx = t.getCtx();
+                     t.set_arc_delay(ctx->cells.at(ctx->id(cell)).get(), ctx->id(port),
+                                     ctx->getDelayFromNS(delay).maxDelay());
+                     t.update_nets(nullptr, {});
+                     return ctx->getDelayNS(t.worst_slack());
+                 })
+            .def("clear_arc_delay",
+                 [](IncrementalCriticality &t, const std::string &cell, const std::string &port) {
+                     Context *ctx = t.getCtx();
+                     t.clear_arc_delay(ctx->cells.at(ctx->id(cell)).get(), ctx->id(port));
+                     t.update_nets(nullptr, {});
+                     return ctx->getDelayNS(t.worst_slack());
+                 });
+
     arch_wrap_python(m);
 }
 
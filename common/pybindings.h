@@ -31,11 +31,19 @@
 #include "pywrappers.h"
 
 #include "nextpnr.h"
+#include "timing.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
 namespace py = pybind11;
 
+// Added to the bindings of long-running Context methods (pack, place, route, timing analysis, file writers) to release
+// the GIL while they run, so that other Python threads can make progress meanwhile. Functions bound with it must not
+// touch Python objects. This doesn't make a Context thread-safe: placement and routing hold the Context lock while
+// they run, but a script must still not use one Context from several threads at once. Separate Contexts are
+// independent, and can be worked on in parallel.
+typedef py::call_guard<py::gil_scoped_release> release_gil;
+
 std::string parse_python_exception();
 
 template <typename Tn> void python_export_global(const char *name, Tn &x)
@@ -57,6 +65,22 @@ void deinit_python();
 
 void execute_python_file(const char *python_file);
 
+// A table of integers with one row per netlist object, handed to Python through the buffer protocol so that
+// numpy.asarray() (or memoryview) can use it without creating a Python object per element. Names are stored as
+// IdString indices; ctx.getIdStrings() maps them back to strings.
+struct IntTable
+{
+    std::vector<std::string> columns;
+    std::vector<int32_t> data;
+
+    int rows() const { return columns.empty() ? 0 : int(data.size() / columns.size()); }
+};
+
+// One row per cell: cell, bel, x, y, z, strength. Unplaced cells have a bel and location of -1.
+IntTable placement_table(const Context *ctx);
+// One row per wire bound to a net: net, wire, pip, strength. The source wire of a net has a pip of -1.
+IntTable routing_table(const Context *ctx);
+
 // Defauld IdString conversions
 namespace PythonConversion {
 
@@ -0,0 +1,127 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <ostream>
+#include "json11.hpp"
+#include "nextpnr.h"
+#include "place_common.h"
+#include "profiler.h"
+#include "util.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+using namespace json11;
+
+namespace {
+
+Json path_to_json(const Context *ctx, const TimingResult::Path &path)
+{
+    Json::array ports;
+    for (auto &port : path.ports) {
+        ports.push_back(Json::object{
+                {"net", port.net.str(ctx)},
+                {"cell", port.cell.str(ctx)},
+                {"port", port.port.str(ctx)},
+        });
+    }
+    return Json::object{
+            {"from", path.start},
+            {"to", path.end},
+            {"delay", ctx->getDelayNS(path.delay)},
+            {"slack", ctx->getDelayNS(path.period - path.delay)},
+            {"ports", ports},
+    };
+}
+
+} // namespace
+
+void Context::writeReport(std::ostream &out, const std::vector<std::pair<std::string, double>> &stage_runtimes) const
+{
+    // Same as print_utilisation: cells of each type against bels of that type
+    std::map<IdString, int> used_types;
+    for (auto &cell : cells)
+        used_types[cell.second->type]++;
+    std::map<IdString, int> available_types;
+    for (auto bel : getBels())
+        available_types[getBelType(bel)]++;
+    Json::object utilisation;
+    for (auto &type : available_types) {
+        utilisation[type.first.str(this)] = Json::object{
+                {"used", get_or_default(used_types, type.first, 0)},
+                {"available", type.second},
+        };
+    }
+
+    Json::object runtimes;
+    for (auto &stage : stage_runtimes)
+        runtimes[stage.first] = stage.second;
+
+    // Placement quality as half-perimeter wirelength, and routing quality as the number of wires used
+    wirelen_t hpwl = get_total_hpwl(getCtx(), stage_threads("", 0));
+    int routed_wires = 0;
+    for (auto &net : nets)
+        routed_wires += int(net.second->wires.size());
+
+    // Estimated memory of each subsystem, at the end of the run and at its largest
+    Json::object memory;
+    for (auto &m : memory_usage())
+        memory[m.subsystem] = Json::object{{"current", double(m.current / 1024)}, {"peak", double(m.peak / 1024)}};
+
+    // Throughput of the placer and router inner loops
+    Json::object work;
+    for (auto &t : throughput())
+        work[t.name] = Json::object{{"count", double(t.count)},
+                                    {"seconds", t.seconds},
+                                    {"per_s", t.seconds > 0 ? t.count / t.seconds : 0.0}};
+
+    Json::object report{
+            {"utilisation", utilisation},
+            {"runtime", runtimes},
+            {"peak_rss_kib", double(peak_rss_kib())},
+            {"memory_kib", memory},
+            {"throughput", work},
+            {"wirelength", Json::object{{"hpwl", double(hpwl)}, {"routed_wires", routed_wires}}},
+    };
+
+    if (timing_result.valid) {
+        Json::object fmax;
+        for (auto &clock : timing_result.clock_fmax) {
+            fmax[clock.first.str(this)] = Json::object{
+                    {"achieved", clock.second.first},
+                    {"constraint", clock.second.second},
+            };
+        }
+        Json::array histogram;
+        for (auto &bucket : timing_result.slack_histogram)
+            histogram.push_back(Json::array{bucket.first, int(bucket.second)});
+        Json::array crit_paths, worst_paths;
+        for (auto &path : timing_result.crit_paths)
+            crit_paths.push_back(path_to_json(getCtx(), path));
+        for (auto &path : timing_result.worst_paths)
+            worst_paths.push_back(path_to_json(getCtx(), path));
+        report["fmax"] = fmax;
+        report["slack_histogram_ps"] = histogram;
+        report["critical_paths"] = crit_paths;
+        report["worst_paths"] = worst_paths;
+    }
+
+    out << Json(report).dump() << std::endl;
+}
+
+NEXTPNR_NAMESPACE_END
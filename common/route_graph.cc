@@ -0,0 +1,211 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "route_graph.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include "log.h"
+#include "util.h"
+#include "version.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+const char route_graph_magic[8] = {'N', 'P', 'N', 'R', 'R', 'G', '0', '1'};
+
+void fnv_add(uint64_t &h, const std::string &s)
+{
+    for (char c : s) {
+        h ^= uint8_t(c);
+        h *= 0x100000001b3ULL;
+    }
+    h ^= 0xFF;
+    h *= 0x100000001b3ULL;
+}
+
+template <typename T> void write_vector(std::ostream &out, const std::vector<T> &v)
+{
+    out.write(reinterpret_cast<const char *>(v.data()), sizeof(T) * v.size());
+}
+
+template <typename T> bool read_vector(std::istream &in, std::vector<T> &v, size_t size)
+{
+    v.resize(size);
+    in.read(reinterpret_cast<char *>(v.data()), sizeof(T) * size);
+    return bool(in);
+}
+} // namespace
+
+#ifdef NPNR_DENSE_WIRE_INDEX
+RouteGraph::RouteGraph(Context *ctx) : indexer(ctx)
+#else
+RouteGraph::RouteGraph(Context *ctx)
+#endif
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::string cache_dir = str_or_default(ctx->settings, ctx->id("routeGraph/cacheDir"));
+    std::string filename;
+    uint64_t key = 0;
+    if (!cache_dir.empty() && Arch::routeGraphCacheable) {
+        key = device_key(ctx);
+        filename = stringf("%s/route-graph-%016llx.bin", cache_dir.c_str(), (unsigned long long)key);
+        if (load(ctx, filename, key)) {
+            auto end = std::chrono::high_resolution_clock::now();
+            log_info("Routing graph loaded from '%s' in %.02fs (%d wires, %d pips)\n", filename.c_str(),
+                     std::chrono::duration<float>(end - start).count(), int(wires.size()), int(edges.size()));
+            return;
+        }
+    }
+
+    build(ctx);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    log_info("Routing graph flattened in %.02fs (%d wires, %d pips)\n",
+             std::chrono::duration<float>(end - start).count(), int(wires.size()), int(edges.size()));
+    if (!filename.empty())
+        save(filename, key);
+}
+
+void RouteGraph::build(Context *ctx)
+{
+    for (auto wire : ctx->getWires()) {
+        wires.push_back(wire);
+        wire_delays.push_back(ctx->getWireDelay(wire).maxDelay());
+    }
+    index_wires();
+
+    edge_offsets.reserve(wires.size() + 1);
+    for (auto wire : wires) {
+        edge_offsets.push_back(int(edges.size()));
+        for (auto pip : ctx->getPipsDownhill(wire)) {
+            Edge edge;
+            edge.dst = wire_index(ctx->getPipDstWire(pip));
+            edge.pip = pip;
+            edge.pip_delay = ctx->getPipDelay(pip).maxDelay();
+            edges.push_back(edge);
+        }
+    }
+    edge_offsets.push_back(int(edges.size()));
+}
+
+void RouteGraph::index_wires()
+{
+#ifdef NPNR_DENSE_WIRE_INDEX
+    for (size_t i = 0; i < wires.size(); i++)
+        NPNR_ASSERT(indexer(wires[i]) == int(i));
+#else
+    wire_to_idx.reserve(wires.size());
+    for (size_t i = 0; i < wires.size(); i++)
+        wire_to_idx[wires[i]] = int(i);
+#endif
+}
+
+uint64_t RouteGraph::device_key(Context *ctx)
+{
+    // The chipdb itself is not hashed, as that would read all of it; a rebuilt nextpnr (and so chipdb) gets a
+    // different version string, and load also checks the wires against the device
+    uint64_t key = 0xcbf29ce484222325ULL;
+    fnv_add(key, GIT_DESCRIBE_STR);
+    fnv_add(key, ctx->archId().str(ctx));
+    fnv_add(key, ctx->archArgsToId(ctx->archArgs()).str(ctx));
+    fnv_add(key, ctx->getChipName());
+    fnv_add(key, stringf("%d %d %d %d %d", ctx->getGridDimX(), ctx->getGridDimY(), int(sizeof(WireId)),
+                         int(sizeof(PipId)), int(sizeof(delay_t))));
+    return key;
+}
+
+bool RouteGraph::load(Context *ctx, const std::string &filename, uint64_t key)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        return false;
+    char magic[sizeof(route_graph_magic)];
+    uint64_t file_key;
+    int32_t n_wires, n_edges;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char *>(&file_key), sizeof(file_key));
+    in.read(reinterpret_cast<char *>(&n_wires), sizeof(n_wires));
+    in.read(reinterpret_cast<char *>(&n_edges), sizeof(n_edges));
+    if (!in || !std::equal(magic, magic + sizeof(magic), route_graph_magic) || file_key != key || n_wires < 0 ||
+        n_edges < 0)
+        return false;
+    if (!read_vector(in, wires, n_wires) || !read_vector(in, wire_delays, n_wires) ||
+        !read_vector(in, edge_offsets, n_wires + 1) || !read_vector(in, edges, n_edges)) {
+        log_warning("Routing graph cache '%s' is truncated, rebuilding it\n", filename.c_str());
+        wires.clear();
+        wire_delays.clear();
+        edge_offsets.clear();
+        edges.clear();
+        return false;
+    }
+    // A cheap check that the file really is for this device: the wires must match those of the Arch, in order
+    size_t i = 0;
+    bool match = true;
+    for (auto wire : ctx->getWires()) {
+        if (i >= wires.size() || wires[i] != wire) {
+            match = false;
+            break;
+        }
+        i++;
+    }
+    if (!match || i != wires.size()) {
+        log_warning("Routing graph cache '%s' does not match the device, rebuilding it\n", filename.c_str());
+        wires.clear();
+        wire_delays.clear();
+        edge_offsets.clear();
+        edges.clear();
+        return false;
+    }
+    index_wires();
+    return true;
+}
+
+void RouteGraph::save(const std::string &filename, uint64_t key) const
+{
+    // Written under a temporary name and renamed into place, so that concurrent runs never read a partial file
+    std::string tmp_filename =
+            stringf("%s.%llx.tmp", filename.c_str(),
+                    (unsigned long long)std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    {
+        std::ofstream out(tmp_filename, std::ios::binary);
+        int32_t n_wires = int32_t(wires.size()), n_edges = int32_t(edges.size());
+        out.write(route_graph_magic, sizeof(route_graph_magic));
+        out.write(reinterpret_cast<const char *>(&key), sizeof(key));
+        out.write(reinterpret_cast<const char *>(&n_wires), sizeof(n_wires));
+        out.write(reinterpret_cast<const char *>(&n_edges), sizeof(n_edges));
+        write_vector(out, wires);
+        write_vector(out, wire_delays);
+        write_vector(out, edge_offsets);
+        write_vector(out, edges);
+        if (!out) {
+            log_warning("Failed to write routing graph cache '%s'\n", filename.c_str());
+            std::remove(tmp_filename.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        log_warning("Failed to write routing graph cache '%s'\n", filename.c_str());
+        std::remove(tmp_filename.c_str());
+    }
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,104 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ROUTE_GRAPH_H
+#define ROUTE_GRAPH_H
+
+#include "nextpnr.h"
+#include "wire_indexer.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// The routing graph of the device flattened once into arrays, so the innermost loops of the routers can iterate
+// over the pips downhill of a wire without going through the Arch API for every pip; which on some architectures
+// means decoding relative tile locations on every call. Wires are numbered in ctx->getWires() order.
+//
+// Only static properties are stored; the availability of pips and wires must still be checked through the Arch.
+//
+// If the routeGraph/cacheDir setting names a directory and the Arch sets routeGraphCacheable, the graph is loaded
+// from a file there keyed by the device, or built and saved there; so that later runs on the same device skip
+// building it.
+struct RouteGraph
+{
+    explicit RouteGraph(Context *ctx);
+
+    struct Edge
+    {
+        // Index of the wire driven by the pip
+        int dst;
+        PipId pip;
+        delay_t pip_delay;
+    };
+
+    struct EdgeRange
+    {
+        const Edge *b, *e;
+        const Edge *begin() const { return b; }
+        const Edge *end() const { return e; }
+    };
+
+    int num_wires() const { return int(wires.size()); }
+#ifdef NPNR_DENSE_WIRE_INDEX
+    int wire_index(WireId wire) const { return indexer(wire); }
+#else
+    int wire_index(WireId wire) const { return wire_to_idx.at(wire); }
+#endif
+    WireId wire(int idx) const { return wires[idx]; }
+    delay_t wire_delay(int idx) const { return wire_delays[idx]; }
+
+    EdgeRange downhill(int idx) const
+    {
+        return EdgeRange{edges.data() + edge_offsets[idx], edges.data() + edge_offsets[idx + 1]};
+    }
+
+    // Estimated bytes held by the graph
+    int64_t memory_usage() const
+    {
+        int64_t bytes = int64_t(wires.capacity()) * sizeof(WireId) + int64_t(wire_delays.capacity()) * sizeof(delay_t) +
+                        int64_t(edge_offsets.capacity()) * sizeof(int) + int64_t(edges.capacity()) * sizeof(Edge);
+#ifndef NPNR_DENSE_WIRE_INDEX
+        bytes += int64_t(wire_to_idx.size()) * (sizeof(std::pair<WireId, int>) + 2 * sizeof(int32_t));
+#endif
+        return bytes;
+    }
+
+    // Identifies the device and the nextpnr build, for naming files of routing data cached across runs
+    static uint64_t device_key(Context *ctx);
+
+  private:
+    void build(Context *ctx);
+    bool load(Context *ctx, const std::string &filename, uint64_t key);
+    void save(const std::string &filename, uint64_t key) const;
+    void index_wires();
+
+    std::vector<WireId> wires;
+#ifdef NPNR_DENSE_WIRE_INDEX
+    WireIndexer indexer;
+#else
+    FlatHashMap<WireId, int> wire_to_idx;
+#endif
+    std::vector<delay_t> wire_delays;
+    // The downhill edges of wire i are edges[edge_offsets[i]] to edges[edge_offsets[i + 1] - 1]
+    std::vector<int> edge_offsets;
+    std::vector<Edge> edges;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -19,11 +19,19 @@
 
 #include <chrono>
 #include <cmath>
+#include <numeric>
 #include <queue>
 
 #include "log.h"
+#include "profiler.h"
+#include "route_graph.h"
 #include "router1.h"
+#include "router2.h"
+#include "search_queue.h"
 #include "timing.h"
+#include "util.h"
+#include "wire_indexer.h"
+#include "worker_pool.h"
 
 namespace {
 
@@ -89,6 +97,181 @@ struct QueuedWire
             return l == r ? lhs.randtag > rhs.randtag : l > r;
         }
     };
+
+    struct Cost
+    {
+        delay_t operator()(const QueuedWire &w) const noexcept { return w.delay + w.penalty + w.togo - w.bonus; }
+    };
+};
+
+// Index of the wires used by each arc (by arc id), and of the arcs using each wire. Each link is stored in both
+// lists along with its position in the other one, so that links can be removed in constant time by swapping with
+// the last element of the list.
+struct ArcWireIndex
+{
+    struct ArcLink
+    {
+        WireId wire;
+        int wire_pos;
+    };
+
+    struct WireLink
+    {
+        int arc;
+        int arc_pos;
+    };
+
+    void init(int num_arcs) { arc_wires.resize(num_arcs); }
+
+    // The arc must not already be using the wire
+    void add(int arc, WireId wire)
+    {
+        auto &wl = wire_arcs[wire];
+        auto &al = arc_wires.at(arc);
+        wl.push_back(WireLink{arc, int(al.size())});
+        al.push_back(ArcLink{wire, int(wl.size()) - 1});
+    }
+
+    bool used(WireId wire) const
+    {
+        auto fnd = wire_arcs.find(wire);
+        return fnd != wire_arcs.end() && !fnd->second.empty();
+    }
+
+    const std::vector<ArcLink> &wires_of(int arc) const { return arc_wires.at(arc); }
+
+    bool has_link(int arc, const ArcLink &link) const
+    {
+        auto fnd = wire_arcs.find(link.wire);
+        return fnd != wire_arcs.end() && link.wire_pos < int(fnd->second.size()) &&
+               fnd->second.at(link.wire_pos).arc == arc;
+    }
+
+    template <typename Tf> void for_each_wire_arc(Tf func) const
+    {
+        for (auto &it : wire_arcs)
+            for (auto &link : it.second)
+                func(it.first, link.arc);
+    }
+
+    // Remove all links of an arc, calling unused(wire) for each wire that is no longer used by any arc
+    template <typename Tf> void remove_arc(int arc, Tf unused)
+    {
+        auto &al = arc_wires.at(arc);
+        for (auto &link : al) {
+            auto &wl = wire_arcs.at(link.wire);
+            wl.at(link.wire_pos) = wl.back();
+            wl.pop_back();
+            if (link.wire_pos < int(wl.size())) {
+                auto &moved = wl.at(link.wire_pos);
+                arc_wires.at(moved.arc).at(moved.arc_pos).wire_pos = link.wire_pos;
+            }
+            if (wl.empty())
+                unused(link.wire);
+        }
+        al.clear();
+    }
+
+    // Remove all links of a wire, appending the arcs that were using it to arcs
+    void remove_wire(WireId wire, std::vector<int> &arcs)
+    {
+        auto fnd = wire_arcs.find(wire);
+        if (fnd == wire_arcs.end())
+            return;
+        for (auto &link : fnd->second) {
+            arcs.push_back(link.arc);
+            auto &al = arc_wires.at(link.arc);
+            al.at(link.arc_pos) = al.back();
+            al.pop_back();
+            if (link.arc_pos < int(al.size())) {
+                auto &moved = al.at(link.arc_pos);
+                wire_arcs.at(moved.wire).at(moved.wire_pos).arc_pos = link.arc_pos;
+            }
+        }
+        fnd->second.clear();
+    }
+
+  private:
+    std::vector<std::vector<ArcLink>> arc_wires;
+    FlatHashMap<WireId, std::vector<WireLink>> wire_arcs;
+};
+
+// Wires visited by a search and their best scores. Where wires have a dense index, entries are found through a
+// per-wire array stamped with the generation of the search that wrote them; so starting a new search needs no
+// clearing, and no hashing or allocation once warmed up. Otherwise, a hash map is used.
+struct VisitedWires
+{
+#ifdef NPNR_DENSE_WIRE_INDEX
+    explicit VisitedWires(const WireIndexer *indexer) : indexer(indexer), stamp(indexer->count, 0), slot(indexer->count)
+    {
+    }
+
+    void clear()
+    {
+        entries.clear();
+        if (++generation == 0) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+    }
+
+    QueuedWire *find(WireId wire)
+    {
+        int i = (*indexer)(wire);
+        return stamp[i] == generation ? &entries[slot[i]] : nullptr;
+    }
+
+    void set(const QueuedWire &qw)
+    {
+        int i = (*indexer)(qw.wire);
+        if (stamp[i] == generation) {
+            entries[slot[i]] = qw;
+        } else {
+            stamp[i] = generation;
+            slot[i] = int(entries.size());
+            entries.push_back(qw);
+        }
+    }
+
+  private:
+    const WireIndexer *indexer;
+    std::vector<uint32_t> stamp;
+    std::vector<int> slot;
+    std::vector<QueuedWire> entries;
+    uint32_t generation = 1;
+#else
+    void clear() { entries.clear(); }
+
+    QueuedWire *find(WireId wire)
+    {
+        auto fnd = entries.find(wire);
+        return fnd != entries.end() ? &fnd->second : nullptr;
+    }
+
+    void set(const QueuedWire &qw) { entries[qw.wire] = qw; }
+
+  private:
+    FlatHashMap<WireId, QueuedWire> entries;
+#endif
+  public:
+    QueuedWire &at(WireId wire)
+    {
+        QueuedWire *qw = find(wire);
+        NPNR_ASSERT(qw != nullptr);
+        return *qw;
+    }
+};
+
+// State of the search for the route of one arc; in parallel mode each worker thread uses its own
+struct ArcSearch
+{
+#ifdef NPNR_DENSE_WIRE_INDEX
+    explicit ArcSearch(const WireIndexer *indexer) : visited(indexer) {}
+#endif
+
+    VisitedWires visited;
+    SearchQueue<QueuedWire, QueuedWire::Greater, QueuedWire::Cost> queue;
+    int visit_cnt = 0;
 };
 
 struct Router1
@@ -97,21 +280,72 @@ struct Router1
     const Router1Cfg &cfg;
 
     std::priority_queue<arc_entry, std::vector<arc_entry>, arc_entry::Less> arc_queue;
-    std::unordered_map<WireId, std::unordered_set<arc_key, arc_key::Hash>> wire_to_arcs;
-    std::unordered_map<arc_key, std::unordered_set<WireId>, arc_key::Hash> arc_to_wires;
+    // The arcs of each net have consecutive ids, starting from the base id of the net
+    std::unordered_map<NetInfo *, int> net_arc_base;
+    std::vector<arc_key> arc_keys;
+    ArcWireIndex arc_wires;
     std::unordered_set<arc_key, arc_key::Hash> queued_arcs;
 
-    std::unordered_map<WireId, QueuedWire> visited;
-    std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> queue;
+#ifdef NPNR_DENSE_WIRE_INDEX
+    WireIndexer indexer;
+#endif
+    ArcSearch search;
+    std::vector<QueuedWire> route_path;
+    std::unique_ptr<RouteGraph> graph;
 
-    std::unordered_map<WireId, int> wireScores;
+    FlatHashMap<WireId, int> wireScores;
     std::unordered_map<NetInfo *, int> netScores;
 
     int arcs_with_ripup = 0;
     int arcs_without_ripup = 0;
+    int net_ripups = 0;
+    int wire_ripups = 0;
     bool ripup_flag;
 
-    Router1(Context *ctx, const Router1Cfg &cfg) : ctx(ctx), cfg(cfg) {}
+#ifndef NPNR_DISABLE_THREADS
+    std::unique_ptr<WorkerPool> pool;
+#endif
+    // Number of speculatively routed arcs that had to be rerouted as an earlier arc in their batch took their path
+    int spec_conflicts = 0;
+
+#ifdef NPNR_DENSE_WIRE_INDEX
+    Router1(Context *ctx, const Router1Cfg &cfg) : ctx(ctx), cfg(cfg), indexer(ctx), search(&indexer) { init_arcs(); }
+#else
+    Router1(Context *ctx, const Router1Cfg &cfg) : ctx(ctx), cfg(cfg) { init_arcs(); }
+#endif
+
+    void init_arcs()
+    {
+        for (auto &net_it : ctx->nets) {
+            NetInfo *net_info = net_it.second.get();
+            net_arc_base[net_info] = int(arc_keys.size());
+            for (int user_idx = 0; user_idx < int(net_info->users.size()); user_idx++) {
+                arc_key arc;
+                arc.net_info = net_info;
+                arc.user_idx = user_idx;
+                arc_keys.push_back(arc);
+            }
+        }
+        arc_wires.init(int(arc_keys.size()));
+    }
+
+    int arc_id(const arc_key &arc) const { return net_arc_base.at(arc.net_info) + arc.user_idx; }
+
+    // Remove a wire from all arcs using it, and queue those arcs for rerouting
+    void requeue_wire_arcs(WireId wire)
+    {
+        std::vector<int> arc_ids;
+        arc_wires.remove_wire(wire, arc_ids);
+
+        std::vector<arc_key> arcs;
+        for (int id : arc_ids)
+            arcs.push_back(arc_keys.at(id));
+
+        ctx->sorted_shuffle(arcs);
+
+        for (auto &it : arcs)
+            arc_queue_insert(it);
+    }
 
     void arc_queue_insert(const arc_key &arc, WireId src_wire, WireId dst_wire)
     {
@@ -170,6 +404,7 @@ struct Router1
             log("      ripup net %s\n", ctx->nameOf(net));
 
         netScores[net]++;
+        net_ripups++;
 
         std::vector<WireId> wires;
         for (auto &it : net->wires)
@@ -178,17 +413,7 @@ struct Router1
         ctx->sorted_shuffle(wires);
 
         for (WireId w : wires) {
-            std::vector<arc_key> arcs;
-            for (auto &it : wire_to_arcs[w]) {
-                arc_to_wires[it].erase(w);
-                arcs.push_back(it);
-            }
-            wire_to_arcs[w].clear();
-
-            ctx->sorted_shuffle(arcs);
-
-            for (auto &it : arcs)
-                arc_queue_insert(it);
+            requeue_wire_arcs(w);
 
             if (ctx->debug)
                 log("        unbind wire %s\n", ctx->nameOfWire(w));
@@ -212,23 +437,14 @@ struct Router1
             if (n != nullptr)
                 ripup_net(n);
         } else {
-            std::vector<arc_key> arcs;
-            for (auto &it : wire_to_arcs[w]) {
-                arc_to_wires[it].erase(w);
-                arcs.push_back(it);
-            }
-            wire_to_arcs[w].clear();
-
-            ctx->sorted_shuffle(arcs);
-
-            for (auto &it : arcs)
-                arc_queue_insert(it);
+            requeue_wire_arcs(w);
 
             if (ctx->debug)
                 log("      unbind wire %s\n", ctx->nameOfWire(w));
 
             ctx->unbindWire(w);
             wireScores[w]++;
+            wire_ripups++;
         }
 
         ripup_flag = true;
@@ -246,23 +462,14 @@ struct Router1
             if (n != nullptr)
                 ripup_net(n);
         } else {
-            std::vector<arc_key> arcs;
-            for (auto &it : wire_to_arcs[w]) {
-                arc_to_wires[it].erase(w);
-                arcs.push_back(it);
-            }
-            wire_to_arcs[w].clear();
-
-            ctx->sorted_shuffle(arcs);
-
-            for (auto &it : arcs)
-                arc_queue_insert(it);
+            requeue_wire_arcs(w);
 
             if (ctx->debug)
                 log("      unbind wire %s\n", ctx->nameOfWire(w));
 
             ctx->unbindWire(w);
             wireScores[w]++;
+            wire_ripups++;
         }
 
         ripup_flag = true;
@@ -315,14 +522,15 @@ struct Router1
                     log("[check]   arc: %s %s\n", ctx->nameOfWire(src_wire), ctx->nameOfWire(dst_wire));
 #endif
 
-                for (WireId wire : arc_to_wires[arc]) {
+                int id = arc_id(arc);
+                for (auto &link : arc_wires.wires_of(id)) {
 #if 0
                     if (ctx->debug)
-                        log("[check]     wire: %s\n", ctx->nameOfWire(wire));
+                        log("[check]     wire: %s\n", ctx->nameOfWire(link.wire));
 #endif
-                    valid_wires_for_net.insert(wire);
-                    log_assert(wire_to_arcs[wire].count(arc));
-                    log_assert(net_info->wires.count(wire));
+                    valid_wires_for_net.insert(link.wire);
+                    log_assert(arc_wires.has_link(id, link));
+                    log_assert(net_info->wires.count(link.wire));
                 }
             }
 
@@ -332,14 +540,7 @@ struct Router1
             }
         }
 
-        for (auto &it : wire_to_arcs) {
-            for (auto &arc : it.second)
-                log_assert(valid_arcs.count(arc));
-        }
-
-        for (auto &it : arc_to_wires) {
-            log_assert(valid_arcs.count(it.first));
-        }
+        arc_wires.for_each_wire_arc([&](WireId, int id) { log_assert(valid_arcs.count(arc_keys.at(id))); });
     }
 
     void setup()
@@ -405,9 +606,9 @@ struct Router1
                     continue;
                 }
 
+                int id = arc_id(arc);
                 WireId cursor = dst_wire;
-                wire_to_arcs[cursor].insert(arc);
-                arc_to_wires[arc].insert(cursor);
+                arc_wires.add(id, cursor);
 
                 while (src_wire != cursor) {
                     auto it = net_info->wires.find(cursor);
@@ -418,8 +619,7 @@ struct Router1
 
                     NPNR_ASSERT(it->second.pip != PipId());
                     cursor = ctx->getPipSrcWire(it->second.pip);
-                    wire_to_arcs[cursor].insert(arc);
-                    arc_to_wires[arc].insert(cursor);
+                    arc_wires.add(id, cursor);
                 }
             }
 
@@ -428,7 +628,7 @@ struct Router1
             std::vector<WireId> unbind_wires;
 
             for (auto &it : net_info->wires)
-                if (it.second.strength < STRENGTH_LOCKED && wire_to_arcs.count(it.first) == 0)
+                if (it.second.strength < STRENGTH_LOCKED && !arc_wires.used(it.first))
                     unbind_wires.push_back(it.first);
 
             for (auto it : unbind_wires)
@@ -436,59 +636,47 @@ struct Router1
         }
     }
 
-    bool route_arc(const arc_key &arc, bool ripup)
+    // Unbind wires that are currently used exclusively by this arc
+    void unbind_arc(const arc_key &arc)
     {
+        arc_wires.remove_arc(arc_id(arc), [&](WireId wire) {
+            if (ctx->debug)
+                log("  unbind %s\n", ctx->nameOfWire(wire));
+            ctx->unbindWire(wire);
+        });
+    }
 
-        NetInfo *net_info = arc.net_info;
-        int user_idx = arc.user_idx;
-
-        auto src_wire = ctx->getNetinfoSourceWire(net_info);
-        auto dst_wire = ctx->getNetinfoSinkWire(net_info, net_info->users[user_idx]);
-        ripup_flag = false;
-
-        if (ctx->debug) {
-            log("Routing arc %d on net %s (%d arcs total):\n", user_idx, ctx->nameOf(net_info),
-                int(net_info->users.size()));
-            log("  source ... %s\n", ctx->nameOfWire(src_wire));
-            log("  sink ..... %s\n", ctx->nameOfWire(dst_wire));
-        }
-
-        // unbind wires that are currently used exclusively by this arc
-
-        std::unordered_set<WireId> old_arc_wires;
-        old_arc_wires.swap(arc_to_wires[arc]);
-
-        for (WireId wire : old_arc_wires) {
-            auto &arc_wires = wire_to_arcs.at(wire);
-            NPNR_ASSERT(arc_wires.count(arc));
-            arc_wires.erase(arc);
-            if (arc_wires.empty()) {
-                if (ctx->debug)
-                    log("  unbind %s\n", ctx->nameOfWire(wire));
-                ctx->unbindWire(wire);
-            }
+    // Find the route of an arc, given the current state of the design which this must not modify; so that the
+    // arcs of a batch can be searched in parallel
+    // Search for a route of an arc; with cfg.bbMargin set, first within the bounding box of the arc widened by the
+    // margin, widening further each time no route is found until the search covers the whole device
+    bool find_route(const arc_key &arc, WireId src_wire, WireId dst_wire, bool ripup, ArcSearch &s,
+                    DeterministicRNG &rng)
+    {
+        if (cfg.bbMargin < 0)
+            return find_route(arc, src_wire, dst_wire, ripup, s, rng, ArcBounds(), -1);
+        ArcBounds bb = ctx->getRouteBoundingBox(src_wire, dst_wire);
+        for (int margin = cfg.bbMargin;; margin = 4 * margin + 4) {
+            if (bb.x0 - margin <= 0 && bb.y0 - margin <= 0 && bb.x1 + margin >= ctx->getGridDimX() - 1 &&
+                bb.y1 + margin >= ctx->getGridDimY() - 1)
+                return find_route(arc, src_wire, dst_wire, ripup, s, rng, ArcBounds(), -1);
+            if (find_route(arc, src_wire, dst_wire, ripup, s, rng, bb, margin))
+                return true;
         }
+    }
 
-        // special case
-
-        if (src_wire == dst_wire) {
-            NetInfo *bound = ctx->getBoundWireNet(src_wire);
-            if (bound != nullptr)
-                NPNR_ASSERT(bound == net_info);
-            else {
-                ctx->bindWire(src_wire, net_info, STRENGTH_WEAK);
-            }
-            arc_to_wires[arc].insert(src_wire);
-            wire_to_arcs[src_wire].insert(arc);
-            return true;
-        }
+    // Search for a route of an arc, only through pips within margin of bb if margin isn't negative
+    bool find_route(const arc_key &arc, WireId src_wire, WireId dst_wire, bool ripup, ArcSearch &s,
+                    DeterministicRNG &rng, const ArcBounds &bb, int margin)
+    {
+        NetInfo *net_info = arc.net_info;
+        auto &queue = s.queue;
+        auto &visited = s.visited;
 
         // reset wire queue
 
-        if (!queue.empty()) {
-            std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> new_queue;
-            queue.swap(new_queue);
-        }
+        queue.clear();
+        queue.set_bucket_width(cfg.queueBucketWidth);
         visited.clear();
 
         // A* main loop
@@ -509,24 +697,28 @@ struct Router1
                 qw.togo = ctx->estimateDelay(qw.wire, dst_wire);
                 best_est = qw.delay + qw.togo;
             }
-            qw.randtag = ctx->rng();
+            qw.randtag = rng.rng();
 
             queue.push(qw);
-            visited[qw.wire] = qw;
+            visited.set(qw);
         }
 
         while (visitCnt++ < maxVisitCnt && !queue.empty()) {
             QueuedWire qw = queue.top();
             queue.pop();
 
-            for (auto pip : ctx->getPipsDownhill(qw.wire)) {
-                delay_t next_delay = qw.delay + ctx->getPipDelay(pip).maxDelay();
+            // Explore next_wire through pip; hop_delay is the delay of the pip and next_wire
+            auto explore = [&](PipId pip, WireId next_wire, delay_t hop_delay) {
+                if (margin >= 0) {
+                    Loc pl = ctx->getPipLocation(pip);
+                    if (pl.x < bb.x0 - margin || pl.x > bb.x1 + margin || pl.y < bb.y0 - margin ||
+                        pl.y > bb.y1 + margin)
+                        return;
+                }
+                delay_t next_delay = qw.delay + hop_delay;
                 delay_t next_penalty = qw.penalty;
                 delay_t next_bonus = qw.bonus;
 
-                WireId next_wire = ctx->getPipDstWire(pip);
-                next_delay += ctx->getWireDelay(next_wire).maxDelay();
-
                 WireId conflictWireWire = WireId(), conflictPipWire = WireId();
                 NetInfo *conflictWireNet = nullptr, *conflictPipNet = nullptr;
 
@@ -535,46 +727,46 @@ struct Router1
                 } else {
                     if (!ctx->checkWireAvail(next_wire)) {
                         if (!ripup)
-                            continue;
+                            return;
                         conflictWireWire = ctx->getConflictingWireWire(next_wire);
                         if (conflictWireWire == WireId()) {
                             conflictWireNet = ctx->getConflictingWireNet(next_wire);
                             if (conflictWireNet == nullptr)
-                                continue;
+                                return;
                             else {
                                 if (conflictWireNet->wires.count(next_wire) &&
                                     conflictWireNet->wires.at(next_wire).strength > STRENGTH_STRONG)
-                                    continue;
+                                    return;
                             }
                         } else {
                             NetInfo *conflicting = ctx->getBoundWireNet(conflictWireWire);
                             if (conflicting != nullptr) {
                                 if (conflicting->wires.count(conflictWireWire) &&
                                     conflicting->wires.at(conflictWireWire).strength > STRENGTH_STRONG)
-                                    continue;
+                                    return;
                             }
                         }
                     }
 
                     if (!ctx->checkPipAvail(pip)) {
                         if (!ripup)
-                            continue;
+                            return;
                         conflictPipWire = ctx->getConflictingPipWire(pip);
                         if (conflictPipWire == WireId()) {
                             conflictPipNet = ctx->getConflictingPipNet(pip);
                             if (conflictPipNet == nullptr)
-                                continue;
+                                return;
                             else {
                                 if (conflictPipNet->wires.count(next_wire) &&
                                     conflictPipNet->wires.at(next_wire).strength > STRENGTH_STRONG)
-                                    continue;
+                                    return;
                             }
                         } else {
                             NetInfo *conflicting = ctx->getBoundWireNet(conflictPipWire);
                             if (conflicting != nullptr) {
                                 if (conflicting->wires.count(conflictPipWire) &&
                                     conflicting->wires.at(conflictPipWire).strength > STRENGTH_STRONG)
-                                    continue;
+                                    return;
                             }
                         }
                     }
@@ -628,23 +820,23 @@ struct Router1
                 NPNR_ASSERT(next_score >= 0);
 
                 if ((best_score >= 0) && (next_score - next_bonus - cfg.estimatePrecision > best_score))
-                    continue;
+                    return;
 
-                auto old_visited_it = visited.find(next_wire);
-                if (old_visited_it != visited.end()) {
-                    delay_t old_delay = old_visited_it->second.delay;
-                    delay_t old_score = old_delay + old_visited_it->second.penalty;
+                const QueuedWire *old_visited = visited.find(next_wire);
+                if (old_visited != nullptr) {
+                    delay_t old_delay = old_visited->delay;
+                    delay_t old_score = old_delay + old_visited->penalty;
                     NPNR_ASSERT(old_score >= 0);
 
                     if (next_score + ctx->getDelayEpsilon() >= old_score)
-                        continue;
+                        return;
 
 #if 0
                     if (ctx->debug)
                         log("Found better route to %s. Old vs new delay estimate: %.3f (%.3f) %.3f (%.3f)\n",
                             ctx->nameOfWire(next_wire),
                             ctx->getDelayNS(old_score),
-                            ctx->getDelayNS(old_visited_it->second.delay),
+                            ctx->getDelayNS(old_visited->delay),
                             ctx->getDelayNS(next_score),
                             ctx->getDelayNS(next_delay));
 #endif
@@ -660,11 +852,11 @@ struct Router1
                     next_qw.togo = ctx->estimateDelay(next_wire, dst_wire);
                     delay_t this_est = next_qw.delay + next_qw.togo;
                     if (this_est / 2 - cfg.estimatePrecision > best_est)
-                        continue;
+                        return;
                     if (best_est > this_est)
                         best_est = this_est;
                 }
-                next_qw.randtag = ctx->rng();
+                next_qw.randtag = rng.rng();
 
 #if 0
                 if (ctx->debug)
@@ -675,41 +867,53 @@ struct Router1
                         ctx->getDelayNS(next_delay));
 #endif
 
-                visited[next_qw.wire] = next_qw;
+                visited.set(next_qw);
                 queue.push(next_qw);
 
                 if (next_wire == dst_wire) {
                     maxVisitCnt = std::min(maxVisitCnt, 2 * visitCnt + (next_qw.penalty > 0 ? 100 : 0));
                     best_score = next_score - next_bonus;
                 }
+            };
+
+            if (graph != nullptr) {
+                for (auto &edge : graph->downhill(graph->wire_index(qw.wire)))
+                    explore(edge.pip, graph->wire(edge.dst), edge.pip_delay + graph->wire_delay(edge.dst));
+            } else {
+                for (auto pip : ctx->getPipsDownhill(qw.wire)) {
+                    WireId next_wire = ctx->getPipDstWire(pip);
+                    explore(pip, next_wire, ctx->getPipDelay(pip).maxDelay() + ctx->getWireDelay(next_wire).maxDelay());
+                }
             }
         }
 
-        if (ctx->debug)
-            log("  total number of visited nodes: %d\n", visitCnt);
-
-        if (visited.count(dst_wire) == 0) {
-            if (ctx->debug)
-                log("  no route found for this arc\n");
-            return false;
-        }
+        s.visit_cnt = visitCnt;
+        return visited.find(dst_wire) != nullptr;
+    }
 
-        if (ctx->debug) {
-            log("  final route delay:   %8.2f\n", ctx->getDelayNS(visited[dst_wire].delay));
-            log("  final route penalty: %8.2f\n", ctx->getDelayNS(visited[dst_wire].penalty));
-            log("  final route bonus:   %8.2f\n", ctx->getDelayNS(visited[dst_wire].bonus));
-            log("  arc budget:      %12.2f\n", ctx->getDelayNS(net_info->users[user_idx].budget));
+    // Path of the route found by a search, from the sink back to the source
+    void trace_route(ArcSearch &s, WireId dst_wire, std::vector<QueuedWire> &path)
+    {
+        path.clear();
+        WireId cursor = dst_wire;
+        while (true) {
+            path.push_back(s.visited.at(cursor));
+            if (path.back().pip == PipId())
+                break;
+            cursor = ctx->getPipSrcWire(path.back().pip);
         }
+    }
 
-        // bind resulting route (and maybe unroute other nets)
-
-        std::unordered_set<WireId> unassign_wires = arc_to_wires[arc];
+    // Bind the route found by a search (and maybe unroute other nets)
+    void bind_route(const arc_key &arc, WireId src_wire, WireId dst_wire, const std::vector<QueuedWire> &path)
+    {
+        NetInfo *net_info = arc.net_info;
 
-        WireId cursor = dst_wire;
         delay_t accumulated_path_delay = 0;
         delay_t last_path_delay_delta = 0;
-        while (1) {
-            auto pip = visited[cursor].pip;
+        for (auto &step : path) {
+            WireId cursor = step.wire;
+            auto pip = step.pip;
 
             if (ctx->debug) {
                 delay_t path_delay_delta = ctx->estimateDelay(cursor, dst_wire) - accumulated_path_delay;
@@ -749,15 +953,62 @@ struct Router1
                 }
             }
 
-            wire_to_arcs[cursor].insert(arc);
-            arc_to_wires[arc].insert(cursor);
+            arc_wires.add(arc_id(arc), cursor);
+        }
+    }
 
-            if (pip == PipId())
-                break;
+    bool route_arc(const arc_key &arc, bool ripup)
+    {
 
-            cursor = ctx->getPipSrcWire(pip);
+        NetInfo *net_info = arc.net_info;
+        int user_idx = arc.user_idx;
+
+        auto src_wire = ctx->getNetinfoSourceWire(net_info);
+        auto dst_wire = ctx->getNetinfoSinkWire(net_info, net_info->users[user_idx]);
+        ripup_flag = false;
+
+        if (ctx->debug) {
+            log("Routing arc %d on net %s (%d arcs total):\n", user_idx, ctx->nameOf(net_info),
+                int(net_info->users.size()));
+            log("  source ... %s\n", ctx->nameOfWire(src_wire));
+            log("  sink ..... %s\n", ctx->nameOfWire(dst_wire));
         }
 
+        unbind_arc(arc);
+
+        // special case
+
+        if (src_wire == dst_wire) {
+            NetInfo *bound = ctx->getBoundWireNet(src_wire);
+            if (bound != nullptr)
+                NPNR_ASSERT(bound == net_info);
+            else {
+                ctx->bindWire(src_wire, net_info, STRENGTH_WEAK);
+            }
+            arc_wires.add(arc_id(arc), src_wire);
+            return true;
+        }
+
+        if (!find_route(arc, src_wire, dst_wire, ripup, search, *ctx)) {
+            if (ctx->debug) {
+                log("  total number of visited nodes: %d\n", search.visit_cnt);
+                log("  no route found for this arc\n");
+            }
+            return false;
+        }
+
+        if (ctx->debug) {
+            auto &dst_qw = search.visited.at(dst_wire);
+            log("  total number of visited nodes: %d\n", search.visit_cnt);
+            log("  final route delay:   %8.2f\n", ctx->getDelayNS(dst_qw.delay));
+            log("  final route penalty: %8.2f\n", ctx->getDelayNS(dst_qw.penalty));
+            log("  final route bonus:   %8.2f\n", ctx->getDelayNS(dst_qw.bonus));
+            log("  arc budget:      %12.2f\n", ctx->getDelayNS(net_info->users[user_idx].budget));
+        }
+
+        trace_route(search, dst_wire, route_path);
+        bind_route(arc, src_wire, dst_wire, route_path);
+
         if (ripup_flag)
             arcs_with_ripup++;
         else
@@ -765,6 +1016,162 @@ struct Router1
 
         return true;
     }
+
+    // Pop up to max_arcs arcs of different nets with non-overlapping bounding boxes, that can be searched in
+    // parallel with little chance of their routes conflicting
+    std::vector<arc_key> arc_queue_pop_batch(int max_arcs)
+    {
+        std::vector<arc_key> batch;
+        std::vector<arc_entry> skipped;
+        std::vector<ArcBounds> batch_bounds;
+        std::unordered_set<NetInfo *> batch_nets;
+        const int margin = 2;
+        while (!arc_queue.empty() && int(batch.size()) < max_arcs && int(skipped.size()) < 4 * max_arcs) {
+            arc_entry entry = arc_queue.top();
+            arc_queue.pop();
+            NetInfo *net_info = entry.arc.net_info;
+            ArcBounds bb =
+                    ctx->getRouteBoundingBox(ctx->getNetinfoSourceWire(net_info),
+                                             ctx->getNetinfoSinkWire(net_info, net_info->users[entry.arc.user_idx]));
+            bool overlaps = batch_nets.count(net_info);
+            for (auto &other : batch_bounds)
+                if (bb.x0 - margin <= other.x1 && other.x0 <= bb.x1 + margin && bb.y0 - margin <= other.y1 &&
+                    other.y0 <= bb.y1 + margin)
+                    overlaps = true;
+            if (overlaps) {
+                skipped.push_back(entry);
+                continue;
+            }
+            queued_arcs.erase(entry.arc);
+            batch.push_back(entry.arc);
+            batch_bounds.push_back(bb);
+            batch_nets.insert(net_info);
+        }
+        for (auto &entry : skipped)
+            arc_queue.push(entry);
+        return batch;
+    }
+
+    // Returns true if none of the wires and pips of a speculatively found route, that the search found available,
+    // have since been taken by an earlier route of the batch
+    bool check_route_avail(const arc_key &arc, const std::vector<QueuedWire> &path)
+    {
+        NetInfo *net_info = arc.net_info;
+        for (size_t i = 0; i + 1 < path.size(); i++) {
+            auto &qw = path.at(i);
+            // The search planned to rip up whatever it conflicted with, where the penalty increased
+            bool planned_ripup = qw.penalty != path.at(i + 1).penalty;
+            if (!planned_ripup && !(net_info->wires.count(qw.wire) && net_info->wires.at(qw.wire).pip == qw.pip) &&
+                (!ctx->checkWireAvail(qw.wire) || !ctx->checkPipAvail(qw.pip)))
+                return false;
+        }
+        return true;
+    }
+
+    // Scratch search states for parallel searches, one per concurrently running search
+    std::vector<std::unique_ptr<ArcSearch>> spare_searches;
+    std::mutex spare_mutex;
+
+    std::unique_ptr<ArcSearch> take_search()
+    {
+        std::unique_lock<std::mutex> lk(spare_mutex);
+        if (spare_searches.empty()) {
+#ifdef NPNR_DENSE_WIRE_INDEX
+            return std::unique_ptr<ArcSearch>(new ArcSearch(&indexer));
+#else
+            return std::unique_ptr<ArcSearch>(new ArcSearch());
+#endif
+        }
+        auto s = std::move(spare_searches.back());
+        spare_searches.pop_back();
+        return s;
+    }
+
+    void return_search(std::unique_ptr<ArcSearch> s)
+    {
+        std::unique_lock<std::mutex> lk(spare_mutex);
+        spare_searches.push_back(std::move(s));
+    }
+
+    // Route a batch of arcs; searching them in parallel against the design as it is, then binding the routes in
+    // order; arcs whose route conflicts with an earlier route of the batch are searched again. Returns false, with
+    // failed_arc set, if an arc can't be routed.
+    bool route_batch(const std::vector<arc_key> &batch, arc_key &failed_arc)
+    {
+        int n = int(batch.size());
+        std::vector<WireId> src_wires(n), dst_wires(n);
+        std::vector<int> to_search;
+        for (int i = 0; i < n; i++) {
+            NetInfo *net_info = batch.at(i).net_info;
+            src_wires.at(i) = ctx->getNetinfoSourceWire(net_info);
+            dst_wires.at(i) = ctx->getNetinfoSinkWire(net_info, net_info->users[batch.at(i).user_idx]);
+            if (src_wires.at(i) == dst_wires.at(i)) {
+                // Trivial arcs take the normal path, there is nothing to search
+                if (!route_arc(batch.at(i), true)) {
+                    failed_arc = batch.at(i);
+                    return false;
+                }
+                continue;
+            }
+            unbind_arc(batch.at(i));
+            to_search.push_back(i);
+        }
+
+        std::vector<std::vector<QueuedWire>> paths(n);
+        std::vector<DeterministicRNG> rngs(n);
+        std::vector<uint8_t> found(n, 0);
+        ctx->rng64();
+        for (int i : to_search)
+            rngs.at(i) = ctx->split(i);
+        auto search_arc = [&](int i) {
+            auto s = take_search();
+            found.at(i) = find_route(batch.at(i), src_wires.at(i), dst_wires.at(i), true, *s, rngs.at(i));
+            if (found.at(i))
+                trace_route(*s, dst_wires.at(i), paths.at(i));
+            return_search(std::move(s));
+        };
+#ifdef NPNR_DISABLE_THREADS
+        for (int i : to_search)
+            search_arc(i);
+#else
+        pool->run(to_search, search_arc);
+#endif
+
+        for (int i : to_search) {
+            if (!found.at(i) || !check_route_avail(batch.at(i), paths.at(i))) {
+                ++spec_conflicts;
+                if (!route_arc(batch.at(i), true)) {
+                    failed_arc = batch.at(i);
+                    return false;
+                }
+                continue;
+            }
+            ripup_flag = false;
+            bind_route(batch.at(i), src_wires.at(i), dst_wires.at(i), paths.at(i));
+            if (ripup_flag)
+                arcs_with_ripup++;
+            else
+                arcs_without_ripup++;
+        }
+        return true;
+    }
+
+    // The routing at the point where the fewest arcs were left to route
+    struct Checkpoint
+    {
+        int unrouted_arcs = -1;
+        DesignSnapshot routing;
+    } checkpoint;
+
+    void save_checkpoint()
+    {
+        checkpoint.unrouted_arcs = int(arc_queue.size());
+        ctx->saveSnapshot(checkpoint.routing, false, true);
+    }
+
+    // Replace the current routing with the checkpoint; the router's arc state is not updated so routing can't
+    // continue afterwards
+    void restore_checkpoint() { ctx->restoreSnapshot(checkpoint.routing); }
 };
 
 } // namespace
@@ -777,16 +1184,23 @@ Router1Cfg::Router1Cfg(Context *ctx)
     cleanupReroute = ctx->setting<bool>("router1/cleanupReroute", true);
     fullCleanupReroute = ctx->setting<bool>("router1/fullCleanupReroute", true);
     useEstimate = ctx->setting<bool>("router1/useEstimate", true);
+    threads = ctx->stage_threads("router1", 1);
+    useRouteGraph = ctx->setting<bool>("router1/routeGraph", false);
+    timeBudget = ctx->setting<float>("router1/timeBudget", 0);
+    timeoutRouter2 = ctx->setting<bool>("router1/timeoutRouter2", false);
+    bbMargin = ctx->setting<int>("router1/bbMargin", -1);
 
     wireRipupPenalty = ctx->getRipupDelayPenalty();
     netRipupPenalty = 10 * ctx->getRipupDelayPenalty();
     reuseBonus = wireRipupPenalty / 2;
 
     estimatePrecision = 100 * ctx->getRipupDelayPenalty();
+    queueBucketWidth = ctx->getDelayFromNS(ctx->setting<float>("router1/queueBucketWidth", 0.0f)).maxDelay();
 }
 
 bool router1(Context *ctx, const Router1Cfg &cfg)
 {
+    NPNR_PROFILE_ZONE("router1");
     try {
         log_break();
         log_info("Routing..\n");
@@ -795,8 +1209,18 @@ bool router1(Context *ctx, const Router1Cfg &cfg)
 
         log_info("Setting up routing queue.\n");
 
+        // Arc priorities are based on budgets, so share out the slack of the placed design once before queueing
+        assign_placed_budget(ctx);
+
         Router1 router(ctx, cfg);
         router.setup();
+        if (cfg.useRouteGraph)
+            router.graph.reset(new RouteGraph(ctx));
+#ifndef NPNR_DISABLE_THREADS
+        // Debug output can't be interleaved from several threads
+        if (cfg.threads > 1 && !ctx->debug)
+            router.pool.reset(new WorkerPool(cfg.threads));
+#endif
 #ifndef NDEBUG
         router.check();
 #endif
@@ -806,34 +1230,64 @@ bool router1(Context *ctx, const Router1Cfg &cfg)
         int iter_cnt = 0;
         int last_arcs_with_ripup = 0;
         int last_arcs_without_ripup = 0;
+        int last_net_ripups = 0;
+        int last_wire_ripups = 0;
 
-        log_info("           |   (re-)routed arcs  |   delta    | remaining|       time spent     |\n");
-        log_info("   IterCnt |  w/ripup   wo/ripup |  w/r  wo/r |      arcs| batch(sec) total(sec)|\n");
+        log_info("           |   (re-)routed arcs  |   delta    | remaining| delta ripups |       time spent     |\n");
+        log_info("   IterCnt |  w/ripup   wo/ripup |  w/r  wo/r |      arcs|  nets  wires | batch(sec) total(sec)|\n");
+
+        bool timed_out = false;
+        if (cfg.timeBudget > 0)
+            router.save_checkpoint();
 
         auto prev_time = rstart;
         while (!router.arc_queue.empty()) {
             if (++iter_cnt % 1000 == 0) {
                 auto curr_time = std::chrono::high_resolution_clock::now();
-                log_info("%10d | %8d %10d | %4d %5d | %9d| %10.02f %10.02f|\n", iter_cnt, router.arcs_with_ripup,
-                         router.arcs_without_ripup, router.arcs_with_ripup - last_arcs_with_ripup,
+                log_info("%10d | %8d %10d | %4d %5d | %9d| %5d %6d | %10.02f %10.02f|\n", iter_cnt,
+                         router.arcs_with_ripup, router.arcs_without_ripup,
+                         router.arcs_with_ripup - last_arcs_with_ripup,
                          router.arcs_without_ripup - last_arcs_without_ripup, int(router.arc_queue.size()),
+                         router.net_ripups - last_net_ripups, router.wire_ripups - last_wire_ripups,
                          std::chrono::duration<float>(curr_time - prev_time).count(),
                          std::chrono::duration<float>(curr_time - rstart).count());
                 prev_time = curr_time;
                 last_arcs_with_ripup = router.arcs_with_ripup;
                 last_arcs_without_ripup = router.arcs_without_ripup;
+                last_net_ripups = router.net_ripups;
+                last_wire_ripups = router.wire_ripups;
                 ctx->yield();
+                ctx->autosave();
 #ifndef NDEBUG
                 router.check();
 #endif
+                if (cfg.timeBudget > 0 && int(router.arc_queue.size()) < router.checkpoint.unrouted_arcs)
+                    router.save_checkpoint();
+            }
+
+            if (cfg.timeBudget > 0 &&
+                std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - rstart).count() >
+                        cfg.timeBudget) {
+                timed_out = true;
+                break;
             }
 
             if (ctx->debug)
                 log("-- %d --\n", iter_cnt);
 
-            arc_key arc = router.arc_queue_pop();
+            arc_key arc{};
+            bool routed;
+#ifndef NPNR_DISABLE_THREADS
+            if (router.pool != nullptr)
+                routed = router.route_batch(router.arc_queue_pop_batch(4 * router.pool->size()), arc);
+            else
+#endif
+            {
+                arc = router.arc_queue_pop();
+                routed = router.route_arc(arc, true);
+            }
 
-            if (!router.route_arc(arc, true)) {
+            if (!routed) {
                 log_warning("Failed to find a route for arc %d of net %s.\n", arc.user_idx, ctx->nameOf(arc.net_info));
 #ifndef NDEBUG
                 router.check();
@@ -844,11 +1298,33 @@ bool router1(Context *ctx, const Router1Cfg &cfg)
             }
         }
         auto rend = std::chrono::high_resolution_clock::now();
-        log_info("%10d | %8d %10d | %4d %5d | %9d| %10.02f %10.02f|\n", iter_cnt, router.arcs_with_ripup,
+        log_info("%10d | %8d %10d | %4d %5d | %9d| %5d %6d | %10.02f %10.02f|\n", iter_cnt, router.arcs_with_ripup,
                  router.arcs_without_ripup, router.arcs_with_ripup - last_arcs_with_ripup,
                  router.arcs_without_ripup - last_arcs_without_ripup, int(router.arc_queue.size()),
+                 router.net_ripups - last_net_ripups, router.wire_ripups - last_wire_ripups,
                  std::chrono::duration<float>(rend - prev_time).count(),
                  std::chrono::duration<float>(rend - rstart).count());
+        if (router.spec_conflicts > 0)
+            log_info("%d speculatively routed arcs conflicted and were rerouted.\n", router.spec_conflicts);
+
+        if (timed_out) {
+            log_warning("Router1 time budget of %.1fs exhausted with %d arcs left to route.\n", cfg.timeBudget,
+                        int(router.arc_queue.size()));
+            if (int(router.arc_queue.size()) > router.checkpoint.unrouted_arcs) {
+                log_info("Restoring earlier routing with %d arcs left to route.\n", router.checkpoint.unrouted_arcs);
+                router.restore_checkpoint();
+            }
+            if (!cfg.timeoutRouter2) {
+                ctx->unlock();
+                return false;
+            }
+            log_info("Finishing routing with router2.\n");
+            Router2Cfg router2_cfg(ctx);
+            router2_cfg.incremental = true;
+            router2(ctx, router2_cfg);
+            ctx->unlock();
+            return true;
+        }
         log_info("Routing complete.\n");
         ctx->yield();
         log_info("Router1 time %.02fs\n", std::chrono::duration<float>(rend - rstart).count());
@@ -874,184 +1350,305 @@ bool router1(Context *ctx, const Router1Cfg &cfg)
     }
 }
 
-bool Context::checkRoutedDesign() const
+namespace {
+// Check the routing tree of one net, appending what would have been logged to diag
+bool check_routed_net(const Context *ctx, const NetInfo *net_info, std::string &diag)
 {
-    const Context *ctx = getCtx();
-
-    for (auto &net_it : ctx->nets) {
-        NetInfo *net_info = net_it.second.get();
-
-#ifdef ARCH_ECP5
-        if (net_info->is_global)
-            continue;
-#endif
+    if (ctx->debug)
+        diag += stringf("checking net %s\n", ctx->nameOf(net_info));
 
+    if (net_info->users.empty()) {
         if (ctx->debug)
-            log("checking net %s\n", ctx->nameOf(net_info));
-
-        if (net_info->users.empty()) {
-            if (ctx->debug)
-                log("  net without sinks\n");
-            log_assert(net_info->wires.empty());
-            continue;
-        }
+            diag += stringf("  net without sinks\n");
+        log_assert(net_info->wires.empty());
+        return true;
+    }
 
-        bool found_unrouted = false;
-        bool found_loop = false;
-        bool found_stub = false;
+    bool found_unrouted = false;
+    bool found_loop = false;
+    bool found_stub = false;
 
-        struct ExtraWireInfo
-        {
-            int order_num = 0;
-            std::unordered_set<WireId> children;
-        };
+    struct ExtraWireInfo
+    {
+        int order_num = 0;
+        std::unordered_set<WireId> children;
+    };
 
-        std::unordered_map<WireId, ExtraWireInfo> db;
+    std::unordered_map<WireId, ExtraWireInfo> db;
 
-        for (auto &it : net_info->wires) {
-            WireId w = it.first;
-            PipId p = it.second.pip;
+    for (auto &it : net_info->wires) {
+        WireId w = it.first;
+        PipId p = it.second.pip;
 
-            if (p != PipId()) {
-                log_assert(ctx->getPipDstWire(p) == w);
-                db[ctx->getPipSrcWire(p)].children.insert(w);
-            }
+        if (p != PipId()) {
+            log_assert(ctx->getPipDstWire(p) == w);
+            db[ctx->getPipSrcWire(p)].children.insert(w);
         }
+    }
 
-        auto src_wire = ctx->getNetinfoSourceWire(net_info);
-        if (src_wire == WireId()) {
-            log_assert(net_info->driver.cell == nullptr);
-            if (ctx->debug)
-                log("  undriven and unrouted\n");
-            continue;
-        }
+    auto src_wire = ctx->getNetinfoSourceWire(net_info);
+    if (src_wire == WireId()) {
+        log_assert(net_info->driver.cell == nullptr);
+        if (ctx->debug)
+            diag += stringf("  undriven and unrouted\n");
+        return true;
+    }
+
+    if (net_info->wires.count(src_wire) == 0) {
+        if (ctx->debug)
+            diag += stringf("  source (%s) not bound to net\n", ctx->nameOfWire(src_wire));
+        found_unrouted = true;
+    }
 
-        if (net_info->wires.count(src_wire) == 0) {
+    std::unordered_map<WireId, int> dest_wires;
+    for (int user_idx = 0; user_idx < int(net_info->users.size()); user_idx++) {
+        auto dst_wire = ctx->getNetinfoSinkWire(net_info, net_info->users[user_idx]);
+        log_assert(dst_wire != WireId());
+        dest_wires[dst_wire] = user_idx;
+
+        if (net_info->wires.count(dst_wire) == 0) {
             if (ctx->debug)
-                log("  source (%s) not bound to net\n", ctx->nameOfWire(src_wire));
+                diag += stringf("  sink %d (%s) not bound to net\n", user_idx, ctx->nameOfWire(dst_wire));
             found_unrouted = true;
         }
+    }
 
-        std::unordered_map<WireId, int> dest_wires;
-        for (int user_idx = 0; user_idx < int(net_info->users.size()); user_idx++) {
-            auto dst_wire = ctx->getNetinfoSinkWire(net_info, net_info->users[user_idx]);
-            log_assert(dst_wire != WireId());
-            dest_wires[dst_wire] = user_idx;
+    std::function<void(WireId, int)> setOrderNum;
+    std::unordered_set<WireId> logged_wires;
 
-            if (net_info->wires.count(dst_wire) == 0) {
+    setOrderNum = [&](WireId w, int num) {
+        auto &db_entry = db[w];
+        if (db_entry.order_num != 0) {
+            found_loop = true;
+            diag += stringf("  %*s=> loop\n", 2 * num, "");
+            return;
+        }
+        db_entry.order_num = num;
+        for (WireId child : db_entry.children) {
+            if (ctx->debug) {
+                diag += stringf("  %*s-> %s\n", 2 * num, "", ctx->nameOfWire(child));
+                logged_wires.insert(child);
+            }
+            setOrderNum(child, num + 1);
+        }
+        if (db_entry.children.empty()) {
+            if (dest_wires.count(w) != 0) {
+                if (ctx->debug)
+                    diag += stringf("  %*s=> sink %d\n", 2 * num, "", dest_wires.at(w));
+            } else {
                 if (ctx->debug)
-                    log("  sink %d (%s) not bound to net\n", user_idx, ctx->nameOfWire(dst_wire));
-                found_unrouted = true;
+                    diag += stringf("  %*s=> stub\n", 2 * num, "");
+                found_stub = true;
             }
         }
+    };
+
+    if (ctx->debug) {
+        diag += stringf("  driver: %s\n", ctx->nameOfWire(src_wire));
+        logged_wires.insert(src_wire);
+    }
+    setOrderNum(src_wire, 1);
 
-        std::function<void(WireId, int)> setOrderNum;
-        std::unordered_set<WireId> logged_wires;
+    std::unordered_set<WireId> dangling_wires;
 
-        setOrderNum = [&](WireId w, int num) {
-            auto &db_entry = db[w];
-            if (db_entry.order_num != 0) {
-                found_loop = true;
-                log("  %*s=> loop\n", 2 * num, "");
-                return;
-            }
-            db_entry.order_num = num;
-            for (WireId child : db_entry.children) {
-                if (ctx->debug) {
-                    log("  %*s-> %s\n", 2 * num, "", ctx->nameOfWire(child));
-                    logged_wires.insert(child);
-                }
-                setOrderNum(child, num + 1);
+    for (auto &it : db) {
+        auto &db_entry = it.second;
+        if (db_entry.order_num == 0)
+            dangling_wires.insert(it.first);
+    }
+
+    if (ctx->debug) {
+        if (dangling_wires.empty()) {
+            diag += stringf("  no dangling wires.\n");
+        } else {
+            std::unordered_set<WireId> root_wires = dangling_wires;
+
+            for (WireId w : dangling_wires) {
+                for (WireId c : db[w].children)
+                    root_wires.erase(c);
             }
-            if (db_entry.children.empty()) {
-                if (dest_wires.count(w) != 0) {
-                    if (ctx->debug)
-                        log("  %*s=> sink %d\n", 2 * num, "", dest_wires.at(w));
-                } else {
-                    if (ctx->debug)
-                        log("  %*s=> stub\n", 2 * num, "");
-                    found_stub = true;
-                }
+
+            for (WireId w : root_wires) {
+                diag += stringf("  dangling wire: %s\n", ctx->nameOfWire(w));
+                logged_wires.insert(w);
+                setOrderNum(w, 1);
             }
-        };
 
-        if (ctx->debug) {
-            log("  driver: %s\n", ctx->nameOfWire(src_wire));
-            logged_wires.insert(src_wire);
+            for (WireId w : dangling_wires) {
+                if (logged_wires.count(w) == 0)
+                    diag += stringf("  loop: %s -> %s\n",
+                                    ctx->nameOfWire(ctx->getPipSrcWire(net_info->wires.at(w).pip)),
+                                    ctx->nameOfWire(w));
+            }
         }
-        setOrderNum(src_wire, 1);
+    }
 
-        std::unordered_set<WireId> dangling_wires;
+    bool fail = false;
 
-        for (auto &it : db) {
-            auto &db_entry = it.second;
-            if (db_entry.order_num == 0)
-                dangling_wires.insert(it.first);
-        }
+    if (found_unrouted) {
+        if (ctx->debug)
+            diag += stringf("check failed: found unrouted arcs\n");
+        fail = true;
+    }
 
-        if (ctx->debug) {
-            if (dangling_wires.empty()) {
-                log("  no dangling wires.\n");
-            } else {
-                std::unordered_set<WireId> root_wires = dangling_wires;
+    if (found_loop) {
+        if (ctx->debug)
+            diag += stringf("check failed: found loops\n");
+        fail = true;
+    }
 
-                for (WireId w : dangling_wires) {
-                    for (WireId c : db[w].children)
-                        root_wires.erase(c);
-                }
+    if (found_stub) {
+        if (ctx->debug)
+            diag += stringf("check failed: found stubs\n");
+        fail = true;
+    }
 
-                for (WireId w : root_wires) {
-                    log("  dangling wire: %s\n", ctx->nameOfWire(w));
-                    logged_wires.insert(w);
-                    setOrderNum(w, 1);
-                }
+    if (!dangling_wires.empty()) {
+        if (ctx->debug)
+            diag += stringf("check failed: found dangling wires\n");
+        fail = true;
+    }
 
-                for (WireId w : dangling_wires) {
-                    if (logged_wires.count(w) == 0)
-                        log("  loop: %s -> %s\n", ctx->nameOfWire(ctx->getPipSrcWire(net_info->wires.at(w).pip)),
-                            ctx->nameOfWire(w));
-                }
-            }
-        }
+    return !fail;
+}
+} // namespace
 
-        bool fail = false;
+bool Context::checkRoutedDesign() const
+{
+    const Context *ctx = getCtx();
 
-        if (found_unrouted) {
-            if (ctx->debug)
-                log("check failed: found unrouted arcs\n");
-            fail = true;
-        }
+    // Each net's routing tree is checked independently, in parallel; diagnostics are collected per net and printed in
+    // net order, up to the first failing net, so the log is the same as checking the nets one by one.
+    std::vector<const NetInfo *> net_list;
+    for (auto &net_it : ctx->nets) {
+        NetInfo *net_info = net_it.second.get();
+#ifdef ARCH_ECP5
+        if (net_info->is_global)
+            continue;
+#endif
+        net_list.push_back(net_info);
+    }
 
-        if (found_loop) {
-            if (ctx->debug)
-                log("check failed: found loops\n");
-            fail = true;
-        }
+    std::vector<std::string> diags(net_list.size());
+    std::vector<char> ok(net_list.size(), 1);
+    const int chunk_size = 256;
+    int chunks = (int(net_list.size()) + chunk_size - 1) / chunk_size;
+    auto check_chunk = [&](int chunk) {
+        int end = std::min(int(net_list.size()), (chunk + 1) * chunk_size);
+        for (int i = chunk * chunk_size; i < end; i++)
+            ok[i] = check_routed_net(ctx, net_list[i], diags[i]);
+    };
+    int threads = std::min(chunks, ctx->stage_threads("check", 0));
+#ifndef NPNR_DISABLE_THREADS
+    if (threads > 1) {
+        std::vector<int> tasks(chunks);
+        std::iota(tasks.begin(), tasks.end(), 0);
+        WorkerPool(threads).run(tasks, check_chunk);
+    } else
+#endif
+    {
+        for (int chunk = 0; chunk < chunks; chunk++)
+            check_chunk(chunk);
+    }
 
-        if (found_stub) {
-            if (ctx->debug)
-                log("check failed: found stubs\n");
-            fail = true;
-        }
+    for (size_t i = 0; i < net_list.size(); i++) {
+        if (!diags[i].empty())
+            log("%s", diags[i].c_str());
+        if (!ok[i])
+            return false;
+    }
+    return true;
+}
 
-        if (!dangling_wires.empty()) {
-            if (ctx->debug)
-                log("check failed: found dangling wires\n");
-            fail = true;
+namespace {
+// Shortest paths by delay from src_wire, ignoring congestion, until every wire of dst_wires has been reached. With an
+// estimate (only for a single sink), this is an A* search towards it.
+int route_delay_search(const Context *ctx, WireId src_wire, const std::vector<WireId> &dst_wires, bool useEstimate,
+                       std::vector<delay_t> *delays, std::unordered_map<WireId, PipId> *route)
+{
+    NPNR_ASSERT(!useEstimate || dst_wires.size() == 1);
+    struct Visit
+    {
+        delay_t delay;
+        PipId pip;
+        bool done;
+    };
+    FlatHashMap<WireId, Visit> visits;
+    FlatHashSet<WireId> pending;
+    pending.insert(dst_wires.begin(), dst_wires.end());
+    // (score, wire); entries whose score is out of date are skipped when popped
+    typedef std::pair<delay_t, WireId> QueueEntry;
+    auto greater = [](const QueueEntry &a, const QueueEntry &b) { return a.first > b.first; };
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, decltype(greater)> queue(greater);
+
+    auto score = [&](WireId wire, delay_t delay) {
+        return useEstimate ? delay + ctx->estimateDelay(wire, dst_wires.front()) : delay;
+    };
+    delay_t src_delay = ctx->getWireDelay(src_wire).maxDelay();
+    visits[src_wire] = Visit{src_delay, PipId(), false};
+    queue.emplace(score(src_wire, src_delay), src_wire);
+
+    while (!queue.empty() && !pending.empty()) {
+        WireId wire = queue.top().second;
+        queue.pop();
+        Visit &visit = visits.at(wire);
+        if (visit.done)
+            continue;
+        visit.done = true;
+        delay_t delay = visit.delay;
+        pending.erase(wire);
+        for (PipId pip : ctx->getPipsDownhill(wire)) {
+            WireId next = ctx->getPipDstWire(pip);
+            delay_t next_delay = delay + ctx->getPipDelay(pip).maxDelay() + ctx->getWireDelay(next).maxDelay();
+            auto fnd = visits.find(next);
+            if (fnd != visits.end()) {
+                if (fnd->second.done || fnd->second.delay <= next_delay)
+                    continue;
+                fnd->second.delay = next_delay;
+                fnd->second.pip = pip;
+            } else {
+                visits[next] = Visit{next_delay, pip, false};
+            }
+            queue.emplace(score(next, next_delay), next);
         }
+    }
 
-        if (fail)
-            return false;
+    int reached = 0;
+    if (delays != nullptr)
+        delays->assign(dst_wires.size(), -1);
+    for (size_t i = 0; i < dst_wires.size(); i++) {
+        auto fnd = visits.find(dst_wires[i]);
+        if (fnd == visits.end() || !fnd->second.done)
+            continue;
+        reached++;
+        if (delays != nullptr)
+            delays->at(i) = fnd->second.delay;
+        if (route != nullptr)
+            for (WireId cursor = dst_wires[i]; cursor != src_wire && !route->count(cursor);) {
+                PipId pip = visits.at(cursor).pip;
+                (*route)[cursor] = pip;
+                cursor = ctx->getPipSrcWire(pip);
+            }
     }
+    return reached;
+}
+} // namespace
 
+bool Context::getActualRouteDelay(WireId src_wire, WireId dst_wire, delay_t *delay,
+                                  std::unordered_map<WireId, PipId> *route, bool useEstimate) const
+{
+    std::vector<delay_t> delays;
+    if (route_delay_search(getCtx(), src_wire, std::vector<WireId>{dst_wire}, useEstimate, &delays, route) == 0)
+        return false;
+    if (delay != nullptr)
+        *delay = delays.front();
     return true;
 }
 
-bool Context::getActualRouteDelay(WireId src_wire, WireId dst_wire, delay_t *delay,
-                                  std::unordered_map<WireId, PipId> *route, bool useEstimate)
+int Context::getActualRouteDelays(WireId src_wire, const std::vector<WireId> &dst_wires,
+                                  std::vector<delay_t> *delays, std::unordered_map<WireId, PipId> *route) const
 {
-    // FIXME
-    return false;
+    return route_delay_search(getCtx(), src_wire, dst_wires, false, delays, route);
 }
 
 NEXTPNR_NAMESPACE_END
@@ -32,10 +32,24 @@ struct Router1Cfg
     bool cleanupReroute;
     bool fullCleanupReroute;
     bool useEstimate;
+    // Iterate over a flattened copy of the routing graph instead of querying the Arch for every pip
+    bool useRouteGraph;
     delay_t wireRipupPenalty;
     delay_t netRipupPenalty;
     delay_t reuseBonus;
     delay_t estimatePrecision;
+    // If non-zero, the A* search uses a bucket queue over costs quantised to this width, rather than a binary heap
+    delay_t queueBucketWidth;
+    // Number of threads searching batches of spatially disjoint arcs in parallel; 1 routes arcs one at a time
+    int threads;
+    // Wall clock time in seconds after which routing stops, restoring the routing with the fewest unrouted arcs
+    // seen; 0 for no limit
+    float timeBudget;
+    // If not negative, search for the route of an arc only within its bounding box (getRouteBoundingBox) padded by
+    // this many tiles, widening the box and searching again if no route is found there
+    int bbMargin;
+    // If the time budget runs out, finish routing from that state with router2 rather than failing
+    bool timeoutRouter2;
 };
 
 extern bool router1(Context *ctx, const Router1Cfg &cfg);
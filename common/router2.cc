@@ -28,20 +28,33 @@
 
 #include "router2.h"
 #include <algorithm>
-#include <boost/container/flat_map.hpp>
+#include <array>
+#include <atomic>
+#include <boost/algorithm/string/predicate.hpp>
 #include <chrono>
-#include <deque>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <numeric>
 #include <queue>
 #include "log.h"
 #include "nextpnr.h"
+#include "profiler.h"
+#include "route_graph.h"
 #include "router1.h"
+#include "router_lookahead.h"
+#include "search_queue.h"
 #include "timing.h"
 #include "util.h"
+#include "wire_indexer.h"
+#include "worker_pool.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
 namespace {
+
 struct Router2
 {
 
@@ -51,6 +64,8 @@ struct Router2
         ArcBounds bb;
         bool routed = false;
         float arc_crit = 0;
+        // Criticality of the arc when it was last routed
+        float routed_crit = 0;
     };
 
     // As we allow overlap at first; the nextpnr bind functions can't be used
@@ -74,33 +89,112 @@ struct Router2
         float total() const { return cost + togo_cost; }
     };
 
-    struct PerWireData
-    {
-        // nextpnr
-        WireId w;
-        // net --> number of arcs; driving pip
-        boost::container::flat_map<int, std::pair<int, PipId>> bound_nets;
-        // Historical congestion cost
-        float hist_cong_cost = 1.0;
-        // Wire is unavailable as locked to another arc
-        bool unavailable = false;
-        // This wire has to be used for this net
-        int reserved_net = -1;
-        // The notional location of the wire, to guarantee thread safety
-        int16_t x = 0, y = 0;
-        // Visit data
-        struct
+    // Use of a wire by a net: number of arcs; driving pip
+    struct WireBinding
+    {
+        int net = -1;
+        int uses = 0;
+        PipId pip;
+    };
+
+    // Nets currently using a wire. Almost all wires have at most one user, which is stored inline; the extra
+    // users of congested wires spill over into an out-of-line list
+    struct BoundNets
+    {
+        WireBinding first;
+        std::unique_ptr<std::vector<WireBinding>> overflow;
+
+        int size() const { return (first.net == -1) ? 0 : (1 + (overflow ? int(overflow->size()) : 0)); }
+        bool empty() const { return first.net == -1; }
+
+        WireBinding *find(int net)
+        {
+            if (first.net == net && net != -1)
+                return &first;
+            if (overflow)
+                for (auto &b : *overflow)
+                    if (b.net == net)
+                        return &b;
+            return nullptr;
+        }
+        const WireBinding *find(int net) const { return const_cast<BoundNets *>(this)->find(net); }
+        bool count(int net) const { return find(net) != nullptr; }
+        WireBinding &at(int net)
         {
-            bool dirty = false, visited = false;
-            PipId pip;
-            WireScore score;
-        } visit;
+            WireBinding *b = find(net);
+            NPNR_ASSERT(b != nullptr);
+            return *b;
+        }
+
+        // Returns the binding for a net, adding an unused one if the net isn't yet bound
+        WireBinding &get_or_add(int net)
+        {
+            WireBinding *b = find(net);
+            if (b != nullptr)
+                return *b;
+            if (first.net == -1) {
+                first = WireBinding();
+                first.net = net;
+                return first;
+            }
+            if (!overflow)
+                overflow.reset(new std::vector<WireBinding>());
+            overflow->emplace_back();
+            overflow->back().net = net;
+            return overflow->back();
+        }
+
+        void erase(int net)
+        {
+            if (first.net == net) {
+                if (overflow && !overflow->empty()) {
+                    first = overflow->back();
+                    overflow->pop_back();
+                } else {
+                    first = WireBinding();
+                }
+            } else if (overflow) {
+                for (auto &b : *overflow)
+                    if (b.net == net) {
+                        b = overflow->back();
+                        overflow->pop_back();
+                        break;
+                    }
+            }
+            if (overflow && overflow->empty())
+                overflow.reset();
+        }
+
+        template <typename Tf> void for_each(Tf func) const
+        {
+            if (first.net == -1)
+                return;
+            func(first);
+            if (overflow)
+                for (auto &b : *overflow)
+                    func(b);
+        }
     };
 
-    float present_wire_cost(const PerWireData &w, int net_uid)
+    // The notional location of the wire, to guarantee thread safety
+    struct WireLoc
     {
-        int other_sources = int(w.bound_nets.size());
-        if (w.bound_nets.count(net_uid))
+        int16_t x = 0, y = 0;
+    };
+
+    // A* visit data
+    struct WireVisit
+    {
+        PipId pip;
+        WireScore score;
+        bool dirty = false, visited = false;
+    };
+
+    float present_wire_cost(int wire, int net_uid)
+    {
+        auto &bound = wire_nets[wire];
+        int other_sources = bound.size();
+        if (bound.count(net_uid))
             other_sources -= 1;
         if (other_sources == 0)
             return 1.0f;
@@ -111,7 +205,11 @@ struct Router2
     Context *ctx;
     Router2Cfg cfg;
 
+#ifdef NPNR_DENSE_WIRE_INDEX
+    Router2(Context *ctx, const Router2Cfg &cfg) : ctx(ctx), cfg(cfg), indexer(ctx) {}
+#else
     Router2(Context *ctx, const Router2Cfg &cfg) : ctx(ctx), cfg(cfg) {}
+#endif
 
     // Use 'udata' for fast net lookups and indexing
     std::vector<NetInfo *> nets_by_udata;
@@ -121,6 +219,74 @@ struct Router2
 
     // Criticality data from timing analysis
     NetCriticalityMap net_crit;
+    std::unique_ptr<IncrementalCriticality> incr_timing;
+    // Nets whose routing has changed since criticalities were last updated by incr_timing
+    std::vector<NetInfo *> timing_changed_nets;
+
+    // Timing graph for repeated analysis, built on first use; the netlist is not changed while routing
+    std::unique_ptr<TimingGraph> timing_graph;
+    const TimingGraph *get_timing_graph()
+    {
+        if (!timing_graph)
+            timing_graph.reset(new TimingGraph(ctx));
+        return timing_graph.get();
+    }
+
+    void setup_net(size_t i)
+    {
+        NetInfo *ni = nets_by_udata.at(i);
+        nets.at(i).arcs.resize(ni->users.size());
+
+        // Start net bounding box at overall min/max
+        nets.at(i).bb.x0 = std::numeric_limits<int>::max();
+        nets.at(i).bb.x1 = std::numeric_limits<int>::min();
+        nets.at(i).bb.y0 = std::numeric_limits<int>::max();
+        nets.at(i).bb.y1 = std::numeric_limits<int>::min();
+        nets.at(i).cx = 0;
+        nets.at(i).cy = 0;
+
+        if (ni->driver.cell != nullptr) {
+            Loc drv_loc = ctx->getBelLocation(ni->driver.cell->bel);
+            nets.at(i).cx += drv_loc.x;
+            nets.at(i).cy += drv_loc.y;
+        }
+
+        for (size_t j = 0; j < ni->users.size(); j++) {
+            auto &usr = ni->users.at(j);
+            WireId src_wire = ctx->getNetinfoSourceWire(ni), dst_wire = ctx->getNetinfoSinkWire(ni, usr);
+            nets.at(i).src_wire = src_wire;
+            if (ni->driver.cell == nullptr)
+                src_wire = dst_wire;
+            if (ni->driver.cell == nullptr && dst_wire == WireId())
+                continue;
+            if (src_wire == WireId())
+                log_error("No wire found for port %s on source cell %s.\n", ctx->nameOf(ni->driver.port),
+                          ctx->nameOf(ni->driver.cell));
+            if (dst_wire == WireId())
+                log_error("No wire found for port %s on destination cell %s.\n", ctx->nameOf(usr.port),
+                          ctx->nameOf(usr.cell));
+            nets.at(i).arcs.at(j).sink_wire = dst_wire;
+            // Set bounding box for this arc
+            nets.at(i).arcs.at(j).bb = ctx->getRouteBoundingBox(src_wire, dst_wire);
+            // Expand net bounding box to include this arc
+            nets.at(i).bb.x0 = std::min(nets.at(i).bb.x0, nets.at(i).arcs.at(j).bb.x0);
+            nets.at(i).bb.x1 = std::max(nets.at(i).bb.x1, nets.at(i).arcs.at(j).bb.x1);
+            nets.at(i).bb.y0 = std::min(nets.at(i).bb.y0, nets.at(i).arcs.at(j).bb.y0);
+            nets.at(i).bb.y1 = std::max(nets.at(i).bb.y1, nets.at(i).arcs.at(j).bb.y1);
+            // Add location to centroid sum
+            Loc usr_loc = ctx->getBelLocation(usr.cell->bel);
+            nets.at(i).cx += usr_loc.x;
+            nets.at(i).cy += usr_loc.y;
+        }
+        nets.at(i).hpwl = std::max(
+                std::abs(nets.at(i).bb.y1 - nets.at(i).bb.y0) + std::abs(nets.at(i).bb.x1 - nets.at(i).bb.x0), 1);
+        nets.at(i).cx /= int(ni->users.size() + 1);
+        nets.at(i).cy /= int(ni->users.size() + 1);
+        if (ctx->debug)
+            log_info("%s: bb=(%d, %d)->(%d, %d) c=(%d, %d) hpwl=%d\n", ctx->nameOf(ni), nets.at(i).bb.x0,
+                     nets.at(i).bb.y0, nets.at(i).bb.x1, nets.at(i).bb.y1, nets.at(i).cx, nets.at(i).cy,
+                     nets.at(i).hpwl);
+    }
 
     void setup_nets()
     {
@@ -132,87 +298,241 @@ struct Router2
             NetInfo *ni = net.second;
             ni->udata = i;
             nets_by_udata.at(i) = ni;
-            nets.at(i).arcs.resize(ni->users.size());
-
-            // Start net bounding box at overall min/max
-            nets.at(i).bb.x0 = std::numeric_limits<int>::max();
-            nets.at(i).bb.x1 = std::numeric_limits<int>::min();
-            nets.at(i).bb.y0 = std::numeric_limits<int>::max();
-            nets.at(i).bb.y1 = std::numeric_limits<int>::min();
-            nets.at(i).cx = 0;
-            nets.at(i).cy = 0;
-
-            if (ni->driver.cell != nullptr) {
-                Loc drv_loc = ctx->getBelLocation(ni->driver.cell->bel);
-                nets.at(i).cx += drv_loc.x;
-                nets.at(i).cy += drv_loc.y;
-            }
-
-            for (size_t j = 0; j < ni->users.size(); j++) {
-                auto &usr = ni->users.at(j);
-                WireId src_wire = ctx->getNetinfoSourceWire(ni), dst_wire = ctx->getNetinfoSinkWire(ni, usr);
-                nets.at(i).src_wire = src_wire;
-                if (ni->driver.cell == nullptr)
-                    src_wire = dst_wire;
-                if (ni->driver.cell == nullptr && dst_wire == WireId())
-                    continue;
-                if (src_wire == WireId())
-                    log_error("No wire found for port %s on source cell %s.\n", ctx->nameOf(ni->driver.port),
-                              ctx->nameOf(ni->driver.cell));
-                if (dst_wire == WireId())
-                    log_error("No wire found for port %s on destination cell %s.\n", ctx->nameOf(usr.port),
-                              ctx->nameOf(usr.cell));
-                nets.at(i).arcs.at(j).sink_wire = dst_wire;
-                // Set bounding box for this arc
-                nets.at(i).arcs.at(j).bb = ctx->getRouteBoundingBox(src_wire, dst_wire);
-                // Expand net bounding box to include this arc
-                nets.at(i).bb.x0 = std::min(nets.at(i).bb.x0, nets.at(i).arcs.at(j).bb.x0);
-                nets.at(i).bb.x1 = std::max(nets.at(i).bb.x1, nets.at(i).arcs.at(j).bb.x1);
-                nets.at(i).bb.y0 = std::min(nets.at(i).bb.y0, nets.at(i).arcs.at(j).bb.y0);
-                nets.at(i).bb.y1 = std::max(nets.at(i).bb.y1, nets.at(i).arcs.at(j).bb.y1);
-                // Add location to centroid sum
-                Loc usr_loc = ctx->getBelLocation(usr.cell->bel);
-                nets.at(i).cx += usr_loc.x;
-                nets.at(i).cy += usr_loc.y;
-            }
-            nets.at(i).hpwl = std::max(
-                    std::abs(nets.at(i).bb.y1 - nets.at(i).bb.y0) + std::abs(nets.at(i).bb.x1 - nets.at(i).bb.x0), 1);
-            nets.at(i).cx /= int(ni->users.size() + 1);
-            nets.at(i).cy /= int(ni->users.size() + 1);
-            if (ctx->debug)
-                log_info("%s: bb=(%d, %d)->(%d, %d) c=(%d, %d) hpwl=%d\n", ctx->nameOf(ni), nets.at(i).bb.x0,
-                         nets.at(i).bb.y0, nets.at(i).bb.x1, nets.at(i).bb.y1, nets.at(i).cx, nets.at(i).cy,
-                         nets.at(i).hpwl);
             i++;
         }
+        // Each net only reads the Arch and its own NetInfo, and writes its own entries
+        parallel_chunks(int(nets.size()), [&](int begin, int end) {
+            for (int idx = begin; idx < end; idx++)
+                setup_net(idx);
+        });
     }
 
-    std::unordered_map<WireId, int> wire_to_idx;
-    std::vector<PerWireData> flat_wires;
+    // Per-wire data is kept in separate arrays indexed by a flat wire index, so that the inner loop of the
+    // router only streams through the data it actually needs
+#ifdef NPNR_DENSE_WIRE_INDEX
+    WireIndexer indexer;
+#else
+    FlatHashMap<WireId, int> wire_to_idx;
+#endif
+    std::vector<WireId> wire_ids;
+    std::vector<WireLoc> wire_locs;
+    std::vector<WireVisit> wire_visits;
+    std::vector<BoundNets> wire_nets;
+    // Wires that have had more than one net bound since the last update_congestion, so that it only has to look at
+    // these rather than the whole device. wire_overused marks the wires in the list; both are guarded by the mutex,
+    // as wires become overused on worker threads. That is rare enough for the lock not to be contended.
+    std::vector<int> overused_list;
+    std::vector<uint8_t> wire_overused;
+    std::mutex overused_mutex;
+    // Number of (wire, net) bindings
+    std::atomic<int> wire_use{0};
+    // Historical congestion cost
+    std::vector<float> wire_hist_cong;
+    // Wire is unavailable as locked to another arc
+    std::vector<uint8_t> wire_unavailable;
+    // This wire has to be used for this net
+    std::vector<int> wire_reserved_net;
+    // Lookahead class of the wire, if the lookahead is enabled
+    std::vector<int> wire_la_class;
+
+    std::unique_ptr<RouterLookahead> lookahead;
+    // Wire indices are shared with the graph, as both number wires in getWires() order
+    std::unique_ptr<RouteGraph> graph;
+
+#ifdef NPNR_DENSE_WIRE_INDEX
+    int wire_idx(WireId w) { return indexer(w); }
+#else
+    int wire_idx(WireId w) { return wire_to_idx.at(w); }
+#endif
+
+    // Run func(begin, end) over chunks of the range [0, n), split across the worker pool if there is one
+    template <typename Tf> void parallel_chunks(int n, Tf func)
+    {
+#ifndef NPNR_DISABLE_THREADS
+        // Debug output can't be interleaved from several threads
+        if (pool != nullptr && !ctx->debug) {
+            int chunks = std::min(n, 8 * pool->size());
+            std::vector<int> tasks(chunks);
+            std::iota(tasks.begin(), tasks.end(), 0);
+            pool->run(tasks, [&](int c) { func(int(int64_t(n) * c / chunks), int(int64_t(n) * (c + 1) / chunks)); });
+            return;
+        }
+#endif
+        func(0, n);
+    }
 
-    PerWireData &wire_data(WireId w) { return flat_wires[wire_to_idx.at(w)]; }
+    void setup_wire(int idx)
+    {
+        WireId wire = wire_ids[idx];
+        NetInfo *bound = ctx->getBoundWireNet(wire);
+        // In incremental mode, existing routing is instead imported arc by arc in import_routing
+        if (bound != nullptr && cfg.incremental && bound->wires.at(wire).strength <= STRENGTH_STRONG)
+            bound = nullptr;
+        if (bound != nullptr) {
+            auto &b = wire_nets[idx].get_or_add(bound->udata);
+            b.uses = 1;
+            wire_use.fetch_add(1, std::memory_order_relaxed);
+            b.pip = bound->wires.at(wire).pip;
+            if (bound->wires.at(wire).strength > STRENGTH_STRONG)
+                wire_unavailable[idx] = 1;
+        }
+
+        ArcBounds wire_loc = ctx->getRouteBoundingBox(wire, wire);
+        WireLoc &loc = wire_locs[idx];
+        loc.x = (wire_loc.x0 + wire_loc.x1) / 2;
+        loc.y = (wire_loc.y0 + wire_loc.y1) / 2;
+        if (lookahead)
+            wire_la_class[idx] = lookahead->wire_class(wire);
+    }
 
     void setup_wires()
     {
         // Set up per-wire structures, so that MT parts don't have to do any memory allocation
-        // This is possibly quite wasteful and not cache-optimal; further consideration necessary
         for (auto wire : ctx->getWires()) {
-            PerWireData pwd;
-            pwd.w = wire;
-            NetInfo *bound = ctx->getBoundWireNet(wire);
-            if (bound != nullptr) {
-                pwd.bound_nets[bound->udata] = std::make_pair(1, bound->wires.at(wire).pip);
-                if (bound->wires.at(wire).strength > STRENGTH_STRONG)
-                    pwd.unavailable = true;
+            NPNR_ASSERT(graph == nullptr || graph->wire(int(wire_ids.size())) == wire);
+#ifdef NPNR_DENSE_WIRE_INDEX
+            NPNR_ASSERT(indexer(wire) == int(wire_ids.size()));
+#else
+            wire_to_idx[wire] = int(wire_ids.size());
+#endif
+            wire_ids.push_back(wire);
+        }
+        int n = int(wire_ids.size());
+        wire_nets.resize(n);
+        wire_hist_cong.resize(n, 1.0f);
+        wire_overused.resize(n, 0);
+        wire_unavailable.resize(n, 0);
+        wire_reserved_net.resize(n, -1);
+        wire_locs.resize(n);
+        if (lookahead)
+            wire_la_class.resize(n);
+        wire_visits.resize(n);
+        // The rest of the setup of each wire only reads the Arch and writes that wire's own entries
+        parallel_chunks(n, [&](int begin, int end) {
+            for (int idx = begin; idx < end; idx++)
+                setup_wire(idx);
+        });
+    }
+
+    // Walk back from the sink of an arc through the existing nextpnr routing of the net. Returns false if this
+    // doesn't reach the current source wire; e.g. because the arc is unrouted or one of its endpoints moved
+    bool trace_existing_arc(NetInfo *net, size_t user, std::vector<std::pair<WireId, PipId>> &path)
+    {
+        path.clear();
+        WireId src = ctx->getNetinfoSourceWire(net);
+        WireId cursor = nets.at(net->udata).arcs.at(user).sink_wire;
+        if (src == WireId() || cursor == WireId())
+            return false;
+        while (true) {
+            auto fnd = net->wires.find(cursor);
+            if (fnd == net->wires.end())
+                return false;
+            PipId pip = fnd->second.pip;
+            path.emplace_back(cursor, pip);
+            if (cursor == src)
+                return pip == PipId();
+            // Reached the root of the routing tree without finding the source, or looped
+            if (pip == PipId() || path.size() > net->wires.size())
+                return false;
+            cursor = ctx->getPipSrcWire(pip);
+        }
+    }
+
+    // Incremental mode (before setup_wires): find which arcs are still legally routed, and release any routing
+    // that is no longer part of one of them, e.g. branches to sinks that have moved
+    struct PreservedArc
+    {
+        NetInfo *net;
+        size_t user;
+        std::vector<std::pair<WireId, PipId>> path;
+    };
+    std::vector<PreservedArc> preserved_arcs;
+
+    void find_preserved_routing()
+    {
+        int total_arcs = 0;
+        std::vector<std::pair<WireId, PipId>> path;
+        std::unordered_set<WireId> keep_wires;
+        std::vector<WireId> stray_wires;
+        for (auto ni : nets_by_udata) {
+#ifdef ARCH_ECP5
+            if (ni->is_global)
+                continue;
+#endif
+            keep_wires.clear();
+            stray_wires.clear();
+            for (size_t i = 0; i < ni->users.size(); i++) {
+                ++total_arcs;
+                if (!trace_existing_arc(ni, i, path))
+                    continue;
+                for (auto &step : path)
+                    keep_wires.insert(step.first);
+                preserved_arcs.push_back(PreservedArc{ni, i, path});
             }
+            for (auto &w : ni->wires)
+                if (w.second.strength <= STRENGTH_STRONG && !keep_wires.count(w.first))
+                    stray_wires.push_back(w.first);
+            for (auto w : stray_wires)
+                ctx->unbindWire(w);
+        }
+        log_info("    preserving %d/%d already routed arcs\n", int(preserved_arcs.size()), total_arcs);
+    }
 
-            ArcBounds wire_loc = ctx->getRouteBoundingBox(wire, wire);
-            pwd.x = (wire_loc.x0 + wire_loc.x1) / 2;
-            pwd.y = (wire_loc.y0 + wire_loc.y1) / 2;
+    // A preserved route can't be kept if it uses a wire that is reserved for the dedicated path of another net, or
+    // locked to another net
+    bool preserved_arc_conflicts(const PreservedArc &pa)
+    {
+        for (auto &step : pa.path) {
+            int idx = wire_idx(step.first);
+            if (wire_reserved_net[idx] != -1 && wire_reserved_net[idx] != pa.net->udata)
+                return true;
+            if (wire_unavailable[idx] && !wire_nets[idx].count(pa.net->udata))
+                return true;
+        }
+        return false;
+    }
 
-            wire_to_idx[wire] = int(flat_wires.size());
-            flat_wires.push_back(pwd);
+    // Incremental mode (after setup_wires and find_all_reserved_wires): import the preserved routes into the
+    // router's own structures. Conflicting arcs are left unrouted, and their routing is released unless another
+    // preserved arc of the same net still uses it
+    void import_routing()
+    {
+        int dropped = 0;
+        std::unordered_set<WireId> keep_wires;
+        std::vector<WireId> stray_wires;
+        size_t end = 0;
+        for (size_t begin = 0; begin < preserved_arcs.size(); begin = end) {
+            // Arcs were preserved net by net
+            NetInfo *net = preserved_arcs.at(begin).net;
+            for (end = begin; end < preserved_arcs.size() && preserved_arcs.at(end).net == net; end++)
+                ;
+            keep_wires.clear();
+            bool net_dropped = false;
+            for (size_t i = begin; i < end; i++) {
+                auto &pa = preserved_arcs.at(i);
+                if (preserved_arc_conflicts(pa)) {
+                    ++dropped;
+                    net_dropped = true;
+                    continue;
+                }
+                for (auto &step : pa.path) {
+                    bind_pip_internal(pa.net, pa.user, wire_idx(step.first), step.second);
+                    keep_wires.insert(step.first);
+                }
+                nets.at(pa.net->udata).arcs.at(pa.user).routed = true;
+            }
+            if (!net_dropped)
+                continue;
+            stray_wires.clear();
+            for (auto &w : net->wires)
+                if (w.second.strength <= STRENGTH_STRONG && !keep_wires.count(w.first))
+                    stray_wires.push_back(w.first);
+            for (auto w : stray_wires)
+                ctx->unbindWire(w);
         }
+        if (dropped > 0)
+            log_info("    %d preserved arcs conflict with reserved or locked wires and will be rerouted\n", dropped);
+        preserved_arcs.clear();
     }
 
     struct QueuedWire
@@ -237,6 +557,11 @@ struct Router2
                 return lhs_score == rhs_score ? lhs.randtag > rhs.randtag : lhs_score > rhs_score;
             }
         };
+
+        struct Cost
+        {
+            float operator()(const QueuedWire &w) const noexcept { return w.score.cost + w.score.togo_cost; }
+        };
     };
 
     bool hit_test_pip(ArcBounds &bb, Loc l)
@@ -247,6 +572,130 @@ struct Router2
 
     double curr_cong_weight, hist_cong_weight, estimate_weight;
 
+    // Backwards search statistics are kept per class of net: global or not, and a fanout bucket
+    static const int BWD_FANOUT_BUCKETS = 5;
+    static const int BWD_CLASS_COUNT = 2 * BWD_FANOUT_BUCKETS;
+    static const int BWD_HIST_BUCKETS = 16;
+    // One in this many backwards searches always gets the full budget, so that the iterations needed to succeed
+    // keep being sampled without the bias of a reduced budget
+    static const int BWD_PROBE_INTERVAL = 16;
+    // Number of full budget searches in a class before its budget is adapted
+    static const int BWD_MIN_SAMPLES = 32;
+
+    struct BackwardsStats
+    {
+        int attempts = 0, hits = 0;
+        int full_attempts = 0;
+        int64_t iters = 0;
+        // Iterations needed by successful full budget searches, in power of two buckets
+        std::array<int, BWD_HIST_BUCKETS> hit_iters{};
+
+        void merge(const BackwardsStats &other)
+        {
+            attempts += other.attempts;
+            hits += other.hits;
+            full_attempts += other.full_attempts;
+            iters += other.iters;
+            for (int i = 0; i < BWD_HIST_BUCKETS; i++)
+                hit_iters[i] += other.hit_iters[i];
+        }
+    };
+
+    // Cumulative statistics over the run, and those of the current iteration
+    std::array<BackwardsStats, BWD_CLASS_COUNT> bwd_totals, bwd_iter_stats;
+    // A* queue entries expanded by all threads over the run
+    int64_t total_expanded = 0;
+    // Current budget of each class
+    std::array<int, BWD_CLASS_COUNT> bwd_budget;
+
+    int bwd_class(NetInfo *net)
+    {
+        int users = int(net->users.size());
+        int bucket = (users <= 1) ? 0 : (users <= 4) ? 1 : (users <= 16) ? 2 : (users <= 64) ? 3 : 4;
+        bool global = net->driver.cell != nullptr && ctx->getBelGlobalBuf(net->driver.cell->bel);
+        return (global ? BWD_FANOUT_BUCKETS : 0) + bucket;
+    }
+
+    int bwd_full_budget(int cls)
+    {
+        return cls >= BWD_FANOUT_BUCKETS ? cfg.global_backwards_max_iter : cfg.backwards_max_iter;
+    }
+
+    static int bwd_hist_bucket(int iters)
+    {
+        int b = 0;
+        while (b < BWD_HIST_BUCKETS - 1 && (1 << b) < iters)
+            ++b;
+        return b;
+    }
+
+    void update_bwd_budgets()
+    {
+        for (int c = 0; c < BWD_CLASS_COUNT; c++) {
+            int full = bwd_full_budget(c);
+            auto &bs = bwd_totals[c];
+            if (!cfg.adaptive_backwards || bs.full_attempts < BWD_MIN_SAMPLES) {
+                bwd_budget[c] = full;
+                continue;
+            }
+            // Enough iterations for 95% of the searches that succeeded with the full budget
+            int full_hits = 0;
+            for (int b = 0; b < BWD_HIST_BUCKETS; b++)
+                full_hits += bs.hit_iters[b];
+            int budget = 0, covered = 0;
+            for (int b = 0; b < BWD_HIST_BUCKETS && covered * 20 < full_hits * 19; b++) {
+                covered += bs.hit_iters[b];
+                budget = 1 << b;
+            }
+            bwd_budget[c] = std::min(budget, full);
+        }
+    }
+
+    void log_bwd_stats()
+    {
+        static const char *fanout_names[BWD_FANOUT_BUCKETS] = {"1", "2-4", "5-16", "17-64", "65+"};
+        for (int c = 0; c < BWD_CLASS_COUNT; c++) {
+            auto &bs = bwd_totals[c];
+            if (bs.attempts == 0)
+                continue;
+            log_info("        bwd %s fanout %5s: %d/%d hits (%.1f%%), %.1f iters/search, budget %d\n",
+                     c >= BWD_FANOUT_BUCKETS ? "global" : "local ", fanout_names[c % BWD_FANOUT_BUCKETS], bs.hits,
+                     bs.attempts, (100.0 * bs.hits) / bs.attempts, double(bs.iters) / bs.attempts, bwd_budget[c]);
+        }
+    }
+
+    // Wire on the trunk of a split high fanout net that the arcs of a cluster may start from
+    struct TrunkSeed
+    {
+        int wire;
+        delay_t delay;
+    };
+
+    // Arcs of a split high fanout net with sinks in one partition bin
+    struct HfnCluster
+    {
+        NetInfo *net;
+        std::vector<size_t> arcs;
+        // Trunk wires within the bin
+        std::vector<TrunkSeed> seeds;
+    };
+
+    // Arc routed from a trunk wire; the wires from there back to the source are bound once the phase completes
+    struct HfnPrefix
+    {
+        NetInfo *net;
+        size_t user;
+        int wire;
+    };
+
+    struct DeferredArc
+    {
+        NetInfo *net;
+        size_t user;
+        // (wire, driving pip) from sink to source
+        std::vector<std::pair<int, PipId>> path;
+    };
+
     struct ThreadContext
     {
         // Nets to route
@@ -256,7 +705,7 @@ struct Router2
 
         std::vector<int> route_arcs;
 
-        std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> queue;
+        SearchQueue<QueuedWire, QueuedWire::Greater, QueuedWire::Cost> queue;
         // Special case where one net has multiple logical arcs to the same physical sink
         std::unordered_set<WireId> processed_sinks;
 
@@ -265,14 +714,37 @@ struct Router2
 
         std::vector<int> dirty_wires;
 
+        // Visit data for searches that leave the thread bounding box; kept per-thread as the shared visit
+        // data of wires outside the box belongs to other threads
+        std::unordered_map<int, WireVisit> local_visits;
+        // Arcs routed partly outside of the thread bounding box; these are bound once the phase completes
+        std::vector<DeferredArc> deferred_arcs;
+
+        std::array<BackwardsStats, BWD_CLASS_COUNT> bwd_stats;
+        int bwd_searches = 0;
+
+        // High fanout net clusters to route, as indices into hfn_clusters
+        std::vector<int> hfn_jobs;
+        // If set, searches start from these trunk wires rather than the source
+        const std::vector<TrunkSeed> *hfn_seeds = nullptr;
+        std::vector<HfnPrefix> hfn_prefixes;
+
+        // Instrumentation, only recorded if a stats file is being written: per tile A* expansions and ripups
+        std::vector<int> tile_expanded, tile_ripups;
+        int64_t route_us = 0;
+        int routed_nets = 0;
+        // A* queue entries expanded
+        int64_t expanded = 0;
+
         // Thread bounding box
         ArcBounds bb;
 
         DeterministicRNG rng;
     };
 
-    bool thread_test_wire(ThreadContext &t, PerWireData &w)
+    bool thread_test_wire(ThreadContext &t, int wire)
     {
+        const WireLoc &w = wire_locs[wire];
         return w.x >= t.bb.x0 && w.x <= t.bb.x1 && w.y >= t.bb.y0 && w.y <= t.bb.y1;
     }
 
@@ -291,29 +763,41 @@ struct Router2
         else                                                                                                           \
             log_error(__VA_ARGS__);                                                                                    \
     } while (0)
-#define ROUTE_LOG_DBG(...)                                                                                             \
-    do {                                                                                                               \
-        if (!is_mt && ctx->debug)                                                                                      \
-            log(__VA_ARGS__);                                                                                          \
-    } while (0)
+// Logging is safe from worker threads, though their messages interleave
+#define ROUTE_LOG_DBG(...) log_debug_if(ctx->debug, __VA_ARGS__)
+
+    void mark_overused(int wire)
+    {
+        std::lock_guard<std::mutex> lock(overused_mutex);
+        if (wire_overused[wire])
+            return;
+        wire_overused[wire] = 1;
+        overused_list.push_back(wire);
+    }
 
     void bind_pip_internal(NetInfo *net, size_t user, int wire, PipId pip)
     {
-        auto &b = flat_wires.at(wire).bound_nets[net->udata];
-        ++b.first;
-        if (b.first == 1) {
-            b.second = pip;
+        auto &bound = wire_nets.at(wire);
+        auto &b = bound.get_or_add(net->udata);
+        ++b.uses;
+        if (b.uses == 1) {
+            b.pip = pip;
+            wire_use.fetch_add(1, std::memory_order_relaxed);
+            if (bound.size() > 1)
+                mark_overused(wire);
         } else {
-            NPNR_ASSERT(b.second == pip);
+            NPNR_ASSERT(b.pip == pip);
         }
     }
 
     void unbind_pip_internal(NetInfo *net, size_t user, WireId wire)
     {
-        auto &b = wire_data(wire).bound_nets.at(net->udata);
-        --b.first;
-        if (b.first == 0) {
-            wire_data(wire).bound_nets.erase(net->udata);
+        auto &bound = wire_nets.at(wire_idx(wire));
+        auto &b = bound.at(net->udata);
+        --b.uses;
+        if (b.uses == 0) {
+            bound.erase(net->udata);
+            wire_use.fetch_sub(1, std::memory_order_relaxed);
         }
     }
 
@@ -325,31 +809,47 @@ struct Router2
         WireId src = nets.at(net->udata).src_wire;
         WireId cursor = ad.sink_wire;
         while (cursor != src) {
-            auto &wd = wire_data(cursor);
-            PipId pip = wd.bound_nets.at(net->udata).second;
+            PipId pip = wire_nets.at(wire_idx(cursor)).at(net->udata).pip;
             unbind_pip_internal(net, user, cursor);
             cursor = ctx->getPipSrcWire(pip);
         }
         ad.routed = false;
     }
 
+    int tile_index(int wire)
+    {
+        const WireLoc &l = wire_locs[wire];
+        int x = std::min<int>(std::max<int>(l.x, 0), ctx->getGridDimX() - 1);
+        int y = std::min<int>(std::max<int>(l.y, 0), ctx->getGridDimY() - 1);
+        return y * ctx->getGridDimX() + x;
+    }
+
+    void record_ripup(ThreadContext &t, NetInfo *net, size_t user)
+    {
+        auto &ad = nets.at(net->udata).arcs.at(user);
+        if (ad.routed && !t.tile_ripups.empty())
+            ++t.tile_ripups[tile_index(wire_idx(ad.sink_wire))];
+    }
+
     float score_wire_for_arc(NetInfo *net, size_t user, WireId wire, PipId pip)
     {
-        auto &wd = wire_data(wire);
+        int idx = wire_idx(wire);
+        auto &bound_nets = wire_nets[idx];
         auto &nd = nets.at(net->udata);
         float base_cost = ctx->getDelayNS(ctx->getPipDelay(pip).maxDelay() + ctx->getWireDelay(wire).maxDelay() +
                                           ctx->getDelayEpsilon());
-        float present_cost = present_wire_cost(wd, net->udata);
-        float hist_cost = wd.hist_cong_cost;
+        float present_cost = present_wire_cost(idx, net->udata);
+        float hist_cost = wire_hist_cong[idx];
         float bias_cost = 0;
         int source_uses = 0;
-        if (wd.bound_nets.count(net->udata))
-            source_uses = wd.bound_nets.at(net->udata).first;
+        if (auto b = bound_nets.find(net->udata))
+            source_uses = b->uses;
         if (timing_driven) {
             float max_bound_crit = 0;
-            for (auto &bound : wd.bound_nets)
-                if (bound.first != net->udata)
-                    max_bound_crit = std::max(max_bound_crit, nets.at(bound.first).max_crit);
+            bound_nets.for_each([&](const WireBinding &b) {
+                if (b.net != net->udata)
+                    max_bound_crit = std::max(max_bound_crit, nets.at(b.net).max_crit);
+            });
             if (max_bound_crit >= 0.8 && nd.arcs.at(user).arc_crit < (max_bound_crit + 0.01)) {
                 present_cost *= 1.5;
             }
@@ -359,17 +859,51 @@ struct Router2
             bias_cost = cfg.bias_cost_factor * (base_cost / int(net->users.size())) *
                         ((std::abs(pl.x - nd.cx) + std::abs(pl.y - nd.cy)) / float(nd.hpwl));
         }
-        return base_cost * hist_cost * present_cost / (1 + source_uses) + bias_cost;
+        float cong_cost = base_cost * hist_cost * present_cost / (1 + source_uses) + bias_cost;
+        if (timing_driven && cfg.crit_weight > 0) {
+            float crit_w = cfg.crit_weight * nd.arcs.at(user).arc_crit;
+            return (1 - crit_w) * cong_cost + crit_w * base_cost;
+        }
+        return cong_cost;
+    }
+
+    float estimate_togo_ns(int wire, int sink)
+    {
+        if (lookahead) {
+            const WireLoc &wl = wire_locs[wire], &sl = wire_locs[sink];
+            return ctx->getDelayNS(lookahead->estimate(wire_la_class[wire], sl.x - wl.x, sl.y - wl.y).cost);
+        }
+        return ctx->getDelayNS(ctx->estimateDelay(wire_ids[wire], wire_ids[sink]));
     }
 
-    float get_togo_cost(NetInfo *net, size_t user, int wire, WireId sink)
+    float get_togo_cost(NetInfo *net, size_t user, int wire, int sink)
     {
-        auto &wd = flat_wires[wire];
         int source_uses = 0;
-        if (wd.bound_nets.count(net->udata))
-            source_uses = wd.bound_nets.at(net->udata).first;
+        if (auto b = wire_nets[wire].find(net->udata))
+            source_uses = b->uses;
         // FIXME: timing/wirelength balance?
-        return (ctx->getDelayNS(ctx->estimateDelay(wd.w, sink)) / (1 + source_uses)) + cfg.ipin_cost_adder;
+        return (estimate_togo_ns(wire, sink) / (1 + source_uses)) + cfg.ipin_cost_adder;
+    }
+
+    // Delay of an arc through the wires it is currently routed through, or the Arch route delay if it isn't routed
+    delay_t arc_delay(const NetInfo *net, int user)
+    {
+        if (net->udata >= 0 && net->udata < int(nets.size()) && nets_by_udata.at(net->udata) == net &&
+            user < int(nets.at(net->udata).arcs.size()) && nets.at(net->udata).arcs.at(user).routed) {
+            auto &nd = nets.at(net->udata);
+            WireId cursor = nd.arcs.at(user).sink_wire;
+            delay_t delay = 0;
+            while (cursor != nd.src_wire) {
+                auto b = wire_nets.at(wire_idx(cursor)).find(net->udata);
+                if (b == nullptr || b->pip == PipId())
+                    break;
+                delay += ctx->getPipDelay(b->pip).maxDelay() + ctx->getWireDelay(cursor).maxDelay();
+                cursor = ctx->getPipSrcWire(b->pip);
+            }
+            if (cursor == nd.src_wire)
+                return delay + ctx->getWireDelay(nd.src_wire).maxDelay();
+        }
+        return ctx->getNetinfoRouteDelay(net, net->users.at(user));
     }
 
     bool check_arc_routing(NetInfo *net, size_t usr)
@@ -377,11 +911,11 @@ struct Router2
         auto &ad = nets.at(net->udata).arcs.at(usr);
         WireId src_wire = nets.at(net->udata).src_wire;
         WireId cursor = ad.sink_wire;
-        while (wire_data(cursor).bound_nets.count(net->udata)) {
-            auto &wd = wire_data(cursor);
-            if (wd.bound_nets.size() != 1)
+        while (wire_nets.at(wire_idx(cursor)).count(net->udata)) {
+            auto &bound = wire_nets.at(wire_idx(cursor));
+            if (bound.size() != 1)
                 return false;
-            auto &uh = wd.bound_nets.at(net->udata).second;
+            auto &uh = bound.at(net->udata).pip;
             if (uh == PipId())
                 break;
             cursor = ctx->getPipSrcWire(uh);
@@ -401,29 +935,42 @@ struct Router2
         return true;
     }
 
-    // Find all the wires that must be used to route a given arc
-    void reserve_wires_for_arc(NetInfo *net, size_t i)
+    // Result of is_wire_undriveable for each wire while reserved wires are found: -1 if not yet known. Entries may be
+    // computed by several threads at once, which is harmless as they all get the same answer.
+    std::vector<std::atomic<int8_t>> undriveable_cache;
+
+    bool is_wire_undriveable_cached(WireId wire)
+    {
+        auto &entry = undriveable_cache.at(wire_idx(wire));
+        int8_t result = entry.load(std::memory_order_relaxed);
+        if (result == -1) {
+            result = is_wire_undriveable(wire) ? 1 : 0;
+            entry.store(result, std::memory_order_relaxed);
+        }
+        return result == 1;
+    }
+
+    // Find all the wires that must be used to route a given arc, adding their indices to rsv
+    void reserve_wires_for_arc(NetInfo *net, size_t i, std::vector<int> &rsv)
     {
         WireId src = ctx->getNetinfoSourceWire(net);
         WireId sink = ctx->getNetinfoSinkWire(net, net->users.at(i));
         if (sink == WireId())
             return;
-        std::unordered_set<WireId> rsv;
         WireId cursor = sink;
         bool done = false;
         if (ctx->debug)
             log("reserving wires for arc %d of net %s\n", int(i), ctx->nameOf(net));
         while (!done) {
-            auto &wd = wire_data(cursor);
             if (ctx->debug)
                 log("      %s\n", ctx->nameOfWire(cursor));
-            wd.reserved_net = net->udata;
+            rsv.push_back(wire_idx(cursor));
             if (cursor == src)
                 break;
             WireId next_cursor;
             for (auto uh : ctx->getPipsUphill(cursor)) {
                 WireId w = ctx->getPipSrcWire(uh);
-                if (is_wire_undriveable(w))
+                if (is_wire_undriveable_cached(w))
                     continue;
                 if (next_cursor != WireId()) {
                     done = true;
@@ -439,29 +986,37 @@ struct Router2
 
     void find_all_reserved_wires()
     {
-        for (auto net : nets_by_udata) {
-            WireId src = ctx->getNetinfoSourceWire(net);
-            if (src == WireId())
-                continue;
-            for (size_t i = 0; i < net->users.size(); i++)
-                reserve_wires_for_arc(net, i);
-        }
+        // The search only reads the Arch, so nets are searched in parallel; the reservations are then applied in net
+        // order, so that where the wires of two nets overlap the result doesn't depend on the threading
+        std::vector<std::vector<int>> net_rsv(nets_by_udata.size());
+        undriveable_cache = std::vector<std::atomic<int8_t>>(wire_nets.size());
+        for (auto &entry : undriveable_cache)
+            entry.store(-1, std::memory_order_relaxed);
+        parallel_chunks(int(nets_by_udata.size()), [&](int begin, int end) {
+            for (int n = begin; n < end; n++) {
+                NetInfo *net = nets_by_udata.at(n);
+                if (ctx->getNetinfoSourceWire(net) == WireId())
+                    continue;
+                for (size_t i = 0; i < net->users.size(); i++)
+                    reserve_wires_for_arc(net, i, net_rsv.at(n));
+            }
+        });
+        undriveable_cache = std::vector<std::atomic<int8_t>>();
+        for (size_t n = 0; n < net_rsv.size(); n++)
+            for (int wire : net_rsv.at(n))
+                wire_reserved_net.at(wire) = int(n);
     }
 
     void reset_wires(ThreadContext &t)
     {
-        for (auto w : t.dirty_wires) {
-            flat_wires[w].visit.visited = false;
-            flat_wires[w].visit.dirty = false;
-            flat_wires[w].visit.pip = PipId();
-            flat_wires[w].visit.score = WireScore();
-        }
+        for (auto w : t.dirty_wires)
+            wire_visits[w] = WireVisit();
         t.dirty_wires.clear();
     }
 
     void set_visited(ThreadContext &t, int wire, PipId pip, WireScore score)
     {
-        auto &v = flat_wires.at(wire).visit;
+        auto &v = wire_visits.at(wire);
         if (!v.dirty)
             t.dirty_wires.push_back(wire);
         v.dirty = true;
@@ -469,7 +1024,7 @@ struct Router2
         v.pip = pip;
         v.score = score;
     }
-    bool was_visited(int wire) { return flat_wires.at(wire).visit.visited; }
+    bool was_visited(int wire) { return wire_visits.at(wire).visited; }
 
     ArcRouteResult route_arc(ThreadContext &t, NetInfo *net, size_t i, bool is_mt, bool is_bb = true)
     {
@@ -486,16 +1041,14 @@ struct Router2
         if (dst_wire == WireId())
             ARC_LOG_ERR("No wire found for port %s on destination cell %s.\n", ctx->nameOf(usr.port),
                         ctx->nameOf(usr.cell));
-        int src_wire_idx = wire_to_idx.at(src_wire);
-        int dst_wire_idx = wire_to_idx.at(dst_wire);
+        int src_wire_idx = wire_idx(src_wire);
+        int dst_wire_idx = wire_idx(dst_wire);
         // Check if arc was already done _in this iteration_
         if (t.processed_sinks.count(dst_wire))
             return ARC_SUCCESS;
 
-        if (!t.queue.empty()) {
-            std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> new_queue;
-            t.queue.swap(new_queue);
-        }
+        t.queue.clear();
+        t.queue.set_bucket_width(cfg.queue_bucket_width);
         if (!t.backwards_queue.empty()) {
             std::queue<int> new_queue;
             t.backwards_queue.swap(new_queue);
@@ -505,62 +1058,67 @@ struct Router2
         // and comes at a minimal performance cost for the others
         // This could also be used to speed up forwards routing by a hybrid
         // bidirectional approach
+        // The budget is adapted per class of net from how many iterations earlier successful searches needed
         int backwards_iter = 0;
-        int backwards_limit =
-                ctx->getBelGlobalBuf(net->driver.cell->bel) ? cfg.global_backwards_max_iter : cfg.backwards_max_iter;
-        t.backwards_queue.push(wire_to_idx.at(dst_wire));
-        while (!t.backwards_queue.empty() && backwards_iter < backwards_limit) {
+        int bwd_cls = bwd_class(net);
+        // Searches from a trunk can't merge backwards, as that needs the routing outside of the thread box
+        int full_limit = (t.hfn_seeds != nullptr) ? 0 : bwd_full_budget(bwd_cls);
+        int backwards_limit = full_limit;
+        if (full_limit > 0 && (++t.bwd_searches % BWD_PROBE_INTERVAL) != 0)
+            backwards_limit = bwd_budget[bwd_cls];
+        t.backwards_queue.push(wire_idx(dst_wire));
+        while (!t.backwards_queue.empty() && backwards_iter < backwards_limit && !was_visited(src_wire_idx)) {
             int cursor = t.backwards_queue.front();
             t.backwards_queue.pop();
-            auto &cwd = flat_wires[cursor];
+            auto &cbound = wire_nets[cursor];
             PipId cpip;
-            if (cwd.bound_nets.count(net->udata)) {
+            if (cbound.count(net->udata)) {
                 // If we can tack onto existing routing; try that
                 // Only do this if the existing routing is uncontented; however
                 int cursor2 = cursor;
                 bool bwd_merge_fail = false;
-                while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
-                    if (flat_wires.at(cursor2).bound_nets.size() > 1) {
+                while (wire_nets.at(cursor2).count(net->udata)) {
+                    if (wire_nets.at(cursor2).size() > 1) {
                         bwd_merge_fail = true;
                         break;
                     }
-                    PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
+                    PipId p = wire_nets.at(cursor2).at(net->udata).pip;
                     if (p == PipId())
                         break;
-                    cursor2 = wire_to_idx.at(ctx->getPipSrcWire(p));
+                    cursor2 = wire_idx(ctx->getPipSrcWire(p));
                 }
                 if (!bwd_merge_fail && cursor2 == src_wire_idx) {
                     // Found a path to merge to existing routing; backwards
                     cursor2 = cursor;
-                    while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
-                        PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
+                    while (wire_nets.at(cursor2).count(net->udata)) {
+                        PipId p = wire_nets.at(cursor2).at(net->udata).pip;
                         if (p == PipId())
                             break;
-                        cursor2 = wire_to_idx.at(ctx->getPipSrcWire(p));
+                        cursor2 = wire_idx(ctx->getPipSrcWire(p));
                         set_visited(t, cursor2, p, WireScore());
                     }
                     break;
                 }
-                cpip = cwd.bound_nets.at(net->udata).second;
+                cpip = cbound.at(net->udata).pip;
             }
             bool did_something = false;
-            for (auto uh : ctx->getPipsUphill(flat_wires[cursor].w)) {
+            for (auto uh : ctx->getPipsUphill(wire_ids[cursor])) {
                 did_something = true;
                 if (!ctx->checkPipAvail(uh) && ctx->getBoundPipNet(uh) != net)
                     continue;
                 if (cpip != PipId() && cpip != uh)
                     continue; // don't allow multiple pips driving a wire with a net
-                int next = wire_to_idx.at(ctx->getPipSrcWire(uh));
+                int next = wire_idx(ctx->getPipSrcWire(uh));
                 if (was_visited(next))
                     continue; // skip wires that have already been visited
-                auto &wd = flat_wires[next];
-                if (wd.unavailable)
+                if (wire_unavailable[next])
                     continue;
-                if (wd.reserved_net != -1 && wd.reserved_net != net->udata)
+                if (wire_reserved_net[next] != -1 && wire_reserved_net[next] != net->udata)
                     continue;
-                if (wd.bound_nets.size() > 1 || (wd.bound_nets.size() == 1 && !wd.bound_nets.count(net->udata)))
+                auto &bound = wire_nets[next];
+                if (bound.size() > 1 || (bound.size() == 1 && !bound.count(net->udata)))
                     continue; // never allow congestion in backwards routing
-                if (!thread_test_wire(t, wd))
+                if (!thread_test_wire(t, next))
                     continue; // thread safety issue
                 t.backwards_queue.push(next);
                 set_visited(t, next, uh, WireScore());
@@ -568,19 +1126,31 @@ struct Router2
             if (did_something)
                 ++backwards_iter;
         }
+        bool bwd_hit = was_visited(src_wire_idx);
+        if (full_limit > 0) {
+            auto &bs = t.bwd_stats[bwd_cls];
+            ++bs.attempts;
+            bs.iters += backwards_iter;
+            if (bwd_hit)
+                ++bs.hits;
+            if (backwards_limit == full_limit) {
+                ++bs.full_attempts;
+                if (bwd_hit)
+                    ++bs.hit_iters[bwd_hist_bucket(backwards_iter + 1)];
+            }
+        }
         // Check if backwards routing succeeded in reaching source
-        if (was_visited(src_wire_idx)) {
+        if (bwd_hit) {
             ROUTE_LOG_DBG("   Routed (backwards): ");
             int cursor_fwd = src_wire_idx;
             bind_pip_internal(net, i, src_wire_idx, PipId());
             while (was_visited(cursor_fwd)) {
-                auto &v = flat_wires.at(cursor_fwd).visit;
-                cursor_fwd = wire_to_idx.at(ctx->getPipDstWire(v.pip));
+                auto &v = wire_visits.at(cursor_fwd);
+                cursor_fwd = wire_idx(ctx->getPipDstWire(v.pip));
                 bind_pip_internal(net, i, cursor_fwd, v.pip);
                 if (ctx->debug) {
-                    auto &wd = flat_wires.at(cursor_fwd);
-                    ROUTE_LOG_DBG("      wire: %s (curr %d hist %f)\n", ctx->nameOfWire(wd.w),
-                                  int(wd.bound_nets.size()) - 1, wd.hist_cong_cost);
+                    ROUTE_LOG_DBG("      wire: %s (curr %d hist %f)\n", ctx->nameOfWire(wire_ids.at(cursor_fwd)),
+                                  wire_nets.at(cursor_fwd).size() - 1, wire_hist_cong.at(cursor_fwd));
                 }
             }
             NPNR_ASSERT(cursor_fwd == dst_wire_idx);
@@ -592,14 +1162,26 @@ struct Router2
 
         // Normal forwards A* routing
         reset_wires(t);
-        WireScore base_score;
-        base_score.cost = 0;
-        base_score.delay = ctx->getWireDelay(src_wire).maxDelay();
-        base_score.togo_cost = get_togo_cost(net, i, src_wire_idx, dst_wire);
-
-        // Add source wire to queue
-        t.queue.push(QueuedWire(src_wire_idx, PipId(), Loc(), base_score));
-        set_visited(t, src_wire_idx, PipId(), base_score);
+        if (t.hfn_seeds != nullptr) {
+            // Start from the trunk of the net within the thread box
+            for (auto &seed : *t.hfn_seeds) {
+                WireScore seed_score;
+                seed_score.cost = 0;
+                seed_score.delay = seed.delay;
+                seed_score.togo_cost = get_togo_cost(net, i, seed.wire, dst_wire_idx);
+                t.queue.push(QueuedWire(seed.wire, PipId(), Loc(), seed_score));
+                set_visited(t, seed.wire, PipId(), seed_score);
+            }
+        } else {
+            WireScore base_score;
+            base_score.cost = 0;
+            base_score.delay = ctx->getWireDelay(src_wire).maxDelay();
+            base_score.togo_cost = get_togo_cost(net, i, src_wire_idx, dst_wire_idx);
+
+            // Add source wire to queue
+            t.queue.push(QueuedWire(src_wire_idx, PipId(), Loc(), base_score));
+            set_visited(t, src_wire_idx, PipId(), base_score);
+        }
 
         int toexplore = 25000 * std::max(1, (ad.bb.x1 - ad.bb.x0) + (ad.bb.y1 - ad.bb.y0));
         int iter = 0;
@@ -609,14 +1191,16 @@ struct Router2
                 false;
         while (!t.queue.empty() && (!is_bb || iter < toexplore)) {
             auto curr = t.queue.top();
-            auto &d = flat_wires.at(curr.wire);
             t.queue.pop();
             ++iter;
+            ++t.expanded;
+            if (!t.tile_expanded.empty())
+                ++t.tile_expanded[tile_index(curr.wire)];
 #if 0
             ROUTE_LOG_DBG("current wire %s\n", ctx->nameOfWire(curr.wire));
 #endif
-            // Explore all pips downhill of cursor
-            for (auto dh : ctx->getPipsDownhill(d.w)) {
+            // Explore the wire with index next_idx through pip dh; hop_delay is the delay of the pip and the wire
+            auto explore = [&](PipId dh, int next_idx, delay_t hop_delay) {
                 // Skip pips outside of box in bounding-box mode
 #if 0
                 ROUTE_LOG_DBG("trying pip %s\n", ctx->nameOfPip(dh));
@@ -624,37 +1208,35 @@ struct Router2
 #if 0
                 int wire_intent = ctx->wireIntent(curr.wire);
                 if (is_bb && !hit_test_pip(ad.bb, ctx->getPipLocation(dh)) && wire_intent != ID_PSEUDO_GND && wire_intent != ID_PSEUDO_VCC)
-                    continue;
+                    return;
 #else
                 if (is_bb && !hit_test_pip(ad.bb, ctx->getPipLocation(dh)))
-                    continue;
+                    return;
                 if (!ctx->checkPipAvail(dh) && ctx->getBoundPipNet(dh) != net)
-                    continue;
+                    return;
 #endif
                 // Evaluate score of next wire
-                WireId next = ctx->getPipDstWire(dh);
-                int next_idx = wire_to_idx.at(next);
+                WireId next = wire_ids[next_idx];
                 if (was_visited(next_idx))
-                    continue;
+                    return;
 #if 1
                 if (debug_arc)
                     ROUTE_LOG_DBG("   src wire %s\n", ctx->nameOfWire(next));
 #endif
-                auto &nwd = flat_wires.at(next_idx);
-                if (nwd.unavailable)
-                    continue;
-                if (nwd.reserved_net != -1 && nwd.reserved_net != net->udata)
-                    continue;
-                if (nwd.bound_nets.count(net->udata) && nwd.bound_nets.at(net->udata).second != dh)
-                    continue;
-                if (!thread_test_wire(t, nwd))
-                    continue; // thread safety issue
+                if (wire_unavailable[next_idx])
+                    return;
+                if (wire_reserved_net[next_idx] != -1 && wire_reserved_net[next_idx] != net->udata)
+                    return;
+                auto nb = wire_nets[next_idx].find(net->udata);
+                if (nb != nullptr && nb->pip != dh)
+                    return;
+                if (!thread_test_wire(t, next_idx))
+                    return; // thread safety issue
                 WireScore next_score;
                 next_score.cost = curr.score.cost + score_wire_for_arc(net, i, next, dh);
-                next_score.delay =
-                        curr.score.delay + ctx->getPipDelay(dh).maxDelay() + ctx->getWireDelay(next).maxDelay();
-                next_score.togo_cost = cfg.estimate_weight * get_togo_cost(net, i, next_idx, dst_wire);
-                const auto &v = nwd.visit;
+                next_score.delay = curr.score.delay + hop_delay;
+                next_score.togo_cost = cfg.estimate_weight * get_togo_cost(net, i, next_idx, dst_wire_idx);
+                const auto &v = wire_visits[next_idx];
                 if (!v.visited || (v.score.total() > next_score.total())) {
                     ++explored;
 #if 0
@@ -668,19 +1250,36 @@ struct Router2
                         toexplore = std::min(toexplore, iter + 5);
                     }
                 }
+            };
+
+            // Explore all pips downhill of cursor
+            if (graph != nullptr) {
+                for (auto &edge : graph->downhill(curr.wire))
+                    explore(edge.pip, edge.dst, edge.pip_delay + graph->wire_delay(edge.dst));
+            } else {
+                for (auto dh : ctx->getPipsDownhill(wire_ids[curr.wire])) {
+                    WireId next = ctx->getPipDstWire(dh);
+                    explore(dh, wire_idx(next),
+                            ctx->getPipDelay(dh).maxDelay() + ctx->getWireDelay(next).maxDelay());
+                }
             }
         }
         if (was_visited(dst_wire_idx)) {
             ROUTE_LOG_DBG("   Routed (explored %d wires): ", explored);
             int cursor_bwd = dst_wire_idx;
             while (was_visited(cursor_bwd)) {
-                auto &v = flat_wires.at(cursor_bwd).visit;
+                auto &v = wire_visits.at(cursor_bwd);
+                if (t.hfn_seeds != nullptr && v.pip == PipId()) {
+                    t.hfn_prefixes.push_back(HfnPrefix{net, i, cursor_bwd});
+                    break;
+                }
                 bind_pip_internal(net, i, cursor_bwd, v.pip);
                 if (ctx->debug) {
-                    auto &wd = flat_wires.at(cursor_bwd);
-                    ROUTE_LOG_DBG("      wire: %s (curr %d hist %f share %d)\n", ctx->nameOfWire(wd.w),
-                                  int(wd.bound_nets.size()) - 1, wd.hist_cong_cost,
-                                  wd.bound_nets.count(net->udata) ? wd.bound_nets.at(net->udata).first : 0);
+                    auto &bound = wire_nets.at(cursor_bwd);
+                    ROUTE_LOG_DBG("      wire: %s (curr %d hist %f share %d)\n",
+                                  ctx->nameOfWire(wire_ids.at(cursor_bwd)), bound.size() - 1,
+                                  wire_hist_cong.at(cursor_bwd),
+                                  bound.count(net->udata) ? bound.at(net->udata).uses : 0);
                 }
                 if (v.pip == PipId()) {
                     NPNR_ASSERT(cursor_bwd == src_wire_idx);
@@ -688,7 +1287,7 @@ struct Router2
                 }
                 ROUTE_LOG_DBG("         pip: %s (%d, %d)\n", ctx->nameOfPip(v.pip), ctx->getPipLocation(v.pip).x,
                               ctx->getPipLocation(v.pip).y);
-                cursor_bwd = wire_to_idx.at(ctx->getPipSrcWire(v.pip));
+                cursor_bwd = wire_idx(ctx->getPipSrcWire(v.pip));
             }
             t.processed_sinks.insert(dst_wire);
             ad.routed = true;
@@ -701,6 +1300,191 @@ struct Router2
     }
 #undef ARC_ERR
 
+    // Number of nets using each wire at the start of the current routing phase. Searches that leave the thread
+    // bounding box cost wires outside of it using this, as the live data is being modified by other threads
+    std::vector<uint16_t> phase_wire_users;
+
+    void snapshot_wire_users()
+    {
+        phase_wire_users.resize(wire_nets.size());
+        for (size_t i = 0; i < wire_nets.size(); i++)
+            phase_wire_users[i] = uint16_t(std::min(wire_nets[i].size(), int(std::numeric_limits<uint16_t>::max())));
+    }
+
+    float score_wire_outside_bb(NetInfo *net, int wire, PipId pip)
+    {
+        auto &nd = nets.at(net->udata);
+        WireId w = wire_ids[wire];
+        float base_cost = ctx->getDelayNS(ctx->getPipDelay(pip).maxDelay() + ctx->getWireDelay(w).maxDelay() +
+                                          ctx->getDelayEpsilon());
+        // Any use of a wire outside of the box is treated as being by another net, as the snapshot doesn't
+        // distinguish between nets
+        int other_sources = phase_wire_users[wire];
+        float present_cost = (other_sources == 0) ? 1.0f : (1 + other_sources * curr_cong_weight);
+        Loc pl = ctx->getPipLocation(pip);
+        float bias_cost = cfg.bias_cost_factor * (base_cost / int(net->users.size())) *
+                          ((std::abs(pl.x - nd.cx) + std::abs(pl.y - nd.cy)) / float(nd.hpwl));
+        return base_cost * wire_hist_cong[wire] * present_cost + bias_cost;
+    }
+
+    // Multi-threaded retry of an arc that didn't fit inside the thread bounding box. Only wires inside the box
+    // may be bound while other threads are running, so routes that leave it are deferred until the phase is over
+    ArcRouteResult route_arc_outside_bb(ThreadContext &t, NetInfo *net, size_t i)
+    {
+        auto &nd = nets[net->udata];
+        auto &ad = nd.arcs[i];
+        WireId src_wire = ctx->getNetinfoSourceWire(net), dst_wire = ctx->getNetinfoSinkWire(net, net->users.at(i));
+        int src_wire_idx = wire_idx(src_wire), dst_wire_idx = wire_idx(dst_wire);
+        if (!thread_test_wire(t, src_wire_idx))
+            return ARC_RETRY_WITHOUT_BB;
+
+        t.queue.clear();
+        t.queue.set_bucket_width(cfg.queue_bucket_width);
+        t.local_visits.clear();
+
+        WireScore base_score;
+        base_score.cost = 0;
+        base_score.delay = ctx->getWireDelay(src_wire).maxDelay();
+        base_score.togo_cost = get_togo_cost(net, i, src_wire_idx, dst_wire_idx);
+        t.queue.push(QueuedWire(src_wire_idx, PipId(), Loc(), base_score));
+        WireVisit &src_visit = t.local_visits[src_wire_idx];
+        src_visit.visited = true;
+        src_visit.score = base_score;
+
+        // Limit the search effort, as nets that genuinely need to cross the whole device are best done
+        // single-threaded
+        int toexplore = 25000 * std::max(1, (ad.bb.x1 - ad.bb.x0) + (ad.bb.y1 - ad.bb.y0));
+        int iter = 0;
+        while (!t.queue.empty() && iter < toexplore) {
+            auto curr = t.queue.top();
+            t.queue.pop();
+            ++iter;
+            ++t.expanded;
+            if (!t.tile_expanded.empty())
+                ++t.tile_expanded[tile_index(curr.wire)];
+            auto explore = [&](PipId dh, int next_idx, delay_t hop_delay) {
+                if (!ctx->checkPipAvail(dh) && ctx->getBoundPipNet(dh) != net)
+                    return;
+                WireId next = wire_ids[next_idx];
+                if (t.local_visits.count(next_idx))
+                    return;
+                if (wire_unavailable[next_idx])
+                    return;
+                if (wire_reserved_net[next_idx] != -1 && wire_reserved_net[next_idx] != net->udata)
+                    return;
+                bool in_box = thread_test_wire(t, next_idx);
+                WireScore next_score;
+                if (in_box) {
+                    auto nb = wire_nets[next_idx].find(net->udata);
+                    if (nb != nullptr && nb->pip != dh)
+                        return;
+                    next_score.cost = curr.score.cost + score_wire_for_arc(net, i, next, dh);
+                    next_score.togo_cost = cfg.estimate_weight * get_togo_cost(net, i, next_idx, dst_wire_idx);
+                } else {
+                    next_score.cost = curr.score.cost + score_wire_outside_bb(net, next_idx, dh);
+                    next_score.togo_cost =
+                            cfg.estimate_weight * (estimate_togo_ns(next_idx, dst_wire_idx) + cfg.ipin_cost_adder);
+                }
+                next_score.delay = curr.score.delay + hop_delay;
+                t.queue.push(QueuedWire(next_idx, dh, ctx->getPipLocation(dh), next_score, t.rng.rng()));
+                WireVisit &v = t.local_visits[next_idx];
+                v.visited = true;
+                v.pip = dh;
+                v.score = next_score;
+                if (next_idx == dst_wire_idx)
+                    toexplore = std::min(toexplore, iter + 5);
+            };
+
+            if (graph != nullptr) {
+                for (auto &edge : graph->downhill(curr.wire))
+                    explore(edge.pip, edge.dst, edge.pip_delay + graph->wire_delay(edge.dst));
+            } else {
+                for (auto dh : ctx->getPipsDownhill(wire_ids[curr.wire])) {
+                    WireId next = ctx->getPipDstWire(dh);
+                    explore(dh, wire_idx(next),
+                            ctx->getPipDelay(dh).maxDelay() + ctx->getWireDelay(next).maxDelay());
+                }
+            }
+        }
+        if (!t.local_visits.count(dst_wire_idx))
+            return ARC_RETRY_WITHOUT_BB;
+
+        DeferredArc da;
+        da.net = net;
+        da.user = i;
+        bool all_in_box = true;
+        int cursor = dst_wire_idx;
+        while (true) {
+            PipId pip = t.local_visits.at(cursor).pip;
+            da.path.emplace_back(cursor, pip);
+            if (!thread_test_wire(t, cursor))
+                all_in_box = false;
+            if (pip == PipId())
+                break;
+            cursor = wire_idx(ctx->getPipSrcWire(pip));
+        }
+        NPNR_ASSERT(cursor == src_wire_idx);
+        t.processed_sinks.insert(dst_wire);
+        if (all_in_box) {
+            for (auto &step : da.path)
+                bind_pip_internal(net, i, step.first, step.second);
+            ad.routed = true;
+        } else {
+            t.deferred_arcs.push_back(std::move(da));
+        }
+        return ARC_SUCCESS;
+    }
+
+    int deferred_arcs = 0, deferred_arc_conflicts = 0;
+
+    // Bind arcs routed outside of the thread bounding box, once no other threads are running
+    void commit_deferred_arcs(ThreadContext &t)
+    {
+        for (auto &da : t.deferred_arcs) {
+            ++deferred_arcs;
+            int udata = da.net->udata;
+            // The net might have since been bound to part of the path via a different pip, in which case it
+            // is left to the single-threaded rerouting of failed nets
+            bool conflict = false;
+            for (auto &step : da.path) {
+                auto b = wire_nets.at(step.first).find(udata);
+                if (b != nullptr && b->pip != step.second) {
+                    conflict = true;
+                    break;
+                }
+            }
+            if (conflict) {
+                ++deferred_arc_conflicts;
+                if (std::find(t.failed_nets.begin(), t.failed_nets.end(), da.net) == t.failed_nets.end())
+                    t.failed_nets.push_back(da.net);
+                continue;
+            }
+            for (auto &step : da.path)
+                bind_pip_internal(da.net, da.user, step.first, step.second);
+            nets.at(udata).arcs.at(da.user).routed = true;
+        }
+        t.deferred_arcs.clear();
+    }
+
+    void reroute_arc_without_bb(ThreadContext &t, NetInfo *net, size_t i)
+    {
+        bool is_mt = false;
+        // Attempt a re-route without the bounding box constraint
+        ROUTE_LOG_DBG("Rerouting arc %d of net '%s' without bounding box, possible tricky routing...\n", int(i),
+                      ctx->nameOf(net));
+        auto res2 = route_arc(t, net, i, is_mt, false);
+        // If this also fails, no choice but to give up
+        if (res2 != ARC_SUCCESS)
+            log_error("Failed to route arc %d of net '%s', from %s to %s.\n", int(i), ctx->nameOf(net),
+                      ctx->nameOfWire(ctx->getNetinfoSourceWire(net)),
+                      ctx->nameOfWire(ctx->getNetinfoSinkWire(net, net->users.at(i))));
+    }
+
+    bool crit_increased(const PerArcData &ad)
+    {
+        return cfg.crit_reroute_delta > 0 && ad.routed && ad.arc_crit > (ad.routed_crit + cfg.crit_reroute_delta);
+    }
+
     bool route_net(ThreadContext &t, NetInfo *net, bool is_mt)
     {
 
@@ -722,8 +1506,9 @@ struct Router2
         t.route_arcs.clear();
         for (size_t i = 0; i < net->users.size(); i++) {
             // Ripup failed arcs to start with
-            // Check if arc is already legally routed
-            if (check_arc_routing(net, i))
+            // Check if arc is already legally routed, and hasn't become much more critical since
+            auto &ad = nets.at(net->udata).arcs.at(i);
+            if (check_arc_routing(net, i) && !crit_increased(ad))
                 continue;
             auto &usr = net->users.at(i);
             WireId dst_wire = ctx->getNetinfoSinkWire(net, usr);
@@ -731,7 +1516,9 @@ struct Router2
             if (net->wires.count(dst_wire) && net->wires.at(dst_wire).strength > STRENGTH_STRONG)
                 return ARC_SUCCESS;
             // Ripup arc to start with
+            record_ripup(t, net, i);
             ripup_arc(net, i);
+            ad.routed_crit = ad.arc_crit;
             t.route_arcs.push_back(i);
         }
         for (auto i : t.route_arcs) {
@@ -740,18 +1527,12 @@ struct Router2
                 return false; // Arc failed irrecoverably
             else if (res1 == ARC_RETRY_WITHOUT_BB) {
                 if (is_mt) {
-                    // Can't break out of bounding box in multi-threaded mode, so mark this arc as a failure
-                    have_failures = true;
+                    // Try leaving the thread bounding box; if that fails too then mark this arc as a failure
+                    // to be retried single-threaded
+                    if (route_arc_outside_bb(t, net, i) != ARC_SUCCESS)
+                        have_failures = true;
                 } else {
-                    // Attempt a re-route without the bounding box constraint
-                    ROUTE_LOG_DBG("Rerouting arc %d of net '%s' without bounding box, possible tricky routing...\n",
-                                  int(i), ctx->nameOf(net));
-                    auto res2 = route_arc(t, net, i, is_mt, false);
-                    // If this also fails, no choice but to give up
-                    if (res2 != ARC_SUCCESS)
-                        log_error("Failed to route arc %d of net '%s', from %s to %s.\n", int(i), ctx->nameOf(net),
-                                  ctx->nameOfWire(ctx->getNetinfoSourceWire(net)),
-                                  ctx->nameOfWire(ctx->getNetinfoSinkWire(net, net->users.at(i))));
+                    reroute_arc_without_bb(t, net, i);
                 }
             }
         }
@@ -774,19 +1555,26 @@ struct Router2
     {
         total_overuse = 0;
         overused_wires = 0;
-        total_wire_use = 0;
+        total_wire_use = wire_use.load(std::memory_order_relaxed);
         failed_nets.clear();
-        for (auto &wire : flat_wires) {
-            total_wire_use += int(wire.bound_nets.size());
-            int overuse = int(wire.bound_nets.size()) - 1;
-            if (overuse > 0) {
-                wire.hist_cong_cost = std::min(1e9, wire.hist_cong_cost + overuse * hist_cong_weight);
-                total_overuse += overuse;
-                overused_wires += 1;
-                for (auto &bound : wire.bound_nets)
-                    failed_nets.insert(bound.first);
+        // Only wires in the overused list can be overused; those that no longer are leave it
+        size_t kept = 0;
+        for (int i : overused_list) {
+            auto &bound = wire_nets[i];
+            int overuse = bound.size() - 1;
+            if (overuse <= 0) {
+                wire_overused[i] = 0;
+                continue;
             }
+            overused_list[kept++] = i;
+            wire_hist_cong[i] = std::min(1e9, wire_hist_cong[i] + overuse * hist_cong_weight);
+            total_overuse += overuse;
+            overused_wires += 1;
+            if (stats_out != nullptr)
+                ++iter_tiles.at(tile_index(i)).overused;
+            bound.for_each([&](const WireBinding &b) { failed_nets.insert(b.net); });
         }
+        overused_list.resize(kept);
     }
 
     bool bind_and_check(NetInfo *net, int usr_idx)
@@ -827,13 +1615,13 @@ struct Router2
                     break;
                 }
             }
-            auto &wd = wire_data(cursor);
-            if (!wd.bound_nets.count(net->udata)) {
+            auto &bound = wire_nets.at(wire_idx(cursor));
+            if (!bound.count(net->udata)) {
                 log("Failure details:\n");
                 log("    Cursor: %s\n", ctx->nameOfWire(cursor));
                 log_error("Internal error; incomplete route tree for arc %d of net %s.\n", usr_idx, ctx->nameOf(net));
             }
-            auto &p = wd.bound_nets.at(net->udata).second;
+            auto &p = bound.at(net->udata).pip;
             if (!ctx->checkPipAvail(p)) {
                 success = false;
                 break;
@@ -888,17 +1676,16 @@ struct Router2
     {
         std::vector<std::vector<int>> hm_xy;
         int max_x = 0, max_y = 0;
-        for (auto &wd : flat_wires) {
-            int val = int(wd.bound_nets.size()) - (congestion ? 1 : 0);
-            if (wd.bound_nets.empty())
+        for (auto &bound : wire_nets) {
+            int val = bound.size() - (congestion ? 1 : 0);
+            if (bound.empty())
                 continue;
             // Estimate wire location by driving pip location
             PipId drv;
-            for (auto &bn : wd.bound_nets)
-                if (bn.second.second != PipId()) {
-                    drv = bn.second.second;
-                    break;
-                }
+            bound.for_each([&](const WireBinding &b) {
+                if (drv == PipId() && b.pip != PipId())
+                    drv = b.pip;
+            });
             if (drv == PipId())
                 continue;
             Loc l = ctx->getPipLocation(drv);
@@ -921,171 +1708,672 @@ struct Router2
             out << std::endl;
         }
     }
-    int mid_x = 0, mid_y = 0;
 
-    void partition_nets()
+    // Per iteration instrumentation, written to cfg.stats_file as CSV; or JSON if the file name ends in .json.
+    // Tiles record overused wires (by wire location), A* expansions and arcs ripped up (by sink location); bins
+    // record the nets routed and time taken by the thread of each partition bin (-1 if routing wasn't split).
+    struct TileStats
+    {
+        int overused = 0, expanded = 0, ripups = 0;
+    };
+
+    struct BinStats
+    {
+        int bin, nets;
+        int64_t expanded, route_us;
+    };
+
+    std::unique_ptr<std::ofstream> stats_out;
+    bool stats_json = false;
+    std::vector<TileStats> iter_tiles;
+    std::vector<BinStats> iter_bins;
+
+    void init_thread_stats(ThreadContext &t)
+    {
+        if (stats_out == nullptr)
+            return;
+        t.tile_expanded.assign(iter_tiles.size(), 0);
+        t.tile_ripups.assign(iter_tiles.size(), 0);
+    }
+
+    void open_stats()
+    {
+        if (cfg.stats_file.empty())
+            return;
+        stats_out.reset(new std::ofstream(cfg.stats_file));
+        if (!*stats_out)
+            log_error("Failed to open router2 stats file '%s' for writing.\n", cfg.stats_file.c_str());
+        stats_json = boost::algorithm::ends_with(cfg.stats_file, ".json");
+        iter_tiles.resize(ctx->getGridDimX() * ctx->getGridDimY());
+        if (stats_json)
+            *stats_out << "{\"iterations\": [" << std::endl;
+        else
+            *stats_out << "iter,type,x,y,bin,overused,expanded,ripups,nets,time_us" << std::endl;
+    }
+
+    void write_iter_stats(int iter, int64_t iter_us)
+    {
+        if (stats_out == nullptr)
+            return;
+        auto &out = *stats_out;
+        int w = ctx->getGridDimX();
+        if (stats_json) {
+            out << (iter > 1 ? "," : "") << "{\"iter\": " << iter << ", \"time_us\": " << iter_us
+                << ", \"overused\": " << overused_wires << ", \"overuse\": " << total_overuse << ", \"bins\": [";
+            for (size_t i = 0; i < iter_bins.size(); i++) {
+                auto &b = iter_bins.at(i);
+                out << (i > 0 ? ", " : "") << "{\"bin\": " << b.bin << ", \"nets\": " << b.nets
+                    << ", \"expanded\": " << b.expanded << ", \"time_us\": " << b.route_us << "}";
+            }
+            out << "], \"tiles\": [";
+            bool first = true;
+            for (int i = 0; i < int(iter_tiles.size()); i++) {
+                auto &ts = iter_tiles.at(i);
+                if (ts.overused == 0 && ts.expanded == 0 && ts.ripups == 0)
+                    continue;
+                out << (first ? "" : ", ") << "[" << (i % w) << ", " << (i / w) << ", " << ts.overused << ", "
+                    << ts.expanded << ", " << ts.ripups << "]";
+                first = false;
+            }
+            out << "]}" << std::endl;
+        } else {
+            out << iter << ",iter,,,," << overused_wires << ",,,," << iter_us << std::endl;
+            for (auto &b : iter_bins)
+                out << iter << ",bin,,," << b.bin << ",," << b.expanded << ",," << b.nets << "," << b.route_us
+                    << std::endl;
+            for (int i = 0; i < int(iter_tiles.size()); i++) {
+                auto &ts = iter_tiles.at(i);
+                if (ts.overused == 0 && ts.expanded == 0 && ts.ripups == 0)
+                    continue;
+                out << iter << ",tile," << (i % w) << "," << (i / w) << ",," << ts.overused << "," << ts.expanded
+                    << "," << ts.ripups << ",," << std::endl;
+            }
+        }
+        std::fill(iter_tiles.begin(), iter_tiles.end(), TileStats());
+        iter_bins.clear();
+    }
+
+    void close_stats()
+    {
+        if (stats_out == nullptr)
+            return;
+        if (stats_json)
+            *stats_out << "]}" << std::endl;
+        stats_out.reset();
+    }
+
+    // Routing is parallelised by recursively bisecting the device into regions, forming a binary tree.
+    // Nets that fit entirely inside a leaf region are routed in parallel with all other leaves; nets that
+    // cross the split of an internal node are routed after its children have finished, in parallel with
+    // the other nodes at the same depth. Only nets crossing the root splits are routed single-threaded.
+    struct PartitionNode
+    {
+        // Region of the device owned by this node; wires outside it are not touched by its threads
+        ArcBounds bb;
+        int depth = 0;
+        // Axis and position of the split used to create the children; split is the last coordinate of child 0
+        bool split_x = false;
+        int split = 0;
+        // Nets that cross the split above are binned on either side of this orthogonal split
+        int cross_split = 0;
+        int children[2] = {-1, -1};
+        bool is_leaf() const { return children[0] == -1; }
+    };
+
+    // Bins within a partition node; leaf nodes only use PART_BIN_LO
+    enum PartitionBin
+    {
+        PART_BIN_LO = 0,
+        PART_BIN_HI = 1,
+        PART_BIN_CROSS = 2,
+        PART_BIN_COUNT = 3,
+    };
+
+    std::vector<PartitionNode> partition;
+    int partition_depth = 0;
+
+#ifndef NPNR_DISABLE_THREADS
+    std::unique_ptr<WorkerPool> pool;
+#endif
+
+    int median_coord(const std::vector<int> &net_idxs, bool x)
+    {
+        std::vector<int> coords;
+        coords.reserve(net_idxs.size());
+        for (int n : net_idxs)
+            coords.push_back(x ? nets.at(n).cx : nets.at(n).cy);
+        auto mid = coords.begin() + coords.size() / 2;
+        std::nth_element(coords.begin(), mid, coords.end());
+        return *mid;
+    }
+
+    // Position of (x, y) along a Hilbert curve over an n by n grid, n a power of two
+    static uint64_t hilbert_index(int n, int x, int y)
+    {
+        uint64_t d = 0;
+        for (int s = n / 2; s > 0; s /= 2) {
+            int rx = (x & s) > 0, ry = (y & s) > 0;
+            d += uint64_t(s) * uint64_t(s) * uint64_t((3 * rx) ^ ry);
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = n - 1 - x;
+                    y = n - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    // Route the nets of a bin along a Hilbert curve through their centres, so consecutive searches mostly touch
+    // the same wires; the more critical net goes first where centres coincide
+    void sort_by_locality(std::vector<NetInfo *> &route_nets)
+    {
+        int n = 1;
+        while (n < ctx->getGridDimX() || n < ctx->getGridDimY())
+            n *= 2;
+        std::vector<std::pair<uint64_t, NetInfo *>> keyed;
+        keyed.reserve(route_nets.size());
+        for (auto ni : route_nets) {
+            auto &nd = nets.at(ni->udata);
+            int x = std::min(std::max(nd.cx, 0), n - 1), y = std::min(std::max(nd.cy, 0), n - 1);
+            keyed.emplace_back(hilbert_index(n, x, y), ni);
+        }
+        std::stable_sort(keyed.begin(), keyed.end(),
+                         [&](const std::pair<uint64_t, NetInfo *> &a, const std::pair<uint64_t, NetInfo *> &b) {
+                             if (a.first != b.first)
+                                 return a.first < b.first;
+                             return nets.at(a.second->udata).max_crit > nets.at(b.second->udata).max_crit;
+                         });
+        for (size_t i = 0; i < keyed.size(); i++)
+            route_nets.at(i) = keyed.at(i).second;
+    }
+
+    void build_partition(int node, const std::vector<int> &region_nets)
     {
-        // Create a histogram of positions in X and Y positions
-        std::map<int, int> cxs, cys;
-        for (auto &n : nets) {
-            if (n.cx != -1)
-                ++cxs[n.cx];
-            if (n.cy != -1)
-                ++cys[n.cy];
-        }
-        // 4-way split for now
-        int accum_x = 0, accum_y = 0;
-        int halfway = int(nets.size()) / 2;
-        for (auto &p : cxs) {
-            if (accum_x < halfway && (accum_x + p.second) >= halfway)
-                mid_x = p.first;
-            accum_x += p.second;
-        }
-        for (auto &p : cys) {
-            if (accum_y < halfway && (accum_y + p.second) >= halfway)
-                mid_y = p.first;
-            accum_y += p.second;
+        // Heuristic: don't bother splitting regions with few nets, as the threading overhead dominates
+        const size_t min_region_nets = 100;
+        if (partition.at(node).depth >= partition_depth || region_nets.size() < min_region_nets)
+            return;
+        int min_x = std::numeric_limits<int>::max(), max_x = std::numeric_limits<int>::min();
+        int min_y = std::numeric_limits<int>::max(), max_y = std::numeric_limits<int>::min();
+        for (int n : region_nets) {
+            min_x = std::min(min_x, nets.at(n).cx);
+            max_x = std::max(max_x, nets.at(n).cx);
+            min_y = std::min(min_y, nets.at(n).cy);
+            max_y = std::max(max_y, nets.at(n).cy);
         }
+        // Split along the axis with the greatest spread of net centroids
+        bool split_x = (max_x - min_x) >= (max_y - min_y);
+        // Regions much narrower than the bounding box margin would leave almost no nets inside the children
+        if (split_x ? (max_x - min_x) <= 2 * cfg.bb_margin_x : (max_y - min_y) <= 2 * cfg.bb_margin_y)
+            return;
+        ArcBounds bb = partition.at(node).bb;
+        int split = median_coord(region_nets, split_x);
+        if (split_x)
+            split = std::max(bb.x0, std::min(bb.x1 - 1, split));
+        else
+            split = std::max(bb.y0, std::min(bb.y1 - 1, split));
+
+        ArcBounds lo_bb = bb, hi_bb = bb;
+        if (split_x) {
+            lo_bb.x1 = split;
+            hi_bb.x0 = split + 1;
+        } else {
+            lo_bb.y1 = split;
+            hi_bb.y0 = split + 1;
+        }
+        std::vector<int> lo_nets, hi_nets;
+        for (int n : region_nets)
+            ((split_x ? nets.at(n).cx : nets.at(n).cy) <= split ? lo_nets : hi_nets).push_back(n);
+
+        int lo_idx = int(partition.size()), hi_idx = lo_idx + 1;
+        int child_depth = partition.at(node).depth + 1;
+        partition.resize(partition.size() + 2);
+        partition.at(lo_idx).bb = lo_bb;
+        partition.at(lo_idx).depth = child_depth;
+        partition.at(hi_idx).bb = hi_bb;
+        partition.at(hi_idx).depth = child_depth;
+
+        auto &pn = partition.at(node);
+        pn.split_x = split_x;
+        pn.split = split;
+        pn.cross_split = median_coord(region_nets, !split_x);
+        if (split_x)
+            pn.cross_split = std::max(bb.y0, std::min(bb.y1 - 1, pn.cross_split));
+        else
+            pn.cross_split = std::max(bb.x0, std::min(bb.x1 - 1, pn.cross_split));
+        pn.children[0] = lo_idx;
+        pn.children[1] = hi_idx;
+
+        build_partition(lo_idx, lo_nets);
+        build_partition(hi_idx, hi_nets);
+    }
+
+    void partition_nets()
+    {
+        // Enough levels that the leaves alone can occupy every thread, with some extra regions so that
+        // idle threads can pick up work from threads with more heavily loaded regions
+        partition_depth = 0;
+        int regions = cfg.regions;
+        if (regions == 0 && cfg.threads > 1)
+            regions = cfg.threads * cfg.regions_per_thread;
+        while ((1 << partition_depth) < regions)
+            ++partition_depth;
+        partition.clear();
+        partition.emplace_back();
+        partition.front().bb =
+                ArcBounds(0, 0, std::numeric_limits<int>::max() - 1, std::numeric_limits<int>::max() - 1);
+        std::vector<int> all_nets(nets.size());
+        for (int i = 0; i < int(nets.size()); i++)
+            all_nets.at(i) = i;
+        build_partition(0, all_nets);
         if (ctx->verbose) {
-            log_info("    x splitpoint: %d\n", mid_x);
-            log_info("    y splitpoint: %d\n", mid_y);
-        }
-        std::vector<int> bins(5, 0);
-        for (auto &n : nets) {
-            if (n.bb.x0 < mid_x && n.bb.x1 < mid_x && n.bb.y0 < mid_y && n.bb.y1 < mid_y)
-                ++bins[0]; // TL
-            else if (n.bb.x0 >= mid_x && n.bb.x1 >= mid_x && n.bb.y0 < mid_y && n.bb.y1 < mid_y)
-                ++bins[1]; // TR
-            else if (n.bb.x0 < mid_x && n.bb.x1 < mid_x && n.bb.y0 >= mid_y && n.bb.y1 >= mid_y)
-                ++bins[2]; // BL
-            else if (n.bb.x0 >= mid_x && n.bb.x1 >= mid_x && n.bb.y0 >= mid_y && n.bb.y1 >= mid_y)
-                ++bins[3]; // BR
-            else
-                ++bins[4]; // cross-boundary
+            int leaves = 0, max_depth = 0;
+            for (auto &pn : partition) {
+                if (pn.is_leaf())
+                    ++leaves;
+                max_depth = std::max(max_depth, pn.depth);
+            }
+            log_info("    partitioned into %d regions (%d leaves, depth %d)\n", int(partition.size()), leaves,
+                     max_depth);
         }
-        if (ctx->verbose)
-            for (int i = 0; i < 5; i++)
-                log_info("        bin %d N=%d\n", i, bins[i]);
+        if (ctx->debug)
+            for (int i = 0; i < int(partition.size()); i++) {
+                auto &pn = partition.at(i);
+                log_info("        region %d depth=%d bb=(%d, %d)->(%d, %d) %s split=%d cross=%d\n", i, pn.depth,
+                         pn.bb.x0, pn.bb.y0, pn.bb.x1, pn.bb.y1, pn.is_leaf() ? "leaf" : (pn.split_x ? "x" : "y"),
+                         pn.split, pn.cross_split);
+            }
+    }
+
+    // Returns the index of the thread context (node * PART_BIN_COUNT + bin) that a net is routed in
+    int partition_bin(const ArcBounds &bb)
+    {
+        int node = 0;
+        while (true) {
+            auto &pn = partition.at(node);
+            if (pn.is_leaf())
+                return node * PART_BIN_COUNT + PART_BIN_LO;
+            int lo = pn.split_x ? bb.x0 : bb.y0, hi = pn.split_x ? bb.x1 : bb.y1;
+            int margin = pn.split_x ? cfg.bb_margin_x : cfg.bb_margin_y;
+            if (hi < (pn.split - margin)) {
+                node = pn.children[0];
+            } else if (lo > (pn.split + margin)) {
+                node = pn.children[1];
+            } else {
+                int cross_lo = pn.split_x ? bb.y0 : bb.x0, cross_hi = pn.split_x ? bb.y1 : bb.x1;
+                int cross_margin = pn.split_x ? cfg.bb_margin_y : cfg.bb_margin_x;
+                if (cross_hi < (pn.cross_split - cross_margin))
+                    return node * PART_BIN_COUNT + PART_BIN_LO;
+                else if (cross_lo > (pn.cross_split + cross_margin))
+                    return node * PART_BIN_COUNT + PART_BIN_HI;
+                else
+                    return node * PART_BIN_COUNT + PART_BIN_CROSS;
+            }
+        }
+    }
+
+    ArcBounds partition_bin_bounds(int node, int bin)
+    {
+        auto &pn = partition.at(node);
+        ArcBounds bb = pn.bb;
+        if (pn.is_leaf() || bin == PART_BIN_CROSS)
+            return bb;
+        bool cross_x = !pn.split_x;
+        if (bin == PART_BIN_LO)
+            (cross_x ? bb.x1 : bb.y1) = pn.cross_split;
+        else
+            (cross_x ? bb.x0 : bb.y0) = pn.cross_split + 1;
+        return bb;
+    }
+
+    std::vector<HfnCluster> hfn_clusters;
+
+    // Split a high fanout net that would otherwise be routed single-threaded. Its sinks are clustered by the
+    // partition bin they fall in; an arc to each cluster is routed now as a trunk, and the rest of the arcs of the
+    // cluster are left for the thread of that bin to route starting from the trunk. Returns false if the net
+    // should be routed as normal.
+    bool split_hfn_net(ThreadContext &st, std::vector<ThreadContext> &tcs, NetInfo *net)
+    {
+        if (net->driver.cell == nullptr)
+            return false;
+#ifdef ARCH_ECP5
+        if (net->is_global)
+            return false;
+#endif
+        auto &nd = nets.at(net->udata);
+        for (auto &ad : nd.arcs)
+            if (net->wires.count(ad.sink_wire) && net->wires.at(ad.sink_wire).strength > STRENGTH_STRONG)
+                return false;
+        std::map<int, std::vector<size_t>> bin_arcs;
+        for (size_t i = 0; i < nd.arcs.size(); i++) {
+            const WireLoc &sl = wire_locs.at(wire_idx(nd.arcs.at(i).sink_wire));
+            bin_arcs[partition_bin(ArcBounds(sl.x, sl.y, sl.x, sl.y))].push_back(i);
+        }
+        st.processed_sinks.clear();
+        for (auto &ba : bin_arcs) {
+            std::vector<size_t> unrouted;
+            for (auto i : ba.second) {
+                auto &ad = nd.arcs.at(i);
+                if (check_arc_routing(net, i) && !crit_increased(ad))
+                    continue;
+                record_ripup(st, net, i);
+                ripup_arc(net, i);
+                ad.routed_crit = ad.arc_crit;
+                unrouted.push_back(i);
+            }
+            if (unrouted.empty())
+                continue;
+            if (ba.first == PART_BIN_CROSS || ba.second.size() < 4) {
+                // Sinks in the root cross bin, or too few to be worth a trunk; route these single-threaded now
+                for (auto i : unrouted)
+                    if (route_arc(st, net, i, false, true) != ARC_SUCCESS)
+                        reroute_arc_without_bb(st, net, i);
+                continue;
+            }
+            // The trunk is the arc with the sink nearest to the middle of the cluster
+            int cx = 0, cy = 0;
+            for (auto i : ba.second) {
+                const WireLoc &sl = wire_locs.at(wire_idx(nd.arcs.at(i).sink_wire));
+                cx += sl.x;
+                cy += sl.y;
+            }
+            cx /= int(ba.second.size());
+            cy /= int(ba.second.size());
+            size_t trunk = ba.second.front();
+            int trunk_dist = std::numeric_limits<int>::max();
+            for (auto i : ba.second) {
+                const WireLoc &sl = wire_locs.at(wire_idx(nd.arcs.at(i).sink_wire));
+                int dist = std::abs(sl.x - cx) + std::abs(sl.y - cy);
+                if (dist < trunk_dist) {
+                    trunk = i;
+                    trunk_dist = dist;
+                }
+            }
+            if (!nd.arcs.at(trunk).routed && route_arc(st, net, trunk, false, true) != ARC_SUCCESS)
+                reroute_arc_without_bb(st, net, trunk);
+            HfnCluster cl;
+            cl.net = net;
+            for (auto i : unrouted)
+                if (i != trunk)
+                    cl.arcs.push_back(i);
+            if (cl.arcs.empty())
+                continue;
+            // Walk the trunk back to the source, finding the delay to each wire within the bin
+            std::vector<int> trunk_wires;
+            int cursor = wire_idx(nd.arcs.at(trunk).sink_wire);
+            while (true) {
+                trunk_wires.push_back(cursor);
+                PipId pip = wire_nets.at(cursor).at(net->udata).pip;
+                if (pip == PipId())
+                    break;
+                cursor = wire_idx(ctx->getPipSrcWire(pip));
+            }
+            auto &bin_ctx = tcs.at(ba.first);
+            delay_t delay = 0;
+            for (auto it = trunk_wires.rbegin(); it != trunk_wires.rend(); ++it) {
+                PipId pip = wire_nets.at(*it).at(net->udata).pip;
+                if (pip != PipId())
+                    delay += ctx->getPipDelay(pip).maxDelay();
+                delay += ctx->getWireDelay(wire_ids.at(*it)).maxDelay();
+                if (thread_test_wire(bin_ctx, *it))
+                    cl.seeds.push_back(TrunkSeed{*it, delay});
+            }
+            bin_ctx.hfn_jobs.push_back(int(hfn_clusters.size()));
+            hfn_clusters.push_back(std::move(cl));
+        }
+        return true;
+    }
+
+    void route_hfn_cluster(ThreadContext &t, const HfnCluster &cl)
+    {
+        t.processed_sinks.clear();
+        t.hfn_seeds = &cl.seeds;
+        bool failed = false;
+        for (auto i : cl.arcs)
+            if (route_arc(t, cl.net, i, true) != ARC_SUCCESS)
+                failed = true;
+        t.hfn_seeds = nullptr;
+        // Retry the whole net single-threaded, once the phase has completed
+        if (failed)
+            t.failed_nets.push_back(cl.net);
+    }
+
+    void commit_hfn_prefixes(ThreadContext &t)
+    {
+        for (auto &p : t.hfn_prefixes) {
+            int cursor = p.wire;
+            while (true) {
+                PipId pip = wire_nets.at(cursor).at(p.net->udata).pip;
+                bind_pip_internal(p.net, p.user, cursor, pip);
+                if (pip == PipId())
+                    break;
+                cursor = wire_idx(ctx->getPipSrcWire(pip));
+            }
+        }
+        t.hfn_prefixes.clear();
     }
 
     void router_thread(ThreadContext &t)
     {
+        auto tstart = std::chrono::high_resolution_clock::now();
         for (auto n : t.route_nets) {
             bool result = route_net(t, n, true);
             if (!result)
                 t.failed_nets.push_back(n);
         }
+        for (int c : t.hfn_jobs)
+            route_hfn_cluster(t, hfn_clusters.at(c));
+        auto tend = std::chrono::high_resolution_clock::now();
+        t.route_us += std::chrono::duration_cast<std::chrono::microseconds>(tend - tstart).count();
+        t.routed_nets += int(t.route_nets.size() + t.hfn_jobs.size());
     }
 
     void do_route()
     {
+        // Each pass takes a new set of streams
+        ctx->rng64();
         // Don't multithread if fewer than 200 nets (heuristic)
-        if (route_queue.size() < 200) {
+        if (route_queue.size() < 200 || partition.size() == 1) {
             ThreadContext st;
-            st.rng.rngseed(ctx->rng64());
+            st.rng = ctx->split(0);
             st.bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+            init_thread_stats(st);
+            auto tstart = std::chrono::high_resolution_clock::now();
             for (size_t j = 0; j < route_queue.size(); j++) {
                 route_net(st, nets_by_udata[route_queue[j]], false);
             }
+            auto tend = std::chrono::high_resolution_clock::now();
+            st.route_us = std::chrono::duration_cast<std::chrono::microseconds>(tend - tstart).count();
+            st.routed_nets = int(route_queue.size());
+            collect_thread_stats(st, -1);
             return;
         }
-        const int Nq = 4, Nv = 2, Nh = 2;
-        const int N = Nq + Nv + Nh;
-        std::vector<ThreadContext> tcs(N + 1);
-        for (auto &th : tcs) {
-            th.rng.rngseed(ctx->rng64());
+        const int root_cross = PART_BIN_CROSS;
+        std::vector<ThreadContext> tcs(partition.size() * PART_BIN_COUNT);
+        for (int i = 0; i < int(tcs.size()); i++) {
+            tcs.at(i).rng = ctx->split(i);
+            tcs.at(i).bb = partition_bin_bounds(i / PART_BIN_COUNT, i % PART_BIN_COUNT);
+            init_thread_stats(tcs.at(i));
         }
-        int le_x = mid_x - cfg.bb_margin_x;
-        int rs_x = mid_x + cfg.bb_margin_x;
-        int le_y = mid_y - cfg.bb_margin_y;
-        int rs_y = mid_y + cfg.bb_margin_y;
-        // Set up thread bounding boxes
-        tcs.at(0).bb = ArcBounds(0, 0, mid_x, mid_y);
-        tcs.at(1).bb = ArcBounds(mid_x + 1, 0, std::numeric_limits<int>::max(), le_y);
-        tcs.at(2).bb = ArcBounds(0, mid_y + 1, mid_x, std::numeric_limits<int>::max());
-        tcs.at(3).bb =
-                ArcBounds(mid_x + 1, mid_y + 1, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
-
-        tcs.at(4).bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), mid_y);
-        tcs.at(5).bb = ArcBounds(0, mid_y + 1, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
-
-        tcs.at(6).bb = ArcBounds(0, 0, mid_x, std::numeric_limits<int>::max());
-        tcs.at(7).bb = ArcBounds(mid_x + 1, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
-
-        tcs.at(8).bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+        tcs.at(root_cross).bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
 
+        hfn_clusters.clear();
+        int hfn_split = 0;
+        auto sstart = std::chrono::high_resolution_clock::now();
         for (auto n : route_queue) {
-            auto &nd = nets.at(n);
-            auto ni = nets_by_udata.at(n);
-            int bin = N;
-            // Quadrants
-            if (nd.bb.x0 < le_x && nd.bb.x1 < le_x && nd.bb.y0 < le_y && nd.bb.y1 < le_y)
-                bin = 0;
-            else if (nd.bb.x0 >= rs_x && nd.bb.x1 >= rs_x && nd.bb.y0 < le_y && nd.bb.y1 < le_y)
-                bin = 1;
-            else if (nd.bb.x0 < le_x && nd.bb.x1 < le_x && nd.bb.y0 >= rs_y && nd.bb.y1 >= rs_y)
-                bin = 2;
-            else if (nd.bb.x0 >= rs_x && nd.bb.x1 >= rs_x && nd.bb.y0 >= rs_y && nd.bb.y1 >= rs_y)
-                bin = 3;
-            // Vertical split
-            else if (nd.bb.y0 < le_y && nd.bb.y1 < le_y)
-                bin = Nq + 0;
-            else if (nd.bb.y0 >= rs_y && nd.bb.y1 >= rs_y)
-                bin = Nq + 1;
-            // Horizontal split
-            else if (nd.bb.x0 < le_x && nd.bb.x1 < le_x)
-                bin = Nq + Nv + 0;
-            else if (nd.bb.x0 >= rs_x && nd.bb.x1 >= rs_x)
-                bin = Nq + Nv + 1;
+            NetInfo *ni = nets_by_udata.at(n);
+            int bin = partition_bin(nets.at(n).bb);
+            if (bin == root_cross && cfg.hfn_split_fanout > 0 && int(ni->users.size()) >= cfg.hfn_split_fanout &&
+                split_hfn_net(tcs.at(root_cross), tcs, ni)) {
+                ++hfn_split;
+                continue;
+            }
             tcs.at(bin).route_nets.push_back(ni);
         }
-        if (ctx->verbose)
-            log_info("%d/%d nets not multi-threadable\n", int(tcs.at(N).route_nets.size()), int(route_queue.size()));
-#ifdef NPNR_DISABLE_THREADS
-        // Singlethreaded routing - quadrants
-        for (int i = 0; i < Nq; i++) {
-            router_thread(tcs.at(i));
+        if (cfg.locality_order)
+            for (auto &t : tcs)
+                sort_by_locality(t.route_nets);
+        // Splitting routes the trunks of high fanout nets single-threaded
+        auto send = std::chrono::high_resolution_clock::now();
+        tcs.at(root_cross).route_us += std::chrono::duration_cast<std::chrono::microseconds>(send - sstart).count();
+        tcs.at(root_cross).routed_nets += hfn_split;
+        if (ctx->verbose) {
+            log_info("%d/%d nets not multi-threadable\n", int(tcs.at(root_cross).route_nets.size()),
+                     int(route_queue.size()));
+            if (hfn_split > 0)
+                log_info("%d high fanout nets split into %d clusters\n", hfn_split, int(hfn_clusters.size()));
         }
-        // Vertical splits
-        for (int i = Nq; i < Nq + Nv; i++) {
-            router_thread(tcs.at(i));
+
+        // Phases of routing; all thread contexts in a phase cover disjoint regions and can run concurrently.
+        // Leaves first, then the bins either side of each cross split, then the cross bins; from the
+        // deepest level upwards.
+        std::vector<std::vector<int>> phases(1);
+        for (int i = 0; i < int(partition.size()); i++)
+            if (partition.at(i).is_leaf())
+                phases.front().push_back(i * PART_BIN_COUNT + PART_BIN_LO);
+        for (int d = partition_depth - 1; d >= 0; d--) {
+            std::vector<int> halves, cross;
+            for (int i = 0; i < int(partition.size()); i++) {
+                auto &pn = partition.at(i);
+                if (pn.is_leaf() || pn.depth != d)
+                    continue;
+                halves.push_back(i * PART_BIN_COUNT + PART_BIN_LO);
+                halves.push_back(i * PART_BIN_COUNT + PART_BIN_HI);
+                if (i != 0)
+                    cross.push_back(i * PART_BIN_COUNT + PART_BIN_CROSS);
+            }
+            phases.push_back(halves);
+            phases.push_back(cross);
         }
-        // Horizontal splits
-        for (int i = Nq + Nv; i < Nq + Nv + Nh; i++) {
-            router_thread(tcs.at(i));
+        // Estimated cost of each bin, used to start the most expensive bins first
+        std::vector<int64_t> bin_cost(tcs.size(), 0);
+        for (int i = 0; i < int(tcs.size()); i++)
+            for (auto ni : tcs.at(i).route_nets)
+                bin_cost.at(i) += int64_t(nets.at(ni->udata).hpwl) * std::max<int64_t>(1, ni->users.size());
+        for (int i = 0; i < int(tcs.size()); i++) {
+            // Arcs from a trunk are assumed to span half of the bin
+            auto &bb = tcs.at(i).bb;
+            for (int c : tcs.at(i).hfn_jobs)
+                bin_cost.at(i) += int64_t(hfn_clusters.at(c).arcs.size()) * ((bb.x1 - bb.x0) + (bb.y1 - bb.y0)) / 2;
         }
+        for (auto &phase : phases) {
+            auto idle = [&](int i) { return tcs.at(i).route_nets.empty() && tcs.at(i).hfn_jobs.empty(); };
+            phase.erase(std::remove_if(phase.begin(), phase.end(), idle), phase.end());
+            std::stable_sort(phase.begin(), phase.end(), [&](int a, int b) { return bin_cost.at(a) > bin_cost.at(b); });
+            if (phase.empty())
+                continue;
+            snapshot_wire_users();
+#ifdef NPNR_DISABLE_THREADS
+            for (int i : phase)
+                router_thread(tcs.at(i));
 #else
-        // Multithreaded part of routing - quadrants
-        std::vector<boost::thread> threads;
-        for (int i = 0; i < Nq; i++) {
-            threads.emplace_back([this, &tcs, i]() { router_thread(tcs.at(i)); });
-        }
-        for (auto &t : threads)
-            t.join();
-        threads.clear();
-        // Vertical splits
-        for (int i = Nq; i < Nq + Nv; i++) {
-            threads.emplace_back([this, &tcs, i]() { router_thread(tcs.at(i)); });
-        }
-        for (auto &t : threads)
-            t.join();
-        threads.clear();
-        // Horizontal splits
-        for (int i = Nq + Nv; i < Nq + Nv + Nh; i++) {
-            threads.emplace_back([this, &tcs, i]() { router_thread(tcs.at(i)); });
-        }
-        for (auto &t : threads)
-            t.join();
-        threads.clear();
+            pool->run(phase, [&](int i) { router_thread(tcs.at(i)); });
 #endif
-        // Singlethreaded part of routing - nets that cross partitions
+            for (int i : phase) {
+                commit_deferred_arcs(tcs.at(i));
+                commit_hfn_prefixes(tcs.at(i));
+            }
+        }
+        if (ctx->verbose)
+            log_info("%d arcs routed outside of their thread bounding box (%d conflicts)\n", deferred_arcs,
+                     deferred_arc_conflicts);
+        deferred_arcs = 0;
+        deferred_arc_conflicts = 0;
+        // Singlethreaded part of routing - nets that cross the root partition
         // or don't fit within bounding box
-        for (auto st_net : tcs.at(N).route_nets)
-            route_net(tcs.at(N), st_net, false);
+        auto &st = tcs.at(root_cross);
+        sstart = std::chrono::high_resolution_clock::now();
+        for (auto st_net : st.route_nets)
+            route_net(st, st_net, false);
         // Failed nets
-        for (int i = 0; i < N; i++)
+        for (int i = 0; i < int(tcs.size()); i++) {
             for (auto fail : tcs.at(i).failed_nets)
-                route_net(tcs.at(N), fail, false);
+                route_net(st, fail, false);
+            st.routed_nets += int(tcs.at(i).failed_nets.size());
+        }
+        send = std::chrono::high_resolution_clock::now();
+        st.route_us += std::chrono::duration_cast<std::chrono::microseconds>(send - sstart).count();
+        st.routed_nets += int(st.route_nets.size());
+        for (int i = 0; i < int(tcs.size()); i++)
+            collect_thread_stats(tcs.at(i), i);
+    }
+
+    void collect_thread_stats(const ThreadContext &t, int bin)
+    {
+        for (int c = 0; c < BWD_CLASS_COUNT; c++)
+            bwd_iter_stats[c].merge(t.bwd_stats[c]);
+        total_expanded += t.expanded;
+        if (stats_out == nullptr)
+            return;
+        for (size_t i = 0; i < t.tile_expanded.size(); i++) {
+            iter_tiles.at(i).expanded += t.tile_expanded.at(i);
+            iter_tiles.at(i).ripups += t.tile_ripups.at(i);
+        }
+        if (t.routed_nets == 0)
+            return;
+        int64_t expanded = 0;
+        for (int e : t.tile_expanded)
+            expanded += e;
+        iter_bins.push_back(BinStats{bin, t.routed_nets, expanded, t.route_us});
+    }
+
+    void update_net_crit(int n)
+    {
+        IdString name = nets_by_udata.at(n)->name;
+        auto fnd = net_crit.find(name);
+        auto &net = nets.at(n);
+        net.max_crit = 0;
+        if (fnd == net_crit.end())
+            return;
+        for (int i = 0; i < int(fnd->second.criticality.size()); i++) {
+            float c = fnd->second.criticality.at(i);
+            net.arcs.at(i).arc_crit = c;
+            net.max_crit = std::max(net.max_crit, c);
+        }
+    }
+
+    // Add nets that aren't congested, but have legally routed arcs that have become more critical than they were
+    // when routed, to the route queue; only those arcs are ripped up and rerouted
+    void queue_crit_increased_nets()
+    {
+        std::vector<bool> queued(nets.size(), false);
+        for (auto n : route_queue)
+            queued.at(n) = true;
+        int added = 0;
+        for (int n = 0; n < int(nets.size()); n++) {
+            if (queued.at(n))
+                continue;
+            update_net_crit(n);
+            auto &arcs = nets.at(n).arcs;
+            if (std::any_of(arcs.begin(), arcs.end(), [&](const PerArcData &ad) { return crit_increased(ad); })) {
+                route_queue.push_back(n);
+                ++added;
+            }
+        }
+        if (ctx->verbose && added > 0)
+            log_info("    %d nets with arcs that became more critical queued for rerouting\n", added);
+    }
+
+    // Estimated bytes held by the router's per-net and per-wire state
+    int64_t memory_usage() const
+    {
+        int64_t bytes = memory_of(nets_by_udata) + memory_of(nets) + memory_of(wire_ids) + memory_of(wire_locs) +
+                        memory_of(wire_visits) + memory_of(wire_nets) + memory_of(overused_list) +
+                        memory_of(wire_overused) + memory_of(wire_hist_cong) + memory_of(wire_unavailable) +
+                        memory_of(wire_reserved_net) + memory_of(wire_la_class);
+#ifndef NPNR_DENSE_WIRE_INDEX
+        bytes += int64_t(wire_to_idx.size()) * (sizeof(std::pair<WireId, int>) + 2 * sizeof(int32_t));
+#endif
+        for (auto &nd : nets)
+            bytes += memory_of(nd.arcs);
+        for (auto &bound : wire_nets)
+            if (bound.overflow)
+                bytes += memory_of(*bound.overflow);
+        if (graph)
+            bytes += graph->memory_usage();
+        return bytes;
     }
 
     void operator()()
@@ -1093,40 +2381,81 @@ struct Router2
         log_info("Running router2...\n");
         log_info("Setting up routing resources...\n");
         auto rstart = std::chrono::high_resolution_clock::now();
+#ifndef NPNR_DISABLE_THREADS
+        // Also used to parallelise setup, so created up front
+        if (cfg.threads > 1)
+            pool.reset(new WorkerPool(cfg.threads));
+#endif
         setup_nets();
+        auto nets_end = std::chrono::high_resolution_clock::now();
+        if (cfg.incremental)
+            find_preserved_routing();
+        if (cfg.use_lookahead) {
+            lookahead.reset(new RouterLookahead(ctx));
+            lookahead->init(cfg.lookahead_cache);
+        }
+        if (cfg.use_route_graph)
+            graph.reset(new RouteGraph(ctx));
+        auto wires_start = std::chrono::high_resolution_clock::now();
         setup_wires();
+        auto wires_end = std::chrono::high_resolution_clock::now();
         find_all_reserved_wires();
+        if (cfg.incremental)
+            import_routing();
         partition_nets();
+#ifndef NPNR_DISABLE_THREADS
+        if (pool == nullptr && partition.size() > 1)
+            pool.reset(new WorkerPool(cfg.threads));
+#endif
+        auto setup_end = std::chrono::high_resolution_clock::now();
+        memory_track("router2", memory_usage());
+        log_info("    setup took %.02fs (nets %.02fs, wires %.02fs)\n",
+                 std::chrono::duration<float>(setup_end - rstart).count(),
+                 std::chrono::duration<float>(nets_end - rstart).count(),
+                 std::chrono::duration<float>(wires_end - wires_start).count());
         curr_cong_weight = cfg.init_curr_cong_weight;
         hist_cong_weight = cfg.hist_cong_weight;
         ThreadContext st;
         int iter = 1;
 
-        for (size_t i = 0; i < nets_by_udata.size(); i++)
+        for (size_t i = 0; i < nets_by_udata.size(); i++) {
+            // In incremental mode, only nets with arcs that need routing start off in the queue; others only
+            // join it if they become involved in congestion
+            if (cfg.incremental && std::all_of(nets.at(i).arcs.begin(), nets.at(i).arcs.end(),
+                                               [](const PerArcData &ad) { return ad.routed; }))
+                continue;
             route_queue.push_back(i);
+        }
+        if (cfg.incremental)
+            log_info("    %d/%d nets need routing\n", int(route_queue.size()), int(nets_by_udata.size()));
 
         timing_driven = ctx->setting<bool>("timing_driven");
+        if (timing_driven && cfg.incremental_timing) {
+            incr_timing.reset(new IncrementalCriticality(ctx));
+            incr_timing->route_delay = [this](const NetInfo *net, int user) { return arc_delay(net, user); };
+        }
+        update_bwd_budgets();
+        open_stats();
         log_info("Running main router loop...\n");
         do {
+            NPNR_PROFILE_ZONE("iteration");
+            auto istart = std::chrono::high_resolution_clock::now();
             ctx->sorted_shuffle(route_queue);
 
-            if (timing_driven && (int(route_queue.size()) > (int(nets_by_udata.size()) / 50))) {
-                // Heuristic: reduce runtime by skipping STA in the case of a "long tail" of a few
-                // congested nodes
-                get_criticalities(ctx, &net_crit);
-                for (auto n : route_queue) {
-                    IdString name = nets_by_udata.at(n)->name;
-                    auto fnd = net_crit.find(name);
-                    auto &net = nets.at(n);
-                    net.max_crit = 0;
-                    if (fnd == net_crit.end())
-                        continue;
-                    for (int i = 0; i < int(fnd->second.criticality.size()); i++) {
-                        float c = fnd->second.criticality.at(i);
-                        net.arcs.at(i).arc_crit = c;
-                        net.max_crit = std::max(net.max_crit, c);
-                    }
+            if (timing_driven && (incr_timing || (int(route_queue.size()) > (int(nets_by_udata.size()) / 50)))) {
+                NPNR_PROFILE_ZONE("timing");
+                // Heuristic: reduce runtime by skipping full STA in the case of a "long tail" of a few
+                // congested nodes; incremental STA only updates what has been rerouted so always runs
+                if (incr_timing) {
+                    incr_timing->update_nets(&net_crit, timing_changed_nets);
+                    timing_changed_nets.clear();
+                } else {
+                    get_criticalities(ctx, &net_crit, get_timing_graph());
                 }
+                for (auto n : route_queue)
+                    update_net_crit(n);
+                if (cfg.crit_reroute_delta > 0)
+                    queue_crit_increased_nets();
                 std::stable_sort(route_queue.begin(), route_queue.end(),
                                  [&](int na, int nb) { return nets.at(na).max_crit > nets.at(nb).max_crit; });
             }
@@ -1138,7 +2467,14 @@ struct Router2
                     log("    routed %d/%d\n", int(j), int(route_queue.size()));
             }
 #endif
-            do_route();
+            bwd_iter_stats = {};
+            if (incr_timing)
+                for (auto n : route_queue)
+                    timing_changed_nets.push_back(nets_by_udata.at(n));
+            {
+                NPNR_PROFILE_ZONE("route nets");
+                do_route();
+            }
             route_queue.clear();
             update_congestion();
 #if 0
@@ -1149,16 +2485,36 @@ struct Router2
 #endif
             if (overused_wires == 0) {
                 // Try and actually bind nextpnr Arch API wires
+                NPNR_PROFILE_ZONE("bind");
                 bind_and_check_all();
+                // Only now is the routing in the design, rather than in the router's own state
+                ctx->autosave();
+                // Route delays of all nets now come from the bound wires
+                if (incr_timing)
+                    timing_changed_nets = nets_by_udata;
             }
             for (auto cn : failed_nets)
                 route_queue.push_back(cn);
-            log_info("    iter=%d wires=%d overused=%d overuse=%d archfail=%s\n", iter, total_wire_use, overused_wires,
-                     total_overuse, overused_wires > 0 ? "NA" : std::to_string(arch_fail).c_str());
+            int bwd_attempts = 0, bwd_hits = 0;
+            for (int c = 0; c < BWD_CLASS_COUNT; c++) {
+                bwd_attempts += bwd_iter_stats[c].attempts;
+                bwd_hits += bwd_iter_stats[c].hits;
+                bwd_totals[c].merge(bwd_iter_stats[c]);
+            }
+            update_bwd_budgets();
+            log_info("    iter=%d wires=%d overused=%d overuse=%d archfail=%s bwdhit=%.1f%%\n", iter, total_wire_use,
+                     overused_wires, total_overuse, overused_wires > 0 ? "NA" : std::to_string(arch_fail).c_str(),
+                     bwd_attempts > 0 ? (100.0 * bwd_hits) / bwd_attempts : 0.0);
+            if (ctx->verbose)
+                log_bwd_stats();
+            auto iend = std::chrono::high_resolution_clock::now();
+            write_iter_stats(iter, std::chrono::duration_cast<std::chrono::microseconds>(iend - istart).count());
             ++iter;
             if (curr_cong_weight < 1e9)
                 curr_cong_weight *= cfg.curr_cong_mult;
         } while (!failed_nets.empty());
+        memory_track("router2", memory_usage());
+        close_stats();
         if (cfg.perf_profile) {
             std::vector<std::pair<int, IdString>> nets_by_runtime;
             for (auto &n : nets_by_udata) {
@@ -1174,6 +2530,7 @@ struct Router2
         }
         auto rend = std::chrono::high_resolution_clock::now();
         log_info("Router2 time %.02fs\n", std::chrono::duration<float>(rend - rstart).count());
+        throughput_track("router2/nodes", total_expanded, std::chrono::duration<double>(rend - rstart).count());
 
         log_info("Running router1 to check that route is legal...\n");
 
@@ -1182,17 +2539,61 @@ struct Router2
 };
 } // namespace
 
+namespace {
+void run_router2(Context *ctx, const Router2Cfg &cfg)
+{
+    NPNR_PROFILE_ZONE("router2");
+    {
+        Router2 rt(ctx, cfg);
+        rt.ctx = ctx;
+        rt();
+    }
+    memory_track("router2", 0);
+}
+} // namespace
+
 void router2(Context *ctx, const Router2Cfg &cfg)
 {
-    Router2 rt(ctx, cfg);
-    rt.ctx = ctx;
-    rt();
+    if (!cfg.check_determinism) {
+        run_router2(ctx, cfg);
+        return;
+    }
+    // Both runs must start from the same routing and random state, and partition the design the same way
+    Router2Cfg first_cfg = cfg, second_cfg = cfg;
+    if (first_cfg.regions == 0)
+        first_cfg.regions = std::max(cfg.threads, 2) * cfg.regions_per_thread;
+    second_cfg.regions = first_cfg.regions;
+    second_cfg.threads = (cfg.threads > 1) ? 1 : 2;
+    DesignSnapshot initial;
+    ctx->saveSnapshot(initial, false, true);
+    uint64_t rngstate = ctx->rngstate;
+
+    log_info("Checking determinism of router2 with %d and %d threads (%d regions)...\n", first_cfg.threads,
+             second_cfg.threads, first_cfg.regions);
+    run_router2(ctx, first_cfg);
+    uint32_t first_checksum = ctx->checksum();
+
+    ctx->restoreSnapshot(initial);
+    ctx->rngstate = rngstate;
+    run_router2(ctx, second_cfg);
+    uint32_t second_checksum = ctx->checksum();
+
+    if (first_checksum != second_checksum)
+        log_error("Router2 results differ between %d threads (checksum 0x%08x) and %d threads (checksum 0x%08x)\n",
+                  first_cfg.threads, first_checksum, second_cfg.threads, second_checksum);
+    log_info("Router2 results match with %d and %d threads (checksum 0x%08x)\n", first_cfg.threads,
+             second_cfg.threads, second_checksum);
 }
 
 Router2Cfg::Router2Cfg(Context *ctx)
 {
     backwards_max_iter = ctx->setting<int>("router2/bwdMaxIter", 20);
     global_backwards_max_iter = ctx->setting<int>("router2/glbBwdMaxIter", 200);
+    adaptive_backwards = ctx->setting<bool>("router2/adaptiveBwd", true);
+    hfn_split_fanout = ctx->setting<int>("router2/hfnSplitFanout", 0);
+    crit_reroute_delta = ctx->setting<float>("router2/critRerouteDelta", 0.0f);
+    if (ctx->settings.count(ctx->id("router2/statsFile")))
+        stats_file = ctx->settings.at(ctx->id("router2/statsFile")).as_string();
     bb_margin_x = ctx->setting<int>("router2/bbMargin/x", 3);
     bb_margin_y = ctx->setting<int>("router2/bbMargin/y", 3);
     ipin_cost_adder = ctx->setting<float>("router2/ipinCostAdder", 0.0f);
@@ -1201,6 +2602,19 @@ Router2Cfg::Router2Cfg(Context *ctx)
     hist_cong_weight = ctx->setting<float>("router2/histCongWeight", 1.0f);
     curr_cong_mult = ctx->setting<float>("router2/currCongWeightMult", 2.0f);
     estimate_weight = ctx->setting<float>("router2/estimateWeight", 1.75f);
+    threads = ctx->stage_threads("router2", 4);
+    incremental = ctx->setting<bool>("router2/incremental", false);
+    incremental_timing = ctx->setting<bool>("router2/incrementalTiming", false);
+    crit_weight = ctx->setting<float>("router2/critWeight", 0.0f);
+    regions_per_thread = ctx->setting<int>("router2/regionsPerThread", 2);
+    regions = ctx->setting<int>("router2/regions", 0);
+    check_determinism = ctx->setting<bool>("router2/checkDeterminism", false);
+    use_lookahead = ctx->setting<bool>("router2/lookahead", false);
+    if (ctx->settings.count(ctx->id("router2/lookaheadCache")))
+        lookahead_cache = ctx->settings.at(ctx->id("router2/lookaheadCache")).as_string();
+    use_route_graph = ctx->setting<bool>("router2/routeGraph", false);
+    queue_bucket_width = ctx->setting<float>("router2/queueBucketWidth", 0.0f);
+    locality_order = ctx->setting<bool>("router2/localityOrder", false);
     perf_profile = ctx->setting<float>("router2/perfProfile", false);
 }
 
@@ -29,6 +29,9 @@ struct Router2Cfg
     int backwards_max_iter;
     // Maximum iterations for backwards routing attempt for global nets
     int global_backwards_max_iter;
+    // Reduce the backwards routing budget for classes of net (global or not, by fanout) where
+    // successful backwards searches have needed fewer iterations than the maximum
+    bool adaptive_backwards;
     // Padding added to bounding boxes to account for imperfect routing,
     // congestion, etc
     int bb_margin_x, bb_margin_y;
@@ -47,6 +50,59 @@ struct Router2Cfg
     // of choosing a less congestion/delay-optimal route
     float estimate_weight;
 
+    // Number of threads to partition routing over; the device is recursively bisected
+    // until there are at least this many leaf regions
+    int threads;
+    // Number of leaf regions created per thread; extra regions allow the work to be balanced
+    // by threads taking regions from busier threads
+    int regions_per_thread;
+    // If non-zero, the number of leaf regions to partition into regardless of the thread count. The regions of
+    // each phase are committed in a fixed order, so for a given seed and partitioning the result doesn't depend
+    // on the number of threads or their timing
+    int regions;
+    // Route twice with different thread counts, but the same partitioning, and fail unless the results match
+    bool check_determinism;
+
+    // Keep existing legal routing and only route the arcs that are unrouted (e.g. because an endpoint moved)
+    // or become congested; for quick turnaround after small changes to an already routed design
+    bool incremental;
+
+    // Use a precomputed per wire type delay table as the A* heuristic instead of estimateDelay; the table is
+    // cached in lookahead_cache if it is not empty, so it need only be built once per device
+    bool use_lookahead;
+    std::string lookahead_cache;
+
+    // Iterate over a flattened copy of the routing graph instead of querying the Arch for every pip
+    bool use_route_graph;
+
+    // Nets with at least this many sinks that would have to be routed single-threaded are instead split into a
+    // trunk to each cluster of sinks, with the arcs of each cluster routed from the trunk in parallel; 0 disables
+    int hfn_split_fanout;
+
+    // Only arcs that use congested wires are ripped up each iteration; with timing driven routing, also reroute
+    // legal arcs whose criticality has risen by more than this since they were routed. 0 disables
+    float crit_reroute_delta;
+
+    // Update criticalities incrementally every iteration, from the delays of the arcs as currently routed, instead
+    // of running a full timing analysis on predicted delays when many nets are left to route
+    bool incremental_timing;
+
+    // How far the cost of a wire moves from congestion towards delay as the criticality of the arc rises; with 1,
+    // an arc of criticality 1 is routed for delay alone. 0 (the default) costs wires the same for every arc
+    float crit_weight;
+
+    // Within each partition bin, route nets in order along a space filling curve through their centres, rather than
+    // in the order of the route queue (by criticality, with timing driven routing), for better cache reuse
+    bool locality_order;
+
+    // If non-zero, the A* searches use a bucket queue over costs quantised to this width (in ns), rather than a
+    // binary heap; faster on large designs, but entries within a bucket aren't popped in exact cost order
+    float queue_bucket_width;
+
+    // If not empty, write per iteration congestion, A* expansion and ripup counts by tile, and time by partition
+    // bin, to this file; as JSON if it ends in .json, otherwise CSV
+    std::string stats_file;
+
     // Print additional performance profiling information
     bool perf_profile = false;
 };
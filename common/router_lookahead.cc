@@ -0,0 +1,312 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "router_lookahead.h"
+#include <chrono>
+#include <fstream>
+#include <queue>
+#include "log.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+// Number of representative wires explored per wire class
+const int lookahead_samples = 3;
+// Limit on the number of wires visited when exploring from one representative wire
+const int lookahead_max_visit = 100000;
+// Routes may detour slightly outside of the table while reaching a sink inside it
+const int lookahead_slack = 4;
+
+const char lookahead_magic[8] = {'N', 'P', 'N', 'R', 'L', 'A', '0', '1'};
+
+void fnv_add(uint64_t &h, const std::string &s)
+{
+    for (char c : s) {
+        h ^= uint8_t(c);
+        h *= 0x100000001b3ULL;
+    }
+    // Terminate each string so that concatenations of different strings don't collide
+    h ^= 0xFF;
+    h *= 0x100000001b3ULL;
+}
+
+int table_size() { return (2 * RouterLookahead::radius + 1) * (2 * RouterLookahead::radius + 1); }
+
+int table_index(int dx, int dy)
+{
+    return (dy + RouterLookahead::radius) * (2 * RouterLookahead::radius + 1) + (dx + RouterLookahead::radius);
+}
+} // namespace
+
+Loc RouterLookahead::wire_loc(const Context *ctx, WireId wire)
+{
+    ArcBounds bb = ctx->getRouteBoundingBox(wire, wire);
+    return Loc((bb.x0 + bb.x1) / 2, (bb.y0 + bb.y1) / 2, 0);
+}
+
+int RouterLookahead::wire_class(WireId wire) const
+{
+    auto fnd = class_index.find(ctx->getWireType(wire));
+    return (fnd == class_index.end()) ? -1 : fnd->second;
+}
+
+void RouterLookahead::init(const std::string &cache_dir)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<std::pair<int, WireId>>> samples;
+    find_classes(samples);
+    if (!cache_dir.empty() && load(cache_file(cache_dir)))
+        return;
+
+    std::unordered_map<WireId, bool> is_sink;
+    for (size_t i = 0; i < classes.size(); i++)
+        for (auto &s : samples.at(i))
+            explore(int(i), s.second, is_sink);
+    fill_unknown();
+    auto end = std::chrono::high_resolution_clock::now();
+    log_info("Router lookahead built in %.02fs (%d wire classes)\n", std::chrono::duration<float>(end - start).count(),
+             int(classes.size()));
+    if (!cache_dir.empty())
+        save(cache_file(cache_dir));
+}
+
+void RouterLookahead::find_classes(std::vector<std::vector<std::pair<int, WireId>>> &samples)
+{
+    // Find the wire classes, and the wires of each class closest to the middle of the device to explore from
+    int mid_x = ctx->getGridDimX() / 2, mid_y = ctx->getGridDimY() / 2;
+    int wire_count = 0;
+    for (auto wire : ctx->getWires()) {
+        ++wire_count;
+        IdString type = ctx->getWireType(wire);
+        auto fnd = class_index.find(type);
+        int cls;
+        if (fnd == class_index.end()) {
+            cls = int(classes.size());
+            class_index[type] = cls;
+            classes.push_back(type);
+            samples.emplace_back();
+        } else {
+            cls = fnd->second;
+        }
+        Loc l = wire_loc(ctx, wire);
+        int dist = std::abs(l.x - mid_x) + std::abs(l.y - mid_y);
+        auto &cs = samples.at(cls);
+        if (int(cs.size()) < lookahead_samples || dist < cs.back().first) {
+            if (int(cs.size()) == lookahead_samples)
+                cs.pop_back();
+            auto pos = std::upper_bound(cs.begin(), cs.end(), dist,
+                                        [](int d, const std::pair<int, WireId> &s) { return d < s.first; });
+            cs.emplace(pos, dist, wire);
+        }
+    }
+
+    device_key = 0xcbf29ce484222325ULL;
+    fnv_add(device_key, ctx->archId().str(ctx));
+    fnv_add(device_key, ctx->archArgsToId(ctx->archArgs()).str(ctx));
+    fnv_add(device_key, ctx->getChipName());
+    fnv_add(device_key, stringf("%d %d %d %d", ctx->getGridDimX(), ctx->getGridDimY(), wire_count, radius));
+    for (size_t i = 0; i < classes.size(); i++) {
+        fnv_add(device_key, classes.at(i).str(ctx));
+        for (auto &s : samples.at(i))
+            fnv_add(device_key, ctx->getWireName(s.second).str(ctx));
+    }
+
+    tables.assign(classes.size(), std::vector<Entry>(table_size()));
+    slopes.assign(classes.size(), Entry());
+}
+
+void RouterLookahead::explore(int cls, WireId start, std::unordered_map<WireId, bool> &is_sink)
+{
+    struct Visit
+    {
+        float cost, delay;
+        Loc loc;
+    };
+    typedef std::pair<float, WireId> QueueEntry;
+    struct QueueGreater
+    {
+        bool operator()(const QueueEntry &a, const QueueEntry &b) const { return a.first > b.first; }
+    };
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, QueueGreater> queue;
+    FlatHashMap<WireId, Visit> visits;
+
+    Loc start_loc = wire_loc(ctx, start);
+    visits[start] = Visit{0, 0, start_loc};
+    queue.emplace(0, start);
+    auto &table = tables.at(cls);
+    float epsilon = ctx->getDelayEpsilon();
+    int visited = 0;
+
+    while (!queue.empty() && visited < lookahead_max_visit) {
+        QueueEntry curr = queue.top();
+        queue.pop();
+        Visit v = visits.at(curr.second);
+        if (curr.first > v.cost)
+            continue; // stale queue entry
+        ++visited;
+        int dx = v.loc.x - start_loc.x, dy = v.loc.y - start_loc.y;
+        if (curr.second != start && std::abs(dx) <= radius && std::abs(dy) <= radius) {
+            auto sink_fnd = is_sink.find(curr.second);
+            if (sink_fnd == is_sink.end()) {
+                bool sink = false;
+                for (auto bp : ctx->getWireBelPins(curr.second))
+                    if (ctx->getBelPinType(bp.bel, bp.pin) == PORT_IN)
+                        sink = true;
+                sink_fnd = is_sink.emplace(curr.second, sink).first;
+            }
+            auto &entry = table.at(table_index(dx, dy));
+            if (sink_fnd->second && (entry.cost < 0 || v.cost < entry.cost)) {
+                entry.cost = v.cost;
+                entry.delay = v.delay;
+            }
+        }
+        for (auto pip : ctx->getPipsDownhill(curr.second)) {
+            WireId next = ctx->getPipDstWire(pip);
+            float step = ctx->getPipDelay(pip).maxDelay() + ctx->getWireDelay(next).maxDelay();
+            float next_cost = v.cost + step + epsilon;
+            auto fnd = visits.find(next);
+            if (fnd != visits.end()) {
+                if (fnd->second.cost <= next_cost)
+                    continue;
+                fnd->second.cost = next_cost;
+                fnd->second.delay = v.delay + step;
+            } else {
+                Loc nl = wire_loc(ctx, next);
+                if (std::abs(nl.x - start_loc.x) > (radius + lookahead_slack) ||
+                    std::abs(nl.y - start_loc.y) > (radius + lookahead_slack))
+                    continue;
+                visits[next] = Visit{next_cost, v.delay + step, nl};
+            }
+            queue.emplace(next_cost, next);
+        }
+    }
+}
+
+void RouterLookahead::fill_unknown()
+{
+    // Derive the per-distance slope of each class from the far half of its table, to extrapolate with, and fill
+    // gaps in the table (offsets where no sink was reached) from it too
+    Entry global_sum;
+    global_sum.delay = global_sum.cost = 0;
+    int global_dist = 0;
+    for (size_t i = 0; i < classes.size(); i++) {
+        float delay_sum = 0, cost_sum = 0;
+        int dist_sum = 0;
+        for (int dy = -radius; dy <= radius; dy++)
+            for (int dx = -radius; dx <= radius; dx++) {
+                auto &e = tables.at(i).at(table_index(dx, dy));
+                int dist = std::abs(dx) + std::abs(dy);
+                if (e.cost < 0 || dist < radius / 2)
+                    continue;
+                delay_sum += e.delay;
+                cost_sum += e.cost;
+                dist_sum += dist;
+            }
+        if (dist_sum > 0) {
+            slopes.at(i).delay = delay_sum / dist_sum;
+            slopes.at(i).cost = cost_sum / dist_sum;
+        }
+        global_sum.delay += delay_sum;
+        global_sum.cost += cost_sum;
+        global_dist += dist_sum;
+    }
+    Entry global_slope;
+    if (global_dist > 0) {
+        global_slope.delay = global_sum.delay / global_dist;
+        global_slope.cost = global_sum.cost / global_dist;
+    } else {
+        global_slope.delay = global_slope.cost = ctx->getDelayEpsilon();
+    }
+    for (size_t i = 0; i < classes.size(); i++) {
+        auto &slope = slopes.at(i);
+        if (slope.cost < 0)
+            slope = global_slope;
+        for (int dy = -radius; dy <= radius; dy++)
+            for (int dx = -radius; dx <= radius; dx++) {
+                auto &e = tables.at(i).at(table_index(dx, dy));
+                if (e.cost >= 0)
+                    continue;
+                int dist = std::max(1, std::abs(dx) + std::abs(dy));
+                e.delay = slope.delay * dist;
+                e.cost = slope.cost * dist;
+            }
+    }
+}
+
+RouterLookahead::Entry RouterLookahead::estimate(int cls, int dx, int dy) const
+{
+    if (cls < 0 || cls >= int(tables.size()))
+        cls = 0;
+    int cdx = std::max(-radius, std::min(radius, dx)), cdy = std::max(-radius, std::min(radius, dy));
+    Entry result = tables.at(cls).at(table_index(cdx, cdy));
+    int extra = std::abs(dx - cdx) + std::abs(dy - cdy);
+    if (extra > 0) {
+        result.delay += slopes.at(cls).delay * extra;
+        result.cost += slopes.at(cls).cost * extra;
+    }
+    return result;
+}
+
+std::string RouterLookahead::cache_file(const std::string &cache_dir) const
+{
+    return stringf("%s/lookahead-%016llx.bin", cache_dir.c_str(), (unsigned long long)device_key);
+}
+
+bool RouterLookahead::load(const std::string &filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        return false;
+    char magic[sizeof(lookahead_magic)];
+    uint64_t key;
+    int32_t n_classes, file_radius;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char *>(&key), sizeof(key));
+    in.read(reinterpret_cast<char *>(&n_classes), sizeof(n_classes));
+    in.read(reinterpret_cast<char *>(&file_radius), sizeof(file_radius));
+    if (!in || !std::equal(magic, magic + sizeof(magic), lookahead_magic) || key != device_key ||
+        n_classes != int32_t(classes.size()) || file_radius != radius)
+        return false;
+    for (size_t i = 0; i < classes.size(); i++) {
+        in.read(reinterpret_cast<char *>(&slopes.at(i)), sizeof(Entry));
+        in.read(reinterpret_cast<char *>(tables.at(i).data()), sizeof(Entry) * table_size());
+    }
+    if (!in)
+        return false;
+    log_info("Loaded router lookahead from '%s'\n", filename.c_str());
+    return true;
+}
+
+void RouterLookahead::save(const std::string &filename) const
+{
+    std::ofstream out(filename, std::ios::binary);
+    int32_t n_classes = int32_t(classes.size()), file_radius = radius;
+    out.write(lookahead_magic, sizeof(lookahead_magic));
+    out.write(reinterpret_cast<const char *>(&device_key), sizeof(device_key));
+    out.write(reinterpret_cast<const char *>(&n_classes), sizeof(n_classes));
+    out.write(reinterpret_cast<const char *>(&file_radius), sizeof(file_radius));
+    for (size_t i = 0; i < classes.size(); i++) {
+        out.write(reinterpret_cast<const char *>(&slopes.at(i)), sizeof(Entry));
+        out.write(reinterpret_cast<const char *>(tables.at(i).data()), sizeof(Entry) * table_size());
+    }
+    if (!out)
+        log_warning("Failed to write router lookahead cache '%s'\n", filename.c_str());
+}
+
+NEXTPNR_NAMESPACE_END
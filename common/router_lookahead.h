@@ -0,0 +1,80 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ROUTER_LOOKAHEAD_H
+#define ROUTER_LOOKAHEAD_H
+
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// A table of the delay and cost of routing from a wire, by wire type, to the nearest sink pin wire at a given
+// offset from it. The table is built by exploring the routing graph from a few representative wires of each
+// type near the middle of the device, and is independent of the design; so it can be cached on disk.
+//
+// This gives a far better A* heuristic than estimateDelay for architectures where that is a simple distance
+// based formula, as it accounts for the wire types actually available.
+struct RouterLookahead
+{
+    explicit RouterLookahead(Context *ctx) : ctx(ctx){};
+
+    // Load the table from cache_dir if it contains one for this device, otherwise build it (saving it to
+    // cache_dir if that is not empty)
+    void init(const std::string &cache_dir);
+
+    // Index of the lookahead class of a wire; for use with estimate()
+    int wire_class(WireId wire) const;
+
+    // The notional location of a wire used for lookahead queries
+    static Loc wire_loc(const Context *ctx, WireId wire);
+
+    struct Entry
+    {
+        float delay = -1, cost = -1;
+    };
+
+    // Estimated delay and cost to reach a sink wire at offset (dx, dy) from a wire of class cls
+    Entry estimate(int cls, int dx, int dy) const;
+
+    // Half-width of the table; offsets outside of this are extrapolated
+    static const int radius = 12;
+
+  private:
+    Context *ctx;
+
+    std::vector<IdString> classes;
+    std::unordered_map<IdString, int> class_index;
+    // Per-class table of (2 * radius + 1)^2 entries, indexed by (dy + radius) * (2 * radius + 1) + (dx + radius)
+    std::vector<std::vector<Entry>> tables;
+    // Per-class delay and cost per unit Manhattan distance, used to extrapolate outside of the table
+    std::vector<Entry> slopes;
+
+    uint64_t device_key = 0;
+
+    void find_classes(std::vector<std::vector<std::pair<int, WireId>>> &samples);
+    void explore(int cls, WireId start, std::unordered_map<WireId, bool> &is_sink);
+    void fill_unknown();
+    std::string cache_file(const std::string &cache_dir) const;
+    bool load(const std::string &filename);
+    void save(const std::string &filename) const;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
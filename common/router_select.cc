@@ -0,0 +1,151 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "router_select.h"
+#include <algorithm>
+#include "congestion.h"
+#include "log.h"
+
+#ifndef NPNR_DISABLE_THREADS
+#include <boost/thread.hpp>
+#endif
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+// Coefficients of the routing time model, in seconds per unit of arc length; these are rough figures to be
+// tuned against benchmark results using the predicted and actual times that are logged
+const float router1_arc_cost = 4e-6f;
+const float router2_arc_cost = 3e-6f;
+// Fixed cost of router2 setup and of each extra thread
+const float router2_setup_cost = 0.2f;
+const float router2_thread_cost = 0.05f;
+// Tile demand above which congestion is expected to need extra rip-up and reroute effort
+const float demand_knee = 4.0f;
+
+int fanout_bucket(int fanout)
+{
+    if (fanout <= 1)
+        return 0;
+    if (fanout <= 4)
+        return 1;
+    if (fanout <= 16)
+        return 2;
+    if (fanout <= 64)
+        return 3;
+    return 4;
+}
+} // namespace
+
+RouteDesignStats get_route_design_stats(const Context *ctx)
+{
+    RouteDesignStats stats;
+    int width = ctx->getGridDimX(), height = ctx->getGridDimY();
+    int64_t serial_length = 0;
+
+    for (auto &net : ctx->nets) {
+        const NetInfo *ni = net.second.get();
+        if (ni->driver.cell == nullptr || ni->driver.cell->bel == BelId() || ni->users.empty())
+            continue;
+        Loc drv = ctx->getBelLocation(ni->driver.cell->bel);
+        int x0 = drv.x, x1 = drv.x, y0 = drv.y, y1 = drv.y;
+        int64_t net_length = 0;
+        for (auto &usr : ni->users) {
+            if (usr.cell == nullptr || usr.cell->bel == BelId())
+                continue;
+            Loc loc = ctx->getBelLocation(usr.cell->bel);
+            net_length += std::abs(loc.x - drv.x) + std::abs(loc.y - drv.y) + 1;
+            x0 = std::min(x0, loc.x);
+            x1 = std::max(x1, loc.x);
+            y0 = std::min(y0, loc.y);
+            y1 = std::max(y1, loc.y);
+        }
+        int fanout = int(ni->users.size());
+        stats.nets++;
+        stats.arcs += fanout;
+        stats.max_fanout = std::max(stats.max_fanout, fanout);
+        stats.fanout_hist[fanout_bucket(fanout)]++;
+        stats.arc_length += net_length;
+        int hpwl = (x1 - x0) + (y1 - y0);
+        stats.total_hpwl += hpwl;
+        if (x0 <= width / 2 && x1 >= width / 2 && y0 <= height / 2 && y1 >= height / 2)
+            serial_length += net_length;
+    }
+
+    // Only the demand is needed here, the capacity of the tiles is much slower to find
+    CongestionMap cmap(ctx);
+    cmap.update_demand();
+    std::vector<float> occupied;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            if (cmap.demand(x, y) > 1e-3f)
+                occupied.push_back(cmap.demand(x, y));
+    if (!occupied.empty()) {
+        auto pct = occupied.begin() + (occupied.size() * 95) / 100;
+        std::nth_element(occupied.begin(), pct, occupied.end());
+        stats.tile_demand = *pct;
+    }
+    if (stats.arc_length > 0)
+        stats.serial_fraction = float(serial_length) / float(stats.arc_length);
+    return stats;
+}
+
+RouterChoice select_router(Context *ctx)
+{
+    RouteDesignStats stats = get_route_design_stats(ctx);
+    log_info("Route estimation: %d nets, %d arcs, max fanout %d, HPWL %lld, tile demand %.1f, serial %.0f%%\n",
+             stats.nets, stats.arcs, stats.max_fanout, (long long)stats.total_hpwl, stats.tile_demand,
+             100 * stats.serial_fraction);
+    log_info("    fanout 1: %d, 2-4: %d, 5-16: %d, 17-64: %d, 65+: %d\n", stats.fanout_hist[0], stats.fanout_hist[1],
+             stats.fanout_hist[2], stats.fanout_hist[3], stats.fanout_hist[4]);
+
+    // Congestion costs router1 more than router2, as it rips up whole nets rather than negotiating
+    float congestion = 1 + std::max(0.0f, stats.tile_demand - demand_knee) / demand_knee;
+    float length = float(stats.arc_length);
+
+    RouterChoice choice;
+    choice.router = "router1";
+    choice.predicted_time = router1_arc_cost * length * congestion * congestion;
+
+    bool has_router2 = std::find(Arch::availableRouters.begin(), Arch::availableRouters.end(), "router2") !=
+                       Arch::availableRouters.end();
+    int max_threads = ctx->stage_threads("", 0);
+    if (has_router2) {
+        float base = router2_arc_cost * length * congestion;
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            float t = router2_setup_cost + base * (stats.serial_fraction + (1 - stats.serial_fraction) / threads) +
+                      router2_thread_cost * (threads - 1);
+            if (t < choice.predicted_time) {
+                choice.router = "router2";
+                choice.threads = threads;
+                choice.predicted_time = t;
+            }
+        }
+    }
+
+    log_info("Selected %s with %d thread%s, predicted routing time %.02fs\n", choice.router.c_str(), choice.threads,
+             choice.threads == 1 ? "" : "s", choice.predicted_time);
+    ctx->settings[ctx->id("router")] = choice.router;
+    IdString threads_key = ctx->id(choice.router + "/threads");
+    if (!ctx->settings.count(threads_key))
+        ctx->settings[threads_key] = choice.threads;
+    return choice;
+}
+
+NEXTPNR_NAMESPACE_END
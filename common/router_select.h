@@ -0,0 +1,61 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ROUTER_SELECT_H
+#define ROUTER_SELECT_H
+
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Cheap statistics of a placed design, used to predict routing time
+struct RouteDesignStats
+{
+    int nets = 0, arcs = 0, max_fanout = 0;
+    // Number of nets with fanout 1, 2-4, 5-16, 17-64 and 65+
+    int fanout_hist[5] = {};
+    // Sum over arcs of the Manhattan distance from driver to sink, plus one
+    int64_t arc_length = 0;
+    // Sum over nets of the half perimeter of their bounding box
+    int64_t total_hpwl = 0;
+    // 95th percentile over occupied tiles of the wirelength crossing the tile, spreading the HPWL of each net
+    // evenly over its bounding box
+    float tile_demand = 0;
+    // Fraction of arc length in nets whose bounding box contains the device centre, which router2 must route
+    // single threaded
+    float serial_fraction = 0;
+};
+
+struct RouterChoice
+{
+    std::string router;
+    int threads = 1;
+    // Predicted routing time in seconds
+    float predicted_time = 0;
+};
+
+RouteDesignStats get_route_design_stats(const Context *ctx);
+
+// Pick the router and thread count with the lowest predicted routing time for the placed design, and set them in
+// ctx->settings (leaving any thread count the user set explicitly)
+RouterChoice select_router(Context *ctx);
+
+NEXTPNR_NAMESPACE_END
+
+#endif
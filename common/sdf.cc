@@ -17,8 +17,14 @@
  *
  */
 
+#include <algorithm>
+#include <numeric>
 #include "nextpnr.h"
+#include "out_buffer.h"
 #include "util.h"
+#ifndef NPNR_DISABLE_THREADS
+#include "worker_pool.h"
+#endif
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -34,100 +40,75 @@ struct RiseFallDelay
     MinMaxTyp rise, fall;
 };
 
-struct PortAndEdge
-{
-    std::string port;
-    ClockEdge edge;
-};
-
-struct IOPath
-{
-    std::string from, to;
-    RiseFallDelay delay;
-};
-
-struct TimingCheck
-{
-    enum CheckType
-    {
-        SETUPHOLD,
-        PERIOD,
-        WIDTH
-    } type;
-    PortAndEdge from, to;
-    RiseFallDelay delay;
-};
-
-struct Cell
-{
-    std::string celltype, instance;
-    std::vector<IOPath> iopaths;
-    std::vector<TimingCheck> checks;
-};
-
-struct CellPort
-{
-    std::string cell, port;
-};
-
-struct Interconnect
-{
-    CellPort from, to;
-    RiseFallDelay delay;
-};
-
+// The text of each cell and net is generated independently, straight into output buffers, so that large designs can
+// be split between worker threads; the buffers are then written out in the same order as a serial run would.
 struct SDFWriter
 {
+    const Context *ctx;
     bool cvc_mode = false;
-    std::vector<Cell> cells;
-    std::vector<Interconnect> conn;
-    std::string sdfversion, design, vendor, program;
+    std::string design;
+    int threads = 1;
+#ifndef NPNR_DISABLE_THREADS
+    std::unique_ptr<WorkerPool> pool;
+#endif
+
+    static constexpr double delay_scale = 1000;
 
-    std::string format_name(const std::string &name)
+    void write_name(OutBuffer &out, const std::string &name)
     {
-        std::string fmt = "\"";
+        out << '"';
         for (char c : name) {
             if (c == '\\' || c == '\"')
-                fmt += "\"";
-            fmt += c;
+                out << '"';
+            out << c;
         }
-        fmt += "\"";
-        return fmt;
+        out << '"';
     }
 
-    std::string escape_name(const std::string &name)
+    void write_escaped(OutBuffer &out, const std::string &name)
     {
-        std::string esc;
         for (char c : name) {
             if (c == '$' || c == '\\' || c == '[' || c == ']' || c == ':' || (cvc_mode && c == '.'))
-                esc += '\\';
-            esc += c;
+                out << '\\';
+            out << c;
         }
-        return esc;
     }
 
-    std::string timing_check_name(TimingCheck::CheckType type)
+    // Convert from DelayInfo to SDF-friendly RiseFallDelay
+    RiseFallDelay convert_delay(const DelayInfo &dly)
     {
-        switch (type) {
-        case TimingCheck::SETUPHOLD:
-            return "SETUPHOLD";
-        case TimingCheck::PERIOD:
-            return "PERIOD";
-        case TimingCheck::WIDTH:
-            return "WIDTH";
-        default:
-            NPNR_ASSERT_FALSE("unknown timing check type");
-        }
+        RiseFallDelay rf;
+        rf.rise.min = ctx->getDelayNS(dly.minRaiseDelay()) * delay_scale;
+        rf.rise.typ =
+                ctx->getDelayNS((dly.minRaiseDelay() + dly.maxRaiseDelay()) / 2) * delay_scale; // fixme: typ delays?
+        rf.rise.max = ctx->getDelayNS(dly.maxRaiseDelay()) * delay_scale;
+        rf.fall.min = ctx->getDelayNS(dly.minFallDelay()) * delay_scale;
+        rf.fall.typ =
+                ctx->getDelayNS((dly.minFallDelay() + dly.maxFallDelay()) / 2) * delay_scale; // fixme: typ delays?
+        rf.fall.max = ctx->getDelayNS(dly.maxFallDelay()) * delay_scale;
+        return rf;
+    }
+
+    RiseFallDelay convert_setuphold(const DelayInfo &setup, const DelayInfo &hold)
+    {
+        RiseFallDelay rf;
+        rf.rise.min = ctx->getDelayNS(setup.minDelay()) * delay_scale;
+        rf.rise.typ = ctx->getDelayNS((setup.minDelay() + setup.maxDelay()) / 2) * delay_scale; // fixme: typ delays?
+        rf.rise.max = ctx->getDelayNS(setup.maxDelay()) * delay_scale;
+        rf.fall.min = ctx->getDelayNS(hold.minDelay()) * delay_scale;
+        rf.fall.typ = ctx->getDelayNS((hold.minDelay() + hold.maxDelay()) / 2) * delay_scale; // fixme: typ delays?
+        rf.fall.max = ctx->getDelayNS(hold.maxDelay()) * delay_scale;
+        return rf;
     }
 
-    void write_delay(std::ostream &out, const RiseFallDelay &delay)
+    void write_delay(OutBuffer &out, const RiseFallDelay &delay)
     {
         write_delay(out, delay.rise);
         out << " ";
         write_delay(out, delay.fall);
     }
 
-    void write_delay(std::ostream &out, const MinMaxTyp &delay)
+    void write_delay(OutBuffer &out, const MinMaxTyp &delay)
     {
         if (cvc_mode)
             out << "(" << int(delay.min) << ":" << int(delay.typ) << ":" << int(delay.max) << ")";
@@ -135,200 +116,202 @@ struct SDFWriter
             out << "(" << delay.min << ":" << delay.typ << ":" << delay.max << ")";
     }
 
-    void write_port(std::ostream &out, const CellPort &port)
+    void write_port(OutBuffer &out, const PortRef &port)
     {
-        if (cvc_mode)
-            out << escape_name(port.cell) + "." + escape_name(port.port);
-        else
-            out << escape_name(port.cell + "/" + port.port);
+        if (cvc_mode) {
+            write_escaped(out, port.cell->name.str(ctx));
+            out << ".";
+            write_escaped(out, port.port.str(ctx));
+        } else {
+            write_escaped(out, port.cell->name.str(ctx) + "/" + port.port.str(ctx));
+        }
     }
 
-    void write_portedge(std::ostream &out, const PortAndEdge &pe)
+    void write_portedge(OutBuffer &out, IdString port, ClockEdge edge)
     {
-        out << "(" << (pe.edge == RISING_EDGE ? "posedge" : "negedge") << " " << escape_name(pe.port) << ")";
+        out << "(" << (edge == RISING_EDGE ? "posedge" : "negedge") << " ";
+        write_escaped(out, port.str(ctx));
+        out << ")";
     }
 
-    void write(std::ostream &out)
+    // Interconnect delays of every arc of a net; routed delays come from the net's cached table of wire delays
+    void write_interconnects(OutBuffer &out, const NetInfo *ni)
     {
-        out << "(DELAYFILE" << std::endl;
-        // Headers and  metadata
-        out << "  (SDFVERSION " << format_name(sdfversion) << ")" << std::endl;
-        out << "  (DESIGN " << format_name(design) << ")" << std::endl;
-        out << "  (VENDOR " << format_name(vendor) << ")" << std::endl;
-        out << "  (PROGRAM " << format_name(program) << ")" << std::endl;
-        out << "  (DIVIDER " << (cvc_mode ? "." : "/") << ")" << std::endl;
-        out << "  (TIMESCALE 1ps)" << std::endl;
-        // Write interconnect delays, with the main design begin a "cell"
-        out << "  (CELL" << std::endl;
-        out << "    (CELLTYPE " << format_name(design) << ")" << std::endl;
-        out << "    (INSTANCE )" << std::endl;
-        out << "    (DELAY" << std::endl;
-        out << "      (ABSOLUTE" << std::endl;
-        for (auto &ic : conn) {
+        if (ni->driver.cell == nullptr)
+            return;
+        for (auto &usr : ni->users) {
             out << "        (INTERCONNECT ";
-            write_port(out, ic.from);
+            write_port(out, ni->driver);
             out << " ";
-            write_port(out, ic.to);
+            write_port(out, usr);
             out << " ";
-            write_delay(out, ic.delay);
-            out << ")" << std::endl;
-        }
-        out << "      )" << std::endl;
-        out << "    )" << std::endl;
-        out << "  )" << std::endl;
-        // Write cells
-        for (auto &cell : cells) {
-            out << "  (CELL" << std::endl;
-            out << "    (CELLTYPE " << format_name(cell.celltype) << ")" << std::endl;
-            out << "    (INSTANCE " << escape_name(cell.instance) << ")" << std::endl;
-            // IOPATHs (combinational delay and clock-to-q)
-            if (!cell.iopaths.empty()) {
-                out << "    (DELAY" << std::endl;
-                out << "      (ABSOLUTE" << std::endl;
-                for (auto &path : cell.iopaths) {
-                    out << "        (IOPATH " << escape_name(path.from) << " " << escape_name(path.to) << " ";
-                    write_delay(out, path.delay);
-                    out << ")" << std::endl;
-                }
-                out << "      )" << std::endl;
-                out << "    )" << std::endl;
-            }
-            // Timing Checks (setup/hold, period, width)
-            if (!cell.checks.empty()) {
-                out << "    (TIMINGCHECK" << std::endl;
-                for (auto &check : cell.checks) {
-                    out << "      (" << timing_check_name(check.type) << " ";
-                    write_portedge(out, check.from);
-                    out << " ";
-                    if (check.type == TimingCheck::SETUPHOLD) {
-                        write_portedge(out, check.to);
-                        out << " ";
-                    }
-                    if (check.type == TimingCheck::SETUPHOLD)
-                        write_delay(out, check.delay);
-                    else
-                        write_delay(out, check.delay.rise);
-                    out << ")" << std::endl;
-                }
-                out << "    )" << std::endl;
-            }
-            out << "    )" << std::endl;
+            // FIXME: min/max routing delay - or at least constructing DelayInfo here
+            write_delay(out, convert_delay(ctx->getDelayFromNS(ctx->getDelayNS(ctx->getNetinfoRouteDelay(ni, usr)))));
+            out << ")\n";
         }
-        out << ")" << std::endl;
     }
-};
-
-} // namespace SDF
-
-void Context::writeSDF(std::ostream &out, bool cvc_mode) const
-{
-    using namespace SDF;
-    SDFWriter wr;
-    wr.cvc_mode = cvc_mode;
-    wr.design = str_or_default(attrs, id("module"), "top");
-    wr.sdfversion = "3.0";
-    wr.vendor = "nextpnr";
-    wr.program = "nextpnr";
-
-    const double delay_scale = 1000;
-    // Convert from DelayInfo to SDF-friendly RiseFallDelay
-    auto convert_delay = [&](const DelayInfo &dly) {
-        RiseFallDelay rf;
-        rf.rise.min = getDelayNS(dly.minRaiseDelay()) * delay_scale;
-        rf.rise.typ = getDelayNS((dly.minRaiseDelay() + dly.maxRaiseDelay()) / 2) * delay_scale; // fixme: typ delays?
-        rf.rise.max = getDelayNS(dly.maxRaiseDelay()) * delay_scale;
-        rf.fall.min = getDelayNS(dly.minFallDelay()) * delay_scale;
-        rf.fall.typ = getDelayNS((dly.minFallDelay() + dly.maxFallDelay()) / 2) * delay_scale; // fixme: typ delays?
-        rf.fall.max = getDelayNS(dly.maxFallDelay()) * delay_scale;
-        return rf;
-    };
 
-    auto convert_setuphold = [&](const DelayInfo &setup, const DelayInfo &hold) {
-        RiseFallDelay rf;
-        rf.rise.min = getDelayNS(setup.minDelay()) * delay_scale;
-        rf.rise.typ = getDelayNS((setup.minDelay() + setup.maxDelay()) / 2) * delay_scale; // fixme: typ delays?
-        rf.rise.max = getDelayNS(setup.maxDelay()) * delay_scale;
-        rf.fall.min = getDelayNS(hold.minDelay()) * delay_scale;
-        rf.fall.typ = getDelayNS((hold.minDelay() + hold.maxDelay()) / 2) * delay_scale; // fixme: typ delays?
-        rf.fall.max = getDelayNS(hold.maxDelay()) * delay_scale;
-        return rf;
-    };
-
-    for (auto cell : sorted(cells)) {
-        Cell sc;
-        const CellInfo *ci = cell.second;
-        sc.instance = ci->name.str(this);
-        sc.celltype = ci->type.str(this);
-        for (auto port : ci->ports) {
+    void write_cell(OutBuffer &out, const CellInfo *ci)
+    {
+        // IOPATHs (combinational delay and clock-to-q) and timing checks are found port by port, but written in
+        // separate sections
+        OutBuffer iopaths(nullptr, 256), checks(nullptr, 256);
+        for (auto &port : ci->ports) {
             int clockCount = 0;
-            TimingPortClass cls = getPortTimingClass(ci, port.first, clockCount);
+            TimingPortClass cls = ctx->getPortTimingClass(ci, port.first, clockCount);
             if (cls == TMG_IGNORE)
                 continue;
             if (port.second.net == nullptr)
                 continue; // Ignore disconnected ports
             if (port.second.type != PORT_IN) {
                 // Add combinational paths to this output (or inout)
-                for (auto other : ci->ports) {
+                for (auto &other : ci->ports) {
                     if (other.second.net == nullptr)
                         continue;
                     if (other.second.type == PORT_OUT)
                         continue;
                     DelayInfo dly;
-                    if (!getCellDelay(ci, other.first, port.first, dly))
+                    if (!ctx->getCellDelay(ci, other.first, port.first, dly))
                         continue;
-                    IOPath iop;
-                    iop.from = other.first.str(this);
-                    iop.to = port.first.str(this);
-                    iop.delay = convert_delay(dly);
-                    sc.iopaths.push_back(iop);
+                    write_iopath(iopaths, other.first, port.first, convert_delay(dly));
                 }
                 // Add clock-to-output delays, also as IOPaths
                 if (cls == TMG_REGISTER_OUTPUT)
                     for (int i = 0; i < clockCount; i++) {
-                        auto clkInfo = getPortClockingInfo(ci, port.first, i);
-                        IOPath cqp;
-                        cqp.from = clkInfo.clock_port.str(this);
-                        cqp.to = port.first.str(this);
-                        cqp.delay = convert_delay(clkInfo.clockToQ);
-                        sc.iopaths.push_back(cqp);
+                        auto clkInfo = ctx->getPortClockingInfo(ci, port.first, i);
+                        write_iopath(iopaths, clkInfo.clock_port, port.first, convert_delay(clkInfo.clockToQ));
                     }
             }
             if (port.second.type != PORT_OUT && cls == TMG_REGISTER_INPUT) {
-                // Add setup/hold checks
+                // Add setup/hold checks, equally for rising and falling edges of the data
                 for (int i = 0; i < clockCount; i++) {
-                    auto clkInfo = getPortClockingInfo(ci, port.first, i);
-                    TimingCheck chk;
-                    chk.from.edge = RISING_EDGE; // Add setup/hold checks equally for rising and falling edges
-                    chk.from.port = port.first.str(this);
-                    chk.to.edge = clkInfo.edge;
-                    chk.to.port = clkInfo.clock_port.str(this);
-                    chk.type = TimingCheck::SETUPHOLD;
-                    chk.delay = convert_setuphold(clkInfo.setup, clkInfo.hold);
-                    sc.checks.push_back(chk);
-                    chk.from.edge = FALLING_EDGE;
-                    sc.checks.push_back(chk);
+                    auto clkInfo = ctx->getPortClockingInfo(ci, port.first, i);
+                    RiseFallDelay delay = convert_setuphold(clkInfo.setup, clkInfo.hold);
+                    for (ClockEdge edge : {RISING_EDGE, FALLING_EDGE}) {
+                        checks << "      (SETUPHOLD ";
+                        write_portedge(checks, port.first, edge);
+                        checks << " ";
+                        write_portedge(checks, clkInfo.clock_port, clkInfo.edge);
+                        checks << " ";
+                        write_delay(checks, delay);
+                        checks << ")\n";
+                    }
                 }
             }
         }
-        wr.cells.push_back(sc);
+
+        out << "  (CELL\n";
+        out << "    (CELLTYPE ";
+        write_name(out, ci->type.str(ctx));
+        out << ")\n";
+        out << "    (INSTANCE ";
+        write_escaped(out, ci->name.str(ctx));
+        out << ")\n";
+        if (!iopaths.buf.empty()) {
+            out << "    (DELAY\n";
+            out << "      (ABSOLUTE\n";
+            out << iopaths.buf;
+            out << "      )\n";
+            out << "    )\n";
+        }
+        if (!checks.buf.empty()) {
+            out << "    (TIMINGCHECK\n";
+            out << checks.buf;
+            out << "    )\n";
+        }
+        out << "    )\n";
     }
 
-    for (auto net : sorted(nets)) {
-        NetInfo *ni = net.second;
-        if (ni->driver.cell == nullptr)
-            continue;
-        for (auto &usr : ni->users) {
-            Interconnect ic;
-            ic.from.cell = ni->driver.cell->name.str(this);
-            ic.from.port = ni->driver.port.str(this);
-            ic.to.cell = usr.cell->name.str(this);
-            ic.to.port = usr.port.str(this);
-            // FIXME: min/max routing delay - or at least constructing DelayInfo here
-            ic.delay = convert_delay(getDelayFromNS(getDelayNS(getNetinfoRouteDelay(ni, usr))));
-            wr.conn.push_back(ic);
+    void write_iopath(OutBuffer &out, IdString from, IdString to, const RiseFallDelay &delay)
+    {
+        out << "        (IOPATH ";
+        write_escaped(out, from.str(ctx));
+        out << " ";
+        write_escaped(out, to.str(ctx));
+        out << " ";
+        write_delay(out, delay);
+        out << ")\n";
+    }
+
+    // Write items [0, count) with write_item, in windows that are each split between the worker threads; the
+    // windows keep the memory used by the per thread buffers bounded
+    template <typename Func> void write_items(OutBuffer &out, size_t count, Func write_item)
+    {
+        const size_t window = 16384;
+        for (size_t begin = 0; begin < count; begin += window) {
+            size_t end = std::min(count, begin + window);
+            int ranges = std::max<int>(1, std::min<int>(threads * 4, int(end - begin) / 64));
+            std::vector<OutBuffer> bufs(ranges);
+            auto do_range = [&](int range) {
+                size_t rbegin = begin + (end - begin) * range / ranges;
+                size_t rend = begin + (end - begin) * (range + 1) / ranges;
+                for (size_t i = rbegin; i < rend; i++)
+                    write_item(bufs.at(range), i);
+            };
+#ifndef NPNR_DISABLE_THREADS
+            if (pool != nullptr && ranges > 1) {
+                std::vector<int> tasks(ranges);
+                std::iota(tasks.begin(), tasks.end(), 0);
+                pool->run(tasks, do_range);
+            } else
+#endif
+                for (int range = 0; range < ranges; range++)
+                    do_range(range);
+            for (auto &buf : bufs)
+                out << buf.buf;
         }
     }
-    wr.write(out);
+
+    void write(OutBuffer &out)
+    {
+        auto cells = sorted(ctx->cells);
+        auto nets = sorted(ctx->nets);
+
+        out << "(DELAYFILE\n";
+        // Headers and  metadata
+        out << "  (SDFVERSION \"3.0\")\n";
+        out << "  (DESIGN ";
+        write_name(out, design);
+        out << ")\n";
+        out << "  (VENDOR \"nextpnr\")\n";
+        out << "  (PROGRAM \"nextpnr\")\n";
+        out << "  (DIVIDER " << (cvc_mode ? "." : "/") << ")\n";
+        out << "  (TIMESCALE 1ps)\n";
+        // Write interconnect delays, with the main design begin a "cell"
+        out << "  (CELL\n";
+        out << "    (CELLTYPE ";
+        write_name(out, design);
+        out << ")\n";
+        out << "    (INSTANCE )\n";
+        out << "    (DELAY\n";
+        out << "      (ABSOLUTE\n";
+        write_items(out, nets.size(), [&](OutBuffer &buf, size_t i) { write_interconnects(buf, nets.at(i).second); });
+        out << "      )\n";
+        out << "    )\n";
+        out << "  )\n";
+        // Write cells
+        write_items(out, cells.size(), [&](OutBuffer &buf, size_t i) { write_cell(buf, cells.at(i).second); });
+        out << ")\n";
+    }
+};
+
+} // namespace SDF
+
+void Context::writeSDF(std::ostream &out, bool cvc_mode) const
+{
+    using namespace SDF;
+    SDFWriter wr;
+    wr.ctx = this;
+    wr.cvc_mode = cvc_mode;
+    wr.design = str_or_default(attrs, id("module"), "top");
+#ifndef NPNR_DISABLE_THREADS
+    wr.threads = stage_threads("sdf", 0);
+    if (wr.threads > 1)
+        wr.pool.reset(new WorkerPool(wr.threads));
+#endif
+    OutBuffer buf(&out);
+    wr.write(buf);
+    buf.flush();
 }
 
-NEXTPNR_NAMESPACE_END
\ No newline at end of file
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,181 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef SEARCH_QUEUE_H
+#define SEARCH_QUEUE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <vector>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// Queue of the A* searches of the routers, popping the entry with the lowest cost first. By default this is the
+// binary heap of std::priority_queue, ordered by Greater. With a bucket width set, it is instead a bucket queue over
+// the cost quantised by that width (as given by KeyOf), which makes push and pop constant time at the price of
+// popping entries within a bucket in last in, first out order rather than by exact cost. The buckets are a ring
+// covering ring_size widths above the current lowest cost, with costs further out held aside until the ring reaches
+// them. A* heuristics that aren't consistent can push costs below the current lowest, and the ring then moves down to
+// take them, so that they still come out first as they would from the heap.
+template <typename T, typename Greater, typename KeyOf> class SearchQueue
+{
+  public:
+    // 0 selects the binary heap; only call while the queue is empty
+    void set_bucket_width(double width)
+    {
+        NPNR_ASSERT(empty());
+        bucket_width = width;
+        if (width > 0 && ring.empty())
+            ring.resize(ring_size);
+    }
+    bool bucketed() const { return bucket_width > 0; }
+
+    bool empty() const { return bucketed() ? (count == 0) : heap.empty(); }
+    size_t size() const { return bucketed() ? count : heap.size(); }
+
+    void push(const T &t)
+    {
+        if (!bucketed()) {
+            heap.push(t);
+            return;
+        }
+        int64_t q = quantise(t);
+        if (count == 0)
+            base = ring_top = q;
+        else if (q < base)
+            lower_base(q);
+        if (q - base < int64_t(ring_size)) {
+            ring[q & ring_mask].push_back(t);
+            ++in_ring;
+            ring_top = std::max(ring_top, q);
+        } else {
+            far.push_back(t);
+            far_min = std::min(far_min, q);
+        }
+        ++count;
+    }
+
+    const T &top()
+    {
+        if (!bucketed())
+            return heap.top();
+        advance();
+        return ring[base & ring_mask].back();
+    }
+
+    void pop()
+    {
+        if (!bucketed()) {
+            heap.pop();
+            return;
+        }
+        advance();
+        ring[base & ring_mask].pop_back();
+        --in_ring;
+        --count;
+    }
+
+    void clear()
+    {
+        if (!bucketed()) {
+            std::priority_queue<T, std::vector<T>, Greater> new_heap;
+            heap.swap(new_heap);
+            return;
+        }
+        if (in_ring > 0)
+            for (auto &bucket : ring)
+                bucket.clear();
+        far.clear();
+        far_min = std::numeric_limits<int64_t>::max();
+        in_ring = 0;
+        count = 0;
+    }
+
+  private:
+    enum : size_t
+    {
+        ring_size = 4096,
+        ring_mask = ring_size - 1
+    };
+
+    double bucket_width = 0;
+    std::priority_queue<T, std::vector<T>, Greater> heap;
+
+    std::vector<std::vector<T>> ring;
+    // Entries too far above base for the ring
+    std::vector<T> far;
+    int64_t far_min = std::numeric_limits<int64_t>::max();
+    // Quantised cost of the lowest bucket that may be non-empty, and of the highest
+    int64_t base = 0, ring_top = 0;
+    size_t count = 0, in_ring = 0;
+
+    int64_t quantise(const T &t) const { return int64_t(std::floor(double(KeyOf()(t)) / bucket_width)); }
+
+    // Move the ring down to start at q, holding aside the buckets that no longer fit in it
+    void lower_base(int64_t q)
+    {
+        int64_t first_far = q + int64_t(ring_size);
+        for (int64_t k = std::max(base, first_far); k <= ring_top && in_ring > 0; k++) {
+            auto &bucket = ring[k & ring_mask];
+            if (bucket.empty())
+                continue;
+            far.insert(far.end(), bucket.begin(), bucket.end());
+            far_min = std::min(far_min, k);
+            in_ring -= bucket.size();
+            bucket.clear();
+        }
+        base = q;
+        ring_top = std::min(ring_top, first_far - 1);
+    }
+
+    // Move base to the lowest non-empty bucket, bringing far entries into the ring once base reaches them
+    void advance()
+    {
+        NPNR_ASSERT(count > 0);
+        if (in_ring == 0)
+            base = ring_top = far_min;
+        else
+            while (ring[base & ring_mask].empty() && base < far_min)
+                ++base;
+        if (far.empty() || base < far_min)
+            return;
+        size_t kept = 0;
+        far_min = std::numeric_limits<int64_t>::max();
+        for (size_t i = 0; i < far.size(); i++) {
+            int64_t q = quantise(far[i]);
+            if (q - base < int64_t(ring_size)) {
+                ring[q & ring_mask].push_back(far[i]);
+                ++in_ring;
+                ring_top = std::max(ring_top, q);
+            } else {
+                far_min = std::min(far_min, q);
+                far[kept++] = far[i];
+            }
+        }
+        far.resize(kept);
+    }
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -17,10 +17,16 @@
  *
  */
 
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <cmath>
 #include <fstream>
+#include <map>
 #include "log.h"
 #include "nextpnr.h"
+#include "out_buffer.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -28,10 +34,31 @@ namespace {
 struct SVGWriter
 {
     const Context *ctx;
-    std::ostream &out;
+    OutBuffer &out;
     float scale = 500.0;
     bool hide_inactive = false;
-    SVGWriter(const Context *ctx, std::ostream &out) : ctx(ctx), out(out){};
+    // Only draw bound bels, and wires and pips used by nets, found through the netlist rather than the whole device
+    bool used_only = false;
+    // Draw one box per tile, shaded by its number of bound bels, instead of the bels themselves
+    bool per_tile = false;
+    // Join collinear horizontal and vertical lines, and write the lines of each style as a few paths
+    bool merge = false;
+
+    struct Segment
+    {
+        float a1, a2, b;
+    };
+    // Lines held back for merging, for each style: horizontal, vertical and other lines
+    std::vector<std::vector<Segment>> hlines, vlines;
+    std::vector<std::vector<GraphicElement>> other_lines;
+
+    SVGWriter(const Context *ctx, OutBuffer &out) : ctx(ctx), out(out)
+    {
+        hlines.resize(GraphicElement::STYLE_MAX);
+        vlines.resize(GraphicElement::STYLE_MAX);
+        other_lines.resize(GraphicElement::STYLE_MAX);
+    };
+
     const char *get_stroke_colour(GraphicElement::style_t style)
     {
         switch (style) {
@@ -48,6 +75,46 @@ struct SVGWriter
         }
     }
 
+    void coord(float value)
+    {
+        char tmp[32];
+        snprintf(tmp, sizeof(tmp), "%.6g", value * scale);
+        out << tmp;
+    }
+
+    void write_line(float x1, float y1, float x2, float y2, GraphicElement::style_t style)
+    {
+        out << "<line x1=\"";
+        coord(x1);
+        out << "\" y1=\"";
+        coord(y1);
+        out << "\" x2=\"";
+        coord(x2);
+        out << "\" y2=\"";
+        coord(y2);
+        out << "\" stroke=\"" << get_stroke_colour(style) << "\"/>\n";
+    }
+
+    void write_rect(float x1, float y1, float x2, float y2, GraphicElement::style_t style, const char *fill,
+                    float opacity = 1)
+    {
+        out << "<rect x=\"";
+        coord(x1);
+        out << "\" y=\"";
+        coord(y1);
+        out << "\" width=\"";
+        coord(x2 - x1);
+        out << "\" height=\"";
+        coord(y2 - y1);
+        out << "\" stroke=\"" << get_stroke_colour(style) << "\" fill=\"" << fill << "\"";
+        if (opacity < 1) {
+            char tmp[32];
+            snprintf(tmp, sizeof(tmp), " fill-opacity=\"%.2f\"", opacity);
+            out << tmp;
+        }
+        out << "/>\n";
+    }
+
     void write_decal(const DecalXY &dxy)
     {
         for (const auto &el : ctx->getDecalGraphics(dxy.decal)) {
@@ -57,17 +124,22 @@ struct SVGWriter
             switch (el.type) {
             case GraphicElement::TYPE_LINE:
             case GraphicElement::TYPE_ARROW:
-                out << stringf("<line x1=\"%f\" y1=\"%f\" x2=\"%f\" y2=\"%f\" stroke=\"%s\"/>", (el.x1 + dxy.x) * scale,
-                               (el.y1 + dxy.y) * scale, (el.x2 + dxy.x) * scale, (el.y2 + dxy.y) * scale,
-                               get_stroke_colour(el.style))
-                    << std::endl;
+                if (!merge)
+                    write_line(el.x1 + dxy.x, el.y1 + dxy.y, el.x2 + dxy.x, el.y2 + dxy.y, el.style);
+                else if (el.y1 == el.y2)
+                    hlines.at(el.style).push_back(Segment{std::min(el.x1, el.x2) + dxy.x,
+                                                          std::max(el.x1, el.x2) + dxy.x, el.y1 + dxy.y});
+                else if (el.x1 == el.x2)
+                    vlines.at(el.style).push_back(Segment{std::min(el.y1, el.y2) + dxy.y,
+                                                          std::max(el.y1, el.y2) + dxy.y, el.x1 + dxy.x});
+                else
+                    other_lines.at(el.style).push_back(GraphicElement(el.type, el.style, el.x1 + dxy.x,
+                                                                      el.y1 + dxy.y, el.x2 + dxy.x, el.y2 + dxy.y,
+                                                                      el.z));
                 break;
             case GraphicElement::TYPE_BOX:
-                out << stringf("<rect x=\"%f\" y=\"%f\" width=\"%f\" height=\"%f\" stroke=\"%s\" fill=\"%s\"/>",
-                               (el.x1 + dxy.x) * scale, (el.y1 + dxy.y) * scale, (el.x2 - el.x1) * scale,
-                               (el.y2 - el.y1) * scale, get_stroke_colour(el.style),
-                               el.style == GraphicElement::STYLE_ACTIVE ? "#FF8080" : "none")
-                    << std::endl;
+                write_rect(el.x1 + dxy.x, el.y1 + dxy.y, el.x2 + dxy.x, el.y2 + dxy.y, el.style,
+                           el.style == GraphicElement::STYLE_ACTIVE ? "#FF8080" : "none");
                 break;
             default:
                 break;
@@ -75,76 +147,198 @@ struct SVGWriter
         }
     }
 
+    // Merge overlapping or touching segments that lie on the same line
+    static void merge_segments(std::vector<Segment> &segs)
+    {
+        std::sort(segs.begin(), segs.end(),
+                  [](const Segment &a, const Segment &b) { return a.b < b.b || (a.b == b.b && a.a1 < b.a1); });
+        size_t n = 0;
+        for (size_t i = 0; i < segs.size(); i++) {
+            if (n > 0 && segs.at(n - 1).b == segs.at(i).b && segs.at(i).a1 <= segs.at(n - 1).a2)
+                segs.at(n - 1).a2 = std::max(segs.at(n - 1).a2, segs.at(i).a2);
+            else
+                segs.at(n++) = segs.at(i);
+        }
+        segs.resize(n);
+    }
+
+    void write_merged_lines()
+    {
+        // Paths are split every so often to keep each element to a reasonable size
+        const int max_path_segments = 4096;
+        for (int style = 0; style < GraphicElement::STYLE_MAX; style++) {
+            auto &hl = hlines.at(style), &vl = vlines.at(style);
+            merge_segments(hl);
+            merge_segments(vl);
+            int count = 0;
+            auto begin_segment = [&]() {
+                if (count % max_path_segments == 0) {
+                    if (count > 0)
+                        out << "\"/>\n";
+                    out << "<path fill=\"none\" stroke=\"" << get_stroke_colour(GraphicElement::style_t(style))
+                        << "\" d=\"";
+                } else {
+                    out << " ";
+                }
+                count++;
+            };
+            for (auto &seg : hl) {
+                begin_segment();
+                out << "M";
+                coord(seg.a1);
+                out << " ";
+                coord(seg.b);
+                out << "H";
+                coord(seg.a2);
+            }
+            for (auto &seg : vl) {
+                begin_segment();
+                out << "M";
+                coord(seg.b);
+                out << " ";
+                coord(seg.a1);
+                out << "V";
+                coord(seg.a2);
+            }
+            for (auto &el : other_lines.at(style)) {
+                begin_segment();
+                out << "M";
+                coord(el.x1);
+                out << " ";
+                coord(el.y1);
+                out << "L";
+                coord(el.x2);
+                out << " ";
+                coord(el.y2);
+            }
+            if (count > 0)
+                out << "\"/>\n";
+        }
+    }
+
+    void write_tiles()
+    {
+        std::map<std::pair<int, int>, int> used;
+        int max_used = 1;
+        for (auto &cell : ctx->cells) {
+            if (cell.second->bel == BelId())
+                continue;
+            DecalXY dxy = ctx->getBelDecal(cell.second->bel);
+            int &count = used[std::make_pair(int(std::floor(dxy.x)), int(std::floor(dxy.y)))];
+            max_used = std::max(max_used, ++count);
+        }
+        for (auto &tile : used) {
+            float x = tile.first.first, y = tile.first.second;
+            write_rect(x, y, x + 1, y + 1, GraphicElement::STYLE_FRAME, "#FF3030",
+                       0.2f + 0.8f * float(tile.second) / max_used);
+        }
+    }
+
     void operator()(const std::string &flags)
     {
         std::vector<std::string> options;
-        boost::algorithm::split(options, flags, boost::algorithm::is_space());
+        boost::algorithm::split(options, flags, boost::algorithm::is_space(), boost::algorithm::token_compress_on);
         bool noroute = false;
         for (const auto &opt : options) {
-            if (boost::algorithm::starts_with(opt, "scale=")) {
+            if (opt.empty()) {
+                continue;
+            } else if (boost::algorithm::starts_with(opt, "scale=")) {
                 scale = float(std::stod(opt.substr(6)));
                 continue;
             } else if (opt == "hide_routing") {
                 noroute = true;
             } else if (opt == "hide_inactive") {
                 hide_inactive = true;
+            } else if (opt == "used_only") {
+                used_only = true;
+            } else if (opt == "per_tile") {
+                per_tile = true;
+            } else if (opt == "merge") {
+                merge = true;
             } else {
                 log_error("Unknown SVG option '%s'\n", opt.c_str());
             }
         }
         float max_x = 0, max_y = 0;
-        for (auto group : ctx->getGroups()) {
-            auto decal = ctx->getGroupDecal(group);
-            for (auto el : ctx->getDecalGraphics(decal.decal)) {
-                max_x = std::max(max_x, decal.x + el.x1 + 1);
-                max_y = std::max(max_y, decal.y + el.y1 + 1);
-            }
-        }
-        for (auto bel : ctx->getBels()) {
-            auto decal = ctx->getBelDecal(bel);
-            for (auto el : ctx->getDecalGraphics(decal.decal)) {
-                max_x = std::max(max_x, decal.x + el.x1 + 1);
-                max_y = std::max(max_y, decal.y + el.y1 + 1);
-            }
-        }
-        for (auto wire : ctx->getWires()) {
-            auto decal = ctx->getWireDecal(wire);
-            for (auto el : ctx->getDecalGraphics(decal.decal)) {
+        auto update_bounds = [&](const DecalXY &decal) {
+            for (auto &el : ctx->getDecalGraphics(decal.decal)) {
                 max_x = std::max(max_x, decal.x + el.x1 + 1);
                 max_y = std::max(max_y, decal.y + el.y1 + 1);
             }
-        }
-        for (auto pip : ctx->getPips()) {
-            auto decal = ctx->getPipDecal(pip);
-            for (auto el : ctx->getDecalGraphics(decal.decal)) {
-                max_x = std::max(max_x, decal.x + el.x1 + 1);
-                max_y = std::max(max_y, decal.y + el.y1 + 1);
-            }
-        }
-        out << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>" << std::endl;
-        out << stringf("<svg viewBox=\"0 0 %f %f\" width=\"%f\" height=\"%f\" xmlns=\"http://www.w3.org/2000/svg\">",
-                       max_x * scale, max_y * scale, max_x * scale, max_y * scale)
-            << std::endl;
-        out << "<rect x=\"0\" y=\"0\" width=\"100%\" height=\"100%\" stroke=\"#fff\" fill=\"#fff\"/>" << std::endl;
+        };
+        // The bounds of the device, so that snapshots of a design line up; routing not drawn doesn't count
         for (auto group : ctx->getGroups())
-            write_decal(ctx->getGroupDecal(group));
+            update_bounds(ctx->getGroupDecal(group));
         for (auto bel : ctx->getBels())
-            write_decal(ctx->getBelDecal(bel));
-        if (!noroute) {
+            update_bounds(ctx->getBelDecal(bel));
+        if (!noroute && !used_only) {
             for (auto wire : ctx->getWires())
-                write_decal(ctx->getWireDecal(wire));
+                update_bounds(ctx->getWireDecal(wire));
             for (auto pip : ctx->getPips())
-                write_decal(ctx->getPipDecal(pip));
+                update_bounds(ctx->getPipDecal(pip));
         }
-        out << "</svg>" << std::endl;
+        out << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n";
+        out << "<svg viewBox=\"0 0 ";
+        coord(max_x);
+        out << " ";
+        coord(max_y);
+        out << "\" width=\"";
+        coord(max_x);
+        out << "\" height=\"";
+        coord(max_y);
+        out << "\" xmlns=\"http://www.w3.org/2000/svg\">\n";
+        out << "<rect x=\"0\" y=\"0\" width=\"100%\" height=\"100%\" stroke=\"#fff\" fill=\"#fff\"/>\n";
+        if (!used_only)
+            for (auto group : ctx->getGroups())
+                write_decal(ctx->getGroupDecal(group));
+        if (per_tile) {
+            write_tiles();
+        } else if (used_only) {
+            for (auto cell : sorted(ctx->cells))
+                if (cell.second->bel != BelId())
+                    write_decal(ctx->getBelDecal(cell.second->bel));
+        } else {
+            for (auto bel : ctx->getBels())
+                write_decal(ctx->getBelDecal(bel));
+        }
+        if (!noroute) {
+            if (used_only) {
+                for (auto net : sorted(ctx->nets))
+                    for (auto &wire : net.second->wires) {
+                        write_decal(ctx->getWireDecal(wire.first));
+                        if (wire.second.pip != PipId())
+                            write_decal(ctx->getPipDecal(wire.second.pip));
+                    }
+            } else {
+                for (auto wire : ctx->getWires())
+                    write_decal(ctx->getWireDecal(wire));
+                for (auto pip : ctx->getPips())
+                    write_decal(ctx->getPipDecal(pip));
+            }
+        }
+        if (merge)
+            write_merged_lines();
+        out << "</svg>\n";
     }
 };
 } // namespace
 
 void Context::writeSVG(const std::string &filename, const std::string &flags) const
 {
-    std::ofstream out(filename);
-    SVGWriter(this, out)(flags);
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+        log_error("Failed to open SVG file '%s' for writing.\n", filename.c_str());
+    // Compress the output for .svgz files
+    boost::iostreams::filtering_ostream gz;
+    std::ostream *out = &file;
+    if (boost::algorithm::ends_with(filename, ".svgz")) {
+        gz.push(boost::iostreams::gzip_compressor());
+        gz.push(file);
+        out = &gz;
+    }
+    OutBuffer buf(out);
+    SVGWriter(this, buf)(flags);
+    buf.flush();
 }
 
 NEXTPNR_NAMESPACE_END
@@ -20,13 +20,19 @@
 
 #include "timing.h"
 #include <algorithm>
+#include <array>
 #include <boost/range/adaptor/reversed.hpp>
 #include <deque>
+#include <functional>
 #include <map>
+#include <queue>
 #include <unordered_map>
 #include <utility>
+#include "design_utils.h"
 #include "log.h"
+#include "profiler.h"
 #include "util.h"
+#include "worker_pool.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -75,6 +81,69 @@ template <> struct hash<NEXTPNR_NAMESPACE_PREFIX ClockPair>
 } // namespace std
 NEXTPNR_NAMESPACE_BEGIN
 
+namespace {
+// Data for each clock event seen by a net. Nets almost always see only one or two clock events, so the first N entries
+// are stored inline and looked up by linear search, and only nets with more than that allocate.
+template <typename T, size_t N = 2> struct ClockEventMap
+{
+    typedef std::pair<ClockEvent, T> value_type;
+
+    template <typename Map, typename Value> struct iterator_base
+    {
+        Map *map;
+        size_t idx;
+
+        Value &operator*() const { return map->at(idx); }
+        Value *operator->() const { return &map->at(idx); }
+        iterator_base &operator++()
+        {
+            ++idx;
+            return *this;
+        }
+        bool operator==(const iterator_base &other) const { return idx == other.idx; }
+        bool operator!=(const iterator_base &other) const { return idx != other.idx; }
+    };
+    typedef iterator_base<ClockEventMap, value_type> iterator;
+    typedef iterator_base<const ClockEventMap, const value_type> const_iterator;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    value_type &at(size_t i) { return i < N ? fixed[i] : extra.at(i - N); }
+    const value_type &at(size_t i) const { return i < N ? fixed[i] : extra.at(i - N); }
+
+    iterator begin() { return iterator{this, 0}; }
+    iterator end() { return iterator{this, count}; }
+    const_iterator begin() const { return const_iterator{this, 0}; }
+    const_iterator end() const { return const_iterator{this, count}; }
+
+    iterator find(const ClockEvent &ev)
+    {
+        for (size_t i = 0; i < count; i++)
+            if (at(i).first == ev)
+                return iterator{this, i};
+        return end();
+    }
+
+    T &operator[](const ClockEvent &ev)
+    {
+        auto found = find(ev);
+        if (found != end())
+            return found->second;
+        if (count < N)
+            fixed[count] = value_type(ev, T());
+        else
+            extra.emplace_back(ev, T());
+        return at(count++).second;
+    }
+
+  private:
+    std::array<value_type, N> fixed;
+    std::vector<value_type> extra;
+    size_t count = 0;
+};
+} // namespace
+
 typedef std::vector<const PortRef *> PortRefVector;
 typedef std::map<int, unsigned> DelayFrequency;
 
@@ -86,47 +155,159 @@ struct CriticalPath
 };
 
 typedef std::unordered_map<ClockPair, CriticalPath> CriticalPathMap;
+// The worst paths of each clock pair, most critical first
+typedef std::unordered_map<ClockPair, std::vector<CriticalPath>> WorstPathMap;
 typedef std::unordered_map<IdString, NetCriticalityInfo> NetCriticalityMap;
 
-struct Timing
+struct TimingGraph::Impl
 {
-    Context *ctx;
-    bool net_delays;
-    bool update;
-    delay_t min_slack;
-    CriticalPathMap *crit_path;
-    DelayFrequency *slack_histogram;
-    NetCriticalityMap *net_crit;
-    IdString async_clock;
-
-    struct TimingData
+    // A sink of a net: its port class, the clock events that capture it (with their setup times) if it is a register
+    // input or endpoint, and the combinational arcs through its cell to the nodes that cell drives. Delays are kept as
+    // DelayInfo so that both the slow (max) and fast (min) corner can be analysed.
+    struct Sink
     {
-        TimingData() : max_arrival(), max_path_length(), min_remaining_budget() {}
-        TimingData(delay_t max_arrival) : max_arrival(max_arrival), max_path_length(), min_remaining_budget() {}
-        delay_t max_arrival;
-        unsigned max_path_length = 0;
-        delay_t min_remaining_budget;
-        bool false_startpoint = false;
-        std::vector<delay_t> min_required;
-        std::unordered_map<ClockEvent, delay_t> arrival_time;
+        TimingPortClass port_class;
+        std::vector<std::pair<ClockEvent, DelayInfo>> captures;
+        // Path exceptions that each capture is a to object of
+        std::vector<uint64_t> capture_exceptions;
+        std::vector<std::pair<int, DelayInfo>> arcs;
+    };
+    // A combinational arc through the driver of a net, from a sink (user index from_user of node from_node, or -1 if
+    // the cell is not a user of that net) that has class from_class
+    struct Fanin
+    {
+        int from_node, from_user;
+        TimingPortClass from_class;
+        DelayInfo delay;
+    };
+    // A start point of paths through a net
+    struct Launch
+    {
+        ClockEvent clock;
+        DelayInfo arrival;
+        bool false_startpoint;
+        // Path exceptions that the start point is a from object of
+        uint64_t exceptions;
+    };
+    struct Node
+    {
+        NetInfo *net;
+        // One per user of net
+        std::vector<Sink> sinks;
+        std::vector<Fanin> fanin;
+        std::vector<Launch> launches;
     };
 
-    Timing(Context *ctx, bool net_delays, bool update, CriticalPathMap *crit_path = nullptr,
-           DelayFrequency *slack_histogram = nullptr, NetCriticalityMap *net_crit = nullptr)
-            : ctx(ctx), net_delays(net_delays), update(update), min_slack(1.0e12 / ctx->setting<float>("target_freq")),
-              crit_path(crit_path), slack_histogram(slack_histogram), net_crit(net_crit),
-              async_clock(ctx->id("$async$"))
+    std::vector<Node> nodes;
+    std::unordered_map<const NetInfo *, int> node_index;
+    // Path exceptions (false paths, multicycle paths and maximum delays), one per bit of the exception masks of
+    // launches and captures. A path is affected by the exceptions in both the mask of its launch and of its capture.
+    std::vector<const TimingConstraint *> exceptions;
+    std::unordered_map<const TimingConstraint *, int> exception_bit;
+    // Exceptions with no from or to objects, which match anything
+    uint64_t any_from_exceptions = 0, any_to_exceptions = 0;
+    // Nodes in topological order; a node may appear more than once
+    std::vector<int> order;
+    // The entries of order grouped into levels, where level l is level_order[level_start[l]..level_start[l + 1]).
+    // Arrival times can be propagated from all the nodes of a level in parallel, with the same result as walking
+    // order serially.
+    std::vector<int> level_order;
+    std::vector<int> level_start;
+#ifndef NPNR_DISABLE_THREADS
+    // Threads for propagating arrival times, if timing/threads is more than 1
+    std::unique_ptr<WorkerPool> pool;
+#endif
+
+    int get_node(NetInfo *net)
     {
+        auto found = node_index.find(net);
+        if (found != node_index.end())
+            return found->second;
+        int idx = int(nodes.size());
+        node_index[net] = idx;
+        nodes.emplace_back();
+        nodes.back().net = net;
+        return idx;
     }
 
-    delay_t walk_paths()
+    // Give each path exception a bit, in name order so that the bits do not depend on hashing
+    void compile_exceptions(Context *ctx)
     {
-        const auto clk_period = ctx->getDelayFromNS(1.0e9 / ctx->setting<float>("target_freq")).maxDelay();
+        std::vector<const TimingConstraint *> constrs;
+        for (auto &constr : ctx->constraints) {
+            // There is no hold analysis for minimum delays to apply to
+            if (constr.second->type != TimingConstraint::MIN_DELAY)
+                constrs.push_back(constr.second.get());
+        }
+        std::sort(constrs.begin(), constrs.end(), [&](const TimingConstraint *a, const TimingConstraint *b) {
+            return a->name.str(ctx) < b->name.str(ctx);
+        });
+        if (constrs.size() > 64) {
+            log_warning("Only the first 64 of %d timing path exceptions are applied.\n", int(constrs.size()));
+            constrs.resize(64);
+        }
+        for (auto constr : constrs) {
+            int bit = int(exceptions.size());
+            exceptions.push_back(constr);
+            exception_bit[constr] = bit;
+            if (constr->from.empty())
+                any_from_exceptions |= uint64_t(1) << bit;
+            if (constr->to.empty())
+                any_to_exceptions |= uint64_t(1) << bit;
+        }
+    }
+
+    // Exceptions for which the cell port, its net or the clock domain is one of the objects in the given index
+    uint64_t match_exceptions(Context *ctx,
+                              const std::unordered_multimap<TimingConstrObjectId, TimingConstraint *> &objs,
+                              uint64_t any, const CellInfo *cell, IdString port, const NetInfo *net,
+                              const NetInfo *clock) const
+    {
+        if (exceptions.empty())
+            return 0;
+        uint64_t mask = any;
+        auto add = [&](TimingConstrObjectId obj) {
+            if (obj == TimingConstrObjectId())
+                return;
+            auto range = objs.equal_range(obj);
+            for (auto it = range.first; it != range.second; ++it) {
+                auto found = exception_bit.find(it->second);
+                if (found != exception_bit.end())
+                    mask |= uint64_t(1) << found->second;
+            }
+        };
+        add(ctx->timingWildcardObject());
+        add(cell->tmg_id);
+        add(cell->ports.at(port).tmg_id);
+        if (net != nullptr)
+            add(net->tmg_id);
+        if (clock != nullptr && clock->clkconstr)
+            add(clock->clkconstr->domain_tmg_id);
+        return mask;
+    }
+
+    uint64_t from_exceptions(Context *ctx, const CellInfo *cell, IdString port, const NetInfo *net,
+                             const NetInfo *clock) const
+    {
+        return match_exceptions(ctx, ctx->constrsFrom, any_from_exceptions, cell, port, net, clock);
+    }
+
+    uint64_t to_exceptions(Context *ctx, const CellInfo *cell, IdString port, const NetInfo *net,
+                           const NetInfo *clock) const
+    {
+        return match_exceptions(ctx, ctx->constrsTo, any_to_exceptions, cell, port, net, clock);
+    }
+
+    void build(Context *ctx)
+    {
+        const IdString async_clock = ctx->id("$async$");
+        const DelayInfo zero_delay = ctx->getDelayFromNS(0);
+
+        compile_exceptions(ctx);
 
         // First, compute the topological order of nets to walk through the circuit, assuming it is a _acyclic_ graph
         // TODO(eddieh): Handle the case where it is cyclic, e.g. combinatorial loops
-        std::vector<NetInfo *> topological_order;
-        std::unordered_map<const NetInfo *, std::unordered_map<ClockEvent, TimingData>> net_data;
+        std::unordered_map<int, std::unordered_map<ClockEvent, Launch>> launches;
         // In lieu of deleting edges from the graph, simply count the number of fanins to each output port
         std::unordered_map<const PortInfo *, unsigned> port_fanin;
 
@@ -159,25 +340,27 @@ struct Timing
             for (auto o : output_ports) {
                 int clocks = 0;
                 TimingPortClass portClass = ctx->getPortTimingClass(cell.second.get(), o->name, clocks);
+                int o_node = get_node(o->net);
                 // If output port is influenced by a clock (e.g. FF output) then add it to the ordering as a timing
                 // start-point
                 if (portClass == TMG_REGISTER_OUTPUT) {
-                    topological_order.emplace_back(o->net);
+                    order.push_back(o_node);
                     for (int i = 0; i < clocks; i++) {
                         TimingClockingInfo clkInfo = ctx->getPortClockingInfo(cell.second.get(), o->name, i);
                         const NetInfo *clknet = get_net_or_empty(cell.second.get(), clkInfo.clock_port);
                         IdString clksig = clknet ? clknet->name : async_clock;
-                        net_data[o->net][ClockEvent{clksig, clknet ? clkInfo.edge : RISING_EDGE}] =
-                                TimingData{clkInfo.clockToQ.maxDelay()};
+                        ClockEvent ev{clksig, clknet ? clkInfo.edge : RISING_EDGE};
+                        launches[o_node][ev] = Launch{ev, clkInfo.clockToQ, false,
+                                                      from_exceptions(ctx, cell.second.get(), o->name, o->net, clknet)};
                     }
 
                 } else {
                     if (portClass == TMG_STARTPOINT || portClass == TMG_GEN_CLOCK || portClass == TMG_IGNORE) {
-                        topological_order.emplace_back(o->net);
-                        TimingData td;
-                        td.false_startpoint = (portClass == TMG_GEN_CLOCK || portClass == TMG_IGNORE);
-                        td.max_arrival = 0;
-                        net_data[o->net][ClockEvent{async_clock, RISING_EDGE}] = td;
+                        order.push_back(o_node);
+                        ClockEvent ev{async_clock, RISING_EDGE};
+                        bool false_startpoint = (portClass == TMG_GEN_CLOCK || portClass == TMG_IGNORE);
+                        uint64_t exceptions = from_exceptions(ctx, cell.second.get(), o->name, o->net, nullptr);
+                        launches[o_node][ev] = Launch{ev, zero_delay, false_startpoint, exceptions};
                     }
 
                     // Don't analyse paths from a clock input to other pins - they will be considered by the
@@ -197,12 +380,10 @@ struct Timing
                             port_fanin[o]++;
                     }
                     // If there is no fanin, add the port as a false startpoint
-                    if (!port_fanin.count(o) && !net_data.count(o->net)) {
-                        topological_order.emplace_back(o->net);
-                        TimingData td;
-                        td.false_startpoint = true;
-                        td.max_arrival = 0;
-                        net_data[o->net][ClockEvent{async_clock, RISING_EDGE}] = td;
+                    if (!port_fanin.count(o) && !launches.count(o_node)) {
+                        order.push_back(o_node);
+                        ClockEvent ev{async_clock, RISING_EDGE};
+                        launches[o_node][ev] = Launch{ev, zero_delay, true, 0};
                     }
                 }
             }
@@ -213,11 +394,13 @@ struct Timing
             for (auto &p : ctx->ports) {
                 if (p.second.type != PORT_IN || p.second.net == nullptr)
                     continue;
-                topological_order.emplace_back(p.second.net);
+                order.push_back(get_node(p.second.net));
             }
         }
 
-        std::deque<NetInfo *> queue(topological_order.begin(), topological_order.end());
+        std::deque<NetInfo *> queue;
+        for (int n : order)
+            queue.push_back(nodes.at(n).net);
         // Now walk the design, from the start points identified previously, building up a topological order
         while (!queue.empty()) {
             const auto net = queue.front();
@@ -250,7 +433,7 @@ struct Timing
                                   "error.\n",
                                   ctx->nameOf(usr.cell), ctx->nameOf(port.first), ctx->nameOf(port.second.net));
                     if (--it->second == 0) {
-                        topological_order.emplace_back(port.second.net);
+                        order.push_back(get_node(port.second.net));
                         queue.emplace_back(port.second.net);
                         port_fanin.erase(it);
                     }
@@ -282,11 +465,294 @@ struct Timing
                           "timing ports, etc.\n");
         }
 
-        // Go forwards topologically to find the maximum arrival time and max path length for each net
-        for (auto net : topological_order) {
-            if (!net_data.count(net))
-                continue;
-            auto &nd_map = net_data.at(net);
+        for (auto &launch : launches)
+            for (auto &ev : launch.second)
+                nodes.at(launch.first).launches.push_back(ev.second);
+
+        // Now record the sinks and fanin of every node. This may add nodes for nets the walk above did not reach, which
+        // are then visited in turn.
+        for (size_t n = 0; n < nodes.size(); n++) {
+            NetInfo *net = nodes.at(n).net;
+            std::vector<Sink> sinks(net->users.size());
+            for (size_t i = 0; i < net->users.size(); i++) {
+                auto &usr = net->users.at(i);
+                auto &sink = sinks.at(i);
+                int port_clocks;
+                sink.port_class = ctx->getPortTimingClass(usr.cell, usr.port, port_clocks);
+                if (sink.port_class == TMG_REGISTER_INPUT) {
+                    for (int j = 0; j < port_clocks; j++) {
+                        TimingClockingInfo clkInfo = ctx->getPortClockingInfo(usr.cell, usr.port, j);
+                        const NetInfo *clknet = get_net_or_empty(usr.cell, clkInfo.clock_port);
+                        IdString clksig = clknet ? clknet->name : async_clock;
+                        sink.captures.emplace_back(ClockEvent{clksig, clknet ? clkInfo.edge : RISING_EDGE},
+                                                   clkInfo.setup);
+                        sink.capture_exceptions.push_back(to_exceptions(ctx, usr.cell, usr.port, net, clknet));
+                    }
+                } else if (sink.port_class == TMG_ENDPOINT) {
+                    sink.captures.emplace_back(ClockEvent{async_clock, RISING_EDGE}, zero_delay);
+                    sink.capture_exceptions.push_back(to_exceptions(ctx, usr.cell, usr.port, net, nullptr));
+                }
+                // Record all output ports on the same cell as the sink that have an arc from it
+                for (auto &port : usr.cell->ports) {
+                    if (port.second.type != PORT_OUT || !port.second.net)
+                        continue;
+                    DelayInfo comb_delay;
+                    if (!ctx->getCellDelay(usr.cell, usr.port, port.first, comb_delay))
+                        continue;
+                    sink.arcs.emplace_back(get_node(port.second.net), comb_delay);
+                }
+            }
+            std::vector<Fanin> fanin;
+            const PortRef &drv = net->driver;
+            if (drv.cell != nullptr) {
+                for (auto &port : drv.cell->ports) {
+                    if (port.second.type != PORT_IN || !port.second.net)
+                        continue;
+                    DelayInfo comb_delay;
+                    if (!ctx->getCellDelay(drv.cell, port.first, drv.port, comb_delay))
+                        continue;
+                    Fanin fi;
+                    fi.from_node = get_node(port.second.net);
+                    fi.from_user = -1;
+                    for (size_t i = 0; i < port.second.net->users.size(); i++) {
+                        auto &user = port.second.net->users.at(i);
+                        if (user.cell == drv.cell && user.port == port.first) {
+                            fi.from_user = int(i);
+                            break;
+                        }
+                    }
+                    int port_clocks;
+                    fi.from_class = ctx->getPortTimingClass(drv.cell, port.first, port_clocks);
+                    fi.delay = comb_delay;
+                    fanin.push_back(fi);
+                }
+            }
+            // get_node may have reallocated nodes, so only take the reference now
+            auto &node = nodes.at(n);
+            node.sinks = std::move(sinks);
+            node.fanin = std::move(fanin);
+        }
+
+        build_levels();
+#ifndef NPNR_DISABLE_THREADS
+        int threads = ctx->stage_threads("timing", 1);
+        if (threads > 1)
+            pool.reset(new WorkerPool(threads));
+#endif
+    }
+
+    int64_t memory_usage() const
+    {
+        int64_t bytes = memory_of(nodes) + memory_of(order) + memory_of(level_order) + memory_of(level_start);
+        bytes += int64_t(node_index.size()) * (sizeof(std::pair<const NetInfo *, int>) + 3 * sizeof(void *));
+        for (auto &node : nodes) {
+            bytes += memory_of(node.sinks) + memory_of(node.fanin) + memory_of(node.launches);
+            for (auto &sink : node.sinks)
+                bytes += memory_of(sink.captures) + memory_of(sink.capture_exceptions) + memory_of(sink.arcs);
+        }
+        return bytes;
+    }
+
+    void build_levels()
+    {
+        // An entry of order must come after the entries that propagate to its node earlier in order, and after its
+        // node's previous entry. An entry that propagates to a node whose last entry is earlier in order must also
+        // come after that entry, so the late arrival is not propagated any further, as in a serial walk.
+        std::vector<int> level_in(nodes.size(), 0), last_level(nodes.size(), -1);
+        std::vector<int> entry_level;
+        entry_level.reserve(order.size());
+        int max_level = -1;
+        for (int n : order) {
+            int level = std::max(level_in.at(n), last_level.at(n) + 1);
+            for (auto &sink : nodes.at(n).sinks) {
+                if (sink.port_class == TMG_ENDPOINT || sink.port_class == TMG_IGNORE ||
+                    sink.port_class == TMG_CLOCK_INPUT)
+                    continue;
+                for (auto &arc : sink.arcs)
+                    level = std::max(level, last_level.at(arc.first) + 1);
+            }
+            last_level.at(n) = level;
+            for (auto &sink : nodes.at(n).sinks) {
+                if (sink.port_class == TMG_ENDPOINT || sink.port_class == TMG_IGNORE ||
+                    sink.port_class == TMG_CLOCK_INPUT)
+                    continue;
+                for (auto &arc : sink.arcs)
+                    level_in.at(arc.first) = std::max(level_in.at(arc.first), level + 1);
+            }
+            entry_level.push_back(level);
+            max_level = std::max(max_level, level);
+        }
+        // Counting sort of the entries by level
+        level_start.assign(max_level + 2, 0);
+        for (int level : entry_level)
+            ++level_start.at(level + 1);
+        for (int l = 0; l <= max_level; l++)
+            level_start.at(l + 1) += level_start.at(l);
+        std::vector<int> next(level_start.begin(), level_start.end() - 1);
+        level_order.resize(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+            level_order.at(next.at(entry_level.at(i))++) = order.at(i);
+    }
+};
+
+namespace {
+// Total over all the timing graphs that currently exist, as the placers and routers keep their own
+std::atomic<int64_t> timing_graph_bytes{0};
+} // namespace
+
+TimingGraph::TimingGraph(Context *ctx) : impl(new Impl)
+{
+    impl->build(ctx);
+    memory_track("timing_graph", timing_graph_bytes += impl->memory_usage());
+}
+
+TimingGraph::~TimingGraph() { memory_track("timing_graph", timing_graph_bytes -= impl->memory_usage()); }
+
+struct Timing
+{
+    typedef TimingGraph::Impl Graph;
+
+    Context *ctx;
+    bool net_delays;
+    bool update;
+    delay_t min_slack;
+    CriticalPathMap *crit_path;
+    DelayFrequency *slack_histogram;
+    NetCriticalityMap *net_crit;
+    IdString async_clock;
+    const TimingGraph *graph;
+    std::unique_ptr<TimingGraph> own_graph;
+    // Analyse the fast corner, using the minimum of every delay, rather than the slow corner
+    bool fast_corner = false;
+    // If set, the report_paths worst paths of each clock pair are traced and stored here
+    WorstPathMap *worst_paths = nullptr;
+    size_t report_paths = 0;
+
+    delay_t corner_delay(const DelayInfo &delay) const { return fast_corner ? delay.minDelay() : delay.maxDelay(); }
+
+    struct TimingData
+    {
+        TimingData() : max_arrival(), max_path_length(), min_remaining_budget() {}
+        TimingData(delay_t max_arrival) : max_arrival(max_arrival), max_path_length(), min_remaining_budget() {}
+        delay_t max_arrival;
+        unsigned max_path_length = 0;
+        delay_t min_remaining_budget;
+        bool false_startpoint = false;
+        // Path exceptions whose from objects include the start points of every path reaching here
+        uint64_t exceptions = ~uint64_t(0);
+        std::vector<delay_t> min_required;
+    };
+
+    Timing(Context *ctx, bool net_delays, bool update, CriticalPathMap *crit_path = nullptr,
+           DelayFrequency *slack_histogram = nullptr, NetCriticalityMap *net_crit = nullptr,
+           const TimingGraph *graph = nullptr)
+            : ctx(ctx), net_delays(net_delays), update(update), min_slack(1.0e12 / ctx->setting<float>("target_freq")),
+              crit_path(crit_path), slack_histogram(slack_histogram), net_crit(net_crit),
+              async_clock(ctx->id("$async$")), graph(graph)
+    {
+    }
+
+    // Period available for a path launched by start and captured by the given edge of clksig
+    delay_t clock_period(delay_t clk_period, const ClockEvent &start, IdString clksig, ClockEdge edge) const
+    {
+        delay_t period;
+        // Set default period
+        if (edge == start.edge) {
+            period = clk_period;
+        } else {
+            period = clk_period / 2;
+        }
+        if (clksig != async_clock) {
+            if (ctx->nets.at(clksig)->clkconstr) {
+                if (edge == start.edge) {
+                    // same edge
+                    period = ctx->nets.at(clksig)->clkconstr->period.minDelay();
+                } else if (edge == RISING_EDGE) {
+                    // falling -> rising
+                    period = ctx->nets.at(clksig)->clkconstr->low.minDelay();
+                } else if (edge == FALLING_EDGE) {
+                    // rising -> falling
+                    period = ctx->nets.at(clksig)->clkconstr->high.minDelay();
+                }
+            }
+        }
+        return period;
+    }
+
+    delay_t walk_paths()
+    {
+        const auto clk_period = ctx->getDelayFromNS(1.0e9 / ctx->setting<float>("target_freq")).maxDelay();
+
+        if (graph == nullptr) {
+            own_graph.reset(new TimingGraph(ctx));
+            graph = own_graph.get();
+        }
+        const Graph &g = *graph->impl;
+
+        // Find the period available to a path with timing data nd, captured by capture c of sink, after applying the
+        // path exceptions common to its launch and capture. Returns false for a false path.
+        auto path_period = [&](const ClockEvent &start, const TimingData &nd, const Graph::Sink &sink, size_t c,
+                               delay_t &period) {
+            const ClockEvent &dest_ev = sink.captures.at(c).first;
+            period = clock_period(clk_period, start, dest_ev.clock, dest_ev.edge);
+            uint64_t mask = nd.exceptions & sink.capture_exceptions.at(c);
+            if (mask == 0)
+                return true;
+            delay_t max_delay = std::numeric_limits<delay_t>::max();
+            int cycles = std::numeric_limits<int>::max();
+            for (size_t bit = 0; bit < g.exceptions.size(); bit++) {
+                if (!(mask & (uint64_t(1) << bit)))
+                    continue;
+                const TimingConstraint *constr = g.exceptions.at(bit);
+                if (constr->type == TimingConstraint::FALSE_PATH)
+                    return false;
+                else if (constr->type == TimingConstraint::MAX_DELAY)
+                    max_delay = std::min(max_delay, constr->value);
+                else if (constr->type == TimingConstraint::MULTICYCLE)
+                    cycles = std::min(cycles, int(constr->value));
+            }
+            // A maximum delay overrides the clocks; of several exceptions of one kind, the tightest applies
+            if (max_delay != std::numeric_limits<delay_t>::max())
+                period = max_delay;
+            else if (cycles != std::numeric_limits<int>::max())
+                period += (cycles - 1) * clock_period(clk_period, dest_ev, dest_ev.clock, dest_ev.edge);
+            return true;
+        };
+
+        std::vector<ClockEventMap<TimingData>> net_data(g.nodes.size());
+        for (size_t n = 0; n < g.nodes.size(); n++) {
+            for (auto &launch : g.nodes.at(n).launches) {
+                TimingData td(corner_delay(launch.arrival));
+                td.false_startpoint = launch.false_startpoint;
+                td.exceptions = launch.exceptions;
+                net_data.at(n)[launch.clock] = td;
+            }
+        }
+
+        // Routing delays of each node's users, computed the first time they are needed
+        std::vector<std::vector<delay_t>> route_delays(g.nodes.size());
+        auto get_route_delays = [&](int n) -> const std::vector<delay_t> & {
+            auto &delays = route_delays.at(n);
+            NetInfo *net = g.nodes.at(n).net;
+            NPNR_ASSERT(g.nodes.at(n).sinks.size() == net->users.size());
+            if (delays.empty() && !net->users.empty()) {
+                delays.reserve(net->users.size());
+                for (auto &usr : net->users)
+                    delays.push_back(fast_corner ? ctx->getNetinfoRouteDelayMin(net, usr)
+                                                 : ctx->getNetinfoRouteDelay(net, usr));
+            }
+            return delays;
+        };
+
+        // Go forwards topologically to find the maximum arrival time and max path length for each net. If locks is
+        // set, other threads may be propagating to the same nodes, so updates to other nodes are made holding the lock
+        // for that node
+        auto propagate_arrival = [&](int n, std::vector<std::mutex> *locks) {
+            auto &nd_map = net_data.at(n);
+            if (nd_map.empty())
+                return;
+            const auto &node = g.nodes.at(n);
+            NetInfo *net = node.net;
             for (auto &startdomain : nd_map) {
                 ClockEvent start_clk = startdomain.first;
                 auto &nd = startdomain.second;
@@ -295,28 +761,26 @@ struct Timing
                 const auto net_arrival = nd.max_arrival;
                 const auto net_length_plus_one = nd.max_path_length + 1;
                 nd.min_remaining_budget = clk_period;
-                for (auto &usr : net->users) {
-                    int port_clocks;
-                    TimingPortClass portClass = ctx->getPortTimingClass(usr.cell, usr.port, port_clocks);
-                    auto net_delay = net_delays ? ctx->getNetinfoRouteDelay(net, usr) : delay_t();
+                for (size_t i = 0; i < net->users.size(); i++) {
+                    auto &usr = net->users.at(i);
+                    const auto &sink = node.sinks.at(i);
+                    auto net_delay = net_delays ? get_route_delays(n).at(i) : delay_t();
                     auto usr_arrival = net_arrival + net_delay;
 
-                    if (portClass == TMG_ENDPOINT || portClass == TMG_IGNORE || portClass == TMG_CLOCK_INPUT) {
+                    if (sink.port_class == TMG_ENDPOINT || sink.port_class == TMG_IGNORE ||
+                        sink.port_class == TMG_CLOCK_INPUT) {
                         // Skip
                     } else {
                         auto budget_override = ctx->getBudgetOverride(net, usr, net_delay);
                         // Iterate over all output ports on the same cell as the sink
-                        for (auto port : usr.cell->ports) {
-                            if (port.second.type != PORT_OUT || !port.second.net)
-                                continue;
-                            DelayInfo comb_delay;
-                            // Look up delay through this path
-                            bool is_path = ctx->getCellDelay(usr.cell, usr.port, port.first, comb_delay);
-                            if (!is_path)
-                                continue;
-                            auto &data = net_data[port.second.net][start_clk];
+                        for (auto &arc : sink.arcs) {
+                            std::unique_lock<std::mutex> lk;
+                            if (locks)
+                                lk = std::unique_lock<std::mutex>(locks->at(arc.first % locks->size()));
+                            auto &data = net_data.at(arc.first)[start_clk];
                             auto &arrival = data.max_arrival;
-                            arrival = std::max(arrival, usr_arrival + comb_delay.maxDelay());
+                            arrival = std::max(arrival, usr_arrival + corner_delay(arc.second));
+                            data.exceptions &= nd.exceptions;
                             if (!budget_override) { // Do not increment path length if budget overridden since it
                                                     // doesn't
                                 // require a share of the slack
@@ -327,16 +791,54 @@ struct Timing
                     }
                 }
             }
+        };
+#ifndef NPNR_DISABLE_THREADS
+        if (g.pool) {
+            const int chunk_size = 64;
+            std::vector<std::mutex> locks(256);
+            std::vector<int> chunks;
+            for (size_t l = 0; l + 1 < g.level_start.size(); l++) {
+                int begin = g.level_start.at(l), end = g.level_start.at(l + 1);
+                if (end - begin <= chunk_size) {
+                    for (int i = begin; i < end; i++)
+                        propagate_arrival(g.level_order.at(i), nullptr);
+                    continue;
+                }
+                chunks.clear();
+                for (int i = begin; i < end; i += chunk_size)
+                    chunks.push_back(i);
+                g.pool->run(chunks, [&](int first) {
+                    for (int i = first; i < std::min(first + chunk_size, end); i++)
+                        propagate_arrival(g.level_order.at(i), &locks);
+                });
+            }
+        } else
+#endif
+        {
+            for (int n : g.order)
+                propagate_arrival(n, nullptr);
         }
 
-        std::unordered_map<ClockPair, std::pair<delay_t, NetInfo *>> crit_nets;
+        std::unordered_map<ClockPair, std::pair<delay_t, int>> crit_nets;
+        // A path endpoint, kept by arrival time; the path itself is only traced for the endpoints that are reported
+        struct Endpoint
+        {
+            delay_t arrival;
+            delay_t period;
+            int node;
+            const PortRef *port;
+        };
+        auto later_endpoint = [](const Endpoint &a, const Endpoint &b) { return a.arrival > b.arrival; };
+        std::unordered_map<ClockPair, std::vector<Endpoint>> worst_endpoints;
 
         // Now go backwards topologically to determine the minimum path slack, and to distribute all path slack evenly
         // between all nets on the path
-        for (auto net : boost::adaptors::reverse(topological_order)) {
-            if (!net_data.count(net))
+        for (int n : boost::adaptors::reverse(g.order)) {
+            auto &nd_map = net_data.at(n);
+            if (nd_map.empty())
                 continue;
-            auto &nd_map = net_data.at(net);
+            const auto &node = g.nodes.at(n);
+            NetInfo *net = node.net;
             for (auto &startdomain : nd_map) {
                 auto &nd = startdomain.second;
                 // Ignore false startpoints
@@ -344,36 +846,20 @@ struct Timing
                     continue;
                 const delay_t net_length_plus_one = nd.max_path_length + 1;
                 auto &net_min_remaining_budget = nd.min_remaining_budget;
-                for (auto &usr : net->users) {
-                    auto net_delay = net_delays ? ctx->getNetinfoRouteDelay(net, usr) : delay_t();
+                for (size_t i = 0; i < net->users.size(); i++) {
+                    auto &usr = net->users.at(i);
+                    const auto &sink = node.sinks.at(i);
+                    auto net_delay = net_delays ? get_route_delays(n).at(i) : delay_t();
                     auto budget_override = ctx->getBudgetOverride(net, usr, net_delay);
-                    int port_clocks;
-                    TimingPortClass portClass = ctx->getPortTimingClass(usr.cell, usr.port, port_clocks);
-                    if (portClass == TMG_REGISTER_INPUT || portClass == TMG_ENDPOINT) {
-                        auto process_endpoint = [&](IdString clksig, ClockEdge edge, delay_t setup) {
-                            const auto net_arrival = nd.max_arrival;
-                            const auto endpoint_arrival = net_arrival + net_delay + setup;
+                    if (sink.port_class == TMG_REGISTER_INPUT || sink.port_class == TMG_ENDPOINT) {
+                        for (size_t c = 0; c < sink.captures.size(); c++) {
+                            auto &capture = sink.captures.at(c);
+                            const ClockEvent &dest_ev = capture.first;
                             delay_t period;
-                            // Set default period
-                            if (edge == startdomain.first.edge) {
-                                period = clk_period;
-                            } else {
-                                period = clk_period / 2;
-                            }
-                            if (clksig != async_clock) {
-                                if (ctx->nets.at(clksig)->clkconstr) {
-                                    if (edge == startdomain.first.edge) {
-                                        // same edge
-                                        period = ctx->nets.at(clksig)->clkconstr->period.minDelay();
-                                    } else if (edge == RISING_EDGE) {
-                                        // falling -> rising
-                                        period = ctx->nets.at(clksig)->clkconstr->low.minDelay();
-                                    } else if (edge == FALLING_EDGE) {
-                                        // rising -> falling
-                                        period = ctx->nets.at(clksig)->clkconstr->high.minDelay();
-                                    }
-                                }
-                            }
+                            if (!path_period(startdomain.first, nd, sink, c, period))
+                                continue;
+                            const auto net_arrival = nd.max_arrival;
+                            const auto endpoint_arrival = net_arrival + net_delay + corner_delay(capture.second);
                             auto path_budget = period - endpoint_arrival;
 
                             if (update) {
@@ -390,45 +876,41 @@ struct Timing
                                 int slack_ps = ctx->getDelayNS(path_budget) * 1000;
                                 (*slack_histogram)[slack_ps]++;
                             }
-                            ClockEvent dest_ev{clksig, edge};
                             ClockPair clockPair{startdomain.first, dest_ev};
-                            nd.arrival_time[dest_ev] = std::max(nd.arrival_time[dest_ev], endpoint_arrival);
 
                             if (crit_path) {
                                 if (!crit_nets.count(clockPair) || crit_nets.at(clockPair).first < endpoint_arrival) {
-                                    crit_nets[clockPair] = std::make_pair(endpoint_arrival, net);
+                                    crit_nets[clockPair] = std::make_pair(endpoint_arrival, n);
                                     (*crit_path)[clockPair].path_delay = endpoint_arrival;
                                     (*crit_path)[clockPair].path_period = period;
                                     (*crit_path)[clockPair].ports.clear();
                                     (*crit_path)[clockPair].ports.push_back(&usr);
                                 }
                             }
-                        };
-                        if (portClass == TMG_REGISTER_INPUT) {
-                            for (int i = 0; i < port_clocks; i++) {
-                                TimingClockingInfo clkInfo = ctx->getPortClockingInfo(usr.cell, usr.port, i);
-                                const NetInfo *clknet = get_net_or_empty(usr.cell, clkInfo.clock_port);
-                                IdString clksig = clknet ? clknet->name : async_clock;
-                                process_endpoint(clksig, clknet ? clkInfo.edge : RISING_EDGE, clkInfo.setup.maxDelay());
+
+                            if (worst_paths && report_paths > 0) {
+                                // Keep only the latest arriving endpoints, in a min-heap so the earliest is evicted
+                                auto &heap = worst_endpoints[clockPair];
+                                Endpoint ep{endpoint_arrival, period, n, &usr};
+                                if (heap.size() < report_paths) {
+                                    heap.push_back(ep);
+                                    std::push_heap(heap.begin(), heap.end(), later_endpoint);
+                                } else if (heap.front().arrival < endpoint_arrival) {
+                                    std::pop_heap(heap.begin(), heap.end(), later_endpoint);
+                                    heap.back() = ep;
+                                    std::push_heap(heap.begin(), heap.end(), later_endpoint);
+                                }
                             }
-                        } else {
-                            process_endpoint(async_clock, RISING_EDGE, 0);
                         }
 
                     } else if (update) {
 
                         // Iterate over all output ports on the same cell as the sink
-                        for (const auto &port : usr.cell->ports) {
-                            if (port.second.type != PORT_OUT || !port.second.net)
-                                continue;
-                            DelayInfo comb_delay;
-                            bool is_path = ctx->getCellDelay(usr.cell, usr.port, port.first, comb_delay);
-                            if (!is_path)
-                                continue;
-                            if (net_data.count(port.second.net) &&
-                                net_data.at(port.second.net).count(startdomain.first)) {
-                                auto path_budget =
-                                        net_data.at(port.second.net).at(startdomain.first).min_remaining_budget;
+                        for (auto &arc : sink.arcs) {
+                            auto &out_map = net_data.at(arc.first);
+                            auto found = out_map.find(startdomain.first);
+                            if (found != out_map.end()) {
+                                auto path_budget = found->second.min_remaining_budget;
                                 auto budget_share = budget_override ? 0 : path_budget / net_length_plus_one;
                                 usr.budget = std::min(usr.budget, net_delay + budget_share);
                                 net_min_remaining_budget =
@@ -440,70 +922,73 @@ struct Timing
             }
         }
 
-        if (crit_path) {
-            // Walk backwards from the most critical net
-            for (auto crit_pair : crit_nets) {
-                NetInfo *crit_net = crit_pair.second.second;
-                auto &cp_ports = (*crit_path)[crit_pair.first].ports;
-                while (crit_net) {
-                    const PortInfo *crit_ipin = nullptr;
-                    delay_t max_arrival = std::numeric_limits<delay_t>::min();
-                    // Look at all input ports on its driving cell
-                    for (const auto &port : crit_net->driver.cell->ports) {
-                        if (port.second.type != PORT_IN || !port.second.net)
-                            continue;
-                        DelayInfo comb_delay;
-                        bool is_path =
-                                ctx->getCellDelay(crit_net->driver.cell, port.first, crit_net->driver.port, comb_delay);
-                        if (!is_path)
-                            continue;
-                        // If input port is influenced by a clock, skip
-                        int port_clocks;
-                        TimingPortClass portClass =
-                                ctx->getPortTimingClass(crit_net->driver.cell, port.first, port_clocks);
-                        if (portClass == TMG_CLOCK_INPUT || portClass == TMG_ENDPOINT || portClass == TMG_IGNORE)
-                            continue;
-                        // And find the fanin net with the latest arrival time
-                        if (net_data.count(port.second.net) &&
-                            net_data.at(port.second.net).count(crit_pair.first.start)) {
-                            auto net_arrival = net_data.at(port.second.net).at(crit_pair.first.start).max_arrival;
-                            if (net_delays) {
-                                for (auto &user : port.second.net->users)
-                                    if (user.port == port.first && user.cell == crit_net->driver.cell) {
-                                        net_arrival += ctx->getNetinfoRouteDelay(port.second.net, user);
-                                        break;
-                                    }
-                            }
-                            net_arrival += comb_delay.maxDelay();
-                            if (net_arrival > max_arrival) {
-                                max_arrival = net_arrival;
-                                crit_ipin = &port.second;
-                            }
+        // Walk backwards from a net, following the fanin with the latest arrival, appending the ports passed through
+        // to the path and then putting it in path order
+        auto trace_back = [&](int crit_node, const ClockEvent &start, PortRefVector &cp_ports) {
+            while (true) {
+                const Graph::Fanin *crit_fanin = nullptr;
+                delay_t max_arrival = std::numeric_limits<delay_t>::min();
+                // Look at all input ports on its driving cell
+                for (auto &fi : g.nodes.at(crit_node).fanin) {
+                    // If input port is influenced by a clock, skip
+                    if (fi.from_class == TMG_CLOCK_INPUT || fi.from_class == TMG_ENDPOINT ||
+                        fi.from_class == TMG_IGNORE)
+                        continue;
+                    // And find the fanin net with the latest arrival time
+                    auto &in_map = net_data.at(fi.from_node);
+                    auto found = in_map.find(start);
+                    if (found != in_map.end()) {
+                        auto net_arrival = found->second.max_arrival;
+                        if (net_delays && fi.from_user != -1)
+                            net_arrival += get_route_delays(fi.from_node).at(fi.from_user);
+                        net_arrival += corner_delay(fi.delay);
+                        if (net_arrival > max_arrival) {
+                            max_arrival = net_arrival;
+                            crit_fanin = &fi;
                         }
                     }
+                }
 
-                    if (!crit_ipin)
-                        break;
-                    // Now convert PortInfo* into a PortRef*
-                    for (auto &usr : crit_ipin->net->users) {
-                        if (usr.cell->name == crit_net->driver.cell->name && usr.port == crit_ipin->name) {
-                            cp_ports.push_back(&usr);
-                            break;
-                        }
-                    }
-                    crit_net = crit_ipin->net;
+                if (!crit_fanin)
+                    break;
+                if (crit_fanin->from_user != -1)
+                    cp_ports.push_back(&g.nodes.at(crit_fanin->from_node).net->users.at(crit_fanin->from_user));
+                crit_node = crit_fanin->from_node;
+            }
+            std::reverse(cp_ports.begin(), cp_ports.end());
+        };
+
+        if (crit_path) {
+            // Walk backwards from the most critical net
+            for (auto crit_pair : crit_nets)
+                trace_back(crit_pair.second.second, crit_pair.first.start, (*crit_path)[crit_pair.first].ports);
+        }
+
+        if (worst_paths) {
+            for (auto &endpoints : worst_endpoints) {
+                auto &heap = endpoints.second;
+                std::sort_heap(heap.begin(), heap.end(), later_endpoint);
+                auto &paths = (*worst_paths)[endpoints.first];
+                for (auto &ep : heap) {
+                    paths.emplace_back();
+                    auto &path = paths.back();
+                    path.path_delay = ep.arrival;
+                    path.path_period = ep.period;
+                    path.ports.push_back(ep.port);
+                    trace_back(ep.node, endpoints.first.start, path.ports);
                 }
-                std::reverse(cp_ports.begin(), cp_ports.end());
             }
         }
 
         if (net_crit) {
             NPNR_ASSERT(crit_path);
             // Go through in reverse topological order to set required times
-            for (auto net : boost::adaptors::reverse(topological_order)) {
-                if (!net_data.count(net))
+            for (int n : boost::adaptors::reverse(g.order)) {
+                auto &nd_map = net_data.at(n);
+                if (nd_map.empty())
                     continue;
-                auto &nd_map = net_data.at(net);
+                const auto &node = g.nodes.at(n);
+                NetInfo *net = node.net;
                 for (auto &startdomain : nd_map) {
                     auto &nd = startdomain.second;
                     if (nd.false_startpoint)
@@ -514,76 +999,31 @@ struct Timing
                         nd.min_required.resize(net->users.size(), std::numeric_limits<delay_t>::max());
                     delay_t net_min_required = std::numeric_limits<delay_t>::max();
                     for (size_t i = 0; i < net->users.size(); i++) {
-                        auto &usr = net->users.at(i);
-                        auto net_delay = ctx->getNetinfoRouteDelay(net, usr);
-                        int port_clocks;
-                        TimingPortClass portClass = ctx->getPortTimingClass(usr.cell, usr.port, port_clocks);
-                        if (portClass == TMG_REGISTER_INPUT || portClass == TMG_ENDPOINT) {
-                            auto process_endpoint = [&](IdString clksig, ClockEdge edge, delay_t setup) {
-                                delay_t period;
-                                // Set default period
-                                if (edge == startdomain.first.edge) {
-                                    period = clk_period;
-                                } else {
-                                    period = clk_period / 2;
-                                }
-                                if (clksig != async_clock) {
-                                    if (ctx->nets.at(clksig)->clkconstr) {
-                                        if (edge == startdomain.first.edge) {
-                                            // same edge
-                                            period = ctx->nets.at(clksig)->clkconstr->period.minDelay();
-                                        } else if (edge == RISING_EDGE) {
-                                            // falling -> rising
-                                            period = ctx->nets.at(clksig)->clkconstr->low.minDelay();
-                                        } else if (edge == FALLING_EDGE) {
-                                            // rising -> falling
-                                            period = ctx->nets.at(clksig)->clkconstr->high.minDelay();
-                                        }
-                                    }
-                                }
-                                nd.min_required.at(i) = std::min(period - setup, nd.min_required.at(i));
-                            };
-                            if (portClass == TMG_REGISTER_INPUT) {
-                                for (int j = 0; j < port_clocks; j++) {
-                                    TimingClockingInfo clkInfo = ctx->getPortClockingInfo(usr.cell, usr.port, j);
-                                    const NetInfo *clknet = get_net_or_empty(usr.cell, clkInfo.clock_port);
-                                    IdString clksig = clknet ? clknet->name : async_clock;
-                                    process_endpoint(clksig, clknet ? clkInfo.edge : RISING_EDGE,
-                                                     clkInfo.setup.maxDelay());
-                                }
-                            } else {
-                                process_endpoint(async_clock, RISING_EDGE, 0);
-                            }
+                        auto net_delay = get_route_delays(n).at(i);
+                        const auto &sink = node.sinks.at(i);
+                        for (size_t c = 0; c < sink.captures.size(); c++) {
+                            delay_t period;
+                            if (!path_period(startdomain.first, nd, sink, c, period))
+                                continue;
+                            delay_t required = period - corner_delay(sink.captures.at(c).second);
+                            nd.min_required.at(i) = std::min(required, nd.min_required.at(i));
                         }
                         net_min_required = std::min(net_min_required, nd.min_required.at(i) - net_delay);
                     }
-                    PortRef &drv = net->driver;
-                    if (drv.cell == nullptr)
-                        continue;
-                    for (const auto &port : drv.cell->ports) {
-                        if (port.second.type != PORT_IN || !port.second.net)
+                    for (auto &fi : node.fanin) {
+                        if (fi.from_class != TMG_COMB_INPUT)
                             continue;
-                        DelayInfo comb_delay;
-                        bool is_path = ctx->getCellDelay(drv.cell, port.first, drv.port, comb_delay);
-                        if (!is_path)
-                            continue;
-                        int cc;
-                        auto pclass = ctx->getPortTimingClass(drv.cell, port.first, cc);
-                        if (pclass != TMG_COMB_INPUT)
-                            continue;
-                        NetInfo *sink_net = port.second.net;
-                        if (net_data.count(sink_net) && net_data.at(sink_net).count(startdomain.first)) {
-                            auto &sink_nd = net_data.at(sink_net).at(startdomain.first);
+                        auto &sink_map = net_data.at(fi.from_node);
+                        auto found = sink_map.find(startdomain.first);
+                        if (found != sink_map.end()) {
+                            auto &sink_nd = found->second;
                             if (sink_nd.min_required.empty())
-                                sink_nd.min_required.resize(sink_net->users.size(),
+                                sink_nd.min_required.resize(g.nodes.at(fi.from_node).net->users.size(),
                                                             std::numeric_limits<delay_t>::max());
-                            for (size_t i = 0; i < sink_net->users.size(); i++) {
-                                auto &user = sink_net->users.at(i);
-                                if (user.cell == drv.cell && user.port == port.first) {
-                                    sink_nd.min_required.at(i) = std::min(sink_nd.min_required.at(i),
-                                                                          net_min_required - comb_delay.maxDelay());
-                                    break;
-                                }
+                            if (fi.from_user != -1) {
+                                delay_t required = net_min_required - corner_delay(fi.delay);
+                                sink_nd.min_required.at(fi.from_user) =
+                                        std::min(sink_nd.min_required.at(fi.from_user), required);
                             }
                         }
                     }
@@ -592,9 +1032,9 @@ struct Timing
             std::unordered_map<ClockEvent, delay_t> worst_slack;
 
             // Assign slack values
-            for (auto &net_entry : net_data) {
-                const NetInfo *net = net_entry.first;
-                for (auto &startdomain : net_entry.second) {
+            for (size_t n = 0; n < net_data.size(); n++) {
+                const NetInfo *net = g.nodes.at(n).net;
+                for (auto &startdomain : net_data.at(n)) {
                     auto &nd = startdomain.second;
                     if (startdomain.first.clock == async_clock)
                         continue;
@@ -605,8 +1045,7 @@ struct Timing
                         nc.slack.resize(net->users.size(), std::numeric_limits<delay_t>::max());
 
                     for (size_t i = 0; i < net->users.size(); i++) {
-                        delay_t slack = nd.min_required.at(i) -
-                                        (nd.max_arrival + ctx->getNetinfoRouteDelay(net, net->users.at(i)));
+                        delay_t slack = nd.min_required.at(i) - (nd.max_arrival + get_route_delays(n).at(i));
 
                         if (worst_slack.count(startdomain.first))
                             worst_slack.at(startdomain.first) = std::min(worst_slack.at(startdomain.first), slack);
@@ -619,9 +1058,9 @@ struct Timing
                 }
             }
             // Assign criticality values
-            for (auto &net_entry : net_data) {
-                const NetInfo *net = net_entry.first;
-                for (auto &startdomain : net_entry.second) {
+            for (size_t n = 0; n < net_data.size(); n++) {
+                const NetInfo *net = g.nodes.at(n).net;
+                for (auto &startdomain : net_data.at(n)) {
                     if (startdomain.first.clock == async_clock)
                         continue;
                     auto &nd = startdomain.second;
@@ -649,6 +1088,8 @@ struct Timing
         return min_slack;
     }
 
+    // A single forward pass for arrival times and path lengths and a single backward pass sharing each path's slack
+    // equally between its arcs, over the graph's cached topological order
     void assign_budget()
     {
         // Clear delays to a very high value first
@@ -662,7 +1103,7 @@ struct Timing
     }
 };
 
-void assign_budget(Context *ctx, bool quiet)
+void assign_budget(Context *ctx, bool quiet, const TimingGraph *graph)
 {
     if (!quiet) {
         log_break();
@@ -670,7 +1111,8 @@ void assign_budget(Context *ctx, bool quiet)
                  ctx->setting<float>("target_freq") / 1e6);
     }
 
-    Timing timing(ctx, ctx->setting<int>("slack_redist_iter") > 0 /* net_delays */, true /* update */);
+    Timing timing(ctx, ctx->setting<int>("slack_redist_iter") > 0 /* net_delays */, true /* update */, nullptr, nullptr,
+                  nullptr, graph);
     timing.assign_budget();
 
     if (!quiet || ctx->verbose) {
@@ -707,8 +1149,68 @@ void assign_budget(Context *ctx, bool quiet)
         log_info("Checksum: 0x%08x\n", ctx->checksum());
 }
 
+void assign_placed_budget(Context *ctx, const TimingGraph *graph)
+{
+    Timing timing(ctx, true /* net_delays */, true /* update */, nullptr, nullptr, nullptr, graph);
+    timing.assign_budget();
+}
+
+static void print_slack_histogram(const DelayFrequency &slack_histogram, const char *title)
+{
+    unsigned num_bins = 20;
+    unsigned bar_width = 60;
+    std::vector<unsigned> bins_count(num_bins);
+    std::vector<unsigned> bins_bounds(num_bins + 1);
+    unsigned max_freq = 0;
+    auto min_slack = slack_histogram.begin()->first;
+    auto max_slack = slack_histogram.rbegin()->first;
+
+    if ((min_slack < 0) && (max_slack > 0)) {
+        /* Double sided histogram */
+        /* [0...bin_ofs-1]        = neg */
+        /* [bin_ofs...num_bins-1] = pos */
+        auto bin_ofs = std::max<unsigned>(
+                num_bins / 4, std::min<unsigned>(num_bins - (num_bins / 4) - 1,
+                                                 ceil(float(num_bins) * -min_slack / (max_slack - min_slack))));
+        auto bin_size_neg = std::max<unsigned>(1, ceil((-min_slack + 1) / float(bin_ofs)));
+        auto bin_size_pos = std::max<unsigned>(1, ceil((max_slack + 1) / float(num_bins - bin_ofs)));
+        for (unsigned i = 0; i < bin_ofs; i++)
+            bins_bounds[i] = (i - bin_ofs) * bin_size_neg;
+        for (unsigned i = bin_ofs; i <= num_bins; i++)
+            bins_bounds[i] = (i - bin_ofs) * bin_size_pos;
+        for (const auto &i : slack_histogram) {
+            int idx = (i.first < 0) ? (int)bin_ofs + (i.first / (int)bin_size_neg) - 1
+                                    : (int)bin_ofs + (i.first / (int)bin_size_pos);
+            auto &bin = bins_count[idx];
+            bin += i.second;
+            max_freq = std::max(max_freq, bin);
+        }
+    } else {
+        /* Single sided histogram */
+        auto bin_size = std::max<unsigned>(1, ceil((max_slack - min_slack + 1) / float(num_bins)));
+        for (unsigned i = 0; i <= num_bins; i++)
+            bins_bounds[i] = min_slack + bin_size * i;
+        for (const auto &i : slack_histogram) {
+            auto &bin = bins_count[(i.first - min_slack) / bin_size];
+            bin += i.second;
+            max_freq = std::max(max_freq, bin);
+        }
+    }
+    bar_width = std::min(bar_width, max_freq);
+
+    log_break();
+    log_info("%s:\n", title);
+    log_info(" legend: * represents %d endpoint(s)\n", max_freq / bar_width);
+    log_info("         + represents [1,%d) endpoint(s)\n", max_freq / bar_width);
+    for (unsigned i = 0; i < num_bins; ++i)
+        log_info("[%6d, %6d) | %6d | %s%c\n", bins_bounds[i], bins_bounds[i + 1], bins_count[i],
+                 std::string(bins_count[i] * bar_width / max_freq, '*').c_str(),
+                 (bins_count[i] * bar_width) % max_freq > 0 ? '+' : ' ');
+}
+
 void timing_analysis(Context *ctx, bool print_histogram, bool print_fmax, bool print_path, bool warn_on_failure)
 {
+    NPNR_PROFILE_ZONE("timing analysis");
     auto format_event = [ctx](const ClockEvent &e, int field_width = 0) {
         std::string value;
         if (e.clock == ctx->id("$async$"))
@@ -722,10 +1224,30 @@ void timing_analysis(Context *ctx, bool print_histogram, bool print_fmax, bool p
 
     CriticalPathMap crit_paths;
     DelayFrequency slack_histogram;
+    WorstPathMap worst_paths;
+    int report_paths = print_path ? ctx->setting<int>("timing/reportPaths", 0) : 0;
 
+    TimingGraph graph(ctx);
     Timing timing(ctx, true /* net_delays */, false /* update */, (print_path || print_fmax) ? &crit_paths : nullptr,
-                  print_histogram ? &slack_histogram : nullptr);
+                  print_histogram ? &slack_histogram : nullptr, nullptr, &graph);
+    if (report_paths > 0) {
+        timing.worst_paths = &worst_paths;
+        timing.report_paths = report_paths;
+    }
     timing.walk_paths();
+    std::vector<ClockPair> report_pairs;
+    for (auto &paths : worst_paths)
+        report_pairs.push_back(paths.first);
+    std::sort(report_pairs.begin(), report_pairs.end(), [&](const ClockPair &a, const ClockPair &b) {
+        return std::make_pair(format_event(a.start), format_event(a.end)) <
+               std::make_pair(format_event(b.start), format_event(b.end));
+    });
+    auto clock_target = [ctx](IdString clock) {
+        float target = ctx->setting<float>("target_freq") / 1e6;
+        if (ctx->nets.at(clock)->clkconstr)
+            target = 1000 / ctx->getDelayNS(ctx->nets.at(clock)->clkconstr->period.minDelay());
+        return target;
+    };
     std::map<IdString, std::pair<ClockPair, CriticalPath>> clock_reports;
     std::map<IdString, double> clock_fmax;
     std::vector<ClockPair> xclock_paths;
@@ -928,6 +1450,20 @@ void timing_analysis(Context *ctx, bool print_histogram, bool print_fmax, bool p
             auto &crit_path = crit_paths.at(xclock).ports;
             print_path_report(xclock, crit_path);
         }
+
+        for (auto &clocks : report_pairs) {
+            auto &paths = worst_paths.at(clocks);
+            std::string start = format_event(clocks.start);
+            std::string end = format_event(clocks.end);
+            log_break();
+            log_info("%d worst paths for '%s' -> '%s':\n", int(paths.size()), start.c_str(), end.c_str());
+            for (size_t i = 0; i < paths.size(); i++) {
+                log_break();
+                log_info("Path %d: %.02f ns (slack %.02f ns)\n", int(i + 1), ctx->getDelayNS(paths[i].path_delay),
+                         ctx->getDelayNS(paths[i].path_period - paths[i].path_delay));
+                print_path_report(clocks, paths[i].ports);
+            }
+        }
     }
     if (print_fmax) {
         log_break();
@@ -937,9 +1473,7 @@ void timing_analysis(Context *ctx, bool print_histogram, bool print_fmax, bool p
         for (auto &clock : clock_reports) {
             const auto &clock_name = clock.first.str(ctx);
             const int width = max_width - clock_name.size();
-            float target = ctx->setting<float>("target_freq") / 1e6;
-            if (ctx->nets.at(clock.first)->clkconstr)
-                target = 1000 / ctx->getDelayNS(ctx->nets.at(clock.first)->clkconstr->period.minDelay());
+            float target = clock_target(clock.first);
 
             bool passed = target < clock_fmax[clock.first];
             if (!warn_on_failure || passed)
@@ -974,65 +1508,542 @@ void timing_analysis(Context *ctx, bool print_histogram, bool print_fmax, bool p
         log_break();
     }
 
-    if (print_histogram && slack_histogram.size() > 0) {
-        unsigned num_bins = 20;
-        unsigned bar_width = 60;
-        std::vector<unsigned> bins_count(num_bins);
-        std::vector<unsigned> bins_bounds(num_bins + 1);
-        unsigned max_freq = 0;
-        auto min_slack = slack_histogram.begin()->first;
-        auto max_slack = slack_histogram.rbegin()->first;
-
-        if ((min_slack < 0) && (max_slack > 0)) {
-            /* Double sided histogram */
-            /* [0...bin_ofs-1]        = neg */
-            /* [bin_ofs...num_bins-1] = pos */
-            auto bin_ofs = std::max<unsigned>(
-                    num_bins / 4, std::min<unsigned>(num_bins - (num_bins / 4) - 1,
-                                                     ceil(float(num_bins) * -min_slack / (max_slack - min_slack))));
-            auto bin_size_neg = std::max<unsigned>(1, ceil((-min_slack + 1) / float(bin_ofs)));
-            auto bin_size_pos = std::max<unsigned>(1, ceil((max_slack + 1) / float(num_bins - bin_ofs)));
-            for (unsigned i = 0; i < bin_ofs; i++)
-                bins_bounds[i] = (i - bin_ofs) * bin_size_neg;
-            for (unsigned i = bin_ofs; i <= num_bins; i++)
-                bins_bounds[i] = (i - bin_ofs) * bin_size_pos;
-            for (const auto &i : slack_histogram) {
-                int idx = (i.first < 0) ? (int)bin_ofs + (i.first / (int)bin_size_neg) - 1
-                                        : (int)bin_ofs + (i.first / (int)bin_size_pos);
-                auto &bin = bins_count[idx];
-                bin += i.second;
-                max_freq = std::max(max_freq, bin);
-            }
-        } else {
-            /* Single sided histogram */
-            auto bin_size = std::max<unsigned>(1, ceil((max_slack - min_slack + 1) / float(num_bins)));
-            for (unsigned i = 0; i <= num_bins; i++)
-                bins_bounds[i] = min_slack + bin_size * i;
-            for (const auto &i : slack_histogram) {
-                auto &bin = bins_count[(i.first - min_slack) / bin_size];
-                bin += i.second;
-                max_freq = std::max(max_freq, bin);
+    if (print_histogram && slack_histogram.size() > 0)
+        print_slack_histogram(slack_histogram, "Slack histogram");
+
+    // Keep the results for the machine-readable report
+    auto &result = ctx->timing_result;
+    result = TimingResult();
+    result.valid = true;
+    auto to_result_path = [&](const ClockPair &clocks, const CriticalPath &path) {
+        TimingResult::Path rp;
+        rp.start = format_event(clocks.start);
+        rp.end = format_event(clocks.end);
+        rp.delay = path.path_delay;
+        rp.period = path.path_period;
+        for (auto sink : path.ports) {
+            NetInfo *net = sink->cell->ports.at(sink->port).net;
+            rp.ports.push_back(TimingResult::PathPort{net ? net->name : IdString(), sink->cell->name, sink->port});
+        }
+        return rp;
+    };
+    for (auto &clock : clock_reports) {
+        result.clock_fmax[clock.first] = std::make_pair(clock_fmax.at(clock.first), clock_target(clock.first));
+        result.crit_paths.push_back(to_result_path(clock.second.first, clock.second.second));
+    }
+    for (auto &xclock : xclock_paths)
+        result.crit_paths.push_back(to_result_path(xclock, crit_paths.at(xclock)));
+    for (auto &clocks : report_pairs)
+        for (auto &path : worst_paths.at(clocks))
+            result.worst_paths.push_back(to_result_path(clocks, path));
+    result.slack_histogram = slack_histogram;
+
+    // The fast corner, with the minimum of every delay, is only reported as a summary, reusing the same timing graph
+    if ((print_fmax || print_histogram) && bool_or_default(ctx->settings, ctx->id("timing/fastCorner"), false)) {
+        CriticalPathMap fast_paths;
+        DelayFrequency fast_histogram;
+        Timing fast_timing(ctx, true /* net_delays */, false /* update */, print_fmax ? &fast_paths : nullptr,
+                           print_histogram ? &fast_histogram : nullptr, nullptr, &graph);
+        fast_timing.fast_corner = true;
+        fast_timing.walk_paths();
+        if (print_fmax) {
+            std::map<IdString, double> fast_fmax;
+            for (auto &path : fast_paths) {
+                const ClockEvent &a = path.first.start;
+                const ClockEvent &b = path.first.end;
+                if (a.clock != b.clock || a.clock == ctx->id("$async$"))
+                    continue;
+                double Fmax = (a.edge == b.edge ? 1000 : 500) / ctx->getDelayNS(path.second.path_delay);
+                if (!fast_fmax.count(a.clock) || Fmax < fast_fmax.at(a.clock))
+                    fast_fmax[a.clock] = Fmax;
             }
+            log_break();
+            for (auto &clock : fast_fmax)
+                log_info("Fast corner max frequency for clock '%s': %.02f MHz\n", clock.first.c_str(ctx), clock.second);
         }
-        bar_width = std::min(bar_width, max_freq);
-
-        log_break();
-        log_info("Slack histogram:\n");
-        log_info(" legend: * represents %d endpoint(s)\n", max_freq / bar_width);
-        log_info("         + represents [1,%d) endpoint(s)\n", max_freq / bar_width);
-        for (unsigned i = 0; i < num_bins; ++i)
-            log_info("[%6d, %6d) | %6d | %s%c\n", bins_bounds[i], bins_bounds[i + 1], bins_count[i],
-                     std::string(bins_count[i] * bar_width / max_freq, '*').c_str(),
-                     (bins_count[i] * bar_width) % max_freq > 0 ? '+' : ' ');
+        if (print_histogram && fast_histogram.size() > 0)
+            print_slack_histogram(fast_histogram, "Fast corner slack histogram");
     }
 }
 
-void get_criticalities(Context *ctx, NetCriticalityMap *net_crit)
+void get_criticalities(Context *ctx, NetCriticalityMap *net_crit, const TimingGraph *graph)
 {
     CriticalPathMap crit_paths;
     net_crit->clear();
-    Timing timing(ctx, true, true, &crit_paths, nullptr, net_crit);
+    Timing timing(ctx, true, true, &crit_paths, nullptr, net_crit, graph);
     timing.walk_paths();
 }
 
+IncrementalCriticality::IncrementalCriticality(Context *ctx) : ctx(ctx), delay_cache(ctx) { build(); }
+
+void IncrementalCriticality::build()
+{
+    const IdString async_clock = ctx->id("$async$");
+    const auto clk_period = ctx->getDelayFromNS(1.0e9 / ctx->setting<float>("target_freq")).maxDelay();
+    const bool ooc = bool_or_default(ctx->settings, ctx->id("arch.ooc"));
+
+    std::unordered_map<ClockEvent, int> event_index;
+    auto get_event = [&](IdString clock, ClockEdge edge) {
+        ClockEvent ev{clock, edge};
+        auto found = event_index.find(ev);
+        if (found != event_index.end())
+            return found->second;
+        int index = int(events.size());
+        event_index[ev] = index;
+        events.emplace_back(clock, edge);
+        return index;
+    };
+
+    // Find the start points and count the fanin of every other output, as walk_paths does
+    std::vector<NetInfo *> order;
+    std::unordered_set<const NetInfo *> start_nets;
+    std::unordered_map<const NetInfo *, std::vector<std::pair<int, delay_t>>> launch_times;
+    std::unordered_map<const PortInfo *, unsigned> port_fanin;
+    std::unordered_set<IdString> ooc_port_nets;
+    if (ooc) {
+        for (auto &p : ctx->ports) {
+            if (p.second.type != PORT_IN || p.second.net == nullptr)
+                continue;
+            ooc_port_nets.insert(p.second.net->name);
+        }
+    }
+    for (auto cell : sorted(ctx->cells)) {
+        CellInfo *ci = cell.second;
+        for (auto &o : ci->ports) {
+            if (o.second.type != PORT_OUT || o.second.net == nullptr)
+                continue;
+            NetInfo *net = o.second.net;
+            int clocks = 0;
+            TimingPortClass portClass = ctx->getPortTimingClass(ci, o.first, clocks);
+            if (portClass == TMG_REGISTER_OUTPUT) {
+                order.push_back(net);
+                start_nets.insert(net);
+                for (int i = 0; i < clocks; i++) {
+                    TimingClockingInfo clkInfo = ctx->getPortClockingInfo(ci, o.first, i);
+                    const NetInfo *clknet = get_net_or_empty(ci, clkInfo.clock_port);
+                    // Asynchronous paths are never used for criticality
+                    if (clknet == nullptr)
+                        continue;
+                    launch_times[net].emplace_back(get_event(clknet->name, clkInfo.edge),
+                                                   clkInfo.clockToQ.maxDelay());
+                }
+                continue;
+            }
+            if (portClass == TMG_STARTPOINT || portClass == TMG_GEN_CLOCK || portClass == TMG_IGNORE) {
+                order.push_back(net);
+                start_nets.insert(net);
+            }
+            if (portClass == TMG_CLOCK_INPUT)
+                continue;
+            for (auto &i : ci->ports) {
+                if (i.second.type == PORT_OUT || i.second.net == nullptr)
+                    continue;
+                if (i.second.net->driver.cell == nullptr && !ooc_port_nets.count(i.second.net->name))
+                    continue;
+                DelayInfo comb_delay;
+                if (ctx->getCellDelay(ci, i.first, o.first, comb_delay))
+                    port_fanin[&o.second]++;
+            }
+            if (!port_fanin.count(&o.second) && !start_nets.count(net)) {
+                order.push_back(net);
+                start_nets.insert(net);
+            }
+        }
+    }
+    if (ooc) {
+        for (auto &p : ctx->ports) {
+            if (p.second.type != PORT_IN || p.second.net == nullptr)
+                continue;
+            order.push_back(p.second.net);
+        }
+    }
+    domain_count = int(events.size());
+
+    // Walk the design from the start points to get the topological order. Nets left out because of combinational
+    // loops are reported by the full timing analysis, and are simply not analysed here
+    auto is_comb_output = [&](CellInfo *cell, IdString port) {
+        int port_clocks;
+        TimingPortClass portClass = ctx->getPortTimingClass(cell, port, port_clocks);
+        return portClass != TMG_REGISTER_OUTPUT && portClass != TMG_STARTPOINT && portClass != TMG_IGNORE &&
+               portClass != TMG_GEN_CLOCK;
+    };
+    std::deque<NetInfo *> queue(order.begin(), order.end());
+    while (!queue.empty()) {
+        NetInfo *net = queue.front();
+        queue.pop_front();
+        for (auto &usr : net->users) {
+            int user_clocks;
+            TimingPortClass usrClass = ctx->getPortTimingClass(usr.cell, usr.port, user_clocks);
+            if (usrClass == TMG_IGNORE || usrClass == TMG_CLOCK_INPUT)
+                continue;
+            for (auto &port : usr.cell->ports) {
+                if (port.second.type != PORT_OUT || port.second.net == nullptr)
+                    continue;
+                if (!is_comb_output(usr.cell, port.first))
+                    continue;
+                DelayInfo comb_delay;
+                if (!ctx->getCellDelay(usr.cell, usr.port, port.first, comb_delay))
+                    continue;
+                auto it = port_fanin.find(&port.second);
+                if (it == port_fanin.end())
+                    continue;
+                if (--it->second == 0) {
+                    order.push_back(port.second.net);
+                    queue.push_back(port.second.net);
+                    port_fanin.erase(it);
+                }
+            }
+        }
+    }
+
+    for (auto net : order) {
+        if (net_index.count(net))
+            continue;
+        net_index[net] = int(nets.size());
+        nets.emplace_back();
+        nets.back().net = net;
+    }
+
+    // Build the arcs and endpoints of every net
+    for (int n = 0; n < int(nets.size()); n++) {
+        TimingNet &tn = nets.at(n);
+        NetInfo *net = tn.net;
+        tn.delay.resize(net->users.size(), 0);
+        tn.fanout.resize(net->users.size());
+        tn.endpoints.resize(net->users.size());
+        for (size_t u = 0; u < net->users.size(); u++) {
+            auto &usr = net->users.at(u);
+            tn.arc_class.push_back(delay_cache.arc_class(net, usr));
+            int port_clocks;
+            TimingPortClass usrClass = ctx->getPortTimingClass(usr.cell, usr.port, port_clocks);
+            if (usrClass == TMG_REGISTER_INPUT) {
+                for (int i = 0; i < port_clocks; i++) {
+                    TimingClockingInfo clkInfo = ctx->getPortClockingInfo(usr.cell, usr.port, i);
+                    const NetInfo *clknet = get_net_or_empty(usr.cell, clkInfo.clock_port);
+                    IdString clksig = clknet ? clknet->name : async_clock;
+                    tn.endpoints.at(u).emplace_back(get_event(clksig, clknet ? clkInfo.edge : RISING_EDGE),
+                                                    clkInfo.setup.maxDelay());
+                }
+            } else if (usrClass == TMG_ENDPOINT) {
+                tn.endpoints.at(u).emplace_back(get_event(async_clock, RISING_EDGE), 0);
+            } else if (usrClass == TMG_COMB_INPUT) {
+                for (auto &port : usr.cell->ports) {
+                    if (port.second.type != PORT_OUT || port.second.net == nullptr)
+                        continue;
+                    auto to = net_index.find(port.second.net);
+                    if (to == net_index.end() || to->second <= n || !is_comb_output(usr.cell, port.first))
+                        continue;
+                    DelayInfo comb_delay;
+                    if (!ctx->getCellDelay(usr.cell, usr.port, port.first, comb_delay))
+                        continue;
+                    tn.fanout.at(u).push_back(int(arcs.size()));
+                    nets.at(to->second).fanin.push_back(int(arcs.size()));
+                    arcs.push_back(CellArc{n, int(u), to->second, comb_delay.maxDelay()});
+                }
+            }
+        }
+        tn.start_arrival.resize(domain_count, std::numeric_limits<delay_t>::lowest());
+        if (launch_times.count(net))
+            for (auto &launch : launch_times.at(net))
+                tn.start_arrival.at(launch.first) = std::max(tn.start_arrival.at(launch.first), launch.second);
+        tn.arrival = tn.start_arrival;
+        tn.net_required.resize(domain_count, std::numeric_limits<delay_t>::max());
+        tn.required.resize(net->users.size() * domain_count, std::numeric_limits<delay_t>::max());
+    }
+
+    // The time available between each launching clock domain and each capturing clock event
+    period.resize(domain_count);
+    for (int d = 0; d < domain_count; d++) {
+        for (auto &ev : events) {
+            delay_t p = (ev.second == events.at(d).second) ? clk_period : clk_period / 2;
+            if (ev.first != async_clock && ctx->nets.at(ev.first)->clkconstr) {
+                auto &constr = ctx->nets.at(ev.first)->clkconstr;
+                if (ev.second == events.at(d).second)
+                    p = constr->period.minDelay();
+                else if (ev.second == RISING_EDGE)
+                    p = constr->low.minDelay();
+                else
+                    p = constr->high.minDelay();
+            }
+            period.at(d).push_back(p);
+        }
+    }
+
+    for (auto cell : sorted(ctx->cells)) {
+        cells.push_back(cell.second);
+        std::vector<int> connected;
+        for (auto &port : cell.second->ports) {
+            auto found = port.second.net ? net_index.find(port.second.net) : net_index.end();
+            if (found != net_index.end())
+                connected.push_back(found->second);
+        }
+        std::sort(connected.begin(), connected.end());
+        connected.erase(std::unique(connected.begin(), connected.end()), connected.end());
+        cell_nets.push_back(connected);
+        cell_locs.push_back(Loc(-1, -1, -1));
+    }
+}
+
+void IncrementalCriticality::update_delays(TimingNet &tn)
+{
+    for (size_t u = 0; u < tn.net->users.size(); u++)
+        tn.delay.at(u) = route_delay ? route_delay(tn.net, int(u))
+                                     : delay_cache.route_delay(tn.arc_class.at(u), tn.net, tn.net->users.at(u));
+    int n = int(&tn - nets.data());
+    for (auto it = arc_delay_overrides.lower_bound(std::make_pair(n, 0));
+         it != arc_delay_overrides.end() && it->first.first == n; ++it)
+        tn.delay.at(it->first.second) = it->second;
+}
+
+bool IncrementalCriticality::update_arrival(TimingNet &tn)
+{
+    bool changed = false;
+    for (int d = 0; d < domain_count; d++) {
+        delay_t arrival = tn.start_arrival.at(d);
+        for (int a : tn.fanin) {
+            const CellArc &arc = arcs.at(a);
+            const TimingNet &from = nets.at(arc.from_net);
+            if (from.arrival.at(d) == std::numeric_limits<delay_t>::lowest())
+                continue;
+            arrival = std::max(arrival, from.arrival.at(d) + from.delay.at(arc.from_user) + arc.delay);
+        }
+        if (arrival != tn.arrival.at(d)) {
+            tn.arrival.at(d) = arrival;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool IncrementalCriticality::update_required(TimingNet &tn)
+{
+    bool changed = false;
+    for (int d = 0; d < domain_count; d++) {
+        delay_t net_required = std::numeric_limits<delay_t>::max();
+        for (size_t u = 0; u < tn.net->users.size(); u++) {
+            delay_t required = std::numeric_limits<delay_t>::max();
+            for (auto &endpoint : tn.endpoints.at(u))
+                required = std::min(required, period.at(d).at(endpoint.first) - endpoint.second);
+            for (int a : tn.fanout.at(u)) {
+                const CellArc &arc = arcs.at(a);
+                const TimingNet &to = nets.at(arc.to_net);
+                if (to.net_required.at(d) == std::numeric_limits<delay_t>::max())
+                    continue;
+                required = std::min(required, to.net_required.at(d) - arc.delay);
+            }
+            tn.required.at(u * domain_count + d) = required;
+            if (required != std::numeric_limits<delay_t>::max())
+                net_required = std::min(net_required, required - tn.delay.at(u));
+        }
+        if (net_required != tn.net_required.at(d)) {
+            tn.net_required.at(d) = net_required;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void IncrementalCriticality::update(NetCriticalityMap *net_crit, int move_threshold)
+{
+    // Find the nets of cells that have moved, and update the delays of their arcs
+    std::vector<bool> dirty(nets.size(), first_update);
+    for (size_t i = 0; i < cells.size(); i++) {
+        CellInfo *ci = cells.at(i);
+        if (ci->bel == BelId())
+            continue;
+        Loc loc = ctx->getBelLocation(ci->bel);
+        Loc &last = cell_locs.at(i);
+        if (loc == last || (std::abs(loc.x - last.x) + std::abs(loc.y - last.y) < move_threshold && !first_update))
+            continue;
+        last = loc;
+        for (int n : cell_nets.at(i))
+            dirty.at(n) = true;
+    }
+    for (int n : override_changed)
+        dirty.at(n) = true;
+    propagate(dirty, net_crit);
+}
+
+void IncrementalCriticality::update_nets(NetCriticalityMap *net_crit, const std::vector<NetInfo *> &changed_nets)
+{
+    std::vector<bool> dirty(nets.size(), first_update);
+    for (auto net : changed_nets) {
+        // Nets that are not timed, e.g. because they are only part of combinational loops, are ignored
+        auto found = net_index.find(net);
+        if (found != net_index.end())
+            dirty.at(found->second) = true;
+    }
+    for (int n : override_changed)
+        dirty.at(n) = true;
+    propagate(dirty, net_crit);
+}
+
+std::pair<int, int> IncrementalCriticality::find_arc(const CellInfo *cell, IdString port) const
+{
+    auto fnd_port = cell->ports.find(port);
+    if (fnd_port == cell->ports.end() || fnd_port->second.net == nullptr)
+        return std::make_pair(-1, -1);
+    const NetInfo *net = fnd_port->second.net;
+    auto found = net_index.find(net);
+    if (found == net_index.end())
+        return std::make_pair(-1, -1);
+    if (net->driver.cell == cell && net->driver.port == port)
+        return std::make_pair(found->second, -1);
+    size_t user = find_user(net, cell, port, fnd_port->second.user_idx);
+    if (user == net->users.size())
+        return std::make_pair(-1, -1);
+    return std::make_pair(found->second, int(user));
+}
+
+void IncrementalCriticality::set_arc_delay(const CellInfo *cell, IdString port, delay_t delay)
+{
+    auto arc = find_arc(cell, port);
+    if (arc.first == -1 || arc.second == -1)
+        log_error("Port '%s.%s' is not an input on a timed net.\n", ctx->nameOf(cell), ctx->nameOf(port));
+    arc_delay_overrides[arc] = delay;
+    override_changed.push_back(arc.first);
+}
+
+void IncrementalCriticality::clear_arc_delay(const CellInfo *cell, IdString port)
+{
+    auto arc = find_arc(cell, port);
+    if (arc.first != -1 && arc_delay_overrides.erase(arc))
+        override_changed.push_back(arc.first);
+}
+
+bool IncrementalCriticality::port_timing(const CellInfo *cell, IdString port, delay_t &arrival, delay_t &required,
+                                         delay_t &slack) const
+{
+    auto arc = find_arc(cell, port);
+    if (arc.first == -1 || first_update)
+        return false;
+    const TimingNet &tn = nets.at(arc.first);
+    arrival = std::numeric_limits<delay_t>::lowest();
+    required = std::numeric_limits<delay_t>::max();
+    slack = std::numeric_limits<delay_t>::max();
+    bool found = false;
+    for (int d = 0; d < domain_count; d++) {
+        if (tn.arrival.at(d) == std::numeric_limits<delay_t>::lowest())
+            continue;
+        delay_t d_arrival = tn.arrival.at(d), d_required = tn.net_required.at(d);
+        if (arc.second != -1) {
+            d_arrival += tn.delay.at(arc.second);
+            d_required = tn.required.at(arc.second * domain_count + d);
+        }
+        arrival = std::max(arrival, d_arrival);
+        if (d_required == std::numeric_limits<delay_t>::max())
+            continue;
+        required = std::min(required, d_required);
+        slack = std::min(slack, d_required - d_arrival);
+        found = true;
+    }
+    return found;
+}
+
+void IncrementalCriticality::propagate(const std::vector<bool> &dirty, NetCriticalityMap *net_crit)
+{
+    // Arrival times only depend on earlier nets in topological order, and required times on later ones, so
+    // changes are propagated in that order, stopping wherever a time is unchanged
+    std::priority_queue<int, std::vector<int>, std::greater<int>> fwd_queue;
+    std::priority_queue<int> bwd_queue;
+    auto queue_net = [&](int n, bool fwd) {
+        TimingNet &tn = nets.at(n);
+        if (tn.queued)
+            return;
+        tn.queued = true;
+        if (fwd)
+            fwd_queue.push(n);
+        else
+            bwd_queue.push(n);
+    };
+    updated_nets = 0;
+    for (int n = 0; n < int(nets.size()); n++) {
+        if (!dirty.at(n))
+            continue;
+        update_delays(nets.at(n));
+        ++updated_nets;
+        if (first_update)
+            queue_net(n, true);
+        for (auto &fanout : nets.at(n).fanout)
+            for (int a : fanout)
+                queue_net(arcs.at(a).to_net, true);
+    }
+    while (!fwd_queue.empty()) {
+        TimingNet &tn = nets.at(fwd_queue.top());
+        fwd_queue.pop();
+        tn.queued = false;
+        if (update_arrival(tn))
+            for (auto &fanout : tn.fanout)
+                for (int a : fanout)
+                    queue_net(arcs.at(a).to_net, true);
+    }
+    for (int n = 0; n < int(nets.size()); n++)
+        if (dirty.at(n))
+            queue_net(n, false);
+    while (!bwd_queue.empty()) {
+        TimingNet &tn = nets.at(bwd_queue.top());
+        bwd_queue.pop();
+        tn.queued = false;
+        if (update_required(tn))
+            for (int a : tn.fanin)
+                queue_net(arcs.at(a).from_net, false);
+    }
+    first_update = false;
+    override_changed.clear();
+
+    // The worst slack and critical path delay of every clock domain, which all criticalities depend on
+    std::vector<delay_t> worst_slack(domain_count, std::numeric_limits<delay_t>::max());
+    std::vector<delay_t> crit_delay(domain_count, 0);
+    for (auto &tn : nets) {
+        for (int d = 0; d < domain_count; d++) {
+            if (tn.arrival.at(d) == std::numeric_limits<delay_t>::lowest())
+                continue;
+            for (size_t u = 0; u < tn.net->users.size(); u++) {
+                delay_t arrival = tn.arrival.at(d) + tn.delay.at(u);
+                delay_t required = tn.required.at(u * domain_count + d);
+                if (required != std::numeric_limits<delay_t>::max())
+                    worst_slack.at(d) = std::min(worst_slack.at(d), required - arrival);
+                for (auto &endpoint : tn.endpoints.at(u))
+                    if (endpoint.first == d)
+                        crit_delay.at(d) = std::max(crit_delay.at(d), arrival + endpoint.second);
+            }
+        }
+    }
+    worst_slack_all = std::numeric_limits<delay_t>::max();
+    for (int d = 0; d < domain_count; d++)
+        worst_slack_all = std::min(worst_slack_all, worst_slack.at(d));
+    if (net_crit == nullptr)
+        return;
+
+    for (auto &tn : nets) {
+        std::vector<delay_t> slack(tn.net->users.size(), std::numeric_limits<delay_t>::max());
+        std::vector<float> criticality(tn.net->users.size(), 0);
+        delay_t cd_worst_slack = std::numeric_limits<delay_t>::max();
+        bool constrained = false;
+        for (int d = 0; d < domain_count; d++) {
+            if (tn.arrival.at(d) == std::numeric_limits<delay_t>::lowest() || crit_delay.at(d) <= 0)
+                continue;
+            for (size_t u = 0; u < tn.net->users.size(); u++) {
+                delay_t required = tn.required.at(u * domain_count + d);
+                if (required == std::numeric_limits<delay_t>::max())
+                    continue;
+                constrained = true;
+                delay_t user_slack = required - (tn.arrival.at(d) + tn.delay.at(u));
+                slack.at(u) = std::min(slack.at(u), user_slack);
+                float crit = 1.0f - ((float(user_slack) - float(worst_slack.at(d))) / crit_delay.at(d));
+                criticality.at(u) = std::max(criticality.at(u), std::min(1.0f, std::max(0.0f, crit)));
+            }
+            cd_worst_slack = std::min(cd_worst_slack, worst_slack.at(d));
+        }
+        if (!constrained) {
+            net_crit->erase(tn.net->name);
+            continue;
+        }
+        auto &nc = (*net_crit)[tn.net->name];
+        nc.slack = std::move(slack);
+        nc.criticality = std::move(criticality);
+        nc.cd_worst_slack = cd_worst_slack;
+    }
+}
+
 NEXTPNR_NAMESPACE_END
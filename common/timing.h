@@ -20,12 +20,32 @@
 #ifndef TIMING_H
 #define TIMING_H
 
+#include <functional>
+#include <map>
+#include <memory>
+#include "delay_cache.h"
 #include "nextpnr.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
+// The timing graph of the netlist: the topological order of nets, the class and clocking of every port and the delays
+// through cells. None of this depends on placement or routing, so passes that run timing analysis repeatedly on an
+// unchanged netlist should build it once and pass it to each analysis. It must be rebuilt after the netlist changes.
+struct TimingGraph
+{
+    explicit TimingGraph(Context *ctx);
+    ~TimingGraph();
+
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
 // Evenly redistribute the total path slack amongst all sinks on each path
-void assign_budget(Context *ctx, bool quiet = false);
+void assign_budget(Context *ctx, bool quiet = false, const TimingGraph *graph = nullptr);
+
+// As assign_budget, but always including net delays (predicted for unrouted arcs) so that the budgets reflect the
+// placement, for routing
+void assign_placed_budget(Context *ctx, const TimingGraph *graph = nullptr);
 
 // Perform timing analysis and print out the fmax, and optionally the
 //    critical path
@@ -43,7 +63,101 @@ struct NetCriticalityInfo
 };
 
 typedef std::unordered_map<IdString, NetCriticalityInfo> NetCriticalityMap;
-void get_criticalities(Context *ctx, NetCriticalityMap *net_crit);
+void get_criticalities(Context *ctx, NetCriticalityMap *net_crit, const TimingGraph *graph = nullptr);
+
+// Criticality analysis for placers that update criticalities often. The timing graph, the delay of every arc and the
+// arrival and required times are kept between updates, so that after the placement changes only the arcs of cells
+// that have moved, and the times that depend on them, are recomputed. Like get_criticalities, only paths within
+// a clock domain are used for criticality; max_path_length is not computed.
+struct IncrementalCriticality
+{
+    explicit IncrementalCriticality(Context *ctx);
+
+    // Update net_crit for the current placement. Cells that have moved by no more than move_threshold (in Manhattan
+    // distance) since the arcs of their nets were last updated are treated as not having moved.
+    void update(NetCriticalityMap *net_crit, int move_threshold = 0);
+
+    // Update net_crit after the given nets have changed, for example because they were rerouted. Only the arcs of
+    // these nets are recomputed, and cell moves are not looked for. net_crit may be null for the queries below.
+    void update_nets(NetCriticalityMap *net_crit, const std::vector<NetInfo *> &changed_nets);
+
+    // Use delay for the arc from the driver of its net to the input port of cell in place of the Arch delay, until
+    // cleared; takes effect, recomputing only what depends on the arc, at the next update. For what-if analysis
+    void set_arc_delay(const CellInfo *cell, IdString port, delay_t delay);
+    void clear_arc_delay(const CellInfo *cell, IdString port);
+
+    // The arrival and required times of the signal at a port of a cell, and the slack, as of the last update; the
+    // worst over all clock domains. Returns false if there are none, e.g. the port's net isn't timed
+    bool port_timing(const CellInfo *cell, IdString port, delay_t &arrival, delay_t &required, delay_t &slack) const;
+    // Worst slack over all clock domains as of the last update
+    delay_t worst_slack() const { return worst_slack_all; }
+
+    Context *getCtx() const { return ctx; }
+
+    // Number of nets whose delays were recomputed by the last update
+    int updated_nets = 0;
+
+    // If set, gives the delay of user user of net instead of the Arch route delay, e.g. for a router whose routing
+    // isn't bound to the Arch yet
+    std::function<delay_t(const NetInfo *net, int user)> route_delay;
+
+  private:
+    Context *ctx;
+    PredictDelayCache delay_cache;
+
+    // A combinational arc through a cell, from a user of a net to the net driven by that cell
+    struct CellArc
+    {
+        int from_net, from_user, to_net;
+        delay_t delay;
+    };
+
+    struct TimingNet
+    {
+        NetInfo *net;
+        std::vector<int> fanin;
+        // Per user
+        std::vector<delay_t> delay;
+        std::vector<int> arc_class;
+        std::vector<std::vector<int>> fanout;
+        std::vector<std::vector<std::pair<int, delay_t>>> endpoints; // (clock event, setup time)
+        // Per clock domain, and per user and clock domain for required
+        std::vector<delay_t> start_arrival, arrival, net_required;
+        std::vector<delay_t> required;
+        bool queued = false;
+    };
+
+    // Nets in topological order
+    std::vector<TimingNet> nets;
+    std::unordered_map<const NetInfo *, int> net_index;
+    std::vector<CellArc> arcs;
+    // All clock events, of which the first domain_count are the launching clock domains
+    std::vector<std::pair<IdString, ClockEdge>> events;
+    int domain_count = 0;
+    // Period available from each clock domain to each clock event
+    std::vector<std::vector<delay_t>> period;
+
+    // Cells, with the nets they connect to and their location when the arcs of these nets were last updated
+    std::vector<CellInfo *> cells;
+    std::vector<std::vector<int>> cell_nets;
+    std::vector<Loc> cell_locs;
+    bool first_update = true;
+
+    // Arc delays set by set_arc_delay, by (net, user), and the nets whose overrides changed since the last update
+    std::map<std::pair<int, int>, delay_t> arc_delay_overrides;
+    std::vector<int> override_changed;
+    delay_t worst_slack_all = std::numeric_limits<delay_t>::max();
+
+    // (index of the net in nets, user) of the arc to a port, or -1 for the net if there is none
+    std::pair<int, int> find_arc(const CellInfo *cell, IdString port) const;
+
+    void build();
+    void update_delays(TimingNet &tn);
+    bool update_arrival(TimingNet &tn);
+    bool update_required(TimingNet &tn);
+    // Recompute the delays of the dirty nets, propagate the changes and write the criticalities to net_crit
+    void propagate(const std::vector<bool> &dirty, NetCriticalityMap *net_crit);
+};
 
 NEXTPNR_NAMESPACE_END
 
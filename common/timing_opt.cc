@@ -31,7 +31,9 @@
 #include "timing_opt.h"
 #include <boost/range/adaptor/reversed.hpp>
 #include <queue>
+#include "delay_cache.h"
 #include "nextpnr.h"
+#include "place_common.h"
 #include "timing.h"
 #include "util.h"
 
@@ -79,7 +81,7 @@ NEXTPNR_NAMESPACE_BEGIN
 class TimingOptimiser
 {
   public:
-    TimingOptimiser(Context *ctx, TimingOptCfg cfg) : ctx(ctx), cfg(cfg){};
+    TimingOptimiser(Context *ctx, TimingOptCfg cfg) : ctx(ctx), cfg(cfg), delay_cache(ctx){};
     bool optimise()
     {
         log_info("Running timing-driven placement optimisation...\n");
@@ -88,7 +90,7 @@ class TimingOptimiser
             timing_analysis(ctx, false, true, false, false);
         for (int i = 0; i < 30; i++) {
             log_info("   Iteration %d...\n", i);
-            get_criticalities(ctx, &net_crit);
+            get_criticalities(ctx, &net_crit, get_timing_graph());
             setup_delay_limits();
             auto crit_paths = find_crit_paths(0.98, 50000);
             for (auto &path : crit_paths)
@@ -139,7 +141,7 @@ class TimingOptimiser
                     continue;
                 for (auto user : net->users) {
                     if (user.cell == cell && user.port == port.first) {
-                        if (ctx->predictDelay(net, user) >
+                        if (delay_cache.predict(net, user) >
                             1.1 * max_net_delay.at(std::make_pair(cell->name, port.first)))
                             return false;
                     }
@@ -151,7 +153,7 @@ class TimingOptimiser
                     BelId dstBel = user.cell->bel;
                     if (dstBel == BelId())
                         continue;
-                    if (ctx->predictDelay(net, user) >
+                    if (delay_cache.predict(net, user) >
                         1.1 * max_net_delay.at(std::make_pair(user.cell->name, user.port))) {
 
                         return false;
@@ -162,33 +164,14 @@ class TimingOptimiser
         return true;
     }
 
-    BelId cell_swap_bel(CellInfo *cell, BelId newBel)
+    // Check that a batch of moves are both legal and remain within maximum delay bounds
+    bool acceptable_move(const CellMoveBatch &move, bool check_delays = true)
     {
-        BelId oldBel = cell->bel;
-        if (oldBel == newBel)
-            return oldBel;
-        CellInfo *other_cell = ctx->getBoundBelCell(newBel);
-        NPNR_ASSERT(other_cell == nullptr || other_cell->belStrength <= STRENGTH_WEAK);
-        ctx->unbindBel(oldBel);
-        if (other_cell != nullptr) {
-            ctx->unbindBel(newBel);
-            ctx->bindBel(oldBel, other_cell, STRENGTH_WEAK);
-        }
-        ctx->bindBel(newBel, cell, STRENGTH_WEAK);
-        return oldBel;
-    }
-
-    // Check that a series of moves are both legal and remain within maximum delay bounds
-    // Moves are specified as a vector of pairs <cell, oldBel>
-    bool acceptable_move(std::vector<std::pair<CellInfo *, BelId>> &move, bool check_delays = true)
-    {
-        for (auto &entry : move) {
-            if (!ctx->isBelLocationValid(entry.first->bel))
-                return false;
-            if (!ctx->isBelLocationValid(entry.second))
-                return false;
-            if (!check_delays)
-                continue;
+        if (!move.is_legal())
+            return false;
+        if (!check_delays)
+            return true;
+        for (auto &entry : move.moves) {
             if (!check_cell_delay_limits(entry.first))
                 return false;
             // We might have swapped another cell onto the original bel. Check this for max delay violations
@@ -200,72 +183,94 @@ class TimingOptimiser
         return true;
     }
 
+    // The bels of the same type as a bel in each tile within distance d of it (or the groups given by the arch), in
+    // the order find_neighbours visits them. This only depends on the device, so is found once per bel for the run.
+    const std::vector<std::vector<BelId>> &get_window_bels(BelId centre, int d)
+    {
+        auto found = window_bels.find(std::make_pair(d, centre));
+        if (found != window_bels.end())
+            return found->second;
+        std::vector<std::vector<BelId>> tiles;
+        if (cfg.neighbourBels) {
+            cfg.neighbourBels(centre, d, tiles);
+            return window_bels[std::make_pair(d, centre)] = std::move(tiles);
+        }
+        Loc centre_loc = ctx->getBelLocation(centre);
+        IdString type = ctx->getBelType(centre);
+        for (int dy = -d; dy <= d; dy++) {
+            for (int dx = -d; dx <= d; dx++) {
+                std::vector<BelId> tile_bels;
+                for (auto bel : ctx->getBelsByTile(centre_loc.x + dx, centre_loc.y + dy))
+                    if (ctx->getBelType(bel) == type)
+                        tile_bels.push_back(bel);
+                if (!tile_bels.empty())
+                    tiles.push_back(std::move(tile_bels));
+            }
+        }
+        return window_bels[std::make_pair(d, centre)] = std::move(tiles);
+    }
+
     int find_neighbours(CellInfo *cell, IdString prev_cell, int d, bool allow_swap)
     {
         BelId curr = cell->bel;
-        Loc curr_loc = ctx->getBelLocation(curr);
         int found_count = 0;
         cell_neighbour_bels[cell->name] = std::unordered_set<BelId>{};
-        for (int dy = -d; dy <= d; dy++) {
-            for (int dx = -d; dx <= d; dx++) {
-                // Go through all the Bels at this location
-                // First, find all bels of the correct type that are either unbound or bound normally
-                // Strongly bound bels are ignored
-                // FIXME: This means that we cannot touch carry chains or similar relatively constrained macros
-                std::vector<BelId> free_bels_at_loc;
-                std::vector<BelId> bound_bels_at_loc;
-                for (auto bel : ctx->getBelsByTile(curr_loc.x + dx, curr_loc.y + dy)) {
-                    if (ctx->getBelType(bel) != cell->type)
-                        continue;
-                    CellInfo *bound = ctx->getBoundBelCell(bel);
-                    if (bound == nullptr) {
-                        free_bels_at_loc.push_back(bel);
-                    } else if (bound->belStrength <= STRENGTH_WEAK && bound->constr_parent == nullptr &&
-                               bound->constr_children.empty()) {
-                        bound_bels_at_loc.push_back(bel);
-                    }
+        for (auto &tile_bels : get_window_bels(curr, d)) {
+            // Go through all the Bels at this location
+            // First, find all bels of the correct type that are either unbound or bound normally
+            // Strongly bound bels are ignored
+            // FIXME: This means that we cannot touch carry chains or similar relatively constrained macros
+            std::vector<BelId> free_bels_at_loc;
+            std::vector<BelId> bound_bels_at_loc;
+            for (auto bel : tile_bels) {
+                CellInfo *bound = ctx->getBoundBelCell(bel);
+                if (bound == nullptr) {
+                    free_bels_at_loc.push_back(bel);
+                } else if (bound->belStrength <= STRENGTH_WEAK && bound->constr_parent == nullptr &&
+                           bound->constr_children.empty()) {
+                    bound_bels_at_loc.push_back(bel);
                 }
-                BelId candidate;
-
-                while (!free_bels_at_loc.empty() || !bound_bels_at_loc.empty()) {
-                    BelId try_bel;
-                    if (!free_bels_at_loc.empty()) {
-                        int try_idx = ctx->rng(int(free_bels_at_loc.size()));
-                        try_bel = free_bels_at_loc.at(try_idx);
-                        free_bels_at_loc.erase(free_bels_at_loc.begin() + try_idx);
-                    } else {
-                        int try_idx = ctx->rng(int(bound_bels_at_loc.size()));
-                        try_bel = bound_bels_at_loc.at(try_idx);
-                        bound_bels_at_loc.erase(bound_bels_at_loc.begin() + try_idx);
-                    }
-                    if (bel_candidate_cells.count(try_bel) && !allow_swap) {
-                        // Overlap is only allowed if it is with the previous cell (this is handled by removing those
-                        // edges in the graph), or if allow_swap is true to deal with cases where overlap means few
-                        // neighbours are identified
-                        if (bel_candidate_cells.at(try_bel).size() > 1 ||
-                            (bel_candidate_cells.at(try_bel).size() == 1 &&
-                             *(bel_candidate_cells.at(try_bel).begin()) != prev_cell))
-                            continue;
-                    }
-                    // TODO: what else to check here?
-                    candidate = try_bel;
-                    break;
+            }
+            BelId candidate;
+
+            while (!free_bels_at_loc.empty() || !bound_bels_at_loc.empty()) {
+                BelId try_bel;
+                if (!free_bels_at_loc.empty()) {
+                    int try_idx = ctx->rng(int(free_bels_at_loc.size()));
+                    try_bel = free_bels_at_loc.at(try_idx);
+                    free_bels_at_loc.erase(free_bels_at_loc.begin() + try_idx);
+                } else {
+                    int try_idx = ctx->rng(int(bound_bels_at_loc.size()));
+                    try_bel = bound_bels_at_loc.at(try_idx);
+                    bound_bels_at_loc.erase(bound_bels_at_loc.begin() + try_idx);
                 }
+                if (bel_candidate_cells.count(try_bel) && !allow_swap) {
+                    // Overlap is only allowed if it is with the previous cell (this is handled by removing those
+                    // edges in the graph), or if allow_swap is true to deal with cases where overlap means few
+                    // neighbours are identified
+                    if (bel_candidate_cells.at(try_bel).size() > 1 ||
+                        (bel_candidate_cells.at(try_bel).size() == 1 &&
+                         *(bel_candidate_cells.at(try_bel).begin()) != prev_cell))
+                        continue;
+                }
+                // TODO: what else to check here?
+                candidate = try_bel;
+                break;
+            }
 
-                if (candidate != BelId()) {
-                    cell_neighbour_bels[cell->name].insert(candidate);
-                    bel_candidate_cells[candidate].insert(cell->name);
-                    // Work out if we need to delete any overlap
-                    std::vector<IdString> overlap;
-                    for (auto other : bel_candidate_cells[candidate])
-                        if (other != cell->name && other != prev_cell)
-                            overlap.push_back(other);
-                    if (overlap.size() > 0)
-                        NPNR_ASSERT(allow_swap);
-                    for (auto ov : overlap) {
-                        bel_candidate_cells[candidate].erase(ov);
-                        cell_neighbour_bels[ov].erase(candidate);
-                    }
+            if (candidate != BelId()) {
+                cell_neighbour_bels[cell->name].insert(candidate);
+                bel_candidate_cells[candidate].insert(cell->name);
+                // Work out if we need to delete any overlap
+                std::vector<IdString> overlap;
+                for (auto other : bel_candidate_cells[candidate])
+                    if (other != cell->name && other != prev_cell)
+                        overlap.push_back(other);
+                if (overlap.size() > 0)
+                    NPNR_ASSERT(allow_swap);
+                for (auto ov : overlap) {
+                    bel_candidate_cells[candidate].erase(ov);
+                    cell_neighbour_bels[ov].erase(candidate);
                 }
             }
         }
@@ -448,19 +453,16 @@ class TimingOptimiser
             return;
         }
 
+        // The path entries point into the users of their nets, so the delay of each arc can be predicted directly
+        std::vector<NetInfo *> path_nets;
+        for (auto port : path)
+            path_nets.push_back(port->cell->ports.at(port->port).net);
+
         // Calculate original delay before touching anything
         delay_t original_delay = 0;
 
-        for (size_t i = 0; i < path.size(); i++) {
-            NetInfo *pn = path.at(i)->cell->ports.at(path.at(i)->port).net;
-            for (size_t j = 0; j < pn->users.size(); j++) {
-                auto &usr = pn->users.at(j);
-                if (usr.cell == path.at(i)->cell && usr.port == path.at(i)->port) {
-                    original_delay += ctx->predictDelay(pn, usr);
-                    break;
-                }
-            }
-        }
+        for (size_t i = 0; i < path.size(); i++)
+            original_delay += delay_cache.predict(path_nets.at(i), *path.at(i));
 
         IdString last_cell;
         const int d = 2; // FIXME: how to best determine d
@@ -486,18 +488,18 @@ class TimingOptimiser
         std::queue<std::pair<int, BelId>> visit;
         std::unordered_set<std::pair<int, BelId>> to_visit;
 
+        CellMoveBatch move(ctx);
         for (auto startbel : cell_neighbour_bels[path_cells.front()]) {
             // Swap for legality check
             CellInfo *cell = ctx->cells.at(path_cells.front()).get();
-            BelId origBel = cell_swap_bel(cell, startbel);
-            std::vector<std::pair<CellInfo *, BelId>> move{std::make_pair(cell, origBel)};
+            move.swap(cell, startbel);
             if (acceptable_move(move)) {
                 auto entry = std::make_pair(0, startbel);
                 visit.push(entry);
                 cumul_costs[path_cells.front()][startbel] = 0;
             }
             // Swap back
-            cell_swap_bel(cell, origBel);
+            move.rollback();
         }
 
         while (!visit.empty()) {
@@ -506,7 +508,6 @@ class TimingOptimiser
             auto cellname = path_cells.at(entry.first);
             if (entry.first == int(path_cells.size()) - 1)
                 continue;
-            std::vector<std::pair<CellInfo *, BelId>> move;
             // Apply the entire backtrace for accurate legality and delay checks
             // This is probably pretty expensive (but also probably pales in comparison to the number of swaps
             // SA will make...)
@@ -519,8 +520,7 @@ class TimingOptimiser
             }
             for (auto rt_entry : boost::adaptors::reverse(route_to_entry)) {
                 CellInfo *cell = ctx->cells.at(rt_entry.first).get();
-                BelId origBel = cell_swap_bel(cell, rt_entry.second);
-                move.push_back(std::make_pair(cell, origBel));
+                move.swap(cell, rt_entry.second);
             }
 
             // Have a look at where we can travel from here
@@ -531,20 +531,12 @@ class TimingOptimiser
                 // Experimentally swap the next path cell onto the neighbour bel we are trying
                 IdString ncname = path_cells.at(entry.first + 1);
                 CellInfo *next_cell = ctx->cells.at(ncname).get();
-                BelId origBel = cell_swap_bel(next_cell, neighbour);
-                move.push_back(std::make_pair(next_cell, origBel));
+                move.swap(next_cell, neighbour);
 
                 delay_t total_delay = 0;
 
                 for (size_t i = 0; i < path.size(); i++) {
-                    NetInfo *pn = path.at(i)->cell->ports.at(path.at(i)->port).net;
-                    for (size_t j = 0; j < pn->users.size(); j++) {
-                        auto &usr = pn->users.at(j);
-                        if (usr.cell == path.at(i)->cell && usr.port == path.at(i)->port) {
-                            total_delay += ctx->predictDelay(pn, usr);
-                            break;
-                        }
-                    }
+                    total_delay += delay_cache.predict(path_nets.at(i), *path.at(i));
                     if (path.at(i)->cell == next_cell)
                         break;
                 }
@@ -562,15 +554,12 @@ class TimingOptimiser
                     }
                 }
                 // Revert the experimental swap
-                cell_swap_bel(move.back().first, move.back().second);
-                move.pop_back();
+                move.undo_last();
             }
 
             // Revert move by swapping cells back to their original order
             // Execute swaps in reverse order to how we made them originally
-            for (auto move_entry : boost::adaptors::reverse(move)) {
-                cell_swap_bel(move_entry.first, move_entry.second);
-            }
+            move.rollback();
         }
 
         // Did we find a solution??
@@ -595,10 +584,11 @@ class TimingOptimiser
                          ctx->getDelayNS(lowest->second), ctx->getDelayNS(original_delay));
             for (auto rt_entry : boost::adaptors::reverse(route_to_solution)) {
                 CellInfo *cell = ctx->cells.at(rt_entry.first).get();
-                cell_swap_bel(cell, rt_entry.second);
+                move.swap(cell, rt_entry.second);
                 if (ctx->debug)
                     log_info("    %s at %s\n", rt_entry.first.c_str(ctx), ctx->getBelName(rt_entry.second).c_str(ctx));
             }
+            move.commit();
 
         } else {
             if (ctx->debug)
@@ -612,12 +602,23 @@ class TimingOptimiser
     std::vector<IdString> path_cells;
     std::unordered_map<IdString, std::unordered_set<BelId>> cell_neighbour_bels;
     std::unordered_map<BelId, std::unordered_set<IdString>> bel_candidate_cells;
+    // Same-type bels around each bel, by (distance, bel)
+    std::unordered_map<std::pair<int, BelId>, std::vector<std::vector<BelId>>> window_bels;
     // Map cell ports to net delay limit
     std::unordered_map<std::pair<IdString, IdString>, delay_t> max_net_delay;
     // Criticality data from timing analysis
     NetCriticalityMap net_crit;
+    // Timing graph for repeated analysis, built on first use; the netlist is not changed while optimising
+    std::unique_ptr<TimingGraph> timing_graph;
+    const TimingGraph *get_timing_graph()
+    {
+        if (!timing_graph)
+            timing_graph.reset(new TimingGraph(ctx));
+        return timing_graph.get();
+    }
     Context *ctx;
     TimingOptCfg cfg;
+    PredictDelayCache delay_cache;
 };
 
 bool timing_opt(Context *ctx, TimingOptCfg cfg) { return TimingOptimiser(ctx, cfg).optimise(); }
@@ -17,6 +17,7 @@
  *
  */
 
+#include <functional>
 #include "log.h"
 #include "nextpnr.h"
 
@@ -30,6 +31,11 @@ struct TimingOptCfg
     // Normally these would only be logic cells (or tiles if applicable), the algorithm makes little sense
     // for other cell types
     std::unordered_set<IdString> cellTypes;
+
+    // Optionally, the arch can supply the bels that a cell on the centre bel could be moved to, within d tiles of it,
+    // as groups of which at most one bel is picked each (normally one group per tile). By default, every tile in the
+    // window is searched with getBelsByTile for bels of the centre bel's type.
+    std::function<void(BelId centre, int d, std::vector<std::vector<BelId>> &groups)> neighbourBels;
 };
 
 extern bool timing_opt(Context *ctx, TimingOptCfg cfg);
@@ -20,6 +20,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <string>
@@ -67,6 +68,18 @@ std::string str_or_default(const std::unordered_map<KeyType, Property> &ct, cons
     }
 };
 
+inline std::string str_or_default(const IdStringDict<Property> &ct, const IdString &key, std::string def = "")
+{
+    auto found = ct.find(key);
+    if (found == ct.end())
+        return def;
+    else {
+        if (!found->second.is_string)
+            log_error("Expecting string value but got integer %d.\n", int(found->second.intval));
+        return found->second.as_string();
+    }
+};
+
 // Get a value from a map-style container, converting to int, and returning
 // default if value is not found
 template <typename Container, typename KeyType> int int_or_default(const Container &ct, const KeyType &key, int def = 0)
@@ -96,6 +109,23 @@ int int_or_default(const std::unordered_map<KeyType, Property> &ct, const KeyTyp
     }
 };
 
+inline int int_or_default(const IdStringDict<Property> &ct, const IdString &key, int def = 0)
+{
+    auto found = ct.find(key);
+    if (found == ct.end())
+        return def;
+    else {
+        if (found->second.is_string) {
+            try {
+                return std::stoi(found->second.as_string());
+            } catch (std::invalid_argument &e) {
+                log_error("Expecting numeric value but got '%s'.\n", found->second.as_string().c_str());
+            }
+        } else
+            return found->second.as_int64();
+    }
+};
+
 // As above, but convert to bool
 template <typename Container, typename KeyType>
 bool bool_or_default(const Container &ct, const KeyType &key, bool def = false)
@@ -103,17 +133,23 @@ bool bool_or_default(const Container &ct, const KeyType &key, bool def = false)
     return bool(int_or_default(ct, key, int(def)));
 };
 
-// Wrap an unordered_map, and allow it to be iterated over sorted by key
-template <typename K, typename V> std::map<K, V *> sorted(const std::unordered_map<K, std::unique_ptr<V>> &orig)
+// Wrap an unordered_map, and allow it to be iterated over sorted by key. This is a sorted vector rather than a map, as
+// it is called on all the cells or nets of large designs and only ever iterated over
+template <typename K, typename V>
+std::vector<std::pair<K, V *>> sorted(const std::unordered_map<K, std::unique_ptr<V>> &orig)
 {
-    std::map<K, V *> retVal;
+    std::vector<std::pair<K, V *>> retVal;
+    retVal.reserve(orig.size());
     for (auto &item : orig)
-        retVal.emplace(std::make_pair(item.first, item.second.get()));
+        retVal.emplace_back(item.first, item.second.get());
+    std::sort(retVal.begin(), retVal.end(),
+              [](const std::pair<K, V *> &a, const std::pair<K, V *> &b) { return a.first < b.first; });
     return retVal;
 };
 
 // Wrap an unordered_map, and allow it to be iterated over sorted by key
-template <typename K, typename V> std::map<K, V &> sorted_ref(std::unordered_map<K, V> &orig)
+template <typename K, typename V, typename H, typename E, typename A>
+std::map<K, V &> sorted_ref(std::unordered_map<K, V, H, E, A> &orig)
 {
     std::map<K, V &> retVal;
     for (auto &item : orig)
@@ -122,7 +158,8 @@ template <typename K, typename V> std::map<K, V &> sorted_ref(std::unordered_map
 };
 
 // Wrap an unordered_map, and allow it to be iterated over sorted by key
-template <typename K, typename V> std::map<K, const V &> sorted_cref(const std::unordered_map<K, V> &orig)
+template <typename K, typename V, typename H, typename E, typename A>
+std::map<K, const V &> sorted_cref(const std::unordered_map<K, V, H, E, A> &orig)
 {
     std::map<K, const V &> retVal;
     for (auto &item : orig)
@@ -130,12 +167,28 @@ template <typename K, typename V> std::map<K, const V &> sorted_cref(const std::
     return retVal;
 };
 
-// Wrap an unordered_set, and allow it to be iterated over sorted by key
-template <typename K> std::set<K> sorted(const std::unordered_set<K> &orig)
+// IdStringDict is already sorted by key, these allow it to be used in the same way as an unordered_map
+template <typename V> std::map<IdString, V &> sorted_ref(IdStringDict<V> &orig)
+{
+    std::map<IdString, V &> retVal;
+    for (auto &item : orig)
+        retVal.emplace(std::make_pair(item.first, std::ref(item.second)));
+    return retVal;
+};
+
+template <typename V> std::map<IdString, const V &> sorted_cref(const IdStringDict<V> &orig)
 {
-    std::set<K> retVal;
+    std::map<IdString, const V &> retVal;
     for (auto &item : orig)
-        retVal.insert(item);
+        retVal.emplace(std::make_pair(item.first, std::ref(item.second)));
+    return retVal;
+};
+
+// Wrap an unordered_set, and allow it to be iterated over sorted by key
+template <typename K> std::vector<K> sorted(const std::unordered_set<K> &orig)
+{
+    std::vector<K> retVal(orig.begin(), orig.end());
+    std::sort(retVal.begin(), retVal.end());
     return retVal;
 };
 
@@ -0,0 +1,67 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef WIRE_INDEXER_H
+#define WIRE_INDEXER_H
+
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+#if defined(ARCH_ICE40) || defined(ARCH_ECP5) || defined(ARCH_GENERIC) || defined(ARCH_GOWIN)
+#define NPNR_DENSE_WIRE_INDEX
+// Dense index of every wire, computed directly from the WireId without any hashing. Wires are numbered in
+// ctx->getWires() order; only defined where the Arch database layout allows this
+struct WireIndexer
+{
+    explicit WireIndexer(const Context *ctx)
+    {
+#if defined(ARCH_ICE40)
+        count = ctx->chip_info->wire_data.size();
+#elif defined(ARCH_GENERIC) || defined(ARCH_GOWIN)
+        // Wires are stored in the order they were added, which is also the getWires() order
+        wire_index = &ctx->wire_index;
+        count = int(ctx->wires.size());
+#else
+        width = ctx->chip_info->width;
+        count = 0;
+        for (int i = 0; i < ctx->chip_info->width * ctx->chip_info->height; i++) {
+            tile_offset.push_back(count);
+            count += ctx->chip_info->locations[ctx->chip_info->location_type[i]].wire_data.size();
+        }
+#endif
+    }
+
+#if defined(ARCH_ICE40)
+    int operator()(WireId wire) const { return wire.index; }
+#elif defined(ARCH_GENERIC) || defined(ARCH_GOWIN)
+    int operator()(WireId wire) const { return (*wire_index)[wire.index]; }
+    const std::vector<int> *wire_index;
+#else
+    int operator()(WireId wire) const { return tile_offset[wire.location.y * width + wire.location.x] + wire.index; }
+    std::vector<int> tile_offset;
+    int width;
+#endif
+    int count;
+};
+#endif
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+#ifndef NPNR_DISABLE_THREADS
+// Persistent set of worker threads, kept for the whole duration of a pass (e.g. routing) so that each batch of work
+// doesn't pay thread startup costs. Each batch of tasks is dealt round-robin, in priority order, onto per-worker
+// deques; a worker that runs out of tasks steals from the back of the other workers' deques.
+struct WorkerPool
+{
+    explicit WorkerPool(int n_workers) : workers(n_workers)
+    {
+        for (int i = 0; i < n_workers; i++)
+            threads.emplace_back([this, i]() { worker_thread(i); });
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::unique_lock<std::mutex> lk(batch_mutex);
+            stop = true;
+        }
+        batch_cv.notify_all();
+        for (auto &t : threads)
+            t.join();
+    }
+
+    // Run func(task) for every task and wait for completion; tasks should be given highest priority first
+    void run(const std::vector<int> &tasks, const std::function<void(int)> &func)
+    {
+        if (tasks.empty())
+            return;
+        {
+            std::unique_lock<std::mutex> lk(batch_mutex);
+            for (size_t i = 0; i < tasks.size(); i++) {
+                auto &w = workers.at(i % workers.size());
+                std::unique_lock<std::mutex> wlk(w.mutex);
+                w.tasks.push_back(tasks.at(i));
+            }
+            task_func = &func;
+            remaining = int(tasks.size());
+            error = nullptr;
+            ++generation;
+        }
+        batch_cv.notify_all();
+        std::unique_lock<std::mutex> lk(batch_mutex);
+        done_cv.wait(lk, [this]() { return remaining == 0; });
+        task_func = nullptr;
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    int size() const { return int(workers.size()); }
+
+  private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    std::vector<Worker> workers;
+    std::vector<boost::thread> threads;
+
+    std::mutex batch_mutex;
+    std::condition_variable batch_cv, done_cv;
+    const std::function<void(int)> *task_func = nullptr;
+    int remaining = 0;
+    uint64_t generation = 0;
+    bool stop = false;
+    std::exception_ptr error;
+
+    bool take_task(int worker, int &task)
+    {
+        {
+            auto &w = workers.at(worker);
+            std::unique_lock<std::mutex> lk(w.mutex);
+            if (!w.tasks.empty()) {
+                task = w.tasks.front();
+                w.tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < workers.size(); i++) {
+            auto &victim = workers.at((worker + i) % workers.size());
+            std::unique_lock<std::mutex> lk(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_thread(int idx)
+    {
+        uint64_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lk(batch_mutex);
+                batch_cv.wait(lk, [&]() { return stop || generation != seen_generation; });
+                if (stop)
+                    return;
+                seen_generation = generation;
+            }
+            int task;
+            while (take_task(idx, task)) {
+                // The batch a task belongs to can't complete until the task has run, so task_func is
+                // always the right function here even if this worker woke up for an earlier batch
+                const std::function<void(int)> *func;
+                {
+                    std::unique_lock<std::mutex> lk(batch_mutex);
+                    func = task_func;
+                }
+                try {
+                    (*func)(task);
+                } catch (...) {
+                    std::unique_lock<std::mutex> lk(batch_mutex);
+                    if (!error)
+                        error = std::current_exception();
+                }
+                std::unique_lock<std::mutex> lk(batch_mutex);
+                if (--remaining == 0)
+                    done_cv.notify_all();
+            }
+        }
+    }
+};
+#endif
+
+NEXTPNR_NAMESPACE_END
+
+#endif
@@ -33,6 +33,7 @@
 #include "router1.h"
 #include "router2.h"
 #include "timing.h"
+#include "timing_opt.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -102,6 +103,15 @@ Arch::Arch(ArchArgs args) : args(args)
     if (chip_info->const_id_count != DB_CONST_ID_COUNT)
         log_error("Chip database 'bba' and nextpnr code are out of sync; please rebuild (or contact distribution "
                   "maintainer)!\n");
+    // Bels, wires and pips are used throughout; tile names and package data only for a few lookups
+    for (auto &loc : chip_info->locations) {
+        chipdb_advise(loc.bel_data, ChipdbUse::HOT);
+        chipdb_advise(loc.wire_data, ChipdbUse::HOT);
+        chipdb_advise(loc.pip_data, ChipdbUse::HOT);
+    }
+    chipdb_advise(chip_info->tile_info, ChipdbUse::COLD);
+    chipdb_advise(chip_info->package_info, ChipdbUse::COLD);
+    chipdb_advise(chip_info->pio_info, ChipdbUse::COLD);
 
     package_info = nullptr;
     for (auto &pkg : chip_info->package_info) {
@@ -115,6 +125,33 @@ Arch::Arch(ArchArgs args) : args(args)
         log_error("Unsupported package '%s' for '%s'.\n", args.package.c_str(), getChipName().c_str());
 
     bel_to_cell.resize(chip_info->height * chip_info->width * max_loc_bels, nullptr);
+    bel_package_pin.resize(bel_to_cell.size(), -1);
+    for (size_t i = 0; i < package_info->pin_data.size(); i++) {
+        auto &ppin = package_info->pin_data[i];
+        package_pin_by_name.emplace(ppin.name.get(), int(i));
+        BelId bel;
+        bel.location = ppin.abs_loc;
+        bel.index = ppin.bel_index;
+        if (bel_package_pin.at(getBelFlatIndex(bel)) == -1)
+            bel_package_pin.at(getBelFlatIndex(bel)) = int(i);
+    }
+    slice_tiles.resize(chip_info->height * chip_info->width);
+
+    int num_tiles = chip_info->width * chip_info->height;
+    tile_wire_base.resize(num_tiles + 1);
+    tile_pip_base.resize(num_tiles + 1);
+    for (int i = 0; i < num_tiles; i++) {
+        const LocationTypePOD &loc = chip_info->locations[chip_info->location_type[i]];
+        tile_wire_base[i + 1] = tile_wire_base[i] + loc.wire_data.size();
+        tile_pip_base[i + 1] = tile_pip_base[i] + loc.pip_data.size();
+    }
+    wire_to_net.resize(tile_wire_base.back(), nullptr);
+    wire_fanout.resize(tile_wire_base.back(), 0);
+    pip_to_net.resize(tile_pip_base.back(), nullptr);
+    tile_decals = std::vector<std::atomic<const TileDecals *>>(num_tiles);
+
+    setupCellTimingLookup();
+    setupWireTypeReach();
 }
 
 // -----------------------------------------------------------------------
@@ -335,25 +372,22 @@ IdString Arch::getPipName(PipId pip) const
 
 BelId Arch::getPackagePinBel(const std::string &pin) const
 {
-    for (auto &ppin : package_info->pin_data) {
-        if (ppin.name.get() == pin) {
-            BelId bel;
-            bel.location = ppin.abs_loc;
-            bel.index = ppin.bel_index;
-            return bel;
-        }
-    }
-    return BelId();
+    auto found = package_pin_by_name.find(pin);
+    if (found == package_pin_by_name.end())
+        return BelId();
+    auto &ppin = package_info->pin_data[found->second];
+    BelId bel;
+    bel.location = ppin.abs_loc;
+    bel.index = ppin.bel_index;
+    return bel;
 }
 
 std::string Arch::getBelPackagePin(BelId bel) const
 {
-    for (auto &ppin : package_info->pin_data) {
-        if (Location(ppin.abs_loc) == bel.location && ppin.bel_index == bel.index) {
-            return ppin.name.get();
-        }
-    }
-    return "";
+    int pin = bel_package_pin.at(getBelFlatIndex(bel));
+    if (pin == -1)
+        return "";
+    return package_info->pin_data[pin].name.get();
 }
 
 int Arch::getPioBelBank(BelId bel) const
@@ -518,6 +552,27 @@ ArcBounds Arch::getRouteBoundingBox(WireId src, WireId dst) const
         dst_loc = est_location(dst);
     }
     extend(dst_loc.first, dst_loc.second);
+
+    if (src != dst) {
+        // The estimated locations only take one pip of each wire into account. Make sure the box contains every pip
+        // the route could leave the source wire or enter the sink wire through, using the reach of their types, so
+        // the first and last hops never force the arc out of the box
+        auto extend_reach = [&](WireId w) {
+            int type = locInfo(w)->wire_data[w.index].type;
+            if (type < 0 || type >= int(wire_type_reach.size()))
+                return;
+            const auto &reach = wire_type_reach[type];
+            extend(w.location.x - reach.first, w.location.y - reach.second);
+            extend(w.location.x + reach.first, w.location.y + reach.second);
+        };
+        extend_reach(src);
+        extend_reach(dst);
+        // Nothing can be routed outside the device, so the extra reach stops at its edges
+        bb.x0 = std::max(bb.x0, 0);
+        bb.y0 = std::max(bb.y0, 0);
+        bb.x1 = std::min(bb.x1, chip_info->width - 1);
+        bb.y1 = std::min(bb.y1, chip_info->height - 1);
+    }
     return bb;
 }
 
@@ -583,6 +638,28 @@ bool Arch::place()
     } else {
         log_error("ECP5 architecture does not support placer '%s'\n", placer.c_str());
     }
+    bool retVal = true;
+    if (bool_or_default(settings, id("opt_timing"), false)) {
+        TimingOptCfg tocfg(getCtx());
+        tocfg.cellTypes.insert(id_TRELLIS_SLICE);
+        // The four slices of a PLC tile are at z 0..3, so look them up directly rather than scanning every bel
+        tocfg.neighbourBels = [this](BelId centre, int d, std::vector<std::vector<BelId>> &groups) {
+            Loc centre_loc = getBelLocation(centre);
+            for (int y = std::max(0, centre_loc.y - d); y <= std::min(getGridDimY() - 1, centre_loc.y + d); y++) {
+                for (int x = std::max(0, centre_loc.x - d); x <= std::min(getGridDimX() - 1, centre_loc.x + d); x++) {
+                    std::vector<BelId> slices;
+                    for (int z = 0; z < 4; z++) {
+                        BelId bel = getBelByLocation(Loc(x, y, z));
+                        if (bel != BelId() && getBelType(bel) == id_TRELLIS_SLICE)
+                            slices.push_back(bel);
+                    }
+                    if (!slices.empty())
+                        groups.push_back(std::move(slices));
+                }
+            }
+        };
+        retVal = timing_opt(getCtx(), tocfg);
+    }
     permute_luts();
 
     // In out-of-context mode, create a locked macro
@@ -593,7 +670,7 @@ bool Arch::place()
     getCtx()->settings[getCtx()->id("place")] = 1;
 
     archInfoToAttributes();
-    return true;
+    return retVal;
 }
 
 bool Arch::route()
@@ -603,7 +680,6 @@ bool Arch::route()
     setupWireLocations();
     route_ecp5_globals(getCtx());
     assignArchInfo();
-    assign_budget(getCtx(), true);
 
     bool result;
     if (router == "router1") {
@@ -622,10 +698,91 @@ bool Arch::route()
 
 // -----------------------------------------------------------------------
 
+std::array<int32_t, 4> Arch::getPipDecalEnds(PipId pip) const
+{
+    WireId src = getPipSrcWire(pip), dst = getPipDstWire(pip);
+    return {{locInfo(src)->wire_data[src.index].type, locInfo(src)->wire_data[src.index].tile_wire,
+             locInfo(dst)->wire_data[dst.index].type, locInfo(dst)->wire_data[dst.index].tile_wire}};
+}
+
+const Arch::TileDecals &Arch::getTileDecals(Location loc) const
+{
+    int w = chip_info->width, h = chip_info->height;
+    int tile = loc.y * w + loc.x;
+    const TileDecals *decals = tile_decals[tile].load(std::memory_order_acquire);
+    if (decals != nullptr)
+        return *decals;
+
+#ifndef NPNR_DISABLE_THREADS
+    std::lock_guard<std::mutex> lock(tile_decal_mutex);
+#endif
+    int loc_type = chip_info->location_type[tile];
+    const LocationTypePOD &loc_data = chip_info->locations[loc_type];
+    if (decal_edge_band == -1) {
+        // The graphics test for tiles up to 4 from an edge, including the tiles at the other ends of pips
+        int max_rel = 0;
+        for (auto &lt : chip_info->locations)
+            for (auto &pd : lt.pip_data)
+                max_rel = std::max({max_rel, std::abs(pd.rel_src_loc.x), std::abs(pd.rel_src_loc.y),
+                                    std::abs(pd.rel_dst_loc.x), std::abs(pd.rel_dst_loc.y)});
+        decal_edge_band = 4 + max_rel;
+    }
+    int band = decal_edge_band, classes = 2 * band + 9;
+    auto pos_class = [&](int pos, int size) {
+        if (pos < band)
+            return pos;
+        if (pos >= size - band)
+            return band + (size - 1 - pos);
+        return 2 * band + pos % 9;
+    };
+    int64_t key = (int64_t(loc_type) * classes + pos_class(loc.x, w)) * classes + pos_class(loc.y, h);
+    auto &entry = tile_decal_classes[key];
+    if (!entry) {
+        entry.reset(new TileDecals);
+        entry->x = loc.x;
+        entry->y = loc.y;
+        entry->wires.resize(loc_data.wire_data.size());
+        for (int i = 0; i < int(loc_data.wire_data.size()); i++) {
+            WireId wire;
+            wire.location = loc;
+            wire.index = i;
+            gfxTileWire(entry->wires[i], loc.x, loc.y, w, h, getWireType(wire),
+                        GfxTileWireId(loc_data.wire_data[i].tile_wire), GraphicElement::STYLE_INACTIVE);
+        }
+        entry->pips.resize(loc_data.pip_data.size());
+        entry->pip_ends.resize(loc_data.pip_data.size());
+        for (int i = 0; i < int(loc_data.pip_data.size()); i++) {
+            PipId pip;
+            pip.location = loc;
+            pip.index = i;
+            WireId src = getPipSrcWire(pip), dst = getPipDstWire(pip);
+            auto &ends = entry->pip_ends[i] = getPipDecalEnds(pip);
+            gfxTilePip(entry->pips[i], loc.x, loc.y, w, h, src, getWireType(src), GfxTileWireId(ends[1]), dst,
+                       getWireType(dst), GfxTileWireId(ends[3]), GraphicElement::STYLE_INACTIVE);
+        }
+    }
+    tile_decals[tile].store(entry.get(), std::memory_order_release);
+    return *entry;
+}
+
 std::vector<GraphicElement> Arch::getDecalGraphics(DecalId decal) const
 {
     std::vector<GraphicElement> ret;
 
+    // Copy graphics drawn at another tile of the same class, moving them to this one
+    auto translate = [&](const std::vector<GraphicElement> &graphics, const TileDecals &decals,
+                         GraphicElement::style_t style) {
+        float dx = decal.location.x - decals.x, dy = decal.location.y - decals.y;
+        ret = graphics;
+        for (auto &el : ret) {
+            el.x1 += dx;
+            el.x2 += dx;
+            el.y1 += dy;
+            el.y2 += dy;
+            el.style = style;
+        }
+    };
+
     if (decal.type == DecalId::TYPE_GROUP) {
         int type = decal.z;
         int x = decal.location.x;
@@ -643,28 +800,26 @@ std::vector<GraphicElement> Arch::getDecalGraphics(DecalId decal) const
             ret.push_back(el);
         }
     } else if (decal.type == DecalId::TYPE_WIRE) {
-        WireId wire;
-        wire.index = decal.z;
-        wire.location = decal.location;
-        auto wire_type = getWireType(wire);
-        int x = decal.location.x;
-        int y = decal.location.y;
         GraphicElement::style_t style = decal.active ? GraphicElement::STYLE_ACTIVE : GraphicElement::STYLE_INACTIVE;
-        GfxTileWireId tilewire = GfxTileWireId(locInfo(wire)->wire_data[wire.index].tile_wire);
-        gfxTileWire(ret, x, y, chip_info->width, chip_info->height, wire_type, tilewire, style);
+        const TileDecals &decals = getTileDecals(decal.location);
+        translate(decals.wires.at(decal.z), decals, style);
     } else if (decal.type == DecalId::TYPE_PIP) {
         PipId pip;
         pip.index = decal.z;
         pip.location = decal.location;
-        WireId src_wire = getPipSrcWire(pip);
-        WireId dst_wire = getPipDstWire(pip);
-        int x = decal.location.x;
-        int y = decal.location.y;
-        GfxTileWireId src_id = GfxTileWireId(locInfo(src_wire)->wire_data[src_wire.index].tile_wire);
-        GfxTileWireId dst_id = GfxTileWireId(locInfo(dst_wire)->wire_data[dst_wire.index].tile_wire);
         GraphicElement::style_t style = decal.active ? GraphicElement::STYLE_ACTIVE : GraphicElement::STYLE_HIDDEN;
-        gfxTilePip(ret, x, y, chip_info->width, chip_info->height, src_wire, getWireType(src_wire), src_id, dst_wire,
-                   getWireType(dst_wire), dst_id, style);
+        const TileDecals &decals = getTileDecals(decal.location);
+        auto ends = getPipDecalEnds(pip);
+        if (ends == decals.pip_ends.at(pip.index)) {
+            translate(decals.pips.at(pip.index), decals, style);
+        } else {
+            // The neighbouring tiles differ from those of the tile the class was drawn for
+            WireId src_wire = getPipSrcWire(pip);
+            WireId dst_wire = getPipDstWire(pip);
+            gfxTilePip(ret, pip.location.x, pip.location.y, chip_info->width, chip_info->height, src_wire,
+                       getWireType(src_wire), GfxTileWireId(ends[1]), dst_wire, getWireType(dst_wire),
+                       GfxTileWireId(ends[3]), style);
+        }
     } else if (decal.type == DecalId::TYPE_BEL) {
         BelId bel;
         bel.index = decal.z;
@@ -722,47 +877,111 @@ DecalXY Arch::getGroupDecal(GroupId group) const
 
 // -----------------------------------------------------------------------
 
-bool Arch::getDelayFromTimingDatabase(IdString tctype, IdString from, IdString to, DelayInfo &delay) const
+void Arch::setupCellTimingLookup()
 {
-    auto fnd_dk = celldelay_cache.find({tctype, from, to});
-    if (fnd_dk != celldelay_cache.end()) {
-        delay = fnd_dk->second.second;
-        return fnd_dk->second.first;
-    }
     for (auto &tc : speed_grade->cell_timings) {
-        if (tc.cell_type == tctype.index) {
-            for (auto &dly : tc.prop_delays) {
-                if (dly.from_port == from.index && dly.to_port == to.index) {
-                    delay.max_delay = dly.max_delay;
-                    delay.min_delay = dly.min_delay;
-                    celldelay_cache[{tctype, from, to}] = std::make_pair(true, delay);
-                    return true;
-                }
-            }
-            celldelay_cache[{tctype, from, to}] = std::make_pair(false, DelayInfo());
-            return false;
+        if (tc.cell_type >= int(cell_timing_lookup.size()))
+            cell_timing_lookup.resize(tc.cell_type + 1);
+        CellTimingLookup &lookup = cell_timing_lookup[tc.cell_type];
+        // Only the first entry for a type is used, as with a search of the database
+        if (lookup.present)
+            continue;
+        lookup.present = true;
+        auto add_port = [&](int32_t port) {
+            if (port >= int(lookup.port_index.size()))
+                lookup.port_index.resize(port + 1, -1);
+            if (lookup.port_index[port] == -1)
+                lookup.port_index[port] = lookup.num_ports++;
+        };
+        for (auto &dly : tc.prop_delays) {
+            add_port(dly.from_port);
+            add_port(dly.to_port);
+        }
+        for (auto &sh : tc.setup_holds) {
+            add_port(sh.clock_port);
+            add_port(sh.sig_port);
+        }
+        int n = lookup.num_ports;
+        lookup.prop_delays.resize(n * n, nullptr);
+        lookup.setup_holds.resize(n * n, nullptr);
+        for (auto &dly : tc.prop_delays) {
+            auto &entry = lookup.prop_delays[lookup.port_index[dly.from_port] * n + lookup.port_index[dly.to_port]];
+            if (entry == nullptr)
+                entry = &dly;
+        }
+        for (auto &sh : tc.setup_holds) {
+            auto &entry = lookup.setup_holds[lookup.port_index[sh.clock_port] * n + lookup.port_index[sh.sig_port]];
+            if (entry == nullptr)
+                entry = &sh;
         }
     }
-    NPNR_ASSERT_FALSE("failed to find timing cell in db");
 }
 
-void Arch::getSetupHoldFromTimingDatabase(IdString tctype, IdString clock, IdString port, DelayInfo &setup,
-                                          DelayInfo &hold) const
+void Arch::setupWireTypeReach()
 {
-    for (auto &tc : speed_grade->cell_timings) {
-        if (tc.cell_type == tctype.index) {
-            for (auto &sh : tc.setup_holds) {
-                if (sh.clock_port == clock.index && sh.sig_port == port.index) {
-                    setup.max_delay = sh.max_setup;
-                    setup.min_delay = sh.min_setup;
-                    hold.max_delay = sh.max_hold;
-                    hold.min_delay = sh.min_hold;
-                    return;
-                }
+    for (auto &loc : chip_info->locations) {
+        for (auto &wire : loc.wire_data) {
+            if (wire.type >= int(wire_type_reach.size()))
+                wire_type_reach.resize(wire.type + 1, std::make_pair(0, 0));
+            auto &reach = wire_type_reach[wire.type];
+            for (auto &pip : wire.pips_uphill) {
+                reach.first = std::max(reach.first, std::abs(int(pip.rel_loc.x)));
+                reach.second = std::max(reach.second, std::abs(int(pip.rel_loc.y)));
+            }
+            for (auto &pip : wire.pips_downhill) {
+                reach.first = std::max(reach.first, std::abs(int(pip.rel_loc.x)));
+                reach.second = std::max(reach.second, std::abs(int(pip.rel_loc.y)));
             }
         }
     }
-    NPNR_ASSERT_FALSE("failed to find timing cell in db");
+    // Global and other special wires can span much of the device; general routing can always be used to get from
+    // them to a box sized for the longest general routing wires
+    int max_reach_x = 0, max_reach_y = 0;
+    for (IdString type : {id_WIRE_TYPE_H00, id_WIRE_TYPE_H01, id_WIRE_TYPE_H02, id_WIRE_TYPE_H06, id_WIRE_TYPE_V00,
+                          id_WIRE_TYPE_V01, id_WIRE_TYPE_V02, id_WIRE_TYPE_V06}) {
+        if (type.index >= int(wire_type_reach.size()))
+            continue;
+        max_reach_x = std::max(max_reach_x, wire_type_reach[type.index].first);
+        max_reach_y = std::max(max_reach_y, wire_type_reach[type.index].second);
+    }
+    for (auto &reach : wire_type_reach) {
+        reach.first = std::min(reach.first, max_reach_x);
+        reach.second = std::min(reach.second, max_reach_y);
+    }
+}
+
+bool Arch::getDelayFromTimingDatabase(IdString tctype, IdString from, IdString to, DelayInfo &delay) const
+{
+    NPNR_ASSERT(tctype.index >= 0 && tctype.index < int(cell_timing_lookup.size()));
+    const CellTimingLookup &lookup = cell_timing_lookup[tctype.index];
+    if (!lookup.present)
+        NPNR_ASSERT_FALSE("failed to find timing cell in db");
+    int from_idx = lookup.port(from), to_idx = lookup.port(to);
+    if (from_idx == -1 || to_idx == -1)
+        return false;
+    const CellPropDelayPOD *dly = lookup.prop_delays[from_idx * lookup.num_ports + to_idx];
+    if (dly == nullptr)
+        return false;
+    delay.max_delay = dly->max_delay;
+    delay.min_delay = dly->min_delay;
+    return true;
+}
+
+void Arch::getSetupHoldFromTimingDatabase(IdString tctype, IdString clock, IdString port, DelayInfo &setup,
+                                          DelayInfo &hold) const
+{
+    NPNR_ASSERT(tctype.index >= 0 && tctype.index < int(cell_timing_lookup.size()));
+    const CellTimingLookup &lookup = cell_timing_lookup[tctype.index];
+    int clock_idx = lookup.port(clock), port_idx = lookup.port(port);
+    const CellSetupHoldPOD *sh = nullptr;
+    if (clock_idx != -1 && port_idx != -1)
+        sh = lookup.setup_holds[clock_idx * lookup.num_ports + port_idx];
+    if (sh == nullptr)
+        NPNR_ASSERT_FALSE("failed to find timing cell in db");
+    setup.max_delay = sh->max_setup;
+    setup.min_delay = sh->min_setup;
+    hold.max_delay = sh->max_hold;
+    hold.min_delay = sh->min_hold;
 }
 
 bool Arch::getCellDelay(const CellInfo *cell, IdString fromPort, IdString toPort, DelayInfo &delay) const
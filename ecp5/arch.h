@@ -22,6 +22,7 @@
 #error Include "arch.h" via "nextpnr.h" only.
 #endif
 
+#include <array>
 #include <set>
 #include <sstream>
 
@@ -411,44 +412,40 @@ struct ArchArgs
     } speed = SPEED_6;
 };
 
-struct DelayKey
-{
-    IdString celltype, from, to;
-    inline bool operator==(const DelayKey &other) const
-    {
-        return celltype == other.celltype && from == other.from && to == other.to;
-    }
-};
-
-NEXTPNR_NAMESPACE_END
-namespace std {
-template <> struct hash<NEXTPNR_NAMESPACE_PREFIX DelayKey>
-{
-    std::size_t operator()(const NEXTPNR_NAMESPACE_PREFIX DelayKey &dk) const noexcept
-    {
-        std::size_t seed = std::hash<NEXTPNR_NAMESPACE_PREFIX IdString>()(dk.celltype);
-        seed ^= std::hash<NEXTPNR_NAMESPACE_PREFIX IdString>()(dk.from) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-        seed ^= std::hash<NEXTPNR_NAMESPACE_PREFIX IdString>()(dk.to) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-        return seed;
-    }
-};
-} // namespace std
-NEXTPNR_NAMESPACE_BEGIN
-
 struct Arch : BaseCtx
 {
     const ChipInfoPOD *chip_info;
     const PackageInfoPOD *package_info;
     const SpeedGradePOD *speed_grade;
+    // Index into package_info->pin_data of each pin by name, and of the pin of each bel (by flat index) or -1
+    std::unordered_map<std::string, int> package_pin_by_name;
+    std::vector<int> bel_package_pin;
 
     mutable std::unordered_map<IdString, BelId> bel_by_name;
     mutable std::unordered_map<IdString, WireId> wire_by_name;
     mutable std::unordered_map<IdString, PipId> pip_by_name;
 
     std::vector<CellInfo *> bel_to_cell;
-    std::unordered_map<WireId, NetInfo *> wire_to_net;
-    std::unordered_map<PipId, NetInfo *> pip_to_net;
-    std::unordered_map<WireId, int> wire_fanout;
+    // Indexed by getWireFlatIndex and getPipFlatIndex
+    std::vector<NetInfo *> wire_to_net;
+    std::vector<NetInfo *> pip_to_net;
+    std::vector<int> wire_fanout;
+    // Flat index of the first wire and pip of each tile, counting through the tiles in order
+    std::vector<int> tile_wire_base, tile_pip_base;
+
+    // Summary of the flipflop control sets used by the slices bound in each tile, kept up to date by bindBel and
+    // unbindBel so that slice validity checks need not visit the other cells of the tile
+    struct SliceTileState
+    {
+        int dffs = 0;
+        // Set if the flipflops of the tile disagree on their clock, LSR or the muxes and mode for them
+        bool conflict = false;
+        IdString clk_sig, lsr_sig, clkmux, lsrmux, srmode;
+
+        void add(const CellInfo *cell);
+        bool valid() const { return !conflict; }
+    };
+    std::vector<SliceTileState> slice_tiles;
 
     ArchArgs args;
     Arch(ArchArgs args);
@@ -491,17 +488,31 @@ struct Arch : BaseCtx
 
     uint32_t getBelChecksum(BelId bel) const { return bel.index; }
 
+    int getBelTileIndex(BelId bel) const { return bel.location.y * chip_info->width + bel.location.x; }
+
     int getBelFlatIndex(BelId bel) const
     {
         return (bel.location.y * chip_info->width + bel.location.x) * max_loc_bels + bel.index;
     }
 
+    int getWireFlatIndex(WireId wire) const
+    {
+        return tile_wire_base[wire.location.y * chip_info->width + wire.location.x] + wire.index;
+    }
+
+    int getPipFlatIndex(PipId pip) const
+    {
+        return tile_pip_base[pip.location.y * chip_info->width + pip.location.x] + pip.index;
+    }
+
     void bindBel(BelId bel, CellInfo *cell, PlaceStrength strength)
     {
         NPNR_ASSERT(bel != BelId());
         int idx = getBelFlatIndex(bel);
         NPNR_ASSERT(bel_to_cell.at(idx) == nullptr);
         bel_to_cell[idx] = cell;
+        if (cell->type == id_TRELLIS_SLICE)
+            slice_tiles[getBelTileIndex(bel)].add(cell);
         cell->bel = bel;
         cell->belStrength = strength;
         refreshUiBel(bel);
@@ -512,9 +523,13 @@ struct Arch : BaseCtx
         NPNR_ASSERT(bel != BelId());
         int idx = getBelFlatIndex(bel);
         NPNR_ASSERT(bel_to_cell.at(idx) != nullptr);
-        bel_to_cell[idx]->bel = BelId();
-        bel_to_cell[idx]->belStrength = STRENGTH_NONE;
+        CellInfo *cell = bel_to_cell[idx];
+        cell->bel = BelId();
+        cell->belStrength = STRENGTH_NONE;
         bel_to_cell[idx] = nullptr;
+        // Removing a flipflop may resolve a conflict or change the control set of the tile, so recompute
+        if (cell->type == id_TRELLIS_SLICE && cell->sliceInfo.using_dff)
+            refreshSliceTile(bel);
         refreshUiBel(bel);
     }
 
@@ -621,46 +636,47 @@ struct Arch : BaseCtx
     void bindWire(WireId wire, NetInfo *net, PlaceStrength strength)
     {
         NPNR_ASSERT(wire != WireId());
-        NPNR_ASSERT(wire_to_net[wire] == nullptr);
-        wire_to_net[wire] = net;
+        NetInfo *&bound = wire_to_net[getWireFlatIndex(wire)];
+        NPNR_ASSERT(bound == nullptr);
+        bound = net;
         net->wires[wire].pip = PipId();
         net->wires[wire].strength = strength;
+        net->wire_delays.clear();
         refreshUiWire(wire);
     }
 
     void unbindWire(WireId wire)
     {
         NPNR_ASSERT(wire != WireId());
-        NPNR_ASSERT(wire_to_net[wire] != nullptr);
+        NetInfo *&bound = wire_to_net[getWireFlatIndex(wire)];
+        NPNR_ASSERT(bound != nullptr);
 
-        auto &net_wires = wire_to_net[wire]->wires;
+        auto &net_wires = bound->wires;
         auto it = net_wires.find(wire);
         NPNR_ASSERT(it != net_wires.end());
 
         auto pip = it->second.pip;
         if (pip != PipId()) {
-            wire_fanout[getPipSrcWire(pip)]--;
-            pip_to_net[pip] = nullptr;
+            wire_fanout[getWireFlatIndex(getPipSrcWire(pip))]--;
+            pip_to_net[getPipFlatIndex(pip)] = nullptr;
         }
 
         net_wires.erase(it);
-        wire_to_net[wire] = nullptr;
+        bound->wire_delays.clear();
+        bound = nullptr;
         refreshUiWire(wire);
     }
 
     bool checkWireAvail(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        return wire_to_net.find(wire) == wire_to_net.end() || wire_to_net.at(wire) == nullptr;
+        return wire_to_net[getWireFlatIndex(wire)] == nullptr;
     }
 
     NetInfo *getBoundWireNet(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        if (wire_to_net.find(wire) == wire_to_net.end())
-            return nullptr;
-        else
-            return wire_to_net.at(wire);
+        return wire_to_net[getWireFlatIndex(wire)];
     }
 
     WireId getConflictingWireWire(WireId wire) const { return wire; }
@@ -668,10 +684,7 @@ struct Arch : BaseCtx
     NetInfo *getConflictingWireNet(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        if (wire_to_net.find(wire) == wire_to_net.end())
-            return nullptr;
-        else
-            return wire_to_net.at(wire);
+        return wire_to_net[getWireFlatIndex(wire)];
     }
 
     DelayInfo getWireDelay(WireId wire) const
@@ -728,49 +741,52 @@ struct Arch : BaseCtx
     void bindPip(PipId pip, NetInfo *net, PlaceStrength strength)
     {
         NPNR_ASSERT(pip != PipId());
-        NPNR_ASSERT(pip_to_net[pip] == nullptr);
+        NetInfo *&bound = pip_to_net[getPipFlatIndex(pip)];
+        NPNR_ASSERT(bound == nullptr);
 
-        pip_to_net[pip] = net;
-        wire_fanout[getPipSrcWire(pip)]++;
+        bound = net;
+        wire_fanout[getWireFlatIndex(getPipSrcWire(pip))]++;
 
         WireId dst;
         dst.index = locInfo(pip)->pip_data[pip.index].dst_idx;
         dst.location = pip.location + locInfo(pip)->pip_data[pip.index].rel_dst_loc;
-        NPNR_ASSERT(wire_to_net[dst] == nullptr);
-        wire_to_net[dst] = net;
+        NetInfo *&dst_bound = wire_to_net[getWireFlatIndex(dst)];
+        NPNR_ASSERT(dst_bound == nullptr);
+        dst_bound = net;
         net->wires[dst].pip = pip;
         net->wires[dst].strength = strength;
+        net->wire_delays.clear();
     }
 
     void unbindPip(PipId pip)
     {
         NPNR_ASSERT(pip != PipId());
-        NPNR_ASSERT(pip_to_net[pip] != nullptr);
-        wire_fanout[getPipSrcWire(pip)]--;
+        NetInfo *&bound = pip_to_net[getPipFlatIndex(pip)];
+        NPNR_ASSERT(bound != nullptr);
+        wire_fanout[getWireFlatIndex(getPipSrcWire(pip))]--;
 
         WireId dst;
         dst.index = locInfo(pip)->pip_data[pip.index].dst_idx;
         dst.location = pip.location + locInfo(pip)->pip_data[pip.index].rel_dst_loc;
-        NPNR_ASSERT(wire_to_net[dst] != nullptr);
-        wire_to_net[dst] = nullptr;
-        pip_to_net[pip]->wires.erase(dst);
+        NetInfo *&dst_bound = wire_to_net[getWireFlatIndex(dst)];
+        NPNR_ASSERT(dst_bound != nullptr);
+        dst_bound = nullptr;
+        bound->wires.erase(dst);
+        bound->wire_delays.clear();
 
-        pip_to_net[pip] = nullptr;
+        bound = nullptr;
     }
 
     bool checkPipAvail(PipId pip) const
     {
         NPNR_ASSERT(pip != PipId());
-        return pip_to_net.find(pip) == pip_to_net.end() || pip_to_net.at(pip) == nullptr;
+        return pip_to_net[getPipFlatIndex(pip)] == nullptr;
     }
 
     NetInfo *getBoundPipNet(PipId pip) const
     {
         NPNR_ASSERT(pip != PipId());
-        if (pip_to_net.find(pip) == pip_to_net.end())
-            return nullptr;
-        else
-            return pip_to_net.at(pip);
+        return pip_to_net[getPipFlatIndex(pip)];
     }
 
     WireId getConflictingPipWire(PipId pip) const { return WireId(); }
@@ -778,10 +794,7 @@ struct Arch : BaseCtx
     NetInfo *getConflictingPipNet(PipId pip) const
     {
         NPNR_ASSERT(pip != PipId());
-        if (pip_to_net.find(pip) == pip_to_net.end())
-            return nullptr;
-        else
-            return pip_to_net.at(pip);
+        return pip_to_net[getPipFlatIndex(pip)];
     }
 
     AllPipRange getPips() const
@@ -819,10 +832,7 @@ struct Arch : BaseCtx
     {
         DelayInfo delay;
         NPNR_ASSERT(pip != PipId());
-        int fanout = 0;
-        auto fnd_fanout = wire_fanout.find(getPipSrcWire(pip));
-        if (fnd_fanout != wire_fanout.end())
-            fanout = fnd_fanout->second;
+        int fanout = wire_fanout[getWireFlatIndex(getPipSrcWire(pip))];
         delay.min_delay =
                 speed_grade->pip_classes[locInfo(pip)->pip_data[pip.index].timing_class].min_base_delay +
                 fanout * speed_grade->pip_classes[locInfo(pip)->pip_data[pip.index].timing_class].min_fanout_adder;
@@ -904,6 +914,12 @@ struct Arch : BaseCtx
     delay_t estimateDelay(WireId src, WireId dst) const;
     ArcBounds getRouteBoundingBox(WireId src, WireId dst) const;
     delay_t predictDelay(const NetInfo *net_info, const PortRef &sink) const;
+    // predictDelay only depends on the cell types and ports of the arc, and the distance between the bels when they
+    // are in different tiles; so PredictDelayCache may memoise it
+    static const bool predictDelayCacheable = true;
+    int getPredictDelayClass(const NetInfo *net_info, const PortRef &sink) const { return 0; }
+    // WireId and PipId are plain indices into the chipdb, so a flattened routing graph can be cached on disk
+    static const bool routeGraphCacheable = true;
     delay_t getDelayEpsilon() const { return 20; }
     delay_t getRipupDelayPenalty() const;
     float getDelayNS(delay_t v) const { return v * 0.001; }
@@ -932,6 +948,28 @@ struct Arch : BaseCtx
     DecalXY getPipDecal(PipId pip) const;
     DecalXY getGroupDecal(GroupId group) const;
 
+    // Graphics of the wires and pips of a tile, as drawn at tile (x, y). They only depend on the location type and on
+    // the position of the tile relative to the device edges and modulo 9 (the pitch of the length 6 wires), so they
+    // are computed once for the first tile of each such class that is drawn, and translated for the others
+    struct TileDecals
+    {
+        int x, y;
+        std::vector<std::vector<GraphicElement>> wires, pips;
+        // Type and tile wire of the source and destination of each pip, which also depend on the neighbouring tiles
+        std::vector<std::array<int32_t, 4>> pip_ends;
+    };
+    // Indexed by tile; filled in as tiles are first drawn
+    mutable std::vector<std::atomic<const TileDecals *>> tile_decals;
+    mutable std::unordered_map<int64_t, std::unique_ptr<TileDecals>> tile_decal_classes;
+#ifndef NPNR_DISABLE_THREADS
+    mutable std::mutex tile_decal_mutex;
+#endif
+    // Distance from the device edges within which a tile's exact position affects its graphics
+    mutable int decal_edge_band = -1;
+
+    const TileDecals &getTileDecals(Location loc) const;
+    std::array<int32_t, 4> getPipDecalEnds(PipId pip) const;
+
     // -------------------------------------------------
 
     // Get the delay through a cell from one port to another, returning false
@@ -952,11 +990,14 @@ struct Arch : BaseCtx
     // Placement validity checks
     bool isValidBelForCell(CellInfo *cell, BelId bel) const;
     bool isBelLocationValid(BelId bel) const;
+    // As isBelLocationValid, but as if each Bel in overlay were bound to the given cell (or unbound, for nullptr)
+    // instead. Only Bels in the same tile as bel are looked up in overlay
+    bool isBelLocationValidWith(BelId bel, const std::unordered_map<BelId, CellInfo *> &overlay) const;
 
     int scoreBelForCell(CellInfo *cell, BelId bel) const;
 
-    // Helper function for above
-    bool slicesCompatible(const std::vector<const CellInfo *> &cells) const;
+    // Recompute the entry of slice_tiles for the tile of a Bel from the cells bound there
+    void refreshSliceTile(BelId bel);
 
     void assignArchInfo();
 
@@ -1015,10 +1056,33 @@ struct Arch : BaseCtx
     // Improves directivity of routing to DSP inputs, avoids issues
     // with different routes to the same physical reset wire causing
     // conflicts and slow routing
-    std::unordered_map<WireId, std::pair<int, int>> wire_loc_overrides;
+    FlatHashMap<WireId, std::pair<int, int>> wire_loc_overrides;
     void setupWireLocations();
 
-    mutable std::unordered_map<DelayKey, std::pair<bool, DelayInfo>> celldelay_cache;
+    // Dense lookup of the timing database for a cell timing type, so that cell delay queries are array reads
+    struct CellTimingLookup
+    {
+        // Local index of each port named in the database for this type, indexed by IdString index; -1 if unused
+        std::vector<int> port_index;
+        int num_ports = 0;
+        bool present = false;
+        // num_ports * num_ports entries indexed by from (or clock) port then to (or signal) port; nullptr if no arc
+        std::vector<const CellPropDelayPOD *> prop_delays;
+        std::vector<const CellSetupHoldPOD *> setup_holds;
+
+        int port(IdString name) const
+        {
+            return (name.index >= 0 && name.index < int(port_index.size())) ? port_index[name.index] : -1;
+        }
+    };
+    // Indexed by the IdString index of the cell timing type; entries for types not in the database are empty
+    std::vector<CellTimingLookup> cell_timing_lookup;
+    void setupCellTimingLookup();
+
+    // Furthest a wire of each type reaches from its own location to any of its pips, in tiles along x and y. Indexed
+    // by the IdString index of the wire type, and capped at the reach of the longest general routing wires
+    std::vector<std::pair<int, int>> wire_type_reach;
+    void setupWireTypeReach();
 
     static const std::string defaultPlacer;
     static const std::vector<std::string> availablePlacers;
@@ -33,55 +33,75 @@ inline NetInfo *port_or_nullptr(const CellInfo *cell, IdString name)
     return found->second.net;
 }
 
-bool Arch::slicesCompatible(const std::vector<const CellInfo *> &cells) const
+// Adding cells in any order gives the same result, as any flipflop whose control set differs from the first is a
+// conflict anyway
+void Arch::SliceTileState::add(const CellInfo *cell)
 {
     // TODO: allow different LSR/CLK and MUX/SRMODE settings once
     // routing details are worked out
-    IdString clk_sig, lsr_sig;
-    IdString CLKMUX, LSRMUX, SRMODE;
-    bool first = true;
-    for (auto cell : cells) {
-        if (cell->sliceInfo.using_dff) {
-            if (first) {
-                clk_sig = cell->sliceInfo.clk_sig;
-                lsr_sig = cell->sliceInfo.lsr_sig;
-                CLKMUX = cell->sliceInfo.clkmux;
-                LSRMUX = cell->sliceInfo.lsrmux;
-                SRMODE = cell->sliceInfo.srmode;
-            } else {
-                if (cell->sliceInfo.clk_sig != clk_sig)
-                    return false;
-                if (cell->sliceInfo.lsr_sig != lsr_sig)
-                    return false;
-                if (cell->sliceInfo.clkmux != CLKMUX)
-                    return false;
-                if (cell->sliceInfo.lsrmux != LSRMUX)
-                    return false;
-                if (cell->sliceInfo.srmode != SRMODE)
-                    return false;
-            }
-            first = false;
-        }
+    if (!cell->sliceInfo.using_dff)
+        return;
+    if (dffs == 0) {
+        clk_sig = cell->sliceInfo.clk_sig;
+        lsr_sig = cell->sliceInfo.lsr_sig;
+        clkmux = cell->sliceInfo.clkmux;
+        lsrmux = cell->sliceInfo.lsrmux;
+        srmode = cell->sliceInfo.srmode;
+    } else if (cell->sliceInfo.clk_sig != clk_sig || cell->sliceInfo.lsr_sig != lsr_sig ||
+               cell->sliceInfo.clkmux != clkmux || cell->sliceInfo.lsrmux != lsrmux ||
+               cell->sliceInfo.srmode != srmode) {
+        conflict = true;
+    }
+    dffs++;
+}
+
+void Arch::refreshSliceTile(BelId bel)
+{
+    SliceTileState &state = slice_tiles[getBelTileIndex(bel)];
+    state = SliceTileState();
+    for (auto bel_other : getBelsByTile(bel.location.x, bel.location.y)) {
+        CellInfo *cell_other = getBoundBelCell(bel_other);
+        if (cell_other != nullptr && cell_other->type == id_TRELLIS_SLICE)
+            state.add(cell_other);
     }
-    return true;
 }
 
 bool Arch::isBelLocationValid(BelId bel) const
 {
     if (getBelType(bel) == id_TRELLIS_SLICE) {
-        std::vector<const CellInfo *> bel_cells;
+        CellInfo *cell = getBoundBelCell(bel);
+        if (cell != nullptr && cell->sliceInfo.has_l6mux && ((getBelLocation(bel).z % 2) == 1))
+            return false;
+        return slice_tiles[getBelTileIndex(bel)].valid();
+    } else {
+        CellInfo *cell = getBoundBelCell(bel);
+        if (cell == nullptr)
+            return true;
+        else
+            return isValidBelForCell(cell, bel);
+    }
+}
+
+bool Arch::isBelLocationValidWith(BelId bel, const std::unordered_map<BelId, CellInfo *> &overlay) const
+{
+    auto bound_cell = [&](BelId b) {
+        auto found = overlay.find(b);
+        return found != overlay.end() ? found->second : getBoundBelCell(b);
+    };
+    if (getBelType(bel) == id_TRELLIS_SLICE) {
         Loc bel_loc = getBelLocation(bel);
+        CellInfo *cell = bound_cell(bel);
+        if (cell != nullptr && cell->sliceInfo.has_l6mux && ((bel_loc.z % 2) == 1))
+            return false;
+        SliceTileState state;
         for (auto bel_other : getBelsByTile(bel_loc.x, bel_loc.y)) {
-            CellInfo *cell_other = getBoundBelCell(bel_other);
-            if (cell_other != nullptr) {
-                bel_cells.push_back(cell_other);
-            }
+            CellInfo *cell_other = bound_cell(bel_other);
+            if (cell_other != nullptr && cell_other->type == id_TRELLIS_SLICE)
+                state.add(cell_other);
         }
-        if (getBoundBelCell(bel) != nullptr && getBoundBelCell(bel)->sliceInfo.has_l6mux && ((bel_loc.z % 2) == 1))
-            return false;
-        return slicesCompatible(bel_cells);
+        return state.valid();
     } else {
-        CellInfo *cell = getBoundBelCell(bel);
+        CellInfo *cell = bound_cell(bel);
         if (cell == nullptr)
             return true;
         else
@@ -94,21 +114,26 @@ bool Arch::isValidBelForCell(CellInfo *cell, BelId bel) const
     if (cell->type == id_TRELLIS_SLICE) {
         NPNR_ASSERT(getBelType(bel) == id_TRELLIS_SLICE);
 
-        std::vector<const CellInfo *> bel_cells;
         Loc bel_loc = getBelLocation(bel);
 
         if (cell->sliceInfo.has_l6mux && ((bel_loc.z % 2) == 1))
             return false;
 
+        if (getBoundBelCell(bel) == nullptr) {
+            // The common case of trying a cell in a free Bel only needs the cell adding to the tile summary
+            SliceTileState state = slice_tiles[getBelTileIndex(bel)];
+            state.add(cell);
+            return state.valid();
+        }
+
+        SliceTileState state;
         for (auto bel_other : getBelsByTile(bel_loc.x, bel_loc.y)) {
             CellInfo *cell_other = getBoundBelCell(bel_other);
-            if (cell_other != nullptr && bel_other != bel) {
-                bel_cells.push_back(cell_other);
-            }
+            if (cell_other != nullptr && bel_other != bel && cell_other->type == id_TRELLIS_SLICE)
+                state.add(cell_other);
         }
-
-        bel_cells.push_back(cell);
-        return slicesCompatible(bel_cells);
+        state.add(cell);
+        return state.valid();
     } else if (cell->type == id_DCUA || cell->type == id_EXTREFB || cell->type == id_PCSCLKDIV) {
         return args.type != ArchArgs::LFE5U_25F && args.type != ArchArgs::LFE5U_45F && args.type != ArchArgs::LFE5U_85F;
     } else {
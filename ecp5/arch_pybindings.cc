@@ -40,9 +40,9 @@ void arch_wrap_python(py::module &m)
     auto arch_cls = py::class_<Arch, BaseCtx>(m, "Arch").def(py::init<ArchArgs>());
     auto ctx_cls = py::class_<Context, Arch>(m, "Context")
                            .def("checksum", &Context::checksum)
-                           .def("pack", &Context::pack)
-                           .def("place", &Context::place)
-                           .def("route", &Context::route);
+                           .def("pack", &Context::pack, release_gil())
+                           .def("place", &Context::place, release_gil())
+                           .def("route", &Context::route, release_gil());
 
     fn_wrapper_2a<Context, decltype(&Context::isValidBelForCell), &Context::isValidBelForCell, pass_through<bool>,
                   addr_and_unwrap<CellInfo>, conv_from_str<BelId>>::def_wrap(ctx_cls, "isValidBelForCell");
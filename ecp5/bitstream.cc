@@ -22,6 +22,7 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <fstream>
 #include <iomanip>
+#include <numeric>
 #include <queue>
 #include <regex>
 #include <streambuf>
@@ -29,6 +30,7 @@
 #include "log.h"
 #include "pio.h"
 #include "util.h"
+#include "worker_pool.h"
 
 #define fmt_str(x) (static_cast<const std::ostringstream &>(std::ostringstream() << x).str())
 
@@ -569,7 +571,7 @@ static std::vector<bool> parse_config_str(const Property &p, int length)
     return word;
 }
 
-std::string intstr_or_default(const std::unordered_map<IdString, Property> &ct, const IdString &key,
+std::string intstr_or_default(const IdStringDict<Property> &ct, const IdString &key,
                               std::string def = "0")
 {
     auto found = ct.find(key);
@@ -652,23 +654,54 @@ void write_bitstream(Context *ctx, std::string base_config_file, std::string tex
             }
         }
     }
-    // Add all set, configurable pips to the config
-    for (auto pip : ctx->getPips()) {
-        if (ctx->getBoundPipNet(pip) != nullptr) {
-            if (ctx->getPipClass(pip) == 0) { // ignore fixed pips
+    // Add all set, configurable pips to the config. The tiles are split into contiguous chunks, each scanned into its
+    // own partial config; merging these in chunk order gives the same order of arcs as a single scan, so like the
+    // other output writers this uses all cores unless told otherwise
+    int threads = ctx->stage_threads("bitstream", 0);
+    int num_tiles = ctx->chip_info->width * ctx->chip_info->height;
+    int num_chunks = std::min(num_tiles, threads > 1 ? 4 * threads : 1);
+    std::vector<ChipConfig> partial_cc(num_chunks);
+    auto add_pips = [&](int chunk) {
+        ChipConfig &pcc = partial_cc.at(chunk);
+        for (int t = (num_tiles * chunk) / num_chunks; t < (num_tiles * (chunk + 1)) / num_chunks; t++) {
+            PipId pip;
+            pip.location = Location(t % ctx->chip_info->width, t / ctx->chip_info->width);
+            int num_pips = ctx->chip_info->locations[ctx->chip_info->location_type[t]].pip_data.size();
+            for (pip.index = 0; pip.index < num_pips; pip.index++) {
+                if (ctx->getBoundPipNet(pip) == nullptr || ctx->getPipClass(pip) != 0) // ignore fixed pips
+                    continue;
                 std::string source = get_trellis_wirename(ctx, pip.location, ctx->getPipSrcWire(pip));
                 if (source.find("CLKI_PLL") != std::string::npos) {
                     // Special case - must set pip in all relevant tiles
                     for (auto equiv_pip : ctx->getPipsUphill(ctx->getPipDstWire(pip))) {
                         if (ctx->getPipSrcWire(equiv_pip) == ctx->getPipSrcWire(pip))
-                            set_pip(ctx, cc, equiv_pip);
+                            set_pip(ctx, pcc, equiv_pip);
                     }
                 } else {
-                    set_pip(ctx, cc, pip);
+                    set_pip(ctx, pcc, pip);
                 }
             }
         }
+    };
+#ifndef NPNR_DISABLE_THREADS
+    if (num_chunks > 1) {
+        std::vector<int> chunks(num_chunks);
+        std::iota(chunks.begin(), chunks.end(), 0);
+        WorkerPool pool(threads);
+        pool.run(chunks, add_pips);
+    } else
+#endif
+    {
+        for (int chunk = 0; chunk < num_chunks; chunk++)
+            add_pips(chunk);
+    }
+    for (auto &pcc : partial_cc) {
+        for (auto &tile : pcc.tiles) {
+            auto &carcs = cc.tiles[tile.first].carcs;
+            carcs.insert(carcs.end(), tile.second.carcs.begin(), tile.second.carcs.end());
+        }
     }
+
     // Find bank voltages
     std::unordered_map<int, IOVoltage> bankVcc;
     std::unordered_map<int, bool> bankLvds, bankVref, bankDiff;
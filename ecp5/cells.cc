@@ -333,11 +333,10 @@ static unsigned get_dram_init(const Context *ctx, const CellInfo *ram, int bit)
 {
     auto init_prop = get_or_default(ram->params, ctx->id("INITVAL"), Property(0, 64));
     NPNR_ASSERT(!init_prop.is_string);
-    const std::string &idata = init_prop.str;
-    NPNR_ASSERT(idata.length() == 64);
+    NPNR_ASSERT(init_prop.size() == 64);
     unsigned value = 0;
     for (int i = 0; i < 16; i++) {
-        char c = idata.at(4 * i + bit);
+        char c = init_prop.get(4 * i + bit);
         if (c == '1')
             value |= (1 << i);
         else
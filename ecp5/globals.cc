@@ -19,9 +19,13 @@
 
 #include "globals.h"
 #include <algorithm>
+#include <chrono>
 #include <iomanip>
+#include <map>
 #include <queue>
+#include <tuple>
 #include "cells.h"
+#include "global_router.h"
 #include "log.h"
 #include "nextpnr.h"
 #include "place_common.h"
@@ -141,54 +145,84 @@ class Ecp5GlobalRouter
         return *(ctx->getPipsUphill(spine_wire).begin());
     }
 
-    void route_logic_tile_global(NetInfo *net, int global_index, PortRef user)
+    // Paths from a sink wire up to the HPBX global wire of its tile, kept from the first search for each type of tile,
+    // sink wire and global. Tiles of one type are routed alike, so later sinks can normally follow the path rather than
+    // search again. Pips are given relative to the sink wire, from the sink upwards.
+    std::map<std::tuple<int, int, int>, std::vector<std::pair<Location, int32_t>>> global_paths;
+
+    std::tuple<int, int, int> global_path_key(WireId sink, int global_index)
     {
-        WireId userWire = ctx->getBelPinWire(user.cell->bel, user.port);
-        WireId globalWire;
-        IdString global_name = ctx->id(fmt_str("G_HPBX" << std::setw(2) << std::setfill('0') << global_index << "00"));
-        std::queue<WireId> upstream;
-        std::unordered_map<WireId, PipId> backtrace;
-        upstream.push(userWire);
-        bool already_routed = false;
-        WireId next;
-        // Search back from the pin until we reach the global network
-        while (true) {
-            next = upstream.front();
-            upstream.pop();
+        int loc_type = ctx->chip_info->location_type[sink.location.y * ctx->chip_info->width + sink.location.x];
+        return std::make_tuple(loc_type, int(sink.index), global_index);
+    }
 
-            if (ctx->getBoundWireNet(next) == net) {
-                already_routed = true;
-                globalWire = next;
+    // Follow the stored path for a sink as far as the first target wire, binding its pips. Returns the target, or
+    // WireId() if there is no stored path or part of it is in use by another net
+    template <typename Ttgt> WireId follow_global_path(NetInfo *net, WireId sink, int global_index, Ttgt is_target)
+    {
+        auto found = global_paths.find(global_path_key(sink, global_index));
+        if (found == global_paths.end())
+            return WireId();
+        std::vector<PipId> pips;
+        WireId cursor = sink;
+        for (auto &step : found->second) {
+            if (is_target(cursor))
                 break;
-            }
+            PipId pip;
+            pip.location = Location(sink.location.x + step.first.x, sink.location.y + step.first.y);
+            pip.index = step.second;
+            if (pip.location.x < 0 || pip.location.y < 0 || pip.location.x >= ctx->chip_info->width ||
+                pip.location.y >= ctx->chip_info->height || pip.index >= int(ctx->locInfo(pip)->pip_data.size()))
+                return WireId();
+            if (ctx->getPipDstWire(pip) != cursor)
+                return WireId();
+            if (!ctx->checkPipAvail(pip) && ctx->getBoundPipNet(pip) != net)
+                return WireId();
+            WireId prev = ctx->getPipSrcWire(pip);
+            if (!is_target(prev) && !ctx->checkWireAvail(prev))
+                return WireId();
+            pips.push_back(pip);
+            cursor = prev;
+        }
+        if (!is_target(cursor))
+            return WireId();
+        for (auto pip : pips)
+            ctx->bindPip(pip, net, STRENGTH_LOCKED);
+        return cursor;
+    }
 
-            if (ctx->getWireBasename(next) == global_name) {
-                globalWire = next;
-                break;
-            }
-            if (ctx->checkWireAvail(next)) {
-                for (auto pip : ctx->getPipsUphill(next)) {
-                    WireId src = ctx->getPipSrcWire(pip);
-                    if (backtrace.count(src))
-                        continue;
-                    backtrace[src] = pip;
-                    upstream.push(src);
-                }
-            }
-            if (upstream.size() > 30000) {
+    // Store the routing of a sink that was searched all the way to the global wire
+    void store_global_path(NetInfo *net, WireId sink, WireId global, int global_index)
+    {
+        std::vector<std::pair<Location, int32_t>> path;
+        for (WireId cursor = sink; cursor != global;) {
+            PipId pip = net->wires.at(cursor).pip;
+            path.emplace_back(Location(pip.location.x - sink.location.x, pip.location.y - sink.location.y),
+                              pip.index);
+            cursor = ctx->getPipSrcWire(pip);
+        }
+        global_paths[global_path_key(sink, global_index)] = path;
+    }
+
+    void route_logic_tile_global(NetInfo *net, int global_index, PortRef user)
+    {
+        WireId userWire = ctx->getBelPinWire(user.cell->bel, user.port);
+        IdString global_name = ctx->id(fmt_str("G_HPBX" << std::setw(2) << std::setfill('0') << global_index << "00"));
+        // Search back from the pin until we reach the global network, or the routing of the net into this tile
+        // for an earlier sink
+        auto is_target = [&](WireId wire) {
+            return ctx->getBoundWireNet(wire) == net || ctx->getWireBasename(wire) == global_name;
+        };
+        WireId next = follow_global_path(net, userWire, global_index, is_target);
+        if (next == WireId()) {
+            next = route_to_global_tree(ctx, net, userWire, 30000, is_target, [](PipId) { return true; });
+            if (next == WireId())
                 log_error("failed to route HPBX%02d00 to %s.%s\n", global_index,
                           ctx->getBelName(user.cell->bel).c_str(ctx), user.port.c_str(ctx));
-            }
-        }
-        // Set all the pips we found along the way
-        WireId cursor = next;
-        while (true) {
-            auto fnd = backtrace.find(cursor);
-            if (fnd == backtrace.end())
-                break;
-            ctx->bindPip(fnd->second, net, STRENGTH_LOCKED);
-            cursor = ctx->getPipDstWire(fnd->second);
+            if (ctx->getBoundWireNet(next) != net && next != userWire)
+                store_global_path(net, userWire, next, global_index);
         }
+        bool already_routed = ctx->getBoundWireNet(next) == net;
         // If the global network inside the tile isn't already set up,
         // we also need to bind the buffers along the way
         if (!already_routed) {
@@ -593,55 +627,20 @@ class Ecp5GlobalRouter
                     log_info("    trying dedicated routing for edge clock source %s\n", ctx->nameOf(ni));
                     WireId src = ctx->getNetinfoSourceWire(ni);
                     WireId dst = ctx->getBelPinWire(ci->bel, pin);
-                    std::queue<WireId> visit;
-                    std::unordered_map<WireId, PipId> backtrace;
-                    visit.push(dst);
-                    int iter = 0;
-                    WireId cursor;
-                    bool success = false;
                     // This is a best-effort pass, if it fails then still try general routing later
                     const int iter_max = 1000;
-                    while (iter < iter_max && !visit.empty()) {
-                        cursor = visit.front();
-                        visit.pop();
-                        ++iter;
-                        NetInfo *bound = ctx->getBoundWireNet(cursor);
-                        if (bound != nullptr) {
-                            if (bound == ni) {
-                                success = true;
-                                break;
-                            } else {
-                                continue;
-                            }
-                        }
-                        if (cursor == src) {
-                            ctx->bindWire(cursor, ni, STRENGTH_LOCKED);
-                            success = true;
-                            break;
-                        }
-                        for (auto uh : ctx->getPipsUphill(cursor)) {
-                            if (!ctx->checkPipAvail(uh))
-                                continue;
-                            WireId src = ctx->getPipSrcWire(uh);
-                            if (backtrace.count(src))
-                                continue;
-                            IdString basename = ctx->getWireBasename(src);
-                            // "ECLKCIB" wires are the junction with general routing
-                            if (basename.str(ctx).find("ECLKCIB") != std::string::npos)
-                                continue;
-                            visit.push(src);
-                            backtrace[src] = uh;
-                        }
-                    }
-                    if (success) {
-                        while (cursor != dst) {
-                            PipId pip = backtrace.at(cursor);
-                            ctx->bindPip(pip, ni, STRENGTH_LOCKED);
-                            cursor = ctx->getPipDstWire(pip);
-                        }
-                    } else {
+                    WireId found = route_to_global_tree(
+                            ctx, ni, dst, iter_max,
+                            [&](WireId wire) { return wire == src || ctx->getBoundWireNet(wire) == ni; },
+                            [&](PipId pip) {
+                                IdString basename = ctx->getWireBasename(ctx->getPipSrcWire(pip));
+                                // "ECLKCIB" wires are the junction with general routing
+                                return basename.str(ctx).find("ECLKCIB") == std::string::npos;
+                            });
+                    if (found == WireId())
                         log_info("        no route found, general routing will be used.\n");
-                    }
+                    else if (ctx->getBoundWireNet(found) != ni)
+                        ctx->bindWire(found, ni, STRENGTH_LOCKED);
                 }
             }
         }
@@ -651,8 +650,11 @@ void promote_ecp5_globals(Context *ctx) { Ecp5GlobalRouter(ctx).promote_globals(
 void route_ecp5_globals(Context *ctx)
 {
     Ecp5GlobalRouter router(ctx);
+    auto rstart = std::chrono::high_resolution_clock::now();
     router.route_globals();
     router.route_eclk_sources();
+    auto rend = std::chrono::high_resolution_clock::now();
+    log_info("Global routing took %.02fs\n", std::chrono::duration<float>(rend - rstart).count());
 }
 
 NEXTPNR_NAMESPACE_END
@@ -18,6 +18,7 @@
  */
 
 #include <boost/algorithm/string.hpp>
+#include <chrono>
 #include <sstream>
 #include "log.h"
 
@@ -50,9 +51,22 @@ bool Arch::applyLPF(std::string filename, std::istream &in)
         }
     };
 
+    // Look up the cell for a port without interning its name, which would add an IdString for every constraint on a
+    // port the design doesn't have
+    auto find_port_cell = [&](const std::string &name) -> CellInfo * {
+        int index = idstring_db->lookup(name);
+        if (index < 0)
+            return nullptr;
+        auto fnd_cell = cells.find(IdString(index));
+        return fnd_cell != cells.end() ? fnd_cell->second.get() : nullptr;
+    };
+
     try {
         if (!in)
             log_error("failed to open LPF file\n");
+        auto start_time = std::chrono::steady_clock::now();
+        const IdString id_LOC = id("LOC");
+        int applied = 0, unmatched = 0;
         std::string line;
         std::string linebuf;
         int lineno = 0;
@@ -68,9 +82,10 @@ bool Arch::applyLPF(std::string filename, std::istream &in)
                 continue;
             linebuf += line;
             // Look for a command up to a semicolon
+            size_t cmdpos = 0;
             size_t scpos = linebuf.find(';');
             while (scpos != std::string::npos) {
-                std::string command = linebuf.substr(0, scpos);
+                std::string command = linebuf.substr(cmdpos, scpos - cmdpos);
                 // Split command into words
                 std::stringstream ss(command);
                 std::vector<std::string> words;
@@ -127,11 +142,14 @@ bool Arch::applyLPF(std::string filename, std::istream &in)
                         std::string cell = strip_quotes(words.at(2));
                         if (words.at(3) != "SITE")
                             log_error("expected 'SITE' after 'LOCATE COMP %s' (on line %d)\n", cell.c_str(), lineno);
-                        auto fnd_cell = cells.find(id(cell));
+                        CellInfo *port_cell = find_port_cell(cell);
                         if (words.size() > 5)
                             log_error("unexpected input following LOCATE clause (on line %d)\n", lineno);
-                        if (fnd_cell != cells.end()) {
-                            fnd_cell->second->attrs[id("LOC")] = strip_quotes(words.at(4));
+                        if (port_cell != nullptr) {
+                            port_cell->attrs[id_LOC] = strip_quotes(words.at(4));
+                            ++applied;
+                        } else {
+                            ++unmatched;
                         }
                     } else if (verb == "IOBUF") {
                         if (words.size() < 3)
@@ -140,8 +158,9 @@ bool Arch::applyLPF(std::string filename, std::istream &in)
                         if (words.at(1) != "PORT")
                             log_error("expected 'PORT' after 'IOBUF' (on line %d)\n", lineno);
                         std::string cell = strip_quotes(words.at(2));
-                        auto fnd_cell = cells.find(id(cell));
-                        if (fnd_cell != cells.end()) {
+                        CellInfo *port_cell = find_port_cell(cell);
+                        if (port_cell != nullptr) {
+                            ++applied;
                             for (size_t i = 3; i < words.size(); i++) {
                                 std::string setting = words.at(i);
                                 size_t eqpos = setting.find('=');
@@ -153,19 +172,25 @@ bool Arch::applyLPF(std::string filename, std::istream &in)
                                 if (!iobuf_keys.count(key))
                                     log_warning("IOBUF '%s' attribute '%s' is not recognised (on line %d)\n",
                                                 cell.c_str(), key.c_str(), lineno);
-                                fnd_cell->second->attrs[id(key)] = value;
+                                port_cell->attrs[id(key)] = value;
                             }
+                        } else {
+                            ++unmatched;
                         }
                     }
                 }
 
-                linebuf = linebuf.substr(scpos + 1);
-                scpos = linebuf.find(';');
+                cmdpos = scpos + 1;
+                scpos = linebuf.find(';', cmdpos);
             }
+            linebuf.erase(0, cmdpos);
         }
         if (!isempty(linebuf))
             log_error("unexpected end of LPF file\n");
         settings[id("input/lpf")] = filename;
+        auto end_time = std::chrono::steady_clock::now();
+        log_info("Applied %d LPF port constraints (%d for ports not in the design) in %.02fs\n", applied, unmatched,
+                 std::chrono::duration<double>(end_time - start_time).count());
         return true;
     } catch (log_execution_error_exception) {
         return false;
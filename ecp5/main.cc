@@ -21,6 +21,7 @@
 
 #include <fstream>
 #include "bitstream.h"
+#include "cells.h"
 #include "command.h"
 #include "design_utils.h"
 #include "log.h"
@@ -35,10 +36,18 @@ class ECP5CommandHandler : public CommandHandler
     ECP5CommandHandler(int argc, char **argv);
     virtual ~ECP5CommandHandler(){};
     std::unique_ptr<Context> createContext(std::unordered_map<std::string, Property> &values) override;
+    std::vector<std::string> getContextOptions() override
+    {
+        return {"12k",    "25k",      "45k",      "85k",      "um-25k",  "um-45k",
+                "um-85k", "um5g-25k", "um5g-45k", "um5g-85k", "package", "speed"};
+    }
     void setupArchContext(Context *ctx) override{};
     void customAfterLoad(Context *ctx) override;
+    bool preflightConfig(Context *ctx, PreflightCfg &cfg) override;
     void validate() override;
     void customBitstream(Context *ctx) override;
+    // Fills in default mux parameters of block RAMs
+    bool bitstreamModifiesDesign() override { return true; }
 
   protected:
     po::options_description getArchOptions() override;
@@ -81,6 +90,10 @@ po::options_description ECP5CommandHandler::getArchOptions()
 
     specific.add_options()("lpf", po::value<std::vector<std::string>>(), "LPF pin constraint file(s)");
     specific.add_options()("lpf-allow-unconstrained", "don't require LPF file(s) to constrain all IO");
+    specific.add_options()("opt-timing", "run post-placement timing optimisation pass (experimental)");
+    specific.add_options()("lut-matching",
+                           "pair LUTs into slices by scored matching rather than greedily, in parallel with "
+                           "--pack-threads");
 
     specific.add_options()(
             "out-of-context",
@@ -255,6 +268,10 @@ std::unique_ptr<Context> ECP5CommandHandler::createContext(std::unordered_map<st
     ctx->settings[ctx->id("arch.speed")] = speedString(ctx->archArgs().speed);
     if (vm.count("out-of-context"))
         ctx->settings[ctx->id("arch.ooc")] = 1;
+    if (vm.count("opt-timing"))
+        ctx->settings[ctx->id("opt_timing")] = Property::State::S1;
+    if (vm.count("lut-matching"))
+        ctx->settings[ctx->id("arch.lut_matching")] = 1;
     return ctx;
 }
 
@@ -288,6 +305,32 @@ void ECP5CommandHandler::customAfterLoad(Context *ctx)
     }
 }
 
+bool ECP5CommandHandler::preflightConfig(Context *ctx, PreflightCfg &cfg)
+{
+    // Each slice holds two LUTs (a carry uses both) and two FFs; a distributed RAM needs at least a slice of LUTs
+    PreflightCfg::Resource slice("slices", {id_TRELLIS_SLICE}, 2);
+    slice.groups.push_back([](const Context *ctx, const CellInfo *ci) {
+        return is_lut(ctx, ci) ? 1 : (is_carry(ctx, ci) || is_dpram(ctx, ci)) ? 2 : 0;
+    });
+    slice.groups.push_back([](const Context *ctx, const CellInfo *ci) { return is_ff(ctx, ci) ? 1 : 0; });
+    cfg.resources.push_back(slice);
+    PreflightCfg::Resource ram("block RAMs", {id_DP16KD});
+    ram.groups.push_back(preflight_cell_types({{id_DP16KD, 1}, {ctx->id("PDPW16KD"), 1}}));
+    cfg.resources.push_back(ram);
+    PreflightCfg::Resource mult("multipliers", {id_MULT18X18D});
+    mult.groups.push_back(preflight_cell_types({{id_MULT18X18D, 1}}));
+    cfg.resources.push_back(mult);
+    PreflightCfg::Resource io("IOs", {id_TRELLIS_IO});
+    io.groups.push_back([](const Context *ctx, const CellInfo *ci) { return is_trellis_io(ctx, ci) ? 1 : 0; });
+    io.top_ports = true;
+    cfg.resources.push_back(io);
+    cfg.pad_cell_types = {id_TRELLIS_IO, ctx->id("DCUA"), ctx->id("EXTREFB")};
+    cfg.loc_attrs.push_back(ctx->id("LOC"));
+    cfg.global_bel_types.push_back(id_DCCA);
+    cfg.clock_ports.push_back(ctx->id("CLK"));
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     ECP5CommandHandler handler(argc, argv);
@@ -18,9 +18,12 @@
  */
 
 #include <algorithm>
+#include <array>
 #include <boost/optional.hpp>
 #include <iterator>
+#include <numeric>
 #include <queue>
+#include <set>
 #include <unordered_set>
 #include "cells.h"
 #include "chain_utils.h"
@@ -29,6 +32,7 @@
 #include "log.h"
 #include "timing.h"
 #include "util.h"
+#include "worker_pool.h"
 NEXTPNR_NAMESPACE_BEGIN
 
 static bool is_nextpnr_iob(Context *ctx, CellInfo *cell)
@@ -47,15 +51,43 @@ class Ecp5Packer
     void flush_cells()
     {
         for (auto pcell : packed_cells) {
+            auto found = ctx->cells.find(pcell);
+            if (found != ctx->cells.end())
+                unindex_cell(found->second.get());
             ctx->cells.erase(pcell);
         }
         for (auto &ncell : new_cells) {
+            index_cell(ncell.get());
             ctx->cells[ncell->name] = std::move(ncell);
         }
         packed_cells.clear();
         new_cells.clear();
     }
 
+    // Names of the cells of each type, so that passes need only visit the cells they are interested in. Kept up to date
+    // by flush_cells and everywhere else the packer adds, removes or changes the type of a cell
+    std::unordered_map<IdString, std::set<IdString>> cells_by_type;
+
+    void index_cell(const CellInfo *ci) { cells_by_type[ci->type].insert(ci->name); }
+    void unindex_cell(const CellInfo *ci) { cells_by_type[ci->type].erase(ci->name); }
+
+    // Cells of any of the given types, in the same order as sorted(ctx->cells)
+    std::vector<CellInfo *> cells_of_type(std::initializer_list<IdString> types)
+    {
+        std::vector<IdString> names;
+        for (auto type : types) {
+            auto &type_cells = cells_by_type[type];
+            names.insert(names.end(), type_cells.begin(), type_cells.end());
+        }
+        if (types.size() > 1)
+            std::sort(names.begin(), names.end());
+        std::vector<CellInfo *> result;
+        result.reserve(names.size());
+        for (auto name : names)
+            result.push_back(ctx->cells.at(name).get());
+        return result;
+    }
+
     // Print logic usgage
     int available_slices = 0;
     void print_logic_usage()
@@ -106,8 +138,7 @@ class Ecp5Packer
     void find_lutff_pairs()
     {
         log_info("Finding LUTFF pairs...\n");
-        for (auto cell : sorted(ctx->cells)) {
-            CellInfo *ci = cell.second;
+        for (auto ci : cells_of_type({ctx->id("LUT4"), ctx->id("PFUMX"), ctx->id("L6MUX21")})) {
             if (is_lut(ctx, ci) || is_pfumx(ctx, ci) || is_l6mux(ctx, ci)) {
                 NetInfo *znet = ci->ports.at(ctx->id("Z")).net;
                 if (znet != nullptr) {
@@ -262,9 +293,8 @@ class Ecp5Packer
     {
         log_info("Finding LUT-LUT pairs...\n");
         std::unordered_set<IdString> procdLuts;
-        for (auto cell : sorted(ctx->cells)) {
-            CellInfo *ci = cell.second;
-            if (is_lut(ctx, ci) && procdLuts.find(cell.first) == procdLuts.end()) {
+        for (auto ci : cells_of_type({ctx->id("LUT4")})) {
+            if (procdLuts.find(ci->name) == procdLuts.end()) {
                 NetInfo *znet = ci->ports.at(ctx->id("Z")).net;
                 std::vector<NetInfo *> inpnets;
                 if (znet != nullptr) {
@@ -392,12 +422,185 @@ class Ecp5Packer
         }
         if (ctx->debug) {
             log_info("Singleton LUTs (packer QoR debug): \n");
-            for (auto cell : sorted(ctx->cells))
-                if (is_lut(ctx, cell.second) && !procdLuts.count(cell.first))
-                    log_info("     %s\n", cell.first.c_str(ctx));
+            for (auto ci : cells_of_type({ctx->id("LUT4")}))
+                if (!procdLuts.count(ci->name))
+                    log_info("     %s\n", ci->name.c_str(ctx));
         }
     }
 
+    // Pair LUTs by scored matching rather than greedily. The netlist neighbours of each LUT are scored as partners in
+    // parallel, then pairs are chosen best score first, breaking ties by name so the result doesn't depend on threads
+    void pair_luts_matching(int threads)
+    {
+        log_info("Finding LUT-LUT pairs by scored matching...\n");
+        std::vector<CellInfo *> luts = cells_of_type({ctx->id("LUT4")});
+        // Intern everything the scoring looks up first, so IdString indices stay deterministic
+        for (const char *name :
+             {"Q", "B", "C", "D", "GSR", "SRMODE", "CEMUX", "LSRMUX", "CLKMUX", "CLK", "CE", "LSR"})
+            ctx->id(name);
+        const IdString q_port = ctx->id("Q");
+        const std::array<IdString, 4> lut_inputs = {ctx->id("A"), ctx->id("B"), ctx->id("C"), ctx->id("D")};
+
+        auto input_nets = [&](const CellInfo *lut) {
+            std::array<const NetInfo *, 4> nets;
+            for (int i = 0; i < 4; i++) {
+                auto found = lut->ports.find(lut_inputs[i]);
+                nets[i] = (found != lut->ports.end()) ? found->second.net : nullptr;
+            }
+            return nets;
+        };
+        auto ff_q = [&](const CellInfo *lut) -> const NetInfo * {
+            auto ff = lutffPairs.find(lut->name);
+            return (ff != lutffPairs.end()) ? get_net_or_empty(ctx->cells.at(ff->second).get(), q_port) : nullptr;
+        };
+        // One way of the score between two LUTs; the full score is symmetric
+        auto half_score = [&](const CellInfo *a, const CellInfo *b) {
+            int score = 0;
+            const NetInfo *a_z = get_net_or_empty(a, id_Z), *a_q = ff_q(a);
+            for (const NetInfo *net : input_nets(b)) {
+                if (net == nullptr)
+                    continue;
+                if (net == a_z)
+                    score += 8;
+                else if (net == a_q)
+                    score += 4;
+            }
+            // Both feeding the same CCU2, RAM or DFF
+            if (a_z != nullptr && a_z->users.size() < 10) {
+                const NetInfo *b_z = get_net_or_empty(b, id_Z);
+                for (auto &user : a_z->users) {
+                    if (b_z == nullptr || !(is_lc(ctx, user.cell) || user.cell->type == id_DP16KD ||
+                                            is_ff(ctx, user.cell)))
+                        continue;
+                    for (auto &port : user.cell->ports) {
+                        if (port.second.type == PORT_IN && port.second.net == b_z) {
+                            score += 3;
+                            goto common_sink;
+                        }
+                    }
+                }
+            common_sink:;
+            }
+            return score;
+        };
+        auto score = [&](const CellInfo *a, const CellInfo *b) {
+            int total = half_score(a, b) + half_score(b, a);
+            // Shared inputs, ignoring high fanout nets
+            auto a_in = input_nets(a), b_in = input_nets(b);
+            for (int i = 0; i < 4; i++) {
+                if (a_in[i] == nullptr || a_in[i]->users.size() >= 16)
+                    continue;
+                if (std::find(a_in.begin(), a_in.begin() + i, a_in[i]) != a_in.begin() + i)
+                    continue;
+                if (std::find(b_in.begin(), b_in.end(), a_in[i]) != b_in.end())
+                    total += 2;
+            }
+            // Filling both flipflops of the slice
+            if (lutffPairs.count(a->name) && lutffPairs.count(b->name))
+                total += 1;
+            return total;
+        };
+
+        struct Candidate
+        {
+            int score;
+            IdString a, b;
+        };
+        const int chunk_size = 1024;
+        int num_chunks = (int(luts.size()) + chunk_size - 1) / chunk_size;
+        std::vector<std::vector<Candidate>> chunk_candidates(num_chunks);
+        auto score_chunk = [&](int chunk) {
+            auto &candidates = chunk_candidates.at(chunk);
+            std::vector<CellInfo *> neighbours;
+            auto add_neighbour = [&](CellInfo *ci, CellInfo *other) {
+                if (other != nullptr && other != ci && is_lut(ctx, other))
+                    neighbours.push_back(other);
+            };
+            for (int i = chunk * chunk_size; i < std::min(int(luts.size()), (chunk + 1) * chunk_size); i++) {
+                CellInfo *ci = luts.at(i);
+                neighbours.clear();
+                const NetInfo *znet = get_net_or_empty(ci, id_Z);
+                if (znet != nullptr && znet->users.size() < 10) {
+                    for (auto &user : znet->users) {
+                        add_neighbour(ci, user.cell);
+                        // LUTs driving other inputs of the same sink
+                        for (auto &port : user.cell->ports) {
+                            NetInfo *pn = port.second.net;
+                            if (port.second.type == PORT_IN && pn != nullptr && pn != znet && pn->users.size() <= 10)
+                                add_neighbour(ci, pn->driver.cell);
+                        }
+                    }
+                }
+                const NetInfo *qnet = ff_q(ci);
+                if (qnet != nullptr && qnet->users.size() < 10)
+                    for (auto &user : qnet->users)
+                        add_neighbour(ci, user.cell);
+                for (const NetInfo *innet : input_nets(ci)) {
+                    if (innet == nullptr)
+                        continue;
+                    CellInfo *drv = innet->driver.cell;
+                    if (drv != nullptr && is_ff(ctx, drv)) {
+                        auto fflut = fflutPairs.find(drv->name);
+                        if (fflut != fflutPairs.end())
+                            add_neighbour(ci, ctx->cells.at(fflut->second).get());
+                    } else {
+                        add_neighbour(ci, drv);
+                    }
+                    if (innet->users.size() < 5)
+                        for (auto &user : innet->users)
+                            add_neighbour(ci, user.cell);
+                }
+                std::sort(neighbours.begin(), neighbours.end(),
+                          [](const CellInfo *x, const CellInfo *y) { return x->name < y->name; });
+                neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+                for (CellInfo *other : neighbours) {
+                    if (!can_pack_lutff(ci->name, other->name))
+                        continue;
+                    int s = score(ci, other);
+                    if (s > 0)
+                        candidates.push_back(
+                                Candidate{s, std::min(ci->name, other->name), std::max(ci->name, other->name)});
+                }
+            }
+        };
+#ifndef NPNR_DISABLE_THREADS
+        if (threads > 1 && num_chunks > 1) {
+            std::vector<int> chunks(num_chunks);
+            std::iota(chunks.begin(), chunks.end(), 0);
+            WorkerPool pool(threads);
+            pool.run(chunks, score_chunk);
+        } else
+#endif
+        {
+            for (int chunk = 0; chunk < num_chunks; chunk++)
+                score_chunk(chunk);
+        }
+
+        std::vector<Candidate> candidates;
+        for (auto &chunk : chunk_candidates)
+            candidates.insert(candidates.end(), chunk.begin(), chunk.end());
+        // A pair may have been found from both of its LUTs
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &x, const Candidate &y) {
+            if (x.score != y.score)
+                return x.score > y.score;
+            if (x.a != y.a)
+                return x.a < y.a;
+            return x.b < y.b;
+        });
+        candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                                     [](const Candidate &x, const Candidate &y) { return x.a == y.a && x.b == y.b; }),
+                         candidates.end());
+        std::unordered_set<IdString> procdLuts;
+        for (auto &cand : candidates) {
+            if (procdLuts.count(cand.a) || procdLuts.count(cand.b))
+                continue;
+            procdLuts.insert(cand.a);
+            procdLuts.insert(cand.b);
+            lutPairs[cand.a] = cand.b;
+        }
+        log_info("    paired %d of %d LUTs\n", int(procdLuts.size()), int(luts.size()));
+    }
+
     // Return true if an port is a top level port that provides its own IOBUF
     bool is_top_port(PortRef &port)
     {
@@ -536,8 +739,7 @@ class Ecp5Packer
     void pack_lut5xs()
     {
         log_info("Packing LUT5-7s...\n");
-        for (auto cell : sorted(ctx->cells)) {
-            CellInfo *ci = cell.second;
+        for (auto ci : cells_of_type({ctx->id("PFUMX")})) {
             if (is_pfumx(ctx, ci)) {
                 std::unique_ptr<CellInfo> packed =
                         create_ecp5_cell(ctx, ctx->id("TRELLIS_SLICE"), ci->name.str(ctx) + "_SLICE");
@@ -554,7 +756,7 @@ class Ecp5Packer
                 if (lut1 == nullptr)
                     log_error("PFUMX '%s' has ALUT driven by cell other than a LUT\n", ci->name.c_str(ctx));
                 if (ctx->verbose)
-                    log_info("   mux '%s' forms part of a LUT5\n", cell.first.c_str(ctx));
+                    log_info("   mux '%s' forms part of a LUT5\n", ci->name.c_str(ctx));
                 replace_port(lut0, ctx->id("A"), packed.get(), ctx->id("A0"));
                 replace_port(lut0, ctx->id("B"), packed.get(), ctx->id("B0"));
                 replace_port(lut0, ctx->id("C"), packed.get(), ctx->id("C0"));
@@ -593,8 +795,7 @@ class Ecp5Packer
         }
         flush_cells();
         // Pack LUT6s
-        for (auto cell : sorted(ctx->cells)) {
-            CellInfo *ci = cell.second;
+        for (auto ci : cells_of_type({ctx->id("L6MUX21")})) {
             if (is_l6mux(ctx, ci)) {
                 NetInfo *ofx0_0 = ci->ports.at(ctx->id("D0")).net;
                 if (ofx0_0 == nullptr)
@@ -623,7 +824,7 @@ class Ecp5Packer
                     continue;
                 }
                 if (ctx->verbose)
-                    log_info("   mux '%s' forms part of a LUT6\n", cell.first.c_str(ctx));
+                    log_info("   mux '%s' forms part of a LUT6\n", ci->name.c_str(ctx));
                 replace_port(ci, ctx->id("D0"), slice1, id_FXA);
                 replace_port(ci, ctx->id("D1"), slice1, id_FXB);
                 replace_port(ci, ctx->id("SD"), slice1, id_M1);
@@ -650,8 +851,7 @@ class Ecp5Packer
         }
         flush_cells();
         // Pack LUT7s
-        for (auto cell : sorted(ctx->cells)) {
-            CellInfo *ci = cell.second;
+        for (auto ci : cells_of_type({ctx->id("L6MUX21")})) {
             if (is_l6mux(ctx, ci)) {
                 NetInfo *ofx1_0 = ci->ports.at(ctx->id("D0")).net;
                 if (ofx1_0 == nullptr)
@@ -768,6 +968,7 @@ class Ecp5Packer
 
         CellInfo *feedin_ptr = feedin.get();
         IdString feedin_name = feedin->name;
+        index_cell(feedin.get());
         ctx->cells[feedin_name] = std::move(feedin);
         IdString new_carry_name = new_carry->name;
         ctx->nets[new_carry_name] = std::move(new_carry);
@@ -817,6 +1018,7 @@ class Ecp5Packer
 
         CellInfo *feedout_ptr = feedout.get();
         IdString feedout_name = feedout->name;
+        index_cell(feedout.get());
         ctx->cells[feedout_name] = std::move(feedout);
 
         IdString new_cin_name = new_cin->name;
@@ -972,8 +1174,7 @@ class Ecp5Packer
     // Pack distributed RAM
     void pack_dram()
     {
-        for (auto cell : sorted(ctx->cells)) {
-            CellInfo *ci = cell.second;
+        for (auto ci : cells_of_type({ctx->id("TRELLIS_DPR16X4")})) {
             if (is_dpram(ctx, ci)) {
 
                 // Create RAMW slice
@@ -1104,8 +1305,7 @@ class Ecp5Packer
     void pack_remaining_luts()
     {
         log_info("Packing unpaired LUTs into a SLICE...\n");
-        for (auto cell : sorted(ctx->cells)) {
-            CellInfo *ci = cell.second;
+        for (auto ci : cells_of_type({ctx->id("LUT4")})) {
             if (is_lut(ctx, ci)) {
                 std::unique_ptr<CellInfo> slice =
                         create_ecp5_cell(ctx, ctx->id("TRELLIS_SLICE"), ci->name.str(ctx) + "_SLICE");
@@ -1171,14 +1371,10 @@ class Ecp5Packer
     void pack_remaining_ffs()
     {
         // Enter dense flipflop packing mode once utilisation exceeds a threshold (default: 95%)
-        int used_slices = 0;
-        for (auto &cell : ctx->cells)
-            if (cell.second->type == id_TRELLIS_SLICE)
-                ++used_slices;
+        int used_slices = int(cells_by_type[id_TRELLIS_SLICE].size());
 
         log_info("Packing unpaired FFs into a SLICE...\n");
-        for (auto cell : sorted(ctx->cells)) {
-            CellInfo *ci = cell.second;
+        for (auto ci : cells_of_type({ctx->id("TRELLIS_FF")})) {
             if (is_ff(ctx, ci)) {
                 bool pack_dense = used_slices > (dense_pack_mode_thresh * available_slices);
                 bool requires_m = get_net_or_empty(ci, ctx->id("M")) != nullptr;
@@ -1408,21 +1604,25 @@ class Ecp5Packer
                 set_net_constant(ctx, ni, gnd_net.get(), false);
                 gnd_used = true;
                 dead_nets.push_back(net.first);
+                unindex_cell(ctx->cells.at(drv_cell).get());
                 ctx->cells.erase(drv_cell);
             } else if (ni->driver.cell != nullptr && ni->driver.cell->type == ctx->id("VCC")) {
                 IdString drv_cell = ni->driver.cell->name;
                 set_net_constant(ctx, ni, vcc_net.get(), true);
                 vcc_used = true;
                 dead_nets.push_back(net.first);
+                unindex_cell(ctx->cells.at(drv_cell).get());
                 ctx->cells.erase(drv_cell);
             }
         }
 
         if (gnd_used) {
+            index_cell(gnd_cell.get());
             ctx->cells[gnd_cell->name] = std::move(gnd_cell);
             ctx->nets[gnd_net->name] = std::move(gnd_net);
         }
         if (vcc_used) {
+            index_cell(vcc_cell.get());
             ctx->cells[vcc_cell->name] = std::move(vcc_cell);
             ctx->nets[vcc_net->name] = std::move(vcc_net);
         }
@@ -1498,7 +1698,9 @@ class Ecp5Packer
                     disconnect_port(ctx, ci, id_RST);
                     ci->ports.erase(id_RST);
                 }
+                unindex_cell(ci);
                 ci->type = id_DP16KD;
+                index_cell(ci);
             }
         }
         for (auto cell : sorted(ctx->cells)) {
@@ -1682,7 +1884,9 @@ class Ecp5Packer
                 ci->params[ctx->id("MODE")] = std::string("ACTIVE_LOW");
                 ci->params[ctx->id("SYNCMODE")] =
                         ci->type == ctx->id("SGSR") ? std::string("SYNC") : std::string("ASYNC");
+                unindex_cell(ci);
                 ci->type = id_GSR;
+                index_cell(ci);
                 for (BelId bel : ctx->getBels()) {
                     if (ctx->getBelType(bel) != id_GSR)
                         continue;
@@ -2713,7 +2917,9 @@ class Ecp5Packer
             eclksync_done:
                 continue;
             } else if (ci->type == ctx->id("DDRDLLA")) {
+                unindex_cell(ci);
                 ci->type = id_DDRDLL; // transform from Verilog to Bel name
+                index_cell(ci);
                 const NetInfo *clk = net_or_nullptr(ci, id_CLK);
                 if (clk == nullptr)
                     log_error("DDRDLLA '%s' has disconnected port CLK\n", ci->name.c_str(ctx));
@@ -2999,6 +3205,8 @@ class Ecp5Packer
   public:
     void pack()
     {
+        for (auto &cell : ctx->cells)
+            index_cell(cell.second.get());
         prepack_checks();
         print_logic_usage();
         pack_io();
@@ -3014,7 +3222,10 @@ class Ecp5Packer
         pack_carries();
         find_lutff_pairs();
         pack_lut5xs();
-        pair_luts();
+        if (bool_or_default(ctx->settings, ctx->id("arch.lut_matching")))
+            pair_luts_matching(ctx->stage_threads("pack", 1));
+        else
+            pair_luts();
         pack_lut_pairs();
         pack_remaining_luts();
         pack_remaining_ffs();
@@ -3044,11 +3255,22 @@ class Ecp5Packer
     std::unordered_map<IdString, IdString> lutPairs;
 };
 // Main pack function
+// Clean up the synthesised netlist of buffers, constant logic and unused LUTs
+static void pack_optimise(Context *ctx)
+{
+    NetlistOptCfg cfg;
+    cfg.luts.push_back({ctx->id("LUT4"), {id_A, id_B, ctx->id("C"), ctx->id("D")}, id_Z, ctx->id("INIT")});
+    cfg.constants.push_back({ctx->id("GND"), ctx->id("Y"), false});
+    cfg.constants.push_back({ctx->id("VCC"), ctx->id("Y"), true});
+    optimise_netlist(ctx, cfg);
+}
+
 bool Arch::pack()
 {
     Context *ctx = getCtx();
     try {
         log_break();
+        pack_optimise(ctx);
         Ecp5Packer(ctx).pack();
         log_info("Checksum: 0x%08x\n", ctx->checksum());
         assignArchInfo();
@@ -3179,6 +3401,12 @@ void Arch::assignArchInfo()
     for (auto net : sorted(nets)) {
         net.second->is_global = bool_or_default(net.second->attrs, id("ECP5_IS_GLOBAL"));
     }
+    // The slice summaries of already placed tiles depend on sliceInfo
+    for (auto &cell : cells) {
+        CellInfo *ci = cell.second.get();
+        if (ci->type == id_TRELLIS_SLICE && ci->bel != BelId())
+            refreshSliceTile(ci->bel);
+    }
 }
 
 NEXTPNR_NAMESPACE_END
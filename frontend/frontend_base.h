@@ -103,12 +103,21 @@
  *   int get_vector_bit_signal(const BitVectorDataType &bits, int i) const;
  *       returns the signal number of vector bit <i>
  *
+ * With frontend/threads set above 1, the cell accessors (get_cell_type, foreach_port_dir, foreach_port_conn,
+ * foreach_attr, foreach_param and the vector accessors) are called from several threads at once, and the CellDataType
+ * references passed by foreach_cell must stay valid until it returns.
+ *
  */
 
+#include <memory>
+#include <numeric>
 #include "design_utils.h"
 #include "log.h"
 #include "nextpnr.h"
 #include "util.h"
+#ifndef NPNR_DISABLE_THREADS
+#include "worker_pool.h"
+#endif
 NEXTPNR_NAMESPACE_BEGIN
 
 namespace {
@@ -133,6 +142,11 @@ template <typename FrontendType> struct GenericFrontend
         m.prefix = "";
         m.path = top;
         ctx->top_module = top;
+#ifndef NPNR_DISABLE_THREADS
+        int threads = ctx->stage_threads("frontend", 1);
+        if (threads > 1)
+            pool.reset(new WorkerPool(threads));
+#endif
         // Do the actual import, starting from the top level module
         import_module(m, top.str(ctx), top.str(ctx), mod_refs.at(top));
     }
@@ -148,6 +162,10 @@ template <typename FrontendType> struct GenericFrontend
     std::unordered_map<IdString, ModuleInfo> mods;
     std::unordered_map<IdString, const mod_dat_t &> mod_refs;
     IdString top;
+#ifndef NPNR_DISABLE_THREADS
+    // Prepares leaf cells in parallel, if frontend/threads is above 1
+    std::unique_ptr<WorkerPool> pool;
+#endif
 
     // Process the list of modules and determine
     // the top module
@@ -441,38 +459,123 @@ template <typename FrontendType> struct GenericFrontend
         return ni;
     }
 
-    // Import a leaf cell - (white|black)box
-    void import_leaf_cell(HierModuleState &m, const std::string &name, const cell_dat_t &cd)
+    // An IdString looked up without adding it: either its index, or the string to add later. Preparing cells in
+    // parallel must not add strings, as IdString indices (and so anything sorted by them) would then depend on thread
+    // timing; instead the new strings are added when the cell is added, in the same order as a serial import.
+    struct DeferredId
+    {
+        int index = -1;
+        std::string str;
+    };
+
+    DeferredId defer_id(const std::string &str)
+    {
+        DeferredId id;
+        id.index = ctx->idstring_db->lookup(str);
+        if (id.index == -1)
+            id.str = str;
+        return id;
+    }
+
+    IdString resolve_id(const DeferredId &id) { return (id.index != -1) ? IdString(id.index) : ctx->id(id.str); }
+
+    // A leaf cell read from the netlist, but not yet added to the context
+    struct PreparedPortBit
     {
-        IdString inst_name = unique_name(m.prefix, name, false);
-        ctx->hierarchy[m.path].leaf_cells_by_gname[inst_name] = ctx->id(name);
-        ctx->hierarchy[m.path].leaf_cells[ctx->id(name)] = inst_name;
-        CellInfo *ci = ctx->createCell(inst_name, ctx->id(impl.get_cell_type(cd)));
+        DeferredId name;
+        // Signal index in the module, or -1 if the bit is constant
+        int signal;
+        char constval;
+    };
+
+    struct PreparedPortConn
+    {
+        std::string name;
+        DeferredId name_id;
+        std::vector<PreparedPortBit> bits;
+    };
+
+    struct PreparedLeafCell
+    {
+        std::string name;
+        const cell_dat_t *data;
+        DeferredId name_id, type;
+        std::vector<std::pair<DeferredId, PortType>> port_dirs;
+        std::vector<PreparedPortConn> conns;
+        std::vector<std::pair<DeferredId, Property>> attrs, params;
+    };
+
+    // Read a leaf cell from the netlist; this only looks up existing strings, so it can be run in parallel
+    void prepare_leaf_cell(PreparedLeafCell &pc)
+    {
+        const cell_dat_t &cd = *pc.data;
+        pc.name_id = defer_id(pc.name);
+        pc.type = defer_id(impl.get_cell_type(cd));
+        impl.foreach_port_dir(cd, [&](const std::string &port, PortType dir) {
+            pc.port_dirs.emplace_back(defer_id(port), dir);
+        });
+        impl.foreach_port_conn(cd, [&](const std::string &name, const bitvector_t &bits) {
+            pc.conns.emplace_back();
+            PreparedPortConn &conn = pc.conns.back();
+            conn.name = name;
+            conn.name_id = defer_id(name);
+            int width = impl.get_vector_length(bits);
+            conn.bits.resize(width);
+            for (int i = 0; i < width; i++) {
+                PreparedPortBit &bit = conn.bits.at(i);
+                bit.name = defer_id(get_bit_name(name, i, width));
+                if (impl.is_vector_bit_constant(bits, i)) {
+                    bit.signal = -1;
+                    bit.constval = impl.get_vector_bit_constval(bits, i);
+                } else {
+                    bit.signal = impl.get_vector_bit_signal(bits, i);
+                    bit.constval = 'x';
+                }
+            }
+        });
+        impl.foreach_attr(cd, [&](const std::string &name, const Property &value) {
+            pc.attrs.emplace_back(defer_id(name), value);
+        });
+        impl.foreach_param(cd, [&](const std::string &name, const Property &value) {
+            pc.params.emplace_back(defer_id(name), value);
+        });
+    }
+
+    // Add a prepared leaf cell - (white|black)box - to the context and connect it up
+    void import_leaf_cell(HierModuleState &m, PreparedLeafCell &pc)
+    {
+        IdString inst_name = unique_name(m.prefix, pc.name, false);
+        IdString name_id = resolve_id(pc.name_id);
+        ctx->hierarchy[m.path].leaf_cells[name_id] = inst_name;
+        CellInfo *ci = ctx->createCell(inst_name, resolve_id(pc.type));
         ci->hierpath = m.path;
         // Import port directions
         std::unordered_map<IdString, PortType> port_dirs;
-        impl.foreach_port_dir(cd, [&](const std::string &port, PortType dir) { port_dirs[ctx->id(port)] = dir; });
+        for (auto &pd : pc.port_dirs)
+            port_dirs[resolve_id(pd.first)] = pd.second;
         // Import port connectivity
-        impl.foreach_port_conn(cd, [&](const std::string &name, const bitvector_t &bits) {
-            if (!port_dirs.count(ctx->id(name)))
-                log_error("Failed to get direction for port '%s' of cell '%s'\n", name.c_str(), inst_name.c_str(ctx));
-            PortType dir = port_dirs.at(ctx->id(name));
-            int width = impl.get_vector_length(bits);
+        for (auto &conn : pc.conns) {
+            IdString conn_id = resolve_id(conn.name_id);
+            if (!port_dirs.count(conn_id))
+                log_error("Failed to get direction for port '%s' of cell '%s'\n", conn.name.c_str(),
+                          inst_name.c_str(ctx));
+            PortType dir = port_dirs.at(conn_id);
+            int width = int(conn.bits.size());
             for (int i = 0; i < width; i++) {
-                std::string port_bit_name = get_bit_name(name, i, width);
-                IdString port_bit_ids = ctx->id(port_bit_name);
+                const PreparedPortBit &bit = conn.bits.at(i);
+                IdString port_bit_ids = resolve_id(bit.name);
                 // Create cell port
                 ci->ports[port_bit_ids].name = port_bit_ids;
                 ci->ports[port_bit_ids].type = dir;
                 // Resolve connectivity
                 NetInfo *net;
-                if (impl.is_vector_bit_constant(bits, i)) {
+                if (bit.signal == -1) {
                     // Create a constant driver if one is needed
-                    net = create_constant_net(m, inst_name.str(ctx) + "." + port_bit_name + "$const",
-                                              impl.get_vector_bit_constval(bits, i));
+                    net = create_constant_net(m, inst_name.str(ctx) + "." + port_bit_ids.str(ctx) + "$const",
+                                              bit.constval);
                 } else {
                     // Otherwise, lookup (creating if needed) the net with this index
-                    net = create_or_get_net(m, impl.get_vector_bit_signal(bits, i));
+                    net = create_or_get_net(m, bit.signal);
                 }
                 NPNR_ASSERT(net != nullptr);
 
@@ -480,15 +583,15 @@ template <typename FrontendType> struct GenericFrontend
                 if (dir == PORT_OUT && net->driver.cell != nullptr)
                     log_error("Net '%s' is multiply driven by cell ports %s.%s and %s.%s\n", ctx->nameOf(net),
                               ctx->nameOf(net->driver.cell), ctx->nameOf(net->driver.port), ctx->nameOf(inst_name),
-                              port_bit_name.c_str());
+                              ctx->nameOf(port_bit_ids));
                 connect_port(ctx, net, ci, port_bit_ids);
             }
-        });
+        }
         // Import attributes and parameters
-        impl.foreach_attr(cd,
-                          [&](const std::string &name, const Property &value) { ci->attrs[ctx->id(name)] = value; });
-        impl.foreach_param(cd,
-                           [&](const std::string &name, const Property &value) { ci->params[ctx->id(name)] = value; });
+        for (auto &attr : pc.attrs)
+            ci->attrs[resolve_id(attr.first)] = std::move(attr.second);
+        for (auto &param : pc.params)
+            ci->params[resolve_id(param.first)] = std::move(param.second);
     }
 
     // Import a submodule cell
@@ -534,16 +637,47 @@ template <typename FrontendType> struct GenericFrontend
     // Import the cells section of a module
     void import_module_cells(HierModuleState &m, const mod_dat_t &data)
     {
+        // Runs of leaf cells are prepared in blocks, in parallel if enabled, and then added in netlist order. The
+        // context itself (cells, nets and names) is only ever changed by this thread.
+        const size_t block_size = 4096;
+        std::vector<PreparedLeafCell> block;
+        auto flush_block = [&]() {
+#ifndef NPNR_DISABLE_THREADS
+            if (pool != nullptr && block.size() > 1) {
+                int chunks = std::min<int>(int(block.size()), 64);
+                std::vector<int> tasks(chunks);
+                std::iota(tasks.begin(), tasks.end(), 0);
+                pool->run(tasks, [&](int chunk) {
+                    size_t begin = block.size() * chunk / chunks, end = block.size() * (chunk + 1) / chunks;
+                    for (size_t i = begin; i < end; i++)
+                        prepare_leaf_cell(block.at(i));
+                });
+            } else
+#endif
+            {
+                for (auto &pc : block)
+                    prepare_leaf_cell(pc);
+            }
+            for (auto &pc : block)
+                import_leaf_cell(m, pc);
+            block.clear();
+        };
         impl.foreach_cell(data, [&](const std::string &cellname, const cell_dat_t &cd) {
             IdString type = ctx->id(impl.get_cell_type(cd));
             if (mods.count(type) && !mods.at(type).is_box()) {
                 // Module type is known; and not boxed. Import as a submodule by flattening hierarchy
+                flush_block();
                 import_submodule_cell(m, cellname, cd);
             } else {
                 // Module type is unknown or boxes. Import as a leaf cell (nextpnr CellInfo)
-                import_leaf_cell(m, cellname, cd);
+                block.emplace_back();
+                block.back().name = cellname;
+                block.back().data = &cd;
+                if (block.size() >= block_size)
+                    flush_block();
             }
         });
+        flush_block();
     }
 
     // Create a top level input/output buffer
@@ -605,6 +739,7 @@ template <typename FrontendType> struct GenericFrontend
         pinfo.name = name_id;
         pinfo.net = net;
         pinfo.type = dir;
+        pinfo.user_idx = 0;
         ctx->ports[pinfo.name] = pinfo;
 
         return iobuf;
@@ -680,6 +815,7 @@ template <typename FrontendType> struct GenericFrontend
         // Combine users
         for (auto &usr : mergee->users) {
             usr.cell->ports[usr.port].net = base;
+            usr.cell->ports[usr.port].user_idx = base->users.size();
             base->users.push_back(usr);
         }
         // Point aliases to the new net
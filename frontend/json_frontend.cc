@@ -18,187 +18,705 @@
  */
 
 #include "json_frontend.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
 #include "frontend_base.h"
-#include "json11.hpp"
 #include "log.h"
 #include "nextpnr.h"
 
-#include <streambuf>
-
 NEXTPNR_NAMESPACE_BEGIN
 
-using namespace json11;
+namespace {
 
-struct JsonFrontendImpl
+// The parts of a Yosys JSON netlist used by the frontend, in a compact form. Objects become vectors of (key, value)
+// sorted by key, bit vectors hold signal numbers, with constant bits stored as the negated character [01xz].
+template <typename T> using JsonEntries = std::vector<std::pair<std::string, T>>;
+typedef std::vector<int> JsonBits;
+
+struct JsonPort
 {
-    // See specification in frontend_base.h
-    JsonFrontendImpl(Json &root) : root(root){};
-    Json &root;
-    typedef const Json &ModuleDataType;
-    typedef const Json &ModulePortDataType;
-    typedef const Json &CellDataType;
-    typedef const Json &NetnameDataType;
-    typedef const Json::array &BitVectorDataType;
+    std::string direction;
+    JsonBits bits;
+    int offset = 0;
+    bool upto = false;
+    JsonEntries<Property> attrs;
+};
 
-    template <typename TFunc> void foreach_module(TFunc Func) const
-    {
-        for (const auto &mod : root.object_items())
-            Func(mod.first, mod.second);
+struct JsonCell
+{
+    std::string type;
+    JsonEntries<Property> attrs, params;
+    JsonEntries<PortType> port_dirs;
+    JsonEntries<JsonBits> conns;
+};
+
+struct JsonNetname
+{
+    JsonBits bits;
+    int offset = 0;
+    bool upto = false;
+    JsonEntries<Property> attrs;
+};
+
+struct JsonModule
+{
+    JsonEntries<Property> attrs, settings;
+    JsonEntries<JsonPort> ports;
+    JsonEntries<JsonCell> cells;
+    JsonEntries<JsonNetname> netnames;
+};
+
+PortType lookup_portdir(const std::string &dir)
+{
+    if (dir == "input")
+        return PORT_IN;
+    else if (dir == "inout")
+        return PORT_INOUT;
+    else if (dir == "output")
+        return PORT_OUT;
+    else
+        NPNR_ASSERT_FALSE("invalid json port direction");
+}
+
+// json11, used before, kept object members in a std::map; keep its ordering, and let a repeated key override the
+// earlier ones, so designs are imported exactly as they were
+template <typename T> void sort_entries(JsonEntries<T> &entries)
+{
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const std::pair<std::string, T> &a, const std::pair<std::string, T> &b) {
+                         return a.first < b.first;
+                     });
+    size_t count = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (i + 1 < entries.size() && entries.at(i + 1).first == entries.at(i).first)
+            continue;
+        if (count != i)
+            entries.at(count) = std::move(entries.at(i));
+        count++;
     }
+    entries.resize(count);
+}
 
-    template <typename TFunc> void foreach_port(ModuleDataType &mod, TFunc Func) const
+// Parses a netlist straight from the stream, a block at a time, into the structures above; the file is never held in
+// memory as a whole, and values the frontend doesn't use are skipped without being stored
+struct JsonReader
+{
+    JsonReader(std::istream &in, const std::string &filename) : in(in), filename(filename), buffer(1 << 16) {}
+
+    std::istream &in;
+    const std::string &filename;
+    std::vector<char> buffer;
+    size_t pos = 0, len = 0;
+    int line = 1;
+
+    NPNR_NORETURN void error(const std::string &msg) const
     {
-        const auto &ports = mod["ports"];
-        if (ports.is_null())
-            return;
-        for (const auto &port : ports.object_items())
-            Func(port.first, port.second);
+        log_error("Failed to parse JSON file '%s' at line %d: %s.\n", filename.c_str(), line, msg.c_str());
     }
 
-    template <typename TFunc> void foreach_cell(ModuleDataType &mod, TFunc Func) const
+    int peek()
     {
-        const auto &cells = mod["cells"];
-        if (cells.is_null())
-            return;
-        for (const auto &cell : cells.object_items())
-            Func(cell.first, cell.second);
+        if (pos == len) {
+            in.read(buffer.data(), buffer.size());
+            len = size_t(in.gcount());
+            pos = 0;
+            if (len == 0)
+                return EOF;
+        }
+        return buffer[pos];
     }
 
-    template <typename TFunc> void foreach_netname(ModuleDataType &mod, TFunc Func) const
+    int get()
     {
-        const auto &netnames = mod["netnames"];
-        if (netnames.is_null())
-            return;
-        for (const auto &netname : netnames.object_items())
-            Func(netname.first, netname.second);
+        int c = peek();
+        if (c == EOF)
+            error("unexpected end of file");
+        pos++;
+        if (c == '\n')
+            line++;
+        return c;
     }
 
-    PortType lookup_portdir(const std::string &dir) const
+    // Skips whitespace and comments
+    void skip_ws()
     {
-        if (dir == "input")
-            return PORT_IN;
-        else if (dir == "inout")
-            return PORT_INOUT;
-        else if (dir == "output")
-            return PORT_OUT;
-        else
-            NPNR_ASSERT_FALSE("invalid json port direction");
+        while (true) {
+            int c = peek();
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                get();
+            } else if (c == '/') {
+                get();
+                c = get();
+                if (c == '/') {
+                    while (peek() != EOF && get() != '\n')
+                        ;
+                } else if (c == '*') {
+                    int prev = 0;
+                    while ((c = get()) != '/' || prev != '*')
+                        prev = c;
+                } else {
+                    error("malformed comment");
+                }
+            } else {
+                return;
+            }
+        }
     }
 
-    PortType get_port_dir(ModulePortDataType &port) const { return lookup_portdir(port["direction"].string_value()); }
-
-    int get_array_offset(const Json &obj) const
+    bool consume(char c)
     {
-        auto offset = obj["offset"];
-        return offset.is_null() ? 0 : offset.int_value();
+        skip_ws();
+        if (peek() != c)
+            return false;
+        get();
+        return true;
     }
 
-    bool is_array_upto(const Json &obj) const
+    void expect(char c)
     {
-        auto upto = obj["upto"];
-        return upto.is_null() ? false : bool(upto.int_value());
+        if (!consume(c))
+            error(std::string("expected '") + c + "'");
     }
 
-    BitVectorDataType &get_port_bits(ModulePortDataType &port) const { return port["bits"].array_items(); }
+    void put_utf8(std::string &out, uint32_t cp)
+    {
+        if (cp < 0x80) {
+            out += char(cp);
+        } else if (cp < 0x800) {
+            out += char(0xC0 | (cp >> 6));
+            out += char(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += char(0xE0 | (cp >> 12));
+            out += char(0x80 | ((cp >> 6) & 0x3F));
+            out += char(0x80 | (cp & 0x3F));
+        } else {
+            out += char(0xF0 | (cp >> 18));
+            out += char(0x80 | ((cp >> 12) & 0x3F));
+            out += char(0x80 | ((cp >> 6) & 0x3F));
+            out += char(0x80 | (cp & 0x3F));
+        }
+    }
 
-    const std::string &get_cell_type(CellDataType &cell) const { return cell["type"].string_value(); }
+    uint32_t parse_hex4()
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            int c = get();
+            value <<= 4;
+            if (c >= '0' && c <= '9')
+                value |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                value |= c - 'A' + 10;
+            else
+                error("invalid \\u escape");
+        }
+        return value;
+    }
 
-    Property parse_property(const Json &val) const
+    std::string parse_string()
     {
-        if (val.is_number()) {
-            if (val.int_value() != val.number_value())
-                log_error("Found an out-of-range integer parameter in the JSON file.\n"
-                          "Please regenerate the input file with an up-to-date version of yosys.\n");
-            return Property(val.int_value(), 32);
-        } else {
-            return Property::from_string(val.string_value());
+        expect('"');
+        std::string out;
+        while (true) {
+            int c = get();
+            if (c == '"')
+                return out;
+            if (c != '\\') {
+                out += char(c);
+                continue;
+            }
+            c = get();
+            switch (c) {
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case '"':
+            case '\\':
+            case '/':
+                out += char(c);
+                break;
+            case 'u': {
+                uint32_t cp = parse_hex4();
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    if (get() != '\\' || get() != 'u')
+                        error("unpaired surrogate in \\u escape");
+                    uint32_t low = parse_hex4();
+                    if (low < 0xDC00 || low > 0xDFFF)
+                        error("unpaired surrogate in \\u escape");
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                put_utf8(out, cp);
+                break;
+            }
+            default:
+                error("invalid escape sequence");
+            }
         }
     }
 
-    template <typename TFunc> void foreach_attr(const Json &obj, TFunc Func) const
+    // Returns the text of a number, which is then converted as needed
+    std::string parse_number_text()
     {
-        const auto &attrs = obj["attributes"];
-        if (attrs.is_null())
-            return;
-        for (const auto &attr : attrs.object_items()) {
-            Func(attr.first, parse_property(attr.second));
+        skip_ws();
+        std::string text;
+        while (true) {
+            int c = peek();
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')
+                text += char(get());
+            else
+                break;
         }
+        if (text.empty())
+            error("expected a number");
+        return text;
+    }
+
+    // As json11, numbers are doubles; false if not an integer in range
+    bool number_to_int(const std::string &text, int &value) const
+    {
+        char *end;
+        double number = strtod(text.c_str(), &end);
+        if (*end != '\0')
+            error("invalid number '" + text + "'");
+        if (number < std::numeric_limits<int>::min() || number > std::numeric_limits<int>::max() ||
+            number != double(int(number)))
+            return false;
+        value = int(number);
+        return true;
+    }
+
+    int parse_int()
+    {
+        std::string text = parse_number_text();
+        int value;
+        if (!number_to_int(text, value))
+            error("expected an integer, found '" + text + "'");
+        return value;
+    }
+
+    bool parse_literal()
+    {
+        skip_ws();
+        std::string word;
+        while (peek() >= 'a' && peek() <= 'z')
+            word += char(get());
+        if (word == "true")
+            return true;
+        if (word == "false" || word == "null")
+            return false;
+        error("unexpected '" + word + "'");
     }
 
-    template <typename TFunc> void foreach_param(const Json &obj, TFunc Func) const
+    // Calls Func(key) for each member of an object, which must parse or skip the value
+    template <typename TFunc> void parse_object(TFunc Func)
     {
-        const auto &params = obj["parameters"];
-        if (params.is_null())
+        expect('{');
+        if (consume('}'))
             return;
-        for (const auto &param : params.object_items()) {
-            Func(param.first, parse_property(param.second));
-        }
+        do {
+            skip_ws();
+            std::string key = parse_string();
+            expect(':');
+            Func(key);
+        } while (consume(','));
+        expect('}');
     }
 
-    template <typename TFunc> void foreach_setting(const Json &obj, TFunc Func) const
+    // Calls Func() for each element of an array, which must parse or skip it
+    template <typename TFunc> void parse_array(TFunc Func)
     {
-        const auto &settings = obj["settings"];
-        if (settings.is_null())
+        expect('[');
+        if (consume(']'))
             return;
-        for (const auto &setting : settings.object_items()) {
-            Func(setting.first, parse_property(setting.second));
+        do {
+            Func();
+        } while (consume(','));
+        expect(']');
+    }
+
+    void skip_value()
+    {
+        skip_ws();
+        int c = peek();
+        if (c == '{')
+            parse_object([&](const std::string &) { skip_value(); });
+        else if (c == '[')
+            parse_array([&]() { skip_value(); });
+        else if (c == '"')
+            parse_string();
+        else if (c == 't' || c == 'f' || c == 'n')
+            parse_literal();
+        else
+            parse_number_text();
+    }
+
+    Property parse_property()
+    {
+        skip_ws();
+        int c = peek();
+        if (c == '"')
+            return Property::from_string(parse_string());
+        if (c == 't' || c == 'f' || c == 'n') {
+            // Not a number, so treated as an empty string as before
+            parse_literal();
+            return Property::from_string("");
         }
+        int value;
+        if (!number_to_int(parse_number_text(), value))
+            log_error("Found an out-of-range integer parameter in the JSON file.\n"
+                      "Please regenerate the input file with an up-to-date version of yosys.\n");
+        return Property(value, 32);
+    }
+
+    void parse_properties(JsonEntries<Property> &props)
+    {
+        parse_object([&](const std::string &key) {
+            Property value = parse_property();
+            props.emplace_back(key, std::move(value));
+        });
+        sort_entries(props);
+    }
+
+    void parse_bits(JsonBits &bits)
+    {
+        parse_array([&]() {
+            skip_ws();
+            if (peek() == '"') {
+                std::string value = parse_string();
+                if (value.size() != 1)
+                    error("invalid constant bit '" + value + "'");
+                bits.push_back(-int(value.at(0)));
+            } else {
+                bits.push_back(parse_int());
+            }
+        });
+    }
+
+    bool parse_flag()
+    {
+        skip_ws();
+        int c = peek();
+        if (c == 't' || c == 'f' || c == 'n')
+            return parse_literal();
+        return parse_int() != 0;
+    }
+
+    void parse_port(JsonPort &port)
+    {
+        parse_object([&](const std::string &key) {
+            if (key == "direction")
+                port.direction = parse_string();
+            else if (key == "bits")
+                parse_bits(port.bits);
+            else if (key == "offset")
+                port.offset = parse_int();
+            else if (key == "upto")
+                port.upto = parse_flag();
+            else if (key == "attributes")
+                parse_properties(port.attrs);
+            else
+                skip_value();
+        });
+    }
+
+    void parse_cell(JsonCell &cell)
+    {
+        parse_object([&](const std::string &key) {
+            if (key == "type") {
+                cell.type = parse_string();
+            } else if (key == "attributes") {
+                parse_properties(cell.attrs);
+            } else if (key == "parameters") {
+                parse_properties(cell.params);
+            } else if (key == "port_directions") {
+                parse_object([&](const std::string &port) {
+                    skip_ws();
+                    cell.port_dirs.emplace_back(port, lookup_portdir(parse_string()));
+                });
+                sort_entries(cell.port_dirs);
+            } else if (key == "connections") {
+                parse_object([&](const std::string &port) {
+                    cell.conns.emplace_back(port, JsonBits());
+                    parse_bits(cell.conns.back().second);
+                });
+                sort_entries(cell.conns);
+            } else {
+                skip_value();
+            }
+        });
+    }
+
+    void parse_netname(JsonNetname &net)
+    {
+        parse_object([&](const std::string &key) {
+            if (key == "bits")
+                parse_bits(net.bits);
+            else if (key == "offset")
+                net.offset = parse_int();
+            else if (key == "upto")
+                net.upto = parse_flag();
+            else if (key == "attributes")
+                parse_properties(net.attrs);
+            else
+                skip_value();
+        });
     }
 
-    template <typename TFunc> void foreach_port_dir(CellDataType &cell, TFunc Func) const
+    void parse_module(JsonModule &mod)
     {
-        for (const auto &pdir : cell["port_directions"].object_items())
-            Func(pdir.first, lookup_portdir(pdir.second.string_value()));
+        parse_object([&](const std::string &key) {
+            if (key == "attributes") {
+                parse_properties(mod.attrs);
+            } else if (key == "settings") {
+                parse_properties(mod.settings);
+            } else if (key == "ports") {
+                parse_object([&](const std::string &name) {
+                    mod.ports.emplace_back(name, JsonPort());
+                    parse_port(mod.ports.back().second);
+                });
+                sort_entries(mod.ports);
+            } else if (key == "cells") {
+                parse_object([&](const std::string &name) {
+                    mod.cells.emplace_back(name, JsonCell());
+                    parse_cell(mod.cells.back().second);
+                });
+                sort_entries(mod.cells);
+            } else if (key == "netnames") {
+                parse_object([&](const std::string &name) {
+                    mod.netnames.emplace_back(name, JsonNetname());
+                    parse_netname(mod.netnames.back().second);
+                });
+                sort_entries(mod.netnames);
+            } else {
+                skip_value();
+            }
+        });
     }
 
-    template <typename TFunc> void foreach_port_conn(CellDataType &cell, TFunc Func) const
+    // Returns false if there is no "modules" member
+    bool parse_netlist(JsonEntries<JsonModule> &modules)
     {
-        for (const auto &pconn : cell["connections"].object_items())
-            Func(pconn.first, pconn.second.array_items());
+        bool found_modules = false;
+        skip_ws();
+        if (peek() != '{')
+            error("expected an object");
+        parse_object([&](const std::string &key) {
+            if (key == "modules") {
+                found_modules = true;
+                parse_object([&](const std::string &name) {
+                    modules.emplace_back(name, JsonModule());
+                    parse_module(modules.back().second);
+                });
+                sort_entries(modules);
+            } else {
+                skip_value();
+            }
+        });
+        skip_ws();
+        if (peek() != EOF)
+            error("unexpected data after the end of the netlist");
+        return found_modules;
     }
+};
+
+struct JsonFrontendImpl
+{
+    // See specification in frontend_base.h
+    JsonFrontendImpl(const JsonEntries<JsonModule> &modules) : modules(modules){};
+    const JsonEntries<JsonModule> &modules;
+    typedef JsonModule ModuleDataType;
+    typedef JsonPort ModulePortDataType;
+    typedef JsonCell CellDataType;
+    typedef JsonNetname NetnameDataType;
+    typedef JsonBits BitVectorDataType;
+
+    template <typename TFunc> void foreach_module(TFunc Func) const
+    {
+        for (const auto &mod : modules)
+            Func(mod.first, mod.second);
+    }
+
+    template <typename TFunc> void foreach_port(const ModuleDataType &mod, TFunc Func) const
+    {
+        for (const auto &port : mod.ports)
+            Func(port.first, port.second);
+    }
+
+    template <typename TFunc> void foreach_cell(const ModuleDataType &mod, TFunc Func) const
+    {
+        for (const auto &cell : mod.cells)
+            Func(cell.first, cell.second);
+    }
+
+    template <typename TFunc> void foreach_netname(const ModuleDataType &mod, TFunc Func) const
+    {
+        for (const auto &netname : mod.netnames)
+            Func(netname.first, netname.second);
+    }
+
+    PortType get_port_dir(const ModulePortDataType &port) const { return lookup_portdir(port.direction); }
+
+    template <typename T> int get_array_offset(const T &obj) const { return obj.offset; }
+
+    template <typename T> bool is_array_upto(const T &obj) const { return obj.upto; }
 
-    BitVectorDataType &get_net_bits(NetnameDataType &net) const { return net["bits"].array_items(); }
+    const BitVectorDataType &get_port_bits(const ModulePortDataType &port) const { return port.bits; }
 
-    int get_vector_length(BitVectorDataType &bits) const { return int(bits.size()); }
+    const std::string &get_cell_type(const CellDataType &cell) const { return cell.type; }
 
-    bool is_vector_bit_constant(BitVectorDataType &bits, int i) const
+    template <typename T, typename TFunc> void foreach_attr(const T &obj, TFunc Func) const
+    {
+        for (const auto &attr : obj.attrs)
+            Func(attr.first, attr.second);
+    }
+
+    template <typename TFunc> void foreach_param(const CellDataType &cell, TFunc Func) const
+    {
+        for (const auto &param : cell.params)
+            Func(param.first, param.second);
+    }
+
+    template <typename TFunc> void foreach_setting(const ModuleDataType &mod, TFunc Func) const
+    {
+        for (const auto &setting : mod.settings)
+            Func(setting.first, setting.second);
+    }
+
+    template <typename TFunc> void foreach_port_dir(const CellDataType &cell, TFunc Func) const
+    {
+        for (const auto &pdir : cell.port_dirs)
+            Func(pdir.first, pdir.second);
+    }
+
+    template <typename TFunc> void foreach_port_conn(const CellDataType &cell, TFunc Func) const
+    {
+        for (const auto &pconn : cell.conns)
+            Func(pconn.first, pconn.second);
+    }
+
+    const BitVectorDataType &get_net_bits(const NetnameDataType &net) const { return net.bits; }
+
+    int get_vector_length(const BitVectorDataType &bits) const { return int(bits.size()); }
+
+    bool is_vector_bit_constant(const BitVectorDataType &bits, int i) const
     {
         NPNR_ASSERT(i < int(bits.size()));
-        return bits[i].is_string();
+        return bits[i] < 0;
     }
 
-    char get_vector_bit_constval(BitVectorDataType &bits, int i) const
+    char get_vector_bit_constval(const BitVectorDataType &bits, int i) const
     {
-        auto s = bits.at(i).string_value();
-        NPNR_ASSERT(s.size() == 1);
-        return s.at(0);
+        NPNR_ASSERT(bits.at(i) < 0);
+        return char(-bits.at(i));
     }
 
-    int get_vector_bit_signal(BitVectorDataType &bits, int i) const
+    int get_vector_bit_signal(const BitVectorDataType &bits, int i) const
     {
-        NPNR_ASSERT(bits.at(i).is_number());
-        return bits.at(i).int_value();
+        NPNR_ASSERT(bits.at(i) >= 0);
+        return bits.at(i);
     }
 };
 
+} // namespace
+
 bool parse_json(std::istream &in, const std::string &filename, Context *ctx)
 {
-    Json root;
+    JsonEntries<JsonModule> modules;
     {
         if (!in)
             log_error("Failed to open JSON file '%s'.\n", filename.c_str());
-        std::string json_str((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-        std::string error;
-        root = Json::parse(json_str, error, JsonParse::COMMENTS);
-        if (root.is_null())
-            log_error("Failed to parse JSON file '%s': %s.\n", filename.c_str(), error.c_str());
-        root = root["modules"];
-        if (root.is_null())
+        if (!JsonReader(in, filename).parse_netlist(modules))
             log_error("JSON file '%s' doesn't look like a netlist (doesn't contain \"modules\" key)\n",
                       filename.c_str());
     }
-    GenericFrontend<JsonFrontendImpl>(ctx, JsonFrontendImpl(root))();
+    GenericFrontend<JsonFrontendImpl>(ctx, JsonFrontendImpl(modules))();
     return true;
 }
 
+bool read_json_routing(std::istream &in, const std::string &filename, Context *ctx,
+                       std::unordered_map<IdString, std::vector<std::pair<WireId, PipId>>> &routing)
+{
+    try {
+        JsonEntries<JsonModule> modules;
+        if (!in)
+            log_error("Failed to open JSON file '%s'.\n", filename.c_str());
+        if (!JsonReader(in, filename).parse_netlist(modules))
+            log_error("JSON file '%s' doesn't look like a netlist (doesn't contain \"modules\" key)\n",
+                      filename.c_str());
+        // The ROUTING attribute is a list of wire;pip;strength entries, where the wire may be left out if there is a
+        // pip, as it is the pip's destination
+        for (auto &mod : modules)
+            for (auto &netname : mod.second.netnames)
+                for (auto &attr : netname.second.attrs) {
+                    if (attr.first != "ROUTING" || !attr.second.is_string)
+                        continue;
+                    std::vector<std::pair<WireId, PipId>> net;
+                    const std::string &value = attr.second.str;
+                    std::vector<std::string> fields;
+                    for (size_t start = 0;;) {
+                        size_t end = value.find(';', start);
+                        fields.push_back(value.substr(start, end - start));
+                        if (end == std::string::npos)
+                            break;
+                        start = end + 1;
+                    }
+                    for (size_t i = 0; i + 2 < fields.size(); i += 3) {
+                        PipId pip = fields[i + 1].empty() ? PipId() : ctx->getPipByName(ctx->id(fields[i + 1]));
+                        WireId wire;
+                        if (!fields[i + 1].empty())
+                            wire = (pip == PipId()) ? WireId() : ctx->getPipDstWire(pip);
+                        else
+                            wire = ctx->getWireByName(ctx->id(fields[i]));
+                        net.emplace_back(wire, pip);
+                    }
+                    if (!net.empty())
+                        routing[ctx->id(netname.first)] = std::move(net);
+                }
+        return true;
+    } catch (log_execution_error_exception) {
+        return false;
+    }
+}
+
+bool read_json_placement(std::istream &in, const std::string &filename, Context *ctx,
+                         std::unordered_map<IdString, BelId> &placement)
+{
+    try {
+        JsonEntries<JsonModule> modules;
+        if (!in)
+            log_error("Failed to open JSON file '%s'.\n", filename.c_str());
+        if (!JsonReader(in, filename).parse_netlist(modules))
+            log_error("JSON file '%s' doesn't look like a netlist (doesn't contain \"modules\" key)\n",
+                      filename.c_str());
+        // A design written by nextpnr is a single flattened module, with the bel of each cell as an attribute
+        for (auto &mod : modules)
+            for (auto &cell : mod.second.cells)
+                for (auto &attr : cell.second.attrs) {
+                    if (attr.first != "NEXTPNR_BEL" || !attr.second.is_string)
+                        continue;
+                    BelId bel = ctx->getBelByName(ctx->id(attr.second.as_string()));
+                    if (bel != BelId())
+                        placement[ctx->id(cell.first)] = bel;
+                }
+        return true;
+    } catch (log_execution_error_exception) {
+        return false;
+    }
+}
+
 NEXTPNR_NAMESPACE_END
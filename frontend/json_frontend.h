@@ -22,5 +22,11 @@
 NEXTPNR_NAMESPACE_BEGIN
 
 bool parse_json(std::istream &in, const std::string &filename, Context *ctx);
+// Read just the routing of each routed net of a design written by nextpnr, by net name; see bind_net_routing
+bool read_json_routing(std::istream &in, const std::string &filename, Context *ctx,
+                       std::unordered_map<IdString, std::vector<std::pair<WireId, PipId>>> &routing);
+// Read just the bel of each placed cell of a design written by nextpnr, by cell name, leaving out unknown bels
+bool read_json_placement(std::istream &in, const std::string &filename, Context *ctx,
+                         std::unordered_map<IdString, BelId> &placement);
 
 NEXTPNR_NAMESPACE_END
@@ -117,15 +117,50 @@ struct Arch : BaseCtx
 {
     std::string chipName;
 
-    std::unordered_map<IdString, WireInfo> wires;
-    std::unordered_map<IdString, PipInfo> pips;
-    std::unordered_map<IdString, BelInfo> bels;
+    // Wires, pips and bels are stored densely in the order they were added. The IdString naming each one is still its
+    // id, and is mapped to its position by the *_index tables, which are indexed by the IdString index (-1 if absent)
+    std::vector<WireInfo> wires;
+    std::vector<PipInfo> pips;
+    std::vector<BelInfo> bels;
+    std::vector<int> wire_index, pip_index, bel_index;
     std::unordered_map<GroupId, GroupInfo> groups;
 
+    static int dense_index(const std::vector<int> &table, IdString name)
+    {
+        return (name.index >= 0 && name.index < int(table.size())) ? table[name.index] : -1;
+    }
+    static void set_dense_index(std::vector<int> &table, IdString name, int index)
+    {
+        if (name.index >= int(table.size()))
+            table.resize(name.index + 1, -1);
+        table[name.index] = index;
+    }
+
     // These functions include useful errors if not found
-    WireInfo &wire_info(IdString wire);
-    PipInfo &pip_info(IdString wire);
-    BelInfo &bel_info(IdString wire);
+    const WireInfo &wire_info(IdString wire) const
+    {
+        int index = dense_index(wire_index, wire);
+        if (index < 0)
+            NPNR_ASSERT_FALSE_STR("no wire named " + wire.str(this));
+        return wires[index];
+    }
+    const PipInfo &pip_info(IdString pip) const
+    {
+        int index = dense_index(pip_index, pip);
+        if (index < 0)
+            NPNR_ASSERT_FALSE_STR("no pip named " + pip.str(this));
+        return pips[index];
+    }
+    const BelInfo &bel_info(IdString bel) const
+    {
+        int index = dense_index(bel_index, bel);
+        if (index < 0)
+            NPNR_ASSERT_FALSE_STR("no bel named " + bel.str(this));
+        return bels[index];
+    }
+    WireInfo &wire_info(IdString wire) { return const_cast<WireInfo &>(static_cast<const Arch *>(this)->wire_info(wire)); }
+    PipInfo &pip_info(IdString pip) { return const_cast<PipInfo &>(static_cast<const Arch *>(this)->pip_info(pip)); }
+    BelInfo &bel_info(IdString bel) { return const_cast<BelInfo &>(static_cast<const Arch *>(this)->bel_info(bel)); }
 
     std::vector<IdString> bel_ids, wire_ids, pip_ids;
 
@@ -134,12 +169,14 @@ struct Arch : BaseCtx
 
     std::unordered_map<DecalId, std::vector<GraphicElement>> decal_graphics;
 
-    int gridDimX, gridDimY;
+    int gridDimX = 0, gridDimY = 0;
     std::vector<std::vector<int>> tileBelDimZ;
     std::vector<std::vector<int>> tilePipDimZ;
 
     std::unordered_map<IdString, CellTiming> cellTiming;
 
+    // Preallocate storage for a device of the given size, before adding its wires, pips and bels
+    void reserveGraph(int num_wires, int num_pips, int num_bels);
     void addWire(IdString name, IdString type, int x, int y);
     void addPip(IdString name, IdString type, IdString srcWire, IdString dstWire, DelayInfo delay, Loc loc);
 
@@ -171,6 +208,11 @@ struct Arch : BaseCtx
     void addCellTimingSetupHold(IdString cell, IdString port, IdString clock, DelayInfo setup, DelayInfo hold);
     void addCellTimingClockToOut(IdString cell, IdString port, IdString clock, DelayInfo clktoq);
 
+    // Save everything added through the construction API above to a binary device file, or load one into an empty
+    // Arch, so that a device built by a script can be reused without running the script again
+    void writeDevice(const std::string &filename) const;
+    void readDevice(const std::string &filename);
+
     // ---------------------------------------------------------------
     // Common Arch API. Every arch must provide the following methods.
 
@@ -251,6 +293,12 @@ struct Arch : BaseCtx
 
     delay_t estimateDelay(WireId src, WireId dst) const;
     delay_t predictDelay(const NetInfo *net_info, const PortRef &sink) const;
+    // predictDelay only depends on the cell types and ports of the arc, and the distance between the bels when they
+    // are in different tiles; so PredictDelayCache may memoise it
+    static const bool predictDelayCacheable = true;
+    int getPredictDelayClass(const NetInfo *net_info, const PortRef &sink) const { return 0; }
+    // WireId and PipId hold IdStrings, whose indices differ between runs, so the routing graph can't be cached
+    static const bool routeGraphCacheable = false;
     delay_t getDelayEpsilon() const { return 0.001; }
     delay_t getRipupDelayPenalty() const { return 0.015; }
     float getDelayNS(delay_t v) const { return v; }
@@ -284,7 +332,12 @@ struct Arch : BaseCtx
     TimingClockingInfo getPortClockingInfo(const CellInfo *cell, IdString port, int index) const;
 
     bool isValidBelForCell(CellInfo *cell, BelId bel) const;
+    // Preference of the initial placer among valid Bels; lower is better. No preference on this arch
+    int scoreBelForCell(CellInfo *cell, BelId bel) const { return 0; }
     bool isBelLocationValid(BelId bel) const;
+    // As isBelLocationValid, but as if each Bel in overlay were bound to the given cell (or unbound, for nullptr)
+    // instead. Only Bels in the same tile as bel are looked up in overlay
+    bool isBelLocationValidWith(BelId bel, const std::unordered_map<BelId, CellInfo *> &overlay) const;
 
     static const std::string defaultPlacer;
     static const std::vector<std::string> availablePlacers;
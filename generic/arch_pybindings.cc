@@ -53,9 +53,9 @@ void arch_wrap_python(py::module &m)
 
     auto ctx_cls = py::class_<Context, Arch>(m, "Context")
                            .def("checksum", &Context::checksum)
-                           .def("pack", &Context::pack)
-                           .def("place", &Context::place)
-                           .def("route", &Context::route);
+                           .def("pack", &Context::pack, release_gil())
+                           .def("place", &Context::place, release_gil())
+                           .def("route", &Context::route, release_gil());
 
     py::class_<BelPin>(m, "BelPin").def_readwrite("bel", &BelPin::bel).def_readwrite("pin", &BelPin::pin);
 
@@ -150,6 +150,14 @@ void arch_wrap_python(py::module &m)
 
     fn_wrapper_2a_v<Context, decltype(&Context::addClock), &Context::addClock, conv_from_str<IdString>,
                     pass_through<float>>::def_wrap(ctx_cls, "addClock");
+    fn_wrapper_3a_v<Context, decltype(&Context::addFalsePath), &Context::addFalsePath, conv_from_str<IdString>,
+                    conv_from_str<IdString>, conv_from_str<IdString>>::def_wrap(ctx_cls, "addFalsePath");
+    fn_wrapper_4a_v<Context, decltype(&Context::addMulticyclePath), &Context::addMulticyclePath,
+                    conv_from_str<IdString>, conv_from_str<IdString>, conv_from_str<IdString>,
+                    pass_through<int>>::def_wrap(ctx_cls, "addMulticyclePath");
+    fn_wrapper_4a_v<Context, decltype(&Context::addMaxDelay), &Context::addMaxDelay, conv_from_str<IdString>,
+                    conv_from_str<IdString>, conv_from_str<IdString>, pass_through<float>>::def_wrap(ctx_cls,
+                                                                                                    "addMaxDelay");
 
     // Generic arch construction API
     fn_wrapper_4a_v<Context, decltype(&Context::addWire), &Context::addWire, conv_from_str<IdString>,
@@ -161,6 +169,39 @@ void arch_wrap_python(py::module &m)
                     pass_through<Loc>>::def_wrap(ctx_cls, "addPip", "name"_a, "type"_a, "srcWire"_a, "dstWire"_a,
                                                  "delay"_a, "loc"_a);
 
+    fn_wrapper_3a_v<Context, decltype(&Context::reserveGraph), &Context::reserveGraph, pass_through<int>,
+                    pass_through<int>, pass_through<int>>::def_wrap(ctx_cls, "reserveGraph", "num_wires"_a,
+                                                                    "num_pips"_a, "num_bels"_a);
+    // Bulk forms of addWire and addPip, taking a sequence per argument so that a device can be built without a
+    // Python call per wire or pip
+    ctx_cls.def(
+            "addWires",
+            [](Context &ctx, py::sequence names, py::sequence types, py::sequence xs, py::sequence ys) {
+                size_t count = py::len(names);
+                if (py::len(types) != count || py::len(xs) != count || py::len(ys) != count)
+                    throw std::invalid_argument("addWires arguments must all have the same length");
+                for (size_t i = 0; i < count; i++)
+                    ctx.addWire(ctx.id(names[i].cast<std::string>()), ctx.id(types[i].cast<std::string>()),
+                                xs[i].cast<int>(), ys[i].cast<int>());
+            },
+            "names"_a, "types"_a, "xs"_a, "ys"_a);
+    ctx_cls.def(
+            "addPips",
+            [](Context &ctx, py::sequence names, py::sequence types, py::sequence srcWires, py::sequence dstWires,
+               py::sequence delays, py::sequence locs) {
+                size_t count = py::len(names);
+                if (py::len(types) != count || py::len(srcWires) != count || py::len(dstWires) != count ||
+                    py::len(delays) != count || py::len(locs) != count)
+                    throw std::invalid_argument("addPips arguments must all have the same length");
+                for (size_t i = 0; i < count; i++)
+                    ctx.addPip(ctx.id(names[i].cast<std::string>()), ctx.id(types[i].cast<std::string>()),
+                               ctx.id(srcWires[i].cast<std::string>()), ctx.id(dstWires[i].cast<std::string>()),
+                               delays[i].cast<DelayInfo>(), locs[i].cast<Loc>());
+            },
+            "names"_a, "types"_a, "srcWires"_a, "dstWires"_a, "delays"_a, "locs"_a);
+    ctx_cls.def("writeDevice", &Context::writeDevice, "filename"_a, release_gil());
+    ctx_cls.def("readDevice", &Context::readDevice, "filename"_a, release_gil());
+
     fn_wrapper_4a_v<Context, decltype(&Context::addBel), &Context::addBel, conv_from_str<IdString>,
                     conv_from_str<IdString>, pass_through<Loc>, pass_through<bool>>::def_wrap(ctx_cls, "addBel",
                                                                                               "name"_a, "type"_a,
@@ -0,0 +1,475 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2020  nextpnr contributors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "log.h"
+#include "nextpnr.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// A device file holds everything added through the construction API, so that a device built once by a script can be
+// loaded directly on later runs. It starts with the magic, then a table of every string used, which the rest of the
+// file refers to by index. Wires, pips and bels follow in the order they were added, then the bel pins, in the order
+// they appear on their wires, so that loading rebuilds the same wire and pip order.
+
+namespace {
+const char device_file_magic[8] = {'N', 'P', 'N', 'R', 'G', 'D', '0', '1'};
+
+struct DeviceFileWriter
+{
+    std::ostringstream body;
+    std::vector<IdString> strings;
+    std::unordered_map<IdString, uint32_t> string_index;
+
+    template <typename T> void write(const T &value) { body.write(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+    void write_str(const std::string &s)
+    {
+        write(uint32_t(s.size()));
+        body.write(s.data(), s.size());
+    }
+
+    void write_id(IdString id)
+    {
+        auto found = string_index.find(id);
+        if (found == string_index.end()) {
+            found = string_index.emplace(id, uint32_t(strings.size())).first;
+            strings.push_back(id);
+        }
+        write(found->second);
+    }
+
+    void write_ids(const std::vector<IdString> &ids)
+    {
+        write(uint32_t(ids.size()));
+        for (auto id : ids)
+            write_id(id);
+    }
+
+    void write_delay(const DelayInfo &delay) { write(delay.delay); }
+
+    void write_loc(const Loc &loc)
+    {
+        write(int32_t(loc.x));
+        write(int32_t(loc.y));
+        write(int32_t(loc.z));
+    }
+
+    void write_decal(const DecalXY &decalxy)
+    {
+        write_id(decalxy.decal);
+        write(decalxy.x);
+        write(decalxy.y);
+    }
+
+    void write_attrs(const std::map<IdString, std::string> &attrs)
+    {
+        write(uint32_t(attrs.size()));
+        for (auto &attr : attrs) {
+            write_id(attr.first);
+            write_str(attr.second);
+        }
+    }
+};
+
+struct DeviceFileReader
+{
+    const std::string &filename;
+    std::istream &in;
+    std::vector<IdString> strings;
+
+    DeviceFileReader(const std::string &filename, std::istream &in) : filename(filename), in(in) {}
+
+    void check()
+    {
+        if (!in)
+            log_error("Device file '%s' is truncated.\n", filename.c_str());
+    }
+
+    template <typename T> T read()
+    {
+        T value;
+        in.read(reinterpret_cast<char *>(&value), sizeof(T));
+        check();
+        return value;
+    }
+
+    std::string read_str()
+    {
+        std::string s(read<uint32_t>(), '\0');
+        in.read(&s[0], s.size());
+        check();
+        return s;
+    }
+
+    IdString read_id()
+    {
+        uint32_t index = read<uint32_t>();
+        if (index >= strings.size())
+            log_error("Device file '%s' is corrupt.\n", filename.c_str());
+        return strings[index];
+    }
+
+    std::vector<IdString> read_ids()
+    {
+        std::vector<IdString> ids(read<uint32_t>());
+        for (auto &id : ids)
+            id = read_id();
+        return ids;
+    }
+
+    DelayInfo read_delay()
+    {
+        DelayInfo delay;
+        delay.delay = read<delay_t>();
+        return delay;
+    }
+
+    Loc read_loc()
+    {
+        Loc loc;
+        loc.x = read<int32_t>();
+        loc.y = read<int32_t>();
+        loc.z = read<int32_t>();
+        return loc;
+    }
+
+    DecalXY read_decal()
+    {
+        DecalXY decalxy;
+        decalxy.decal = read_id();
+        decalxy.x = read<float>();
+        decalxy.y = read<float>();
+        return decalxy;
+    }
+
+    void read_attrs(std::map<IdString, std::string> &attrs)
+    {
+        uint32_t count = read<uint32_t>();
+        for (uint32_t i = 0; i < count; i++) {
+            IdString key = read_id();
+            attrs[key] = read_str();
+        }
+    }
+};
+} // namespace
+
+void Arch::writeDevice(const std::string &filename) const
+{
+    DeviceFileWriter w;
+
+    w.write(int32_t(args.K));
+    w.write(args.delayScale);
+    w.write(args.delayOffset);
+    w.write_str(chipName);
+
+    w.write(uint32_t(wires.size()));
+    for (auto &wi : wires) {
+        w.write_id(wi.name);
+        w.write_id(wi.type);
+        w.write(int32_t(wi.x));
+        w.write(int32_t(wi.y));
+        w.write_decal(wi.decalxy);
+        w.write_attrs(wi.attrs);
+    }
+
+    w.write(uint32_t(pips.size()));
+    for (auto &pi : pips) {
+        w.write_id(pi.name);
+        w.write_id(pi.type);
+        w.write_id(pi.srcWire);
+        w.write_id(pi.dstWire);
+        w.write_delay(pi.delay);
+        w.write_loc(pi.loc);
+        w.write_decal(pi.decalxy);
+        w.write_attrs(pi.attrs);
+    }
+
+    w.write(uint32_t(bels.size()));
+    for (auto &bi : bels) {
+        w.write_id(bi.name);
+        w.write_id(bi.type);
+        w.write_loc(Loc(bi.x, bi.y, bi.z));
+        w.write(uint8_t(bi.gb));
+        w.write_decal(bi.decalxy);
+        w.write_attrs(bi.attrs);
+    }
+
+    uint32_t num_pins = 0;
+    for (auto &wi : wires)
+        num_pins += uint32_t(wi.bel_pins.size());
+    w.write(num_pins);
+    for (auto &wi : wires) {
+        for (auto &bp : wi.bel_pins) {
+            w.write_id(bp.bel);
+            w.write_id(bp.pin);
+            w.write_id(wi.name);
+            w.write(int32_t(bel_info(bp.bel).pins.at(bp.pin).type));
+        }
+    }
+
+    // Groups, decals and timing are hash maps, so they are written sorted by name to keep the file reproducible
+    std::vector<GroupId> group_names;
+    for (auto &group : groups)
+        group_names.push_back(group.first);
+    std::sort(group_names.begin(), group_names.end(),
+              [&](GroupId a, GroupId b) { return a.str(this) < b.str(this); });
+    w.write(uint32_t(group_names.size()));
+    for (auto group : group_names) {
+        auto &gi = groups.at(group);
+        w.write_id(group);
+        w.write_ids(gi.bels);
+        w.write_ids(gi.wires);
+        w.write_ids(gi.pips);
+        w.write_ids(gi.groups);
+        w.write_decal(gi.decalxy);
+    }
+
+    std::vector<DecalId> decal_names;
+    for (auto &decal : decal_graphics)
+        decal_names.push_back(decal.first);
+    std::sort(decal_names.begin(), decal_names.end(),
+              [&](DecalId a, DecalId b) { return a.str(this) < b.str(this); });
+    w.write(uint32_t(decal_names.size()));
+    for (auto decal : decal_names) {
+        auto &graphics = decal_graphics.at(decal);
+        w.write_id(decal);
+        w.write(uint32_t(graphics.size()));
+        for (auto &ge : graphics) {
+            w.write(int32_t(ge.type));
+            w.write(int32_t(ge.style));
+            w.write(ge.x1);
+            w.write(ge.y1);
+            w.write(ge.x2);
+            w.write(ge.y2);
+            w.write(ge.z);
+            w.write_str(ge.text);
+        }
+    }
+
+    std::vector<IdString> timing_cells;
+    for (auto &tmg : cellTiming)
+        timing_cells.push_back(tmg.first);
+    std::sort(timing_cells.begin(), timing_cells.end(),
+              [&](IdString a, IdString b) { return a.str(this) < b.str(this); });
+    w.write(uint32_t(timing_cells.size()));
+    for (auto cell : timing_cells) {
+        auto &tmg = cellTiming.at(cell);
+        w.write_id(cell);
+        std::map<std::string, std::pair<IdString, TimingPortClass>> port_classes;
+        for (auto &pc : tmg.portClasses)
+            port_classes[pc.first.str(this)] = pc;
+        w.write(uint32_t(port_classes.size()));
+        for (auto &pc : port_classes) {
+            w.write_id(pc.second.first);
+            w.write(int32_t(pc.second.second));
+        }
+        std::map<std::pair<std::string, std::string>, std::pair<CellDelayKey, DelayInfo>> comb_delays;
+        for (auto &cd : tmg.combDelays)
+            comb_delays[std::make_pair(cd.first.from.str(this), cd.first.to.str(this))] = cd;
+        w.write(uint32_t(comb_delays.size()));
+        for (auto &cd : comb_delays) {
+            w.write_id(cd.second.first.from);
+            w.write_id(cd.second.first.to);
+            w.write_delay(cd.second.second);
+        }
+        std::map<std::string, IdString> clocked_ports;
+        for (auto &ci : tmg.clockingInfo)
+            clocked_ports[ci.first.str(this)] = ci.first;
+        w.write(uint32_t(clocked_ports.size()));
+        for (auto &port : clocked_ports) {
+            auto &infos = tmg.clockingInfo.at(port.second);
+            w.write_id(port.second);
+            w.write(uint32_t(infos.size()));
+            for (auto &ci : infos) {
+                w.write_id(ci.clock_port);
+                w.write(int32_t(ci.edge));
+                w.write_delay(ci.setup);
+                w.write_delay(ci.hold);
+                w.write_delay(ci.clockToQ);
+            }
+        }
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out)
+        log_error("Failed to open device file '%s' for writing.\n", filename.c_str());
+    out.write(device_file_magic, sizeof(device_file_magic));
+    uint32_t num_strings = uint32_t(w.strings.size());
+    out.write(reinterpret_cast<const char *>(&num_strings), sizeof(num_strings));
+    for (auto id : w.strings) {
+        const std::string &s = id.str(this);
+        uint32_t len = uint32_t(s.size());
+        out.write(reinterpret_cast<const char *>(&len), sizeof(len));
+        out.write(s.data(), len);
+    }
+    out << w.body.rdbuf();
+    if (!out)
+        log_error("Failed to write device file '%s'.\n", filename.c_str());
+    log_info("Wrote device with %d wires, %d pips and %d bels to '%s'.\n", int(wires.size()), int(pips.size()),
+             int(bels.size()), filename.c_str());
+}
+
+void Arch::readDevice(const std::string &filename)
+{
+    if (!wires.empty() || !pips.empty() || !bels.empty())
+        log_error("A device file can only be loaded before any wires, pips or bels are added.\n");
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        log_error("Failed to open device file '%s'.\n", filename.c_str());
+    DeviceFileReader r(filename, in);
+
+    char magic[sizeof(device_file_magic)];
+    in.read(magic, sizeof(magic));
+    if (!in || !std::equal(magic, magic + sizeof(magic), device_file_magic))
+        log_error("'%s' is not a nextpnr-generic device file.\n", filename.c_str());
+    uint32_t num_strings = r.read<uint32_t>();
+    r.strings.reserve(num_strings);
+    for (uint32_t i = 0; i < num_strings; i++)
+        r.strings.push_back(id(r.read_str()));
+
+    args.K = r.read<int32_t>();
+    args.delayScale = r.read<double>();
+    args.delayOffset = r.read<double>();
+    chipName = r.read_str();
+
+    uint32_t num_wires = r.read<uint32_t>();
+    wires.reserve(num_wires);
+    wire_ids.reserve(num_wires);
+    for (uint32_t i = 0; i < num_wires; i++) {
+        IdString name = r.read_id();
+        IdString type = r.read_id();
+        int x = r.read<int32_t>();
+        int y = r.read<int32_t>();
+        addWire(name, type, x, y);
+        wires.back().decalxy = r.read_decal();
+        r.read_attrs(wires.back().attrs);
+    }
+
+    uint32_t num_pips = r.read<uint32_t>();
+    pips.reserve(num_pips);
+    pip_ids.reserve(num_pips);
+    for (uint32_t i = 0; i < num_pips; i++) {
+        IdString name = r.read_id();
+        IdString type = r.read_id();
+        IdString src = r.read_id();
+        IdString dst = r.read_id();
+        DelayInfo delay = r.read_delay();
+        Loc loc = r.read_loc();
+        addPip(name, type, src, dst, delay, loc);
+        pips.back().decalxy = r.read_decal();
+        r.read_attrs(pips.back().attrs);
+    }
+
+    uint32_t num_bels = r.read<uint32_t>();
+    bels.reserve(num_bels);
+    bel_ids.reserve(num_bels);
+    for (uint32_t i = 0; i < num_bels; i++) {
+        IdString name = r.read_id();
+        IdString type = r.read_id();
+        Loc loc = r.read_loc();
+        bool gb = r.read<uint8_t>() != 0;
+        addBel(name, type, loc, gb);
+        bels.back().decalxy = r.read_decal();
+        r.read_attrs(bels.back().attrs);
+    }
+
+    uint32_t num_pins = r.read<uint32_t>();
+    for (uint32_t i = 0; i < num_pins; i++) {
+        IdString bel = r.read_id();
+        IdString pin = r.read_id();
+        IdString wire = r.read_id();
+        switch (r.read<int32_t>()) {
+        case PORT_IN:
+            addBelInput(bel, pin, wire);
+            break;
+        case PORT_OUT:
+            addBelOutput(bel, pin, wire);
+            break;
+        case PORT_INOUT:
+            addBelInout(bel, pin, wire);
+            break;
+        default:
+            log_error("Device file '%s' is corrupt.\n", filename.c_str());
+        }
+    }
+
+    uint32_t num_groups = r.read<uint32_t>();
+    for (uint32_t i = 0; i < num_groups; i++) {
+        auto &gi = groups[r.read_id()];
+        gi.bels = r.read_ids();
+        gi.wires = r.read_ids();
+        gi.pips = r.read_ids();
+        gi.groups = r.read_ids();
+        gi.decalxy = r.read_decal();
+    }
+
+    uint32_t num_decals = r.read<uint32_t>();
+    for (uint32_t i = 0; i < num_decals; i++) {
+        auto &graphics = decal_graphics[r.read_id()];
+        graphics.resize(r.read<uint32_t>());
+        for (auto &ge : graphics) {
+            ge.type = GraphicElement::type_t(r.read<int32_t>());
+            ge.style = GraphicElement::style_t(r.read<int32_t>());
+            ge.x1 = r.read<float>();
+            ge.y1 = r.read<float>();
+            ge.x2 = r.read<float>();
+            ge.y2 = r.read<float>();
+            ge.z = r.read<float>();
+            ge.text = r.read_str();
+        }
+    }
+
+    uint32_t num_timing_cells = r.read<uint32_t>();
+    for (uint32_t i = 0; i < num_timing_cells; i++) {
+        auto &tmg = cellTiming[r.read_id()];
+        uint32_t num_port_classes = r.read<uint32_t>();
+        for (uint32_t j = 0; j < num_port_classes; j++) {
+            IdString port = r.read_id();
+            tmg.portClasses[port] = TimingPortClass(r.read<int32_t>());
+        }
+        uint32_t num_comb_delays = r.read<uint32_t>();
+        for (uint32_t j = 0; j < num_comb_delays; j++) {
+            CellDelayKey key;
+            key.from = r.read_id();
+            key.to = r.read_id();
+            tmg.combDelays[key] = r.read_delay();
+        }
+        uint32_t num_clocked_ports = r.read<uint32_t>();
+        for (uint32_t j = 0; j < num_clocked_ports; j++) {
+            auto &infos = tmg.clockingInfo[r.read_id()];
+            infos.resize(r.read<uint32_t>());
+            for (auto &ci : infos) {
+                ci.clock_port = r.read_id();
+                ci.edge = ClockEdge(r.read<int32_t>());
+                ci.setup = r.read_delay();
+                ci.hold = r.read_delay();
+                ci.clockToQ = r.read_delay();
+            }
+        }
+    }
+
+    log_info("Loaded device with %d wires, %d pips and %d bels from '%s'.\n", int(wires.size()), int(pips.size()),
+             int(bels.size()), filename.c_str());
+    refreshUi();
+}
+
+NEXTPNR_NAMESPACE_END
@@ -33,6 +33,7 @@ class GenericCommandHandler : public CommandHandler
     GenericCommandHandler(int argc, char **argv);
     virtual ~GenericCommandHandler(){};
     std::unique_ptr<Context> createContext(std::unordered_map<std::string, Property> &values) override;
+    std::vector<std::string> getContextOptions() override { return {"no-iobs", "device-file"}; }
     void setupArchContext(Context *ctx) override{};
     void customBitstream(Context *ctx) override;
 
@@ -47,6 +48,7 @@ po::options_description GenericCommandHandler::getArchOptions()
     po::options_description specific("Architecture specific options");
     specific.add_options()("generic", "set device type to generic");
     specific.add_options()("no-iobs", "disable automatic IO buffer insertion");
+    specific.add_options()("device-file", po::value<std::string>(), "load the device from a file written by writeDevice");
     return specific;
 }
 
@@ -63,6 +65,8 @@ std::unique_ptr<Context> GenericCommandHandler::createContext(std::unordered_map
     auto ctx = std::unique_ptr<Context>(new Context(chipArgs));
     if (vm.count("no-iobs"))
         ctx->settings[ctx->id("disable_iobs")] = Property::State::S1;
+    if (vm.count("device-file"))
+        ctx->readDevice(vm["device-file"].as<std::string>());
     return ctx;
 }
 
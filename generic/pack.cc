@@ -23,6 +23,7 @@
 #include "cells.h"
 #include "design_utils.h"
 #include "log.h"
+#include "pack_engine.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -32,48 +33,51 @@ static void pack_lut_lutffs(Context *ctx)
 {
     log_info("Packing LUT-FFs..\n");
 
+    // Find the DFF, if any, that each LUT can be packed with: one whose D input is the only load of the LUT output
+    // TODO: LUT cascade
+    PackEngine engine(ctx, ctx->stage_threads("pack", 1));
+    std::vector<CellInfo *> ffs = engine.cells_matching([ctx](const CellInfo *ci) { return is_ff(ctx, ci); });
+    std::unordered_set<const CellInfo *> ff_set(ffs.begin(), ffs.end());
+    const IdString bel_attr = ctx->id("BEL");
+    PackEngine::PairRule lut_ff;
+    lut_ff.driver_pred = [ctx](const CellInfo *ci) { return is_lut(ctx, ci); };
+    lut_ff.driver_port = ctx->id("Q");
+    lut_ff.user_pred = [&ff_set](const CellInfo *ci) { return ff_set.count(ci) != 0; };
+    lut_ff.user_port = ctx->id("D");
+    lut_ff.compatible = [bel_attr](const CellInfo *lut, const CellInfo *dff) {
+        // Locations must match, if both are constrained
+        auto lut_bel = lut->attrs.find(bel_attr);
+        auto dff_bel = dff->attrs.find(bel_attr);
+        return lut_bel == lut->attrs.end() || dff_bel == dff->attrs.end() || lut_bel->second == dff_bel->second;
+    };
+
     std::unordered_set<IdString> packed_cells;
     std::vector<std::unique_ptr<CellInfo>> new_cells;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+    for (auto &pair : engine.match_pairs(lut_ff)) {
+        CellInfo *ci = pair.first, *dff = pair.second;
+        std::unique_ptr<CellInfo> packed =
+                create_generic_cell(ctx, ctx->id("GENERIC_SLICE"), ci->name.str(ctx) + "_LC");
+        std::copy(ci->attrs.begin(), ci->attrs.end(), std::inserter(packed->attrs, packed->attrs.begin()));
+        packed_cells.insert(ci->name);
         if (ctx->verbose)
-            log_info("cell '%s' is of type '%s'\n", ci->name.c_str(ctx), ci->type.c_str(ctx));
-        if (is_lut(ctx, ci)) {
-            std::unique_ptr<CellInfo> packed =
-                    create_generic_cell(ctx, ctx->id("GENERIC_SLICE"), ci->name.str(ctx) + "_LC");
-            std::copy(ci->attrs.begin(), ci->attrs.end(), std::inserter(packed->attrs, packed->attrs.begin()));
-            packed_cells.insert(ci->name);
+            log_info("packed cell %s into %s\n", ci->name.c_str(ctx), packed->name.c_str(ctx));
+        if (dff) {
             if (ctx->verbose)
-                log_info("packed cell %s into %s\n", ci->name.c_str(ctx), packed->name.c_str(ctx));
-            // See if we can pack into a DFF
-            // TODO: LUT cascade
+                log_info("found attached dff %s\n", dff->name.c_str(ctx));
             NetInfo *o = ci->ports.at(ctx->id("Q")).net;
-            CellInfo *dff = net_only_drives(ctx, o, is_ff, ctx->id("D"), true);
-            auto lut_bel = ci->attrs.find(ctx->id("BEL"));
-            bool packed_dff = false;
-            if (dff) {
-                if (ctx->verbose)
-                    log_info("found attached dff %s\n", dff->name.c_str(ctx));
-                auto dff_bel = dff->attrs.find(ctx->id("BEL"));
-                if (lut_bel != ci->attrs.end() && dff_bel != dff->attrs.end() && lut_bel->second != dff_bel->second) {
-                    // Locations don't match, can't pack
-                } else {
-                    lut_to_lc(ctx, ci, packed.get(), false);
-                    dff_to_lc(ctx, dff, packed.get(), false);
-                    ctx->nets.erase(o->name);
-                    if (dff_bel != dff->attrs.end())
-                        packed->attrs[ctx->id("BEL")] = dff_bel->second;
-                    packed_cells.insert(dff->name);
-                    if (ctx->verbose)
-                        log_info("packed cell %s into %s\n", dff->name.c_str(ctx), packed->name.c_str(ctx));
-                    packed_dff = true;
-                }
-            }
-            if (!packed_dff) {
-                lut_to_lc(ctx, ci, packed.get(), true);
-            }
-            new_cells.push_back(std::move(packed));
+            auto dff_bel = dff->attrs.find(bel_attr);
+            lut_to_lc(ctx, ci, packed.get(), false);
+            dff_to_lc(ctx, dff, packed.get(), false);
+            ctx->nets.erase(o->name);
+            if (dff_bel != dff->attrs.end())
+                packed->attrs[bel_attr] = dff_bel->second;
+            packed_cells.insert(dff->name);
+            if (ctx->verbose)
+                log_info("packed cell %s into %s\n", dff->name.c_str(ctx), packed->name.c_str(ctx));
+        } else {
+            lut_to_lc(ctx, ci, packed.get(), true);
         }
+        new_cells.push_back(std::move(packed));
     }
     for (auto pcell : packed_cells) {
         ctx->cells.erase(pcell);
@@ -267,11 +271,25 @@ static void pack_io(Context *ctx)
 }
 
 // Main pack function
+// Clean up the synthesised netlist of buffers, constant logic and unused LUTs
+static void pack_optimise(Context *ctx)
+{
+    NetlistOptCfg cfg;
+    NetlistOptCfg::LutType lut{ctx->id("LUT"), {}, ctx->id("Q"), ctx->id("INIT")};
+    for (int i = 0; i < ctx->args.K; i++)
+        lut.inputs.push_back(ctx->id("I[" + std::to_string(i) + "]"));
+    cfg.luts.push_back(lut);
+    cfg.constants.push_back({ctx->id("GND"), ctx->id("Y"), false});
+    cfg.constants.push_back({ctx->id("VCC"), ctx->id("Y"), true});
+    optimise_netlist(ctx, cfg);
+}
+
 bool Arch::pack()
 {
     Context *ctx = getCtx();
     try {
         log_break();
+        pack_optimise(ctx);
         pack_constants(ctx);
         pack_io(ctx);
         pack_lut_lutffs(ctx);
@@ -0,0 +1,132 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <random>
+#include "../../bba/compress.h"
+#include "embed.h"
+#include "gtest/gtest.h"
+#include "log.h"
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+#if !defined(EXTERNAL_CHIPDB_ROOT) && !defined(WIN32)
+
+namespace {
+// Embedded files are registered for the lifetime of the process, so they and their data are never freed
+const void *embed(const std::string &filename, const std::vector<uint8_t> &data)
+{
+    auto content = new std::vector<uint8_t>(data);
+    new EmbeddedFile(filename, content->data(), content->size());
+    return content->data();
+}
+
+// The chipdb is written in the endianness of the machine that uses it
+bool big_endian()
+{
+    uint16_t one = 1;
+    return *reinterpret_cast<uint8_t *>(&one) == 0;
+}
+} // namespace
+
+TEST(CompressedChipdbTest, uncompressed_passthrough)
+{
+    std::vector<uint8_t> data{1, 2, 3, 4};
+    const void *content = embed("test_plain.bin", data);
+    EXPECT_EQ(get_chipdb("test_plain.bin"), content);
+    EXPECT_EQ(get_chipdb("test_missing.bin"), nullptr);
+}
+
+TEST(CompressedChipdbTest, round_trip)
+{
+    // Three blocks: a compressible one, with long runs and literal sequences for the extended lengths; one of random
+    // data, which is stored; and a short final one
+    std::vector<uint8_t> data;
+    std::mt19937 rng(1);
+    while (data.size() < size_t(compressBlockSize)) {
+        data.insert(data.end(), 1000, uint8_t(data.size() / 1000));
+        for (int i = 0; i < 300; i++)
+            data.push_back(uint8_t(rng()));
+        for (int i = 0; i < 64; i++)
+            data.push_back(uint8_t(i % 7));
+    }
+    data.resize(compressBlockSize);
+    for (int i = 0; i < compressBlockSize; i++)
+        data.push_back(uint8_t(rng()));
+    for (int i = 0; i < 12345; i++)
+        data.push_back(uint8_t(i / 3));
+
+    std::vector<uint8_t> compressed = compressBlob(data, big_endian());
+    ASSERT_LT(compressed.size(), data.size());
+    embed("test_compressed.bin", compressed);
+    const void *raw = get_chipdb("test_compressed.bin");
+    ASSERT_NE(raw, nullptr);
+    EXPECT_EQ(memcmp(raw, data.data(), data.size()), 0);
+    // Decompressed once
+    EXPECT_EQ(get_chipdb("test_compressed.bin"), raw);
+}
+
+TEST(CompressedChipdbTest, corrupt)
+{
+    std::vector<uint8_t> data(5000);
+    for (size_t i = 0; i < data.size(); i++)
+        data.at(i) = uint8_t(i % 13);
+    std::vector<uint8_t> compressed = compressBlob(data, big_endian());
+    // Claim one more byte than the block decompresses to
+    uint64_t raw_size = data.size() + 1;
+    memcpy(compressed.data() + 16, &raw_size, sizeof(raw_size));
+    embed("test_corrupt.bin", compressed);
+    EXPECT_THROW(get_chipdb("test_corrupt.bin"), log_execution_error_exception);
+}
+
+TEST(CompressedChipdbTest, corrupt_header)
+{
+    // Two full blocks and a short one
+    std::vector<uint8_t> data(2 * compressBlockSize + 1000);
+    for (size_t i = 0; i < data.size(); i++)
+        data.at(i) = uint8_t(i % 251);
+    const std::vector<uint8_t> compressed = compressBlob(data, big_endian());
+    int count = 0;
+    auto expect_corrupt = [&](std::vector<uint8_t> file) {
+        std::string filename = "test_corrupt_header" + std::to_string(count++) + ".bin";
+        embed(filename, file);
+        EXPECT_THROW(get_chipdb(filename), log_execution_error_exception) << filename;
+    };
+    auto with_field = [&](size_t offset, uint64_t value, size_t bytes) {
+        std::vector<uint8_t> file = compressed;
+        uint32_t value32 = uint32_t(value);
+        memcpy(file.data() + offset, bytes == 4 ? static_cast<void *>(&value32) : static_cast<void *>(&value), bytes);
+        return file;
+    };
+    // The header is: magic, version, block size, raw size, number of blocks
+    expect_corrupt(with_field(12, 0, 4));
+    // More blocks than the raw size needs, so that the last ones would start past the end of the output
+    expect_corrupt(with_field(24, 4, 4));
+    expect_corrupt(with_field(16, 1000, 8));
+    // Fewer blocks than the raw size needs
+    expect_corrupt(with_field(24, 2, 4));
+    expect_corrupt(with_field(16, data.size() + compressBlockSize, 8));
+    // Block counts and sizes whose product overflows
+    expect_corrupt(with_field(24, 0xFFFFFFFFU, 4));
+    expect_corrupt(with_field(16, uint64_t(1) << 63, 8));
+    // A block table, or block data, that runs past the end of the file
+    expect_corrupt(std::vector<uint8_t>(compressed.begin(), compressed.begin() + 30));
+    expect_corrupt(std::vector<uint8_t>(compressed.begin(), compressed.end() - 1));
+    expect_corrupt(std::vector<uint8_t>(compressed.begin(), compressed.begin() + 20));
+}
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <map>
+#include <random>
+#include "gtest/gtest.h"
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+typedef FlatHashMap<int, int> Map;
+
+// Check that map holds exactly the entries of expected, both when looked up and when iterated over
+void check_contents(const Map &map, const std::map<int, int> &expected)
+{
+    ASSERT_EQ(map.size(), expected.size());
+    for (auto &entry : expected) {
+        ASSERT_EQ(map.count(entry.first), size_t(1)) << "key " << entry.first;
+        ASSERT_EQ(map.at(entry.first), entry.second) << "key " << entry.first;
+    }
+    std::map<int, int> iterated;
+    for (auto &entry : map)
+        ASSERT_TRUE(iterated.insert(entry).second) << "key " << entry.first << " visited twice";
+    ASSERT_EQ(iterated, expected);
+}
+
+// The slot of the index that key is first looked up in, for an index of the given size
+size_t home_slot(int key, size_t slots) { return flat_hash_mix(std::hash<int>()(key)) & (slots - 1); }
+} // namespace
+
+TEST(FlatHashMapTest, erase_reinsert_threshold)
+{
+    // Grow past the size at which an index is built, shrink until it is dropped again, and grow once more
+    Map map;
+    std::map<int, int> expected;
+    for (int i = 0; i < 12; i++) {
+        map[i] = 100 + i;
+        expected[i] = 100 + i;
+        check_contents(map, expected);
+    }
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(map.erase(i), size_t(1));
+        EXPECT_EQ(map.erase(i), size_t(0));
+        expected.erase(i);
+        check_contents(map, expected);
+    }
+    for (int i = 0; i < 12; i++) {
+        auto inserted = map.emplace(i, 200 + i);
+        EXPECT_EQ(inserted.second, i < 10);
+        if (i < 10)
+            expected[i] = 200 + i;
+        check_contents(map, expected);
+    }
+    EXPECT_EQ(map.count(12), size_t(0));
+    EXPECT_TRUE(map.find(12) == map.end());
+}
+
+TEST(FlatHashMapTest, erase_last_and_middle)
+{
+    for (int n : {4, 8, 9, 40}) {
+        Map map;
+        std::map<int, int> expected;
+        for (int i = 0; i < n; i++) {
+            map[i] = i;
+            expected[i] = i;
+        }
+        // The entry stored last
+        int last = (map.end() - 1)->first;
+        EXPECT_EQ(map.erase(last), size_t(1));
+        expected.erase(last);
+        check_contents(map, expected);
+        // An entry in the middle, which the last entry is moved into
+        auto middle = map.begin() + map.size() / 2;
+        int middle_key = middle->first, moved_key = (map.end() - 1)->first;
+        auto next = map.erase(middle);
+        expected.erase(middle_key);
+        ASSERT_TRUE(next != map.end());
+        EXPECT_EQ(next->first, moved_key);
+        check_contents(map, expected);
+        // Erasing the last entry by iterator gives the end
+        EXPECT_TRUE(map.erase(map.end() - 1) == map.end());
+    }
+}
+
+TEST(FlatHashMapTest, probe_wraparound)
+{
+    // 9 to 32 entries are indexed by a table of 64 slots. Fill it with keys that start their probe in the last slot,
+    // so that the probe sequence runs off the end of the table and continues at the start, plus keys that start in
+    // the first slots, which share the wrapped part of it.
+    const size_t slots = 64;
+    std::vector<int> at_end, at_start, others;
+    for (int key = 0; at_end.size() < 6 || at_start.size() < 3 || others.size() < 10; key++) {
+        size_t slot = home_slot(key, slots);
+        if (slot == slots - 1 && at_end.size() < 6)
+            at_end.push_back(key);
+        else if (slot <= 1 && at_start.size() < 3)
+            at_start.push_back(key);
+        else if (slot > 1 && slot < slots - 8 && others.size() < 10)
+            others.push_back(key);
+    }
+
+    Map map;
+    std::map<int, int> expected;
+    for (auto keys : {&others, &at_end, &at_start})
+        for (int key : *keys) {
+            map[key] = key + 1;
+            expected[key] = key + 1;
+        }
+    check_contents(map, expected);
+
+    // Erase the wrapped keys one by one from the front of the chain; each erasure shifts the rest of it back across
+    // the end of the table
+    for (int key : at_end) {
+        EXPECT_EQ(map.erase(key), size_t(1));
+        expected.erase(key);
+        check_contents(map, expected);
+    }
+    for (int key : at_end) {
+        map[key] = -key;
+        expected[key] = -key;
+    }
+    check_contents(map, expected);
+    for (int key : at_start) {
+        EXPECT_EQ(map.erase(key), size_t(1));
+        expected.erase(key);
+        check_contents(map, expected);
+    }
+}
+
+TEST(FlatHashMapTest, erase_while_iterating)
+{
+    for (int n : {6, 20, 100}) {
+        Map map;
+        std::map<int, int> expected;
+        for (int i = 0; i < n; i++)
+            map[i * 7] = i;
+        // Every entry must be visited exactly once, including those moved into the holes left by erasing
+        std::map<int, int> visited;
+        for (auto it = map.begin(); it != map.end();) {
+            EXPECT_TRUE(visited.insert(*it).second) << "key " << it->first << " visited twice";
+            if (it->second % 3 == 0) {
+                it = map.erase(it);
+            } else {
+                expected.insert(*it);
+                ++it;
+            }
+        }
+        EXPECT_EQ(visited.size(), size_t(n));
+        check_contents(map, expected);
+    }
+}
+
+TEST(FlatHashMapTest, random_operations)
+{
+    std::mt19937 rng(1);
+    Map map;
+    std::map<int, int> expected;
+    for (int step = 0; step < 20000; step++) {
+        // Keep a narrow key range, so the map often grows and shrinks across the index threshold
+        int range = (step / 2000) % 2 ? 16 : 200;
+        int key = rng() % range;
+        if (rng() % 2) {
+            map[key] = step;
+            expected[key] = step;
+        } else {
+            EXPECT_EQ(map.erase(key), expected.erase(key));
+        }
+        if (step % 100 == 0)
+            check_contents(map, expected);
+    }
+    check_contents(map, expected);
+}
@@ -0,0 +1,98 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include "gtest/gtest.h"
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+class IdStringDictTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp() { ctx = new Context(chipArgs); }
+
+    virtual void TearDown() { delete ctx; }
+
+    ArchArgs chipArgs;
+    Context *ctx;
+};
+
+TEST_F(IdStringDictTest, insert_find_erase)
+{
+    IdStringDict<int> dict;
+    EXPECT_TRUE(dict.empty());
+    EXPECT_TRUE(dict.emplace(ctx->id("b"), 2).second);
+    EXPECT_TRUE(dict.insert(std::make_pair(ctx->id("a"), 1)).second);
+    dict[ctx->id("c")] = 3;
+    // An existing entry is kept, as with std::map
+    EXPECT_FALSE(dict.emplace(ctx->id("a"), 10).second);
+    ASSERT_EQ(dict.size(), size_t(3));
+    EXPECT_EQ(dict.at(ctx->id("a")), 1);
+    EXPECT_EQ(dict.at(ctx->id("b")), 2);
+    EXPECT_EQ(dict.at(ctx->id("c")), 3);
+    EXPECT_EQ(dict.count(ctx->id("d")), size_t(0));
+    EXPECT_TRUE(dict.find(ctx->id("d")) == dict.end());
+    EXPECT_THROW(dict.at(ctx->id("d")), std::out_of_range);
+
+    EXPECT_EQ(dict.erase(ctx->id("b")), size_t(1));
+    EXPECT_EQ(dict.erase(ctx->id("b")), size_t(0));
+    EXPECT_EQ(dict.size(), size_t(2));
+    EXPECT_EQ(dict.count(ctx->id("b")), size_t(0));
+    EXPECT_EQ(dict.at(ctx->id("c")), 3);
+}
+
+TEST_F(IdStringDictTest, sorted_by_index)
+{
+    // Insert in an order unrelated to the IdString indices, and check iteration is by index
+    std::vector<IdString> keys;
+    for (int i = 0; i < 50; i++)
+        keys.push_back(ctx->id("key" + std::to_string(i)));
+    IdStringDict<int> dict;
+    for (int i = 0; i < 50; i++) {
+        int k = (i * 17) % 50;
+        dict[keys.at(k)] = k;
+    }
+    ASSERT_EQ(dict.size(), size_t(50));
+    EXPECT_TRUE(std::is_sorted(dict.begin(), dict.end(), [](const std::pair<IdString, int> &a,
+                                                            const std::pair<IdString, int> &b) {
+        return a.first.index < b.first.index;
+    }));
+    for (int i = 0; i < 50; i++)
+        EXPECT_EQ(dict.at(keys.at(i)), i);
+}
+
+TEST_F(IdStringDictTest, std_inserter)
+{
+    std::map<IdString, int> src{{ctx->id("x"), 1}, {ctx->id("y"), 2}, {ctx->id("z"), 3}};
+    IdStringDict<int> dict;
+    std::copy(src.begin(), src.end(), std::inserter(dict, dict.end()));
+    ASSERT_EQ(dict.size(), size_t(3));
+    for (auto &entry : src)
+        EXPECT_EQ(dict.at(entry.first), entry.second);
+}
+
+TEST_F(IdStringDictTest, equality)
+{
+    IdStringDict<int> a{{ctx->id("p"), 1}, {ctx->id("q"), 2}};
+    IdStringDict<int> b{{ctx->id("q"), 2}, {ctx->id("p"), 1}};
+    EXPECT_TRUE(a == b);
+    b[ctx->id("q")] = 3;
+    EXPECT_TRUE(a != b);
+}
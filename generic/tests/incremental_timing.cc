@@ -0,0 +1,122 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "design_utils.h"
+#include "gtest/gtest.h"
+#include "log.h"
+#include "nextpnr.h"
+#include "timing.h"
+
+USING_NEXTPNR_NAMESPACE
+
+// A register to register path through one LUT, with fixed routing delays of 1ns and a 10ns clock:
+//   ff0.Q (clock to out 0.5ns) -> lut.I (1ns) -> lut.O (1ns) -> ff1.D (1ns, setup 0.2ns)
+class IncrementalTimingTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        ctx = new Context(chipArgs);
+        ctx->settings[ctx->id("target_freq")] = std::to_string(100e6);
+        ctx->createNet(ctx->id("clk"));
+        ctx->createNet(ctx->id("q"));
+        ctx->createNet(ctx->id("d"));
+        for (auto name : {"ff0", "ff1"}) {
+            CellInfo *ff = ctx->createCell(ctx->id(name), ctx->id("FF"));
+            ff->addInput(ctx->id("CLK"));
+            ff->addInput(ctx->id("D"));
+            ff->addOutput(ctx->id("Q"));
+            ctx->connectPort(ctx->id("clk"), ff->name, ctx->id("CLK"));
+            ctx->addCellTimingClock(ff->name, ctx->id("CLK"));
+            ctx->addCellTimingSetupHold(ff->name, ctx->id("D"), ctx->id("CLK"), ctx->getDelayFromNS(0.2),
+                                        ctx->getDelayFromNS(0));
+            ctx->addCellTimingClockToOut(ff->name, ctx->id("Q"), ctx->id("CLK"), ctx->getDelayFromNS(0.5));
+        }
+        lut = ctx->createCell(ctx->id("lut"), ctx->id("LUT"));
+        lut->addInput(ctx->id("I"));
+        lut->addOutput(ctx->id("O"));
+        ctx->addCellTimingDelay(lut->name, ctx->id("I"), ctx->id("O"), ctx->getDelayFromNS(1));
+        ctx->connectPort(ctx->id("q"), ctx->id("ff0"), ctx->id("Q"));
+        ctx->connectPort(ctx->id("q"), lut->name, ctx->id("I"));
+        ctx->connectPort(ctx->id("d"), lut->name, ctx->id("O"));
+        ctx->connectPort(ctx->id("d"), ctx->id("ff1"), ctx->id("D"));
+        ff1 = ctx->cells.at(ctx->id("ff1")).get();
+
+        tmg = new IncrementalCriticality(ctx);
+        tmg->route_delay = [this](const NetInfo *, int) { return ctx->getDelayFromNS(1).maxDelay(); };
+    }
+
+    virtual void TearDown()
+    {
+        delete tmg;
+        delete ctx;
+    }
+
+    ArchArgs chipArgs;
+    Context *ctx;
+    CellInfo *lut, *ff1;
+    IncrementalCriticality *tmg;
+};
+
+TEST_F(IncrementalTimingTest, port_timing)
+{
+    delay_t arrival, required, slack;
+    // Nothing is known before the first update
+    EXPECT_FALSE(tmg->port_timing(ff1, ctx->id("D"), arrival, required, slack));
+    tmg->update(nullptr);
+    ASSERT_TRUE(tmg->port_timing(ff1, ctx->id("D"), arrival, required, slack));
+    EXPECT_NEAR(arrival, 3.5, 1e-4);
+    EXPECT_NEAR(required, 9.8, 1e-4);
+    EXPECT_NEAR(slack, 6.3, 1e-4);
+    ASSERT_TRUE(tmg->port_timing(lut, ctx->id("I"), arrival, required, slack));
+    EXPECT_NEAR(arrival, 1.5, 1e-4);
+    EXPECT_NEAR(required, 7.8, 1e-4);
+    EXPECT_NEAR(tmg->worst_slack(), 6.3, 1e-4);
+    // The clock isn't a timed net
+    EXPECT_FALSE(tmg->port_timing(ff1, ctx->id("CLK"), arrival, required, slack));
+}
+
+TEST_F(IncrementalTimingTest, arc_delay_override)
+{
+    tmg->update(nullptr);
+    tmg->set_arc_delay(lut, ctx->id("I"), ctx->getDelayFromNS(3).maxDelay());
+    tmg->update(nullptr);
+    EXPECT_NEAR(tmg->worst_slack(), 4.3, 1e-4);
+    delay_t arrival, required, slack;
+    ASSERT_TRUE(tmg->port_timing(ff1, ctx->id("D"), arrival, required, slack));
+    EXPECT_NEAR(arrival, 5.5, 1e-4);
+
+    tmg->clear_arc_delay(lut, ctx->id("I"));
+    tmg->update(nullptr);
+    EXPECT_NEAR(tmg->worst_slack(), 6.3, 1e-4);
+
+    // Only an input on a timed net can be overridden
+    EXPECT_THROW(tmg->set_arc_delay(lut, ctx->id("O"), 0), log_execution_error_exception);
+}
+
+TEST_F(IncrementalTimingTest, update_nets)
+{
+    NetCriticalityMap net_crit;
+    tmg->update(&net_crit);
+    // Slow down the routing of the net into ff1 and only tell the analysis about that net
+    tmg->route_delay = [this](const NetInfo *net, int) {
+        return ctx->getDelayFromNS(net->name == ctx->id("d") ? 2 : 1).maxDelay();
+    };
+    tmg->update_nets(&net_crit, {ctx->nets.at(ctx->id("d")).get()});
+    EXPECT_NEAR(tmg->worst_slack(), 5.3, 1e-4);
+    EXPECT_EQ(tmg->updated_nets, 1);
+}
@@ -0,0 +1,114 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "design_utils.h"
+#include "gtest/gtest.h"
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+class NetlistPortsTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        ctx = new Context(chipArgs);
+        net = ctx->createNet(ctx->id("net"));
+        CellInfo *drv = ctx->createCell(ctx->id("drv"), ctx->id("T"));
+        drv->addOutput(ctx->id("O"));
+        connect_port(ctx, net, drv, ctx->id("O"));
+        for (int i = 0; i < 5; i++) {
+            CellInfo *load = ctx->createCell(ctx->id("load" + std::to_string(i)), ctx->id("T"));
+            load->addInput(ctx->id("I"));
+            connect_port(ctx, net, load, ctx->id("I"));
+            loads.push_back(load);
+        }
+    }
+
+    virtual void TearDown() { delete ctx; }
+
+    // Every user must be found through the index stored on its port
+    void check_users()
+    {
+        for (size_t i = 0; i < net->users.size(); i++) {
+            auto &usr = net->users.at(i);
+            EXPECT_EQ(usr.cell->ports.at(usr.port).user_idx, i);
+            EXPECT_EQ(find_user(net, usr.cell, usr.port, usr.cell->ports.at(usr.port).user_idx), i);
+        }
+    }
+
+    ArchArgs chipArgs;
+    Context *ctx;
+    NetInfo *net;
+    std::vector<CellInfo *> loads;
+};
+
+TEST_F(NetlistPortsTest, find_user)
+{
+    check_users();
+    IdString port = ctx->id("I");
+    // A stale hint falls back to a search
+    EXPECT_EQ(find_user(net, loads.at(3), port, 0), size_t(3));
+    EXPECT_EQ(find_user(net, loads.at(3), port, 100), size_t(3));
+    // Not a user of the net
+    EXPECT_EQ(find_user(net, ctx->cells.at(ctx->id("drv")).get(), ctx->id("O"), 0), net->users.size());
+}
+
+TEST_F(NetlistPortsTest, disconnect_swaps_last_user)
+{
+    IdString port = ctx->id("I");
+    disconnect_port(ctx, loads.at(1), port);
+    EXPECT_EQ(loads.at(1)->ports.at(port).net, nullptr);
+    ASSERT_EQ(net->users.size(), size_t(4));
+    // The last user takes the place of the removed one
+    EXPECT_EQ(net->users.at(1).cell, loads.at(4));
+    check_users();
+
+    // Removing the last user doesn't move anything
+    disconnect_port(ctx, loads.at(3), port);
+    ASSERT_EQ(net->users.size(), size_t(3));
+    EXPECT_EQ(net->users.at(0).cell, loads.at(0));
+    EXPECT_EQ(net->users.at(1).cell, loads.at(4));
+    EXPECT_EQ(net->users.at(2).cell, loads.at(2));
+    check_users();
+
+    // Disconnecting an unconnected port is harmless
+    disconnect_port(ctx, loads.at(3), port);
+    EXPECT_EQ(net->users.size(), size_t(3));
+}
+
+TEST_F(NetlistPortsTest, disconnect_all_and_driver)
+{
+    IdString port = ctx->id("I");
+    for (auto load : loads) {
+        disconnect_port(ctx, load, port);
+        check_users();
+    }
+    EXPECT_TRUE(net->users.empty());
+    disconnect_port(ctx, ctx->cells.at(ctx->id("drv")).get(), ctx->id("O"));
+    EXPECT_EQ(net->driver.cell, nullptr);
+}
+
+TEST_F(NetlistPortsTest, reconnect_after_disconnect)
+{
+    IdString port = ctx->id("I");
+    disconnect_port(ctx, loads.at(0), port);
+    connect_port(ctx, net, loads.at(0), port);
+    ASSERT_EQ(net->users.size(), size_t(5));
+    EXPECT_EQ(net->users.back().cell, loads.at(0));
+    check_users();
+}
@@ -0,0 +1,169 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <algorithm>
+#include "gtest/gtest.h"
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+const Property::State states[] = {Property::S0, Property::S1, Property::Sx, Property::Sz};
+
+// A pattern of all four states, least significant first, whose 64 bit words all differ
+std::string pattern(int width)
+{
+    std::string bits;
+    for (int i = 0; i < width; i++)
+        bits.push_back(states[(i * 7 + i / 5) % 4]);
+    return bits;
+}
+
+std::string reversed(std::string s)
+{
+    std::reverse(s.begin(), s.end());
+    return s;
+}
+} // namespace
+
+TEST(PropertyTest, int_constructor)
+{
+    Property p(5, 4);
+    EXPECT_FALSE(p.is_string);
+    EXPECT_EQ(p.width, 4);
+    EXPECT_EQ(p.bit_str(), "1010");
+    EXPECT_EQ(p.to_string(), "0101");
+    EXPECT_EQ(p.as_int64(), 5);
+    EXPECT_TRUE(p.is_fully_def());
+
+    // Bits above the 64 of the integer are 0
+    Property wide(-1, 70);
+    EXPECT_EQ(wide.bit_str(), std::string(64, '1') + std::string(6, '0'));
+    EXPECT_EQ(wide.as_int64(), -1);
+
+    EXPECT_EQ(Property(0x1234, 0).width, 0);
+    EXPECT_EQ(Property(0x1234, 0).bit_str(), "");
+    EXPECT_EQ(Property(5, 8), Property::from_string("00000101"));
+}
+
+TEST(PropertyTest, get_set)
+{
+    const int width = 200;
+    Property p(0, width);
+    std::string expected(width, Property::S0);
+    // Set the bits either side of each word boundary to every state in turn, then back to 0
+    for (int i : {0, 1, 62, 63, 64, 65, 127, 128, 191, 192, 199}) {
+        for (auto state : states) {
+            p.set(i, state);
+            expected.at(i) = state;
+            ASSERT_EQ(p.get(i), state);
+            ASSERT_EQ(p.bit_str(), expected);
+        }
+        p.set(i, Property::S0);
+        expected.at(i) = Property::S0;
+        ASSERT_EQ(p.bit_str(), expected);
+    }
+    EXPECT_EQ(p, Property(0, width));
+
+    std::string bits = pattern(width);
+    for (int i = 0; i < width; i++)
+        p.set(i, Property::State(bits.at(i)));
+    EXPECT_EQ(p.bit_str(), bits);
+    for (int i = 0; i < width; i++)
+        EXPECT_EQ(p.get(i), bits.at(i));
+}
+
+TEST(PropertyTest, push_back)
+{
+    std::string bits = pattern(200);
+    Property p;
+    for (int i = 0; i < int(bits.size()); i++) {
+        p.push_back(Property::State(bits.at(i)));
+        ASSERT_EQ(p.width, i + 1);
+        ASSERT_EQ(p.planes.size(), size_t(2 * (i / 64 + 1)));
+        ASSERT_EQ(p.get(i), bits.at(i));
+    }
+    EXPECT_EQ(p.bit_str(), bits);
+    EXPECT_EQ(p.size(), bits.size());
+}
+
+TEST(PropertyTest, string_round_trip)
+{
+    for (int width : {1, 4, 63, 64, 65, 128, 130}) {
+        std::string bits = pattern(width);
+        Property p = Property::from_string(reversed(bits));
+        EXPECT_FALSE(p.is_string);
+        EXPECT_EQ(p.width, width);
+        EXPECT_EQ(p.bit_str(), bits);
+        EXPECT_EQ(p.to_string(), reversed(bits));
+        EXPECT_EQ(Property::from_string(p.to_string()), p);
+    }
+    for (auto state : states) {
+        Property p(state);
+        EXPECT_EQ(p.to_string(), std::string(1, state));
+        EXPECT_EQ(Property::from_string(p.to_string()), p);
+    }
+
+    // Literal strings that look like binary values are escaped with a trailing space
+    Property literal("01xz");
+    EXPECT_TRUE(literal.is_string);
+    EXPECT_EQ(literal.to_string(), "01xz ");
+    EXPECT_EQ(Property::from_string("01xz "), literal);
+    EXPECT_EQ(Property::from_string("hello").as_string(), "hello");
+}
+
+TEST(PropertyTest, extract)
+{
+    std::string bits = pattern(130);
+    Property p = Property::from_string(reversed(bits));
+    for (int offset : {0, 3, 60, 64, 100}) {
+        for (int len : {1, 4, 30, 64, 66}) {
+            if (offset + len > 130)
+                continue;
+            Property sub = p.extract(offset, len);
+            EXPECT_EQ(sub.width, len);
+            EXPECT_EQ(sub.bit_str(), bits.substr(offset, len)) << offset << " " << len;
+        }
+    }
+    // Bits past the end are padded
+    EXPECT_EQ(p.extract(120, 20).bit_str(), bits.substr(120) + std::string(10, Property::S0));
+    EXPECT_EQ(p.extract(120, 20, Property::Sx).bit_str(), bits.substr(120) + std::string(10, Property::Sx));
+    EXPECT_EQ(Property(0xABCD, 16).extract(4, 8).as_int64(), 0xBC);
+}
+
+TEST(PropertyTest, undefined_bits)
+{
+    // Only bits that are 1 count towards the integer value; x and z count as 0
+    Property p = Property::from_string("1x1z");
+    EXPECT_EQ(p.bit_str(), "z1x1");
+    EXPECT_EQ(p.as_int64(), 0xA);
+    EXPECT_EQ(p.as_bits(), std::vector<bool>({false, true, false, true}));
+    EXPECT_TRUE(p.as_bool());
+    EXPECT_FALSE(p.is_fully_def());
+
+    Property undef = Property::from_string("zxzx");
+    EXPECT_EQ(undef.as_int64(), 0);
+    EXPECT_FALSE(undef.as_bool());
+    EXPECT_EQ(Property(Property::Sz).as_int64(), 0);
+    EXPECT_EQ(Property(Property::S1).as_int64(), 1);
+
+    // Above the first word, only the bit planes hold the value
+    Property wide = Property::from_string("1" + std::string(70, 'x'));
+    EXPECT_EQ(wide.as_int64(), 0);
+    EXPECT_TRUE(wide.as_bool());
+    EXPECT_EQ(wide.extract(64, 7).as_int64(), 0x40);
+}
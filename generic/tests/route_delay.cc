@@ -0,0 +1,111 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef NPNR_DISABLE_THREADS
+
+#include <numeric>
+#include "gtest/gtest.h"
+#include "nextpnr.h"
+#include "worker_pool.h"
+
+USING_NEXTPNR_NAMESPACE
+
+// A few routed nets, each a chain of wires joined by 1ns pips from its driver, with a sink on every wire after the
+// first; the routed delay to sink k of a net is k ns
+class RouteDelayTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        ctx = new Context(chipArgs);
+        for (int n = 0; n < num_nets; n++) {
+            NetInfo *net = ctx->createNet(ctx->id("net" + std::to_string(n)));
+            std::vector<IdString> wires;
+            for (int k = 0; k <= num_sinks; k++) {
+                wires.push_back(ctx->id("net" + std::to_string(n) + "_w" + std::to_string(k)));
+                ctx->addWire(wires.back(), ctx->id("WIRE"), k, n);
+            }
+
+            IdString drv_bel = ctx->id("drv" + std::to_string(n));
+            ctx->addBel(drv_bel, ctx->id("DRV"), Loc(0, n, 0), false);
+            ctx->addBelOutput(drv_bel, ctx->id("O"), wires.at(0));
+            CellInfo *drv = ctx->createCell(drv_bel, ctx->id("DRV"));
+            drv->addOutput(ctx->id("O"));
+            ctx->connectPort(net->name, drv->name, ctx->id("O"));
+            ctx->bindBel(drv_bel, drv, STRENGTH_USER);
+            ctx->bindWire(wires.at(0), net, STRENGTH_WEAK);
+
+            for (int k = 1; k <= num_sinks; k++) {
+                IdString pip = ctx->id("net" + std::to_string(n) + "_p" + std::to_string(k));
+                ctx->addPip(pip, ctx->id("PIP"), wires.at(k - 1), wires.at(k), ctx->getDelayFromNS(1), Loc(k, n, 0));
+                IdString snk_bel = ctx->id("net" + std::to_string(n) + "_snk" + std::to_string(k));
+                ctx->addBel(snk_bel, ctx->id("SNK"), Loc(k, n, 1), false);
+                ctx->addBelInput(snk_bel, ctx->id("I"), wires.at(k));
+                CellInfo *snk = ctx->createCell(snk_bel, ctx->id("SNK"));
+                snk->addInput(ctx->id("I"));
+                ctx->connectPort(net->name, snk->name, ctx->id("I"));
+                ctx->bindBel(snk_bel, snk, STRENGTH_USER);
+                ctx->bindPip(pip, net, STRENGTH_WEAK);
+            }
+        }
+    }
+
+    virtual void TearDown() { delete ctx; }
+
+    static const int num_nets = 8, num_sinks = 32;
+    ArchArgs chipArgs;
+    Context *ctx;
+};
+
+TEST_F(RouteDelayTest, routed)
+{
+    NetInfo *net = ctx->nets.at(ctx->id("net0")).get();
+    for (int k = 1; k <= num_sinks; k++) {
+        EXPECT_NEAR(ctx->getNetinfoRouteDelay(net, net->users.at(k - 1)), k, 1e-4);
+        EXPECT_NEAR(ctx->getNetinfoRouteDelayMin(net, net->users.at(k - 1)), k, 1e-4);
+    }
+}
+
+TEST_F(RouteDelayTest, concurrent)
+{
+    // Every sink of every net is queried from several threads at once, each time starting with no cached delays, so
+    // threads fill in and read the delays of the same net together
+    std::vector<int> tasks(4 * num_nets * num_sinks);
+    std::iota(tasks.begin(), tasks.end(), 0);
+    std::vector<delay_t> max_delay(tasks.size()), min_delay(tasks.size());
+    std::vector<const NetInfo *> nets;
+    for (int n = 0; n < num_nets; n++)
+        nets.push_back(ctx->nets.at(ctx->id("net" + std::to_string(n))).get());
+    WorkerPool pool(8);
+    for (int round = 0; round < 50; round++) {
+        for (auto &net : ctx->nets)
+            net.second->wire_delays.clear();
+        pool.run(tasks, [&](int task) {
+            const NetInfo *net = nets.at(task % num_nets);
+            const PortRef &sink = net->users.at((task / num_nets) % num_sinks);
+            max_delay.at(task) = ctx->getNetinfoRouteDelay(net, sink);
+            min_delay.at(task) = ctx->getNetinfoRouteDelayMin(net, sink);
+        });
+        for (int task : tasks) {
+            int k = (task / num_nets) % num_sinks + 1;
+            ASSERT_NEAR(max_delay.at(task), k, 1e-4);
+            ASSERT_NEAR(min_delay.at(task), k, 1e-4);
+        }
+    }
+}
+
+#endif
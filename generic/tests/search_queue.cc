@@ -0,0 +1,119 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <random>
+#include <set>
+#include "gtest/gtest.h"
+#include "nextpnr.h"
+#include "search_queue.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+struct Entry
+{
+    float cost;
+    struct Greater
+    {
+        bool operator()(const Entry &lhs, const Entry &rhs) const { return lhs.cost > rhs.cost; }
+    };
+    struct Cost
+    {
+        float operator()(const Entry &e) const { return e.cost; }
+    };
+};
+
+typedef SearchQueue<Entry, Entry::Greater, Entry::Cost> Queue;
+
+std::vector<float> pop_all(Queue &queue)
+{
+    std::vector<float> costs;
+    while (!queue.empty()) {
+        costs.push_back(queue.top().cost);
+        queue.pop();
+    }
+    return costs;
+}
+} // namespace
+
+TEST(SearchQueueTest, heap)
+{
+    Queue queue;
+    for (float cost : {3.f, 1.f, 2.f, 1.5f})
+        queue.push(Entry{cost});
+    EXPECT_EQ(queue.size(), size_t(4));
+    EXPECT_EQ(pop_all(queue), std::vector<float>({1.f, 1.5f, 2.f, 3.f}));
+}
+
+TEST(SearchQueueTest, far_entries)
+{
+    Queue queue;
+    queue.set_bucket_width(1);
+    for (float cost : {0.f, 10000.f, 5000.f, 20.f})
+        queue.push(Entry{cost});
+    EXPECT_EQ(pop_all(queue), std::vector<float>({0.f, 20.f, 5000.f, 10000.f}));
+}
+
+TEST(SearchQueueTest, cost_below_current)
+{
+    Queue queue;
+    queue.set_bucket_width(1);
+    queue.push(Entry{5});
+    queue.push(Entry{9});
+    EXPECT_EQ(queue.top().cost, 5);
+    queue.pop();
+    // An inconsistent heuristic can give a cost below the one just popped, which must still come out first, and
+    // ahead of later entries in the bucket just popped from
+    queue.push(Entry{3});
+    queue.push(Entry{5.2f});
+    EXPECT_EQ(pop_all(queue), std::vector<float>({3.f, 5.2f, 9.f}));
+
+    // Moving the ring down far enough holds aside the entries that no longer fit in it
+    queue.push(Entry{100});
+    queue.push(Entry{4000});
+    queue.push(Entry{50});
+    queue.push(Entry{-5000});
+    EXPECT_EQ(pop_all(queue), std::vector<float>({-5000.f, 50.f, 100.f, 4000.f}));
+}
+
+TEST(SearchQueueTest, random_search)
+{
+    // Searches where each popped entry pushes a few more, some of them cheaper than itself. Every pop must be within a
+    // bucket width of the cheapest entry queued.
+    std::mt19937 rng(1);
+    const float width = 0.005f;
+    for (int search = 0; search < 20; search++) {
+        Queue queue;
+        queue.set_bucket_width(width);
+        std::multiset<float> queued;
+        queue.push(Entry{float(rng() % 100)});
+        queued.insert(queue.top().cost);
+        for (int i = 0; i < 2000 && !queue.empty(); i++) {
+            float cost = queue.top().cost;
+            queue.pop();
+            ASSERT_LE(cost, *queued.begin() + width * 1.001f);
+            queued.erase(queued.find(cost));
+            int children = rng() % 4;
+            for (int j = 0; j < children; j++) {
+                float next = cost + 0.05f * (1 + rng() % 3) - 0.08f * (rng() % 2) + (rng() % 20 == 0 ? 50.f : 0.f);
+                queue.push(Entry{next});
+                queued.insert(next);
+            }
+        }
+        EXPECT_EQ(queue.size(), queued.size());
+    }
+}
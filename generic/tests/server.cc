@@ -0,0 +1,176 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef _WIN32
+
+#include <cstring>
+#include <fstream>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "command.h"
+#include "gtest/gtest.h"
+#include "nextpnr.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+class TestCommandHandler : public CommandHandler
+{
+  public:
+    TestCommandHandler(int argc, char **argv) : CommandHandler(argc, argv) {}
+    std::unique_ptr<Context> createContext(std::unordered_map<std::string, Property> &values) override
+    {
+        ArchArgs chipArgs;
+        return std::unique_ptr<Context>(new Context(chipArgs));
+    }
+    std::vector<std::string> getContextOptions() override { return {"no-iobs"}; }
+    void setupArchContext(Context *ctx) override {}
+
+  protected:
+    po::options_description getArchOptions() override
+    {
+        po::options_description specific("Architecture specific options");
+        specific.add_options()("no-iobs", "disable automatic IO buffer insertion");
+        return specific;
+    }
+};
+
+// Run a command line through the handler, as main does
+int run(std::vector<std::string> args)
+{
+    args.insert(args.begin(), "nextpnr-generic-test");
+    std::vector<char *> argv;
+    for (auto &arg : args)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+    TestCommandHandler handler(int(args.size()), argv.data());
+    return handler.exec();
+}
+
+bool is_socket(const std::string &path)
+{
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+// Whether a server is listening on path. The server runs an empty job for the connection, which just fails
+bool is_listening(const std::string &path)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool ok = fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    if (fd >= 0)
+        close(fd);
+    return ok;
+}
+} // namespace
+
+class ServerTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        char dir_template[] = "/tmp/nextpnr-server-test-XXXXXX";
+        ASSERT_NE(mkdtemp(dir_template), nullptr);
+        dir = dir_template;
+        path = dir + "/server.sock";
+    }
+
+    virtual void TearDown()
+    {
+        if (server > 0) {
+            kill(server, SIGTERM);
+            waitpid(server, nullptr, 0);
+        }
+        unlink(path.c_str());
+        rmdir(dir.c_str());
+    }
+
+    // Start a server in a child process and wait until it accepts jobs
+    void start_server(std::vector<std::string> args)
+    {
+        args.push_back("--server");
+        args.push_back(path);
+        server = fork();
+        ASSERT_GE(server, 0);
+        if (server == 0)
+            _exit(run(args));
+        for (int i = 0; i < 1000 && !is_listening(path); i++)
+            usleep(10000);
+        ASSERT_TRUE(is_listening(path));
+    }
+
+    std::string dir, path;
+    pid_t server = -1;
+};
+
+TEST_F(ServerTest, runs_jobs)
+{
+    start_server({});
+    EXPECT_EQ(run({"--client", path, "--test"}), 0);
+    // The server keeps serving after a job
+    EXPECT_EQ(run({"--client", path, "--test"}), 0);
+}
+
+TEST_F(ServerTest, rejects_mismatched_device_options)
+{
+    start_server({});
+    EXPECT_NE(run({"--client", path, "--test", "--no-iobs"}), 0);
+    EXPECT_EQ(run({"--client", path, "--test"}), 0);
+}
+
+TEST_F(ServerTest, accepts_matching_device_options)
+{
+    start_server({"--no-iobs"});
+    EXPECT_EQ(run({"--client", path, "--test", "--no-iobs"}), 0);
+    EXPECT_NE(run({"--client", path, "--test"}), 0);
+}
+
+TEST_F(ServerTest, replaces_stale_socket)
+{
+    start_server({});
+    kill(server, SIGKILL);
+    waitpid(server, nullptr, 0);
+    server = -1;
+    // The socket of the killed server is left behind, and is replaced
+    ASSERT_TRUE(is_socket(path));
+    EXPECT_FALSE(is_listening(path));
+    start_server({});
+    EXPECT_EQ(run({"--client", path, "--test"}), 0);
+}
+
+TEST_F(ServerTest, keeps_other_files)
+{
+    {
+        std::ofstream f(path);
+        f << "not a socket";
+    }
+    EXPECT_NE(run({"--server", path}), 0);
+    std::ifstream f(path);
+    std::string content;
+    std::getline(f, content);
+    EXPECT_EQ(content, "not a socket");
+}
+
+#endif
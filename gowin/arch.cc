@@ -31,35 +31,13 @@
 
 NEXTPNR_NAMESPACE_BEGIN
 
-WireInfo &Arch::wire_info(IdString wire)
-{
-    auto w = wires.find(wire);
-    if (w == wires.end())
-        NPNR_ASSERT_FALSE_STR("no wire named " + wire.str(this));
-    return w->second;
-}
-
-PipInfo &Arch::pip_info(IdString pip)
-{
-    auto p = pips.find(pip);
-    if (p == pips.end())
-        NPNR_ASSERT_FALSE_STR("no pip named " + pip.str(this));
-    return p->second;
-}
-
-BelInfo &Arch::bel_info(IdString bel)
-{
-    auto b = bels.find(bel);
-    if (b == bels.end())
-        NPNR_ASSERT_FALSE_STR("no bel named " + bel.str(this));
-    return b->second;
-}
-
 void Arch::addWire(IdString name, IdString type, int x, int y)
 {
     // std::cout << name.str(this) << std::endl;
-    NPNR_ASSERT(wires.count(name) == 0);
-    WireInfo &wi = wires[name];
+    NPNR_ASSERT(dense_index(wire_index, name) == -1);
+    set_dense_index(wire_index, name, int(wires.size()));
+    wires.emplace_back();
+    WireInfo &wi = wires.back();
     wi.name = name;
     wi.type = type;
     wi.x = x;
@@ -68,15 +46,24 @@ void Arch::addWire(IdString name, IdString type, int x, int y)
     wire_ids.push_back(name);
 }
 
-void Arch::addPip(IdString name, IdString type, IdString srcWire, IdString dstWire, DelayInfo delay, Loc loc)
+int Arch::addPipDelay(DelayInfo delay)
+{
+    pip_delays.push_back(delay);
+    return int(pip_delays.size()) - 1;
+}
+
+void Arch::addPip(IdString name, IdString type, IdString srcWire, IdString dstWire, int delay_class, Loc loc)
 {
-    NPNR_ASSERT(pips.count(name) == 0);
-    PipInfo &pi = pips[name];
+    NPNR_ASSERT(dense_index(pip_index, name) == -1);
+    set_dense_index(pip_index, name, int(pips.size()));
+    pips.emplace_back();
+    PipInfo &pi = pips.back();
     pi.name = name;
     pi.type = type;
     pi.srcWire = srcWire;
     pi.dstWire = dstWire;
-    pi.delay = delay;
+    NPNR_ASSERT(delay_class >= 0 && delay_class < int(pip_delays.size()));
+    pi.delay_class = delay_class;
     pi.loc = loc;
 
     wire_info(srcWire).downhill.push_back(name);
@@ -96,9 +83,11 @@ void Arch::addPip(IdString name, IdString type, IdString srcWire, IdString dstWi
 
 void Arch::addBel(IdString name, IdString type, Loc loc, bool gb)
 {
-    NPNR_ASSERT(bels.count(name) == 0);
+    NPNR_ASSERT(dense_index(bel_index, name) == -1);
     NPNR_ASSERT(bel_by_loc.count(loc) == 0);
-    BelInfo &bi = bels[name];
+    set_dense_index(bel_index, name, int(bels.size()));
+    bels.emplace_back();
+    BelInfo &bi = bels.back();
     bi.name = name;
     bi.type = type;
     bi.x = loc.x;
@@ -181,19 +170,20 @@ void Arch::addDecalGraphic(DecalId decal, const GraphicElement &graphic)
 void Arch::setWireDecal(WireId wire, DecalXY decalxy)
 {
     wire_info(wire).decalxy = decalxy;
-    refreshUiWire(wire);
+    // The decal may have moved, which the GUI only picks up on a full reload
+    refreshUi();
 }
 
 void Arch::setPipDecal(PipId pip, DecalXY decalxy)
 {
     pip_info(pip).decalxy = decalxy;
-    refreshUiPip(pip);
+    refreshUi();
 }
 
 void Arch::setBelDecal(BelId bel, DecalXY decalxy)
 {
     bel_info(bel).decalxy = decalxy;
-    refreshUiBel(bel);
+    refreshUi();
 }
 
 void Arch::setGroupDecal(GroupId group, DecalXY decalxy)
@@ -214,71 +204,89 @@ void Arch::setDelayScaling(double scale, double offset)
     args.delayOffset = offset;
 }
 
-void Arch::addCellTimingClock(IdString cell, IdString port) { cellTiming[cell].portClasses[port] = TMG_CLOCK_INPUT; }
+void Arch::addCellTimingClock(IdString cls, IdString port) { cellTiming[cls].portClasses[port] = TMG_CLOCK_INPUT; }
 
-void Arch::addCellTimingDelay(IdString cell, IdString fromPort, IdString toPort, DelayInfo delay)
+void Arch::addCellTimingDelay(IdString cls, IdString fromPort, IdString toPort, DelayInfo delay)
 {
-    if (get_or_default(cellTiming[cell].portClasses, fromPort, TMG_IGNORE) == TMG_IGNORE)
-        cellTiming[cell].portClasses[fromPort] = TMG_COMB_INPUT;
-    if (get_or_default(cellTiming[cell].portClasses, toPort, TMG_IGNORE) == TMG_IGNORE)
-        cellTiming[cell].portClasses[toPort] = TMG_COMB_OUTPUT;
-    cellTiming[cell].combDelays[CellDelayKey{fromPort, toPort}] = delay;
+    if (get_or_default(cellTiming[cls].portClasses, fromPort, TMG_IGNORE) == TMG_IGNORE)
+        cellTiming[cls].portClasses[fromPort] = TMG_COMB_INPUT;
+    if (get_or_default(cellTiming[cls].portClasses, toPort, TMG_IGNORE) == TMG_IGNORE)
+        cellTiming[cls].portClasses[toPort] = TMG_COMB_OUTPUT;
+    cellTiming[cls].combDelays[CellDelayKey{fromPort, toPort}] = delay;
 }
 
-void Arch::addCellTimingSetupHold(IdString cell, IdString port, IdString clock, DelayInfo setup, DelayInfo hold)
+void Arch::addCellTimingSetupHold(IdString cls, IdString port, IdString clock, DelayInfo setup, DelayInfo hold)
 {
     TimingClockingInfo ci;
     ci.clock_port = clock;
     ci.edge = RISING_EDGE;
     ci.setup = setup;
     ci.hold = hold;
-    cellTiming[cell].clockingInfo[port].push_back(ci);
-    cellTiming[cell].portClasses[port] = TMG_REGISTER_INPUT;
+    cellTiming[cls].clockingInfo[port].push_back(ci);
+    cellTiming[cls].portClasses[port] = TMG_REGISTER_INPUT;
 }
 
-void Arch::addCellTimingClockToOut(IdString cell, IdString port, IdString clock, DelayInfo clktoq)
+void Arch::addCellTimingClockToOut(IdString cls, IdString port, IdString clock, DelayInfo clktoq)
 {
     TimingClockingInfo ci;
     ci.clock_port = clock;
     ci.edge = RISING_EDGE;
     ci.clockToQ = clktoq;
-    cellTiming[cell].clockingInfo[port].push_back(ci);
-    cellTiming[cell].portClasses[port] = TMG_REGISTER_OUTPUT;
+    cellTiming[cls].clockingInfo[port].push_back(ci);
+    cellTiming[cls].portClasses[port] = TMG_REGISTER_OUTPUT;
 }
 
 // ---------------------------------------------------------------
 
+const Arch::TileWireKind &Arch::tileWireKind(IdString wire)
+{
+    if (wire.index >= int(tile_wire_kinds.size()))
+        tile_wire_kinds.resize(wire.index + 1);
+    TileWireKind &wk = tile_wire_kinds[wire.index];
+    if (wk.kind != TileWireKind::UNKNOWN)
+        return wk;
+    const std::string &wirename = wire.str(this);
+    if (wirename == "VCC" || wirename == "GND") {
+        wk.kind = TileWireKind::GLOBAL;
+    } else if (!isdigit(wirename[1]) || !isdigit(wirename[2]) || !isdigit(wirename[3])) {
+        wk.kind = TileWireKind::LOCAL;
+    } else if (wirename[0] == 'N' || wirename[0] == 'S' || wirename[0] == 'E' || wirename[0] == 'W') {
+        wk.kind = TileWireKind::SEGMENT;
+        wk.direction = wirename[0];
+        wk.num = std::stoi(wirename.substr(1, 2));
+        wk.segment = std::stoi(wirename.substr(3, 1));
+    } else {
+        wk.kind = TileWireKind::LOCAL;
+    }
+    return wk;
+}
+
 // TODO represent wires more intelligently.
 IdString Arch::wireToGlobal(int &row, int &col, const DatabasePOD *db, IdString &wire)
 {
-    const std::string &wirename = wire.str(this);
+    const TileWireKind &wk = tileWireKind(wire);
     char buf[32];
-    if (wirename == "VCC" || wirename == "GND") {
+    if (wk.kind == TileWireKind::GLOBAL) {
         return wire;
     }
-    if (!isdigit(wirename[1]) || !isdigit(wirename[2]) || !isdigit(wirename[3])) {
-        snprintf(buf, 32, "R%dC%d_%s", row + 1, col + 1, wirename.c_str());
+    if (wk.kind == TileWireKind::LOCAL) {
+        snprintf(buf, 32, "R%dC%d_%s", row + 1, col + 1, wire.c_str(this));
         return id(buf);
     }
-    char direction = wirename[0];
-    int num = std::stoi(wirename.substr(1, 2));
-    int segment = std::stoi(wirename.substr(3, 1));
+    char direction = wk.direction;
+    int num = wk.num;
     switch (direction) {
     case 'N':
-        row += segment;
+        row += wk.segment;
         break;
     case 'S':
-        row -= segment;
+        row -= wk.segment;
         break;
     case 'E':
-        col -= segment;
+        col -= wk.segment;
         break;
     case 'W':
-        col += segment;
-        break;
-    default:
-        snprintf(buf, 32, "R%dC%d_%s", row + 1, col + 1, wirename.c_str());
-        return id(buf);
+        col += wk.segment;
         break;
     }
     // wires wrap around the edges
@@ -577,6 +585,13 @@ Arch::Arch(ArchArgs args) : args(args)
     }
     // setup db
     char buf[32];
+    size_t total_pips = 0;
+    for (int i = 0; i < db->rows * db->cols; i++) {
+        const TilePOD *tile = db->grid[i].get();
+        total_pips += tile->num_pips + tile->num_clock_pips;
+    }
+    pips.reserve(total_pips);
+    pip_ids.reserve(total_pips);
     for (int i = 0; i < db->rows * db->cols; i++) {
         int row = i / db->cols;
         int col = i % db->cols;
@@ -591,13 +606,13 @@ Arch::Arch(ArchArgs args) : args(args)
                 int destcol = col;
                 IdString destid = pip.dest_id;
                 IdString gdestname = wireToGlobal(destrow, destcol, db, destid);
-                if (wires.count(gdestname) == 0)
+                if (dense_index(wire_index, gdestname) == -1)
                     addWire(gdestname, pip.dest_id, destcol, destrow);
                 int srcrow = row;
                 int srccol = col;
                 IdString srcid = pip.src_id;
                 IdString gsrcname = wireToGlobal(srcrow, srccol, db, srcid);
-                if (wires.count(gsrcname) == 0)
+                if (dense_index(wire_index, gsrcname) == -1)
                     addWire(gsrcname, pip.src_id, srccol, srcrow);
             }
         }
@@ -690,6 +705,8 @@ Arch::Arch(ArchArgs args) : args(args)
         }
     }
     // setup pips
+    // Only a few wire types occur as pip destinations, so each one's delay is looked up and stored once
+    std::unordered_map<IdString, int> wire_type_delays;
     for (int i = 0; i < db->rows * db->cols; i++) {
         int row = i / db->cols;
         int col = i % db->cols;
@@ -711,7 +728,9 @@ Arch::Arch(ArchArgs args) : args(args)
                 snprintf(buf, 32, "R%dC%d_%s_%s", row + 1, col + 1, IdString(pip.src_id).c_str(this),
                          IdString(pip.dest_id).c_str(this));
                 IdString pipname = id(buf);
-                DelayInfo delay = getWireTypeDelay(pip.dest_id);
+                auto delay_class = wire_type_delays.find(pip.dest_id);
+                if (delay_class == wire_type_delays.end())
+                    delay_class = wire_type_delays.emplace(pip.dest_id, addPipDelay(getWireTypeDelay(pip.dest_id))).first;
                 // local alias
                 auto local_alias = pairLookup(tile->aliases.get(), tile->num_aliases, srcid.index);
                 // std::cout << "srcid " << srcid.str(this) << std::endl;
@@ -733,10 +752,11 @@ Arch::Arch(ArchArgs args) : args(args)
                     gsrcname = wireToGlobal(srcrow, srccol, db, srcid);
                     // std::cout << buf << std::endl;
                 }
-                addPip(pipname, pip.dest_id, gsrcname, gdestname, delay, Loc(col, row, j));
+                addPip(pipname, pip.dest_id, gsrcname, gdestname, delay_class->second, Loc(col, row, j));
             }
         }
     }
+    setupSliceTiming();
     // Dummy for empty decals
     decal_graphics[IdString()];
 }
@@ -752,7 +772,7 @@ void IdString::initialize_arch(const BaseCtx *ctx)
 
 BelId Arch::getBelByName(IdString name) const
 {
-    if (bels.count(name))
+    if (dense_index(bel_index, name) != -1)
         return name;
     return BelId();
 }
@@ -761,7 +781,7 @@ IdString Arch::getBelName(BelId bel) const { return bel; }
 
 Loc Arch::getBelLocation(BelId bel) const
 {
-    auto &info = bels.at(bel);
+    auto &info = bel_info(bel);
     return Loc(info.x, info.y, info.z);
 }
 
@@ -775,13 +795,13 @@ BelId Arch::getBelByLocation(Loc loc) const
 
 const std::vector<BelId> &Arch::getBelsByTile(int x, int y) const { return bels_by_tile.at(x).at(y); }
 
-bool Arch::getBelGlobalBuf(BelId bel) const { return bels.at(bel).gb; }
+bool Arch::getBelGlobalBuf(BelId bel) const { return bel_info(bel).gb; }
 
 uint32_t Arch::getBelChecksum(BelId bel) const { return bel.index; }
 
 void Arch::bindBel(BelId bel, CellInfo *cell, PlaceStrength strength)
 {
-    bels.at(bel).bound_cell = cell;
+    bel_info(bel).bound_cell = cell;
     cell->bel = bel;
     cell->belStrength = strength;
     refreshUiBel(bel);
@@ -789,38 +809,38 @@ void Arch::bindBel(BelId bel, CellInfo *cell, PlaceStrength strength)
 
 void Arch::unbindBel(BelId bel)
 {
-    bels.at(bel).bound_cell->bel = BelId();
-    bels.at(bel).bound_cell->belStrength = STRENGTH_NONE;
-    bels.at(bel).bound_cell = nullptr;
+    bel_info(bel).bound_cell->bel = BelId();
+    bel_info(bel).bound_cell->belStrength = STRENGTH_NONE;
+    bel_info(bel).bound_cell = nullptr;
     refreshUiBel(bel);
 }
 
-bool Arch::checkBelAvail(BelId bel) const { return bels.at(bel).bound_cell == nullptr; }
+bool Arch::checkBelAvail(BelId bel) const { return bel_info(bel).bound_cell == nullptr; }
 
-CellInfo *Arch::getBoundBelCell(BelId bel) const { return bels.at(bel).bound_cell; }
+CellInfo *Arch::getBoundBelCell(BelId bel) const { return bel_info(bel).bound_cell; }
 
-CellInfo *Arch::getConflictingBelCell(BelId bel) const { return bels.at(bel).bound_cell; }
+CellInfo *Arch::getConflictingBelCell(BelId bel) const { return bel_info(bel).bound_cell; }
 
 const std::vector<BelId> &Arch::getBels() const { return bel_ids; }
 
-IdString Arch::getBelType(BelId bel) const { return bels.at(bel).type; }
+IdString Arch::getBelType(BelId bel) const { return bel_info(bel).type; }
 
-const std::map<IdString, std::string> &Arch::getBelAttrs(BelId bel) const { return bels.at(bel).attrs; }
+const std::map<IdString, std::string> &Arch::getBelAttrs(BelId bel) const { return bel_info(bel).attrs; }
 
 WireId Arch::getBelPinWire(BelId bel, IdString pin) const
 {
-    const auto &bdata = bels.at(bel);
+    const auto &bdata = bel_info(bel);
     if (!bdata.pins.count(pin))
         log_error("bel '%s' has no pin '%s'\n", bel.c_str(this), pin.c_str(this));
     return bdata.pins.at(pin).wire;
 }
 
-PortType Arch::getBelPinType(BelId bel, IdString pin) const { return bels.at(bel).pins.at(pin).type; }
+PortType Arch::getBelPinType(BelId bel, IdString pin) const { return bel_info(bel).pins.at(pin).type; }
 
 std::vector<IdString> Arch::getBelPins(BelId bel) const
 {
     std::vector<IdString> ret;
-    for (auto &it : bels.at(bel).pins)
+    for (auto &it : bel_info(bel).pins)
         ret.push_back(it.first);
     return ret;
 }
@@ -829,16 +849,16 @@ std::vector<IdString> Arch::getBelPins(BelId bel) const
 
 WireId Arch::getWireByName(IdString name) const
 {
-    if (wires.count(name))
+    if (dense_index(wire_index, name) != -1)
         return name;
     return WireId();
 }
 
 IdString Arch::getWireName(WireId wire) const { return wire; }
 
-IdString Arch::getWireType(WireId wire) const { return wires.at(wire).type; }
+IdString Arch::getWireType(WireId wire) const { return wire_info(wire).type; }
 
-const std::map<IdString, std::string> &Arch::getWireAttrs(WireId wire) const { return wires.at(wire).attrs; }
+const std::map<IdString, std::string> &Arch::getWireAttrs(WireId wire) const { return wire_info(wire).attrs; }
 
 uint32_t Arch::getWireChecksum(WireId wire) const
 {
@@ -848,34 +868,36 @@ uint32_t Arch::getWireChecksum(WireId wire) const
 
 void Arch::bindWire(WireId wire, NetInfo *net, PlaceStrength strength)
 {
-    wires.at(wire).bound_net = net;
+    wire_info(wire).bound_net = net;
     net->wires[wire].pip = PipId();
     net->wires[wire].strength = strength;
+    net->wire_delays.clear();
     refreshUiWire(wire);
 }
 
 void Arch::unbindWire(WireId wire)
 {
-    auto &net_wires = wires.at(wire).bound_net->wires;
+    auto &net_wires = wire_info(wire).bound_net->wires;
 
     auto pip = net_wires.at(wire).pip;
     if (pip != PipId()) {
-        pips.at(pip).bound_net = nullptr;
+        pip_info(pip).bound_net = nullptr;
         refreshUiPip(pip);
     }
 
     net_wires.erase(wire);
-    wires.at(wire).bound_net = nullptr;
+    wire_info(wire).bound_net->wire_delays.clear();
+    wire_info(wire).bound_net = nullptr;
     refreshUiWire(wire);
 }
 
-bool Arch::checkWireAvail(WireId wire) const { return wires.at(wire).bound_net == nullptr; }
+bool Arch::checkWireAvail(WireId wire) const { return wire_info(wire).bound_net == nullptr; }
 
-NetInfo *Arch::getBoundWireNet(WireId wire) const { return wires.at(wire).bound_net; }
+NetInfo *Arch::getBoundWireNet(WireId wire) const { return wire_info(wire).bound_net; }
 
-NetInfo *Arch::getConflictingWireNet(WireId wire) const { return wires.at(wire).bound_net; }
+NetInfo *Arch::getConflictingWireNet(WireId wire) const { return wire_info(wire).bound_net; }
 
-const std::vector<BelPin> &Arch::getWireBelPins(WireId wire) const { return wires.at(wire).bel_pins; }
+const std::vector<BelPin> &Arch::getWireBelPins(WireId wire) const { return wire_info(wire).bel_pins; }
 
 const std::vector<WireId> &Arch::getWires() const { return wire_ids; }
 
@@ -883,61 +905,63 @@ const std::vector<WireId> &Arch::getWires() const { return wire_ids; }
 
 PipId Arch::getPipByName(IdString name) const
 {
-    if (pips.count(name))
+    if (dense_index(pip_index, name) != -1)
         return name;
     return PipId();
 }
 
 IdString Arch::getPipName(PipId pip) const { return pip; }
 
-IdString Arch::getPipType(PipId pip) const { return pips.at(pip).type; }
+IdString Arch::getPipType(PipId pip) const { return pip_info(pip).type; }
 
-const std::map<IdString, std::string> &Arch::getPipAttrs(PipId pip) const { return pips.at(pip).attrs; }
+const std::map<IdString, std::string> &Arch::getPipAttrs(PipId pip) const { return pip_info(pip).attrs; }
 
 uint32_t Arch::getPipChecksum(PipId wire) const { return wire.index; }
 
 void Arch::bindPip(PipId pip, NetInfo *net, PlaceStrength strength)
 {
-    WireId wire = pips.at(pip).dstWire;
-    pips.at(pip).bound_net = net;
-    wires.at(wire).bound_net = net;
+    WireId wire = pip_info(pip).dstWire;
+    pip_info(pip).bound_net = net;
+    wire_info(wire).bound_net = net;
     net->wires[wire].pip = pip;
     net->wires[wire].strength = strength;
+    net->wire_delays.clear();
     refreshUiPip(pip);
     refreshUiWire(wire);
 }
 
 void Arch::unbindPip(PipId pip)
 {
-    WireId wire = pips.at(pip).dstWire;
-    wires.at(wire).bound_net->wires.erase(wire);
-    pips.at(pip).bound_net = nullptr;
-    wires.at(wire).bound_net = nullptr;
+    WireId wire = pip_info(pip).dstWire;
+    wire_info(wire).bound_net->wires.erase(wire);
+    wire_info(wire).bound_net->wire_delays.clear();
+    pip_info(pip).bound_net = nullptr;
+    wire_info(wire).bound_net = nullptr;
     refreshUiPip(pip);
     refreshUiWire(wire);
 }
 
-bool Arch::checkPipAvail(PipId pip) const { return pips.at(pip).bound_net == nullptr; }
+bool Arch::checkPipAvail(PipId pip) const { return pip_info(pip).bound_net == nullptr; }
 
-NetInfo *Arch::getBoundPipNet(PipId pip) const { return pips.at(pip).bound_net; }
+NetInfo *Arch::getBoundPipNet(PipId pip) const { return pip_info(pip).bound_net; }
 
-NetInfo *Arch::getConflictingPipNet(PipId pip) const { return pips.at(pip).bound_net; }
+NetInfo *Arch::getConflictingPipNet(PipId pip) const { return pip_info(pip).bound_net; }
 
-WireId Arch::getConflictingPipWire(PipId pip) const { return pips.at(pip).bound_net ? pips.at(pip).dstWire : WireId(); }
+WireId Arch::getConflictingPipWire(PipId pip) const { return pip_info(pip).bound_net ? pip_info(pip).dstWire : WireId(); }
 
 const std::vector<PipId> &Arch::getPips() const { return pip_ids; }
 
-Loc Arch::getPipLocation(PipId pip) const { return pips.at(pip).loc; }
+Loc Arch::getPipLocation(PipId pip) const { return pip_info(pip).loc; }
 
-WireId Arch::getPipSrcWire(PipId pip) const { return pips.at(pip).srcWire; }
+WireId Arch::getPipSrcWire(PipId pip) const { return pip_info(pip).srcWire; }
 
-WireId Arch::getPipDstWire(PipId pip) const { return pips.at(pip).dstWire; }
+WireId Arch::getPipDstWire(PipId pip) const { return pip_info(pip).dstWire; }
 
-DelayInfo Arch::getPipDelay(PipId pip) const { return pips.at(pip).delay; }
+DelayInfo Arch::getPipDelay(PipId pip) const { return pip_delays[pip_info(pip).delay_class]; }
 
-const std::vector<PipId> &Arch::getPipsDownhill(WireId wire) const { return wires.at(wire).downhill; }
+const std::vector<PipId> &Arch::getPipsDownhill(WireId wire) const { return wire_info(wire).downhill; }
 
-const std::vector<PipId> &Arch::getPipsUphill(WireId wire) const { return wires.at(wire).uphill; }
+const std::vector<PipId> &Arch::getPipsUphill(WireId wire) const { return wire_info(wire).uphill; }
 
 // ---------------------------------------------------------------
 
@@ -965,8 +989,8 @@ const std::vector<GroupId> &Arch::getGroupGroups(GroupId group) const { return g
 
 delay_t Arch::estimateDelay(WireId src, WireId dst) const
 {
-    const WireInfo &s = wires.at(src);
-    const WireInfo &d = wires.at(dst);
+    const WireInfo &s = wire_info(src);
+    const WireInfo &d = wire_info(dst);
     int dx = abs(s.x - d.x);
     int dy = abs(s.y - d.y);
     return (dx + dy) * args.delayScale + args.delayOffset;
@@ -989,10 +1013,10 @@ ArcBounds Arch::getRouteBoundingBox(WireId src, WireId dst) const
 {
     ArcBounds bb;
 
-    int src_x = wires.at(src).x;
-    int src_y = wires.at(src).y;
-    int dst_x = wires.at(dst).x;
-    int dst_y = wires.at(dst).y;
+    int src_x = wire_info(src).x;
+    int src_y = wire_info(src).y;
+    int dst_x = wire_info(dst).x;
+    int dst_y = wire_info(dst).y;
 
     bb.x0 = src_x;
     bb.y0 = src_y;
@@ -1075,11 +1099,11 @@ const std::vector<GraphicElement> &Arch::getDecalGraphics(DecalId decal) const
     return decal_graphics.at(decal);
 }
 
-DecalXY Arch::getBelDecal(BelId bel) const { return bels.at(bel).decalxy; }
+DecalXY Arch::getBelDecal(BelId bel) const { return bel_info(bel).decalxy; }
 
-DecalXY Arch::getWireDecal(WireId wire) const { return wires.at(wire).decalxy; }
+DecalXY Arch::getWireDecal(WireId wire) const { return wire_info(wire).decalxy; }
 
-DecalXY Arch::getPipDecal(PipId pip) const { return pips.at(pip).decalxy; }
+DecalXY Arch::getPipDecal(PipId pip) const { return pip_info(pip).decalxy; }
 
 DecalXY Arch::getGroupDecal(GroupId group) const { return groups.at(group).decalxy; }
 
@@ -1087,11 +1111,10 @@ DecalXY Arch::getGroupDecal(GroupId group) const { return groups.at(group).decal
 
 bool Arch::getCellDelay(const CellInfo *cell, IdString fromPort, IdString toPort, DelayInfo &delay) const
 {
-    if (!cellTiming.count(cell->name))
+    if (cell->timing == nullptr)
         return false;
-    const auto &tmg = cellTiming.at(cell->name);
-    auto fnd = tmg.combDelays.find(CellDelayKey{fromPort, toPort});
-    if (fnd != tmg.combDelays.end()) {
+    auto fnd = cell->timing->combDelays.find(CellDelayKey{fromPort, toPort});
+    if (fnd != cell->timing->combDelays.end()) {
         delay = fnd->second;
         return true;
     } else {
@@ -1102,11 +1125,12 @@ bool Arch::getCellDelay(const CellInfo *cell, IdString fromPort, IdString toPort
 // Get the port class, also setting clockPort if applicable
 TimingPortClass Arch::getPortTimingClass(const CellInfo *cell, IdString port, int &clockInfoCount) const
 {
-    if (!cellTiming.count(cell->name))
+    if (cell->timing == nullptr)
         return TMG_IGNORE;
-    const auto &tmg = cellTiming.at(cell->name);
-    if (tmg.clockingInfo.count(port))
-        clockInfoCount = int(tmg.clockingInfo.at(port).size());
+    const auto &tmg = *cell->timing;
+    auto fnd = tmg.clockingInfo.find(port);
+    if (fnd != tmg.clockingInfo.end())
+        clockInfoCount = int(fnd->second.size());
     else
         clockInfoCount = 0;
     return get_or_default(tmg.portClasses, port, TMG_IGNORE);
@@ -1114,8 +1138,8 @@ TimingPortClass Arch::getPortTimingClass(const CellInfo *cell, IdString port, in
 
 TimingClockingInfo Arch::getPortClockingInfo(const CellInfo *cell, IdString port, int index) const
 {
-    NPNR_ASSERT(cellTiming.count(cell->name));
-    const auto &tmg = cellTiming.at(cell->name);
+    NPNR_ASSERT(cell->timing != nullptr);
+    const auto &tmg = *cell->timing;
     NPNR_ASSERT(tmg.clockingInfo.count(port));
     return tmg.clockingInfo.at(port).at(index);
 }
@@ -1147,6 +1171,19 @@ bool Arch::isBelLocationValid(BelId bel) const
     return cellsCompatible(cells.data(), int(cells.size()));
 }
 
+bool Arch::isBelLocationValidWith(BelId bel, const std::unordered_map<BelId, CellInfo *> &overlay) const
+{
+    std::vector<const CellInfo *> cells;
+    Loc loc = getBelLocation(bel);
+    for (auto tbel : getBelsByTile(loc.x, loc.y)) {
+        auto found = overlay.find(tbel);
+        CellInfo *bound = found != overlay.end() ? found->second : getBoundBelCell(tbel);
+        if (bound != nullptr)
+            cells.push_back(bound);
+    }
+    return cellsCompatible(cells.data(), int(cells.size()));
+}
+
 #ifdef WITH_HEAP
 const std::string Arch::defaultPlacer = "heap";
 #else
@@ -1162,40 +1199,39 @@ const std::vector<std::string> Arch::availablePlacers = {"sa",
 const std::string Arch::defaultRouter = "router1";
 const std::vector<std::string> Arch::availableRouters = {"router1", "router2"};
 
+void Arch::setupSliceTiming()
+{
+    // Every slice has the same timing, so it is built once for the SLICE class and shared
+    addCellTimingClock(id_SLICE, id_CLK);
+    IdString ports[4] = {id_A, id_B, id_C, id_D};
+    DelayInfo setup = delayLookup(speed->dff.timings.get(), speed->dff.num_timings, id_clksetpos);
+    DelayInfo hold = delayLookup(speed->dff.timings.get(), speed->dff.num_timings, id_clkholdpos);
+    for (int i = 0; i < 4; i++)
+        addCellTimingSetupHold(id_SLICE, ports[i], id_CLK, setup, hold);
+    DelayInfo clkout = delayLookup(speed->dff.timings.get(), speed->dff.num_timings, id_clk_qpos);
+    addCellTimingClockToOut(id_SLICE, id_Q, id_CLK, clkout);
+    IdString port_delay[4] = {id_a_f, id_b_f, id_c_f, id_d_f};
+    for (int i = 0; i < 4; i++) {
+        DelayInfo delay = delayLookup(speed->lut.timings.get(), speed->lut.num_timings, port_delay[i]);
+        addCellTimingDelay(id_SLICE, ports[i], id_F, delay);
+    }
+}
+
 void Arch::assignArchInfo()
 {
+    const CellTiming *slice_timing = &cellTiming.at(id_SLICE);
     for (auto &cell : getCtx()->cells) {
-        IdString cname = cell.first;
         CellInfo *ci = cell.second.get();
-        if (ci->type == id("SLICE")) {
+        if (ci->type == id_SLICE) {
             ci->is_slice = true;
             ci->ff_used = ci->params.at(id_FF_USED).as_bool();
-            ci->slice_clk = get_net_or_empty(ci, id("CLK"));
-            ci->slice_ce = get_net_or_empty(ci, id("CE"));
-            ci->slice_lsr = get_net_or_empty(ci, id("LSR"));
-
-            // add timing paths
-            addCellTimingClock(cname, id_CLK);
-            IdString ports[4] = {id_A, id_B, id_C, id_D};
-            for (int i = 0; i < 4; i++) {
-                DelayInfo setup = delayLookup(speed->dff.timings.get(), speed->dff.num_timings, id_clksetpos);
-                DelayInfo hold = delayLookup(speed->dff.timings.get(), speed->dff.num_timings, id_clkholdpos);
-                // DelayInfo setup = getDelayFromNS(0.1);
-                // DelayInfo hold = getDelayFromNS(0.1);
-                addCellTimingSetupHold(cname, ports[i], id_CLK, setup, hold);
-            }
-            DelayInfo clkout = delayLookup(speed->dff.timings.get(), speed->dff.num_timings, id_clk_qpos);
-            // DelayInfo clkout = getDelayFromNS(0.1);
-            addCellTimingClockToOut(cname, id_Q, id_CLK, clkout);
-            IdString port_delay[4] = {id_a_f, id_b_f, id_c_f, id_d_f};
-            for (int i = 0; i < 4; i++) {
-                DelayInfo delay = delayLookup(speed->lut.timings.get(), speed->lut.num_timings, port_delay[i]);
-                // DelayInfo delay = getDelayFromNS(0.1);
-                addCellTimingDelay(cname, ports[i], id_F, delay);
-            }
-
+            ci->slice_clk = get_net_or_empty(ci, id_CLK);
+            ci->slice_ce = get_net_or_empty(ci, id_CE);
+            ci->slice_lsr = get_net_or_empty(ci, id_LSR);
+            ci->timing = slice_timing;
         } else {
             ci->is_slice = false;
+            ci->timing = nullptr;
         }
     }
 }
@@ -170,7 +170,8 @@ struct PipInfo
     std::map<IdString, std::string> attrs;
     NetInfo *bound_net;
     WireId srcWire, dstWire;
-    DelayInfo delay;
+    // Index into Arch::pip_delays
+    int delay_class;
     DecalXY decalxy;
     Loc loc;
 };
@@ -250,15 +251,50 @@ struct Arch : BaseCtx
     const PackagePOD *package;
     const TimingGroupsPOD *speed;
 
-    std::unordered_map<IdString, WireInfo> wires;
-    std::unordered_map<IdString, PipInfo> pips;
-    std::unordered_map<IdString, BelInfo> bels;
+    // Wires, pips and bels are stored densely in the order they were added. The IdString naming each one is still its
+    // id, and is mapped to its position by the *_index tables, which are indexed by the IdString index (-1 if absent)
+    std::vector<WireInfo> wires;
+    std::vector<PipInfo> pips;
+    std::vector<BelInfo> bels;
+    std::vector<int> wire_index, pip_index, bel_index;
     std::unordered_map<GroupId, GroupInfo> groups;
 
+    static int dense_index(const std::vector<int> &table, IdString name)
+    {
+        return (name.index >= 0 && name.index < int(table.size())) ? table[name.index] : -1;
+    }
+    static void set_dense_index(std::vector<int> &table, IdString name, int index)
+    {
+        if (name.index >= int(table.size()))
+            table.resize(name.index + 1, -1);
+        table[name.index] = index;
+    }
+
     // These functions include useful errors if not found
-    WireInfo &wire_info(IdString wire);
-    PipInfo &pip_info(IdString wire);
-    BelInfo &bel_info(IdString wire);
+    const WireInfo &wire_info(IdString wire) const
+    {
+        int index = dense_index(wire_index, wire);
+        if (index < 0)
+            NPNR_ASSERT_FALSE_STR("no wire named " + wire.str(this));
+        return wires[index];
+    }
+    const PipInfo &pip_info(IdString pip) const
+    {
+        int index = dense_index(pip_index, pip);
+        if (index < 0)
+            NPNR_ASSERT_FALSE_STR("no pip named " + pip.str(this));
+        return pips[index];
+    }
+    const BelInfo &bel_info(IdString bel) const
+    {
+        int index = dense_index(bel_index, bel);
+        if (index < 0)
+            NPNR_ASSERT_FALSE_STR("no bel named " + bel.str(this));
+        return bels[index];
+    }
+    WireInfo &wire_info(IdString wire) { return const_cast<WireInfo &>(static_cast<const Arch *>(this)->wire_info(wire)); }
+    PipInfo &pip_info(IdString pip) { return const_cast<PipInfo &>(static_cast<const Arch *>(this)->pip_info(pip)); }
+    BelInfo &bel_info(IdString bel) { return const_cast<BelInfo &>(static_cast<const Arch *>(this)->bel_info(bel)); }
 
     std::vector<IdString> bel_ids, wire_ids, pip_ids;
 
@@ -271,10 +307,15 @@ struct Arch : BaseCtx
     std::vector<std::vector<int>> tileBelDimZ;
     std::vector<std::vector<int>> tilePipDimZ;
 
+    // Cell timing, keyed by timing class rather than by cell. Cells point at theirs through ArchCellInfo::timing
     std::unordered_map<IdString, CellTiming> cellTiming;
 
+    // The distinct pip delays; pips only hold an index into this
+    std::vector<DelayInfo> pip_delays;
+
     void addWire(IdString name, IdString type, int x, int y);
-    void addPip(IdString name, IdString type, IdString srcWire, IdString dstWire, DelayInfo delay, Loc loc);
+    int addPipDelay(DelayInfo delay);
+    void addPip(IdString name, IdString type, IdString srcWire, IdString dstWire, int delay_class, Loc loc);
 
     void addBel(IdString name, IdString type, Loc loc, bool gb);
     void addBelInput(IdString bel, IdString name, IdString wire);
@@ -298,10 +339,28 @@ struct Arch : BaseCtx
 
     void setDelayScaling(double scale, double offset);
 
-    void addCellTimingClock(IdString cell, IdString port);
-    void addCellTimingDelay(IdString cell, IdString fromPort, IdString toPort, DelayInfo delay);
-    void addCellTimingSetupHold(IdString cell, IdString port, IdString clock, DelayInfo setup, DelayInfo hold);
-    void addCellTimingClockToOut(IdString cell, IdString port, IdString clock, DelayInfo clktoq);
+    void addCellTimingClock(IdString cls, IdString port);
+    void addCellTimingDelay(IdString cls, IdString fromPort, IdString toPort, DelayInfo delay);
+    void addCellTimingSetupHold(IdString cls, IdString port, IdString clock, DelayInfo setup, DelayInfo hold);
+    void addCellTimingClockToOut(IdString cls, IdString port, IdString clock, DelayInfo clktoq);
+    void setupSliceTiming();
+
+    // How wireToGlobal treats a tile-relative wire name, parsed once per name rather than once per pip of every tile.
+    // Indexed by the IdString index of the name
+    struct TileWireKind
+    {
+        enum : uint8_t
+        {
+            UNKNOWN,
+            GLOBAL,  // VCC and GND are the same wire everywhere
+            LOCAL,   // a wire of this tile only
+            SEGMENT, // a wire spanning `segment` tiles towards `direction`
+        } kind = UNKNOWN;
+        char direction = 0;
+        int num = 0, segment = 0;
+    };
+    std::vector<TileWireKind> tile_wire_kinds;
+    const TileWireKind &tileWireKind(IdString wire);
 
     IdString wireToGlobal(int &row, int &col, const DatabasePOD *db, IdString &wire);
     DelayInfo getWireTypeDelay(IdString wire);
@@ -387,6 +446,12 @@ struct Arch : BaseCtx
 
     delay_t estimateDelay(WireId src, WireId dst) const;
     delay_t predictDelay(const NetInfo *net_info, const PortRef &sink) const;
+    // predictDelay only depends on the cell types and ports of the arc, and the distance between the bels when they
+    // are in different tiles; so PredictDelayCache may memoise it
+    static const bool predictDelayCacheable = true;
+    int getPredictDelayClass(const NetInfo *net_info, const PortRef &sink) const { return 0; }
+    // WireId and PipId hold IdStrings, whose indices differ between runs, so the routing graph can't be cached
+    static const bool routeGraphCacheable = false;
     delay_t getDelayEpsilon() const { return 0.01; }
     delay_t getRipupDelayPenalty() const { return 0.4; }
     float getDelayNS(delay_t v) const { return v; }
@@ -423,7 +488,12 @@ struct Arch : BaseCtx
     TimingClockingInfo getPortClockingInfo(const CellInfo *cell, IdString port, int index) const;
 
     bool isValidBelForCell(CellInfo *cell, BelId bel) const;
+    // Preference of the initial placer among valid Bels; lower is better. No preference on this arch
+    int scoreBelForCell(CellInfo *cell, BelId bel) const { return 0; }
     bool isBelLocationValid(BelId bel) const;
+    // As isBelLocationValid, but as if each Bel in overlay were bound to the given cell (or unbound, for nullptr)
+    // instead. Only Bels in the same tile as bel are looked up in overlay
+    bool isBelLocationValidWith(BelId bel, const std::unordered_map<BelId, CellInfo *> &overlay) const;
 
     static const std::string defaultPlacer;
     static const std::vector<std::string> availablePlacers;
@@ -53,9 +53,9 @@ void arch_wrap_python(py::module &m)
 
     auto ctx_cls = py::class_<Context, Arch>(m, "Context")
                            .def("checksum", &Context::checksum)
-                           .def("pack", &Context::pack)
-                           .def("place", &Context::place)
-                           .def("route", &Context::route);
+                           .def("pack", &Context::pack, release_gil())
+                           .def("place", &Context::place, release_gil())
+                           .def("route", &Context::route, release_gil());
 
     py::class_<BelPin>(m, "BelPin").def_readwrite("bel", &BelPin::bel).def_readwrite("pin", &BelPin::pin);
 
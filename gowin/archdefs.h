@@ -78,9 +78,12 @@ struct ArchNetInfo
 };
 
 struct NetInfo;
+struct CellTiming;
 
 struct ArchCellInfo
 {
+    // Timing of the cell, shared by all cells of the same timing class, or nullptr if it has none
+    const CellTiming *timing = nullptr;
     // Is the flip-flop of this slice used
     bool ff_used;
     // Is a slice type primitive
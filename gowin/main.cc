@@ -22,6 +22,7 @@
 
 #include <fstream>
 #include <regex>
+#include "cells.h"
 #include "command.h"
 #include "design_utils.h"
 #include "log.h"
@@ -35,8 +36,10 @@ class GowinCommandHandler : public CommandHandler
     GowinCommandHandler(int argc, char **argv);
     virtual ~GowinCommandHandler(){};
     std::unique_ptr<Context> createContext(std::unordered_map<std::string, Property> &values) override;
+    std::vector<std::string> getContextOptions() override { return {"device"}; }
     void setupArchContext(Context *ctx) override{};
     void customAfterLoad(Context *ctx) override;
+    bool preflightConfig(Context *ctx, PreflightCfg &cfg) override;
 
   protected:
     po::options_description getArchOptions() override;
@@ -82,6 +85,26 @@ void GowinCommandHandler::customAfterLoad(Context *ctx)
     }
 }
 
+bool GowinCommandHandler::preflightConfig(Context *ctx, PreflightCfg &cfg)
+{
+    // Each slice holds a LUT and a DFF
+    PreflightCfg::Resource slice("slices", {id_SLICE});
+    slice.groups.push_back([](const Context *ctx, const CellInfo *ci) { return is_lut(ctx, ci) ? 1 : 0; });
+    slice.groups.push_back([](const Context *ctx, const CellInfo *ci) { return is_ff(ctx, ci) ? 1 : 0; });
+    cfg.resources.push_back(slice);
+    std::unordered_map<IdString, int> io_types;
+    for (auto type : {"IBUF", "OBUF", "TBUF", "IOBUF"}) {
+        io_types[ctx->id(type)] = 1;
+        cfg.pad_cell_types.push_back(ctx->id(type));
+    }
+    PreflightCfg::Resource io("IOs", {id_IOB});
+    io.groups.push_back(preflight_cell_types(io_types));
+    io.top_ports = true;
+    cfg.resources.push_back(io);
+    cfg.check_bel_names = true;
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     GowinCommandHandler handler(argc, argv);
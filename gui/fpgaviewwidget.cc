@@ -17,8 +17,14 @@
  *
  */
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <limits>
 #include <math.h>
+#include <numeric>
+#include <string>
+#include <thread>
 
 #include <QApplication>
 #include <QCoreApplication>
@@ -81,6 +87,8 @@ FPGAViewWidget::~FPGAViewWidget() {}
 void FPGAViewWidget::newContext(Context *ctx)
 {
     ctx_ = ctx;
+    if (ctx_ != nullptr)
+        ctx_->attachUi();
     {
         QMutexLocker lock(&rendererArgsLock_);
 
@@ -215,26 +223,181 @@ void FPGAViewWidget::renderDecal(LineShaderData &out, PickQuadTree::BoundingBox
     }
 }
 
-void FPGAViewWidget::renderArchDecal(LineShaderData out[GraphicElement::STYLE_MAX], PickQuadTree::BoundingBox &bb,
-                                     const DecalXY &decal)
+void FPGAViewWidget::renderInstancedDecal(DecalShapes shapes[3], PickQuadTree::BoundingBox &bb, const DecalXY &decal)
 {
-    float offsetX = decal.x;
-    float offsetY = decal.y;
+    static const GraphicElement::style_t styles[3] = {GraphicElement::STYLE_FRAME, GraphicElement::STYLE_INACTIVE,
+                                                      GraphicElement::STYLE_ACTIVE};
+    auto drawn = [](const GraphicElement &el) {
+        return el.type == GraphicElement::TYPE_BOX || el.type == GraphicElement::TYPE_LINE ||
+               el.type == GraphicElement::TYPE_ARROW;
+    };
+
+    auto graphics = ctx_->getDecalGraphics(decal.decal);
+
+    // Shapes are placed relative to the tile the decal starts in, so that the same bel in different tiles has the
+    // same shape
+    float x0 = std::numeric_limits<float>::infinity(), y0 = std::numeric_limits<float>::infinity();
+    for (auto &el : graphics) {
+        if (!drawn(el) || std::find(styles, styles + 3, el.style) == styles + 3)
+            continue;
+        x0 = std::min(x0, decal.x + std::min(el.x1, el.x2));
+        y0 = std::min(y0, decal.y + std::min(el.y1, el.y2));
+        bb.setX0(std::min(bb.x0(), decal.x + el.x1));
+        bb.setY0(std::min(bb.y0(), decal.y + el.y1));
+        bb.setX1(std::max(bb.x1(), decal.x + el.x2));
+        bb.setY1(std::max(bb.y1(), decal.y + el.y2));
+    }
+    if (std::isinf(x0))
+        return;
+    float originX = std::floor(x0), originY = std::floor(y0);
+
+    for (int i = 0; i < 3; i++) {
+        // Shapes are told apart by their elements, to a fraction of a tile
+        std::string key;
+        for (auto &el : graphics) {
+            if (!drawn(el) || el.style != styles[i])
+                continue;
+            int32_t quantised[5] = {el.type, int32_t(std::lround((decal.x + el.x1 - originX) * 4096)),
+                                    int32_t(std::lround((decal.y + el.y1 - originY) * 4096)),
+                                    int32_t(std::lround((decal.x + el.x2 - originX) * 4096)),
+                                    int32_t(std::lround((decal.y + el.y2 - originY) * 4096))};
+            key.append(reinterpret_cast<const char *>(quantised), sizeof(quantised));
+        }
+        if (key.empty())
+            continue;
 
-    for (auto &el : ctx_->getDecalGraphics(decal.decal)) {
-        switch (el.style) {
-        case GraphicElement::STYLE_FRAME:
-        case GraphicElement::STYLE_INACTIVE:
-        case GraphicElement::STYLE_ACTIVE:
-            renderGraphicElement(out[el.style], bb, el, offsetX, offsetY);
-            break;
-        default:
-            break;
+        auto found = shapes[i].index.find(key);
+        if (found == shapes[i].index.end()) {
+            found = shapes[i].index.emplace(key, int(shapes[i].shapes.size())).first;
+            shapes[i].shapes.emplace_back(key, DecalShapes::Shape());
+            PickQuadTree::BoundingBox unused;
+            for (auto &el : graphics) {
+                if (drawn(el) && el.style == styles[i])
+                    renderGraphicElement(shapes[i].shapes.back().second.geometry, unused, el, decal.x - originX,
+                                         decal.y - originY);
+            }
         }
+        shapes[i].shapes.at(found->second).second.offsets.emplace_back(originX, originY);
     }
 }
 
-void FPGAViewWidget::populateQuadTree(RendererData *data, const DecalXY &decal, const PickedElement &element)
+void FPGAViewWidget::renderArchDecals(RendererData *data, const std::vector<DecalXY> &decals, int routing_begin,
+                                      int routing_end)
+{
+    // Large devices have millions of decals, so their geometry is built in chunks on worker threads. The chunks are
+    // then joined in order, giving the same buffers as building them in one go
+    const int chunk_size = 4096;
+    int num_chunks = (int(decals.size()) + chunk_size - 1) / chunk_size;
+    int grid_x = std::max(1, ctx_->getGridDimX()), grid_y = std::max(1, ctx_->getGridDimY());
+    struct Chunk
+    {
+        LineShaderData gfxByStyle[GraphicElement::STYLE_MAX];
+        DecalShapes shapes[3];
+        LineShaderData gfxRouting[2];
+        // Tile of each active wire or pip element
+        std::vector<int> activeTiles;
+        PickQuadTree::BoundingBox bb;
+    };
+    std::vector<Chunk> chunks(num_chunks);
+    auto render_chunk = [&](int i) {
+        Chunk &chunk = chunks[i];
+        int end = std::min(int(decals.size()), (i + 1) * chunk_size);
+        for (int j = i * chunk_size; j < end; j++) {
+            const DecalXY &decal = decals[j];
+            if (j < routing_begin || j >= routing_end) {
+                renderInstancedDecal(chunk.shapes, chunk.bb, decal);
+                continue;
+            }
+            // Wires and pips have buffers of their own, so that they can be swapped for a summary when zoomed out
+            for (auto &el : ctx_->getDecalGraphics(decal.decal)) {
+                switch (el.style) {
+                case GraphicElement::STYLE_FRAME:
+                    renderGraphicElement(chunk.gfxByStyle[el.style], chunk.bb, el, decal.x, decal.y);
+                    break;
+                case GraphicElement::STYLE_INACTIVE:
+                    renderGraphicElement(chunk.gfxRouting[0], chunk.bb, el, decal.x, decal.y);
+                    break;
+                case GraphicElement::STYLE_ACTIVE: {
+                    renderGraphicElement(chunk.gfxRouting[1], chunk.bb, el, decal.x, decal.y);
+                    int x = int(std::floor(decal.x + (el.x1 + el.x2) / 2));
+                    int y = int(std::floor(decal.y + (el.y1 + el.y2) / 2));
+                    x = std::min(std::max(x, 0), grid_x - 1);
+                    y = std::min(std::max(y, 0), grid_y - 1);
+                    chunk.activeTiles.push_back(y * grid_x + x);
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+        }
+    };
+#ifndef NPNR_DISABLE_THREADS
+    if (num_chunks > 1) {
+        if (renderPool_ == nullptr)
+            renderPool_.reset(new WorkerPool(std::max(1, int(std::thread::hardware_concurrency()))));
+        std::vector<int> tasks(num_chunks);
+        std::iota(tasks.begin(), tasks.end(), 0);
+        renderPool_->run(tasks, render_chunk);
+    } else
+#endif
+        for (int i = 0; i < num_chunks; i++)
+            render_chunk(i);
+
+    std::vector<int> tile_active(grid_x * grid_y, 0);
+    DecalShapes shapes[3];
+    for (auto &chunk : chunks) {
+        for (int i = 0; i < GraphicElement::STYLE_MAX; i++)
+            data->gfxByStyle[i].append(chunk.gfxByStyle[i]);
+        for (int i = 0; i < 3; i++) {
+            for (auto &shape : chunk.shapes[i].shapes) {
+                auto found = shapes[i].index.find(shape.first);
+                if (found == shapes[i].index.end()) {
+                    shapes[i].index.emplace(shape.first, int(shapes[i].shapes.size()));
+                    shapes[i].shapes.push_back(std::move(shape));
+                } else {
+                    auto &offsets = shapes[i].shapes.at(found->second).second.offsets;
+                    offsets.insert(offsets.end(), shape.second.offsets.begin(), shape.second.offsets.end());
+                }
+            }
+        }
+        for (int i = 0; i < 2; i++)
+            data->gfxRouting[i].append(chunk.gfxRouting[i]);
+        for (int tile : chunk.activeTiles)
+            tile_active[tile]++;
+        data->bbGlobal.setX0(std::min(data->bbGlobal.x0(), chunk.bb.x0()));
+        data->bbGlobal.setY0(std::min(data->bbGlobal.y0(), chunk.bb.y0()));
+        data->bbGlobal.setX1(std::max(data->bbGlobal.x1(), chunk.bb.x1()));
+        data->bbGlobal.setY1(std::max(data->bbGlobal.y1(), chunk.bb.y1()));
+    }
+
+    for (int i = 0; i < 3; i++) {
+        for (auto &shape : shapes[i].shapes)
+            data->gfxInstanced[i].addShape(shape.second.geometry, shape.second.offsets);
+    }
+
+    // The zoomed out view has one square per tile with active routing, growing with the amount of it. This is a few
+    // lines per tile, rather than one per wire and pip
+    int max_active = *std::max_element(tile_active.begin(), tile_active.end());
+    if (max_active == 0)
+        return;
+    for (int y = 0; y < grid_y; y++) {
+        for (int x = 0; x < grid_x; x++) {
+            int active = tile_active[y * grid_x + x];
+            if (active == 0)
+                continue;
+            float size = 0.1f + 0.35f * std::sqrt(float(active) / max_active);
+            auto line = PolyLine(true);
+            line.point(x + 0.5f - size, y + 0.5f - size);
+            line.point(x + 0.5f + size, y + 0.5f - size);
+            line.point(x + 0.5f + size, y + 0.5f + size);
+            line.point(x + 0.5f - size, y + 0.5f + size);
+            line.build(data->gfxRoutingLowDetail);
+        }
+    }
+}
+
+void FPGAViewWidget::addPickBoxes(PickBoxes &out, const DecalXY &decal, const PickedElement &element)
 {
     float x = decal.x;
     float y = decal.y;
@@ -244,10 +407,9 @@ void FPGAViewWidget::populateQuadTree(RendererData *data, const DecalXY &decal,
             continue;
         }
 
-        bool res = true;
         if (el.type == GraphicElement::TYPE_BOX) {
             // Boxes are bounded by themselves.
-            res = data->qt->insert(PickQuadTree::BoundingBox(x + el.x1, y + el.y1, x + el.x2, y + el.y2), element);
+            out.emplace_back(PickQuadTree::BoundingBox(x + el.x1, y + el.y1, x + el.x2, y + el.y2), element);
         }
 
         if (el.type == GraphicElement::TYPE_LINE || el.type == GraphicElement::TYPE_ARROW) {
@@ -266,11 +428,7 @@ void FPGAViewWidget::populateQuadTree(RendererData *data, const DecalXY &decal,
             x1 += 0.01;
             y1 += 0.01;
 
-            res = data->qt->insert(PickQuadTree::BoundingBox(x0, y0, x1, y1), element);
-        }
-
-        if (!res) {
-            NPNR_ASSERT_FALSE("populateQuadTree: could not insert element");
+            out.emplace_back(PickQuadTree::BoundingBox(x0, y0, x1, y1), element);
         }
     }
 }
@@ -311,11 +469,24 @@ void FPGAViewWidget::paintGL()
     lineShader_.draw(GraphicElement::STYLE_GRID, colors_.grid, thick1Px, matrix);
 
     // Render Arch graphics.
+    lineShader_.draw(LineShader::BUFFER_INSTANCED_FRAME, colors_.frame, thick11Px, matrix);
     lineShader_.draw(GraphicElement::STYLE_FRAME, colors_.frame, thick11Px, matrix);
     lineShader_.draw(GraphicElement::STYLE_HIDDEN, colors_.hidden, thick11Px, matrix);
+    lineShader_.draw(LineShader::BUFFER_INSTANCED_INACTIVE, colors_.inactive, thick11Px, matrix);
     lineShader_.draw(GraphicElement::STYLE_INACTIVE, colors_.inactive, thick11Px, matrix);
+    lineShader_.draw(LineShader::BUFFER_INSTANCED_ACTIVE, colors_.active, thick11Px, matrix);
     lineShader_.draw(GraphicElement::STYLE_ACTIVE, colors_.active, thick11Px, matrix);
 
+    // Once a tile is only a few pixels across, individual wires and pips can't be made out, and drawing them all is
+    // what makes large devices slow to pan and zoom. Show the per-tile summary of used routing instead
+    bool lowDetail = thick1Px > 1.0f / 12;
+    if (lowDetail) {
+        lineShader_.draw(LineShader::BUFFER_ROUTING_LOW_DETAIL, colors_.active, thick2Px, matrix);
+    } else {
+        lineShader_.draw(LineShader::BUFFER_ROUTING_INACTIVE, colors_.inactive, thick11Px, matrix);
+        lineShader_.draw(LineShader::BUFFER_ROUTING_ACTIVE, colors_.active, thick11Px, matrix);
+    }
+
     // Draw highlighted items.
     for (int i = 0; i < 8; i++) {
         GraphicElement::style_t style = (GraphicElement::style_t)(GraphicElement::STYLE_HIGHLIGHTED0 + i);
@@ -374,69 +545,64 @@ void FPGAViewWidget::renderLines(void)
     if (ctx_ == nullptr)
         return;
 
-    // Data from Context needed to render all decals.
-    std::vector<std::pair<DecalXY, BelId>> belDecals;
-    std::vector<std::pair<DecalXY, WireId>> wireDecals;
-    std::vector<std::pair<DecalXY, PipId>> pipDecals;
-    std::vector<std::pair<DecalXY, GroupId>> groupDecals;
+    // Changes published by the flow since the last render. Only a full reload needs the Context lock, so following
+    // placement and routing doesn't hold up the flow.
+    Context::UiUpdates updates;
+    ctx_->takeUiUpdates(updates);
+
     bool decalsChanged = false;
-    {
+    // Binding a bel, wire or pip only changes the style of its decal, not where it is, so the picking quadtree only
+    // needs rebuilding when everything is reloaded (which includes the displayed kinds of decal changing). Groups that
+    // changed are updated in place
+    bool decalsMoved = false;
+    std::unordered_set<GroupId> movedGroups;
+    if (updates.all || updates.frame) {
+        decalsChanged = true;
+        decalsMoved = true;
+        belDecals_.clear();
+        wireDecals_.clear();
+        pipDecals_.clear();
+        groupDecals_.clear();
+
         // Take the UI/Normal mutex on the Context, copy over all we need as
         // fast as we can.
         std::lock_guard<std::mutex> lock_ui(ctx_->ui_mutex);
         std::lock_guard<std::mutex> lock(ctx_->mutex);
 
-        // For now, collapse any decal changes into change of all decals.
-        // TODO(q3k): fix this
-        if (ctx_->allUiReload) {
-            ctx_->allUiReload = false;
-            decalsChanged = true;
-        }
-        if (ctx_->frameUiReload) {
-            ctx_->frameUiReload = false;
-            decalsChanged = true;
+        if (displayBel_) {
+            for (auto bel : ctx_->getBels()) {
+                belDecals_.decals.push_back({ctx_->getBelDecal(bel), bel});
+            }
         }
-        if (ctx_->belUiReload.size() > 0) {
-            ctx_->belUiReload.clear();
-            decalsChanged = true;
+        if (displayWire_) {
+            for (auto wire : ctx_->getWires()) {
+                wireDecals_.decals.push_back({ctx_->getWireDecal(wire), wire});
+            }
         }
-        if (ctx_->wireUiReload.size() > 0) {
-            ctx_->wireUiReload.clear();
-            decalsChanged = true;
+        if (displayPip_) {
+            for (auto pip : ctx_->getPips()) {
+                pipDecals_.decals.push_back({ctx_->getPipDecal(pip), pip});
+            }
         }
-        if (ctx_->pipUiReload.size() > 0) {
-            ctx_->pipUiReload.clear();
-            decalsChanged = true;
+        if (displayGroup_) {
+            for (auto group : ctx_->getGroups()) {
+                groupDecals_.decals.push_back({ctx_->getGroupDecal(group), group});
+            }
         }
-        if (ctx_->groupUiReload.size() > 0) {
-            ctx_->groupUiReload.clear();
+    } else {
+        decalsChanged |= belDecals_.update(updates.bels);
+        decalsChanged |= wireDecals_.update(updates.wires);
+        decalsChanged |= pipDecals_.update(updates.pips);
+        if (groupDecals_.update(updates.groups)) {
             decalsChanged = true;
-        }
-
-        // Local copy of decals, taken as fast as possible to not block the P&R.
-        if (decalsChanged) {
-            if (displayBel_) {
-                for (auto bel : ctx_->getBels()) {
-                    belDecals.push_back({ctx_->getBelDecal(bel), bel});
-                }
-            }
-            if (displayWire_) {
-                for (auto wire : ctx_->getWires()) {
-                    wireDecals.push_back({ctx_->getWireDecal(wire), wire});
-                }
-            }
-            if (displayPip_) {
-                for (auto pip : ctx_->getPips()) {
-                    pipDecals.push_back({ctx_->getPipDecal(pip), pip});
-                }
-            }
-            if (displayGroup_) {
-                for (auto group : ctx_->getGroups()) {
-                    groupDecals.push_back({ctx_->getGroupDecal(group), group});
-                }
-            }
+            for (auto &change : updates.groups)
+                movedGroups.insert(change.first);
         }
     }
+    auto &belDecals = belDecals_.decals;
+    auto &wireDecals = wireDecals_.decals;
+    auto &pipDecals = pipDecals_.decals;
+    auto &groupDecals = groupDecals_.decals;
 
     // Arguments from the main UI thread on what we should render.
     std::vector<DecalXY> selectedDecals;
@@ -463,71 +629,86 @@ void FPGAViewWidget::renderLines(void)
     // Render decals if necessary.
     if (decalsChanged) {
         int last_render[GraphicElement::STYLE_HIGHLIGHTED0];
+        int last_render_routing[3];
+        int last_render_instanced[3];
         {
             QMutexLocker locker(&rendererDataLock_);
             for (int i = 0; i < GraphicElement::STYLE_HIGHLIGHTED0; i++)
                 last_render[i] = rendererData_->gfxByStyle[(enum GraphicElement::style_t)i].last_render;
+            for (int i = 0; i < 2; i++)
+                last_render_routing[i] = rendererData_->gfxRouting[i].last_render;
+            last_render_routing[2] = rendererData_->gfxRoutingLowDetail.last_render;
+            for (int i = 0; i < 3; i++)
+                last_render_instanced[i] = rendererData_->gfxInstanced[i].last_render;
         }
 
         auto data = std::unique_ptr<FPGAViewWidget::RendererData>(new FPGAViewWidget::RendererData);
         // Reset bounding box.
         data->bbGlobal.clear();
 
-        // Draw Bels.
-        if (displayBel_) {
-            for (auto const &decal : belDecals) {
-                renderArchDecal(data->gfxByStyle, data->bbGlobal, decal.first);
-            }
-        }
-        // Draw Wires.
-        if (displayWire_) {
-            for (auto const &decal : wireDecals) {
-                renderArchDecal(data->gfxByStyle, data->bbGlobal, decal.first);
-            }
-        }
-        // Draw Pips.
-        if (displayPip_) {
-            for (auto const &decal : pipDecals) {
-                renderArchDecal(data->gfxByStyle, data->bbGlobal, decal.first);
-            }
-        }
-        // Draw Groups.
-        if (displayGroup_) {
-            for (auto const &decal : groupDecals) {
-                renderArchDecal(data->gfxByStyle, data->bbGlobal, decal.first);
-            }
-        }
+        // Draw Bels, Wires, Pips and Groups.
+        std::vector<DecalXY> decals;
+        decals.reserve(belDecals.size() + wireDecals.size() + pipDecals.size() + groupDecals.size());
+        for (auto const &decal : belDecals)
+            decals.push_back(decal.first);
+        int routing_begin = int(decals.size());
+        for (auto const &decal : wireDecals)
+            decals.push_back(decal.first);
+        for (auto const &decal : pipDecals)
+            decals.push_back(decal.first);
+        int routing_end = int(decals.size());
+        for (auto const &decal : groupDecals)
+            decals.push_back(decal.first);
+        renderArchDecals(data.get(), decals, routing_begin, routing_end);
 
         // Bounding box should be calculated by now.
         NPNR_ASSERT(data->bbGlobal.w() != 0);
         NPNR_ASSERT(data->bbGlobal.h() != 0);
 
-        // Enlarge the bounding box slightly for the picking - when we insert
-        // elements into it, we enlarge their bounding boxes slightly, so
-        // we need to give ourselves some sagery margin here.
-        auto bb = data->bbGlobal;
-        bb.setX0(bb.x0() - 1);
-        bb.setY0(bb.y0() - 1);
-        bb.setX1(bb.x1() + 1);
-        bb.setY1(bb.y1() + 1);
-
-        // Populate picking quadtree.
-        data->qt = std::unique_ptr<PickQuadTree>(new PickQuadTree(bb));
-        for (auto const &decal : belDecals) {
-            populateQuadTree(data.get(), decal.first,
-                             PickedElement::fromBel(decal.second, decal.first.x, decal.first.y));
-        }
-        for (auto const &decal : wireDecals) {
-            populateQuadTree(data.get(), decal.first,
-                             PickedElement::fromWire(decal.second, decal.first.x, decal.first.y));
-        }
-        for (auto const &decal : pipDecals) {
-            populateQuadTree(data.get(), decal.first,
-                             PickedElement::fromPip(decal.second, decal.first.x, decal.first.y));
+        if (!decalsMoved) {
+            QMutexLocker lock(&rendererDataLock_);
+            if (rendererData_->qt == nullptr) {
+                decalsMoved = true;
+            } else if (!movedGroups.empty()) {
+                // Swap out the picking boxes of the groups that changed, only falling back to rebuilding the tree if
+                // a group has moved outside of it
+                rendererData_->qt->remove_if([&](const PickedElement &e) {
+                    return e.type == ElementType::GROUP && movedGroups.count(e.group);
+                });
+                PickBoxes boxes;
+                for (auto const &decal : groupDecals) {
+                    if (movedGroups.count(decal.second))
+                        addPickBoxes(boxes, decal.first,
+                                     PickedElement::fromGroup(decal.second, decal.first.x, decal.first.y));
+                }
+                if (!rendererData_->qt->insert_bulk(std::move(boxes)))
+                    decalsMoved = true;
+            }
         }
-        for (auto const &decal : groupDecals) {
-            populateQuadTree(data.get(), decal.first,
+        if (decalsMoved) {
+            // Enlarge the bounding box slightly for the picking - when we insert
+            // elements into it, we enlarge their bounding boxes slightly, so
+            // we need to give ourselves some sagery margin here.
+            auto bb = data->bbGlobal;
+            bb.setX0(bb.x0() - 1);
+            bb.setY0(bb.y0() - 1);
+            bb.setX1(bb.x1() + 1);
+            bb.setY1(bb.y1() + 1);
+
+            // Populate picking quadtree, loading it in one go.
+            PickBoxes boxes;
+            for (auto const &decal : belDecals)
+                addPickBoxes(boxes, decal.first, PickedElement::fromBel(decal.second, decal.first.x, decal.first.y));
+            for (auto const &decal : wireDecals)
+                addPickBoxes(boxes, decal.first, PickedElement::fromWire(decal.second, decal.first.x, decal.first.y));
+            for (auto const &decal : pipDecals)
+                addPickBoxes(boxes, decal.first, PickedElement::fromPip(decal.second, decal.first.x, decal.first.y));
+            for (auto const &decal : groupDecals)
+                addPickBoxes(boxes, decal.first,
                              PickedElement::fromGroup(decal.second, decal.first.x, decal.first.y));
+            data->qt = std::unique_ptr<PickQuadTree>(new PickQuadTree(bb));
+            if (!data->qt->insert_bulk(std::move(boxes)))
+                NPNR_ASSERT_FALSE("renderLines: could not insert picking boxes");
         }
 
         // Swap over.
@@ -537,6 +718,9 @@ void FPGAViewWidget::renderLines(void)
             // If we're not re-rendering any highlights/selections, let's
             // copy them over from teh current object.
             data->gfxGrid = rendererData_->gfxGrid;
+            // Decals are where they were, so the existing quadtree still applies
+            if (!decalsMoved)
+                data->qt = std::move(rendererData_->qt);
             if (!highlightedOrSelectedChanged) {
                 data->gfxSelected = rendererData_->gfxSelected;
                 data->gfxHovered = rendererData_->gfxHovered;
@@ -545,6 +729,11 @@ void FPGAViewWidget::renderLines(void)
             }
             for (int i = 0; i < GraphicElement::STYLE_HIGHLIGHTED0; i++)
                 data->gfxByStyle[(enum GraphicElement::style_t)i].last_render = ++last_render[i];
+            for (int i = 0; i < 2; i++)
+                data->gfxRouting[i].last_render = ++last_render_routing[i];
+            data->gfxRoutingLowDetail.last_render = ++last_render_routing[2];
+            for (int i = 0; i < 3; i++)
+                data->gfxInstanced[i].last_render = ++last_render_instanced[i];
             rendererData_ = std::move(data);
         }
     }
@@ -937,6 +1126,11 @@ void FPGAViewWidget::update_vbos()
     for (int style = GraphicElement::STYLE_FRAME; style < GraphicElement::STYLE_HIGHLIGHTED0; style++) {
         lineShader_.update_vbos((enum GraphicElement::style_t)(style), rendererData_->gfxByStyle[style]);
     }
+    lineShader_.update_vbos(LineShader::BUFFER_ROUTING_INACTIVE, rendererData_->gfxRouting[0]);
+    lineShader_.update_vbos(LineShader::BUFFER_ROUTING_ACTIVE, rendererData_->gfxRouting[1]);
+    lineShader_.update_vbos(LineShader::BUFFER_ROUTING_LOW_DETAIL, rendererData_->gfxRoutingLowDetail);
+    for (int i = 0; i < 3; i++)
+        lineShader_.update_vbos(LineShader::BUFFER_INSTANCED_FRAME + i, rendererData_->gfxInstanced[i]);
 
     for (int i = 0; i < 8; i++) {
         GraphicElement::style_t style = (GraphicElement::style_t)(GraphicElement::STYLE_HIGHLIGHTED0 + i);
@@ -37,6 +37,7 @@
 #include "lineshader.h"
 #include "nextpnr.h"
 #include "quadtree.h"
+#include "worker_pool.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -281,6 +282,12 @@ class FPGAViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
     {
         LineShaderData gfxGrid;
         LineShaderData gfxByStyle[GraphicElement::STYLE_MAX];
+        // Inactive and active wires and pips, drawn in full when zoomed in
+        LineShaderData gfxRouting[2];
+        // Per-tile summary of active wires and pips, drawn instead of gfxRouting when zoomed out
+        LineShaderData gfxRoutingLowDetail;
+        // Frame, inactive and active styles of bels, groups and tiles
+        InstancedLineShaderData gfxInstanced[3];
         LineShaderData gfxSelected;
         LineShaderData gfxHovered;
         LineShaderData gfxHighlighted[8];
@@ -293,6 +300,49 @@ class FPGAViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
     };
     std::unique_ptr<RendererData> rendererData_;
     QMutex rendererDataLock_;
+#ifndef NPNR_DISABLE_THREADS
+    // Threads for building decal geometry, only used by the renderer thread
+    std::unique_ptr<WorkerPool> renderPool_;
+#endif
+
+    // Decals being shown, only used by the renderer thread. These are copied from the Context when everything is
+    // reloaded, and otherwise kept up to date from the changes it publishes, without taking its lock
+    template <typename T> struct ShownDecals
+    {
+        std::vector<std::pair<DecalXY, T>> decals;
+        // Position of each object in decals, built when first needed
+        std::unordered_map<T, int> index;
+
+        void clear()
+        {
+            decals.clear();
+            index.clear();
+        }
+
+        // Returns whether any of the shown decals changed
+        bool update(const std::vector<std::pair<T, DecalXY>> &changes)
+        {
+            if (changes.empty() || decals.empty())
+                return false;
+            if (index.empty()) {
+                for (int i = 0; i < int(decals.size()); i++)
+                    index[decals[i].second] = i;
+            }
+            bool changed = false;
+            for (auto &change : changes) {
+                auto found = index.find(change.first);
+                if (found == index.end())
+                    continue;
+                decals[found->second].first = change.second;
+                changed = true;
+            }
+            return changed;
+        }
+    };
+    ShownDecals<BelId> belDecals_;
+    ShownDecals<WireId> wireDecals_;
+    ShownDecals<PipId> pipDecals_;
+    ShownDecals<GroupId> groupDecals_;
 
     void clampZoom();
     void zoomToBB(const PickQuadTree::BoundingBox &bb, float margin, bool clamp);
@@ -301,9 +351,21 @@ class FPGAViewWidget : public QOpenGLWidget, protected QOpenGLFunctions
     void renderGraphicElement(LineShaderData &out, PickQuadTree::BoundingBox &bb, const GraphicElement &el, float x,
                               float y);
     void renderDecal(LineShaderData &out, PickQuadTree::BoundingBox &bb, const DecalXY &decal);
-    void renderArchDecal(LineShaderData out[GraphicElement::STYLE_MAX], PickQuadTree::BoundingBox &bb,
-                         const DecalXY &decal);
-    void populateQuadTree(RendererData *data, const DecalXY &decal, const PickedElement &element);
+    // Shapes of instanced decals in one style, by their elements
+    struct DecalShapes
+    {
+        struct Shape
+        {
+            LineShaderData geometry;
+            std::vector<Vertex2DPOD> offsets;
+        };
+        std::vector<std::pair<std::string, Shape>> shapes;
+        std::unordered_map<std::string, int> index;
+    };
+    void renderInstancedDecal(DecalShapes shapes[3], PickQuadTree::BoundingBox &bb, const DecalXY &decal);
+    void renderArchDecals(RendererData *data, const std::vector<DecalXY> &decals, int routing_begin, int routing_end);
+    using PickBoxes = std::vector<std::pair<PickQuadTree::BoundingBox, PickedElement>>;
+    void addPickBoxes(PickBoxes &out, const DecalXY &decal, const PickedElement &element);
     boost::optional<PickedElement> pickElement(float worldx, float worldy);
     QVector4D mouseToWorldCoordinates(int x, int y);
     QVector4D mouseToWorldDimensions(float x, float y);
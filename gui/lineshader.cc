@@ -18,6 +18,7 @@
  */
 
 #include "lineshader.h"
+#include <QOpenGLExtraFunctions>
 #include "log.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -166,102 +167,156 @@ bool LineShader::compile(void)
     attributes_.position = program_->attributeLocation("position");
     attributes_.normal = program_->attributeLocation("normal");
     attributes_.miter = program_->attributeLocation("miter");
+    attributes_.offset = program_->attributeLocation("offset");
     uniforms_.thickness = program_->uniformLocation("thickness");
     uniforms_.projection = program_->uniformLocation("projection");
     uniforms_.color = program_->uniformLocation("color");
     program_->release();
 
-    for (int style = 0; style < GraphicElement::STYLE_MAX; style++) {
-        buffers_[style].position = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
-        buffers_[style].normal = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
-        buffers_[style].miter = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
-        buffers_[style].index = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+    // Instanced attributes are core from OpenGL 3.3, and an extension before
+    auto context = QOpenGLContext::currentContext();
+    instancing_ = context->format().version() >= qMakePair(3, 3) || context->hasExtension("GL_ARB_instanced_arrays");
 
-        if (!buffers_[style].vao.create())
+    for (int buffer = 0; buffer < BUFFER_MAX; buffer++) {
+        buffers_[buffer].position = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+        buffers_[buffer].normal = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+        buffers_[buffer].miter = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+        buffers_[buffer].index = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+        buffers_[buffer].offset = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+
+        if (!buffers_[buffer].vao.create())
             log_abort();
-        buffers_[style].vao.bind();
+        buffers_[buffer].vao.bind();
 
-        if (!buffers_[style].position.create())
+        if (!buffers_[buffer].position.create())
+            log_abort();
+        if (!buffers_[buffer].normal.create())
             log_abort();
-        if (!buffers_[style].normal.create())
+        if (!buffers_[buffer].miter.create())
             log_abort();
-        if (!buffers_[style].miter.create())
+        if (!buffers_[buffer].index.create())
             log_abort();
-        if (!buffers_[style].index.create())
+        if (!buffers_[buffer].offset.create())
             log_abort();
 
-        buffers_[style].position.setUsagePattern(QOpenGLBuffer::StaticDraw);
-        buffers_[style].normal.setUsagePattern(QOpenGLBuffer::StaticDraw);
-        buffers_[style].miter.setUsagePattern(QOpenGLBuffer::StaticDraw);
-        buffers_[style].index.setUsagePattern(QOpenGLBuffer::StaticDraw);
+        buffers_[buffer].position.setUsagePattern(QOpenGLBuffer::StaticDraw);
+        buffers_[buffer].normal.setUsagePattern(QOpenGLBuffer::StaticDraw);
+        buffers_[buffer].miter.setUsagePattern(QOpenGLBuffer::StaticDraw);
+        buffers_[buffer].index.setUsagePattern(QOpenGLBuffer::StaticDraw);
+        buffers_[buffer].offset.setUsagePattern(QOpenGLBuffer::StaticDraw);
 
-        buffers_[style].position.bind();
-        buffers_[style].normal.bind();
-        buffers_[style].miter.bind();
-        buffers_[style].index.bind();
+        buffers_[buffer].position.bind();
+        buffers_[buffer].normal.bind();
+        buffers_[buffer].miter.bind();
+        buffers_[buffer].index.bind();
 
-        buffers_[style].vao.release();
+        buffers_[buffer].vao.release();
     }
 
     return true;
 }
 
-void LineShader::update_vbos(enum GraphicElement::style_t style, const LineShaderData &line)
+void LineShader::update_vbos(int buffer, const LineShaderData &line)
 {
-    if (buffers_[style].last_vbo_update == line.last_render)
+    if (buffers_[buffer].last_vbo_update == line.last_render)
         return;
-    buffers_[style].last_vbo_update = line.last_render;
+    buffers_[buffer].last_vbo_update = line.last_render;
+    upload_lines(buffer, line);
+}
+
+void LineShader::upload_lines(int buffer, const LineShaderData &line)
+{
+    buffers_[buffer].draws.clear();
 
-    buffers_[style].indices = line.indices.size();
-    if (buffers_[style].indices == 0)
+    buffers_[buffer].indices = line.indices.size();
+    if (buffers_[buffer].indices == 0)
         return;
 
-    buffers_[style].position.bind();
-    buffers_[style].position.allocate(&line.vertices[0], sizeof(Vertex2DPOD) * line.vertices.size());
+    buffers_[buffer].position.bind();
+    buffers_[buffer].position.allocate(&line.vertices[0], sizeof(Vertex2DPOD) * line.vertices.size());
+
+    buffers_[buffer].normal.bind();
+    buffers_[buffer].normal.allocate(&line.normals[0], sizeof(Vertex2DPOD) * line.normals.size());
+
+    buffers_[buffer].miter.bind();
+    buffers_[buffer].miter.allocate(&line.miters[0], sizeof(GLfloat) * line.miters.size());
+
+    buffers_[buffer].index.bind();
+    buffers_[buffer].index.allocate(&line.indices[0], sizeof(GLuint) * line.indices.size());
+}
+
+void LineShader::update_vbos(int buffer, const InstancedLineShaderData &instanced)
+{
+    if (buffers_[buffer].last_vbo_update == instanced.last_render)
+        return;
+    buffers_[buffer].last_vbo_update = instanced.last_render;
 
-    buffers_[style].normal.bind();
-    buffers_[style].normal.allocate(&line.normals[0], sizeof(Vertex2DPOD) * line.normals.size());
+    if (!instancing_) {
+        LineShaderData expanded;
+        instanced.expand(expanded);
+        upload_lines(buffer, expanded);
+        return;
+    }
 
-    buffers_[style].miter.bind();
-    buffers_[style].miter.allocate(&line.miters[0], sizeof(GLfloat) * line.miters.size());
+    upload_lines(buffer, instanced.shapes);
+    buffers_[buffer].draws = instanced.draws;
+    if (buffers_[buffer].indices == 0)
+        return;
 
-    buffers_[style].index.bind();
-    buffers_[style].index.allocate(&line.indices[0], sizeof(GLuint) * line.indices.size());
+    buffers_[buffer].offset.bind();
+    buffers_[buffer].offset.allocate(&instanced.offsets[0], sizeof(Vertex2DPOD) * instanced.offsets.size());
 }
 
-void LineShader::draw(enum GraphicElement::style_t style, const QColor &color, float thickness,
-                      const QMatrix4x4 &projection)
+void LineShader::draw(int buffer, const QColor &color, float thickness, const QMatrix4x4 &projection)
 {
     auto gl = QOpenGLContext::currentContext()->functions();
-    if (buffers_[style].indices == 0)
+    if (buffers_[buffer].indices == 0)
         return;
     program_->bind();
-    buffers_[style].vao.bind();
+    buffers_[buffer].vao.bind();
 
     program_->setUniformValue(uniforms_.projection, projection);
     program_->setUniformValue(uniforms_.thickness, thickness);
     program_->setUniformValue(uniforms_.color, color.redF(), color.greenF(), color.blueF(), color.alphaF());
 
-    buffers_[style].position.bind();
+    buffers_[buffer].position.bind();
     program_->enableAttributeArray(attributes_.position);
     program_->setAttributeBuffer(attributes_.position, GL_FLOAT, 0, 2);
 
-    buffers_[style].normal.bind();
+    buffers_[buffer].normal.bind();
     program_->enableAttributeArray(attributes_.normal);
     program_->setAttributeBuffer(attributes_.normal, GL_FLOAT, 0, 2);
 
-    buffers_[style].miter.bind();
+    buffers_[buffer].miter.bind();
     program_->enableAttributeArray(attributes_.miter);
     program_->setAttributeBuffer(attributes_.miter, GL_FLOAT, 0, 1);
 
-    buffers_[style].index.bind();
-    gl->glDrawElements(GL_TRIANGLES, buffers_[style].indices, GL_UNSIGNED_INT, (void *)0);
+    buffers_[buffer].index.bind();
+    if (buffers_[buffer].draws.empty()) {
+        program_->setAttributeValue(attributes_.offset, 0.0f, 0.0f);
+        gl->glDrawElements(GL_TRIANGLES, buffers_[buffer].indices, GL_UNSIGNED_INT, (void *)0);
+    } else {
+        // One draw call per shape, with the offset attribute advancing once per instance
+        auto extra = QOpenGLContext::currentContext()->extraFunctions();
+        buffers_[buffer].offset.bind();
+        program_->enableAttributeArray(attributes_.offset);
+        extra->glVertexAttribDivisor(attributes_.offset, 1);
+        for (auto &draw : buffers_[buffer].draws) {
+            if (draw.num_indices == 0 || draw.num_instances == 0)
+                continue;
+            program_->setAttributeBuffer(attributes_.offset, GL_FLOAT, sizeof(Vertex2DPOD) * draw.first_instance, 2);
+            extra->glDrawElementsInstanced(GL_TRIANGLES, draw.num_indices, GL_UNSIGNED_INT,
+                                           (void *)(sizeof(GLuint) * draw.first_index), draw.num_instances);
+        }
+        extra->glVertexAttribDivisor(attributes_.offset, 0);
+        program_->disableAttributeArray(attributes_.offset);
+    }
 
     program_->disableAttributeArray(attributes_.position);
     program_->disableAttributeArray(attributes_.normal);
     program_->disableAttributeArray(attributes_.miter);
 
-    buffers_[style].vao.release();
+    buffers_[buffer].vao.release();
     program_->release();
 }
 
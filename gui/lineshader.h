@@ -25,6 +25,7 @@
 #include <QOpenGLShaderProgram>
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLWidget>
+#include <algorithm>
 #include <array>
 
 #include "log.h"
@@ -60,6 +61,83 @@ struct LineShaderData
         miters.clear();
         indices.clear();
     }
+
+    // Append the lines of another LineShaderData, as if they had been built into this one
+    void append(const LineShaderData &other)
+    {
+        GLuint offset = GLuint(vertices.size());
+        vertices.insert(vertices.end(), other.vertices.begin(), other.vertices.end());
+        normals.insert(normals.end(), other.normals.begin(), other.normals.end());
+        miters.insert(miters.end(), other.miters.begin(), other.miters.end());
+        indices.reserve(indices.size() + other.indices.size());
+        for (auto index : other.indices)
+            indices.push_back(index + offset);
+    }
+};
+
+// InstancedLineShaderData is geometry made of a few shapes, each drawn at many
+// offsets. Each shape is built once relative to its own origin, and every
+// instance of it only adds an offset, which saves building and uploading the
+// same lines again for every bel or tile.
+struct InstancedLineShaderData
+{
+    // All shapes, one after another.
+    LineShaderData shapes;
+    // All instance offsets, grouped by shape.
+    std::vector<Vertex2DPOD> offsets;
+
+    struct Shape
+    {
+        int first_index, num_indices;
+        int first_instance, num_instances;
+    };
+    std::vector<Shape> draws;
+
+    int last_render = 0;
+
+    void clear(void)
+    {
+        shapes.clear();
+        offsets.clear();
+        draws.clear();
+    }
+
+    // Add a shape and where it should be drawn.
+    void addShape(const LineShaderData &shape, const std::vector<Vertex2DPOD> &instances)
+    {
+        Shape draw;
+        draw.first_index = int(shapes.indices.size());
+        draw.num_indices = int(shape.indices.size());
+        draw.first_instance = int(offsets.size());
+        draw.num_instances = int(instances.size());
+        shapes.append(shape);
+        offsets.insert(offsets.end(), instances.begin(), instances.end());
+        draws.push_back(draw);
+    }
+
+    // Build every instance out in full, for when the GPU can't draw instances.
+    void expand(LineShaderData &out) const
+    {
+        for (auto &draw : draws) {
+            if (draw.num_indices == 0)
+                continue;
+            // Each shape was built from its own run of vertices
+            auto first = shapes.indices.begin() + draw.first_index;
+            auto last = first + draw.num_indices;
+            GLuint first_vertex = *std::min_element(first, last);
+            GLuint end_vertex = *std::max_element(first, last) + 1;
+            for (int i = draw.first_instance; i < draw.first_instance + draw.num_instances; i++) {
+                GLuint base = GLuint(out.vertices.size());
+                for (GLuint v = first_vertex; v < end_vertex; v++) {
+                    out.vertices.emplace_back(shapes.vertices[v].x + offsets[i].x, shapes.vertices[v].y + offsets[i].y);
+                    out.normals.push_back(shapes.normals[v]);
+                    out.miters.push_back(shapes.miters[v]);
+                }
+                for (auto it = first; it != last; ++it)
+                    out.indices.push_back(*it - first_vertex + base);
+            }
+        }
+    }
 };
 
 // PolyLine is a set of segments defined by points, that can be built to a
@@ -141,21 +219,46 @@ class LineShader
         // - which way the normal should be applied (+1 for one vertex, -1
         //   for the other)
         GLuint miter;
+        // offset of the instance being drawn, zero when not drawing instances
+        GLuint offset;
     } attributes_;
 
+    // Whether the GPU can draw instances, otherwise instanced data is built
+    // out in full when uploaded.
+    bool instancing_ = false;
+
     // GL buffers
+  public:
+    // Buffers beyond the per-style ones, for the wires and pips which are drawn at a level of detail depending on zoom
+    enum LineShaderBuffer
+    {
+        BUFFER_ROUTING_INACTIVE = GraphicElement::STYLE_MAX,
+        BUFFER_ROUTING_ACTIVE,
+        BUFFER_ROUTING_LOW_DETAIL,
+        // Bels, groups and tiles, as instances of repeated shapes
+        BUFFER_INSTANCED_FRAME,
+        BUFFER_INSTANCED_INACTIVE,
+        BUFFER_INSTANCED_ACTIVE,
+
+        BUFFER_MAX
+    };
+
+  private:
     struct Buffers
     {
         QOpenGLBuffer position;
         QOpenGLBuffer normal;
         QOpenGLBuffer miter;
         QOpenGLBuffer index;
+        QOpenGLBuffer offset;
         QOpenGLVertexArrayObject vao;
         int indices = 0;
+        // Shapes to draw instances of, empty unless drawing instances
+        std::vector<InstancedLineShaderData::Shape> draws;
 
         int last_vbo_update = 0;
     };
-    std::array<Buffers, GraphicElement::STYLE_MAX> buffers_;
+    std::array<Buffers, BUFFER_MAX> buffers_;
 
     // GL uniform locations.
     struct
@@ -168,6 +271,9 @@ class LineShader
         GLuint color;
     } uniforms_;
 
+    // Upload lines to a buffer, to be drawn once.
+    void upload_lines(int buffer, const LineShaderData &line);
+
   public:
     LineShader(QObject *parent) : parent_(parent), program_(nullptr) {}
 
@@ -176,10 +282,11 @@ class LineShader
             "in highp vec2  position;\n"
             "in highp vec2  normal;\n"
             "in highp float miter;\n"
+            "in highp vec2  offset;\n"
             "uniform   highp float thickness;\n"
             "uniform   highp mat4  projection;\n"
             "void main() {\n"
-            "   vec2 p = position.xy + vec2(normal * thickness/2.0 / miter);\n"
+            "   vec2 p = position.xy + offset + vec2(normal * thickness/2.0 / miter);\n"
             "   gl_Position = projection * vec4(p, 0.0, 1.0);\n"
             "}\n";
 
@@ -193,10 +300,12 @@ class LineShader
     // Must be called on initialization.
     bool compile(void);
 
-    void update_vbos(enum GraphicElement::style_t style, const LineShaderData &line);
+    // Buffers are indexed by style, or by one of the LineShaderBuffer extras.
+    void update_vbos(int buffer, const LineShaderData &line);
+    void update_vbos(int buffer, const InstancedLineShaderData &instanced);
 
     // Render a LineShaderData with a given M/V/P transformation.
-    void draw(enum GraphicElement::style_t style, const QColor &color, float thickness, const QMatrix4x4 &projection);
+    void draw(int buffer, const QColor &color, float thickness, const QMatrix4x4 &projection);
 };
 
 NEXTPNR_NAMESPACE_END
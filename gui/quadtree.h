@@ -206,6 +206,65 @@ template <typename CoordinateT, typename ElementT> class QuadTreeNode
         return true;
     }
 
+    // Creates the four children of this node. Elements already in this node
+    // stay here, it's up to the caller to move them down.
+    void split()
+    {
+        // Calculate the split point.
+        splitx_ = (bound_.x1_ - bound_.x0_) / 2 + bound_.x0_;
+        splity_ = (bound_.y1_ - bound_.y0_) / 2 + bound_.y0_;
+        // Create the new children.
+        children_ = decltype(children_)(new QuadTreeNode<CoordinateT, ElementT>[4] {
+            // Note: not using [NW] = QuadTreeNode because that seems to
+            //       crash g++ 7.3.0.
+            /* NW */ QuadTreeNode<CoordinateT, ElementT>(BoundingBox(bound_.x0_, bound_.y0_, splitx_, splity_),
+                                                         depth_ + 1, max_elems_),
+                    /* NE */
+                    QuadTreeNode<CoordinateT, ElementT>(BoundingBox(splitx_, bound_.y0_, bound_.x1_, splity_),
+                                                        depth_ + 1, max_elems_),
+                    /* SW */
+                    QuadTreeNode<CoordinateT, ElementT>(BoundingBox(bound_.x0_, splity_, splitx_, bound_.y1_),
+                                                        depth_ + 1, max_elems_),
+                    /* SE */
+                    QuadTreeNode<CoordinateT, ElementT>(BoundingBox(splitx_, splity_, bound_.x1_, bound_.y1_),
+                                                        depth_ + 1, max_elems_),
+        });
+    }
+
+    // Insert elements known to fit this node, all at once. The node splits
+    // (if it needs to) with all its elements at hand, and hands each child
+    // its share in one go, instead of elements being moved down again on
+    // every split as with one-by-one insertion.
+    void insert_bulk_fitting(std::vector<BoundElement> &&elems)
+    {
+        if (children_ == nullptr) {
+            if (elems_.size() + elems.size() <= max_elems_ || depth_ > 5) {
+                for (auto &elem : elems)
+                    elems_.push_back(std::move(elem));
+                return;
+            }
+            split();
+            for (auto &elem : elems_)
+                elems.push_back(std::move(elem));
+            elems_.clear();
+        }
+
+        std::vector<BoundElement> quadrants[4];
+        for (auto &elem : elems) {
+            auto quad = quadrant(elem.bb_);
+            if (quad == THIS_NODE)
+                elems_.push_back(std::move(elem));
+            else
+                quadrants[quad].push_back(std::move(elem));
+        }
+        elems.clear();
+        elems.shrink_to_fit();
+        for (int i = 0; i < 4; i++) {
+            if (!quadrants[i].empty())
+                children_[i].insert_bulk_fitting(std::move(quadrants[i]));
+        }
+    }
+
   public:
     // Standard constructor for node.
     // @param b BoundingBox this node covers.
@@ -262,25 +321,7 @@ template <typename CoordinateT, typename ElementT> class QuadTreeNode
                 elems_.push_back(BoundElement(k, std::move(v)));
                 return true;
             }
-            // Splitting. Calculate the split point.
-            splitx_ = (bound_.x1_ - bound_.x0_) / 2 + bound_.x0_;
-            splity_ = (bound_.y1_ - bound_.y0_) / 2 + bound_.y0_;
-            // Create the new children.
-            children_ = decltype(children_)(new QuadTreeNode<CoordinateT, ElementT>[4] {
-                // Note: not using [NW] = QuadTreeNode because that seems to
-                //       crash g++ 7.3.0.
-                /* NW */ QuadTreeNode<CoordinateT, ElementT>(BoundingBox(bound_.x0_, bound_.y0_, splitx_, splity_),
-                                                             depth_ + 1, max_elems_),
-                        /* NE */
-                        QuadTreeNode<CoordinateT, ElementT>(BoundingBox(splitx_, bound_.y0_, bound_.x1_, splity_),
-                                                            depth_ + 1, max_elems_),
-                        /* SW */
-                        QuadTreeNode<CoordinateT, ElementT>(BoundingBox(bound_.x0_, splity_, splitx_, bound_.y1_),
-                                                            depth_ + 1, max_elems_),
-                        /* SE */
-                        QuadTreeNode<CoordinateT, ElementT>(BoundingBox(splitx_, splity_, bound_.x1_, bound_.y1_),
-                                                            depth_ + 1, max_elems_),
-            });
+            split();
             // Move all elements to where they belong.
             auto it = elems_.begin();
             while (it != elems_.end()) {
@@ -302,6 +343,40 @@ template <typename CoordinateT, typename ElementT> class QuadTreeNode
         return true;
     }
 
+    // Insert many elements at once. Either all of them are inserted or, if
+    // any doesn't fit this node, none are.
+    bool insert_bulk(std::vector<std::pair<BoundingBox, ElementT>> &&elems)
+    {
+        std::vector<BoundElement> bound;
+        bound.reserve(elems.size());
+        for (auto &elem : elems) {
+            if (!fits(elem.first))
+                return false;
+            bound.push_back(BoundElement(elem.first, std::move(elem.second)));
+        }
+        elems.clear();
+        insert_bulk_fitting(std::move(bound));
+        return true;
+    }
+
+    // Remove all elements for which pred returns true.
+    // @returns count of elements removed.
+    template <typename Pred> size_t remove_if(const Pred &pred)
+    {
+        size_t before = elems_.size();
+        elems_.erase(std::remove_if(elems_.begin(), elems_.end(),
+                                    [&](const BoundElement &elem) { return pred(elem.elem_); }),
+                     elems_.end());
+        size_t res = before - elems_.size();
+        if (children_ != nullptr) {
+            res += children_[NW].remove_if(pred);
+            res += children_[NE].remove_if(pred);
+            res += children_[SW].remove_if(pred);
+            res += children_[SE].remove_if(pred);
+        }
+        return res;
+    }
+
     // Dump a human-readable representation of the tree to stdout.
     void dump(int level) const
     {
@@ -399,6 +474,27 @@ template <typename CoordinateT, typename ElementT> class QuadTree
         return root_.insert(k, v);
     }
 
+    // Inserts many values at once. This gives the same lookups as inserting
+    // them one by one, but is much faster for large numbers of values as no
+    // value is moved between nodes as the tree splits.
+    //
+    // @param elems Bounding boxes and the values to store at them.
+    // @returns Whether the insert was successful. If any bounding box doesn't
+    //          fit the tree, no values are inserted.
+    bool insert_bulk(std::vector<std::pair<BoundingBox, ElementT>> elems)
+    {
+        for (auto &elem : elems)
+            elem.first.fixup();
+        return root_.insert_bulk(std::move(elems));
+    }
+
+    // Removes all values for which a predicate returns true. Together with
+    // insert, this lets parts of the tree be updated without rebuilding it.
+    //
+    // @param pred Callable taking a const reference to a value.
+    // @returns Count of values removed.
+    template <typename Pred> size_t remove_if(const Pred &pred) { return root_.remove_if(pred); }
+
     // Dump a human-readable representation of the tree to stdout.
     void dump() const { root_.dump(0); }
 
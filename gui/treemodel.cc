@@ -19,6 +19,8 @@
  */
 
 #include "treemodel.h"
+#include <algorithm>
+#include <iterator>
 #include "log.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -145,6 +147,72 @@ void IdStringList::search(QList<Item *> &results, QString text, int limit)
     }
 }
 
+SearchIndex::SearchIndex(int count, std::function<std::string(int)> name, const std::atomic<bool> &cancel)
+{
+    offsets_.reserve(count + 1);
+    offsets_.push_back(0);
+    for (int i = 0; i < count && !cancel; i++) {
+        chars_ += name(i);
+        offsets_.push_back(uint32_t(chars_.size()));
+    }
+    if (cancel)
+        return;
+    std::vector<uint32_t> grams;
+    for (int block = 0; block * BLOCK_SIZE < count; block++) {
+        grams.clear();
+        for (int i = block * BLOCK_SIZE; i < std::min(count, (block + 1) * BLOCK_SIZE); i++)
+            for (uint32_t j = offsets_[i]; j + 3 <= offsets_[i + 1]; j++)
+                grams.push_back(trigram(&chars_[j]));
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        for (uint32_t g : grams)
+            blocks_[g].push_back(uint32_t(block));
+    }
+}
+
+std::vector<int> SearchIndex::search(const std::string &text, int limit) const
+{
+    std::vector<int> results;
+    int count = int(offsets_.size()) - 1;
+    // Check the names of [begin, end), returning false once there are enough results
+    auto check = [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (limit != -1 && int(results.size()) > limit)
+                return false;
+            auto name_begin = chars_.begin() + offsets_[i], name_end = chars_.begin() + offsets_[i + 1];
+            if (std::search(name_begin, name_end, text.begin(), text.end()) != name_end || text.empty())
+                results.push_back(i);
+        }
+        return true;
+    };
+    if (text.size() < 3) {
+        check(0, count);
+        return results;
+    }
+
+    // Intersect the block lists of the trigrams of the text, starting from the shortest
+    std::vector<const std::vector<uint32_t> *> lists;
+    for (size_t j = 0; j + 3 <= text.size(); j++) {
+        auto fnd = blocks_.find(trigram(&text[j]));
+        if (fnd == blocks_.end())
+            return results;
+        lists.push_back(&fnd->second);
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b) { return a->size() < b->size(); });
+    std::vector<uint32_t> candidates = *lists.front(), next;
+    for (size_t k = 1; k < lists.size() && !candidates.empty(); k++) {
+        next.clear();
+        std::set_intersection(candidates.begin(), candidates.end(), lists.at(k)->begin(), lists.at(k)->end(),
+                              std::back_inserter(next));
+        candidates.swap(next);
+    }
+    for (uint32_t block : candidates)
+        if (!check(int(block) * BLOCK_SIZE, std::min(count, int(block + 1) * BLOCK_SIZE)))
+            break;
+    return results;
+}
+
 Model::Model(QObject *parent) : QAbstractItemModel(parent), root_(new Item("Elements", nullptr)) {}
 
 Model::~Model() {}
@@ -22,7 +22,11 @@
 #define TREEMODEL_H
 
 #include <QAbstractItemModel>
+#include <atomic>
 #include <boost/optional.hpp>
+#include <functional>
+#include <string>
+#include <thread>
 
 #include "nextpnr.h"
 
@@ -114,6 +118,38 @@ class Item
     }
 };
 
+// SearchIndex finds the names containing a piece of text, without going over
+// every name, for the element lists of large devices that have millions of
+// wires and pips. Names are grouped into blocks, and each trigram maps to the
+// blocks with a name containing it; only the names of blocks having every
+// trigram of the text are checked. Texts shorter than a trigram check every
+// name.
+class SearchIndex
+{
+  public:
+    // Index count names, the name of element i given by name(i). Stops early,
+    // leaving the index unusable, if cancel is set.
+    SearchIndex(int count, std::function<std::string(int)> name, const std::atomic<bool> &cancel);
+
+    // Indices of the names containing text in increasing order, stopping once
+    // there are more than limit (unless limit is -1).
+    std::vector<int> search(const std::string &text, int limit) const;
+
+  private:
+    enum
+    {
+        BLOCK_SIZE = 16
+    };
+
+    static uint32_t trigram(const char *s) { return uint8_t(s[0]) | (uint8_t(s[1]) << 8) | (uint8_t(s[2]) << 16); }
+
+    // Name i is chars_[offsets_[i], offsets_[i + 1])
+    std::string chars_;
+    std::vector<uint32_t> offsets_;
+    // Trigram -> sorted list of blocks
+    std::unordered_map<uint32_t, std::vector<uint32_t>> blocks_;
+};
+
 // IdString is an Item that corresponds to a real element in Arch.
 class IdStringItem : public Item
 {
@@ -223,6 +259,20 @@ template <typename ElementT> class ElementList : public Item
 
     virtual void fetchMore() override { fetchMore(100); }
 
+    // Number of elements, loaded or not.
+    size_t elementCount() const { return elements()->size(); }
+
+    // Name of element i, loaded or not.
+    IdString elementName(size_t i) const { return getter_(ctx_, elements()->at(i)); }
+
+    // Child for element i, loading the elements up to it.
+    Item *elementChild(size_t i)
+    {
+        while (size_t(children_.size()) <= i && canFetchMore())
+            fetchMore();
+        return children_.at(int(i));
+    }
+
     // getById finds a child for the given IdString.
     virtual boost::optional<Item *> getById(IdString id) override
     {
@@ -280,6 +330,13 @@ template <typename ElementT> class ElementXYRoot : public Item
     ElementGetter getter_;
     // Type of children that he list creates in X->Y->...
     ElementType child_type_;
+    // (ElementList, element) of every element, in order, and the search
+    // index over their names, built in the background as large devices have
+    // millions of elements.
+    std::vector<std::pair<int, int>> flat_;
+    std::unique_ptr<SearchIndex> index_;
+    std::atomic<bool> index_ready_{false}, index_cancel_{false};
+    std::thread index_thread_;
 
   public:
     ElementXYRoot(Context *ctx, ElementMap map, ElementGetter getter, ElementType type)
@@ -316,6 +373,26 @@ template <typename ElementT> class ElementXYRoot : public Item
                 managed_lists_.push_back(std::move(std::unique_ptr<ElementList<ElementT>>(item2)));
             }
         }
+
+        for (int l = 0; l < int(managed_lists_.size()); l++)
+            for (int e = 0; e < int(managed_lists_.at(l)->elementCount()); e++)
+                flat_.emplace_back(l, e);
+        index_thread_ = std::thread([this]() {
+            index_.reset(new SearchIndex(
+                    int(flat_.size()),
+                    [this](int i) {
+                        auto &fe = flat_.at(i);
+                        return std::string(managed_lists_.at(fe.first)->elementName(fe.second).c_str(ctx_));
+                    },
+                    index_cancel_));
+            index_ready_ = !index_cancel_;
+        });
+    }
+
+    ~ElementXYRoot()
+    {
+        index_cancel_ = true;
+        index_thread_.join();
     }
 
     // getById finds a child for the given IdString.
@@ -335,6 +412,16 @@ template <typename ElementT> class ElementXYRoot : public Item
     // Find children that contain the given text.
     virtual void search(QList<Item *> &results, QString text, int limit) override
     {
+        if (index_ready_) {
+            for (int i : index_->search(text.toStdString(), limit)) {
+                if (limit != -1 && results.size() > limit)
+                    return;
+                auto &fe = flat_.at(i);
+                results.push_back(managed_lists_.at(fe.first)->elementChild(fe.second));
+            }
+            return;
+        }
+        // Until the index is built
         for (auto &l : managed_lists_) {
             if (limit != -1 && results.size() > limit)
                 return;
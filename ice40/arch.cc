@@ -44,6 +44,65 @@ void IdString::initialize_arch(const BaseCtx *ctx)
 
 // -----------------------------------------------------------------------
 
+// Lookup in the name hashes built by chipdb.py, which must hash names identically
+static uint32_t name_crc32(const std::string &s)
+{
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFU;
+    for (char c : s)
+        crc = table[(crc ^ uint8_t(c)) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFU;
+}
+
+static uint32_t name_adler32(const std::string &s)
+{
+    uint32_t a = 1, b = 0;
+    for (char c : s) {
+        a = (a + uint8_t(c)) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+static uint32_t name_hash_mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+// Returns the only index that name could be, which the caller must check, or -1
+static int lookup_name(const NameHashPOD &hash, const std::string &name)
+{
+    uint32_t n = hash.displacements.size();
+    if (n == 0)
+        return -1;
+    uint32_t crc = name_crc32(name);
+    int32_t d = hash.displacements[crc % n];
+    if (d == 0)
+        return -1;
+    uint32_t slot;
+    if (d < 0)
+        slot = uint32_t(-(d + 1));
+    else
+        slot = name_hash_mix(crc ^ name_hash_mix(name_adler32(name) + uint32_t(d) * 0x9e3779b9U)) % n;
+    return hash.values[slot];
+}
+
+// -----------------------------------------------------------------------
+
 static const ChipInfoPOD *get_chip_info(ArchArgs::ArchArgsTypes chip)
 {
     std::string chipdb;
@@ -95,6 +154,12 @@ Arch::Arch(ArchArgs args) : args(args)
     chip_info = get_chip_info(args.type);
     if (chip_info == nullptr)
         log_error("Unsupported iCE40 chip type.\n");
+    // Bels, wires and pips are used throughout; config and package data only for a few lookups
+    chipdb_advise(chip_info->bel_data, ChipdbUse::HOT);
+    chipdb_advise(chip_info->wire_data, ChipdbUse::HOT);
+    chipdb_advise(chip_info->pip_data, ChipdbUse::HOT);
+    chipdb_advise(chip_info->bel_config, ChipdbUse::COLD);
+    chipdb_advise(chip_info->packages_data, ChipdbUse::COLD);
 
     package_info = nullptr;
     std::string package_name = args.package;
@@ -109,12 +174,20 @@ Arch::Arch(ArchArgs args) : args(args)
     }
     if (package_info == nullptr)
         log_error("Unsupported package '%s'.\n", args.package.c_str());
+    bel_package_pin.resize(chip_info->bel_data.size(), -1);
+    for (size_t i = 0; i < package_info->pins.size(); i++) {
+        auto &ppin = package_info->pins[i];
+        package_pin_by_name.emplace(ppin.name.get(), int(i));
+        if (bel_package_pin.at(ppin.bel_index) == -1)
+            bel_package_pin.at(ppin.bel_index) = int(i);
+    }
 
     bel_carry.resize(chip_info->bel_data.size());
     bel_to_cell.resize(chip_info->bel_data.size());
     wire_to_net.resize(chip_info->wire_data.size());
     pip_to_net.resize(chip_info->pip_data.size());
     switches_locked.resize(chip_info->num_switches);
+    lc_tiles.resize(chip_info->width * chip_info->height);
 }
 
 // -----------------------------------------------------------------------
@@ -186,16 +259,10 @@ IdString Arch::archArgsToId(ArchArgs args) const
 BelId Arch::getBelByName(IdString name) const
 {
     BelId ret;
-
-    if (bel_by_name.empty()) {
-        for (size_t i = 0; i < chip_info->bel_data.size(); i++)
-            bel_by_name[id(chip_info->bel_data[i].name.get())] = i;
-    }
-
-    auto it = bel_by_name.find(name);
-    if (it != bel_by_name.end())
-        ret.index = it->second;
-
+    const std::string &str = name.str(this);
+    int index = lookup_name(chip_info->bel_hash, str);
+    if (index != -1 && str == chip_info->bel_data[index].name.get())
+        ret.index = index;
     return ret;
 }
 
@@ -347,16 +414,10 @@ bool Arch::isBelLocked(BelId bel) const
 WireId Arch::getWireByName(IdString name) const
 {
     WireId ret;
-
-    if (wire_by_name.empty()) {
-        for (int i = 0; i < int(chip_info->wire_data.size()); i++)
-            wire_by_name[id(chip_info->wire_data[i].name.get())] = i;
-    }
-
-    auto it = wire_by_name.find(name);
-    if (it != wire_by_name.end())
-        ret.index = it->second;
-
+    const std::string &str = name.str(this);
+    int index = lookup_name(chip_info->wire_hash, str);
+    if (index != -1 && str == chip_info->wire_data[index].name.get())
+        ret.index = index;
     return ret;
 }
 
@@ -417,23 +478,20 @@ std::vector<std::pair<IdString, std::string>> Arch::getWireAttrs(WireId wire) co
 PipId Arch::getPipByName(IdString name) const
 {
     PipId ret;
-
-    if (pip_by_name.empty()) {
-        for (int i = 0; i < int(chip_info->pip_data.size()); i++) {
-            PipId pip;
-            pip.index = i;
-            pip_by_name[getPipName(pip)] = i;
-        }
+    const std::string &str = name.str(this);
+    int index = lookup_name(chip_info->pip_hash, str);
+    if (index != -1) {
+        PipId pip;
+        pip.index = index;
+        if (str == getPipNameStr(pip))
+            ret = pip;
     }
-
-    auto it = pip_by_name.find(name);
-    if (it != pip_by_name.end())
-        ret.index = it->second;
-
     return ret;
 }
 
-IdString Arch::getPipName(PipId pip) const
+IdString Arch::getPipName(PipId pip) const { return id(getPipNameStr(pip)); }
+
+std::string Arch::getPipNameStr(PipId pip) const
 {
     NPNR_ASSERT(pip != PipId());
 
@@ -447,9 +505,9 @@ IdString Arch::getPipName(PipId pip) const
     std::string dst_name = chip_info->wire_data[chip_info->pip_data[pip.index].dst].name.get();
     std::replace(dst_name.begin(), dst_name.end(), '/', '.');
 
-    return id("X" + std::to_string(x) + "/Y" + std::to_string(y) + "/" + src_name + ".->." + dst_name);
+    return "X" + std::to_string(x) + "/Y" + std::to_string(y) + "/" + src_name + ".->." + dst_name;
 #else
-    return id(chip_info->pip_data[pip.index].name.get());
+    return chip_info->pip_data[pip.index].name.get();
 #endif
 }
 
@@ -468,24 +526,20 @@ std::vector<std::pair<IdString, std::string>> Arch::getPipAttrs(PipId pip) const
 
 BelId Arch::getPackagePinBel(const std::string &pin) const
 {
-    for (auto &ppin : package_info->pins) {
-        if (ppin.name.get() == pin) {
-            BelId id;
-            id.index = ppin.bel_index;
-            return id;
-        }
-    }
-    return BelId();
+    auto found = package_pin_by_name.find(pin);
+    if (found == package_pin_by_name.end())
+        return BelId();
+    BelId id;
+    id.index = package_info->pins[found->second].bel_index;
+    return id;
 }
 
 std::string Arch::getBelPackagePin(BelId bel) const
 {
-    for (auto &ppin : package_info->pins) {
-        if (ppin.bel_index == bel.index) {
-            return std::string(ppin.name.get());
-        }
-    }
-    return "";
+    int pin = bel_package_pin.at(bel.index);
+    if (pin == -1)
+        return "";
+    return std::string(package_info->pins[pin].name.get());
 }
 
 // -----------------------------------------------------------------------
@@ -1193,6 +1247,12 @@ void Arch::assignArchInfo()
         CellInfo *ci = cell.second.get();
         assignCellInfo(ci);
     }
+    // The LC summaries of already placed tiles depend on lcInfo and is_global
+    for (auto &cell : getCtx()->cells) {
+        CellInfo *ci = cell.second.get();
+        if (ci->type == id_ICESTORM_LC && ci->bel != BelId())
+            refreshLogicTile(ci->bel);
+    }
 }
 
 void Arch::assignCellInfo(CellInfo *cell)
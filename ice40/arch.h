@@ -202,6 +202,14 @@ NPNR_PACKED_STRUCT(struct GlobalNetworkInfoPOD {
     uint16_t pad;
 });
 
+// Minimal perfect hash from names to indices, built by chipdb.py. A name's CRC-32 selects a displacement: 0 for no
+// names, -(slot + 1) for a single name, or d > 0 to mix with the CRC-32 and Adler-32 of the name into a slot. The
+// value in the slot is the index to check the name against.
+NPNR_PACKED_STRUCT(struct NameHashPOD {
+    RelSlice<int32_t> displacements;
+    RelSlice<int32_t> values;
+});
+
 NPNR_PACKED_STRUCT(struct ChipInfoPOD {
     int32_t width, height;
     uint32_t num_switches;
@@ -215,6 +223,7 @@ NPNR_PACKED_STRUCT(struct ChipInfoPOD {
     RelSlice<CellTimingPOD> cell_timing;
     RelSlice<GlobalNetworkInfoPOD> global_network_info;
     RelSlice<RelPtr<char>> tile_wire_names;
+    NameHashPOD bel_hash, wire_hash, pip_hash;
 });
 
 /************************ End of chipdb section. ************************/
@@ -377,10 +386,10 @@ struct Arch : BaseCtx
     bool fast_part;
     const ChipInfoPOD *chip_info;
     const PackageInfoPOD *package_info;
+    // Index into package_info->pins of each pin by name, and of the pin of each bel or -1
+    std::unordered_map<std::string, int> package_pin_by_name;
+    std::vector<int> bel_package_pin;
 
-    mutable std::unordered_map<IdString, int> bel_by_name;
-    mutable std::unordered_map<IdString, int> wire_by_name;
-    mutable std::unordered_map<IdString, int> pip_by_name;
     mutable std::unordered_map<Loc, int> bel_by_loc;
 
     std::vector<bool> bel_carry;
@@ -389,6 +398,23 @@ struct Arch : BaseCtx
     std::vector<NetInfo *> pip_to_net;
     std::vector<WireId> switches_locked;
 
+    // Running summary of the logic cells bound in each tile, updated by bindBel and unbindBel, so that checking a
+    // logic tile doesn't need to visit all of its LCs
+    struct LogicTileState
+    {
+        int dffs = 0;
+        bool neg_clk = false;
+        // Set if the flipflops of the tile disagree on their control signals or clock polarity
+        bool conflict = false;
+        const NetInfo *cen = nullptr, *clk = nullptr, *sr = nullptr;
+        // Local tracks needed by LUT inputs and non-global control signals
+        int locals = 0;
+
+        void add(const CellInfo *cell);
+        bool valid() const { return !conflict && locals <= 32; }
+    };
+    std::vector<LogicTileState> lc_tiles;
+
     ArchArgs args;
     Arch(ArchArgs args);
 
@@ -427,6 +453,8 @@ struct Arch : BaseCtx
 
         bel_to_cell[bel.index] = cell;
         bel_carry[bel.index] = (cell->type == id_ICESTORM_LC && cell->lcInfo.carryEnable);
+        if (cell->type == id_ICESTORM_LC)
+            lc_tiles[getBelTileIndex(bel)].add(cell);
         cell->bel = bel;
         cell->belStrength = strength;
         refreshUiBel(bel);
@@ -436,10 +464,18 @@ struct Arch : BaseCtx
     {
         NPNR_ASSERT(bel != BelId());
         NPNR_ASSERT(bel_to_cell[bel.index] != nullptr);
-        bel_to_cell[bel.index]->bel = BelId();
-        bel_to_cell[bel.index]->belStrength = STRENGTH_NONE;
+        CellInfo *cell = bel_to_cell[bel.index];
+        cell->bel = BelId();
+        cell->belStrength = STRENGTH_NONE;
         bel_to_cell[bel.index] = nullptr;
         bel_carry[bel.index] = false;
+        if (cell->type == id_ICESTORM_LC) {
+            // Removing a flipflop may resolve a conflict or change the control signals of the tile, so recompute
+            if (cell->lcInfo.dffEnable)
+                refreshLogicTile(bel);
+            else
+                lc_tiles[getBelTileIndex(bel)].locals -= cell->lcInfo.inputCount;
+        }
         refreshUiBel(bel);
     }
 
@@ -482,6 +518,11 @@ struct Arch : BaseCtx
     BelId getBelByLocation(Loc loc) const;
     BelRange getBelsByTile(int x, int y) const;
 
+    int getBelTileIndex(BelId bel) const
+    {
+        return chip_info->bel_data[bel.index].y * chip_info->width + chip_info->bel_data[bel.index].x;
+    }
+
     bool getBelGlobalBuf(BelId bel) const { return chip_info->bel_data[bel.index].type == ID_SB_GB; }
 
     IdString getBelType(BelId bel) const
@@ -520,6 +561,7 @@ struct Arch : BaseCtx
         wire_to_net[wire.index] = net;
         net->wires[wire].pip = PipId();
         net->wires[wire].strength = strength;
+        net->wire_delays.clear();
         refreshUiWire(wire);
     }
 
@@ -539,6 +581,7 @@ struct Arch : BaseCtx
         }
 
         net_wires.erase(it);
+        wire_to_net[wire.index]->wire_delays.clear();
         wire_to_net[wire.index] = nullptr;
         refreshUiWire(wire);
     }
@@ -611,6 +654,7 @@ struct Arch : BaseCtx
         wire_to_net[dst.index] = net;
         net->wires[dst].pip = pip;
         net->wires[dst].strength = strength;
+        net->wire_delays.clear();
         refreshUiPip(pip);
         refreshUiWire(dst);
     }
@@ -626,6 +670,7 @@ struct Arch : BaseCtx
         NPNR_ASSERT(wire_to_net[dst.index] != nullptr);
         wire_to_net[dst.index] = nullptr;
         pip_to_net[pip.index]->wires.erase(dst);
+        pip_to_net[pip.index]->wire_delays.clear();
 
         pip_to_net[pip.index] = nullptr;
         switches_locked[chip_info->pip_data[pip.index].switch_index] = WireId();
@@ -704,6 +749,7 @@ struct Arch : BaseCtx
     }
 
     IdString getPipName(PipId pip) const;
+    std::string getPipNameStr(PipId pip) const;
 
     IdString getPipType(PipId pip) const;
     std::vector<std::pair<IdString, std::string>> getPipAttrs(PipId pip) const;
@@ -770,8 +816,33 @@ struct Arch : BaseCtx
 
     // -------------------------------------------------
 
+    // Route delays measured by the delay fuzzer, by source and sink wire type and distance. When loaded, these
+    // replace the fitted model in estimateDelay (minimum delay seen) and predictDelay (mean delay)
+    struct DelayTable
+    {
+        static const int num_wire_types = WireInfoPOD::WIRE_TYPE_SP12_H + 1;
+        int width = 0, height = 0;
+        // -1 where there were no samples
+        std::vector<delay_t> min_delay, mean_delay;
+
+        bool empty() const { return min_delay.empty(); }
+        int index(int src_type, int dst_type, int dx, int dy) const
+        {
+            return ((src_type * num_wire_types + dst_type) * width + dx) * height + dy;
+        }
+    };
+    DelayTable delay_table;
+    // Load a table written by ice40DelayFuzzerMain
+    void loadDelayTable(const std::string &filename);
+
     delay_t estimateDelay(WireId src, WireId dst) const;
     delay_t predictDelay(const NetInfo *net_info, const PortRef &sink) const;
+    // predictDelay only depends on the cell types and ports of the arc, and the distance between the bels when they
+    // are in different tiles; so PredictDelayCache may memoise it
+    static const bool predictDelayCacheable = true;
+    int getPredictDelayClass(const NetInfo *net_info, const PortRef &sink) const { return 0; }
+    // WireId and PipId are plain indices into the chipdb, so a flattened routing graph can be cached on disk
+    static const bool routeGraphCacheable = true;
     delay_t getDelayEpsilon() const { return 20; }
     delay_t getRipupDelayPenalty() const { return 200; }
     float getDelayNS(delay_t v) const { return v * 0.001; }
@@ -831,8 +902,14 @@ struct Arch : BaseCtx
     // Return true whether all Bels at a given location are valid
     bool isBelLocationValid(BelId bel) const;
 
+    // As isBelLocationValid, but as if each Bel in overlay were bound to the given cell (or unbound, for nullptr)
+    // instead. Only Bels in the same tile as bel are looked up in overlay
+    bool isBelLocationValidWith(BelId bel, const std::unordered_map<BelId, CellInfo *> &overlay) const;
+
     // Helper function for above
     bool logicCellsCompatible(const CellInfo **it, const size_t size) const;
+    // Recompute the entry of lc_tiles for the tile of a Bel from the cells bound there
+    void refreshLogicTile(BelId bel);
 
     // -------------------------------------------------
     // Assign architecture-specific arguments to nets and cells, which must be
@@ -866,6 +943,8 @@ struct Arch : BaseCtx
     static const std::vector<std::string> availableRouters;
 };
 
-void ice40DelayFuzzerMain(Context *ctx);
+// Route random arcs and print the delay of each part of the route against its estimate; or, if table_file is given,
+// write a delay table for loadDelayTable instead
+void ice40DelayFuzzerMain(Context *ctx, const std::string &table_file = "", int threads = 1);
 
 NEXTPNR_NAMESPACE_END
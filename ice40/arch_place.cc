@@ -70,20 +70,77 @@ bool Arch::logicCellsCompatible(const CellInfo **it, const size_t size) const
     return locals_count <= 32;
 }
 
+// Must agree with logicCellsCompatible. The result does not depend on the order cells are added in, as any flipflop
+// with different control signals to the first is a conflict anyway
+void Arch::LogicTileState::add(const CellInfo *cell)
+{
+    if (cell->lcInfo.dffEnable) {
+        if (dffs == 0) {
+            cen = cell->lcInfo.cen;
+            clk = cell->lcInfo.clk;
+            sr = cell->lcInfo.sr;
+
+            if (cen != nullptr && !cen->is_global)
+                locals++;
+            if (clk != nullptr && !clk->is_global)
+                locals++;
+            if (sr != nullptr && !sr->is_global)
+                locals++;
+
+            neg_clk = cell->lcInfo.negClk;
+        } else if (cen != cell->lcInfo.cen || clk != cell->lcInfo.clk || sr != cell->lcInfo.sr ||
+                   neg_clk != cell->lcInfo.negClk) {
+            conflict = true;
+        }
+        dffs++;
+    }
+
+    locals += cell->lcInfo.inputCount;
+}
+
+void Arch::refreshLogicTile(BelId bel)
+{
+    LogicTileState &state = lc_tiles[getBelTileIndex(bel)];
+    state = LogicTileState();
+    Loc bel_loc = getBelLocation(bel);
+    for (auto bel_other : getBelsByTile(bel_loc.x, bel_loc.y)) {
+        CellInfo *ci_other = getBoundBelCell(bel_other);
+        if (ci_other != nullptr && ci_other->type == id_ICESTORM_LC)
+            state.add(ci_other);
+    }
+}
+
 bool Arch::isBelLocationValid(BelId bel) const
 {
+    if (getBelType(bel) == id_ICESTORM_LC) {
+        return lc_tiles[getBelTileIndex(bel)].valid();
+    } else {
+        CellInfo *ci = getBoundBelCell(bel);
+        if (ci == nullptr)
+            return true;
+        else
+            return isValidBelForCell(ci, bel);
+    }
+}
+
+bool Arch::isBelLocationValidWith(BelId bel, const std::unordered_map<BelId, CellInfo *> &overlay) const
+{
+    auto bound_cell = [&](BelId b) {
+        auto found = overlay.find(b);
+        return found != overlay.end() ? found->second : getBoundBelCell(b);
+    };
     if (getBelType(bel) == id_ICESTORM_LC) {
         std::array<const CellInfo *, 8> bel_cells;
         size_t num_cells = 0;
         Loc bel_loc = getBelLocation(bel);
         for (auto bel_other : getBelsByTile(bel_loc.x, bel_loc.y)) {
-            CellInfo *ci_other = getBoundBelCell(bel_other);
+            CellInfo *ci_other = bound_cell(bel_other);
             if (ci_other != nullptr)
                 bel_cells[num_cells++] = ci_other;
         }
         return logicCellsCompatible(bel_cells.data(), num_cells);
     } else {
-        CellInfo *ci = getBoundBelCell(bel);
+        CellInfo *ci = bound_cell(bel);
         if (ci == nullptr)
             return true;
         else
@@ -133,6 +190,13 @@ bool Arch::isValidBelForCell(CellInfo *cell, BelId bel) const
     if (cell->type == id_ICESTORM_LC) {
         NPNR_ASSERT(getBelType(bel) == id_ICESTORM_LC);
 
+        if (getBoundBelCell(bel) == nullptr) {
+            // The common case of trying a cell in a free Bel only needs the cell adding to the tile summary
+            LogicTileState state = lc_tiles[getBelTileIndex(bel)];
+            state.add(cell);
+            return state.valid();
+        }
+
         std::array<const CellInfo *, 8> bel_cells;
         size_t num_cells = 0;
 
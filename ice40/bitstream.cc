@@ -20,6 +20,8 @@
  */
 #include "bitstream.h"
 #include <cctype>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include "cells.h"
 #include "log.h"
@@ -34,12 +36,23 @@ inline TileType tile_at(const Context *ctx, int x, int y)
 
 const ConfigEntryPOD &find_config(const TileInfoPOD &tile, const std::string &name)
 {
-    for (auto &entry : tile.entries) {
-        if (std::string(entry.name.get()) == name) {
-            return entry;
-        }
+    // Every config bit written or read goes through here, so rather than scanning the (up to several thousand) entries
+    // of a tile type each time, index them by name the first time a tile type is used. The chipdb outlives all
+    // contexts, so the index is keyed by the address of the tile info
+    static std::mutex index_mutex;
+    static std::unordered_map<const TileInfoPOD *, std::unordered_map<std::string, const ConfigEntryPOD *>> index;
+
+    std::lock_guard<std::mutex> lock(index_mutex);
+    auto &tile_index = index[&tile];
+    if (tile_index.empty()) {
+        tile_index.reserve(tile.entries.size());
+        for (auto &entry : tile.entries)
+            tile_index.emplace(entry.name.get(), &entry);
     }
-    NPNR_ASSERT_FALSE_STR("unable to find config bit " + name);
+    auto found = tile_index.find(name);
+    if (found == tile_index.end())
+        NPNR_ASSERT_FALSE_STR("unable to find config bit " + name);
+    return *found->second;
 }
 
 std::tuple<int8_t, int8_t, int8_t> get_ieren(const BitstreamInfoPOD &bi, int8_t x, int8_t y, int8_t z)
@@ -882,8 +895,8 @@ void write_asc(const Context *ctx, std::ostream &out)
                     std::vector<bool> bits(256);
                     Property init = get_or_default(cell.second->params, ctx->id(std::string("INIT_") + get_hexdigit(w)),
                                                    Property(0, 256));
-                    for (size_t i = 0; i < init.str.size(); i++) {
-                        bool val = (init.str.at(i) == Property::State::S1);
+                    for (int i = 0; i < int(init.size()); i++) {
+                        bool val = (init.get(i) == Property::State::S1);
                         bits.at(i) = val;
                     }
                     for (int i = bits.size() - 4; i >= 0; i -= 4) {
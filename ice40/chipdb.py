@@ -4,6 +4,7 @@ import sys
 import re
 import textwrap
 import argparse
+import zlib
 
 parser = argparse.ArgumentParser(description="convert ICE40 chip database")
 parser.add_argument("filename", type=str, help="chipdb input filename")
@@ -1471,6 +1472,66 @@ for i in range(len(glbinfo)):
         bba.u16(glbinfo[i][k], k)
     bba.u16(0, "padding")
 
+# Minimal perfect hashes from bel, wire and pip names to their index, so that Arch::get*ByName need not build maps
+# of every name at runtime. Names are hashed with CRC-32 and Adler-32 (see NameHashPOD in arch.h): the CRC picks a
+# bucket, and each bucket has a displacement d > 0 mixed with both hashes to pick the slot of each of its names, or
+# -(slot + 1) for a bucket with a single name. Buckets are placed largest first, so most need few attempts.
+def hash_mix(h):
+    h ^= h >> 16
+    h = (h * 0x85ebca6b) & 0xffffffff
+    h ^= h >> 13
+    h = (h * 0xc2b2ae35) & 0xffffffff
+    h ^= h >> 16
+    return h
+
+def hash_slot(crc, adler, d, n):
+    return hash_mix(crc ^ hash_mix((adler + d * 0x9e3779b9) & 0xffffffff)) % n
+
+def write_name_hash(label, names):
+    n = len(names)
+    keys = [(zlib.crc32(name.encode()), zlib.adler32(name.encode())) for name in names]
+    buckets = [[] for i in range(n)]
+    for i, key in enumerate(keys):
+        buckets[key[0] % n].append(i)
+    disp = [0] * n
+    values = [-1] * n
+    order = sorted(range(n), key=lambda b: -len(buckets[b]))
+    for b in order:
+        items = buckets[b]
+        if len(items) <= 1:
+            break
+        d = 1
+        while True:
+            slots = [hash_slot(keys[i][0], keys[i][1], d, n) for i in items]
+            if len(set(slots)) == len(slots) and all(values[s] == -1 for s in slots):
+                break
+            d += 1
+            assert d < 1000000, "failed to build name hash (duplicate name?)"
+        disp[b] = d
+        for i, s in zip(items, slots):
+            values[s] = i
+    free = [s for s in range(n) if values[s] == -1]
+    for b in order:
+        if len(buckets[b]) == 1:
+            s = free.pop()
+            disp[b] = -(s + 1)
+            values[s] = buckets[b][0]
+    bba.l("%s_disp_%s" % (label, dev_name), "int32_t")
+    for v in disp:
+        bba.u32(v, None)
+    bba.l("%s_values_%s" % (label, dev_name), "int32_t")
+    for v in values:
+        bba.u32(v, None)
+
+def pip_name(info):
+    src = wireinfo[info["src"]]["name"].replace("/", ".")
+    dst = wireinfo[info["dst"]]["name"].replace("/", ".")
+    return "X%d/Y%d/%s.->.%s" % (info["x"], info["y"], src, dst)
+
+write_name_hash("bel_hash", bel_name)
+write_name_hash("wire_hash", [info["name"] for info in wireinfo])
+write_name_hash("pip_hash", [pip_name(info) for info in pipinfo])
+
 bba.l("chip_info_%s" % dev_name)
 bba.u32(dev_width, "dev_width")
 bba.u32(dev_height, "dev_height")
@@ -1485,5 +1546,8 @@ bba.r_slice("package_info_%s" % dev_name, len(packageinfo), "packages_data")
 bba.r_slice("cell_timings_%s" % dev_name, len(cell_timings), "cell_timing")
 bba.r_slice("global_network_info_%s" % dev_name, len(glbinfo), "global_network_info")
 bba.r_slice("tile_wire_names", len(gfx_wire_names), "tile_wire_names")
+for label, count in [("bel_hash", len(bel_name)), ("wire_hash", num_wires), ("pip_hash", len(pipinfo))]:
+    bba.r_slice("%s_disp_%s" % (label, dev_name), count, "%s.displacements" % label)
+    bba.r_slice("%s_values_%s" % (label, dev_name), count, "%s.values" % label)
 
 bba.pop()
@@ -18,17 +18,42 @@
  *
  */
 
+#include <fstream>
+#include <numeric>
+#include "log.h"
 #include "nextpnr.h"
 #include "router1.h"
+#include "worker_pool.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
 #define NUM_FUZZ_ROUTES 100000
+#define SINKS_PER_SEARCH 16
 
-void ice40DelayFuzzerMain(Context *ctx)
+void ice40DelayFuzzerMain(Context *ctx, const std::string &table_file, int threads)
 {
+#ifndef NPNR_DISABLE_THREADS
+    std::unique_ptr<WorkerPool> pool;
+    if (threads > 1)
+        pool.reset(new WorkerPool(threads));
+#endif
     std::vector<WireId> srcWires, dstWires;
 
+    // Samples for the delay table: count, sum and minimum of the delays seen for each entry
+    Arch::DelayTable table;
+    std::vector<int> sample_count;
+    std::vector<int64_t> sample_sum;
+    bool make_table = !table_file.empty();
+    if (make_table) {
+        table.width = ctx->chip_info->width;
+        table.height = ctx->chip_info->height;
+        int size = Arch::DelayTable::num_wire_types * Arch::DelayTable::num_wire_types * table.width * table.height;
+        table.min_delay.resize(size, -1);
+        table.mean_delay.resize(size, -1);
+        sample_count.resize(size);
+        sample_sum.resize(size);
+    }
+
     for (int i = 0; i < int(ctx->chip_info->wire_data.size()); i++) {
         WireId wire;
         wire.index = i;
@@ -50,52 +75,157 @@ void ice40DelayFuzzerMain(Context *ctx)
     ctx->shuffle(srcWires);
     ctx->shuffle(dstWires);
 
-    int index = 0;
+    // Each search finds the routes from one source to several sinks at once. Searches are run in batches across
+    // threads, and their results are then recorded in sample order, so the output doesn't depend on the thread count.
+    struct Sample
+    {
+        WireId cursor, dst;
+        delay_t delay;
+    };
+    struct Search
+    {
+        WireId src;
+        std::vector<WireId> dsts;
+        std::vector<Sample> samples;
+        int arcs;
+    };
+
+    int src_index = 0, dst_index = 0;
     int cnt = 0;
+    std::vector<Search> batch;
 
     while (cnt < NUM_FUZZ_ROUTES) {
-        if (index >= int(srcWires.size()) || index >= int(dstWires.size())) {
-            index = 0;
-            ctx->shuffle(srcWires);
-            ctx->shuffle(dstWires);
+        batch.clear();
+        for (int i = 0; i < 4 * threads && cnt + int(batch.size()) * SINKS_PER_SEARCH < NUM_FUZZ_ROUTES; i++) {
+            if (src_index >= int(srcWires.size())) {
+                src_index = 0;
+                ctx->shuffle(srcWires);
+            }
+            Search search;
+            search.src = srcWires[src_index++];
+            for (int j = 0; j < SINKS_PER_SEARCH; j++) {
+                if (dst_index >= int(dstWires.size())) {
+                    dst_index = 0;
+                    ctx->shuffle(dstWires);
+                }
+                search.dsts.push_back(dstWires[dst_index++]);
+            }
+            batch.push_back(std::move(search));
         }
 
-        WireId src = srcWires[index];
-        WireId dst = dstWires[index++];
-        std::unordered_map<WireId, PipId> route;
-
-#if NUM_FUZZ_ROUTES <= 1000
-        if (!ctx->getActualRouteDelay(src, dst, nullptr, &route, false))
-            continue;
-#else
-        if (!ctx->getActualRouteDelay(src, dst, nullptr, &route, true))
-            continue;
+        auto run_search = [&](int i) {
+            Search &search = batch.at(i);
+            std::vector<delay_t> delays;
+            std::unordered_map<WireId, PipId> route;
+            search.arcs = ctx->getActualRouteDelays(search.src, search.dsts, &delays, &route);
+            for (size_t j = 0; j < search.dsts.size(); j++) {
+                if (delays.at(j) < 0)
+                    continue;
+                WireId dst = search.dsts.at(j);
+                WireId cursor = dst;
+                delay_t delay = 0;
+                while (1) {
+                    delay += ctx->getWireDelay(cursor).maxDelay();
+                    search.samples.push_back(Sample{cursor, dst, delay});
+                    if (cursor == search.src)
+                        break;
+                    PipId pip = route.at(cursor);
+                    delay += ctx->getPipDelay(pip).maxDelay();
+                    cursor = ctx->getPipSrcWire(pip);
+                }
+            }
+        };
+#ifndef NPNR_DISABLE_THREADS
+        if (pool) {
+            std::vector<int> tasks(batch.size());
+            std::iota(tasks.begin(), tasks.end(), 0);
+            pool->run(tasks, run_search);
+        } else
 #endif
+        {
+            for (int i = 0; i < int(batch.size()); i++)
+                run_search(i);
+        }
 
-        WireId cursor = dst;
-        delay_t delay = 0;
-
-        while (1) {
-            delay += ctx->getWireDelay(cursor).maxDelay();
-
-            printf("%s %d %d %s %s %d %d\n", cursor == dst ? "dst" : "src",
-                   int(ctx->chip_info->wire_data[cursor.index].x), int(ctx->chip_info->wire_data[cursor.index].y),
-                   ctx->getWireType(cursor).c_str(ctx), ctx->getWireName(cursor).c_str(ctx), int(delay),
-                   int(ctx->estimateDelay(cursor, dst)));
-
-            if (cursor == src)
-                break;
-
-            PipId pip = route.at(cursor);
-            delay += ctx->getPipDelay(pip).maxDelay();
-            cursor = ctx->getPipSrcWire(pip);
+        for (auto &search : batch) {
+            for (auto &sample : search.samples) {
+                WireId cursor = sample.cursor, dst = sample.dst;
+                if (make_table) {
+                    const WireInfoPOD &wi = ctx->chip_info->wire_data[cursor.index];
+                    const WireInfoPOD &dst_wi = ctx->chip_info->wire_data[dst.index];
+                    int idx = table.index(wi.type, dst_wi.type, abs(dst_wi.x - wi.x), abs(dst_wi.y - wi.y));
+                    sample_count.at(idx)++;
+                    sample_sum.at(idx) += sample.delay;
+                    if (table.min_delay.at(idx) == -1 || sample.delay < table.min_delay.at(idx))
+                        table.min_delay.at(idx) = sample.delay;
+                } else {
+                    printf("%s %d %d %s %s %d %d\n", cursor == dst ? "dst" : "src",
+                           int(ctx->chip_info->wire_data[cursor.index].x),
+                           int(ctx->chip_info->wire_data[cursor.index].y), ctx->getWireType(cursor).c_str(ctx),
+                           ctx->getWireName(cursor).c_str(ctx), int(sample.delay),
+                           int(ctx->estimateDelay(cursor, dst)));
+                }
+            }
+            // Count every search towards the total, even if its sinks were unreachable, so that fuzzing always ends
+            cnt += std::max(search.arcs, 1);
         }
+        fprintf(stderr, "Fuzzed %d arcs.\n", cnt);
+    }
 
-        cnt++;
+    if (make_table) {
+        std::ofstream out(table_file);
+        if (!out)
+            log_error("Failed to open delay table '%s' for writing.\n", table_file.c_str());
+        out << "ice40-delay-table 1 " << ctx->getChipName() << " " << table.width << " " << table.height << std::endl;
+        int entries = 0;
+        for (int src_type = 0; src_type < Arch::DelayTable::num_wire_types; src_type++)
+            for (int dst_type = 0; dst_type < Arch::DelayTable::num_wire_types; dst_type++)
+                for (int dx = 0; dx < table.width; dx++)
+                    for (int dy = 0; dy < table.height; dy++) {
+                        int idx = table.index(src_type, dst_type, dx, dy);
+                        if (sample_count.at(idx) == 0)
+                            continue;
+                        out << src_type << " " << dst_type << " " << dx << " " << dy << " " << table.min_delay.at(idx)
+                            << " " << (sample_sum.at(idx) / sample_count.at(idx)) << std::endl;
+                        entries++;
+                    }
+        log_info("Wrote %d delay table entries to '%s'.\n", entries, table_file.c_str());
+    }
+}
 
-        if (cnt % 100 == 0)
-            fprintf(stderr, "Fuzzed %d arcs.\n", cnt);
+void Arch::loadDelayTable(const std::string &filename)
+{
+    std::ifstream in(filename);
+    if (!in)
+        log_error("Failed to open delay table '%s'.\n", filename.c_str());
+    std::string magic, chip;
+    int version = 0;
+    DelayTable table;
+    in >> magic >> version >> chip >> table.width >> table.height;
+    if (!in || magic != "ice40-delay-table" || version != 1)
+        log_error("'%s' is not a delay table.\n", filename.c_str());
+    if (chip != getChipName() || table.width != chip_info->width || table.height != chip_info->height)
+        log_error("Delay table '%s' is for %s, not %s.\n", filename.c_str(), chip.c_str(), getChipName().c_str());
+
+    int size = DelayTable::num_wire_types * DelayTable::num_wire_types * table.width * table.height;
+    table.min_delay.resize(size, -1);
+    table.mean_delay.resize(size, -1);
+    int src_type, dst_type, dx, dy;
+    delay_t min_delay, mean_delay;
+    int entries = 0;
+    while (in >> src_type >> dst_type >> dx >> dy >> min_delay >> mean_delay) {
+        if (src_type < 0 || src_type >= DelayTable::num_wire_types || dst_type < 0 ||
+            dst_type >= DelayTable::num_wire_types || dx < 0 || dx >= table.width || dy < 0 || dy >= table.height)
+            log_error("Invalid entry in delay table '%s'.\n", filename.c_str());
+        int idx = table.index(src_type, dst_type, dx, dy);
+        table.min_delay.at(idx) = min_delay;
+        table.mean_delay.at(idx) = mean_delay;
+        entries++;
     }
+    if (!in.eof())
+        log_error("Invalid entry in delay table '%s'.\n", filename.c_str());
+    log_info("Loaded %d delay table entries from '%s'.\n", entries, filename.c_str());
+    delay_table = std::move(table);
 }
 
 namespace {
@@ -165,6 +295,12 @@ delay_t Arch::estimateDelay(WireId src, WireId dst) const
     int dx = abs(x2 - x1);
     int dy = abs(y2 - y1);
 
+    if (!delay_table.empty()) {
+        delay_t measured = delay_table.min_delay[delay_table.index(type, chip_info->wire_data[dst.index].type, dx, dy)];
+        if (measured >= 0)
+            return measured;
+    }
+
     const model_params_t &p = model_params_t::get(args);
     delay_t v = p.neighbourhood;
 
@@ -203,6 +339,15 @@ delay_t Arch::predictDelay(const NetInfo *net_info, const PortRef &sink) const
     int dx = abs(sink_loc.x - driver_loc.x);
     int dy = abs(sink_loc.y - driver_loc.y);
 
+    if (!delay_table.empty()) {
+        // The typical arc from a logic cell output to a LUT input, as the delay of a cached prediction may only
+        // depend on the distance
+        delay_t measured = delay_table.mean_delay[delay_table.index(WireInfoPOD::WIRE_TYPE_LUTFF_OUT,
+                                                                    WireInfoPOD::WIRE_TYPE_LUTFF_IN_LUT, dx, dy)];
+        if (measured >= 0)
+            return measured;
+    }
+
     const model_params_t &p = model_params_t::get(args);
 
     if (dx <= 1 && dy <= 1)
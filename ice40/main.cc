@@ -22,6 +22,7 @@
 
 #include <fstream>
 #include "bitstream.h"
+#include "cells.h"
 #include "command.h"
 #include "design_utils.h"
 #include "log.h"
@@ -36,9 +37,15 @@ class Ice40CommandHandler : public CommandHandler
     Ice40CommandHandler(int argc, char **argv);
     virtual ~Ice40CommandHandler(){};
     std::unique_ptr<Context> createContext(std::unordered_map<std::string, Property> &values) override;
+    std::vector<std::string> getContextOptions() override
+    {
+        return {"lp384", "lp1k", "lp4k", "lp8k", "hx1k", "hx4k", "hx8k",
+                "up3k",  "up5k", "u1k",  "u2k",  "u4k",  "package"};
+    }
     void setupArchContext(Context *ctx) override;
     void validate() override;
     void customAfterLoad(Context *ctx) override;
+    bool preflightConfig(Context *ctx, PreflightCfg &cfg) override;
     void customBitstream(Context *ctx) override;
 
   protected:
@@ -83,6 +90,10 @@ po::options_description Ice40CommandHandler::getArchOptions()
     specific.add_options()("no-promote-globals", "disable all global promotion");
     specific.add_options()("opt-timing", "run post-placement timing optimisation pass (experimental)");
     specific.add_options()("tmfuzz", "run path delay estimate fuzzer");
+    specific.add_options()("tmfuzz-threads", po::value<int>(),
+                           "number of threads to run the delay fuzzer with (default: all cores)");
+    specific.add_options()("delay-table", po::value<std::string>(),
+                           "use route delays measured by the fuzzer for delay estimates; with --tmfuzz, write them");
     specific.add_options()("pcf-allow-unconstrained", "don't require PCF to constrain all IO");
 
     return specific;
@@ -107,6 +118,32 @@ void Ice40CommandHandler::customAfterLoad(Context *ctx)
         log_warning("No PCF file specified; IO pins will be placed automatically\n");
     }
 }
+
+bool Ice40CommandHandler::preflightConfig(Context *ctx, PreflightCfg &cfg)
+{
+    // Each logic cell holds a LUT, a DFF and a carry
+    PreflightCfg::Resource lc("logic cells", {id_ICESTORM_LC});
+    lc.groups.push_back([](const Context *ctx, const CellInfo *ci) { return is_lut(ctx, ci) ? 1 : 0; });
+    lc.groups.push_back([](const Context *ctx, const CellInfo *ci) { return is_ff(ctx, ci) ? 1 : 0; });
+    lc.groups.push_back([](const Context *ctx, const CellInfo *ci) { return is_carry(ctx, ci) ? 1 : 0; });
+    cfg.resources.push_back(lc);
+    PreflightCfg::Resource ram("block RAMs", {id_ICESTORM_RAM});
+    ram.groups.push_back([](const Context *ctx, const CellInfo *ci) { return is_ram(ctx, ci) ? 1 : 0; });
+    cfg.resources.push_back(ram);
+    PreflightCfg::Resource io("IOs", {id_SB_IO});
+    io.groups.push_back(
+            [](const Context *ctx, const CellInfo *ci) { return (is_sb_io(ctx, ci) || is_sb_gb_io(ctx, ci)) ? 1 : 0; });
+    io.top_ports = true;
+    cfg.resources.push_back(io);
+    for (auto type : {"SB_IO", "SB_GB_IO", "SB_IO_OD", "SB_IO_I3C", "SB_RGBA_DRV", "SB_RGB_DRV", "SB_LED_DRV_CUR",
+                      "SB_PLL40_PAD", "SB_PLL40_2_PAD", "SB_PLL40_2F_PAD"})
+        cfg.pad_cell_types.push_back(ctx->id(type));
+    cfg.check_bel_names = true;
+    cfg.global_bel_types.push_back(id_SB_GB);
+    cfg.clock_ports.push_back(ctx->id("C"));
+    return true;
+}
+
 void Ice40CommandHandler::customBitstream(Context *ctx)
 {
     if (vm.count("asc")) {
@@ -118,8 +155,14 @@ void Ice40CommandHandler::customBitstream(Context *ctx)
 
 void Ice40CommandHandler::setupArchContext(Context *ctx)
 {
-    if (vm.count("tmfuzz"))
-        ice40DelayFuzzerMain(ctx);
+    if (vm.count("tmfuzz")) {
+        int threads = vm.count("tmfuzz-threads") ? vm["tmfuzz-threads"].as<int>() : ctx->stage_threads("", 0);
+        if (threads < 1)
+            log_error("Number of delay fuzzer threads must be at least 1\n");
+        ice40DelayFuzzerMain(ctx, vm.count("delay-table") ? vm["delay-table"].as<std::string>() : "", threads);
+    } else if (vm.count("delay-table")) {
+        ctx->loadDelayTable(vm["delay-table"].as<std::string>());
+    }
 
     if (vm.count("read")) {
         std::string filename = vm["read"].as<std::string>();
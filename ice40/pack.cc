@@ -20,109 +20,110 @@
  */
 
 #include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iterator>
+#include <set>
 #include <unordered_set>
 #include "cells.h"
 #include "chains.h"
 #include "design_utils.h"
 #include "log.h"
+#include "pack_engine.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
-// Pack LUTs and LUT-FF pairs
-static void pack_lut_lutffs(Context *ctx)
+// Pack LUTs and LUT-FF pairs, then the remaining FFs on their own
+static void pack_lut_lutffs(Context *ctx, int threads)
 {
     log_info("Packing LUT-FFs..\n");
-    int lut_only = 0, lut_and_ff = 0;
+    int lut_only = 0, lut_and_ff = 0, ff_only = 0;
     std::unordered_set<IdString> packed_cells;
     std::vector<std::unique_ptr<CellInfo>> new_cells;
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
+
+    // Find the DFF, if any, that each LUT can be packed with: one whose D input is the only load of the LUT output
+    // TODO: LUT cascade
+    PackEngine engine(ctx, threads);
+    std::vector<CellInfo *> ffs = engine.cells_matching([ctx](const CellInfo *ci) { return is_ff(ctx, ci); });
+    const IdString bel_attr = ctx->id("BEL");
+    PackEngine::PairRule lut_ff;
+    lut_ff.driver_pred = [ctx](const CellInfo *ci) { return is_lut(ctx, ci); };
+    lut_ff.driver_port = id_O;
+    std::unordered_set<const CellInfo *> ff_set(ffs.begin(), ffs.end());
+    lut_ff.user_pred = [&ff_set](const CellInfo *ci) { return ff_set.count(ci) != 0; };
+    lut_ff.user_port = ctx->id("D");
+    lut_ff.compatible = [bel_attr](const CellInfo *lut, const CellInfo *dff) {
+        // Locations must match, if both are constrained
+        auto lut_bel = lut->attrs.find(bel_attr);
+        auto dff_bel = dff->attrs.find(bel_attr);
+        return lut_bel == lut->attrs.end() || dff_bel == dff->attrs.end() || lut_bel->second == dff_bel->second;
+    };
+    auto pairs = engine.match_pairs(lut_ff);
+    std::vector<CellInfo *> luts, lut_dff;
+    for (auto &pair : pairs) {
+        luts.push_back(pair.first);
+        lut_dff.push_back(pair.second);
+    }
+
+    for (size_t i = 0; i < luts.size(); i++) {
+        CellInfo *ci = luts.at(i);
+        std::unique_ptr<CellInfo> packed = create_ice_cell(ctx, ctx->id("ICESTORM_LC"), ci->name.str(ctx) + "_LC");
+        std::copy(ci->attrs.begin(), ci->attrs.end(), std::inserter(packed->attrs, packed->attrs.begin()));
+        packed_cells.insert(ci->name);
         if (ctx->verbose)
-            log_info("cell '%s' is of type '%s'\n", ci->name.c_str(ctx), ci->type.c_str(ctx));
-        if (is_lut(ctx, ci)) {
-            std::unique_ptr<CellInfo> packed = create_ice_cell(ctx, ctx->id("ICESTORM_LC"), ci->name.str(ctx) + "_LC");
-            std::copy(ci->attrs.begin(), ci->attrs.end(), std::inserter(packed->attrs, packed->attrs.begin()));
-            packed_cells.insert(ci->name);
+            log_info("packed cell %s into %s\n", ci->name.c_str(ctx), packed->name.c_str(ctx));
+        CellInfo *dff = lut_dff.at(i);
+        if (dff) {
             if (ctx->verbose)
-                log_info("packed cell %s into %s\n", ci->name.c_str(ctx), packed->name.c_str(ctx));
-            // See if we can pack into a DFF
-            // TODO: LUT cascade
-            NetInfo *o = ci->ports.at(ctx->id("O")).net;
-            CellInfo *dff = net_only_drives(ctx, o, is_ff, ctx->id("D"), true);
-            auto lut_bel = ci->attrs.find(ctx->id("BEL"));
-            bool packed_dff = false;
-            if (dff) {
-                if (ctx->verbose)
-                    log_info("found attached dff %s\n", dff->name.c_str(ctx));
-                auto dff_bel = dff->attrs.find(ctx->id("BEL"));
-                if (lut_bel != ci->attrs.end() && dff_bel != dff->attrs.end() && lut_bel->second != dff_bel->second) {
-                    // Locations don't match, can't pack
-                } else {
-                    lut_to_lc(ctx, ci, packed.get(), false);
-                    dff_to_lc(ctx, dff, packed.get(), false);
-                    ++lut_and_ff;
-                    ctx->nets.erase(o->name);
-                    if (dff_bel != dff->attrs.end())
-                        packed->attrs[ctx->id("BEL")] = dff_bel->second;
-                    for (const auto &attr : dff->attrs) {
-                        // BEL is dealt with specially
-                        if (attr.first != ctx->id("BEL"))
-                            packed->attrs[attr.first] = attr.second;
-                    }
-                    packed_cells.insert(dff->name);
-                    if (ctx->verbose)
-                        log_info("packed cell %s into %s\n", dff->name.c_str(ctx), packed->name.c_str(ctx));
-                    packed_dff = true;
-                }
+                log_info("found attached dff %s\n", dff->name.c_str(ctx));
+            NetInfo *o = ci->ports.at(id_O).net;
+            auto dff_bel = dff->attrs.find(bel_attr);
+            lut_to_lc(ctx, ci, packed.get(), false);
+            dff_to_lc(ctx, dff, packed.get(), false);
+            ++lut_and_ff;
+            ctx->nets.erase(o->name);
+            if (dff_bel != dff->attrs.end())
+                packed->attrs[bel_attr] = dff_bel->second;
+            for (const auto &attr : dff->attrs) {
+                // BEL is dealt with specially
+                if (attr.first != bel_attr)
+                    packed->attrs[attr.first] = attr.second;
             }
-            if (!packed_dff) {
-                lut_to_lc(ctx, ci, packed.get(), true);
-                ++lut_only;
-            }
-            new_cells.push_back(std::move(packed));
+            packed_cells.insert(dff->name);
+            if (ctx->verbose)
+                log_info("packed cell %s into %s\n", dff->name.c_str(ctx), packed->name.c_str(ctx));
+        } else {
+            lut_to_lc(ctx, ci, packed.get(), true);
+            ++lut_only;
         }
+        new_cells.push_back(std::move(packed));
     }
-    for (auto pcell : packed_cells) {
-        ctx->cells.erase(pcell);
-    }
-    for (auto &ncell : new_cells) {
-        ctx->cells[ncell->name] = std::move(ncell);
-    }
-    log_info("    %4d LCs used as LUT4 only\n", lut_only);
-    log_info("    %4d LCs used as LUT4 and DFF\n", lut_and_ff);
-}
-
-// Pack FFs not packed as LUTFFs
-static void pack_nonlut_ffs(Context *ctx)
-{
-    log_info("Packing non-LUT FFs..\n");
+    size_t num_lut_cells = new_cells.size();
 
-    std::unordered_set<IdString> packed_cells;
-    std::vector<std::unique_ptr<CellInfo>> new_cells;
-    int ff_only = 0;
-
-    for (auto cell : sorted(ctx->cells)) {
-        CellInfo *ci = cell.second;
-        if (is_ff(ctx, ci)) {
-            std::unique_ptr<CellInfo> packed =
-                    create_ice_cell(ctx, ctx->id("ICESTORM_LC"), ci->name.str(ctx) + "_DFFLC");
-            std::copy(ci->attrs.begin(), ci->attrs.end(), std::inserter(packed->attrs, packed->attrs.begin()));
-            if (ctx->verbose)
-                log_info("packed cell %s into %s\n", ci->name.c_str(ctx), packed->name.c_str(ctx));
-            packed_cells.insert(ci->name);
-            dff_to_lc(ctx, ci, packed.get(), true);
-            new_cells.push_back(std::move(packed));
-            ++ff_only;
-        }
+    // FFs not packed with a LUT
+    for (auto ci : ffs) {
+        if (packed_cells.count(ci->name))
+            continue;
+        std::unique_ptr<CellInfo> packed = create_ice_cell(ctx, ctx->id("ICESTORM_LC"), ci->name.str(ctx) + "_DFFLC");
+        std::copy(ci->attrs.begin(), ci->attrs.end(), std::inserter(packed->attrs, packed->attrs.begin()));
+        if (ctx->verbose)
+            log_info("packed cell %s into %s\n", ci->name.c_str(ctx), packed->name.c_str(ctx));
+        packed_cells.insert(ci->name);
+        dff_to_lc(ctx, ci, packed.get(), true);
+        new_cells.push_back(std::move(packed));
+        ++ff_only;
     }
+
     for (auto pcell : packed_cells) {
         ctx->cells.erase(pcell);
     }
     for (auto &ncell : new_cells) {
         ctx->cells[ncell->name] = std::move(ncell);
     }
+    NPNR_ASSERT(num_lut_cells == luts.size());
+    log_info("    %4d LCs used as LUT4 only\n", lut_only);
+    log_info("    %4d LCs used as LUT4 and DFF\n", lut_and_ff);
     log_info("    %4d LCs used as DFF only\n", ff_only);
 }
 
@@ -645,6 +646,39 @@ static void insert_global(Context *ctx, NetInfo *net, bool is_reset, bool is_cen
     ctx->cells[gb->name] = std::move(gb);
 }
 
+// Nets ordered by their number of users of one kind (e.g. clock ports), for picking the next net to promote. Ties
+// go to the lowest IdString, as with std::max_element over a std::map
+struct FanoutIndex
+{
+    std::unordered_map<IdString, int> count;
+    std::set<std::pair<int, IdString>> order;
+
+    void add(IdString net, int fanout)
+    {
+        if (fanout == 0)
+            return;
+        count[net] = fanout;
+        order.emplace(-fanout, net);
+    }
+
+    void erase(IdString net)
+    {
+        auto found = count.find(net);
+        if (found == count.end())
+            return;
+        order.erase(std::make_pair(-found->second, net));
+        count.erase(found);
+    }
+
+    // The net with the largest fanout, or a fanout of 0 if there are none
+    std::pair<IdString, int> top() const
+    {
+        if (order.empty())
+            return std::make_pair(IdString(), 0);
+        return std::make_pair(order.begin()->second, -order.begin()->first);
+    }
+};
+
 // Simple global promoter (clock only)
 static void promote_globals(Context *ctx)
 {
@@ -652,26 +686,34 @@ static void promote_globals(Context *ctx)
     const int logic_fanout_thresh = 15;
     const int enable_fanout_thresh = 15;
     const int reset_fanout_thresh = 15;
-    std::map<IdString, int> clock_count, reset_count, cen_count, logic_count;
-    for (auto net : sorted(ctx->nets)) {
-        NetInfo *ni = net.second;
+    // Classify the users of every net once; promoting a net then just removes it from the indices
+    FanoutIndex clock_count, reset_count, cen_count, logic_count;
+    for (auto &net : ctx->nets) {
+        NetInfo *ni = net.second.get();
         if (ni->driver.cell != nullptr && !ctx->isGlobalNet(ni)) {
-            clock_count[net.first] = 0;
-            reset_count[net.first] = 0;
-            cen_count[net.first] = 0;
-
+            int clocks = 0, resets = 0, cens = 0, logics = 0;
             for (auto user : ni->users) {
                 if (is_clock_port(ctx, user))
-                    clock_count[net.first]++;
+                    clocks++;
                 if (is_reset_port(ctx, user))
-                    reset_count[net.first]++;
+                    resets++;
                 if (is_enable_port(ctx, user))
-                    cen_count[net.first]++;
+                    cens++;
                 if (is_logic_port(ctx, user))
-                    logic_count[net.first]++;
+                    logics++;
             }
+            clock_count.add(net.first, clocks);
+            reset_count.add(net.first, resets);
+            cen_count.add(net.first, cens);
+            logic_count.add(net.first, logics);
         }
     }
+    auto promoted = [&](NetInfo *ni) {
+        clock_count.erase(ni->name);
+        reset_count.erase(ni->name);
+        cen_count.erase(ni->name);
+        logic_count.erase(ni->name);
+    };
     int prom_globals = 0, prom_resets = 0, prom_cens = 0, prom_logics = 0;
     int gbs_available = 8, resets_available = 4, cens_available = 4;
     for (auto &cell : ctx->cells)
@@ -704,63 +746,38 @@ static void promote_globals(Context *ctx)
             }
         }
     while (prom_globals < gbs_available) {
-        auto global_clock = std::max_element(clock_count.begin(), clock_count.end(),
-                                             [](const std::pair<IdString, int> &a, const std::pair<IdString, int> &b) {
-                                                 return a.second < b.second;
-                                             });
-
-        auto global_reset = std::max_element(reset_count.begin(), reset_count.end(),
-                                             [](const std::pair<IdString, int> &a, const std::pair<IdString, int> &b) {
-                                                 return a.second < b.second;
-                                             });
-        auto global_cen = std::max_element(cen_count.begin(), cen_count.end(),
-                                           [](const std::pair<IdString, int> &a, const std::pair<IdString, int> &b) {
-                                               return a.second < b.second;
-                                           });
-        auto global_logic = std::max_element(logic_count.begin(), logic_count.end(),
-                                             [](const std::pair<IdString, int> &a, const std::pair<IdString, int> &b) {
-                                                 return a.second < b.second;
-                                             });
-        if (global_clock->second == 0 && prom_logics < 4 && global_logic->second > logic_fanout_thresh &&
-            (global_logic->second > global_cen->second || prom_cens >= cens_available) &&
-            (global_logic->second > global_reset->second || prom_resets >= resets_available) &&
+        auto global_clock = clock_count.top();
+        auto global_reset = reset_count.top();
+        auto global_cen = cen_count.top();
+        auto global_logic = logic_count.top();
+        if (global_clock.second == 0 && prom_logics < 4 && global_logic.second > logic_fanout_thresh &&
+            (global_logic.second > global_cen.second || prom_cens >= cens_available) &&
+            (global_logic.second > global_reset.second || prom_resets >= resets_available) &&
             bool_or_default(ctx->settings, ctx->id("promote_logic"), false)) {
-            NetInfo *logicnet = ctx->nets[global_logic->first].get();
-            insert_global(ctx, logicnet, false, false, true, global_logic->second);
+            NetInfo *logicnet = ctx->nets[global_logic.first].get();
+            insert_global(ctx, logicnet, false, false, true, global_logic.second);
             ++prom_globals;
             ++prom_logics;
-            clock_count.erase(logicnet->name);
-            reset_count.erase(logicnet->name);
-            cen_count.erase(logicnet->name);
-            logic_count.erase(logicnet->name);
-        } else if (global_reset->second > global_clock->second && prom_resets < resets_available &&
-                   global_reset->second > reset_fanout_thresh) {
-            NetInfo *rstnet = ctx->nets[global_reset->first].get();
-            insert_global(ctx, rstnet, true, false, false, global_reset->second);
+            promoted(logicnet);
+        } else if (global_reset.second > global_clock.second && prom_resets < resets_available &&
+                   global_reset.second > reset_fanout_thresh) {
+            NetInfo *rstnet = ctx->nets[global_reset.first].get();
+            insert_global(ctx, rstnet, true, false, false, global_reset.second);
             ++prom_globals;
             ++prom_resets;
-            clock_count.erase(rstnet->name);
-            reset_count.erase(rstnet->name);
-            cen_count.erase(rstnet->name);
-            logic_count.erase(rstnet->name);
-        } else if (global_cen->second > global_clock->second && prom_cens < cens_available &&
-                   global_cen->second > enable_fanout_thresh) {
-            NetInfo *cennet = ctx->nets[global_cen->first].get();
-            insert_global(ctx, cennet, false, true, false, global_cen->second);
+            promoted(rstnet);
+        } else if (global_cen.second > global_clock.second && prom_cens < cens_available &&
+                   global_cen.second > enable_fanout_thresh) {
+            NetInfo *cennet = ctx->nets[global_cen.first].get();
+            insert_global(ctx, cennet, false, true, false, global_cen.second);
             ++prom_globals;
             ++prom_cens;
-            clock_count.erase(cennet->name);
-            reset_count.erase(cennet->name);
-            cen_count.erase(cennet->name);
-            logic_count.erase(cennet->name);
-        } else if (global_clock->second != 0) {
-            NetInfo *clknet = ctx->nets[global_clock->first].get();
-            insert_global(ctx, clknet, false, false, false, global_clock->second);
+            promoted(cennet);
+        } else if (global_clock.second != 0) {
+            NetInfo *clknet = ctx->nets[global_clock.first].get();
+            insert_global(ctx, clknet, false, false, false, global_clock.second);
             ++prom_globals;
-            clock_count.erase(clknet->name);
-            reset_count.erase(clknet->name);
-            cen_count.erase(clknet->name);
-            logic_count.erase(clknet->name);
+            promoted(clknet);
         } else {
             break;
         }
@@ -1639,26 +1656,69 @@ void pack_plls(Context *ctx)
 }
 
 // Main pack function
+// Clean up the synthesised netlist of buffers, constant logic and unused LUTs
+static void pack_optimise(Context *ctx)
+{
+    NetlistOptCfg cfg;
+    cfg.luts.push_back({ctx->id("SB_LUT4"), {ctx->id("I0"), ctx->id("I1"), ctx->id("I2"), ctx->id("I3")}, ctx->id("O"),
+                        ctx->id("LUT_INIT")});
+    cfg.constants.push_back({ctx->id("GND"), ctx->id("Y"), false});
+    cfg.constants.push_back({ctx->id("VCC"), ctx->id("Y"), true});
+    optimise_netlist(ctx, cfg);
+}
+
 bool Arch::pack()
 {
     Context *ctx = getCtx();
     try {
         log_break();
-        pack_constants(ctx);
-        pack_io(ctx);
-        pack_lut_lutffs(ctx);
-        pack_nonlut_ffs(ctx);
-        pack_carries(ctx);
-        pack_ram(ctx);
-        place_plls(ctx);
-        pack_special(ctx);
-        pack_plls(ctx);
-        if (!bool_or_default(ctx->settings, ctx->id("no_promote_globals"), false))
-            promote_globals(ctx);
-        ctx->assignArchInfo();
-        constrain_chains(ctx);
-        ctx->fixupHierarchy();
-        ctx->assignArchInfo();
+        int threads = ctx->stage_threads("pack", 1);
+        bool promote = !bool_or_default(ctx->settings, ctx->id("no_promote_globals"), false);
+
+        // The packer is a pipeline of passes, each timed and with its effect on the number of cells recorded
+        struct PackPass
+        {
+            const char *name;
+            std::function<void()> run;
+            double time;
+            int cells_before, cells_after;
+        };
+        std::vector<PackPass> passes = {
+                {"optimise", [&]() { pack_optimise(ctx); }},
+                {"constants", [&]() { pack_constants(ctx); }},
+                {"io", [&]() { pack_io(ctx); }},
+                {"lut/ff", [&]() { pack_lut_lutffs(ctx, threads); }},
+                {"carries", [&]() { pack_carries(ctx); }},
+                {"ram", [&]() { pack_ram(ctx); }},
+                {"place plls", [&]() { place_plls(ctx); }},
+                {"special", [&]() { pack_special(ctx); }},
+                {"plls", [&]() { pack_plls(ctx); }},
+                {"globals",
+                 [&]() {
+                     if (promote)
+                         promote_globals(ctx);
+                 }},
+                {"chains",
+                 [&]() {
+                     ctx->assignArchInfo();
+                     constrain_chains(ctx);
+                 }},
+                {"hierarchy", [&]() { ctx->fixupHierarchy(); }},
+                {"arch info", [&]() { ctx->assignArchInfo(); }},
+        };
+        for (auto &pass : passes) {
+            pass.cells_before = int(ctx->cells.size());
+            auto pass_start = std::chrono::high_resolution_clock::now();
+            pass.run();
+            auto pass_end = std::chrono::high_resolution_clock::now();
+            pass.time = std::chrono::duration<double>(pass_end - pass_start).count();
+            pass.cells_after = int(ctx->cells.size());
+        }
+        log_info("Packer pass times:\n");
+        for (auto &pass : passes)
+            log_info("    %-12s %7.3fs  %6d -> %6d cells\n", pass.name, pass.time, pass.cells_before,
+                     pass.cells_after);
+
         ctx->settings[ctx->id("pack")] = 1;
         archInfoToAttributes();
         log_info("Checksum: 0x%08x\n", ctx->checksum());
@@ -19,40 +19,103 @@
 
 #include "jsonwrite.h"
 #include <assert.h>
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <iterator>
 #include <log.h>
 #include <map>
+#include <memory>
+#include <numeric>
 #include <string>
 #include "nextpnr.h"
+#include "out_buffer.h"
+#include "util.h"
 #include "version.h"
+#ifndef NPNR_DISABLE_THREADS
+#include "worker_pool.h"
+#endif
 
 NEXTPNR_NAMESPACE_BEGIN
 
 namespace JsonWriter {
 
-std::string get_string(std::string str)
+// How the ROUTING attribute of nets is written
+enum class RoutingMode
 {
-    std::string newstr = "\"";
+    KEEP,
+    COMPACT,
+    OMIT
+};
+
+struct WriteOptions
+{
+    RoutingMode routing = RoutingMode::KEEP;
+    IdString routing_id;
+    int threads = 1;
+#ifndef NPNR_DISABLE_THREADS
+    WorkerPool *pool = nullptr;
+#endif
+};
+
+void write_string(OutBuffer &f, const std::string &str)
+{
+    f << '"';
     for (char c : str) {
         if (c == '\\')
-            newstr += c;
-        newstr += c;
+            f.buf += c;
+        f.buf += c;
     }
-    return newstr + "\"";
+    f << '"';
 }
 
-std::string get_name(IdString name, Context *ctx) { return get_string(name.c_str(ctx)); }
+void write_name(OutBuffer &f, IdString name, Context *ctx) { write_string(f, name.str(ctx)); }
+
+// ROUTING is a list of wire;pip;strength entries. For entries that bind a pip the wire is its destination and is
+// ignored when reading the design back in, so it can be left out.
+std::string compact_routing(const std::string &routing)
+{
+    std::vector<std::pair<size_t, size_t>> fields;
+    size_t start = 0;
+    for (size_t i = 0; i <= routing.size(); i++) {
+        if (i == routing.size() || routing[i] == ';') {
+            fields.emplace_back(start, i - start);
+            start = i + 1;
+        }
+    }
+    std::string result;
+    result.reserve(routing.size());
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (i > 0)
+            result += ';';
+        bool has_pip = (i % 3 == 0) && (i + 2 < fields.size()) && (fields.at(i + 1).second != 0);
+        if (!has_pip)
+            result.append(routing, fields.at(i).first, fields.at(i).second);
+    }
+    return result;
+}
 
-void write_parameters(std::ostream &f, Context *ctx, const std::unordered_map<IdString, Property> &parameters,
-                      bool for_module = false)
+// Net attributes are passed the write options, for their ROUTING attribute
+template <typename Container>
+void write_parameters(OutBuffer &f, Context *ctx, const Container &parameters, bool for_module = false,
+                      const WriteOptions *net_opts = nullptr)
 {
     bool first = true;
     for (auto &param : parameters) {
-        f << stringf("%s\n", first ? "" : ",");
-        f << stringf("        %s%s: ", for_module ? "" : "    ", get_name(param.first, ctx).c_str());
-        f << get_string(param.second.to_string());
+        if (net_opts != nullptr && net_opts->routing != RoutingMode::KEEP && param.first == net_opts->routing_id) {
+            if (net_opts->routing == RoutingMode::OMIT)
+                continue;
+            f << (first ? "\n" : ",\n") << (for_module ? "        " : "            ");
+            write_name(f, param.first, ctx);
+            f << ": ";
+            write_string(f, compact_routing(param.second.to_string()));
+        } else {
+            f << (first ? "\n" : ",\n") << (for_module ? "        " : "            ");
+            write_name(f, param.first, ctx);
+            f << ": ";
+            write_string(f, param.second.to_string());
+        }
         first = false;
     }
 }
@@ -64,8 +127,7 @@ struct PortGroup
     PortType dir;
 };
 
-std::vector<PortGroup> group_ports(Context *ctx, const std::unordered_map<IdString, PortInfo> &ports,
-                                   bool is_cell = false)
+std::vector<PortGroup> group_ports(Context *ctx, const PortInfoMap &ports, bool is_cell = false)
 {
     std::vector<PortGroup> groups;
     std::unordered_map<std::string, size_t> base_to_group;
@@ -95,122 +157,214 @@ std::vector<PortGroup> group_ports(Context *ctx, const std::unordered_map<IdStri
     return groups;
 }
 
-std::string format_port_bits(const PortGroup &port, int &dummy_idx)
+// Single disconnected ports are written as an empty list
+bool skip_port_bits(const PortGroup &port) { return port.bits.size() == 1 && port.bits.at(0) == -1; }
+
+// Number of dummy indices format_port_bits will use for a list of ports
+int count_dummy_bits(const std::vector<PortGroup> &ports)
+{
+    int count = 0;
+    for (auto &port : ports)
+        if (!skip_port_bits(port))
+            count += int(std::count(port.bits.begin(), port.bits.end(), -1));
+    return count;
+}
+
+void format_port_bits(OutBuffer &f, const PortGroup &port, int &dummy_idx)
 {
-    std::stringstream s;
-    s << "[ ";
+    f << "[ ";
     bool first = true;
-    if (port.bits.size() != 1 || port.bits.at(0) != -1) // skip single disconnected ports
+    if (!skip_port_bits(port))
         for (auto bit : port.bits) {
             if (!first)
-                s << ", ";
+                f << ", ";
             if (bit == -1)
-                s << (++dummy_idx);
+                f << (++dummy_idx);
             else
-                s << bit;
+                f << bit;
+            first = false;
+        }
+    f << " ]";
+}
+
+void write_cell(OutBuffer &f, Context *ctx, const CellInfo *c, const std::vector<PortGroup> &cell_ports, int dummy_idx)
+{
+    f << "        ";
+    write_name(f, c->name, ctx);
+    f << ": {\n";
+    f << "          \"hide_name\": " << (c->name.c_str(ctx)[0] == '$' ? "1" : "0") << ",\n";
+    f << "          \"type\": ";
+    write_name(f, c->type, ctx);
+    f << ",\n";
+    f << "          \"parameters\": {";
+    write_parameters(f, ctx, c->params);
+    f << "\n          },\n";
+    f << "          \"attributes\": {";
+    write_parameters(f, ctx, c->attrs);
+    f << "\n          },\n";
+    f << "          \"port_directions\": {";
+    bool first = true;
+    for (auto &pg : cell_ports) {
+        const char *direction = (pg.dir == PORT_IN) ? "input" : (pg.dir == PORT_OUT) ? "output" : "inout";
+        f << (first ? "\n" : ",\n") << "            ";
+        write_string(f, pg.name);
+        f << ": \"" << direction << "\"";
+        first = false;
+    }
+    f << "\n          },\n";
+    f << "          \"connections\": {";
+    first = true;
+    for (auto &pg : cell_ports) {
+        f << (first ? "\n" : ",\n") << "            ";
+        write_string(f, pg.name);
+        f << ": ";
+        format_port_bits(f, pg, dummy_idx);
+        first = false;
+    }
+    f << "\n          }\n";
+    f << "        }";
+}
+
+void write_net(OutBuffer &f, Context *ctx, const NetInfo *w, const WriteOptions &opts)
+{
+    f << "        ";
+    write_name(f, w->name, ctx);
+    f << ": {\n";
+    f << "          \"hide_name\": " << (w->name.c_str(ctx)[0] == '$' ? "1" : "0") << ",\n";
+    f << "          \"bits\": [ " << w->name.index << " ] ,\n";
+    f << "          \"attributes\": {";
+    write_parameters(f, ctx, w->attrs, false, &opts);
+    f << "\n          }\n";
+    f << "        }";
+}
+
+// Call func(range, range_begin, range_end) for ranges covering [begin, end), on the worker threads if there are any
+template <typename Func> void for_each_range(const WriteOptions &opts, size_t begin, size_t end, Func func)
+{
+    int ranges = std::max<int>(1, std::min<int>(opts.threads * 4, int(end - begin) / 64));
+    auto do_range = [&](int range) {
+        func(range, begin + (end - begin) * range / ranges, begin + (end - begin) * (range + 1) / ranges);
+    };
+#ifndef NPNR_DISABLE_THREADS
+    if (opts.pool != nullptr && ranges > 1) {
+        std::vector<int> tasks(ranges);
+        std::iota(tasks.begin(), tasks.end(), 0);
+        opts.pool->run(tasks, do_range);
+        return;
+    }
+#endif
+    for (int range = 0; range < ranges; range++)
+        do_range(range);
+}
+
+// Serialise count items, as a comma separated list, in windows that are each split between the worker threads.
+// prepare(begin, end) is called for each window before it is written; windows keep the memory used by per window
+// state and the per thread buffers bounded.
+template <typename PrepareFunc, typename WriteFunc>
+void write_items(OutBuffer &f, size_t count, const WriteOptions &opts, PrepareFunc prepare, WriteFunc write_item)
+{
+    const size_t window = 16384;
+    bool first = true;
+    for (size_t begin = 0; begin < count; begin += window) {
+        size_t end = std::min(count, begin + window);
+        prepare(begin, end);
+        std::vector<OutBuffer> bufs(opts.threads * 4);
+        for_each_range(opts, begin, end, [&](int range, size_t rbegin, size_t rend) {
+            for (size_t i = rbegin; i < rend; i++) {
+                if (i != rbegin)
+                    bufs.at(range) << ",\n";
+                write_item(bufs.at(range), i);
+            }
+        });
+        for (auto &buf : bufs) {
+            if (buf.buf.empty())
+                continue;
+            f << (first ? "\n" : ",\n") << buf.buf;
             first = false;
         }
-    s << " ]";
-    return s.str();
+    }
 }
 
-void write_module(std::ostream &f, Context *ctx)
+void write_module(OutBuffer &f, Context *ctx, const WriteOptions &opts)
 {
     auto val = ctx->attrs.find(ctx->id("module"));
-    int dummy_idx = int(ctx->idstring_idx_to_str->size()) + 1000;
-    if (val != ctx->attrs.end())
-        f << stringf("    %s: {\n", get_string(val->second.as_string()).c_str());
-    else
-        f << stringf("    %s: {\n", get_string("top").c_str());
-    f << stringf("      \"settings\": {");
+    int dummy_idx = ctx->idstring_db->size() + 1000;
+    f << "    ";
+    write_string(f, (val != ctx->attrs.end()) ? val->second.as_string() : std::string("top"));
+    f << ": {\n";
+    f << "      \"settings\": {";
     write_parameters(f, ctx, ctx->settings, true);
-    f << stringf("\n      },\n");
-    f << stringf("      \"attributes\": {");
+    f << "\n      },\n";
+    f << "      \"attributes\": {";
     write_parameters(f, ctx, ctx->attrs, true);
-    f << stringf("\n      },\n");
-    f << stringf("      \"ports\": {");
+    f << "\n      },\n";
+    f << "      \"ports\": {";
 
     auto ports = group_ports(ctx, ctx->ports);
     bool first = true;
     for (auto &port : ports) {
-        f << stringf("%s\n", first ? "" : ",");
-        f << stringf("        %s: {\n", get_string(port.name).c_str());
-        f << stringf("          \"direction\": \"%s\",\n", port.dir == PORT_IN      ? "input"
-                                                           : port.dir == PORT_INOUT ? "inout"
-                                                                                    : "output");
-        f << stringf("          \"bits\": %s\n", format_port_bits(port, dummy_idx).c_str());
-        f << stringf("        }");
+        f << (first ? "\n" : ",\n") << "        ";
+        write_string(f, port.name);
+        f << ": {\n";
+        f << "          \"direction\": \""
+          << (port.dir == PORT_IN ? "input" : port.dir == PORT_INOUT ? "inout" : "output") << "\",\n";
+        f << "          \"bits\": ";
+        format_port_bits(f, port, dummy_idx);
+        f << "\n        }";
         first = false;
     }
-    f << stringf("\n      },\n");
+    f << "\n      },\n";
 
-    f << stringf("      \"cells\": {");
-    first = true;
-    for (auto &pair : ctx->cells) {
-        auto &c = pair.second;
-        auto cell_ports = group_ports(ctx, c->ports, true);
-        f << stringf("%s\n", first ? "" : ",");
-        f << stringf("        %s: {\n", get_name(c->name, ctx).c_str());
-        f << stringf("          \"hide_name\": %s,\n", c->name.c_str(ctx)[0] == '$' ? "1" : "0");
-        f << stringf("          \"type\": %s,\n", get_name(c->type, ctx).c_str());
-        f << stringf("          \"parameters\": {");
-        write_parameters(f, ctx, c->params);
-        f << stringf("\n          },\n");
-        f << stringf("          \"attributes\": {");
-        write_parameters(f, ctx, c->attrs);
-        f << stringf("\n          },\n");
-        f << stringf("          \"port_directions\": {");
-        bool first2 = true;
-        for (auto &pg : cell_ports) {
-            std::string direction = (pg.dir == PORT_IN) ? "input" : (pg.dir == PORT_OUT) ? "output" : "inout";
-            f << stringf("%s\n", first2 ? "" : ",");
-            f << stringf("            %s: \"%s\"", get_string(pg.name).c_str(), direction.c_str());
-            first2 = false;
-        }
-        f << stringf("\n          },\n");
-        f << stringf("          \"connections\": {");
-        first2 = true;
-        for (auto &pg : cell_ports) {
-            f << stringf("%s\n", first2 ? "" : ",");
-            f << stringf("            %s: %s", get_string(pg.name).c_str(), format_port_bits(pg, dummy_idx).c_str());
-            first2 = false;
+    // Cells are written in the order of ctx->cells. Dummy indices for disconnected port bits are handed out in that
+    // same order, so each window first counts the ones every cell needs to find where its range starts.
+    f << "      \"cells\": {";
+    std::vector<const CellInfo *> cells;
+    cells.reserve(ctx->cells.size());
+    for (auto &cell : ctx->cells)
+        cells.push_back(cell.second.get());
+    std::vector<std::vector<PortGroup>> cell_ports(cells.size());
+    std::vector<int> dummy_start(cells.size());
+    auto prepare_cells = [&](size_t begin, size_t end) {
+        for_each_range(opts, begin, end, [&](int, size_t rbegin, size_t rend) {
+            for (size_t i = rbegin; i < rend; i++) {
+                cell_ports.at(i) = group_ports(ctx, cells.at(i)->ports, true);
+                dummy_start.at(i) = count_dummy_bits(cell_ports.at(i));
+            }
+        });
+        for (size_t i = begin; i < end; i++) {
+            int count = dummy_start.at(i);
+            dummy_start.at(i) = dummy_idx;
+            dummy_idx += count;
         }
-        f << stringf("\n          }\n");
-
-        f << stringf("        }");
-        first = false;
-    }
+    };
+    write_items(f, cells.size(), opts, prepare_cells, [&](OutBuffer &buf, size_t i) {
+        write_cell(buf, ctx, cells.at(i), cell_ports.at(i), dummy_start.at(i));
+        std::vector<PortGroup>().swap(cell_ports.at(i));
+    });
+    f << "\n      },\n";
 
-    f << stringf("\n      },\n");
-
-    f << stringf("      \"netnames\": {");
-    first = true;
-    for (auto &pair : ctx->nets) {
-        auto &w = pair.second;
-        f << stringf("%s\n", first ? "" : ",");
-        f << stringf("        %s: {\n", get_name(w->name, ctx).c_str());
-        f << stringf("          \"hide_name\": %s,\n", w->name.c_str(ctx)[0] == '$' ? "1" : "0");
-        f << stringf("          \"bits\": [ %d ] ,\n", pair.first.index);
-        f << stringf("          \"attributes\": {");
-        write_parameters(f, ctx, w->attrs);
-        f << stringf("\n          }\n");
-        f << stringf("        }");
-        first = false;
-    }
-
-    f << stringf("\n      }\n");
-    f << stringf("    }");
+    f << "      \"netnames\": {";
+    std::vector<const NetInfo *> nets;
+    nets.reserve(ctx->nets.size());
+    for (auto &net : ctx->nets)
+        nets.push_back(net.second.get());
+    write_items(
+            f, nets.size(), opts, [](size_t, size_t) {},
+            [&](OutBuffer &buf, size_t i) { write_net(buf, ctx, nets.at(i), opts); });
+    f << "\n      }\n";
+    f << "    }";
 }
 
-void write_context(std::ostream &f, Context *ctx)
+void write_context(OutBuffer &f, Context *ctx, const WriteOptions &opts)
 {
-    f << stringf("{\n");
-    f << stringf("  \"creator\": %s,\n",
-                 get_string("Next Generation Place and Route (Version " GIT_DESCRIBE_STR ")").c_str());
-    f << stringf("  \"modules\": {\n");
-    write_module(f, ctx);
-    f << stringf("\n  }");
-    f << stringf("\n}\n");
+    f << "{\n";
+    f << "  \"creator\": ";
+    write_string(f, "Next Generation Place and Route (Version " GIT_DESCRIBE_STR ")");
+    f << ",\n";
+    f << "  \"modules\": {\n";
+    write_module(f, ctx, opts);
+    f << "\n  }";
+    f << "\n}\n";
 }
 
 }; // End Namespace JsonWriter
@@ -221,7 +375,27 @@ bool write_json_file(std::ostream &f, std::string &filename, Context *ctx)
         using namespace JsonWriter;
         if (!f)
             log_error("failed to open JSON file.\n");
-        write_context(f, ctx);
+        WriteOptions opts;
+        opts.routing_id = ctx->id("ROUTING");
+        opts.threads = ctx->stage_threads("jsonwrite", 1);
+        std::string routing = str_or_default(ctx->settings, ctx->id("jsonwrite/routing"), "keep");
+        if (routing == "compact")
+            opts.routing = RoutingMode::COMPACT;
+        else if (routing == "omit")
+            opts.routing = RoutingMode::OMIT;
+        else if (routing != "keep")
+            log_error("Unknown ROUTING attribute mode '%s' (available options: keep, compact, omit)\n",
+                      routing.c_str());
+#ifndef NPNR_DISABLE_THREADS
+        std::unique_ptr<WorkerPool> pool;
+        if (opts.threads > 1) {
+            pool.reset(new WorkerPool(opts.threads));
+            opts.pool = pool.get();
+        }
+#endif
+        OutBuffer buf(&f);
+        write_context(buf, ctx, opts);
+        buf.flush();
         log_break();
         return true;
     } catch (log_execution_error_exception) {
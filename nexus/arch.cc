@@ -19,15 +19,21 @@
  */
 
 #include <boost/algorithm/string.hpp>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 
 #include "embed.h"
 #include "log.h"
 #include "nextpnr.h"
 #include "placer1.h"
 #include "placer_heap.h"
+#include "route_graph.h"
 #include "router1.h"
 #include "router2.h"
+#include "router_lookahead.h"
 #include "timing.h"
+#include "timing_opt.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -110,6 +116,14 @@ Arch::Arch(ArchArgs args) : args(args)
     }
     if (!chip_info)
         log_error("Unknown device '%s'.\n", device.c_str());
+    // Bels, wires and pips are used throughout; pad and package data only for a few lookups
+    for (auto &loc : db->loctypes) {
+        chipdb_advise(loc.bels, ChipdbUse::HOT);
+        chipdb_advise(loc.wires, ChipdbUse::HOT);
+        chipdb_advise(loc.pips, ChipdbUse::HOT);
+    }
+    chipdb_advise(chip_info->pads, ChipdbUse::COLD);
+    chipdb_advise(chip_info->packages, ChipdbUse::COLD);
     // Set up bba IdStrings
     for (size_t i = 0; i < db->ids->bba_id_strs.size(); i++) {
         IdString::initialize_add(this, db->ids->bba_id_strs[i].get(), uint32_t(i) + db->ids->num_file_ids);
@@ -119,6 +133,16 @@ Arch::Arch(ArchArgs args) : args(args)
     for (size_t i = 0; i < chip_info->grid.size(); i++) {
         tileStatus[i].boundcells.resize(db->loctypes[chip_info->grid[i].loc_type].bels.size());
     }
+    // Routing binding structures, flattened over all tiles
+    tile_wire_base.resize(chip_info->grid.size() + 1);
+    tile_pip_base.resize(chip_info->grid.size() + 1);
+    for (size_t i = 0; i < chip_info->grid.size(); i++) {
+        auto &loc = db->loctypes[chip_info->grid[i].loc_type];
+        tile_wire_base[i + 1] = tile_wire_base[i] + loc.wires.size();
+        tile_pip_base[i + 1] = tile_pip_base[i] + loc.pips.size();
+    }
+    wire_to_net.resize(tile_wire_base.back(), nullptr);
+    pip_to_net.resize(tile_pip_base.back(), nullptr);
     // This structure is needed for a fast getBelByLocation because bels can have an offset
     for (size_t i = 0; i < chip_info->grid.size(); i++) {
         auto &loc = db->loctypes[chip_info->grid[i].loc_type];
@@ -151,6 +175,11 @@ Arch::Arch(ArchArgs args) : args(args)
         }
         log_error("Unknown package '%s'. Available package options:%s\n", package.c_str(), all_packages.c_str());
     }
+    for (size_t i = 0; i < chip_info->pads.size(); i++) {
+        const char *pin = chip_info->pads[i].pins[package_idx].get();
+        if (pin != nullptr && pin[0] != '\0')
+            pad_by_pin.emplace(pin, int(i));
+    }
 
     // Validate and set up speed grade
 
@@ -312,7 +341,15 @@ WireId Arch::getWireByName(IdString name) const
     return WireId();
 }
 
-IdString Arch::getWireType(WireId wire) const { return id("WIRE"); }
+IdString Arch::getWireType(WireId wire) const
+{
+    // Wires differing only in their trailing index (such as H02E0001 and H02E0101) are the same type of wire
+    std::string name = nameOf(IdString(wire_data(wire).name));
+    size_t end = name.find_last_not_of("0123456789");
+    if (end != std::string::npos)
+        name.resize(end + 1);
+    return id(name);
+}
 
 std::vector<std::pair<IdString, std::string>> Arch::getWireAttrs(WireId wire) const
 {
@@ -565,10 +602,30 @@ TimingClockingInfo Arch::getPortClockingInfo(const CellInfo *cell, IdString port
 
 // -----------------------------------------------------------------------
 
+void Arch::setup_delay_lookahead()
+{
+    if (delay_lookahead || !bool_or_default(settings, id("arch.delayLookahead")))
+        return;
+    // The table is the same as the router2 lookahead, so shares its cache
+    delay_lookahead = std::make_shared<RouterLookahead>(getCtx());
+    delay_lookahead->init(str_or_default(settings, id("router2/lookaheadCache")));
+    loctype_wire_la_class.resize(db->loctypes.size());
+    for (size_t tile = 0; tile < chip_info->grid.size(); tile++) {
+        auto &classes = loctype_wire_la_class[chip_info->grid[tile].loc_type];
+        int num_wires = db->loctypes[chip_info->grid[tile].loc_type].wires.size();
+        if (int(classes.size()) == num_wires)
+            continue;
+        for (int index = 0; index < num_wires; index++)
+            classes.push_back(delay_lookahead->wire_class(WireId(tile, index)));
+    }
+}
+
 delay_t Arch::estimateDelay(WireId src, WireId dst) const
 {
     int src_x = src.tile % chip_info->width, src_y = src.tile / chip_info->width;
     int dst_x = dst.tile % chip_info->width, dst_y = dst.tile / chip_info->width;
+    if (delay_lookahead)
+        return delay_t(delay_lookahead->estimate(wire_la_class(src), dst_x - src_x, dst_y - src_y).delay);
     int dist_x = std::abs(src_x - dst_x);
     int dist_y = std::abs(src_y - dst_y);
     return 75 * dist_x + 75 * dist_y + 200;
@@ -585,9 +642,23 @@ delay_t Arch::predictDelay(const NetInfo *net_info, const PortRef &sink) const
     int dst_x = sink.cell->bel.tile % chip_info->width, dst_y = sink.cell->bel.tile / chip_info->width;
     int dist_x = std::abs(src_x - dst_x);
     int dist_y = std::abs(src_y - dst_y);
+    if (delay_lookahead) {
+        WireId src_wire = getBelPinWire(net_info->driver.cell->bel, net_info->driver.port);
+        if (src_wire != WireId())
+            return delay_t(delay_lookahead->estimate(wire_la_class(src_wire), dist_x, dist_y).delay);
+    }
     return 100 * dist_x + 100 * dist_y + 250;
 }
 
+int Arch::getPredictDelayClass(const NetInfo *net_info, const PortRef &sink) const
+{
+    if (!delay_lookahead)
+        return 0;
+    // 0 is left for drivers without a wire, which use the same fallback as without the lookahead
+    WireId src_wire = getBelPinWire(net_info->driver.cell->bel, net_info->driver.port);
+    return (src_wire == WireId()) ? 0 : (wire_la_class(src_wire) + 1);
+}
+
 bool Arch::getBudgetOverride(const NetInfo *net_info, const PortRef &sink, delay_t &budget) const { return false; }
 
 ArcBounds Arch::getRouteBoundingBox(WireId src, WireId dst) const
@@ -627,6 +698,7 @@ ArcBounds Arch::getRouteBoundingBox(WireId src, WireId dst) const
 
 bool Arch::place()
 {
+    setup_delay_lookahead();
     std::string placer = str_or_default(settings, id("placer"), defaultPlacer);
 
     if (placer == "heap") {
@@ -649,11 +721,41 @@ bool Arch::place()
         log_error("Nexus architecture does not support placer '%s'\n", placer.c_str());
     }
 
+    bool retVal = true;
+    if (bool_or_default(settings, id("opt_timing"), false)) {
+        TimingOptCfg tocfg(getCtx());
+        tocfg.cellTypes.insert(id_OXIDE_COMB);
+        tocfg.cellTypes.insert(id_OXIDE_FF);
+        // Logic bels are at z = (slice << 3) | bel, so only the LUT or FF positions of the four slices in each tile
+        // need to be looked at
+        tocfg.neighbourBels = [this](BelId centre, int d, std::vector<std::vector<BelId>> &groups) {
+            Loc centre_loc = getBelLocation(centre);
+            IdString type = getBelType(centre);
+            int first_z = (type == id_OXIDE_FF) ? BEL_FF0 : BEL_LUT0;
+            for (int y = std::max(0, centre_loc.y - d); y <= std::min(chip_info->height - 1, centre_loc.y + d); y++) {
+                for (int x = std::max(0, centre_loc.x - d); x <= std::min(chip_info->width - 1, centre_loc.x + d);
+                     x++) {
+                    std::vector<BelId> bels;
+                    for (int slice = 0; slice < 4; slice++) {
+                        for (int z = first_z; z < first_z + 2; z++) {
+                            BelId bel = getBelByLocation(Loc(x, y, (slice << 3) | z));
+                            if (bel != BelId() && getBelType(bel) == type)
+                                bels.push_back(bel);
+                        }
+                    }
+                    if (!bels.empty())
+                        groups.push_back(std::move(bels));
+                }
+            }
+        };
+        retVal = timing_opt(getCtx(), tocfg);
+    }
+
     post_place_opt();
 
     getCtx()->attrs[getCtx()->id("step")] = std::string("place");
     archInfoToAttributes();
-    return true;
+    return retVal;
 }
 
 void Arch::pre_routing()
@@ -679,11 +781,82 @@ void Arch::pre_routing()
     }
 }
 
-bool Arch::route()
+void Arch::setup_canonical_wires()
 {
-    assign_budget(getCtx(), true);
+    if (!canonical_wires.empty())
+        return;
+    auto start = std::chrono::high_resolution_clock::now();
+    static const char magic[8] = {'N', 'P', 'N', 'R', 'C', 'W', '0', '1'};
+    int32_t count = tile_wire_base.back();
+
+    // Cached in the same directory as the flattened routing graph, as this is only used for routing too
+    std::string cache_dir = str_or_default(settings, id("routeGraph/cacheDir"));
+    std::string filename;
+    uint64_t key = 0;
+    if (!cache_dir.empty()) {
+        key = RouteGraph::device_key(getCtx());
+        filename = stringf("%s/canonical-wires-%016llx.bin", cache_dir.c_str(), (unsigned long long)key);
+        std::ifstream in(filename, std::ios::binary);
+        char file_magic[sizeof(magic)];
+        uint64_t file_key;
+        int32_t file_count;
+        in.read(file_magic, sizeof(file_magic));
+        in.read(reinterpret_cast<char *>(&file_key), sizeof(file_key));
+        in.read(reinterpret_cast<char *>(&file_count), sizeof(file_count));
+        if (in && std::equal(magic, magic + sizeof(magic), file_magic) && file_key == key && file_count == count) {
+            canonical_wires.resize(count);
+            in.read(reinterpret_cast<char *>(canonical_wires.data()), sizeof(WireId) * count);
+            if (in) {
+                auto end = std::chrono::high_resolution_clock::now();
+                log_info("Canonical wire table loaded from '%s' in %.02fs\n", filename.c_str(),
+                         std::chrono::duration<float>(end - start).count());
+                return;
+            }
+            log_warning("Canonical wire table cache '%s' is truncated, rebuilding it\n", filename.c_str());
+        }
+    }
+
+    std::vector<WireId> table;
+    table.reserve(count);
+    for (int32_t tile = 0; tile < int32_t(chip_info->grid.size()); tile++) {
+        int num_wires = tile_wire_base[tile + 1] - tile_wire_base[tile];
+        for (int index = 0; index < num_wires; index++)
+            table.push_back(chip_canonical_wire(db, chip_info, tile, index));
+    }
+    // Only switched on once complete, as canonical_wire uses the table as soon as it is not empty
+    canonical_wires = std::move(table);
+    auto end = std::chrono::high_resolution_clock::now();
+    log_info("Canonical wire table built in %.02fs\n", std::chrono::duration<float>(end - start).count());
+
+    if (filename.empty())
+        return;
+    // Written under a temporary name and renamed into place, so that concurrent runs never read a partial file
+    std::string tmp_filename =
+            stringf("%s.%llx.tmp", filename.c_str(),
+                    (unsigned long long)std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    {
+        std::ofstream out(tmp_filename, std::ios::binary);
+        out.write(magic, sizeof(magic));
+        out.write(reinterpret_cast<const char *>(&key), sizeof(key));
+        out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char *>(canonical_wires.data()), sizeof(WireId) * count);
+        if (!out) {
+            log_warning("Failed to write canonical wire table cache '%s'\n", filename.c_str());
+            std::remove(tmp_filename.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        log_warning("Failed to write canonical wire table cache '%s'\n", filename.c_str());
+        std::remove(tmp_filename.c_str());
+    }
+}
 
+bool Arch::route()
+{
     pre_routing();
+    setup_canonical_wires();
+    setup_delay_lookahead();
 
     route_globals();
 
@@ -750,11 +923,10 @@ void Arch::set_cell_pinmux(CellInfo *cell, IdString pin, CellPinMux state)
 
 const PadInfoPOD *Arch::get_pkg_pin_data(const std::string &pin) const
 {
-    for (auto &pad : chip_info->pads) {
-        if (pin == pad.pins[package_idx].get())
-            return &pad;
-    }
-    return nullptr;
+    auto found = pad_by_pin.find(pin);
+    if (found == pad_by_pin.end())
+        return nullptr;
+    return &chip_info->pads[found->second];
 }
 
 Loc Arch::get_pad_loc(const PadInfoPOD *pad) const
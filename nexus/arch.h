@@ -855,6 +855,8 @@ struct ArchArgs
     std::string device;
 };
 
+struct RouterLookahead;
+
 struct Arch : BaseCtx
 {
     ArchArgs args;
@@ -870,19 +872,17 @@ struct Arch : BaseCtx
     const SpeedGradePOD *speed_grade;
 
     int package_idx;
+    // Index into chip_info->pads of the pad of each pin of the package, by name
+    std::unordered_map<std::string, int> pad_by_pin;
 
     // Binding states
     struct LogicTileStatus
     {
-        struct SliceStatus
-        {
-            bool valid = true, dirty = true;
-        } slices[4];
-        struct HalfTileStatus
-        {
-            bool valid = true, dirty = true;
-        } halfs[2];
         CellInfo *cells[32];
+        // Bits 0-3 are set if the cells in that slice can't be used together, and bits 4-5 if the flipflops in that
+        // half of the tile have different control sets. Kept up to date as cells are bound, so the tile is valid
+        // exactly when this is zero
+        uint8_t invalid = 0;
     };
 
     struct TileStatus
@@ -894,8 +894,20 @@ struct Arch : BaseCtx
     };
 
     std::vector<TileStatus> tileStatus;
-    std::unordered_map<WireId, NetInfo *> wire_to_net;
-    std::unordered_map<PipId, NetInfo *> pip_to_net;
+    // Indexed by getWireFlatIndex and getPipFlatIndex
+    std::vector<NetInfo *> wire_to_net;
+    std::vector<NetInfo *> pip_to_net;
+    // Flat index of the first wire and pip of each tile, counting through the tiles in order
+    std::vector<int> tile_wire_base, tile_pip_base;
+
+    int getWireFlatIndex(WireId wire) const { return tile_wire_base[wire.tile] + wire.index; }
+    int getPipFlatIndex(PipId pip) const { return tile_pip_base[pip.tile] + pip.index; }
+
+    // Canonical wire of every tile wire, indexed by getWireFlatIndex. Filled in before routing, so that the pip
+    // source and destination lookups done by the routers don't have to search for the primary location of a wire
+    // every time; empty until then
+    std::vector<WireId> canonical_wires;
+    void setup_canonical_wires();
 
     // -------------------------------------------------
 
@@ -1044,51 +1056,52 @@ struct Arch : BaseCtx
     void bindWire(WireId wire, NetInfo *net, PlaceStrength strength)
     {
         NPNR_ASSERT(wire != WireId());
-        NPNR_ASSERT(wire_to_net[wire] == nullptr);
-        wire_to_net[wire] = net;
+        NetInfo *&bound = wire_to_net[getWireFlatIndex(wire)];
+        NPNR_ASSERT(bound == nullptr);
+        bound = net;
         net->wires[wire].pip = PipId();
         net->wires[wire].strength = strength;
+        net->wire_delays.clear();
         refreshUiWire(wire);
     }
 
     void unbindWire(WireId wire)
     {
         NPNR_ASSERT(wire != WireId());
-        NPNR_ASSERT(wire_to_net[wire] != nullptr);
+        NetInfo *&bound = wire_to_net[getWireFlatIndex(wire)];
+        NPNR_ASSERT(bound != nullptr);
 
-        auto &net_wires = wire_to_net[wire]->wires;
+        auto &net_wires = bound->wires;
         auto it = net_wires.find(wire);
         NPNR_ASSERT(it != net_wires.end());
 
         auto pip = it->second.pip;
         if (pip != PipId()) {
-            pip_to_net[pip] = nullptr;
+            pip_to_net[getPipFlatIndex(pip)] = nullptr;
         }
 
         net_wires.erase(it);
-        wire_to_net[wire] = nullptr;
+        bound->wire_delays.clear();
+        bound = nullptr;
         refreshUiWire(wire);
     }
 
     bool checkWireAvail(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        auto w2n = wire_to_net.find(wire);
-        return w2n == wire_to_net.end() || w2n->second == nullptr;
+        return wire_to_net[getWireFlatIndex(wire)] == nullptr;
     }
 
     NetInfo *getBoundWireNet(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        auto w2n = wire_to_net.find(wire);
-        return w2n == wire_to_net.end() ? nullptr : w2n->second;
+        return wire_to_net[getWireFlatIndex(wire)];
     }
 
     NetInfo *getConflictingWireNet(WireId wire) const
     {
         NPNR_ASSERT(wire != WireId());
-        auto w2n = wire_to_net.find(wire);
-        return w2n == wire_to_net.end() ? nullptr : w2n->second;
+        return wire_to_net[getWireFlatIndex(wire)];
     }
 
     WireId getConflictingWireWire(WireId wire) const { return wire; }
@@ -1143,16 +1156,19 @@ struct Arch : BaseCtx
     void bindPip(PipId pip, NetInfo *net, PlaceStrength strength)
     {
         NPNR_ASSERT(pip != PipId());
-        NPNR_ASSERT(pip_to_net[pip] == nullptr);
+        NetInfo *&bound = pip_to_net[getPipFlatIndex(pip)];
+        NPNR_ASSERT(bound == nullptr);
 
         WireId dst = canonical_wire(pip.tile, pip_data(pip).to_wire);
-        NPNR_ASSERT(wire_to_net[dst] == nullptr || wire_to_net[dst] == net);
+        NetInfo *&dst_bound = wire_to_net[getWireFlatIndex(dst)];
+        NPNR_ASSERT(dst_bound == nullptr || dst_bound == net);
 
-        pip_to_net[pip] = net;
+        bound = net;
 
-        wire_to_net[dst] = net;
+        dst_bound = net;
         net->wires[dst].pip = pip;
         net->wires[dst].strength = strength;
+        net->wire_delays.clear();
         refreshUiPip(pip);
         refreshUiWire(dst);
     }
@@ -1160,14 +1176,17 @@ struct Arch : BaseCtx
     void unbindPip(PipId pip)
     {
         NPNR_ASSERT(pip != PipId());
-        NPNR_ASSERT(pip_to_net[pip] != nullptr);
+        NetInfo *&bound = pip_to_net[getPipFlatIndex(pip)];
+        NPNR_ASSERT(bound != nullptr);
 
         WireId dst = canonical_wire(pip.tile, pip_data(pip).to_wire);
-        NPNR_ASSERT(wire_to_net[dst] != nullptr);
-        wire_to_net[dst] = nullptr;
-        pip_to_net[pip]->wires.erase(dst);
+        NetInfo *&dst_bound = wire_to_net[getWireFlatIndex(dst)];
+        NPNR_ASSERT(dst_bound != nullptr);
+        dst_bound = nullptr;
+        bound->wires.erase(dst);
+        bound->wire_delays.clear();
 
-        pip_to_net[pip] = nullptr;
+        bound = nullptr;
         refreshUiPip(pip);
         refreshUiWire(dst);
     }
@@ -1175,14 +1194,13 @@ struct Arch : BaseCtx
     bool checkPipAvail(PipId pip) const
     {
         NPNR_ASSERT(pip != PipId());
-        return pip_to_net.find(pip) == pip_to_net.end() || pip_to_net.at(pip) == nullptr;
+        return pip_to_net[getPipFlatIndex(pip)] == nullptr;
     }
 
     NetInfo *getBoundPipNet(PipId pip) const
     {
         NPNR_ASSERT(pip != PipId());
-        auto p2n = pip_to_net.find(pip);
-        return p2n == pip_to_net.end() ? nullptr : p2n->second;
+        return pip_to_net[getPipFlatIndex(pip)];
     }
 
     WireId getConflictingPipWire(PipId pip) const { return getPipDstWire(pip); }
@@ -1190,8 +1208,7 @@ struct Arch : BaseCtx
     NetInfo *getConflictingPipNet(PipId pip) const
     {
         NPNR_ASSERT(pip != PipId());
-        auto p2n = pip_to_net.find(pip);
-        return p2n == pip_to_net.end() ? nullptr : p2n->second;
+        return pip_to_net[getPipFlatIndex(pip)];
     }
 
     AllPipRange getPips() const
@@ -1302,6 +1319,13 @@ struct Arch : BaseCtx
 
     delay_t estimateDelay(WireId src, WireId dst) const;
     delay_t predictDelay(const NetInfo *net_info, const PortRef &sink) const;
+    // predictDelay only depends on the cell types and ports of the arc, the distance between the bels when they are in
+    // different tiles (the delay lookahead is queried with absolute offsets) and, with the delay lookahead, the
+    // lookahead class of the driver's wire, returned by getPredictDelayClass; so PredictDelayCache may memoise it
+    static const bool predictDelayCacheable = true;
+    int getPredictDelayClass(const NetInfo *net_info, const PortRef &sink) const;
+    // WireId and PipId are plain indices into the chipdb, so a flattened routing graph can be cached on disk
+    static const bool routeGraphCacheable = true;
     delay_t getDelayEpsilon() const { return 20; }
     delay_t getRipupDelayPenalty() const { return 120; }
     delay_t getWireRipupDelayPenalty(WireId wire) const;
@@ -1319,7 +1343,18 @@ struct Arch : BaseCtx
 
     // for better DSP bounding boxes
     void pre_routing();
-    std::unordered_set<WireId> dsp_wires, lram_wires;
+    FlatHashSet<WireId> dsp_wires, lram_wires;
+
+    // Delay lookahead used by estimateDelay and predictDelay when enabled with the arch.delayLookahead setting; built
+    // before placement, or before routing if placement was skipped
+    std::shared_ptr<RouterLookahead> delay_lookahead;
+    // Lookahead class of each wire, by location type and wire index in the tile
+    std::vector<std::vector<int>> loctype_wire_la_class;
+    void setup_delay_lookahead();
+    int wire_la_class(WireId wire) const
+    {
+        return loctype_wire_la_class[chip_info->grid[wire.tile].loc_type][wire.index];
+    }
 
     // -------------------------------------------------
 
@@ -1340,10 +1375,16 @@ struct Arch : BaseCtx
     // This is not intended for Bel type checks, but finer-grained constraints
     // such as conflicting set/reset signals, etc
     bool isValidBelForCell(CellInfo *cell, BelId bel) const;
+    // Preference of the initial placer among valid Bels; lower is better. No preference on this arch
+    int scoreBelForCell(CellInfo *cell, BelId bel) const { return 0; }
 
     // Return true whether all Bels at a given location are valid
     bool isBelLocationValid(BelId bel) const;
 
+    // As isBelLocationValid, but as if each Bel in overlay were bound to the given cell (or unbound, for nullptr)
+    // instead. Only Bels in the same tile as bel are looked up in overlay
+    bool isBelLocationValidWith(BelId bel, const std::unordered_map<BelId, CellInfo *> &overlay) const;
+
     // -------------------------------------------------
 
     bool pack();
@@ -1398,6 +1439,8 @@ struct Arch : BaseCtx
     }
     inline WireId canonical_wire(int32_t tile, uint16_t index) const
     {
+        if (!canonical_wires.empty())
+            return canonical_wires[tile_wire_base[tile] + index];
         WireId c = chip_canonical_wire(db, chip_info, tile, index);
         return c;
     }
@@ -1417,6 +1460,12 @@ struct Arch : BaseCtx
     typedef std::unordered_map<IdString, CellPinStyle> CellPinsData;
 
     std::unordered_map<IdString, CellPinsData> cell_pins_db;
+    // Dense copy of cell_pins_db, as the packer looks up every port of every cell: the styles of a cell type are the
+    // row starting at cell_pin_style_row[type.index] (or -1), indexed by port.index, with the default for any other
+    // port at cell_pin_style_width
+    std::vector<int> cell_pin_style_row;
+    std::vector<CellPinStyle> cell_pin_styles;
+    int cell_pin_style_width = 0;
     CellPinStyle get_cell_pin_style(const CellInfo *cell, IdString port) const;
 
     void init_cell_pin_data();
@@ -1480,16 +1529,24 @@ struct Arch : BaseCtx
         case BEL_FF0:
         case BEL_FF1:
         case BEL_RAMW:
-            ts.halfs[(z >> 3) / 2].dirty = true;
+            update_logic_half(ts, (z >> 3) / 2);
         /* fall-through */
         case BEL_LUT0:
         case BEL_LUT1:
-            ts.slices[(z >> 3)].dirty = true;
+            update_logic_slice(ts, (z >> 3));
             break;
         }
     }
 
-    bool nexus_logic_tile_valid(LogicTileStatus &lts) const;
+    // Recompute the validity bit of one slice or half of a logic tile from its cells
+    void update_logic_slice(LogicTileStatus &lts, int s) const;
+    void update_logic_half(LogicTileStatus &lts, int h) const;
+    // Recompute all of the validity bits of a logic tile, for when the info of its cells has changed
+    void update_logic_tile(LogicTileStatus &lts) const;
+    bool nexus_logic_tile_valid(const LogicTileStatus &lts) const { return lts.invalid == 0; }
+
+    // Interned control sets of flipflops and RAMWs, so that they can be compared by ffInfo.ctrlset_id
+    std::unordered_map<FFControlSet, int> ctrlset_ids;
 
     CellPinMux get_cell_pinmux(const CellInfo *cell, IdString pin) const;
     void set_cell_pinmux(CellInfo *cell, IdString pin, CellPinMux state);
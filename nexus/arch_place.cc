@@ -23,77 +23,85 @@
 
 NEXTPNR_NAMESPACE_BEGIN
 
-bool Arch::nexus_logic_tile_valid(LogicTileStatus &lts) const
+void Arch::update_logic_slice(LogicTileStatus &lts, int s) const
 {
-    for (int s = 0; s < 4; s++) {
-        if (lts.slices[s].dirty) {
-            lts.slices[s].valid = false;
-            lts.slices[s].dirty = false;
-            CellInfo *lut0 = lts.cells[(s << 3) | BEL_LUT0];
-            CellInfo *lut1 = lts.cells[(s << 3) | BEL_LUT1];
-            CellInfo *ff0 = lts.cells[(s << 3) | BEL_FF0];
-            CellInfo *ff1 = lts.cells[(s << 3) | BEL_FF1];
+    auto slice_valid = [&]() {
+        CellInfo *lut0 = lts.cells[(s << 3) | BEL_LUT0];
+        CellInfo *lut1 = lts.cells[(s << 3) | BEL_LUT1];
+        CellInfo *ff0 = lts.cells[(s << 3) | BEL_FF0];
+        CellInfo *ff1 = lts.cells[(s << 3) | BEL_FF1];
 
-            if (s == 2) {
-                CellInfo *ramw = lts.cells[(s << 3) | BEL_RAMW];
-                // Nothing else in SLICEC can be used if the RAMW is used
-                if (ramw != nullptr) {
-                    if (lut0 != nullptr || lut1 != nullptr || ff0 != nullptr || ff1 != nullptr)
-                        return false;
-                }
-            }
-
-            if (lut0 != nullptr) {
-                // Check for overuse of M signal
-                if (lut0->lutInfo.mux2_used && ff0 != nullptr && ff0->ffInfo.m != nullptr)
+        if (s == 2) {
+            CellInfo *ramw = lts.cells[(s << 3) | BEL_RAMW];
+            // Nothing else in SLICEC can be used if the RAMW is used
+            if (ramw != nullptr) {
+                if (lut0 != nullptr || lut1 != nullptr || ff0 != nullptr || ff1 != nullptr)
                     return false;
             }
-            // Check for correct use of FF0 DI
-            if (ff0 != nullptr && ff0->ffInfo.di != nullptr &&
-                (lut0 == nullptr || (ff0->ffInfo.di != lut0->lutInfo.f && ff0->ffInfo.di != lut0->lutInfo.ofx)))
-                return false;
-            if (lut1 != nullptr) {
-                // LUT1 cannot contain a MUX2
-                if (lut1->lutInfo.mux2_used)
-                    return false;
-                // If LUT1 is carry then LUT0 must be carry too
-                if (lut1->lutInfo.is_carry && (lut0 == nullptr || !lut0->lutInfo.is_carry))
-                    return false;
-                if (!lut1->lutInfo.is_carry && lut0 != nullptr && lut0->lutInfo.is_carry)
-                    return false;
-            }
-            // Check for correct use of FF1 DI
-            if (ff1 != nullptr && ff1->ffInfo.di != nullptr && (lut1 == nullptr || ff1->ffInfo.di != lut1->lutInfo.f))
+        }
+
+        if (lut0 != nullptr) {
+            // Check for overuse of M signal
+            if (lut0->lutInfo.mux2_used && ff0 != nullptr && ff0->ffInfo.m != nullptr)
                 return false;
-            lts.slices[s].valid = true;
-        } else if (!lts.slices[s].valid) {
+        }
+        // Check for correct use of FF0 DI
+        if (ff0 != nullptr && ff0->ffInfo.di != nullptr &&
+            (lut0 == nullptr || (ff0->ffInfo.di != lut0->lutInfo.f && ff0->ffInfo.di != lut0->lutInfo.ofx)))
             return false;
+        if (lut1 != nullptr) {
+            // LUT1 cannot contain a MUX2
+            if (lut1->lutInfo.mux2_used)
+                return false;
+            // If LUT1 is carry then LUT0 must be carry too
+            if (lut1->lutInfo.is_carry && (lut0 == nullptr || !lut0->lutInfo.is_carry))
+                return false;
+            if (!lut1->lutInfo.is_carry && lut0 != nullptr && lut0->lutInfo.is_carry)
+                return false;
         }
-    }
-    for (int h = 0; h < 2; h++) {
-        if (lts.halfs[h].dirty) {
-            bool found_ff = false;
-            FFControlSet ctrlset;
-            for (int i = 0; i < 2; i++) {
-                for (auto bel : {BEL_FF0, BEL_FF1, BEL_RAMW}) {
-                    if (bel == BEL_RAMW && (h != 1 || i != 0))
-                        continue;
-                    CellInfo *ci = lts.cells[(h * 2 + i) << 3 | bel];
-                    if (ci == nullptr)
-                        continue;
-                    if (!found_ff) {
-                        ctrlset = ci->ffInfo.ctrlset;
-                        found_ff = true;
-                    } else if (ci->ffInfo.ctrlset != ctrlset) {
-                        return false;
-                    }
-                }
-            }
-        } else if (!lts.halfs[h].valid) {
+        // Check for correct use of FF1 DI
+        if (ff1 != nullptr && ff1->ffInfo.di != nullptr && (lut1 == nullptr || ff1->ffInfo.di != lut1->lutInfo.f))
             return false;
+        return true;
+    };
+    if (slice_valid())
+        lts.invalid &= ~(1 << s);
+    else
+        lts.invalid |= (1 << s);
+}
+
+void Arch::update_logic_half(LogicTileStatus &lts, int h) const
+{
+    // All the flipflops in a half, and the RAMW in the upper half, share one control set
+    int ctrlset = -1;
+    bool valid = true;
+    for (int i = 0; i < 2 && valid; i++) {
+        for (auto bel : {BEL_FF0, BEL_FF1, BEL_RAMW}) {
+            if (bel == BEL_RAMW && (h != 1 || i != 0))
+                continue;
+            const CellInfo *ci = lts.cells[(h * 2 + i) << 3 | bel];
+            if (ci == nullptr)
+                continue;
+            if (ctrlset == -1) {
+                ctrlset = ci->ffInfo.ctrlset_id;
+            } else if (ci->ffInfo.ctrlset_id != ctrlset) {
+                valid = false;
+                break;
+            }
         }
     }
-    return true;
+    if (valid)
+        lts.invalid &= ~(1 << (4 + h));
+    else
+        lts.invalid |= (1 << (4 + h));
+}
+
+void Arch::update_logic_tile(LogicTileStatus &lts) const
+{
+    for (int s = 0; s < 4; s++)
+        update_logic_slice(lts, s);
+    for (int h = 0; h < 2; h++)
+        update_logic_half(lts, h);
 }
 
 bool Arch::isValidBelForCell(CellInfo *cell, BelId bel) const
@@ -115,4 +123,34 @@ bool Arch::isBelLocationValid(BelId bel) const
     }
 }
 
+bool Arch::isBelLocationValidWith(BelId bel, const std::unordered_map<BelId, CellInfo *> &overlay) const
+{
+    if (bel_tile_is(bel, LOC_LOGIC)) {
+        const auto &ts = tileStatus[bel.tile];
+        // Check a copy of the tile status with the overlay applied, so that the real one is left untouched
+        LogicTileStatus lts;
+        if (ts.lts != nullptr)
+            std::copy(std::begin(ts.lts->cells), std::end(ts.lts->cells), std::begin(lts.cells));
+        else
+            std::fill(std::begin(lts.cells), std::end(lts.cells), nullptr);
+        bool changed = false;
+        for (int z = 0; z < std::min<int>(32, int(ts.bels_by_z.size())); z++) {
+            BelId bel_other = ts.bels_by_z.at(z);
+            if (bel_other == BelId())
+                continue;
+            auto found = overlay.find(bel_other);
+            if (found != overlay.end()) {
+                lts.cells[z] = found->second;
+                changed = true;
+            }
+        }
+        if (!changed)
+            return isBelLocationValid(bel);
+        update_logic_tile(lts);
+        return nexus_logic_tile_valid(lts);
+    } else {
+        return true;
+    }
+}
+
 NEXTPNR_NAMESPACE_END
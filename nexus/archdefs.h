@@ -171,6 +171,8 @@ inline bool operator!=(const FFControlSet &a, const FFControlSet &b)
            (a.ce != b.ce);
 }
 
+inline bool operator==(const FFControlSet &a, const FFControlSet &b) { return !(a != b); }
+
 struct ArchCellInfo
 {
     union
@@ -183,6 +185,8 @@ struct ArchCellInfo
         struct
         {
             FFControlSet ctrlset;
+            // Small integer identifying ctrlset, equal for cells with equal control sets
+            int ctrlset_id;
             NetInfo *di, *m;
         } ffInfo;
     };
@@ -228,6 +232,22 @@ template <> struct hash<NEXTPNR_NAMESPACE_PREFIX PipId>
     }
 };
 
+template <> struct hash<NEXTPNR_NAMESPACE_PREFIX FFControlSet>
+{
+    std::size_t operator()(const NEXTPNR_NAMESPACE_PREFIX FFControlSet &cs) const noexcept
+    {
+        std::size_t seed = 0;
+        boost::hash_combine(seed, hash<int>()(cs.clkmux));
+        boost::hash_combine(seed, hash<int>()(cs.cemux));
+        boost::hash_combine(seed, hash<int>()(cs.lsrmux));
+        boost::hash_combine(seed, hash<int>()((cs.async ? 1 : 0) | (cs.regddr_en ? 2 : 0) | (cs.gsr_en ? 4 : 0)));
+        boost::hash_combine(seed, hash<NEXTPNR_NAMESPACE_PREFIX NetInfo *>()(cs.clk));
+        boost::hash_combine(seed, hash<NEXTPNR_NAMESPACE_PREFIX NetInfo *>()(cs.lsr));
+        boost::hash_combine(seed, hash<NEXTPNR_NAMESPACE_PREFIX NetInfo *>()(cs.ce));
+        return seed;
+    }
+};
+
 template <> struct hash<NEXTPNR_NAMESPACE_PREFIX GroupId>
 {
     std::size_t operator()(const NEXTPNR_NAMESPACE_PREFIX GroupId &group) const noexcept
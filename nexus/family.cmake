@@ -11,20 +11,20 @@ foreach(subfamily ${NEXUS_FAMILIES})
     if(BBASM_MODE STREQUAL "binary")
         add_custom_command(
             OUTPUT ${chipdb_bin}
-            COMMAND bbasm ${BBASM_ENDIAN_FLAG} ${chipdb_bba} ${chipdb_bin}
+            COMMAND bbasm ${BBASM_ENDIAN_FLAG} ${BBASM_COMPRESS_FLAG} ${chipdb_bba} ${chipdb_bin}
             DEPENDS bbasm chipdb-${family}-bbas ${chipdb_bba})
         list(APPEND chipdb_binaries ${chipdb_bin})
     elseif(BBASM_MODE STREQUAL "embed")
         add_custom_command(
             OUTPUT ${chipdb_cc} ${chipdb_bin}
-            COMMAND bbasm ${BBASM_ENDIAN_FLAG} --e ${chipdb_bba} ${chipdb_cc} ${chipdb_bin}
+            COMMAND bbasm ${BBASM_ENDIAN_FLAG} ${BBASM_COMPRESS_FLAG} --e ${chipdb_bba} ${chipdb_cc} ${chipdb_bin}
             DEPENDS bbasm chipdb-${family}-bbas ${chipdb_bba})
         list(APPEND chipdb_sources ${chipdb_cc})
         list(APPEND chipdb_binaries ${chipdb_bin})
     elseif(BBASM_MODE STREQUAL "string")
         add_custom_command(
             OUTPUT ${chipdb_cc}
-            COMMAND bbasm ${BBASM_ENDIAN_FLAG} --c ${chipdb_bba} ${chipdb_cc}
+            COMMAND bbasm ${BBASM_ENDIAN_FLAG} ${BBASM_COMPRESS_FLAG} --c ${chipdb_bba} ${chipdb_cc}
             DEPENDS bbasm chipdb-${family}-bbas ${chipdb_bba})
         list(APPEND chipdb_sources ${chipdb_cc})
     endif()
@@ -30,35 +30,66 @@ struct NexusFasmWriter
 {
     const Context *ctx;
     std::ostream &out;
-    std::vector<std::string> fasm_ctx;
+    // Output is built up here and written out in large blocks, rather than a few characters at a time
+    std::string buf;
+    // The FASM context stack, joined with and followed by '.'; and the length of the prefix before each push
+    std::string prefix;
+    std::vector<size_t> prefix_lens;
+    // Full names of the tiles at each location, by index in phys_tiles; created as first used
+    std::vector<std::vector<std::string>> tile_names;
 
-    NexusFasmWriter(const Context *ctx, std::ostream &out) : ctx(ctx), out(out) {}
+    NexusFasmWriter(const Context *ctx, std::ostream &out) : ctx(ctx), out(out)
+    {
+        tile_names.resize(ctx->chip_info->grid.size());
+    }
+
+    // Write out the buffer once it gets large, and at the end
+    void flush_buf(bool force = false)
+    {
+        if (buf.size() >= (1 << 20) || (force && !buf.empty())) {
+            out.write(buf.data(), buf.size());
+            buf.clear();
+        }
+    }
+    void end_line()
+    {
+        buf += '\n';
+        flush_buf();
+    }
 
     // Add a 'dot' prefix to the FASM context stack
-    void push(const std::string &x) { fasm_ctx.push_back(x); }
+    void push(const std::string &x)
+    {
+        prefix_lens.push_back(prefix.size());
+        prefix += x;
+        prefix += '.';
+    }
 
     // Remove a prefix from the FASM context stack
-    void pop() { fasm_ctx.pop_back(); }
+    void pop()
+    {
+        prefix.resize(prefix_lens.back());
+        prefix_lens.pop_back();
+    }
 
     // Remove N prefices from the FASM context stack
     void pop(int N)
     {
         for (int i = 0; i < N; i++)
-            fasm_ctx.pop_back();
+            pop();
     }
     bool last_was_blank = true;
     // Insert a blank line if the last wasn't blank
     void blank()
     {
         if (!last_was_blank)
-            out << std::endl;
+            end_line();
         last_was_blank = true;
     }
     // Write out all prefices from the stack, interspersed with .
     void write_prefix()
     {
-        for (auto &x : fasm_ctx)
-            out << x << ".";
+        buf += prefix;
         last_was_blank = false;
     }
     // Write a single config bit; if value is true
@@ -66,26 +97,34 @@ struct NexusFasmWriter
     {
         if (value) {
             write_prefix();
-            out << name << std::endl;
+            buf += name;
+            end_line();
         }
     }
     // Write a FASM attribute
     void write_attribute(const std::string &key, const std::string &value, bool str = true)
     {
         std::string qu = str ? "\"" : "";
-        out << "{ " << key << "=" << qu << value << qu << " }" << std::endl;
+        buf += "{ " + key + "=" + qu + value + qu + " }";
+        end_line();
         last_was_blank = false;
     }
     // Write a FASM comment
-    void write_comment(const std::string &cmt) { out << "# " << cmt << std::endl; }
+    void write_comment(const std::string &cmt)
+    {
+        buf += "# ";
+        buf += cmt;
+        end_line();
+    }
     // Write a FASM bitvector; optionally inverting the values in the process
     void write_vector(const std::string &name, const std::vector<bool> &value, bool invert = false)
     {
         write_prefix();
-        out << name << " = " << int(value.size()) << "'b";
+        buf += name;
+        buf += stringf(" = %d'b", int(value.size()));
         for (auto bit : boost::adaptors::reverse(value))
-            out << ((bit ^ invert) ? '1' : '0');
-        out << std::endl;
+            buf += ((bit ^ invert) ? '1' : '0');
+        end_line();
     }
     // Write a FASM bitvector given an integer value
     void write_int_vector(const std::string &name, uint64_t value, int width, bool invert = false)
@@ -140,11 +179,17 @@ struct NexusFasmWriter
     }
 
     // Gets the full name of a tile
-    std::string tile_name(int loc, const PhysicalTileInfoPOD &tile)
+    const std::string &tile_name(int loc, const PhysicalTileInfoPOD &tile)
     {
-        int r = loc / ctx->chip_info->width;
-        int c = loc % ctx->chip_info->width;
-        return stringf("%sR%dC%d__%s", ctx->nameOf(tile.prefix), r, c, ctx->nameOf(tile.tiletype));
+        auto &ploc = ctx->chip_info->grid[loc];
+        auto &names = tile_names[loc];
+        if (names.empty()) {
+            int r = loc / ctx->chip_info->width;
+            int c = loc % ctx->chip_info->width;
+            for (auto &pt : ploc.phys_tiles)
+                names.push_back(stringf("%sR%dC%d__%s", ctx->nameOf(pt.prefix), r, c, ctx->nameOf(pt.tiletype)));
+        }
+        return names.at(&tile - ploc.phys_tiles.begin());
     }
     // Look up a tile by location index and tile type
     const PhysicalTileInfoPOD &tile_by_type_and_loc(int loc, IdString type)
@@ -196,7 +241,8 @@ struct NexusFasmWriter
     void push_bel(BelId bel)
     {
         push_belgroup(bel);
-        fasm_ctx.back() += stringf(".%s", ctx->nameOf(ctx->bel_data(bel).name));
+        prefix += ctx->nameOf(ctx->bel_data(bel).name);
+        prefix += '.';
     }
     // Write out a pip in tile.dst.src format
     void write_pip(PipId pip)
@@ -204,10 +250,12 @@ struct NexusFasmWriter
         auto &pd = ctx->pip_data(pip);
         if (pd.flags & PIP_FIXED_CONN)
             return;
-        std::string tile = tile_name(pip.tile, tile_by_type_and_loc(pip.tile, pd.tile_type));
-        std::string source_wire = escape_name(ctx->pip_src_wire_name(pip).str(ctx));
-        std::string dest_wire = escape_name(ctx->pip_dst_wire_name(pip).str(ctx));
-        out << stringf("%s.PIP.%s.%s", tile.c_str(), dest_wire.c_str(), source_wire.c_str()) << std::endl;
+        buf += tile_name(pip.tile, tile_by_type_and_loc(pip.tile, pd.tile_type));
+        buf += ".PIP.";
+        buf += escape_name(ctx->pip_dst_wire_name(pip).str(ctx));
+        buf += '.';
+        buf += escape_name(ctx->pip_src_wire_name(pip).str(ctx));
+        end_line();
     }
     // Write out all the pips corresponding to a net
     void write_net(const NetInfo *net)
@@ -508,7 +556,7 @@ struct NexusFasmWriter
                     value = stringf("320'h%s", value.c_str());
                 } else {
                     // True Verilog bitvector
-                    value = stringf("320'b%s", prop.str.c_str());
+                    value = stringf("320'b%s", prop.bit_str().c_str());
                 }
                 write_bit(stringf("INITVAL_%02X[319:0] = %s", i, value.c_str()));
             }
@@ -628,7 +676,7 @@ struct NexusFasmWriter
                 value = stringf("5120'h%s", value.c_str());
             } else {
                 // True Verilog bitvector
-                value = stringf("5120'b%s", prop.str.c_str());
+                value = stringf("5120'b%s", prop.bit_str().c_str());
             }
             write_bit(stringf("INITVAL_%02X[5119:0] = %s", i, value.c_str()));
         }
@@ -756,6 +804,7 @@ struct NexusFasmWriter
         write_unused();
         // Write bank config
         write_bankcfg();
+        flush_buf(true);
     }
 };
 } // namespace
@@ -18,12 +18,12 @@
  *
  */
 
+#include <chrono>
+#include "global_router.h"
 #include "log.h"
 #include "nextpnr.h"
 #include "util.h"
 
-#include <queue>
-
 NEXTPNR_NAMESPACE_BEGIN
 
 struct NexusGlobalRouter
@@ -42,15 +42,10 @@ struct NexusGlobalRouter
         return true;
     }
 
-    // Dedicated backwards BFS routing for global networks
+    // Dedicated backwards BFS routing for global networks, onto the routing already built for the net
     template <typename Tfilt>
     bool backwards_bfs_route(NetInfo *net, size_t user_idx, int iter_limit, bool strict, Tfilt pip_filter)
     {
-        // Queue of wires to visit
-        std::queue<WireId> visit;
-        // Wire -> upstream pip
-        std::unordered_map<WireId, PipId> backtrace;
-
         // Lookup source and destination wires
         WireId src = ctx->getNetinfoSourceWire(net);
         WireId dst = ctx->getNetinfoSinkWire(net, net->users.at(user_idx));
@@ -66,74 +61,15 @@ struct NexusGlobalRouter
         if (ctx->getBoundWireNet(src) != net)
             ctx->bindWire(src, net, STRENGTH_LOCKED);
 
-        if (src == dst) {
-            // Nothing more to do
+        // As the source is bound, this always ends at the source or at earlier routing from it
+        WireId found = route_to_global_tree(
+                ctx, net, dst, iter_limit, [&](WireId wire) { return ctx->getBoundWireNet(wire) == net; }, pip_filter);
+        if (found != WireId())
             return true;
-        }
-
-        visit.push(dst);
-        backtrace[dst] = PipId();
-
-        int iter = 0;
-
-        while (!visit.empty() && (iter++ < iter_limit)) {
-            WireId cursor = visit.front();
-            visit.pop();
-            // Search uphill pips
-            for (PipId pip : ctx->getPipsUphill(cursor)) {
-                // Skip pip if unavailable, and not because it's already used for this net
-                if (!ctx->checkPipAvail(pip) && ctx->getBoundPipNet(pip) != net)
-                    continue;
-                WireId prev = ctx->getPipSrcWire(pip);
-                // Ditto for the upstream wire
-                if (!ctx->checkWireAvail(prev) && ctx->getBoundWireNet(prev) != net)
-                    continue;
-                // Skip already visited wires
-                if (backtrace.count(prev))
-                    continue;
-                // Apply our custom pip filter
-                if (!pip_filter(pip))
-                    continue;
-                // Add to the queue
-                visit.push(prev);
-                backtrace[prev] = pip;
-                // Check if we are done yet
-                if (prev == src)
-                    goto done;
-            }
-            if (false) {
-            done:
-                break;
-            }
-        }
-
-        if (backtrace.count(src)) {
-            WireId cursor = src;
-            std::vector<PipId> pips;
-            // Create a list of pips on the routed path
-            while (true) {
-                PipId pip = backtrace.at(cursor);
-                if (pip == PipId())
-                    break;
-                pips.push_back(pip);
-                cursor = ctx->getPipDstWire(pip);
-            }
-            // Reverse that list
-            std::reverse(pips.begin(), pips.end());
-            // Bind pips until we hit already-bound routing
-            for (PipId pip : pips) {
-                WireId dst = ctx->getPipDstWire(pip);
-                if (ctx->getBoundWireNet(dst) == net)
-                    break;
-                ctx->bindPip(pip, net, STRENGTH_LOCKED);
-            }
-            return true;
-        } else {
-            if (strict)
-                log_error("Failed to route net '%s' from %s to %s using dedicated routing.\n", ctx->nameOf(net),
-                          ctx->nameOfWire(src), ctx->nameOfWire(dst));
-            return false;
-        }
+        if (strict)
+            log_error("Failed to route net '%s' from %s to %s using dedicated routing.\n", ctx->nameOf(net),
+                      ctx->nameOfWire(src), ctx->nameOfWire(dst));
+        return false;
     }
 
     void route_clk_net(NetInfo *net)
@@ -146,6 +82,7 @@ struct NexusGlobalRouter
     void operator()()
     {
         log_info("Routing globals...\n");
+        auto rstart = std::chrono::high_resolution_clock::now();
         for (auto net : sorted(ctx->nets)) {
             NetInfo *ni = net.second;
             CellInfo *drv = ni->driver.cell;
@@ -156,6 +93,8 @@ struct NexusGlobalRouter
                 continue;
             }
         }
+        auto rend = std::chrono::high_resolution_clock::now();
+        log_info("Global routing took %.02fs\n", std::chrono::duration<float>(rend - rstart).count());
     }
 };
 
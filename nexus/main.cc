@@ -34,9 +34,14 @@ class NexusCommandHandler : public CommandHandler
     NexusCommandHandler(int argc, char **argv);
     virtual ~NexusCommandHandler(){};
     std::unique_ptr<Context> createContext(std::unordered_map<std::string, Property> &values) override;
+    std::vector<std::string> getContextOptions() override
+    {
+        return {"device", "no-post-place-opt", "opt-timing", "delay-lookahead"};
+    }
     void setupArchContext(Context *ctx) override{};
     void customBitstream(Context *ctx) override;
     void customAfterLoad(Context *ctx) override;
+    bool preflightConfig(Context *ctx, PreflightCfg &cfg) override;
 
   protected:
     po::options_description getArchOptions() override;
@@ -51,6 +56,9 @@ po::options_description NexusCommandHandler::getArchOptions()
     specific.add_options()("fasm", po::value<std::string>(), "fasm file to write");
     specific.add_options()("pdc", po::value<std::string>(), "physical constraints file");
     specific.add_options()("no-post-place-opt", "disable post-place repacking (debugging use only)");
+    specific.add_options()("opt-timing", "run post-placement timing optimisation pass (experimental)");
+    specific.add_options()("delay-lookahead",
+                           "estimate placement and routing delays from a table built by exploring the routing graph");
 
     return specific;
 }
@@ -76,6 +84,10 @@ std::unique_ptr<Context> NexusCommandHandler::createContext(std::unordered_map<s
     auto ctx = std::unique_ptr<Context>(new Context(chipArgs));
     if (vm.count("no-post-place-opt"))
         ctx->settings[ctx->id("no_post_place_opt")] = Property::State::S1;
+    if (vm.count("opt-timing"))
+        ctx->settings[ctx->id("opt_timing")] = Property::State::S1;
+    if (vm.count("delay-lookahead"))
+        ctx->settings[ctx->id("arch.delayLookahead")] = Property::State::S1;
     return ctx;
 }
 
@@ -90,6 +102,30 @@ void NexusCommandHandler::customAfterLoad(Context *ctx)
     }
 }
 
+bool NexusCommandHandler::preflightConfig(Context *ctx, PreflightCfg &cfg)
+{
+    PreflightCfg::Resource comb("LUTs", {id_OXIDE_COMB});
+    comb.groups.push_back(preflight_cell_types({{id_LUT4, 1}, {id_INV, 1}, {id_CCU2, 2}, {id_WIDEFN9, 2}}));
+    cfg.resources.push_back(comb);
+    PreflightCfg::Resource ff("FFs", {id_OXIDE_FF});
+    ff.groups.push_back(preflight_cell_types({{id_FD1P3BX, 1}, {id_FD1P3DX, 1}, {id_FD1P3IX, 1}, {id_FD1P3JX, 1}}));
+    cfg.resources.push_back(ff);
+    std::unordered_map<IdString, int> io_types;
+    for (auto type : {"IB", "OB", "OBZ", "BB", "BB_I3C_A", "SEIO33", "SEIO18", "DIFFIO18", "SEIO33_CORE", "SEIO18_CORE",
+                      "DIFFIO18_CORE"}) {
+        io_types[ctx->id(type)] = 1;
+        cfg.pad_cell_types.push_back(ctx->id(type));
+    }
+    PreflightCfg::Resource io("IOs", {id_SEIO33_CORE, id_SEIO18_CORE});
+    io.groups.push_back(preflight_cell_types(io_types));
+    io.top_ports = true;
+    cfg.resources.push_back(io);
+    cfg.loc_attrs.push_back(id_LOC);
+    cfg.global_bel_types.push_back(id_DCC);
+    cfg.clock_ports.push_back(id_CK);
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     NexusCommandHandler handler(argc, argv);
@@ -21,8 +21,10 @@
 #include "design_utils.h"
 #include "log.h"
 #include "nextpnr.h"
+#include "pack_engine.h"
 #include "util.h"
 
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <queue>
 
@@ -48,7 +50,7 @@ Property Arch::parse_lattice_param(const CellInfo *ci, IdString prop, int width,
                 char c = s.at(i);
                 if (c != '0' && c != '1' && c != 'x')
                     log_error("Invalid binary digit '%c' in property %s.%s\n", c, nameOf(ci), nameOf(prop));
-                temp.str.push_back(c);
+                temp.push_back(Property::State(c));
             }
         } else if (boost::starts_with(s, "0x")) {
             for (int i = int(s.length()) - 1; i >= 2; i--) {
@@ -63,7 +65,7 @@ Property Arch::parse_lattice_param(const CellInfo *ci, IdString prop, int width,
                 else
                     log_error("Invalid hex digit '%c' in property %s.%s\n", c, nameOf(ci), nameOf(prop));
                 for (int j = 0; j < 4; j++)
-                    temp.str.push_back(((nibble >> j) & 0x1) ? Property::S1 : Property::S0);
+                    temp.push_back(((nibble >> j) & 0x1) ? Property::S1 : Property::S0);
             }
         } else {
             int64_t ival = 0;
@@ -78,16 +80,16 @@ Property Arch::parse_lattice_param(const CellInfo *ci, IdString prop, int width,
             temp = Property(ival);
         }
 
-        for (auto b : temp.str.substr(width)) {
-            if (b == Property::S1)
+        for (int i = width; i < int(temp.size()); i++) {
+            if (temp.get(i) == Property::S1)
                 log_error("Found value for property %s.%s with width greater than %d\n", nameOf(ci), nameOf(prop),
                           width);
         }
         temp.update_intval();
         return temp.extract(0, width);
     } else {
-        for (auto b : val.str.substr(width)) {
-            if (b == Property::S1)
+        for (int i = width; i < int(val.size()); i++) {
+            if (val.get(i) == Property::S1)
                 log_error("Found bitvector value for property %s.%s with width greater than %d - perhaps a string was "
                           "converted to bits?\n",
                           nameOf(ci), nameOf(prop), width);
@@ -100,106 +102,15 @@ struct NexusPacker
 {
     Context *ctx;
 
-    // Generic cell transformation
-    // Given cell name map and port map
-    // If port name is not found in port map; it will be copied as-is but stripping []
-    struct XFormRule
-    {
-        IdString new_type;
-        std::unordered_map<IdString, IdString> port_xform;
-        std::unordered_map<IdString, std::vector<IdString>> port_multixform;
-        std::unordered_map<IdString, IdString> param_xform;
-        std::vector<std::pair<IdString, std::string>> set_attrs;
-        std::vector<std::pair<IdString, Property>> set_params;
-        std::vector<std::pair<IdString, Property>> default_params;
-        std::vector<std::tuple<IdString, IdString, int, int64_t>> parse_params;
-    };
-
-    void xform_cell(const std::unordered_map<IdString, XFormRule> &rules, CellInfo *ci)
-    {
-        auto &rule = rules.at(ci->type);
-        ci->type = rule.new_type;
-        std::vector<IdString> orig_port_names;
-        for (auto &port : ci->ports)
-            orig_port_names.push_back(port.first);
-
-        for (auto pname : orig_port_names) {
-            if (rule.port_multixform.count(pname)) {
-                auto old_port = ci->ports.at(pname);
-                disconnect_port(ctx, ci, pname);
-                ci->ports.erase(pname);
-                for (auto new_name : rule.port_multixform.at(pname)) {
-                    ci->ports[new_name].name = new_name;
-                    ci->ports[new_name].type = old_port.type;
-                    connect_port(ctx, old_port.net, ci, new_name);
-                }
-            } else {
-                IdString new_name;
-                if (rule.port_xform.count(pname)) {
-                    new_name = rule.port_xform.at(pname);
-                } else {
-                    std::string stripped_name;
-                    for (auto c : pname.str(ctx))
-                        if (c != '[' && c != ']')
-                            stripped_name += c;
-                    new_name = ctx->id(stripped_name);
-                }
-                if (new_name != pname) {
-                    rename_port(ctx, ci, pname, new_name);
-                }
-            }
-        }
-
-        std::vector<IdString> xform_params;
-        for (auto &param : ci->params)
-            if (rule.param_xform.count(param.first))
-                xform_params.push_back(param.first);
-        for (auto param : xform_params)
-            ci->params[rule.param_xform.at(param)] = ci->params[param];
-
-        for (auto &attr : rule.set_attrs)
-            ci->attrs[attr.first] = attr.second;
-
-        for (auto &param : rule.default_params)
-            if (!ci->params.count(param.first))
-                ci->params[param.first] = param.second;
-
-        {
-            IdString old_param, new_param;
-            int width;
-            int64_t def;
-            for (const auto &p : rule.parse_params) {
-                std::tie(old_param, new_param, width, def) = p;
-                ci->params[new_param] = ctx->parse_lattice_param(ci, old_param, width, def);
-            }
-        }
-
-        for (auto &param : rule.set_params)
-            ci->params[param.first] = param.second;
-    }
+    // Generic cell transformation, by the common packing engine
+    typedef PackEngine::XFormRule XFormRule;
+    PackEngine engine;
 
     void generic_xform(const std::unordered_map<IdString, XFormRule> &rules, bool print_summary = false)
     {
-        std::map<std::string, int> cell_count;
-        std::map<std::string, int> new_types;
-        for (auto cell : sorted(ctx->cells)) {
-            CellInfo *ci = cell.second;
-            if (rules.count(ci->type)) {
-                cell_count[ci->type.str(ctx)]++;
-                xform_cell(rules, ci);
-                new_types[ci->type.str(ctx)]++;
-            }
-        }
-        if (print_summary) {
-            for (auto &nt : new_types) {
-                log_info("    Created %d %s cells from:\n", nt.second, nt.first.c_str());
-                for (auto &cc : cell_count) {
-                    if (rules.at(ctx->id(cc.first)).new_type != ctx->id(nt.first))
-                        continue;
-                    log_info("        %6dx %s\n", cc.second, cc.first.c_str());
-                }
-            }
-        }
+        // The netlist changes between these passes, so the engine's index of cells by type is refreshed each time
+        engine.index_cells();
+        engine.xform(rules, print_summary);
     }
 
     void pack_luts()
@@ -1139,7 +1050,8 @@ struct NexusPacker
                 std::string name = stringf("INITVAL_%02X", i);
                 if (!ci->params.count(ctx->id(name)))
                     continue;
-                if (ci->params.at(ctx->id(name)).str.find_last_not_of("0x") == std::string::npos)
+                const Property &init = ci->params.at(ctx->id(name));
+                if ((init.is_string ? init.str : init.bit_str()).find_last_not_of("0x") == std::string::npos)
                     continue;
                 log_error("LRAM initialisation is currently unsupported in ECC mode (to disable ECC, set ECC_BYTE_SEL "
                           "to BYTE_EN).\n");
@@ -1291,9 +1203,82 @@ struct NexusPacker
         return false;
     }
 
+    // The cascade routing found from each output of the cells of a macro, at its temporary placement. Every macro
+    // of the same shape gets the same temporary placement, so this is only searched for once per shape
+    struct CascadeTemplate
+    {
+        BelId root_bel;
+        // For a bel and output pin, the input bel pins within the macro reached by cascade routing, in search order
+        std::map<std::pair<BelId, IdString>, std::vector<std::pair<BelId, IdString>>> reached_pins;
+    };
+    std::unordered_map<std::string, CascadeTemplate> cascade_templates;
+
+    // Find the input pins of other bels of the macro reachable from a bel output through cascade (not general)
+    // routing
+    std::vector<std::pair<BelId, IdString>> find_cascade_pins(WireId start_wire,
+                                                              const std::unordered_map<BelId, CellInfo *> &bel2cell)
+    {
+        std::vector<std::pair<BelId, IdString>> reached;
+        if (ctx->debug)
+            log_info("     searching cascade routing for wire %s:\n", ctx->nameOfWire(start_wire));
+
+        // Standard BFS-type exploration
+        std::queue<WireId> visit;
+        std::unordered_set<WireId> in_queue;
+        visit.push(start_wire);
+        in_queue.insert(start_wire);
+        int iter = 0;
+        const int iter_limit = 1000;
+
+        while (!visit.empty() && (iter++ < iter_limit)) {
+            WireId cursor = visit.front();
+            visit.pop();
+
+            if (ctx->debug)
+                log_info("         visit '%s'\n", ctx->nameOfWire(cursor));
+
+            // Check for downstream bel pins
+            bool found_active_pins = false;
+            for (auto bp : ctx->getWireBelPins(cursor)) {
+                // Always skip unused bels, and don't set found_active_pins
+                // so we can route through these if needed
+                if (!bel2cell.count(bp.bel))
+                    continue;
+                // Skip outputs
+                if (ctx->getBelPinType(bp.bel, bp.pin) != PORT_IN)
+                    continue;
+
+                if (ctx->debug)
+                    log_info("             bel %s pin %s\n", ctx->nameOfBel(bp.bel), ctx->nameOf(bp.pin));
+
+                found_active_pins = true;
+                reached.emplace_back(bp.bel, bp.pin);
+            }
+
+            // By doing this we never attempt to route-through bels
+            // that are actually in use
+            if (found_active_pins)
+                continue;
+
+            // Search downstream pips for wires to add to the queue
+            for (auto pip : ctx->getPipsDownhill(cursor)) {
+                WireId dst = ctx->getPipDstWire(pip);
+                // Ignore general routing, as that isn't a useful cascade path
+                if (is_general_routing(dst))
+                    continue;
+                if (in_queue.count(dst))
+                    continue;
+                in_queue.insert(dst);
+                visit.push(dst);
+            }
+        }
+        return reached;
+    }
+
     // Automatically generate cascade connections downstream of a cell
     // using the temporary placement that we use solely to access the routing graph
-    void auto_cascade_cell(CellInfo *cell, BelId bel, const std::unordered_map<BelId, CellInfo *> &bel2cell)
+    void auto_cascade_cell(CellInfo *cell, BelId bel, const std::unordered_map<BelId, CellInfo *> &bel2cell,
+                           CascadeTemplate &tmpl)
     {
         // Create outputs based on the actual bel
         for (auto bp : ctx->getBelPins(bel)) {
@@ -1307,81 +1292,33 @@ struct NexusPacker
             // Skip if not an output, or being used already for something else
             if (port.second.type != PORT_OUT || port.second.net != nullptr)
                 continue;
-            // Get the corresponding start wire
-            WireId start_wire = ctx->getBelPinWire(bel, port.first);
-
-            // Skip if the start wire doesn't actually exist
-            if (start_wire == WireId())
-                continue;
-
-            if (ctx->debug)
-                log_info("     searching cascade routing for wire %s:\n", ctx->nameOfWire(start_wire));
-
-            // Standard BFS-type exploration
-            std::queue<WireId> visit;
-            std::unordered_set<WireId> in_queue;
-            visit.push(start_wire);
-            in_queue.insert(start_wire);
-            int iter = 0;
-            const int iter_limit = 1000;
-
-            while (!visit.empty() && (iter++ < iter_limit)) {
-                WireId cursor = visit.front();
-                visit.pop();
-
-                if (ctx->debug)
-                    log_info("         visit '%s'\n", ctx->nameOfWire(cursor));
-
-                // Check for downstream bel pins
-                bool found_active_pins = false;
-                for (auto bp : ctx->getWireBelPins(cursor)) {
-                    auto fnd_cell = bel2cell.find(bp.bel);
-                    // Always skip unused bels, and don't set found_active_pins
-                    // so we can route through these if needed
-                    if (fnd_cell == bel2cell.end())
-                        continue;
-                    // Skip outputs
-                    if (ctx->getBelPinType(bp.bel, bp.pin) != PORT_IN)
-                        continue;
-
-                    if (ctx->debug)
-                        log_info("             bel %s pin %s\n", ctx->nameOfBel(bp.bel), ctx->nameOf(bp.pin));
-
-                    found_active_pins = true;
-                    CellInfo *other_cell = fnd_cell->second;
-
-                    if (other_cell == cell)
-                        continue;
+            auto fnd_reached = tmpl.reached_pins.find(std::make_pair(bel, port.first));
+            if (fnd_reached == tmpl.reached_pins.end()) {
+                // Get the corresponding start wire
+                WireId start_wire = ctx->getBelPinWire(bel, port.first);
+                std::vector<std::pair<BelId, IdString>> reached;
+                // Skip if the start wire doesn't actually exist
+                if (start_wire != WireId())
+                    reached = find_cascade_pins(start_wire, bel2cell);
+                fnd_reached = tmpl.reached_pins.emplace(std::make_pair(bel, port.first), std::move(reached)).first;
+            }
 
-                    // Skip pins that are already in use
-                    if (get_net_or_empty(other_cell, bp.pin) != nullptr)
-                        continue;
-                    // Create the input if it doesn't exist
-                    if (!other_cell->ports.count(bp.pin))
-                        other_cell->addInput(bp.pin);
-                    // Make the connection
-                    connect_ports(ctx, cell, port.first, other_cell, bp.pin);
-
-                    if (ctx->debug)
-                        log_info("         found %s.%s\n", ctx->nameOf(other_cell), ctx->nameOf(bp.pin));
-                }
+            for (auto &bp : fnd_reached->second) {
+                CellInfo *other_cell = bel2cell.at(bp.first);
+                if (other_cell == cell)
+                    continue;
 
-                // By doing this we never attempt to route-through bels
-                // that are actually in use
-                if (found_active_pins)
+                // Skip pins that are already in use
+                if (get_net_or_empty(other_cell, bp.second) != nullptr)
                     continue;
+                // Create the input if it doesn't exist
+                if (!other_cell->ports.count(bp.second))
+                    other_cell->addInput(bp.second);
+                // Make the connection
+                connect_ports(ctx, cell, port.first, other_cell, bp.second);
 
-                // Search downstream pips for wires to add to the queue
-                for (auto pip : ctx->getPipsDownhill(cursor)) {
-                    WireId dst = ctx->getPipDstWire(pip);
-                    // Ignore general routing, as that isn't a useful cascade path
-                    if (is_general_routing(dst))
-                        continue;
-                    if (in_queue.count(dst))
-                        continue;
-                    in_queue.insert(dst);
-                    visit.push(dst);
-                }
+                if (ctx->debug)
+                    log_info("         found %s.%s\n", ctx->nameOf(other_cell), ctx->nameOf(bp.second));
             }
         }
     }
@@ -1398,16 +1335,20 @@ struct NexusPacker
             return l;
         };
 
+        // The shape of the macro, which is all that determines its temporary placement
+        std::string shape = root->type.str(ctx);
+        for (auto child : root->constr_children)
+            shape += stringf(";%s,%d,%d,%d,%d", ctx->nameOf(child->type), child->constr_x, child->constr_y,
+                             child->constr_z, int(child->constr_abs_z));
+        auto fnd_tmpl = cascade_templates.find(shape);
+
         // We first create a temporary placement so we can access the routing graph
         bool found = false;
         std::unordered_map<BelId, CellInfo *> bel2cell;
         std::unordered_map<IdString, BelId> cell2bel;
 
-        for (BelId root_bel : ctx->getBels()) {
-            if (ctx->getBelType(root_bel) != root->type)
-                continue;
+        auto try_root_bel = [&](BelId root_bel) {
             Loc root_loc = ctx->getBelLocation(root_bel);
-            found = true;
             bel2cell.clear();
             cell2bel.clear();
             bel2cell[root_bel] = root;
@@ -1417,20 +1358,30 @@ struct NexusPacker
                 // Check that a valid placement exists for all children in the macro at this location
                 Loc c_loc = get_child_loc(root_loc, child);
                 BelId c_bel = ctx->getBelByLocation(c_loc);
-                if (c_bel == BelId()) {
-                    found = false;
-                    break;
-                }
-                if (ctx->getBelType(c_bel) != child->type) {
-                    found = false;
-                    break;
-                }
+                if (c_bel == BelId())
+                    return false;
+                if (ctx->getBelType(c_bel) != child->type)
+                    return false;
                 bel2cell[c_bel] = child;
                 cell2bel[child->name] = c_bel;
             }
+            return true;
+        };
 
-            if (found)
-                break;
+        if (fnd_tmpl != cascade_templates.end()) {
+            found = try_root_bel(fnd_tmpl->second.root_bel);
+            NPNR_ASSERT(found);
+        } else {
+            for (BelId root_bel : ctx->getBels()) {
+                if (ctx->getBelType(root_bel) != root->type)
+                    continue;
+                found = try_root_bel(root_bel);
+                if (found) {
+                    fnd_tmpl = cascade_templates.emplace(shape, CascadeTemplate()).first;
+                    fnd_tmpl->second.root_bel = root_bel;
+                    break;
+                }
+            }
         }
 
         if (!found)
@@ -1443,9 +1394,9 @@ struct NexusPacker
             autocreate_ports(child);
 
         // Insert cascade connections from all cells in the macro
-        auto_cascade_cell(root, cell2bel.at(root->name), bel2cell);
+        auto_cascade_cell(root, cell2bel.at(root->name), bel2cell, fnd_tmpl->second);
         for (auto child : root->constr_children)
-            auto_cascade_cell(child, cell2bel.at(child->name), bel2cell);
+            auto_cascade_cell(child, cell2bel.at(child->name), bel2cell, fnd_tmpl->second);
     }
 
     // Create a DSP cell
@@ -1956,7 +1907,12 @@ struct NexusPacker
         }
     }
 
-    explicit NexusPacker(Context *ctx) : ctx(ctx) {}
+    explicit NexusPacker(Context *ctx) : ctx(ctx), engine(ctx)
+    {
+        engine.param_parser = [ctx](const CellInfo *ci, IdString param, int width, int64_t def) {
+            return ctx->parse_lattice_param(ci, param, width, def);
+        };
+    }
 
     void operator()()
     {
@@ -1978,8 +1934,22 @@ struct NexusPacker
     }
 };
 
+// Clean up the synthesised netlist of buffers, constant logic and unused LUTs. LUTs with an INIT given as a string
+// are left alone
+static void pack_optimise(Context *ctx)
+{
+    NetlistOptCfg cfg;
+    cfg.luts.push_back({id_LUT4, {id_A, id_B, id_C, id_D}, id_Z, id_INIT});
+    cfg.constants.push_back({id_VLO, id_Z, false});
+    cfg.constants.push_back({id_VHI, id_Z, true});
+    cfg.constants.push_back({ctx->id("GND"), ctx->id("Y"), false});
+    cfg.constants.push_back({ctx->id("VCC"), ctx->id("Y"), true});
+    optimise_netlist(ctx, cfg);
+}
+
 bool Arch::pack()
 {
+    pack_optimise(getCtx());
     (NexusPacker(getCtx()))();
     attrs[id("step")] = std::string("pack");
     archInfoToAttributes();
@@ -1994,6 +1964,10 @@ void Arch::assignArchInfo()
     for (auto cell : sorted(cells)) {
         assignCellInfo(cell.second);
     }
+    // The validity of logic tiles with cells already bound depends on the info just assigned
+    for (auto &ts : tileStatus)
+        if (ts.lts != nullptr)
+            update_logic_tile(*ts.lts);
 }
 
 const std::vector<std::string> dsp_bus_prefices = {
@@ -2037,6 +2011,7 @@ void Arch::assignCellInfo(CellInfo *cell)
         cell->ffInfo.ctrlset.lsr = get_net_or_empty(cell, id_LSR);
         cell->ffInfo.di = get_net_or_empty(cell, id_DI);
         cell->ffInfo.m = get_net_or_empty(cell, id_M);
+        cell->ffInfo.ctrlset_id = ctrlset_ids.emplace(cell->ffInfo.ctrlset, int(ctrlset_ids.size())).first->second;
         cell->tmg_index = get_cell_timing_idx(id_OXIDE_FF, id("PPP:SYNC"));
     } else if (cell->type == id_RAMW) {
         cell->ffInfo.ctrlset.async = true;
@@ -2050,6 +2025,7 @@ void Arch::assignCellInfo(CellInfo *cell)
         cell->ffInfo.ctrlset.lsr = get_net_or_empty(cell, id_LSR);
         cell->ffInfo.di = nullptr;
         cell->ffInfo.m = nullptr;
+        cell->ffInfo.ctrlset_id = ctrlset_ids.emplace(cell->ffInfo.ctrlset, int(ctrlset_ids.size())).first->second;
         cell->tmg_index = get_cell_timing_idx(id_RAMW);
     } else if (cell->type == id_OXIDE_EBR) {
         // Strip off bus indices to get the timing ports
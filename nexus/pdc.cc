@@ -21,6 +21,7 @@
 #include "log.h"
 #include "nextpnr.h"
 
+#include <algorithm>
 #include <iterator>
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -80,6 +81,63 @@ struct PDCParser
 
     PDCParser(const std::string &buf, Context *ctx) : buf(buf), ctx(ctx){};
 
+    // Look up the IdString for an object name without interning it, so that names matching nothing don't add one.
+    // Returns the empty IdString if there is no such name
+    IdString lookup_id(const std::string &name) const
+    {
+        int index = ctx->idstring_db->lookup(name);
+        return index < 0 ? IdString() : IdString(index);
+    }
+
+    // Match a name against a pattern where '*' matches any sequence of characters and '?' any one character. Other
+    // characters, including brackets, match literally as they are used for bus indices in port names
+    static bool glob_match(const std::string &pattern, const std::string &name)
+    {
+        size_t p = 0, n = 0, star_p = std::string::npos, star_n = 0;
+        while (n < name.size()) {
+            if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+                ++p;
+                ++n;
+            } else if (p < pattern.size() && pattern[p] == '*') {
+                star_p = p++;
+                star_n = n;
+            } else if (star_p != std::string::npos) {
+                p = star_p + 1;
+                n = ++star_n;
+            } else {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == '*')
+            ++p;
+        return p == pattern.size();
+    }
+
+    // Top level port names in name order, built on first use of a wildcard; and the ports matched by each wildcard
+    // pattern seen, as the same patterns tend to be used repeatedly
+    std::vector<std::pair<std::string, IdString>> port_names;
+    std::unordered_map<std::string, std::vector<IdString>> port_glob_cache;
+
+    const std::vector<IdString> &match_ports(const std::string &pattern)
+    {
+        auto fnd = port_glob_cache.find(pattern);
+        if (fnd != port_glob_cache.end())
+            return fnd->second;
+        if (port_names.empty()) {
+            for (auto &port : ctx->ports)
+                port_names.emplace_back(port.first.str(ctx), port.first);
+            std::sort(port_names.begin(), port_names.end());
+        }
+        std::vector<IdString> matched;
+        // Everything before the first wildcard is a literal prefix, narrowing down the names to test
+        std::string prefix = pattern.substr(0, pattern.find_first_of("*?"));
+        auto it = std::lower_bound(port_names.begin(), port_names.end(), std::make_pair(prefix, IdString()));
+        for (; it != port_names.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+            if (glob_match(pattern, it->first))
+                matched.push_back(it->second);
+        return port_glob_cache.emplace(pattern, std::move(matched)).first->second;
+    }
+
     inline bool eof() const { return pos == int(buf.size()); }
 
     inline char peek() const { return buf.at(pos); }
@@ -243,8 +301,8 @@ struct PDCParser
             std::string s = arg.str;
             if (s.at(0) == '-')
                 log_error("unsupported argument '%s' to get_nets (line %d)\n", s.c_str(), lineno);
-            IdString id = ctx->id(s);
-            if (ctx->nets.count(id) || ctx->net_aliases.count(id))
+            IdString id = lookup_id(s);
+            if (id != IdString() && (ctx->nets.count(id) || ctx->net_aliases.count(id)))
                 nets.emplace_back(TCLEntity::ENTITY_NET, ctx->net_aliases.count(id) ? ctx->net_aliases.at(id) : id);
             else
                 log_warning("get_nets argument '%s' matched no objects.\n", s.c_str());
@@ -262,8 +320,13 @@ struct PDCParser
             std::string s = arg.str;
             if (s.at(0) == '-')
                 log_error("unsupported argument '%s' to get_ports (line %d)\n", s.c_str(), lineno);
-            IdString id = ctx->id(s);
-            if (ctx->ports.count(id))
+            if (s.find_first_of("*?") != std::string::npos) {
+                for (IdString id : match_ports(s))
+                    ports.emplace_back(TCLEntity::ENTITY_PORT, id);
+                continue;
+            }
+            IdString id = lookup_id(s);
+            if (id != IdString() && ctx->ports.count(id))
                 ports.emplace_back(TCLEntity::ENTITY_PORT, id);
         }
         return ports;
@@ -279,8 +342,8 @@ struct PDCParser
             std::string s = arg.str;
             if (s.at(0) == '-')
                 log_error("unsupported argument '%s' to get_cells (line %d)\n", s.c_str(), lineno);
-            IdString id = ctx->id(s);
-            if (ctx->cells.count(id))
+            IdString id = lookup_id(s);
+            if (id != IdString() && ctx->cells.count(id))
                 cells.emplace_back(TCLEntity::ENTITY_CELL, id);
         }
         return cells;
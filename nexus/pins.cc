@@ -192,24 +192,42 @@ static const std::unordered_map<IdString, Arch::CellPinsData> base_cell_pin_data
          }}};
 } // namespace
 
-void Arch::init_cell_pin_data() { cell_pins_db = base_cell_pin_data; }
+void Arch::init_cell_pin_data()
+{
+    cell_pins_db = base_cell_pin_data;
+
+    int max_type = -1;
+    cell_pin_style_width = 1;
+    for (auto &cell : cell_pins_db) {
+        max_type = std::max(max_type, cell.first.index);
+        for (auto &port : cell.second)
+            cell_pin_style_width = std::max(cell_pin_style_width, port.first.index + 1);
+    }
+    cell_pin_style_row.assign(max_type + 1, -1);
+    cell_pin_styles.clear();
+    for (auto &cell : cell_pins_db) {
+        // If there isn't an exact port match, then the empty IdString
+        // represents a wildcard default match
+        auto fnd_default = cell.second.find({});
+        CellPinStyle def = (fnd_default != cell.second.end()) ? fnd_default->second : PINSTYLE_NONE;
+        int row = int(cell_pin_styles.size());
+        cell_pin_style_row.at(cell.first.index) = row;
+        cell_pin_styles.resize(row + cell_pin_style_width + 1, def);
+        for (auto &port : cell.second)
+            if (port.first != IdString())
+                cell_pin_styles.at(row + port.first.index) = port.second;
+    }
+}
 
 CellPinStyle Arch::get_cell_pin_style(const CellInfo *cell, IdString port) const
 {
-    // Look up the pin style in the cell database
-    auto fnd_cell = cell_pins_db.find(cell->type);
-    if (fnd_cell == cell_pins_db.end())
+    int type = cell->type.index;
+    if (type < 0 || type >= int(cell_pin_style_row.size()) || cell_pin_style_row[type] == -1)
         return PINSTYLE_NONE;
-    auto fnd_port = fnd_cell->second.find(port);
-    if (fnd_port != fnd_cell->second.end())
-        return fnd_port->second;
-    // If there isn't an exact port match, then the empty IdString
-    // represents a wildcard default match
-    auto fnd_default = fnd_cell->second.find({});
-    if (fnd_default != fnd_cell->second.end())
-        return fnd_default->second;
-
-    return PINSTYLE_NONE;
+    int row = cell_pin_style_row[type];
+    if (port.index >= 0 && port.index < cell_pin_style_width)
+        return cell_pin_styles[row + port.index];
+    return cell_pin_styles[row + cell_pin_style_width];
 }
 
 NEXTPNR_NAMESPACE_END
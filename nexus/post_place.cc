@@ -20,7 +20,7 @@
 #include "design_utils.h"
 #include "log.h"
 #include "nextpnr.h"
-#include "timing.h"
+#include "place_common.h"
 #include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
@@ -28,7 +28,6 @@ NEXTPNR_NAMESPACE_BEGIN
 struct NexusPostPlaceOpt
 {
     Context *ctx;
-    NetCriticalityMap net_crit;
 
     NexusPostPlaceOpt(Context *ctx) : ctx(ctx){};
 
@@ -41,33 +40,16 @@ struct NexusPostPlaceOpt
     {
         if (is_constrained(cell))
             return false;
-        BelId oldBel = cell->bel;
         CellInfo *other_cell = ctx->getBoundBelCell(new_bel);
         if (other_cell != nullptr && (is_constrained(other_cell) || other_cell->belStrength > STRENGTH_WEAK)) {
             return false;
         }
 
-        ctx->unbindBel(oldBel);
-        if (other_cell != nullptr) {
-            ctx->unbindBel(new_bel);
-        }
-
-        ctx->bindBel(new_bel, cell, STRENGTH_WEAK);
-
-        if (other_cell != nullptr) {
-            ctx->bindBel(oldBel, other_cell, STRENGTH_WEAK);
-        }
-
-        if (!ctx->isBelLocationValid(new_bel) || ((other_cell != nullptr && !ctx->isBelLocationValid(oldBel)))) {
+        CellMoveBatch move(ctx);
+        move.swap(cell, new_bel);
+        if (!move.is_legal()) {
             // New placement is not legal.
-            ctx->unbindBel(new_bel);
-            if (other_cell != nullptr)
-                ctx->unbindBel(oldBel);
-
-            // Revert.
-            ctx->bindBel(oldBel, cell, STRENGTH_WEAK);
-            if (other_cell != nullptr)
-                ctx->bindBel(new_bel, other_cell, STRENGTH_WEAK);
+            move.rollback();
             return false;
         }
 
@@ -91,11 +73,13 @@ struct NexusPostPlaceOpt
     void opt_lutffs()
     {
         int moves_made = 0;
-        for (auto cell : sorted(ctx->cells)) {
-            // Search for FF cells
-            CellInfo *ff = cell.second;
-            if (ff->type != id_OXIDE_FF)
-                continue;
+        // Search for FF cells, visited in name order without sorting the whole netlist
+        std::vector<CellInfo *> ffs;
+        for (auto &cell : ctx->cells)
+            if (cell.second->type == id_OXIDE_FF)
+                ffs.push_back(cell.second.get());
+        std::sort(ffs.begin(), ffs.end(), [](const CellInfo *a, const CellInfo *b) { return a->name < b->name; });
+        for (CellInfo *ff : ffs) {
             // Check M ('fabric') input net
             NetInfo *m = get_net_or_empty(ff, id_M);
             if (m == nullptr)
@@ -137,11 +121,7 @@ struct NexusPostPlaceOpt
         log_info("     created %d direct LUT-FF pairs\n", moves_made);
     }
 
-    void operator()()
-    {
-        get_criticalities(ctx, &net_crit);
-        opt_lutffs();
-    }
+    void operator()() { opt_lutffs(); }
 
     // Configuration
     const int lut_ff_radius = 2;
@@ -0,0 +1,17 @@
+# Run ./nextpnr-ice40 --json ice40/blinky.json --post-route python/dump_placement.py
+# Uses the bulk table accessors, which are much faster than iterating ctx.cells and ctx.nets for large designs
+import numpy as np
+
+names = ctx.getIdStrings()
+
+placement = np.asarray(ctx.getPlacementTable())
+print("{} cells, {} placed".format(len(placement), np.count_nonzero(placement[:, 1] >= 0)))
+for cell, bel, x, y, z, strength in placement[np.lexsort((placement[:, 4], placement[:, 3], placement[:, 2]))]:
+    if bel >= 0:
+        print("{} ({}, {}, {}): {}".format(names[bel], x, y, z, names[cell]))
+
+routing = np.asarray(ctx.getRoutingTable())
+nets, wires_per_net = np.unique(routing[:, 0], return_counts=True)
+print("{} routed nets using {} wires".format(len(nets), len(routing)))
+for net, count in sorted(zip(nets, wires_per_net), key=lambda x: -x[1])[:10]:
+    print("{:6d} wires: {}".format(count, names[net]))